@@ -57,6 +57,9 @@
 /* Utilities include. */
 #include "iot_pki_utils.h"
 
+/* TLS include. */
+#include "iot_tls.h"
+
 /* mbedTLS includes. */
 #include "mbedtls/pk.h"
 #include "mbedtls/oid.h"
@@ -1246,6 +1249,10 @@ CK_RV xProvisionDevice( CK_SESSION_HANDLE xSession,
         vPortFree( xProvisionedState.pcIdentifier );
     }
 
+    /* Objects may have been destroyed or created even if provisioning failed,
+     * so make the next TLS connection read them again. */
+    TLS_InvalidateClientCredential();
+
     return xResult;
 }
 
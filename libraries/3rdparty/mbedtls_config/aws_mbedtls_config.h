@@ -3196,6 +3196,11 @@
  *
  * Uncomment to set the maximum plaintext size of both
  * incoming and outgoing I/O buffers.
+ *
+ * With tlsconfigMAX_FRAGMENT_LENGTH_REQUEST set to 1, the FreeRTOS TLS layer
+ * requests the largest maximum fragment length that fits the incoming buffer
+ * when it is smaller than 16384, so 4096 or less can be used to save heap
+ * with servers that support the extension.
  */
 #define MBEDTLS_SSL_MAX_CONTENT_LEN             8192
 
@@ -171,6 +171,14 @@ IotNetworkError_t IotNetworkAfr_Close( void * pConnection );
  */
 IotNetworkError_t IotNetworkAfr_Destroy( void * pConnection );
 
+/**
+ * @brief An implementation of #IotNetworkInterface_t::sendv for FreeRTOS
+ * Secure Sockets.
+ */
+size_t IotNetworkAfr_Sendv( void * pConnection,
+                            const IotNetworkIoVector_t * pVectors,
+                            size_t vectorCount );
+
 /**
  * @cond DOXYGEN_IGNORE
  * Doxygen should ignore this section.
@@ -65,13 +65,48 @@
     #define IOT_NETWORK_SOCKET_POLL_MS    ( 1000 )
 #endif
 
+/* Provide a default value for the number of buffers passed to SOCKETS_Sendv
+ * at a time. The vectors are converted on the stack in batches of this size. */
+#ifndef IOT_NETWORK_SENDV_BATCH_SIZE
+    #define IOT_NETWORK_SENDV_BATCH_SIZE    ( 8 )
+#endif
+
+/* Serve the receive callbacks of all connections from one task that waits on
+ * their sockets with SOCKETS_Poll(), instead of creating a receive task for
+ * each connection. Requires a Secure Sockets port that implements SOCKETS_Poll(). */
+#ifndef IOT_NETWORK_RECEIVE_DISPATCHER
+    #define IOT_NETWORK_RECEIVE_DISPATCHER            ( 0 )
+#endif
+
+/* Load the TLS credentials of a new connection on another task while the
+ * server name is resolved and the TCP connection is established, instead of
+ * at the start of the TLS handshake. Ignored by Secure Sockets ports that do
+ * not support SOCKETS_SO_TLS_PREPARE. */
+#ifndef IOT_NETWORK_TLS_PREPARE
+    #define IOT_NETWORK_TLS_PREPARE                   ( 1 )
+#endif
+
+/* The maximum number of connections with a receive callback when the receive
+ * dispatcher is used. */
+#ifndef IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS
+    #define IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS    ( 16 )
+#endif
+
+/* The longest the receive dispatcher waits in SOCKETS_Poll(). This bounds how
+ * long a new connection waits to be served and how long a closed connection
+ * waits to be released, as sockets cannot be woken from another task. */
+#ifndef IOT_NETWORK_DISPATCHER_POLL_MS
+    #define IOT_NETWORK_DISPATCHER_POLL_MS            ( 100 )
+#endif
+
 /**
  * @brief The event group bit to set when a connection's socket is shut down.
  */
 #define _FLAG_SHUTDOWN                ( 1 )
 
 /**
- * @brief The event group bit to set when a connection's receive task exits.
+ * @brief The event group bit to set when a connection's receive task exits, or
+ * when the receive dispatcher stops serving the connection.
  */
 #define _FLAG_RECEIVE_TASK_EXITED     ( 2 )
 
@@ -88,7 +123,7 @@ typedef struct _networkConnection
     Socket_t socket;                             /**< @brief FreeRTOS Secure Sockets handle. */
     StaticSemaphore_t socketMutex;               /**< @brief Prevents concurrent threads from sending on a socket. */
     StaticEventGroup_t connectionFlags;          /**< @brief Synchronizes with the receive task. */
-    TaskHandle_t receiveTask;                    /**< @brief Handle of the receive task, if any. */
+    TaskHandle_t receiveTask;                    /**< @brief Handle of the receive task or the receive dispatcher, if any. */
     IotNetworkReceiveCallback_t receiveCallback; /**< @brief Network receive callback, if any. */
     void * pReceiveContext;                      /**< @brief The context for the receive callback. */
     bool bufferedByteValid;                      /**< @brief Used to determine if the buffered byte is valid. */
@@ -97,6 +132,36 @@ typedef struct _networkConnection
 
 /*-----------------------------------------------------------*/
 
+#if ( IOT_NETWORK_RECEIVE_DISPATCHER == 1 )
+
+/**
+ * @brief Protects the list of connections served by the receive dispatcher.
+ */
+    static StaticSemaphore_t _dispatcherMutex;
+
+/**
+ * @brief Wakes the receive dispatcher when it has no connections to wait on.
+ */
+    static StaticSemaphore_t _dispatcherWakeup;
+
+/**
+ * @brief Handle of the receive dispatcher task, NULL until it is started.
+ */
+    static TaskHandle_t _dispatcherTask = NULL;
+
+/**
+ * @brief The connections served by the receive dispatcher.
+ */
+    static _networkConnection_t * _dispatchedConnections[ IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS ];
+
+/**
+ * @brief The number of connections in #_dispatchedConnections.
+ */
+    static size_t _dispatchedConnectionCount = 0;
+#endif
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief An #IotNetworkInterface_t that uses the functions in this file.
  */
@@ -108,7 +173,8 @@ const IotNetworkInterface_t IotNetworkAfr =
     .receive            = IotNetworkAfr_Receive,
     .receiveUpto        = IotNetworkAfr_ReceiveUpto,
     .close              = IotNetworkAfr_Close,
-    .destroy            = IotNetworkAfr_Destroy
+    .destroy            = IotNetworkAfr_Destroy,
+    .sendv              = IotNetworkAfr_Sendv
 };
 
 /*-----------------------------------------------------------*/
@@ -134,6 +200,8 @@ static void _destroyConnection( _networkConnection_t * pNetworkConnection )
 
 /*-----------------------------------------------------------*/
 
+#if ( IOT_NETWORK_RECEIVE_DISPATCHER == 0 )
+
 /**
  * @brief Task routine that waits on incoming network data.
  *
@@ -213,6 +281,274 @@ static void _networkReceiveTask( void * pArgument )
     vTaskDelete( NULL );
 }
 
+#else /* if ( IOT_NETWORK_RECEIVE_DISPATCHER == 0 ) */
+
+/**
+ * @brief Check if a connection is served by the receive dispatcher.
+ *
+ * @param[in] pNetworkConnection The connection to look for.
+ *
+ * @return The index of the connection, or #IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS
+ * if it is not served.
+ */
+static size_t _dispatcherFind( const _networkConnection_t * pNetworkConnection )
+{
+    size_t i = 0;
+
+    for( i = 0; i < _dispatchedConnectionCount; i++ )
+    {
+        if( _dispatchedConnections[ i ] == pNetworkConnection )
+        {
+            break;
+        }
+    }
+
+    if( i == _dispatchedConnectionCount )
+    {
+        i = IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS;
+    }
+
+    return i;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Stop serving a connection from the receive dispatcher.
+ *
+ * Only called from the receive dispatcher, so a connection in its snapshot of
+ * the list remains valid until it is removed here.
+ *
+ * @param[in] pNetworkConnection The connection to remove.
+ * @param[in] destroyConnection Whether the connection was destroyed from a
+ * receive callback and must be freed. Otherwise, the task waiting to destroy it
+ * is released.
+ */
+static void _dispatcherRemove( _networkConnection_t * pNetworkConnection,
+                               bool destroyConnection )
+{
+    size_t index = 0;
+
+    ( void ) xSemaphoreTake( ( QueueHandle_t ) &_dispatcherMutex, portMAX_DELAY );
+
+    index = _dispatcherFind( pNetworkConnection );
+
+    if( index != IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS )
+    {
+        _dispatchedConnectionCount--;
+        _dispatchedConnections[ index ] = _dispatchedConnections[ _dispatchedConnectionCount ];
+        _dispatchedConnections[ _dispatchedConnectionCount ] = NULL;
+    }
+
+    ( void ) xSemaphoreGive( ( QueueHandle_t ) &_dispatcherMutex );
+
+    if( destroyConnection == true )
+    {
+        _destroyConnection( pNetworkConnection );
+    }
+    else
+    {
+        ( void ) xEventGroupSetBits( ( EventGroupHandle_t ) &( pNetworkConnection->connectionFlags ),
+                                     _FLAG_RECEIVE_TASK_EXITED );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Stop serving a connection that was closed or destroyed.
+ *
+ * @param[in] pNetworkConnection The connection to check.
+ *
+ * @return `true` if the connection is still served; `false` if it was removed.
+ */
+static bool _dispatcherCheckConnection( _networkConnection_t * pNetworkConnection )
+{
+    bool served = true;
+    EventBits_t connectionFlags = xEventGroupGetBits( ( EventGroupHandle_t ) &( pNetworkConnection->connectionFlags ) );
+
+    if( ( connectionFlags & _FLAG_CONNECTION_DESTROYED ) == _FLAG_CONNECTION_DESTROYED )
+    {
+        _dispatcherRemove( pNetworkConnection, true );
+        served = false;
+    }
+    else if( ( connectionFlags & _FLAG_SHUTDOWN ) == _FLAG_SHUTDOWN )
+    {
+        _dispatcherRemove( pNetworkConnection, false );
+        served = false;
+    }
+    else
+    {
+        /* Empty else MISRA 15.7 */
+    }
+
+    return served;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Task routine that waits on all connections with a receive callback
+ * and invokes the callbacks of the connections with incoming data.
+ *
+ * @param[in] pArgument Ignored.
+ */
+static void _networkDispatchTask( void * pArgument )
+{
+    size_t connectionCount = 0, pollCount = 0, i = 0;
+    int32_t pollStatus = 0;
+    _networkConnection_t * pNetworkConnection = NULL;
+    _networkConnection_t * pConnections[ IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS ];
+    SocketsPollFd_t pollFds[ IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS ];
+
+    ( void ) pArgument;
+
+    while( true )
+    {
+        /* Take a snapshot of the served connections. Connections are only
+         * removed by this task, so the snapshot stays valid. */
+        ( void ) xSemaphoreTake( ( QueueHandle_t ) &_dispatcherMutex, portMAX_DELAY );
+        connectionCount = _dispatchedConnectionCount;
+        ( void ) memcpy( pConnections, _dispatchedConnections, connectionCount * sizeof( _networkConnection_t * ) );
+        ( void ) xSemaphoreGive( ( QueueHandle_t ) &_dispatcherMutex );
+
+        pollCount = 0;
+
+        for( i = 0; i < connectionCount; i++ )
+        {
+            if( _dispatcherCheckConnection( pConnections[ i ] ) == true )
+            {
+                pConnections[ pollCount ] = pConnections[ i ];
+                pollFds[ pollCount ].xSocket = pConnections[ i ]->socket;
+                pollFds[ pollCount ].ulEvents = SOCKETS_POLLIN;
+                pollFds[ pollCount ].ulREvents = 0;
+                pollCount++;
+            }
+        }
+
+        if( pollCount == 0U )
+        {
+            /* Sleep until a connection is added. */
+            ( void ) xSemaphoreTake( ( QueueHandle_t ) &_dispatcherWakeup, portMAX_DELAY );
+            continue;
+        }
+
+        pollStatus = SOCKETS_Poll( pollFds,
+                                   pollCount,
+                                   pdMS_TO_TICKS( IOT_NETWORK_DISPATCHER_POLL_MS ) );
+
+        if( pollStatus < 0 )
+        {
+            IotLogError( "Error %ld while waiting for network data.", ( long int ) pollStatus );
+            vTaskDelay( pdMS_TO_TICKS( IOT_NETWORK_DISPATCHER_POLL_MS ) );
+            continue;
+        }
+
+        for( i = 0; ( i < pollCount ) && ( pollStatus > 0 ); i++ )
+        {
+            if( pollFds[ i ].ulREvents == 0U )
+            {
+                continue;
+            }
+
+            pollStatus--;
+            pNetworkConnection = pConnections[ i ];
+
+            /* An earlier callback may have closed or destroyed this connection. */
+            if( _dispatcherCheckConnection( pNetworkConnection ) == false )
+            {
+                continue;
+            }
+
+            if( ( pollFds[ i ].ulREvents & SOCKETS_POLLIN ) == SOCKETS_POLLIN )
+            {
+                pNetworkConnection->receiveCallback( pNetworkConnection,
+                                                     pNetworkConnection->pReceiveContext );
+
+                ( void ) _dispatcherCheckConnection( pNetworkConnection );
+            }
+            else
+            {
+                /* Like the receive task, stop receiving once the connection
+                 * has failed. Received data is delivered first. */
+                IotLogDebug( "Network connection %p hung up.", pNetworkConnection );
+                _dispatcherRemove( pNetworkConnection, false );
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Start serving a connection from the receive dispatcher, starting the
+ * dispatcher first if needed.
+ *
+ * @param[in] pNetworkConnection The connection to serve.
+ *
+ * @return #IOT_NETWORK_SUCCESS, #IOT_NETWORK_NO_MEMORY or #IOT_NETWORK_SYSTEM_ERROR.
+ */
+static IotNetworkError_t _dispatcherAdd( _networkConnection_t * pNetworkConnection )
+{
+    IotNetworkError_t status = IOT_NETWORK_SUCCESS;
+    static SemaphoreHandle_t dispatcherMutex = NULL;
+
+    /* Create the dispatcher lock once. Static creation cannot fail. */
+    taskENTER_CRITICAL();
+
+    if( dispatcherMutex == NULL )
+    {
+        dispatcherMutex = xSemaphoreCreateMutexStatic( &_dispatcherMutex );
+        ( void ) xSemaphoreCreateBinaryStatic( &_dispatcherWakeup );
+    }
+
+    taskEXIT_CRITICAL();
+
+    ( void ) xSemaphoreTake( dispatcherMutex, portMAX_DELAY );
+
+    if( _dispatcherTask == NULL )
+    {
+        if( xTaskCreate( _networkDispatchTask,
+                         "NetDisp",
+                         IOT_NETWORK_RECEIVE_TASK_STACK_SIZE,
+                         NULL,
+                         IOT_NETWORK_RECEIVE_TASK_PRIORITY,
+                         &_dispatcherTask ) != pdPASS )
+        {
+            IotLogError( "Failed to create network receive dispatcher task." );
+            _dispatcherTask = NULL;
+            status = IOT_NETWORK_SYSTEM_ERROR;
+        }
+    }
+
+    if( status == IOT_NETWORK_SUCCESS )
+    {
+        if( _dispatchedConnectionCount == IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS )
+        {
+            IotLogError( "The network receive dispatcher serves at most %d connections.",
+                         IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS );
+            status = IOT_NETWORK_NO_MEMORY;
+        }
+        else
+        {
+            pNetworkConnection->receiveTask = _dispatcherTask;
+            _dispatchedConnections[ _dispatchedConnectionCount ] = pNetworkConnection;
+            _dispatchedConnectionCount++;
+        }
+    }
+
+    ( void ) xSemaphoreGive( dispatcherMutex );
+
+    if( status == IOT_NETWORK_SUCCESS )
+    {
+        ( void ) xSemaphoreGive( ( QueueHandle_t ) &_dispatcherWakeup );
+    }
+
+    return status;
+}
+
+#endif /* if ( IOT_NETWORK_RECEIVE_DISPATCHER == 0 ) */
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -297,6 +633,21 @@ static IotNetworkError_t _tlsSetup( const IotNetworkCredentials_t * pAfrCredenti
         }
     }
 
+    #if ( IOT_NETWORK_TLS_PREPARE == 1 )
+        /* Start loading the credentials. The handshake loads them if this fails. */
+        socketStatus = SOCKETS_SetSockOpt( tcpSocket,
+                                           0,
+                                           SOCKETS_SO_TLS_PREPARE,
+                                           NULL,
+                                           0 );
+
+        if( socketStatus != SOCKETS_ERROR_NONE )
+        {
+            IotLogDebug( "Credentials of new connection not loaded ahead of the handshake, error %ld.",
+                         ( long int ) socketStatus );
+        }
+    #endif
+
     IOT_FUNCTION_EXIT_NO_CLEANUP();
 }
 
@@ -454,18 +805,23 @@ IotNetworkError_t IotNetworkAfr_SetReceiveCallback( void * pConnection,
     /* No flags should be set. */
     configASSERT( xEventGroupGetBits( ( EventGroupHandle_t ) &( pNetworkConnection->connectionFlags ) ) == 0 );
 
-    /* Create task that waits for incoming data. */
-    if( xTaskCreate( _networkReceiveTask,
-                     "NetRecv",
-                     IOT_NETWORK_RECEIVE_TASK_STACK_SIZE,
-                     pNetworkConnection,
-                     IOT_NETWORK_RECEIVE_TASK_PRIORITY,
-                     &( pNetworkConnection->receiveTask ) ) != pdPASS )
-    {
-        IotLogError( "Failed to create network receive task." );
+    #if ( IOT_NETWORK_RECEIVE_DISPATCHER == 1 )
+        /* Wait for incoming data from the receive dispatcher. */
+        status = _dispatcherAdd( pNetworkConnection );
+    #else
+        /* Create task that waits for incoming data. */
+        if( xTaskCreate( _networkReceiveTask,
+                         "NetRecv",
+                         IOT_NETWORK_RECEIVE_TASK_STACK_SIZE,
+                         pNetworkConnection,
+                         IOT_NETWORK_RECEIVE_TASK_PRIORITY,
+                         &( pNetworkConnection->receiveTask ) ) != pdPASS )
+        {
+            IotLogError( "Failed to create network receive task." );
 
-        status = IOT_NETWORK_SYSTEM_ERROR;
-    }
+            status = IOT_NETWORK_SYSTEM_ERROR;
+        }
+    #endif
 
     return status;
 }
@@ -516,6 +872,69 @@ size_t IotNetworkAfr_Send( void * pConnection,
 
 /*-----------------------------------------------------------*/
 
+size_t IotNetworkAfr_Sendv( void * pConnection,
+                            const IotNetworkIoVector_t * pVectors,
+                            size_t vectorCount )
+{
+    size_t bytesSent = 0U, batchLength = 0U, batchCount = 0U, i = 0U;
+    int32_t socketStatus = SOCKETS_ERROR_NONE;
+    SocketsIoVector_t socketVectors[ IOT_NETWORK_SENDV_BATCH_SIZE ];
+
+    /* Cast network connection to the correct type. */
+    _networkConnection_t * pNetworkConnection = ( _networkConnection_t * ) pConnection;
+
+    /* Only one thread at a time may send on the connection. Lock the socket
+     * mutex to prevent other threads from sending. */
+    if( xSemaphoreTake( ( QueueHandle_t ) &( pNetworkConnection->socketMutex ),
+                        portMAX_DELAY ) == pdTRUE )
+    {
+        while( vectorCount > 0U )
+        {
+            /* Convert the next batch of buffers to Secure Sockets vectors. */
+            batchCount = ( vectorCount < IOT_NETWORK_SENDV_BATCH_SIZE ) ?
+                         vectorCount : IOT_NETWORK_SENDV_BATCH_SIZE;
+            batchLength = 0U;
+
+            for( i = 0U; i < batchCount; i++ )
+            {
+                socketVectors[ i ].pvBuffer = pVectors[ i ].pBuffer;
+                socketVectors[ i ].xLength = pVectors[ i ].length;
+                batchLength += pVectors[ i ].length;
+            }
+
+            socketStatus = SOCKETS_Sendv( pNetworkConnection->socket,
+                                          socketVectors,
+                                          batchCount,
+                                          0 );
+
+            if( socketStatus < 0 )
+            {
+                IotLogError( "Error %ld while sending data.", ( long int ) socketStatus );
+                break;
+            }
+
+            bytesSent += ( size_t ) socketStatus;
+
+            /* A short write means the socket could not take any more data;
+             * report what was sent and let the caller decide what to do. */
+            if( ( size_t ) socketStatus != batchLength )
+            {
+                IotLogError( "Only %lu of %lu bytes were sent.",
+                             ( unsigned long ) socketStatus,
+                             ( unsigned long ) batchLength );
+                break;
+            }
+
+            pVectors += batchCount;
+            vectorCount -= batchCount;
+        }
+
+        xSemaphoreGive( ( QueueHandle_t ) &( pNetworkConnection->socketMutex ) );
+    }
+
+    return bytesSent;
+}
+
 size_t IotNetworkAfr_Receive( void * pConnection,
                               uint8_t * pBuffer,
                               size_t bytesRequested )
@@ -662,12 +1081,31 @@ IotNetworkError_t IotNetworkAfr_Destroy( void * pConnection )
     /* Cast network connection to the correct type. */
     _networkConnection_t * pNetworkConnection = ( _networkConnection_t * ) pConnection;
 
+    /* Whether the receive task must free the connection once it returns. */
+    bool destroyFromReceiveTask = true;
+
     /* Check if this function is being called from the receive task. */
     if( xTaskGetCurrentTaskHandle() == pNetworkConnection->receiveTask )
     {
-        /* Set the flag specifying that the connection is destroyed. */
-        ( void ) xEventGroupSetBits( ( EventGroupHandle_t ) &( pNetworkConnection->connectionFlags ),
-                                     _FLAG_CONNECTION_DESTROYED );
+        #if ( IOT_NETWORK_RECEIVE_DISPATCHER == 1 )
+
+            /* Receive callbacks may destroy any connection. The dispatcher
+             * only frees the ones it still serves. */
+            ( void ) xSemaphoreTake( ( QueueHandle_t ) &_dispatcherMutex, portMAX_DELAY );
+            destroyFromReceiveTask = ( _dispatcherFind( pNetworkConnection ) != IOT_NETWORK_DISPATCHER_MAX_CONNECTIONS );
+            ( void ) xSemaphoreGive( ( QueueHandle_t ) &_dispatcherMutex );
+        #endif
+
+        if( destroyFromReceiveTask == true )
+        {
+            /* Set the flag specifying that the connection is destroyed. */
+            ( void ) xEventGroupSetBits( ( EventGroupHandle_t ) &( pNetworkConnection->connectionFlags ),
+                                         _FLAG_CONNECTION_DESTROYED );
+        }
+        else
+        {
+            _destroyConnection( pNetworkConnection );
+        }
     }
     else
     {
@@ -75,6 +75,8 @@ typedef enum IotNetworkError
  * @function_brief{platform_network_function_close}
  * - @function_name{platform_network_function_destroy}
  * @function_brief{platform_network_function_destroy}
+ * - @function_name{platform_network_function_sendv}
+ * @function_brief{platform_network_function_sendv}
  * - @function_name{platform_network_function_receivecallback}
  * @function_brief{platform_network_function_receivecallback}
  */
@@ -101,6 +103,9 @@ typedef enum IotNetworkError
  * @function_page{IotNetworkInterface_t::destroy,platform_network,destroy}
  * @function_snippet{platform_network,destroy,this}
  * @copydoc IotNetworkInterface_t::destroy
+ * @function_page{IotNetworkInterface_t::sendv,platform_network,sendv}
+ * @function_snippet{platform_network,sendv,this}
+ * @copydoc IotNetworkInterface_t::sendv
  * @function_page{IotNetworkReceiveCallback_t,platform_network,receivecallback}
  * @function_snippet{platform_network,receivecallback,this}
  * @copydoc IotNetworkReceiveCallback_t
@@ -121,6 +126,16 @@ typedef void ( * IotNetworkReceiveCallback_t )( void * pConnection,
                                                 void * pContext );
 /* @[declare_platform_network_receivecallback] */
 
+/**
+ * @ingroup platform_datatypes_paramstructs
+ * @brief One buffer of a message passed to @ref platform_network_function_sendv.
+ */
+typedef struct IotNetworkIoVector
+{
+    const uint8_t * pBuffer; /**< @brief Data to send. */
+    size_t length;           /**< @brief Length of #IotNetworkIoVector_t.pBuffer. */
+} IotNetworkIoVector_t;
+
 /**
  * @ingroup platform_datatypes_paramstructs
  * @brief Represents the functions of a network stack.
@@ -281,6 +296,27 @@ typedef struct IotNetworkInterface
     /* @[declare_platform_network_destroy] */
     IotNetworkError_t ( * destroy )( void * pConnection );
     /* @[declare_platform_network_destroy] */
+
+    /**
+     * @brief Send a message held in several buffers over a connection.
+     *
+     * Sends the buffers in order as one message, so that a network stack which
+     * frames its data (such as TLS) may combine small buffers instead of sending
+     * each one separately. This function is optional and may be `NULL`; callers
+     * must then fall back to @ref platform_network_function_send for each buffer.
+     *
+     * @param[in] pConnection The connection used to send data, defined by the
+     * network stack.
+     * @param[in] pVectors The buffers to send.
+     * @param[in] vectorCount The number of elements in `pVectors`.
+     *
+     * @return The number of bytes successfully sent, `0` on failure.
+     */
+    /* @[declare_platform_network_sendv] */
+    size_t ( * sendv )( void * pConnection,
+                        const IotNetworkIoVector_t * pVectors,
+                        size_t vectorCount );
+    /* @[declare_platform_network_sendv] */
 } IotNetworkInterface_t;
 
 /**
@@ -0,0 +1,63 @@
+/*
+ * FreeRTOS Secure Sockets V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file dns.h
+ * @brief lwIP DNS client. The benchmark connects to addresses, which are parsed
+ * instead of resolved. Lookups are answered by the benchmark, at once or after
+ * a simulated delay like a lookup that is not cached.
+ */
+
+#ifndef LWIP_HDR_DNS_H
+#define LWIP_HDR_DNS_H
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "lwip/err.h"
+
+#define LWIP_DNS_ADDRTYPE_IPV4    0
+
+/* An IPv4 address in network byte order. */
+typedef struct ip_addr
+{
+    uint32_t addr;
+} ip_addr_t;
+
+typedef void ( * dns_found_callback )( const char * name,
+                                       const ip_addr_t * ipaddr,
+                                       void * callback_arg );
+
+static inline void dns_init( void )
+{
+}
+
+err_t dns_gethostbyname_addrtype( const char * hostname,
+                                  ip_addr_t * addr,
+                                  dns_found_callback found,
+                                  void * callback_arg,
+                                  uint8_t dns_addrtype );
+
+#endif /* LWIP_HDR_DNS_H */
@@ -0,0 +1,831 @@
+/*
+ * FreeRTOS Secure Sockets V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_network_benchmark.c
+ * @brief Measure the cost of serving network receive callbacks on a host.
+ *
+ * Opens connections to a loopback server through the FreeRTOS network interface,
+ * then sends messages from the server to the connections in turn and times each
+ * one until its receive callback has read it. Prints one row with the tasks, task
+ * stack and heap the open connections use and the callback latency.
+ * Whether callbacks come from a task per connection or from the receive dispatcher
+ * is fixed when the benchmark is built.
+ *
+ * With -t, times IotNetworkAfr_Create() instead, opening TLS connections one
+ * after another. Each connection resolves the server name and loads the client
+ * credentials cold, like the first connection after boot. Whether the credentials
+ * are loaded while the name is resolved and the TCP connection is established is
+ * fixed when the benchmark is built, by IOT_NETWORK_TLS_PREPARE.
+ *
+ * Usage: iot_network_benchmark [-c connections] [-m messages] [-s message_bytes]
+ *                              [-t [-d dns_ms] [-k credential_ms]]
+ *
+ * Connections are plain TCP. TLS is replaced by a null TLS library that only
+ * simulates the cost of loading the credentials, and the lookups of uncached
+ * server names take a simulated time as well.
+ */
+
+/* Standard includes. */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Network and Secure Sockets includes. */
+#include "platform/iot_network_freertos.h"
+#include "iot_secure_sockets.h"
+#include "iot_tls.h"
+#include "lwip/dns.h"
+
+/* Test utilities. */
+#include "wait_for_event.h"
+#include "benchmark_kernel.h"
+
+#define BENCH_HOST                  "127.0.0.1"
+#define BENCH_MAX_CONNECTIONS       64U
+#define BENCH_MAX_MESSAGE_SIZE      4096U
+#define BENCH_DEFAULT_CONNECTIONS   1U
+#define BENCH_DEFAULT_MESSAGES      1000U
+#define BENCH_DEFAULT_MESSAGE_SIZE  64U
+#define BENCH_RECEIVE_WAIT_S        5
+#define BENCH_DEFAULT_DNS_MS        20U
+#define BENCH_DEFAULT_CREDENTIAL_MS 40U
+
+/* A connection and the server end of it. */
+
+typedef struct
+{
+    void * pvConnection;          /* Client end, from IotNetworkAfr_Create(). */
+    int iServerSocket;            /* Server end, from accept(). */
+    struct event * pxReceived;    /* Signalled by the callback once a message was read. */
+    uint8_t * pucBuffer;          /* Receive buffer of the callback. */
+    size_t xMessageSize;          /* Bytes the callback reads. */
+    size_t xReceived;             /* Bytes the callback read last. */
+    uint64_t ullReceivedNs;       /* When the callback finished reading. */
+} BenchConnection_t;
+
+/* Measurements of one run. */
+
+typedef struct
+{
+    BenchKernelUsage_t xBaseline; /* Before any connection was opened. */
+    BenchKernelUsage_t xOpen;     /* With all connections open and receiving. */
+    BenchKernelUsage_t xClosed;   /* After all connections were destroyed. */
+    uint64_t * pullLatencyNs;     /* Send to end of callback, per message. */
+    uint32_t ulMessages;          /* Messages that were received. */
+    uint64_t * pullConnectNs;     /* Duration of IotNetworkAfr_Create(), per connection. */
+    uint32_t ulConnects;          /* Connections that were opened. */
+} BenchRun_t;
+
+/* A connection secured by the null TLS library. */
+
+typedef struct
+{
+    TLSParams_t xParams;          /* The network callbacks of the connection. */
+} BenchTlsContext_t;
+
+/* A lookup answered after the simulated delay. */
+
+typedef struct
+{
+    const char * pcName;          /* The name looked up. */
+    ip_addr_t xAddress;           /* Its address. */
+    dns_found_callback xFound;    /* Called with the address. */
+    void * pvArgument;            /* Passed to xFound. */
+} BenchDnsLookup_t;
+
+/* Open the connections and register their callbacks. Returns 0 on success. */
+
+static int prvOpen( BenchConnection_t * pxConnections,
+                    uint32_t ulNumConnections,
+                    size_t xMessageSize );
+
+/* Close and destroy the connections. */
+
+static void prvClose( BenchConnection_t * pxConnections,
+                      uint32_t ulNumConnections );
+
+/* Send messages to the connections in turn and time their callbacks. Returns 0 on success. */
+
+static int prvMeasure( BenchConnection_t * pxConnections,
+                       uint32_t ulNumConnections,
+                       uint32_t ulNumMessages,
+                       BenchRun_t * pxRun );
+
+/* Open TLS connections one after another and time each. Returns 0 on success. */
+
+static int prvMeasureConnect( BenchConnection_t * pxConnections,
+                              uint32_t ulNumConnections,
+                              BenchRun_t * pxRun );
+
+/* Print the row for a run. */
+
+static void prvPrintRow( const BenchRun_t * pxRun,
+                         uint32_t ulNumConnections );
+
+/* Print the row for a run of prvMeasureConnect(). */
+
+static void prvPrintConnectRow( const BenchRun_t * pxRun,
+                                uint32_t ulNumConnections );
+
+/* Receive callback of the connections. */
+
+static void prvReceiveCallback( void * pvConnection,
+                                void * pvContext );
+
+/* Monotonic clock in nanoseconds. */
+
+static uint64_t prvNowNs( void );
+
+/* Block the calling thread. */
+
+static void prvSleepMs( uint32_t ulMs );
+
+/* Benchmark state. */
+
+static int iListenSocket = -1;
+static uint16_t usListenPort = 0;
+static uint32_t ulDnsDelayMs = 0;
+static uint32_t ulCredentialDelayMs = 0;
+
+/* The client credentials of the null TLS library, loaded once and shared by
+ * the handshakes like those of the TLS library. */
+
+static pthread_mutex_t xCredentialLock = PTHREAD_MUTEX_INITIALIZER;
+static int iCredentialLoaded = 0;
+
+/*-----------------------------------------------------------*/
+
+/* The connections are not secured, so the TLS library is replaced by a null TLS
+ * library that passes the data through. */
+
+static void prvLoadCredential( void )
+{
+    ( void ) pthread_mutex_lock( &xCredentialLock );
+
+    if( iCredentialLoaded == 0 )
+    {
+        prvSleepMs( ulCredentialDelayMs );
+        iCredentialLoaded = 1;
+    }
+
+    ( void ) pthread_mutex_unlock( &xCredentialLock );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Init( void ** ppvContext,
+                     TLSParams_t * pxParams )
+{
+    BenchTlsContext_t * pxCtx = pvPortMalloc( sizeof( BenchTlsContext_t ) );
+    BaseType_t xResult = pdFREERTOS_ERRNO_NONE;
+
+    if( pxCtx == NULL )
+    {
+        xResult = pdFREERTOS_ERRNO_ENOMEM;
+    }
+    else
+    {
+        pxCtx->xParams = *pxParams;
+        *ppvContext = pxCtx;
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Connect( void * pvContext )
+{
+    ( void ) pvContext;
+
+    /* Waits for credentials being loaded by TLS_Prepare(). */
+    prvLoadCredential();
+
+    return pdFREERTOS_ERRNO_NONE;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Recv( void * pvContext,
+                     unsigned char * pucReadBuffer,
+                     size_t xReadLength )
+{
+    BenchTlsContext_t * pxCtx = pvContext;
+
+    return pxCtx->xParams.pxNetworkRecv( pxCtx->xParams.pvCallerContext, pucReadBuffer, xReadLength );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Send( void * pvContext,
+                     const unsigned char * pucMsg,
+                     size_t xMsgLength )
+{
+    BenchTlsContext_t * pxCtx = pvContext;
+
+    return pxCtx->xParams.pxNetworkSend( pxCtx->xParams.pvCallerContext, pucMsg, xMsgLength );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Pending( void * pvContext )
+{
+    ( void ) pvContext;
+
+    return pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+void TLS_Cleanup( void * pvContext )
+{
+    vPortFree( pvContext );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Prepare( const char * pcServerCertificate,
+                        uint32_t ulServerCertificateLength )
+{
+    ( void ) pcServerCertificate;
+    ( void ) ulServerCertificateLength;
+
+    prvLoadCredential();
+
+    return pdFREERTOS_ERRNO_NONE;
+}
+
+/*-----------------------------------------------------------*/
+
+void TLS_InvalidateClientCredential( void )
+{
+    ( void ) pthread_mutex_lock( &xCredentialLock );
+    iCredentialLoaded = 0;
+    ( void ) pthread_mutex_unlock( &xCredentialLock );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Lookups are answered by a thread of their own, like by the lwIP thread. */
+
+static void * prvDnsAnswer( void * pvLookup )
+{
+    BenchDnsLookup_t * pxLookup = pvLookup;
+
+    prvSleepMs( ulDnsDelayMs );
+    pxLookup->xFound( pxLookup->pcName, &pxLookup->xAddress, pxLookup->pvArgument );
+    free( pxLookup );
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+err_t dns_gethostbyname_addrtype( const char * hostname,
+                                  ip_addr_t * addr,
+                                  dns_found_callback found,
+                                  void * callback_arg,
+                                  uint8_t dns_addrtype )
+{
+    BenchDnsLookup_t * pxLookup = NULL;
+    pthread_t xThread;
+    err_t xResult = ERR_OK;
+
+    ( void ) dns_addrtype;
+
+    addr->addr = ( uint32_t ) inet_addr( hostname );
+
+    if( addr->addr == ( uint32_t ) INADDR_NONE )
+    {
+        xResult = ERR_ARG;
+    }
+    else if( ulDnsDelayMs > 0U )
+    {
+        pxLookup = malloc( sizeof( BenchDnsLookup_t ) );
+
+        if( pxLookup == NULL )
+        {
+            xResult = ERR_MEM;
+        }
+        else
+        {
+            pxLookup->pcName = hostname;
+            pxLookup->xAddress = *addr;
+            pxLookup->xFound = found;
+            pxLookup->pvArgument = callback_arg;
+
+            if( pthread_create( &xThread, NULL, prvDnsAnswer, pxLookup ) != 0 )
+            {
+                free( pxLookup );
+                xResult = ERR_MEM;
+            }
+            else
+            {
+                ( void ) pthread_detach( xThread );
+                xResult = ERR_INPROGRESS;
+            }
+        }
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000000ULL ) + ( uint64_t ) xNow.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSleepMs( uint32_t ulMs )
+{
+    struct timespec xDelay;
+
+    xDelay.tv_sec = ( time_t ) ( ulMs / 1000U );
+    xDelay.tv_nsec = ( long ) ( ulMs % 1000U ) * 1000000L;
+
+    ( void ) nanosleep( &xDelay, NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvReceiveCallback( void * pvConnection,
+                                void * pvContext )
+{
+    BenchConnection_t * pxConnection = pvContext;
+
+    pxConnection->xReceived = IotNetworkAfr_Receive( pvConnection,
+                                                     pxConnection->pucBuffer,
+                                                     pxConnection->xMessageSize );
+    pxConnection->ullReceivedNs = prvNowNs();
+
+    event_signal( pxConnection->pxReceived );
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvOpen( BenchConnection_t * pxConnections,
+                    uint32_t ulNumConnections,
+                    size_t xMessageSize )
+{
+    IotNetworkServerInfo_t xServerInfo = { 0 };
+    BenchConnection_t * pxConnection;
+    uint32_t ulIndex;
+    int iNoDelay = 1;
+    int iResult = 0;
+
+    xServerInfo.pHostName = BENCH_HOST;
+    xServerInfo.port = usListenPort;
+
+    for( ulIndex = 0; ( ulIndex < ulNumConnections ) && ( iResult == 0 ); ulIndex++ )
+    {
+        pxConnection = &pxConnections[ ulIndex ];
+        pxConnection->xMessageSize = xMessageSize;
+        pxConnection->pucBuffer = malloc( xMessageSize );
+        pxConnection->pxReceived = event_create();
+
+        /* The connection is queued by the listening socket until it is accepted. */
+        if( ( pxConnection->pucBuffer == NULL ) || ( pxConnection->pxReceived == NULL ) ||
+            ( IotNetworkAfr_Create( &xServerInfo, NULL, &pxConnection->pvConnection ) != IOT_NETWORK_SUCCESS ) )
+        {
+            fprintf( stderr, "Connection %u could not be opened.\n", ulIndex );
+            iResult = 1;
+        }
+        else
+        {
+            pxConnection->iServerSocket = accept( iListenSocket, NULL, NULL );
+
+            if( pxConnection->iServerSocket < 0 )
+            {
+                fprintf( stderr, "Connection %u was not accepted.\n", ulIndex );
+                iResult = 1;
+            }
+            else
+            {
+                ( void ) setsockopt( pxConnection->iServerSocket, IPPROTO_TCP, TCP_NODELAY, &iNoDelay, sizeof( iNoDelay ) );
+            }
+        }
+    }
+
+    for( ulIndex = 0; ( ulIndex < ulNumConnections ) && ( iResult == 0 ); ulIndex++ )
+    {
+        pxConnection = &pxConnections[ ulIndex ];
+
+        if( IotNetworkAfr_SetReceiveCallback( pxConnection->pvConnection,
+                                              prvReceiveCallback,
+                                              pxConnection ) != IOT_NETWORK_SUCCESS )
+        {
+            fprintf( stderr, "Connection %u could not receive.\n", ulIndex );
+            iResult = 1;
+        }
+    }
+
+    return iResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvClose( BenchConnection_t * pxConnections,
+                      uint32_t ulNumConnections )
+{
+    BenchConnection_t * pxConnection;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < ulNumConnections; ulIndex++ )
+    {
+        pxConnection = &pxConnections[ ulIndex ];
+
+        if( pxConnection->pvConnection != NULL )
+        {
+            ( void ) IotNetworkAfr_Close( pxConnection->pvConnection );
+            ( void ) IotNetworkAfr_Destroy( pxConnection->pvConnection );
+        }
+
+        if( pxConnection->iServerSocket >= 0 )
+        {
+            ( void ) close( pxConnection->iServerSocket );
+        }
+
+        if( pxConnection->pxReceived != NULL )
+        {
+            event_delete( pxConnection->pxReceived );
+        }
+
+        free( pxConnection->pucBuffer );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvMeasure( BenchConnection_t * pxConnections,
+                       uint32_t ulNumConnections,
+                       uint32_t ulNumMessages,
+                       BenchRun_t * pxRun )
+{
+    BenchConnection_t * pxConnection;
+    uint8_t ucMessage[ BENCH_MAX_MESSAGE_SIZE ];
+    uint32_t ulIndex;
+    uint64_t ullSentNs;
+    int iResult = 0;
+
+    for( ulIndex = 0; ( ulIndex < ulNumMessages ) && ( iResult == 0 ); ulIndex++ )
+    {
+        pxConnection = &pxConnections[ ulIndex % ulNumConnections ];
+        pxConnection->xReceived = 0;
+        ( void ) memset( ucMessage, ( int ) ( ulIndex & 0xFFU ), pxConnection->xMessageSize );
+
+        ullSentNs = prvNowNs();
+
+        if( send( pxConnection->iServerSocket, ucMessage, pxConnection->xMessageSize, 0 ) != ( ssize_t ) pxConnection->xMessageSize )
+        {
+            fprintf( stderr, "Message %u could not be sent.\n", ulIndex );
+            iResult = 1;
+        }
+        else
+        {
+            /* The wait returns on timeout as well, so the callback is checked by
+             * what it received. */
+            ( void ) event_wait_timed( pxConnection->pxReceived, BENCH_RECEIVE_WAIT_S );
+
+            if( pxConnection->xReceived != pxConnection->xMessageSize )
+            {
+                fprintf( stderr, "Message %u was not received.\n", ulIndex );
+                iResult = 1;
+            }
+            else
+            {
+                pxRun->pullLatencyNs[ pxRun->ulMessages++ ] = pxConnection->ullReceivedNs - ullSentNs;
+            }
+        }
+    }
+
+    return iResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvMeasureConnect( BenchConnection_t * pxConnections,
+                              uint32_t ulNumConnections,
+                              BenchRun_t * pxRun )
+{
+    IotNetworkServerInfo_t xServerInfo = { 0 };
+    IotNetworkCredentials_t xCredentials = { 0 };
+    BenchConnection_t * pxConnection;
+    uint64_t ullStartNs;
+    uint32_t ulIndex;
+    int iResult = 0;
+
+    xServerInfo.pHostName = BENCH_HOST;
+    xServerInfo.port = usListenPort;
+
+    for( ulIndex = 0; ( ulIndex < ulNumConnections ) && ( iResult == 0 ); ulIndex++ )
+    {
+        pxConnection = &pxConnections[ ulIndex ];
+
+        /* Every connection loads the credentials, like the first one after boot. */
+        TLS_InvalidateClientCredential();
+
+        ullStartNs = prvNowNs();
+
+        if( IotNetworkAfr_Create( &xServerInfo, &xCredentials, &pxConnection->pvConnection ) != IOT_NETWORK_SUCCESS )
+        {
+            fprintf( stderr, "Connection %u could not be opened.\n", ulIndex );
+            iResult = 1;
+        }
+        else
+        {
+            pxRun->pullConnectNs[ pxRun->ulConnects++ ] = prvNowNs() - ullStartNs;
+            pxConnection->iServerSocket = accept( iListenSocket, NULL, NULL );
+
+            if( pxConnection->iServerSocket < 0 )
+            {
+                fprintf( stderr, "Connection %u was not accepted.\n", ulIndex );
+                iResult = 1;
+            }
+        }
+    }
+
+    return iResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvCompareLatency( const void * pvA,
+                              const void * pvB )
+{
+    uint64_t ullA = *( const uint64_t * ) pvA;
+    uint64_t ullB = *( const uint64_t * ) pvB;
+
+    return ( ullA > ullB ) - ( ullA < ullB );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Sorts the durations and returns their mean and 99th percentile in microseconds. */
+
+static void prvSummarize( uint64_t * pullDurationsNs,
+                          uint32_t ulCount,
+                          double * pdMeanUs,
+                          double * pdP99Us )
+{
+    uint64_t ullTotalNs = 0;
+    uint32_t ulIndex;
+
+    *pdMeanUs = 0.0;
+    *pdP99Us = 0.0;
+
+    if( ulCount > 0U )
+    {
+        qsort( pullDurationsNs, ulCount, sizeof( uint64_t ), prvCompareLatency );
+
+        for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+        {
+            ullTotalNs += pullDurationsNs[ ulIndex ];
+        }
+
+        *pdMeanUs = ( double ) ullTotalNs / 1000.0 / ulCount;
+        *pdP99Us = ( double ) pullDurationsNs[ ( ( ulCount * 99U ) - 1U ) / 100U ] / 1000.0;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintRow( const BenchRun_t * pxRun,
+                         uint32_t ulNumConnections )
+{
+    double dMeanUs;
+    double dP99Us;
+
+    prvSummarize( pxRun->pullLatencyNs, pxRun->ulMessages, &dMeanUs, &dP99Us );
+
+    printf( "%-20s %5s %5s %9s %9s %9s %9s %9s %9s\n",
+            "callbacks", "conns", "tasks", "stack", "heap", "peak", "leaked", "mean_us", "p99_us" );
+    printf( "%-20s %5u %5u %9zu %9zu %9zu %9zu %9.1f %9.1f\n",
+            ( IOT_NETWORK_RECEIVE_DISPATCHER == 1 ) ? "dispatcher" : "task per connection",
+            ulNumConnections,
+            ( uint32_t ) ( pxRun->xOpen.uxTasks - pxRun->xBaseline.uxTasks ),
+            pxRun->xOpen.xStackBytes - pxRun->xBaseline.xStackBytes,
+            pxRun->xOpen.xHeapBytes - pxRun->xBaseline.xHeapBytes,
+            pxRun->xOpen.xPeakHeapBytes - pxRun->xBaseline.xHeapBytes,
+            pxRun->xClosed.xHeapBytes - pxRun->xBaseline.xHeapBytes,
+            dMeanUs,
+            dP99Us );
+    ( void ) fflush( stdout );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintConnectRow( const BenchRun_t * pxRun,
+                                uint32_t ulNumConnections )
+{
+    double dMeanUs;
+    double dP99Us;
+
+    prvSummarize( pxRun->pullConnectNs, pxRun->ulConnects, &dMeanUs, &dP99Us );
+
+    printf( "%-20s %5s %7s %7s %9s %9s\n",
+            "credentials", "conns", "dns_ms", "cred_ms", "mean_us", "p99_us" );
+    printf( "%-20s %5u %7u %7u %9.1f %9.1f\n",
+            ( IOT_NETWORK_TLS_PREPARE == 1 ) ? "prepared" : "in handshake",
+            ulNumConnections,
+            ulDnsDelayMs,
+            ulCredentialDelayMs,
+            dMeanUs,
+            dP99Us );
+    ( void ) fflush( stdout );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    uint32_t ulNumConnections = BENCH_DEFAULT_CONNECTIONS;
+    uint32_t ulNumMessages = BENCH_DEFAULT_MESSAGES;
+    size_t xMessageSize = BENCH_DEFAULT_MESSAGE_SIZE;
+    BenchConnection_t * pxConnections = NULL;
+    BenchRun_t xRun = { 0 };
+    struct sockaddr_in xAddress = { 0 };
+    socklen_t xAddressLength = sizeof( xAddress );
+    uint32_t ulIndex;
+    uint32_t ulDnsMs = BENCH_DEFAULT_DNS_MS;
+    uint32_t ulCredentialMs = BENCH_DEFAULT_CREDENTIAL_MS;
+    int iConnect = 0;
+    int iOption;
+    int iResult = 0;
+
+    while( ( iOption = getopt( argc, argv, "c:m:s:td:k:" ) ) != -1 )
+    {
+        switch( iOption )
+        {
+            case 'c':
+                ulNumConnections = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'm':
+                ulNumMessages = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 's':
+                xMessageSize = ( size_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 't':
+                iConnect = 1;
+                break;
+
+            case 'd':
+                ulDnsMs = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'k':
+                ulCredentialMs = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            default:
+                iResult = 1;
+                break;
+        }
+    }
+
+    if( ( iResult != 0 ) || ( ulNumConnections == 0U ) || ( ulNumConnections > BENCH_MAX_CONNECTIONS ) ||
+        ( ulNumMessages == 0U ) || ( xMessageSize == 0U ) || ( xMessageSize > BENCH_MAX_MESSAGE_SIZE ) )
+    {
+        fprintf( stderr, "usage: %s [-c connections] [-m messages] [-s message_bytes]\n"
+                         "       [-t [-d dns_ms] [-k credential_ms]]\n"
+                         "       at most %u connections and %u byte messages\n",
+                 argv[ 0 ], BENCH_MAX_CONNECTIONS, BENCH_MAX_MESSAGE_SIZE );
+        iResult = 1;
+    }
+
+    if( iResult == 0 )
+    {
+        pxConnections = calloc( ulNumConnections, sizeof( BenchConnection_t ) );
+        xRun.pullLatencyNs = calloc( ulNumMessages, sizeof( uint64_t ) );
+        xRun.pullConnectNs = calloc( ulNumConnections, sizeof( uint64_t ) );
+
+        if( ( pxConnections == NULL ) || ( xRun.pullLatencyNs == NULL ) || ( xRun.pullConnectNs == NULL ) )
+        {
+            fprintf( stderr, "Out of memory.\n" );
+            iResult = 1;
+        }
+        else
+        {
+            for( ulIndex = 0; ulIndex < ulNumConnections; ulIndex++ )
+            {
+                pxConnections[ ulIndex ].iServerSocket = -1;
+            }
+        }
+    }
+
+    if( iResult == 0 )
+    {
+        /* Listen on an ephemeral loopback port, with room for every connection. */
+        xAddress.sin_family = AF_INET;
+        xAddress.sin_addr.s_addr = inet_addr( BENCH_HOST );
+        iListenSocket = socket( AF_INET, SOCK_STREAM, 0 );
+
+        if( ( iListenSocket < 0 ) ||
+            ( bind( iListenSocket, ( struct sockaddr * ) &xAddress, sizeof( xAddress ) ) != 0 ) ||
+            ( listen( iListenSocket, ( int ) ulNumConnections ) != 0 ) ||
+            ( getsockname( iListenSocket, ( struct sockaddr * ) &xAddress, &xAddressLength ) != 0 ) ||
+            ( SOCKETS_Init() != pdPASS ) )
+        {
+            fprintf( stderr, "The loopback server could not be started.\n" );
+            iResult = 1;
+        }
+        else
+        {
+            usListenPort = ntohs( xAddress.sin_port );
+        }
+    }
+
+    if( ( iResult == 0 ) && ( iConnect == 1 ) )
+    {
+        /* Only the connections are timed, the receive run is left out. */
+        ulDnsDelayMs = ulDnsMs;
+        ulCredentialDelayMs = ulCredentialMs;
+
+        iResult = prvMeasureConnect( pxConnections, ulNumConnections, &xRun );
+        prvClose( pxConnections, ulNumConnections );
+
+        if( iResult == 0 )
+        {
+            prvPrintConnectRow( &xRun, ulNumConnections );
+        }
+    }
+    else if( iResult == 0 )
+    {
+        vBenchKernelGetUsage( &xRun.xBaseline );
+        vBenchKernelResetPeak();
+
+        iResult = prvOpen( pxConnections, ulNumConnections, xMessageSize );
+
+        if( iResult == 0 )
+        {
+            vBenchKernelGetUsage( &xRun.xOpen );
+            iResult = prvMeasure( pxConnections, ulNumConnections, ulNumMessages, &xRun );
+        }
+
+        prvClose( pxConnections, ulNumConnections );
+
+        /* The dispatcher task stays when its last connection is destroyed. */
+        vBenchKernelGetUsage( &xRun.xClosed );
+
+        if( iResult == 0 )
+        {
+            prvPrintRow( &xRun, ulNumConnections );
+        }
+    }
+
+    if( iListenSocket >= 0 )
+    {
+        ( void ) close( iListenSocket );
+    }
+
+    free( pxConnections );
+    free( xRun.pullLatencyNs );
+    free( xRun.pullConnectNs );
+
+    return iResult;
+}
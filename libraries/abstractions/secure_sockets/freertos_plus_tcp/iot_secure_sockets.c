@@ -40,6 +40,10 @@
 #include "iot_pkcs11.h"
 #include "iot_crypto.h"
 
+/* mbedTLS includes. */
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+
 #undef _SECURE_SOCKETS_WRAPPER_NOT_REDEFINE
 
 /* Internal context structure. */
@@ -56,8 +60,26 @@ typedef struct SSOCKETContext
     char ** ppcAlpnProtocols;
     uint32_t ulAlpnProtocolsCount;
     BaseType_t xConnectAttempted;
+    BaseType_t xDisableSessionCache;
+    BaseType_t xNonBlocking;
+    SocketsReadyCallback_t pxReadyCallback;
+    void * pvReadyContext;
+    uint32_t ulReadyEvents;
+    volatile BaseType_t xReadyBusy;    /* In use by the ready task. */
+    BaseType_t xReadyClosed;           /* Closed while in use by the ready task, which frees it. */
+    volatile BaseType_t xTLSPreparing; /* The TLS credentials are being loaded by a task of their own. */
+    uint8_t * pucSendvBuffer;          /* Staging buffer of SOCKETS_Sendv(), allocated on first use. */
 } SSOCKETContext_t, * SSOCKETContextPtr_t;
 
+#if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+
+/* Sockets with a ready callback, all served by one task. */
+    static SSOCKETContextPtr_t pxReadySockets[ socketsconfigREADY_CALLBACK_MAX_SOCKETS ];
+    static size_t xReadyCount = 0;
+    static BaseType_t xReadyTaskStarted = pdFALSE;
+    static TaskHandle_t xReadyTask = NULL;
+#endif
+
 /*
  * Helper routines.
  */
@@ -70,8 +92,16 @@ static BaseType_t prvNetworkSend( void * pvContext,
                                   size_t xDataLength )
 {
     SSOCKETContextPtr_t pxContext = ( SSOCKETContextPtr_t ) pvContext; /*lint !e9087 cast used for portability. */
+    BaseType_t xResult = FreeRTOS_send( pxContext->xSocket, pucData, xDataLength, pxContext->xSendFlags );
 
-    return FreeRTOS_send( pxContext->xSocket, pucData, xDataLength, pxContext->xSendFlags );
+    /* A non-blocking socket has no room in its stream buffer. */
+    if( ( pdTRUE == pxContext->xNonBlocking ) && ( xDataLength > 0U ) &&
+        ( ( 0 == xResult ) || ( -pdFREERTOS_ERRNO_ENOSPC == xResult ) ) )
+    {
+        xResult = SOCKETS_EWOULDBLOCK;
+    }
+
+    return xResult;
 }
 /*-----------------------------------------------------------*/
 
@@ -83,8 +113,353 @@ static BaseType_t prvNetworkRecv( void * pvContext,
                                   size_t xReceiveLength )
 {
     SSOCKETContextPtr_t pxContext = ( SSOCKETContextPtr_t ) pvContext; /*lint !e9087 cast used for portability. */
+    BaseType_t xResult = FreeRTOS_recv( pxContext->xSocket, pucReceiveBuffer, xReceiveLength, pxContext->xRecvFlags );
+
+    /* A non-blocking socket has no data. TLS keeps a partial record for later
+     * instead of treating this as the end of the connection. */
+    if( ( pdTRUE == pxContext->xNonBlocking ) && ( xReceiveLength > 0U ) && ( 0 == xResult ) )
+    {
+        xResult = SOCKETS_EWOULDBLOCK;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Send a gather list, through the TLS pipe if negotiated.
+ *
+ * On TLS sockets the data is gathered into a staging buffer, so that each fill
+ * of the buffer becomes one TLS record. Parts of the data that are at least as
+ * large as the buffer are sent without copying when nothing is gathered yet.
+ * The staging buffer belongs to the socket, which allocates it on first use,
+ * and a single buffer is always sent as it is. Unencrypted data goes straight
+ * into the TCP stream buffer, which coalesces it anyway.
+ */
+static int32_t prvSendv( SSOCKETContextPtr_t pxContext,
+                         const SocketsIoVector_t * pxVectors,
+                         size_t xVectorCount )
+{
+    int32_t lStatus = 0;
+    int32_t lSent = 0;
+    size_t xTotalLength = 0;
+    size_t xStagingSize = 0;
+    size_t xStaged = 0;
+    size_t xVector = 0;
+    size_t xOffset = 0;
+    size_t xLength = 0;
+    size_t xSendLength = 0;
+    const uint8_t * pucData = NULL;
+    const uint8_t * pucSend = NULL;
+    uint8_t * pucStaging = NULL;
+    BaseType_t xDone = pdFALSE;
+
+    if( ( pdTRUE == pxContext->xRequireTLS ) && ( xVectorCount > 1U ) )
+    {
+        for( xVector = 0; xVector < xVectorCount; xVector++ )
+        {
+            xTotalLength += pxVectors[ xVector ].xLength;
+        }
+
+        xStagingSize = ( xTotalLength < socketsconfigSENDV_BUFFER_SIZE ) ?
+                       xTotalLength : socketsconfigSENDV_BUFFER_SIZE;
+
+        if( ( xStagingSize > 0U ) && ( NULL == pxContext->pucSendvBuffer ) )
+        {
+            pxContext->pucSendvBuffer = ( uint8_t * ) pvPortMalloc( socketsconfigSENDV_BUFFER_SIZE );
+        }
+
+        pucStaging = pxContext->pucSendvBuffer;
+
+        /* Without a staging buffer, every buffer is sent as it is. */
+        if( NULL == pucStaging )
+        {
+            xStagingSize = 0;
+        }
+    }
+
+    xVector = 0;
+
+    while( ( pdFALSE == xDone ) && ( xVector < xVectorCount ) )
+    {
+        pucData = ( const uint8_t * ) pxVectors[ xVector ].pvBuffer + xOffset;
+        xLength = pxVectors[ xVector ].xLength - xOffset;
+        pucSend = NULL;
+
+        if( ( 0U == xStaged ) && ( xLength >= xStagingSize ) )
+        {
+            pucSend = pucData;
+            xSendLength = xLength;
+        }
+        else
+        {
+            if( xLength > ( xStagingSize - xStaged ) )
+            {
+                xLength = xStagingSize - xStaged;
+            }
+
+            memcpy( &pucStaging[ xStaged ], pucData, xLength );
+            xStaged += xLength;
+        }
+
+        xOffset += xLength;
+
+        if( xOffset == pxVectors[ xVector ].xLength )
+        {
+            xVector++;
+            xOffset = 0;
+        }
+
+        /* Send the staging buffer once it is full or the data ends. */
+        if( ( xStaged > 0U ) && ( ( xStaged == xStagingSize ) || ( xVector == xVectorCount ) ) )
+        {
+            pucSend = pucStaging;
+            xSendLength = xStaged;
+            xStaged = 0;
+        }
 
-    return FreeRTOS_recv( pxContext->xSocket, pucReceiveBuffer, xReceiveLength, pxContext->xRecvFlags );
+        if( NULL != pucSend )
+        {
+            if( pdTRUE == pxContext->xRequireTLS )
+            {
+                lStatus = TLS_Send( pxContext->pvTLSContext, pucSend, xSendLength );
+            }
+            else
+            {
+                lStatus = prvNetworkSend( pxContext, pucSend, xSendLength );
+            }
+
+            if( lStatus > 0 )
+            {
+                lSent += lStatus;
+            }
+
+            /* Stop at an error, or when a send timed out or would block. */
+            if( lStatus != ( int32_t ) xSendLength )
+            {
+                xDone = pdTRUE;
+            }
+        }
+    }
+
+    /* Only report an error if no data was sent. */
+    if( ( lStatus >= 0 ) || ( lSent > 0 ) )
+    {
+        lStatus = lSent;
+    }
+
+    return lStatus;
+}
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+
+/*
+ * @brief Stop the ready callback of a socket.
+ *
+ * Waits until the ready task no longer uses the socket, unless it is called
+ * from a callback.
+ */
+    static void prvReadyClear( SSOCKETContextPtr_t pxContext )
+    {
+        size_t xIndex = 0;
+
+        taskENTER_CRITICAL();
+
+        for( xIndex = 0; xIndex < xReadyCount; xIndex++ )
+        {
+            if( pxReadySockets[ xIndex ] == pxContext )
+            {
+                xReadyCount--;
+                pxReadySockets[ xIndex ] = pxReadySockets[ xReadyCount ];
+                break;
+            }
+        }
+
+        pxContext->pxReadyCallback = NULL;
+        taskEXIT_CRITICAL();
+
+        if( xTaskGetCurrentTaskHandle() != xReadyTask )
+        {
+            while( pdTRUE == pxContext->xReadyBusy )
+            {
+                vTaskDelay( 1 );
+            }
+        }
+    }
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Wait on the sockets with a ready callback and call the callbacks.
+ */
+    static void prvReadyTask( void * pvParameters )
+    {
+        SocketsPollFd_t xFds[ socketsconfigREADY_CALLBACK_MAX_SOCKETS ];
+        SSOCKETContextPtr_t pxContext = NULL;
+        SocketsReadyCallback_t pxCallback = NULL;
+        void * pvCallbackContext = NULL;
+        size_t xCount = 0;
+        size_t xFd = 0;
+        int32_t lStatus = 0;
+
+        ( void ) pvParameters;
+
+        for( ; ; )
+        {
+            /* Sockets marked busy are not freed by SOCKETS_Close() in other tasks. */
+            taskENTER_CRITICAL();
+            xCount = xReadyCount;
+
+            for( xFd = 0; xFd < xCount; xFd++ )
+            {
+                pxContext = pxReadySockets[ xFd ];
+                pxContext->xReadyBusy = pdTRUE;
+                xFds[ xFd ].xSocket = ( Socket_t ) pxContext;
+                xFds[ xFd ].ulEvents = pxContext->ulReadyEvents;
+            }
+
+            taskEXIT_CRITICAL();
+
+            if( 0U == xCount )
+            {
+                ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+            }
+            else
+            {
+                lStatus = SOCKETS_Poll( xFds, xCount, pdMS_TO_TICKS( socketsconfigREADY_CALLBACK_POLL_MS ) );
+
+                for( xFd = 0; xFd < xCount; xFd++ )
+                {
+                    pxContext = ( SSOCKETContextPtr_t ) xFds[ xFd ].xSocket; /*lint !e9087 cast used for portability. */
+
+                    taskENTER_CRITICAL();
+                    pxCallback = pxContext->pxReadyCallback;
+                    pvCallbackContext = pxContext->pvReadyContext;
+                    taskEXIT_CRITICAL();
+
+                    if( ( lStatus > 0 ) && ( 0U != xFds[ xFd ].ulREvents ) && ( NULL != pxCallback ) )
+                    {
+                        /* A hang up does not go away, so it is reported once. */
+                        if( 0U != ( xFds[ xFd ].ulREvents & SOCKETS_POLLHUP ) )
+                        {
+                            prvReadyClear( pxContext );
+                        }
+
+                        pxCallback( ( Socket_t ) pxContext, xFds[ xFd ].ulREvents, pvCallbackContext );
+                    }
+
+                    if( pdTRUE == pxContext->xReadyClosed )
+                    {
+                        vPortFree( pxContext );
+                    }
+                    else
+                    {
+                        pxContext->xReadyBusy = pdFALSE;
+                    }
+                }
+
+                if( lStatus < 0 )
+                {
+                    vTaskDelay( pdMS_TO_TICKS( socketsconfigREADY_CALLBACK_POLL_MS ) );
+                }
+            }
+        }
+    }
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Set the ready callback of a socket, starting the ready task if needed.
+ */
+    static int32_t prvReadySet( SSOCKETContextPtr_t pxContext,
+                                const SocketsReadyNotification_t * pxNotification )
+    {
+        int32_t lStatus = SOCKETS_ERROR_NONE;
+        BaseType_t xStart = pdFALSE;
+        BaseType_t xListed = pdFALSE;
+        size_t xIndex = 0;
+
+        taskENTER_CRITICAL();
+
+        if( pdFALSE == xReadyTaskStarted )
+        {
+            xReadyTaskStarted = pdTRUE;
+            xStart = pdTRUE;
+        }
+
+        taskEXIT_CRITICAL();
+
+        if( pdTRUE == xStart )
+        {
+            if( pdPASS != xTaskCreate( prvReadyTask,
+                                       "SockRdy",
+                                       socketsconfigREADY_CALLBACK_TASK_STACK_DEPTH,
+                                       NULL,
+                                       socketsconfigREADY_CALLBACK_TASK_PRIORITY,
+                                       &xReadyTask ) )
+            {
+                xReadyTaskStarted = pdFALSE;
+                lStatus = SOCKETS_ENOMEM;
+            }
+        }
+
+        if( SOCKETS_ERROR_NONE == lStatus )
+        {
+            taskENTER_CRITICAL();
+
+            for( xIndex = 0; xIndex < xReadyCount; xIndex++ )
+            {
+                if( pxReadySockets[ xIndex ] == pxContext )
+                {
+                    xListed = pdTRUE;
+                    break;
+                }
+            }
+
+            if( ( pdFALSE == xListed ) && ( socketsconfigREADY_CALLBACK_MAX_SOCKETS == xReadyCount ) )
+            {
+                lStatus = SOCKETS_ENOMEM;
+            }
+            else
+            {
+                pxContext->pxReadyCallback = pxNotification->pxCallback;
+                pxContext->pvReadyContext = pxNotification->pvContext;
+                pxContext->ulReadyEvents = pxNotification->ulEvents;
+
+                if( pdFALSE == xListed )
+                {
+                    pxReadySockets[ xReadyCount ] = pxContext;
+                    xReadyCount++;
+                }
+            }
+
+            taskEXIT_CRITICAL();
+        }
+
+        /* Wake the ready task if it has nothing to wait on. */
+        if( ( SOCKETS_ERROR_NONE == lStatus ) && ( NULL != xReadyTask ) )
+        {
+            ( void ) xTaskNotifyGive( xReadyTask );
+        }
+
+        return lStatus;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 ) */
+
+/*
+ * @brief Load the TLS credentials of a socket, then end.
+ *
+ * An error is not reported here, the handshake fails with the same error.
+ */
+static void prvTLSPrepareTask( void * pvParameters )
+{
+    SSOCKETContextPtr_t pxContext = ( SSOCKETContextPtr_t ) pvParameters; /*lint !e9087 cast used for portability. */
+
+    ( void ) TLS_Prepare( pxContext->pcServerCertificate, pxContext->ulServerCertificateLength );
+
+    pxContext->xTLSPreparing = pdFALSE;
+    vTaskDelete( NULL );
 }
 /*-----------------------------------------------------------*/
 
@@ -100,6 +475,18 @@ int32_t SOCKETS_Close( Socket_t xSocket )
 
     if( ( xSocket != SOCKETS_INVALID_SOCKET ) && ( NULL != pxContext ) )
     {
+        /* The task loading the TLS credentials reads the server certificate. */
+        while( pdTRUE == pxContext->xTLSPreparing )
+        {
+            vTaskDelay( 1 );
+        }
+
+        /* The ready task polls the socket and its callback may receive on it,
+         * so it must be done with the socket before anything is freed. */
+        #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+            prvReadyClear( pxContext );
+        #endif
+
         /* Clean-up destination string. */
         if( NULL != pxContext->pcDestination )
         {
@@ -128,6 +515,12 @@ int32_t SOCKETS_Close( Socket_t xSocket )
             vPortFree( pxContext->ppcAlpnProtocols );
         }
 
+        /* Clean-up the SOCKETS_Sendv() staging buffer. */
+        if( NULL != pxContext->pucSendvBuffer )
+        {
+            vPortFree( pxContext->pucSendvBuffer );
+        }
+
         /* Clean-up TLS context. */
         if( pdTRUE == pxContext->xRequireTLS )
         {
@@ -137,8 +530,18 @@ int32_t SOCKETS_Close( Socket_t xSocket )
         /* Close the underlying socket handle. */
         ( void ) FreeRTOS_closesocket( pxContext->xSocket );
 
+        /* A ready callback may close a socket that the ready task is still
+         * going through. The task frees the context when it is done. */
+        #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+            pxContext->xReadyClosed = pxContext->xReadyBusy;
+        #endif
+
         /* Free the context. */
-        vPortFree( pxContext );
+        if( pdTRUE != pxContext->xReadyClosed )
+        {
+            vPortFree( pxContext );
+        }
+
         lReturn = SOCKETS_ERROR_NONE;
     }
     else
@@ -177,10 +580,12 @@ int32_t SOCKETS_Connect( Socket_t xSocket,
         {
             xTLSParams.ulSize = sizeof( xTLSParams );
             xTLSParams.pcDestination = pxContext->pcDestination;
+            xTLSParams.usPort = pxAddress->usPort;
             xTLSParams.pcServerCertificate = pxContext->pcServerCertificate;
             xTLSParams.ulServerCertificateLength = pxContext->ulServerCertificateLength;
             xTLSParams.ppcAlpnProtocols = ( const char ** ) pxContext->ppcAlpnProtocols;
             xTLSParams.ulAlpnProtocolsCount = pxContext->ulAlpnProtocolsCount;
+            xTLSParams.xDisableSessionCache = pxContext->xDisableSessionCache;
             xTLSParams.pvCallerContext = pxContext;
             xTLSParams.pxNetworkRecv = prvNetworkRecv;
             xTLSParams.pxNetworkSend = prvNetworkSend;
@@ -278,6 +683,43 @@ int32_t SOCKETS_Send( Socket_t xSocket,
 }
 /*-----------------------------------------------------------*/
 
+int32_t SOCKETS_Sendv( Socket_t xSocket,
+                       const SocketsIoVector_t * pxVectors,
+                       size_t xVectorCount,
+                       uint32_t ulFlags )
+{
+    int32_t lStatus = SOCKETS_SOCKET_ERROR;
+    SSOCKETContextPtr_t pxContext = ( SSOCKETContextPtr_t ) xSocket; /*lint !e9087 cast used for portability. */
+    size_t xVector = 0;
+
+    if( ( xSocket != SOCKETS_INVALID_SOCKET ) &&
+        ( ( pxVectors != NULL ) || ( 0U == xVectorCount ) ) )
+    {
+        lStatus = SOCKETS_ERROR_NONE;
+
+        for( xVector = 0; xVector < xVectorCount; xVector++ )
+        {
+            if( NULL == pxVectors[ xVector ].pvBuffer )
+            {
+                lStatus = SOCKETS_EINVAL;
+            }
+        }
+    }
+    else
+    {
+        lStatus = SOCKETS_EINVAL;
+    }
+
+    if( SOCKETS_ERROR_NONE == lStatus )
+    {
+        pxContext->xSendFlags = ( BaseType_t ) ulFlags;
+        lStatus = prvSendv( pxContext, pxVectors, xVectorCount );
+    }
+
+    return lStatus;
+}
+/*-----------------------------------------------------------*/
+
 int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
                             int32_t lLevel,
                             int32_t lOptionName,
@@ -355,6 +797,39 @@ int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
 
                 break;
 
+            case SOCKETS_SO_TLS_PREPARE:
+
+                /* The credentials are loaded for the handshake in SOCKETS_Connect(). */
+                if( pxContext->xConnectAttempted == pdTRUE )
+                {
+                    lStatus = SOCKETS_EISCONN;
+                }
+                else if( pdTRUE != pxContext->xRequireTLS )
+                {
+                    lStatus = SOCKETS_EINVAL;
+                }
+                else if( pdFALSE == pxContext->xTLSPreparing )
+                {
+                    pxContext->xTLSPreparing = pdTRUE;
+
+                    if( pdPASS != xTaskCreate( prvTLSPrepareTask,
+                                               "SockTLS",
+                                               socketsconfigTLS_PREPARE_TASK_STACK_DEPTH,
+                                               pxContext,
+                                               socketsconfigTLS_PREPARE_TASK_PRIORITY,
+                                               NULL ) )
+                    {
+                        pxContext->xTLSPreparing = pdFALSE;
+                        lStatus = SOCKETS_ENOMEM;
+                    }
+                }
+                else
+                {
+                    /* Already being loaded. */
+                }
+
+                break;
+
             case SOCKETS_SO_ALPN_PROTOCOLS:
 
                 /* Do not set the ALPN option if the socket is already connected. */
@@ -404,6 +879,28 @@ int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
 
                 break;
 
+            case SOCKETS_SO_TLS_SESSION_CACHE:
+
+                /* Do not change session resumption if the socket is possibly already connected. */
+                if( pxContext->xConnectAttempted == pdTRUE )
+                {
+                    lStatus = SOCKETS_EISCONN;
+                }
+                else if( ( NULL == pvOptionValue ) || ( sizeof( BaseType_t ) != xOptionLength ) )
+                {
+                    lStatus = SOCKETS_EINVAL;
+                }
+                else if( pdFALSE == *( ( const BaseType_t * ) pvOptionValue ) )
+                {
+                    pxContext->xDisableSessionCache = pdTRUE;
+                }
+                else
+                {
+                    pxContext->xDisableSessionCache = pdFALSE;
+                }
+
+                break;
+
             case SOCKETS_SO_NONBLOCK:
                 xTimeout = 0;
 
@@ -425,6 +922,11 @@ int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
                                                        &xTimeout,
                                                        sizeof( xTimeout ) );
                     }
+
+                    if( lStatus == SOCKETS_ERROR_NONE )
+                    {
+                        pxContext->xNonBlocking = pdTRUE;
+                    }
                 }
                 else
                 {
@@ -433,6 +935,31 @@ int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
 
                 break;
 
+            case SOCKETS_SO_READY_CALLBACK:
+                #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+                    if( ( NULL == pvOptionValue ) ||
+                        ( NULL == ( ( const SocketsReadyNotification_t * ) pvOptionValue )->pxCallback ) )
+                    {
+                        prvReadyClear( pxContext );
+                    }
+                    else if( sizeof( SocketsReadyNotification_t ) != xOptionLength )
+                    {
+                        lStatus = SOCKETS_EINVAL;
+                    }
+                    else if( pdTRUE != pxContext->xConnectAttempted )
+                    {
+                        lStatus = SOCKETS_ENOTCONN;
+                    }
+                    else
+                    {
+                        lStatus = prvReadySet( pxContext, ( const SocketsReadyNotification_t * ) pvOptionValue );
+                    }
+                #else
+                    /* The ready task waits on the sockets with select(). */
+                    lStatus = SOCKETS_ENOPROTOOPT;
+                #endif /* if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 ) */
+                break;
+
             case SOCKETS_SO_RCVTIMEO:
             case SOCKETS_SO_SNDTIMEO:
                 /* Comply with Berkeley standard - a 0 timeout is wait forever. */
@@ -468,6 +995,121 @@ int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
 }
 /*-----------------------------------------------------------*/
 
+int32_t SOCKETS_Poll( SocketsPollFd_t * pxFds,
+                      size_t xFdCount,
+                      TickType_t xTimeout )
+{
+    int32_t lStatus = SOCKETS_ERROR_NONE;
+
+    #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+        SSOCKETContextPtr_t pxContext = NULL;
+        SocketSet_t xSocketSet = NULL;
+        EventBits_t xSocketBits = 0;
+        size_t xFd = 0;
+
+        if( ( NULL == pxFds ) && ( 0U != xFdCount ) )
+        {
+            lStatus = SOCKETS_EINVAL;
+        }
+
+        for( xFd = 0; ( xFd < xFdCount ) && ( SOCKETS_ERROR_NONE == lStatus ); xFd++ )
+        {
+            if( ( pxFds[ xFd ].xSocket == SOCKETS_INVALID_SOCKET ) || ( pxFds[ xFd ].xSocket == NULL ) )
+            {
+                lStatus = SOCKETS_EINVAL;
+            }
+        }
+
+        if( SOCKETS_ERROR_NONE == lStatus )
+        {
+            xSocketSet = FreeRTOS_CreateSocketSet();
+
+            if( NULL == xSocketSet )
+            {
+                lStatus = SOCKETS_ENOMEM;
+            }
+        }
+
+        if( SOCKETS_ERROR_NONE == lStatus )
+        {
+            for( xFd = 0; xFd < xFdCount; xFd++ )
+            {
+                pxContext = ( SSOCKETContextPtr_t ) pxFds[ xFd ].xSocket; /*lint !e9087 cast used for portability. */
+                pxFds[ xFd ].ulREvents = 0;
+
+                /* Records already taken from the TCP stream are readable
+                 * without new data arriving, so don't block for them. */
+                if( ( 0U != ( pxFds[ xFd ].ulEvents & SOCKETS_POLLIN ) ) &&
+                    ( pdTRUE == pxContext->xRequireTLS ) &&
+                    ( pdTRUE == TLS_Pending( pxContext->pvTLSContext ) ) )
+                {
+                    pxFds[ xFd ].ulREvents = SOCKETS_POLLIN;
+                    xTimeout = 0;
+                }
+
+                /* A socket waiting only to send must not be woken by unread data. */
+                xSocketBits = eSELECT_EXCEPT;
+
+                if( ( 0U != ( pxFds[ xFd ].ulEvents & SOCKETS_POLLIN ) ) ||
+                    ( 0U == ( pxFds[ xFd ].ulEvents & SOCKETS_POLLOUT ) ) )
+                {
+                    xSocketBits |= eSELECT_READ;
+                }
+
+                if( 0U != ( pxFds[ xFd ].ulEvents & SOCKETS_POLLOUT ) )
+                {
+                    xSocketBits |= eSELECT_WRITE;
+                }
+
+                FreeRTOS_FD_SET( pxContext->xSocket, xSocketSet, xSocketBits );
+            }
+
+            ( void ) FreeRTOS_select( xSocketSet, xTimeout );
+
+            for( xFd = 0; xFd < xFdCount; xFd++ )
+            {
+                pxContext = ( SSOCKETContextPtr_t ) pxFds[ xFd ].xSocket; /*lint !e9087 cast used for portability. */
+                xSocketBits = FreeRTOS_FD_ISSET( pxContext->xSocket, xSocketSet );
+
+                if( 0U != ( xSocketBits & eSELECT_READ ) )
+                {
+                    pxFds[ xFd ].ulREvents |= ( pxFds[ xFd ].ulEvents & SOCKETS_POLLIN );
+                }
+
+                if( 0U != ( xSocketBits & eSELECT_WRITE ) )
+                {
+                    pxFds[ xFd ].ulREvents |= ( pxFds[ xFd ].ulEvents & SOCKETS_POLLOUT );
+                }
+
+                if( 0U != ( xSocketBits & eSELECT_EXCEPT ) )
+                {
+                    pxFds[ xFd ].ulREvents |= SOCKETS_POLLHUP;
+                }
+
+                if( 0U != pxFds[ xFd ].ulREvents )
+                {
+                    lStatus++;
+                }
+
+                /* A socket can only be in one set, so take it out again. */
+                FreeRTOS_FD_CLR( pxContext->xSocket, xSocketSet, eSELECT_ALL );
+            }
+
+            FreeRTOS_DeleteSocketSet( xSocketSet );
+        }
+    #else /* if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 ) */
+        ( void ) pxFds;
+        ( void ) xFdCount;
+        ( void ) xTimeout;
+
+        /* FreeRTOS+TCP cannot wait on several sockets without select(). */
+        lStatus = SOCKETS_ENOPROTOOPT;
+    #endif /* if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 ) */
+
+    return lStatus;
+}
+/*-----------------------------------------------------------*/
+
 int32_t SOCKETS_Shutdown( Socket_t xSocket,
                           uint32_t ulHow )
 {
@@ -632,6 +1274,137 @@ static CK_RV prvSocketsGetCryptoSession( SemaphoreHandle_t * pxSessionLock,
 }
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief DRBG entropy callback, reading a batch of random bytes from the
+ * shared PKCS #11 session.
+ */
+static int prvRandomPoolEntropy( void * pvContext,
+                                 unsigned char * pucOutput,
+                                 size_t xOutputLength )
+{
+    CK_RV xResult = CKR_OK;
+    SemaphoreHandle_t xSessionLock = NULL;
+    CK_SESSION_HANDLE xPkcs11Session = 0;
+    CK_FUNCTION_LIST_PTR pxPkcs11FunctionList = NULL;
+    int lReturn = MBEDTLS_ERR_ENTROPY_SOURCE_FAILED;
+
+    ( void ) pvContext;
+
+    xResult = prvSocketsGetCryptoSession( &xSessionLock,
+                                          &xPkcs11Session,
+                                          &pxPkcs11FunctionList );
+
+    if( CKR_OK == xResult )
+    {
+        xSemaphoreTake( xSessionLock, portMAX_DELAY );
+        xResult = pxPkcs11FunctionList->C_GenerateRandom( xPkcs11Session,
+                                                          pucOutput,
+                                                          xOutputLength );
+        xSemaphoreGive( xSessionLock );
+    }
+
+    if( CKR_OK == xResult )
+    {
+        lReturn = 0;
+    }
+
+    return lReturn;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Copy random bytes out of a pool generated ahead of time.
+ *
+ * The pool is refilled by a CTR_DRBG when it runs empty, and the DRBG only
+ * calls into PKCS #11 to seed and periodically reseed itself, so most
+ * requests neither lock the shared PKCS #11 session nor run the DRBG.
+ * Bytes are wiped from the pool as they are handed out.
+ *
+ * The IP task asks for random numbers, so it must not wait behind another
+ * task that is refilling the pool or reseeding the DRBG. When the pool is
+ * busy, the bytes are read directly from the PKCS #11 DRBG instead.
+ */
+static BaseType_t prvRandomPoolGet( uint8_t * pucBuffer,
+                                    size_t xBufferLength )
+{
+    static StaticSemaphore_t xStaticSemaphore;
+    static SemaphoreHandle_t xPoolLock = NULL;
+    static mbedtls_ctr_drbg_context xDrbgContext;
+    static BaseType_t xDrbgSeeded = pdFALSE;
+    static uint8_t ucPool[ socketsconfigRANDOM_POOL_SIZE ];
+    static size_t xPoolAvailable = 0;
+    size_t xCopyLength = 0;
+    int lResult = 0;
+
+    /* Check if one-time initialization of the lock is needed.*/
+    portENTER_CRITICAL();
+
+    if( NULL == xPoolLock )
+    {
+        xPoolLock = xSemaphoreCreateMutexStatic( &xStaticSemaphore );
+    }
+
+    portEXIT_CRITICAL();
+
+    if( pdTRUE == xSemaphoreTake( xPoolLock, 0 ) )
+    {
+        /* Seed on first use, and again after a failed attempt. */
+        if( pdFALSE == xDrbgSeeded )
+        {
+            mbedtls_ctr_drbg_init( &xDrbgContext );
+            lResult = mbedtls_ctr_drbg_seed( &xDrbgContext,
+                                             prvRandomPoolEntropy,
+                                             NULL,
+                                             NULL,
+                                             0 );
+
+            if( 0 == lResult )
+            {
+                xDrbgSeeded = pdTRUE;
+            }
+            else
+            {
+                mbedtls_ctr_drbg_free( &xDrbgContext );
+            }
+        }
+
+        while( ( 0 == lResult ) && ( xBufferLength > 0U ) )
+        {
+            if( 0U == xPoolAvailable )
+            {
+                lResult = mbedtls_ctr_drbg_random( &xDrbgContext, ucPool, sizeof( ucPool ) );
+
+                if( 0 == lResult )
+                {
+                    xPoolAvailable = sizeof( ucPool );
+                }
+            }
+
+            if( 0 == lResult )
+            {
+                xCopyLength = ( xBufferLength < xPoolAvailable ) ? xBufferLength : xPoolAvailable;
+                xPoolAvailable -= xCopyLength;
+
+                memcpy( pucBuffer, &ucPool[ xPoolAvailable ], xCopyLength );
+                memset( &ucPool[ xPoolAvailable ], 0, xCopyLength );
+
+                pucBuffer += xCopyLength;
+                xBufferLength -= xCopyLength;
+            }
+        }
+
+        xSemaphoreGive( xPoolLock );
+    }
+    else
+    {
+        /* Another task holds the pool. */
+        lResult = prvRandomPoolEntropy( NULL, pucBuffer, xBufferLength );
+    }
+
+    return ( 0 == lResult ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
 /*uint32_t ulRand( void ) __attribute__ ((deprecated)) */
 #if 0
 
@@ -661,35 +1434,19 @@ static CK_RV prvSocketsGetCryptoSession( SemaphoreHandle_t * pxSessionLock,
 
 BaseType_t xApplicationGetRandomNumber( uint32_t * pulNumber )
 {
-    CK_RV xResult = 0;
-    SemaphoreHandle_t xSessionLock = NULL;
-    CK_SESSION_HANDLE xPkcs11Session = 0;
-    CK_FUNCTION_LIST_PTR pxPkcs11FunctionList = NULL;
     uint32_t ulRandomValue = 0;
     BaseType_t xReturn; /* Return pdTRUE if successful */
 
-    xResult = prvSocketsGetCryptoSession( &xSessionLock,
-                                          &xPkcs11Session,
-                                          &pxPkcs11FunctionList );
-
-    if( 0 == xResult )
-    {
-        /* Request a sequence of cryptographically random byte values using
-         * PKCS#11. */
-        xResult = pxPkcs11FunctionList->C_GenerateRandom( xPkcs11Session,
-                                                          ( CK_BYTE_PTR ) &ulRandomValue,
-                                                          sizeof( ulRandomValue ) );
-    }
+    /* Take cryptographically random bytes from the pool. */
+    xReturn = prvRandomPoolGet( ( uint8_t * ) &ulRandomValue,
+                                sizeof( ulRandomValue ) );
 
-    /* Check if any of the API calls failed. */
-    if( 0 == xResult )
+    if( pdTRUE == xReturn )
     {
-        xReturn = pdTRUE;
         *( pulNumber ) = ulRandomValue;
     }
     else
     {
-        xReturn = pdFALSE;
         *( pulNumber ) = 0uL;
     }
 
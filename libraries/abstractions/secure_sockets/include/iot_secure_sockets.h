@@ -167,11 +167,14 @@ typedef struct xSOCKET * Socket_t; /**< @brief Socket handle data type. */
 #define SOCKETS_SO_REQUIRE_TLS                   ( 8 )  /**< Toggle client enforcement of TLS. */
 #define SOCKETS_SO_NONBLOCK                      ( 9 )  /**< Socket is nonblocking. */
 #define SOCKETS_SO_ALPN_PROTOCOLS                ( 10 ) /**< Application protocol list to be included in TLS ClientHello. */
+#define SOCKETS_SO_TLS_SESSION_CACHE             ( 11 ) /**< Toggle resumption of cached TLS sessions. */
 #define SOCKETS_SO_WAKEUP_CALLBACK               ( 17 ) /**< Set the callback to be called whenever there is data available on the socket for reading. */
 #define SOCKETS_SO_TCPKEEPALIVE                  ( 18 ) /**< Enable or Disable TCP keep-alive functionality. */
 #define SOCKETS_SO_TCPKEEPALIVE_INTERVAL         ( 19 ) /**< Set the time in seconds between individual TCP keep-alive probes. */
 #define SOCKETS_SO_TCPKEEPALIVE_COUNT            ( 20 ) /**< Set the maximum number of keep-alive probes TCP should send before dropping the connection. */
 #define SOCKETS_SO_TCPKEEPALIVE_IDLE_TIME        ( 21 ) /**< Set the time in seconds for which the connection needs to remain idle before TCP starts sending keep-alive probes. */
+#define SOCKETS_SO_READY_CALLBACK                ( 22 ) /**< Set the callback to be called whenever the socket is ready to receive or send. */
+#define SOCKETS_SO_TLS_PREPARE                   ( 23 ) /**< Start loading the TLS credentials before SOCKETS_Connect(). */
 
 /**@} */
 
@@ -187,6 +190,18 @@ typedef struct xSOCKET * Socket_t; /**< @brief Socket handle data type. */
 #define SOCKETS_SHUT_RDWR    ( 2 )  /**< No further send or receive. */
 /**@} */
 
+/**
+ * @anchor PollEvents <br>
+ * @name PollEvents
+ *
+ * @brief Events in SocketsPollFd_t for SOCKETS_Poll().
+ */
+/**@{ */
+#define SOCKETS_POLLIN     ( 1U ) /**< Data can be received without blocking. */
+#define SOCKETS_POLLHUP    ( 2U ) /**< The connection was closed or has failed. Always reported, need not be requested. */
+#define SOCKETS_POLLOUT    ( 4U ) /**< Data can be sent without blocking. */
+/**@} */
+
 /**
  * @brief Maximum length of an ASCII DNS name.
  */
@@ -206,6 +221,49 @@ typedef struct SocketsSockaddr
     uint32_t ulAddress;     /**< IP Address. Convention is to call this sin_addr. */
 } SocketsSockaddr_t;
 
+/**
+ * @ingroup SecureSockets_datatypes_paramstructs
+ * @brief One buffer of a gather list passed to SOCKETS_Sendv().
+ */
+typedef struct SocketsIoVector
+{
+    const void * pvBuffer; /**< Data to send. */
+    size_t xLength;        /**< Length of the data to send. */
+} SocketsIoVector_t;
+
+/**
+ * @ingroup SecureSockets_datatypes_paramstructs
+ * @brief A socket to wait on in SOCKETS_Poll().
+ */
+typedef struct SocketsPollFd
+{
+    Socket_t xSocket;   /**< The socket to wait on. */
+    uint32_t ulEvents;  /**< The events to wait for. @ref PollEvents */
+    uint32_t ulREvents; /**< Set by SOCKETS_Poll() to the events that occurred. @ref PollEvents */
+} SocketsPollFd_t;
+
+/**
+ * @brief Callback set with @ref SOCKETS_SO_READY_CALLBACK.
+ *
+ * @param[in] xSocket The socket that is ready.
+ * @param[in] ulREvents The events that occurred. @ref PollEvents
+ * @param[in] pvContext The context given with the callback.
+ */
+typedef void ( * SocketsReadyCallback_t )( Socket_t xSocket,
+                                           uint32_t ulREvents,
+                                           void * pvContext );
+
+/**
+ * @ingroup SecureSockets_datatypes_paramstructs
+ * @brief Value of the @ref SOCKETS_SO_READY_CALLBACK option.
+ */
+typedef struct SocketsReadyNotification
+{
+    SocketsReadyCallback_t pxCallback; /**< Called when one of the events occurs. NULL to stop notifications. */
+    void * pvContext;                  /**< Passed to pxCallback. */
+    uint32_t ulEvents;                 /**< The events to notify. @ref PollEvents */
+} SocketsReadyNotification_t;
+
 /**
  * @brief Well-known port numbers.
  */
@@ -312,6 +370,8 @@ int32_t SOCKETS_Connect( Socket_t xSocket,
  *   buffer pointed to by pvBuffer) is returned.
  * * If a timeout occurred before data could be received then 0 is returned (timeout
  *   is set using @ref SOCKETS_SO_RCVTIMEO).
+ * * If the socket is non-blocking and no data is available, SOCKETS_EWOULDBLOCK
+ *   is returned. This includes TLS sockets that have only part of a record.
  * * If an error occurred, a negative value is returned. @ref SocketsErrors
  */
 /* @[declare_secure_sockets_recv] */
@@ -338,6 +398,9 @@ int32_t SOCKETS_Recv( Socket_t xSocket,
  *
  * @return
  * * On success, the number of bytes actually sent is returned.
+ * * If the socket is non-blocking and nothing could be sent, SOCKETS_EWOULDBLOCK
+ *   is returned. On a TLS socket the call must then be repeated with the same
+ *   data, because part of it may already be encrypted and waiting to be sent.
  * * If an error occurred, a negative value is returned. @ref SocketsErrors
  */
 /* @[declare_secure_sockets_send] */
@@ -347,6 +410,37 @@ int32_t SOCKETS_Send( Socket_t xSocket,
                       uint32_t ulFlags );
 /* @[declare_secure_sockets_send] */
 
+/**
+ * @brief Transmit the data of several buffers to the remote socket, in order.
+ *
+ * Behaves like SOCKETS_Send() called with the buffers concatenated, so that a
+ * protocol header and its payload can be sent without first copying them
+ * together. On a TLS socket, small buffers are gathered into as few TLS
+ * records as possible.
+ *
+ * See the [Berkeley Sockets API]
+ * (https://en.wikipedia.org/wiki/Berkeley_sockets#Socket_API_functions)
+ * in wikipedia
+ *
+ * @param[in] xSocket The handle of the sending socket.
+ * @param[in] pxVectors The buffers containing the data to be sent.
+ * @param[in] xVectorCount The number of buffers in pxVectors.
+ * @param[in] ulFlags Not currently used. Should be set to 0.
+ *
+ * @return
+ * * On success, the total number of bytes actually sent is returned. It is
+ *   less than the total length of the buffers if the send timed out or the
+ *   socket is non-blocking.
+ * * If an error occurred before any data was sent, a negative value is
+ *   returned. @ref SocketsErrors
+ */
+/* @[declare_secure_sockets_sendv] */
+int32_t SOCKETS_Sendv( Socket_t xSocket,
+                       const SocketsIoVector_t * pxVectors,
+                       size_t xVectorCount,
+                       uint32_t ulFlags );
+/* @[declare_secure_sockets_sendv] */
+
 /**
  * @brief Closes all or part of a full-duplex connection on the socket.
  *
@@ -397,6 +491,36 @@ int32_t SOCKETS_Shutdown( Socket_t xSocket,
 int32_t SOCKETS_Close( Socket_t xSocket );
 /* @[declare_secure_sockets_close] */
 
+/**
+ * @brief Waits until one or more connected sockets are ready.
+ *
+ * A TLS socket is reported readable while data already received from the
+ * network is waiting to be decrypted or read, even if the underlying TCP socket
+ * has nothing new. One task can therefore wait on many connections instead of
+ * blocking in SOCKETS_Recv() on each of them.
+ *
+ * See the [Berkeley Sockets API]
+ * (https://en.wikipedia.org/wiki/Berkeley_sockets#Socket_API_functions)
+ * in wikipedia
+ *
+ * \warning Ports built on FreeRTOS+TCP require ipconfigSUPPORT_SELECT_FUNCTION.
+ * Ports that cannot wait on several sockets return SOCKETS_ENOPROTOOPT.
+ *
+ * @param[in,out] pxFds The sockets to wait on. ulREvents is set for each.
+ * @param[in] xFdCount The number of elements in pxFds.
+ * @param[in] xTimeout The maximum number of ticks to wait, 0 to check without
+ * blocking.
+ *
+ * @return
+ * * The number of sockets with events, 0 if the timeout expired.
+ * * If an error occurred, a negative value is returned. @ref SocketsErrors
+ */
+/* @[declare_secure_sockets_poll] */
+int32_t SOCKETS_Poll( SocketsPollFd_t * pxFds,
+                      size_t xFdCount,
+                      TickType_t xTimeout );
+/* @[declare_secure_sockets_poll] */
+
 /**
  * @brief AWS IoT ALPN protocol name for MQTT over TLS on server port 443.
  */
@@ -440,6 +564,8 @@ int32_t SOCKETS_Close( Socket_t xSocket );
  *      - Makes a socket non-blocking.
  *      - Non-blocking connect is not supported - socket option should be
  *        called after connect.
+ *      - SOCKETS_Recv() and SOCKETS_Send() return SOCKETS_EWOULDBLOCK when
+ *        nothing could be transferred, also on TLS sockets.
  *      - pvOptionValue is ignored for this option.
  *    - @ref SOCKETS_SO_WAKEUP_CALLBACK
  *      - Set the callback to be called whenever there is data available on
@@ -447,6 +573,22 @@ int32_t SOCKETS_Close( Socket_t xSocket );
  *      - This option provides an asynchronous way to handle received data
  *      - pvOptionValue is a pointer to the callback function
  *      - See PORT_SPECIFIC_LINK for device limitations.
+ *    - @ref SOCKETS_SO_READY_CALLBACK
+ *      - Set the callback to be called whenever the socket is ready for the
+ *        requested events, typically together with @ref SOCKETS_SO_NONBLOCK.
+ *      - The callbacks of all sockets are called from one task that waits on
+ *        them with SOCKETS_Poll(). A callback should not block.
+ *      - Notifications are level triggered: the callback is called again as
+ *        long as the condition lasts. Request SOCKETS_POLLOUT only while
+ *        there is data waiting to be sent.
+ *      - SOCKETS_POLLHUP is reported once, after which the callback is
+ *        removed.
+ *      - The callback is not running and will not be called once the option
+ *        is cleared or SOCKETS_Close() returns.
+ *      - This socket option should be set after SOCKETS_Connect().
+ *      - pvOptionValue is a pointer to a SocketsReadyNotification_t, NULL to
+ *        stop notifications.
+ *      - See PORT_SPECIFIC_LINK for device limitations.
  *  - Security Sockets Options
  *    - @ref SOCKETS_SO_REQUIRE_TLS
  *      - Use TLS for all connect, send, and receive on this socket.
@@ -476,6 +618,23 @@ int32_t SOCKETS_Close( Socket_t xSocket );
  *      - The ALPN list is expressed as an array of NULL-terminated ANSI
  *        strings.
  *      - xOptionLength is the number of items in the array.
+ *    - @ref SOCKETS_SO_TLS_SESSION_CACHE
+ *      - Resume a TLS session cached from an earlier connection to the same
+ *        server, and cache the session of this connection. Enabled by default
+ *        for sockets that use SNI.
+ *      - This socket option should be set before SOCKETS_Connect() is
+ *        called.
+ *      - pvOptionValue is a pointer to a BaseType_t, pdFALSE to always
+ *        perform a full handshake on this socket.
+ *    - @ref SOCKETS_SO_TLS_PREPARE
+ *      - Start loading the trusted server certificates and the client
+ *        credentials in the background, so that it overlaps the DNS lookup
+ *        and the TCP connection instead of delaying the handshake.
+ *      - This socket option should be set after the other TLS options and
+ *        before SOCKETS_GetHostByName() and SOCKETS_Connect() are called.
+ *      - Ports that only load the credentials during the handshake return
+ *        an error, which callers can ignore.
+ *      - pvOptionValue is ignored for this option.
  *    - @ref SOCKETS_SO_TCPKEEPALIVE
  *      - Enable or disable the TCP keep-alive functionality.
  *      - pvOptionValue is the value to enable or disable Keepalive.
@@ -61,6 +61,85 @@
     #define socketsconfigDEFAULT_RECV_TIMEOUT    ( 10000 )
 #endif
 
+/**
+ * @brief Size of the buffer SOCKETS_Sendv() gathers data into on TLS sockets.
+ *
+ * Data is copied into this buffer until it is full or the data ends, and each
+ * fill is sent as one TLS record. A buffer at least this large is sent as it
+ * is when nothing is gathered yet. Each TLS socket allocates the buffer on its
+ * first SOCKETS_Sendv() call with more than one buffer, and frees it when it
+ * is closed. Set to 0 to send every buffer as its own record.
+ */
+#ifndef socketsconfigSENDV_BUFFER_SIZE
+    #define socketsconfigSENDV_BUFFER_SIZE    ( 1024 )
+#endif
+
+/**
+ * @brief Number of random bytes generated ahead of time by a DRBG.
+ *
+ * Ports that implement xApplicationGetRandomNumber with PKCS #11, like the
+ * FreeRTOS+TCP port, serve small requests from this pool instead of calling
+ * C_GenerateRandom each time. The DRBG is seeded and reseeded from PKCS #11.
+ * At most MBEDTLS_CTR_DRBG_MAX_REQUEST bytes.
+ */
+#ifndef socketsconfigRANDOM_POOL_SIZE
+    #define socketsconfigRANDOM_POOL_SIZE    ( 64 )
+#endif
+
+/**
+ * @brief Maximum number of sockets with a SOCKETS_SO_READY_CALLBACK at a time.
+ *
+ * The callbacks of all these sockets are called from one task.
+ */
+#ifndef socketsconfigREADY_CALLBACK_MAX_SOCKETS
+    #define socketsconfigREADY_CALLBACK_MAX_SOCKETS    ( 8 )
+#endif
+
+/**
+ * @brief Longest time the ready callback task waits in SOCKETS_Poll(), in milliseconds.
+ *
+ * A callback set while the task waits takes effect when the wait ends. Closing
+ * a socket from another task may also wait this long.
+ */
+#ifndef socketsconfigREADY_CALLBACK_POLL_MS
+    #define socketsconfigREADY_CALLBACK_POLL_MS    ( 100 )
+#endif
+
+/**
+ * @brief Stack depth of the ready callback task, in words.
+ *
+ * The callbacks run on this stack.
+ */
+#ifndef socketsconfigREADY_CALLBACK_TASK_STACK_DEPTH
+    #define socketsconfigREADY_CALLBACK_TASK_STACK_DEPTH    ( configMINIMAL_STACK_SIZE * 4 )
+#endif
+
+/**
+ * @brief Priority of the ready callback task.
+ */
+#ifndef socketsconfigREADY_CALLBACK_TASK_PRIORITY
+    #define socketsconfigREADY_CALLBACK_TASK_PRIORITY    ( tskIDLE_PRIORITY + 1 )
+#endif
+
+/**
+ * @brief Stack depth of the task started by SOCKETS_SO_TLS_PREPARE, in words.
+ *
+ * The certificates are parsed and the PKCS #11 objects are read on this stack.
+ */
+#ifndef socketsconfigTLS_PREPARE_TASK_STACK_DEPTH
+    #define socketsconfigTLS_PREPARE_TASK_STACK_DEPTH    ( configMINIMAL_STACK_SIZE * 8 )
+#endif
+
+/**
+ * @brief Priority of the task started by SOCKETS_SO_TLS_PREPARE.
+ *
+ * The credentials are loaded in time for the handshake when this task runs
+ * while the connecting task waits for the DNS lookup and the TCP connection.
+ */
+#ifndef socketsconfigTLS_PREPARE_TASK_PRIORITY
+    #define socketsconfigTLS_PREPARE_TASK_PRIORITY    ( tskIDLE_PRIORITY + 1 )
+#endif
+
 /**
  * @brief By default, metrics of secure socket is disabled.
  *
@@ -55,11 +55,14 @@
 
 /*
  * The loop delay used while waiting for DNS resolution
- * to complete.
+ * to complete. Kept short as it is added to every lookup
+ * that is not answered from the lwIP DNS cache.
  */
 
-#define lwip_dns_resolver_LOOP_DELAY_MS       ( 250 )
-#define lwip_dns_resolver_LOOP_DELAY_TICKS    ( ( TickType_t ) lwip_dns_resolver_LOOP_DELAY_MS / portTICK_PERIOD_MS )
+#define lwip_dns_resolver_LOOP_DELAY_MS       ( 10 )
+#define lwip_dns_resolver_LOOP_DELAY_TICKS                                             \
+    ( ( ( TickType_t ) lwip_dns_resolver_LOOP_DELAY_MS / portTICK_PERIOD_MS ) > 0 ? \
+      ( ( TickType_t ) lwip_dns_resolver_LOOP_DELAY_MS / portTICK_PERIOD_MS ) : 1 )
 
 /*
  * The maximum time to wait for DNS resolution
@@ -71,9 +74,9 @@
  * The maximum number of loop iterations to wait for DNS
  * resolution to complete.
  */
-#define lwip_dns_resolver_MAX_WAIT_CYCLES                 \
-    ( ( ( lwip_dns_resolver_MAX_WAIT_SECONDS ) * 1000 ) / \
-      ( lwip_dns_resolver_LOOP_DELAY_MS ) )
+#define lwip_dns_resolver_MAX_WAIT_CYCLES                              \
+    ( ( ( lwip_dns_resolver_MAX_WAIT_SECONDS ) * configTICK_RATE_HZ ) / \
+      ( lwip_dns_resolver_LOOP_DELAY_TICKS ) )
 
 /*-----------------------------------------------------------*/
 
@@ -103,7 +106,15 @@ typedef struct _ss_ctx_t
     TaskHandle_t rx_handle;
     void ( * rx_callback )( Socket_t pxSocket );
 
+    SocketsReadyCallback_t ready_callback;
+    void * ready_context;
+    uint32_t ready_events;
+    volatile bool ready_busy;
+
+    bool nonblocking;
     bool enforce_tls;
+    bool disable_session_cache;
+    volatile bool tls_preparing;
     void * tls_ctx;
     char * destination;
 
@@ -113,6 +124,8 @@ typedef struct _ss_ctx_t
     char ** ppcAlpnProtocols;
     uint32_t ulAlpnProtocolsCount;
     uint32_t ulRefcount;
+
+    uint8_t * sendv_buffer; /* staging buffer of SOCKETS_Sendv(), allocated on first use */
 } ss_ctx_t;
 
 /*-----------------------------------------------------------*/
@@ -124,6 +137,14 @@ typedef struct _ss_ctx_t
 /*static int8_t sockets_allocated = SUPPORTED_DESCRIPTORS; */
 static int8_t sockets_allocated = socketsconfigDEFAULT_MAX_NUM_SECURE_SOCKETS;
 
+/*
+ * sockets with a ready callback, all served by one task.
+ */
+static ss_ctx_t * ready_sockets[ socketsconfigREADY_CALLBACK_MAX_SOCKETS ];
+static size_t ready_count = 0;
+static bool ready_task_started = false;
+static TaskHandle_t ready_task = NULL;
+
 
 /*-----------------------------------------------------------*/
 
@@ -179,6 +200,11 @@ static void prvSocketsClose( ss_ctx_t * ctx )
         vPortFree( ctx->destination );
     }
 
+    if( ctx->sendv_buffer )
+    {
+        vPortFree( ctx->sendv_buffer );
+    }
+
     vPortFree( ctx );
 }
 
@@ -216,6 +242,12 @@ static BaseType_t prvNetworkSend( void * pvContext,
                          xDataLength,
                          ctx->send_flag );
 
+    if( ( -1 == ret ) && ( true == ctx->nonblocking ) &&
+        ( ( errno == EWOULDBLOCK ) || ( errno == EAGAIN ) ) )
+    {
+        ret = SOCKETS_EWOULDBLOCK;
+    }
+
     return ( BaseType_t ) ret;
 }
 
@@ -249,7 +281,13 @@ static BaseType_t prvNetworkRecv( void * pvContext,
          */
         if( ( errno == EWOULDBLOCK ) || ( errno == EAGAIN ) )
         {
-            return SOCKETS_ERROR_NONE; /* timeout or would block */
+            /* tell a non-blocking caller, and TLS, to try again later */
+            if( true == ctx->nonblocking )
+            {
+                return SOCKETS_EWOULDBLOCK;
+            }
+
+            return SOCKETS_ERROR_NONE; /* timeout */
         }
 
         /*
@@ -347,6 +385,384 @@ static void prvRxSelectClear( ss_ctx_t * ctx )
 
 /*-----------------------------------------------------------*/
 
+/*
+ * @brief Stop the ready callback of a socket.
+ *
+ * Waits for the callback to return if it is running on the ready task, unless
+ * it is called from that callback.
+ */
+static void prvReadyClear( ss_ctx_t * ctx )
+{
+    size_t i;
+
+    taskENTER_CRITICAL();
+
+    for( i = 0; i < ready_count; i++ )
+    {
+        if( ready_sockets[ i ] == ctx )
+        {
+            ready_count--;
+            ready_sockets[ i ] = ready_sockets[ ready_count ];
+            break;
+        }
+    }
+
+    ctx->ready_callback = NULL;
+    taskEXIT_CRITICAL();
+
+    if( xTaskGetCurrentTaskHandle() != ready_task )
+    {
+        while( true == ctx->ready_busy )
+        {
+            vTaskDelay( 1 );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Wait on the sockets with a ready callback and call the callbacks.
+ */
+static void vTaskReady( void * param )
+{
+    SocketsPollFd_t fds[ socketsconfigREADY_CALLBACK_MAX_SOCKETS ];
+    SocketsReadyCallback_t callback;
+    void * context;
+    ss_ctx_t * ctx;
+    size_t count;
+    size_t i;
+    int32_t ret;
+
+    ( void ) param;
+
+    while( 1 )
+    {
+        /* the references keep closed sockets valid until they are skipped */
+        taskENTER_CRITICAL();
+        count = ready_count;
+
+        for( i = 0; i < count; i++ )
+        {
+            ctx = ready_sockets[ i ];
+            prvIncrementRefCount( ctx );
+            fds[ i ].xSocket = ( Socket_t ) ctx;
+            fds[ i ].ulEvents = ctx->ready_events;
+        }
+
+        taskEXIT_CRITICAL();
+
+        if( 0 == count )
+        {
+            ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+            continue;
+        }
+
+        ret = SOCKETS_Poll( fds, count, pdMS_TO_TICKS( socketsconfigREADY_CALLBACK_POLL_MS ) );
+
+        for( i = 0; i < count; i++ )
+        {
+            ctx = ( ss_ctx_t * ) fds[ i ].xSocket;
+
+            if( ( ret > 0 ) && ( 0 != fds[ i ].ulREvents ) )
+            {
+                taskENTER_CRITICAL();
+                callback = ctx->ready_callback;
+                context = ctx->ready_context;
+                ctx->ready_busy = ( NULL != callback );
+                taskEXIT_CRITICAL();
+
+                if( NULL != callback )
+                {
+                    /* a hang up does not go away, report it once */
+                    if( ( fds[ i ].ulREvents & SOCKETS_POLLHUP ) != 0 )
+                    {
+                        prvReadyClear( ctx );
+                    }
+
+                    callback( ( Socket_t ) ctx, fds[ i ].ulREvents, context );
+                    ctx->ready_busy = false;
+                }
+            }
+
+            prvDecrementRefCount( ctx );
+        }
+
+        if( ret < 0 )
+        {
+            vTaskDelay( pdMS_TO_TICKS( socketsconfigREADY_CALLBACK_POLL_MS ) );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Set the ready callback of a socket, starting the ready task if needed.
+ */
+static int32_t prvReadySet( ss_ctx_t * ctx,
+                            const SocketsReadyNotification_t * notification )
+{
+    BaseType_t xReturned;
+    bool start;
+    bool listed = false;
+    size_t i;
+
+    taskENTER_CRITICAL();
+    start = !ready_task_started;
+    ready_task_started = true;
+    taskEXIT_CRITICAL();
+
+    if( true == start )
+    {
+        xReturned = xTaskCreate( vTaskReady,                                   /* pvTaskCode */
+                                 "ssrdy",                                      /* pcName */
+                                 socketsconfigREADY_CALLBACK_TASK_STACK_DEPTH, /* usStackDepth */
+                                 NULL,                                         /* pvParameters */
+                                 socketsconfigREADY_CALLBACK_TASK_PRIORITY,    /* uxPriority */
+                                 &ready_task );                                /* pxCreatedTask */
+
+        if( pdPASS != xReturned )
+        {
+            ready_task_started = false;
+            return SOCKETS_ENOMEM;
+        }
+    }
+
+    taskENTER_CRITICAL();
+
+    for( i = 0; i < ready_count; i++ )
+    {
+        if( ready_sockets[ i ] == ctx )
+        {
+            listed = true;
+            break;
+        }
+    }
+
+    if( ( false == listed ) && ( socketsconfigREADY_CALLBACK_MAX_SOCKETS == ready_count ) )
+    {
+        taskEXIT_CRITICAL();
+        return SOCKETS_ENOMEM;
+    }
+
+    ctx->ready_callback = notification->pxCallback;
+    ctx->ready_context = notification->pvContext;
+    ctx->ready_events = notification->ulEvents;
+
+    if( false == listed )
+    {
+        ready_sockets[ ready_count ] = ctx;
+        ready_count++;
+    }
+
+    taskEXIT_CRITICAL();
+
+    /* wake the ready task if it has nothing to wait on */
+    if( NULL != ready_task )
+    {
+        ( void ) xTaskNotifyGive( ready_task );
+    }
+
+    return SOCKETS_ERROR_NONE;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Send a gather list, through the TLS pipe if negotiated.
+ *
+ * On TLS sockets the data is gathered into a staging buffer, so that each fill
+ * of the buffer becomes one TLS record. Parts of the data that are at least as
+ * large as the buffer are sent without copying when nothing is gathered yet.
+ * The staging buffer belongs to the socket, which allocates it on first use,
+ * and a single buffer is always sent as it is. Unencrypted data is passed to
+ * lwip buffer by buffer.
+ */
+static int32_t prvSendv( ss_ctx_t * ctx,
+                         const SocketsIoVector_t * pxVectors,
+                         size_t xVectorCount )
+{
+    int32_t ret = 0;
+    int32_t sent = 0;
+    size_t total_len = 0;
+    size_t staging_size = 0;
+    size_t staged = 0;
+    size_t vector = 0;
+    size_t offset = 0;
+    size_t len = 0;
+    size_t send_len = 0;
+    const uint8_t * data = NULL;
+    const uint8_t * send_data = NULL;
+    uint8_t * staging = NULL;
+
+    if( ctx->enforce_tls && ( xVectorCount > 1 ) )
+    {
+        for( vector = 0; vector < xVectorCount; vector++ )
+        {
+            total_len += pxVectors[ vector ].xLength;
+        }
+
+        staging_size = ( total_len < socketsconfigSENDV_BUFFER_SIZE ) ?
+                       total_len : socketsconfigSENDV_BUFFER_SIZE;
+
+        if( ( staging_size > 0 ) && ( NULL == ctx->sendv_buffer ) )
+        {
+            ctx->sendv_buffer = ( uint8_t * ) pvPortMalloc( socketsconfigSENDV_BUFFER_SIZE );
+        }
+
+        staging = ctx->sendv_buffer;
+
+        /* Without a staging buffer, every buffer is sent as it is. */
+        if( NULL == staging )
+        {
+            staging_size = 0;
+        }
+    }
+
+    vector = 0;
+
+    while( vector < xVectorCount )
+    {
+        data = ( const uint8_t * ) pxVectors[ vector ].pvBuffer + offset;
+        len = pxVectors[ vector ].xLength - offset;
+        send_data = NULL;
+
+        if( ( 0 == staged ) && ( len >= staging_size ) )
+        {
+            send_data = data;
+            send_len = len;
+        }
+        else
+        {
+            if( len > ( staging_size - staged ) )
+            {
+                len = staging_size - staged;
+            }
+
+            memcpy( &staging[ staged ], data, len );
+            staged += len;
+        }
+
+        offset += len;
+
+        if( offset == pxVectors[ vector ].xLength )
+        {
+            vector++;
+            offset = 0;
+        }
+
+        /* Send the staging buffer once it is full or the data ends. */
+        if( ( staged > 0 ) && ( ( staged == staging_size ) || ( vector == xVectorCount ) ) )
+        {
+            send_data = staging;
+            send_len = staged;
+            staged = 0;
+        }
+
+        if( NULL != send_data )
+        {
+            if( ctx->enforce_tls )
+            {
+                ret = TLS_Send( ctx->tls_ctx, send_data, send_len );
+            }
+            else
+            {
+                ret = prvNetworkSend( ( void * ) ctx, send_data, send_len );
+            }
+
+            if( ret > 0 )
+            {
+                sent += ret;
+            }
+
+            /* Stop at an error, or when a send timed out or would block. */
+            if( ret != ( int32_t ) send_len )
+            {
+                break;
+            }
+        }
+    }
+
+    /* Only report an error if no data was sent. */
+    if( ( ret >= 0 ) || ( sent > 0 ) )
+    {
+        ret = sent;
+    }
+
+    return ret;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Load the TLS credentials of a socket, then end.
+ *
+ * An error is not reported here, the handshake fails with the same error.
+ */
+static void vTaskTlsPrepare( void * param )
+{
+    ss_ctx_t * ctx = ( ss_ctx_t * ) param;
+
+    ( void ) TLS_Prepare( ctx->server_cert, ( uint32_t ) ctx->server_cert_len );
+
+    ctx->tls_preparing = false;
+    prvDecrementRefCount( ctx );
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Start loading the TLS credentials of a socket on a task of its own.
+ */
+static int32_t prvTlsPrepare( ss_ctx_t * ctx )
+{
+    BaseType_t xReturned;
+
+    if( true == ctx->tls_preparing )
+    {
+        return SOCKETS_ERROR_NONE;
+    }
+
+    ctx->tls_preparing = true;
+
+    prvIncrementRefCount( ctx );
+    xReturned = xTaskCreate( vTaskTlsPrepare,                           /* pvTaskCode */
+                             "sstls",                                   /* pcName */
+                             socketsconfigTLS_PREPARE_TASK_STACK_DEPTH, /* usStackDepth */
+                             ctx,                                       /* pvParameters */
+                             socketsconfigTLS_PREPARE_TASK_PRIORITY,    /* uxPriority */
+                             NULL );                                    /* pxCreatedTask */
+
+    if( pdPASS != xReturned )
+    {
+        ctx->tls_preparing = false;
+        prvDecrementRefCount( ctx );
+        return SOCKETS_ENOMEM;
+    }
+
+    return SOCKETS_ERROR_NONE;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Wait for the credentials of a socket to be loaded.
+ *
+ * TLS_Connect() already waits for them, this is only needed before the
+ * trusted server certificate being read is replaced.
+ */
+static void prvTlsPrepareWait( ss_ctx_t * ctx )
+{
+    while( true == ctx->tls_preparing )
+    {
+        vTaskDelay( 1 );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 Socket_t SOCKETS_Socket( int32_t lDomain,
                          int32_t lType,
                          int32_t lProtocol )
@@ -443,6 +859,7 @@ int32_t SOCKETS_Connect( Socket_t xSocket,
 
         tls_params.ulSize = sizeof( tls_params );
         tls_params.pcDestination = ctx->destination;
+        tls_params.usPort = pxAddress->usPort;
         tls_params.pcServerCertificate = ctx->server_cert;
         tls_params.ulServerCertificateLength = ctx->server_cert_len;
         tls_params.pvCallerContext = ctx;
@@ -450,6 +867,7 @@ int32_t SOCKETS_Connect( Socket_t xSocket,
         tls_params.pxNetworkSend = prvNetworkSend;
         tls_params.ppcAlpnProtocols = ( const char ** ) ctx->ppcAlpnProtocols;
         tls_params.ulAlpnProtocolsCount = ctx->ulAlpnProtocolsCount;
+        tls_params.xDisableSessionCache = ctx->disable_session_cache ? pdTRUE : pdFALSE;
 
         status = TLS_Init( &ctx->tls_ctx, &tls_params );
 
@@ -562,6 +980,47 @@ int32_t SOCKETS_Send( Socket_t xSocket,
 
 /*-----------------------------------------------------------*/
 
+int32_t SOCKETS_Sendv( Socket_t xSocket,
+                       const SocketsIoVector_t * pxVectors,
+                       size_t xVectorCount,
+                       uint32_t ulFlags )
+{
+    ss_ctx_t * ctx;
+    size_t vector;
+
+    if( SOCKETS_INVALID_SOCKET == xSocket )
+    {
+        return SOCKETS_SOCKET_ERROR;
+    }
+
+    if( ( NULL == pxVectors ) || ( 0 == xVectorCount ) )
+    {
+        return SOCKETS_EINVAL;
+    }
+
+    for( vector = 0; vector < xVectorCount; vector++ )
+    {
+        if( NULL == pxVectors[ vector ].pvBuffer )
+        {
+            return SOCKETS_EINVAL;
+        }
+    }
+
+    ctx = ( ss_ctx_t * ) xSocket;
+
+    if( ( ctx->status & SS_STATUS_CONNECTED ) != SS_STATUS_CONNECTED )
+    {
+        return SOCKETS_ENOTCONN;
+    }
+
+    configASSERT( ctx->ip_socket >= 0 );
+    ctx->send_flag = ulFlags;
+
+    return prvSendv( ctx, pxVectors, xVectorCount );
+}
+
+/*-----------------------------------------------------------*/
+
 int32_t SOCKETS_Shutdown( Socket_t xSocket,
                           uint32_t ulHow )
 {
@@ -600,12 +1059,163 @@ int32_t SOCKETS_Close( Socket_t xSocket )
     ctx = ( ss_ctx_t * ) xSocket;
     ctx->state = SST_RX_CLOSING;
 
+    if( NULL != ctx->ready_callback )
+    {
+        prvReadyClear( ctx );
+    }
+
     lwip_close( ctx->ip_socket );
     prvDecrementRefCount( ctx );
 
     return SOCKETS_ERROR_NONE;
 }
 
+/*-----------------------------------------------------------*/
+
+int32_t SOCKETS_Poll( SocketsPollFd_t * pxFds,
+                      size_t xFdCount,
+                      TickType_t xTimeout )
+{
+    ss_ctx_t * ctx;
+    fd_set read_fds;
+    fd_set write_fds;
+    fd_set err_fds;
+    struct timeval tv;
+    struct timeval * ptv = NULL;
+    int max_fd = -1;
+    int ret;
+    int32_t ready = 0;
+    size_t i;
+    char peek;
+
+    if( ( NULL == pxFds ) && ( 0 != xFdCount ) )
+    {
+        return SOCKETS_EINVAL;
+    }
+
+    FD_ZERO( &read_fds );
+    FD_ZERO( &write_fds );
+    FD_ZERO( &err_fds );
+
+    for( i = 0; i < xFdCount; i++ )
+    {
+        if( SOCKETS_INVALID_SOCKET == pxFds[ i ].xSocket )
+        {
+            return SOCKETS_EINVAL;
+        }
+
+        ctx = ( ss_ctx_t * ) pxFds[ i ].xSocket;
+        pxFds[ i ].ulREvents = 0;
+
+        if( ( ctx->status & SS_STATUS_CONNECTED ) != SS_STATUS_CONNECTED )
+        {
+            pxFds[ i ].ulREvents = SOCKETS_POLLHUP;
+            continue;
+        }
+
+        /* Records already pulled from lwip are readable without new data
+         * arriving, so don't block on lwip for them. */
+        if( ( ( pxFds[ i ].ulEvents & SOCKETS_POLLIN ) != 0 ) &&
+            ( ( ctx->status & SS_STATUS_SECURED ) == SS_STATUS_SECURED ) &&
+            ( pdTRUE == TLS_Pending( ctx->tls_ctx ) ) )
+        {
+            pxFds[ i ].ulREvents = SOCKETS_POLLIN;
+        }
+
+        configASSERT( ctx->ip_socket >= 0 );
+
+        /* A socket waiting only to send must not be woken by unread data. */
+        if( ( ( pxFds[ i ].ulEvents & SOCKETS_POLLIN ) != 0 ) ||
+            ( ( pxFds[ i ].ulEvents & SOCKETS_POLLOUT ) == 0 ) )
+        {
+            FD_SET( ctx->ip_socket, &read_fds );
+        }
+
+        FD_SET( ctx->ip_socket, &err_fds );
+
+        if( ( pxFds[ i ].ulEvents & SOCKETS_POLLOUT ) != 0 )
+        {
+            FD_SET( ctx->ip_socket, &write_fds );
+        }
+
+        if( ctx->ip_socket > max_fd )
+        {
+            max_fd = ctx->ip_socket;
+        }
+    }
+
+    for( i = 0; i < xFdCount; i++ )
+    {
+        if( 0 != pxFds[ i ].ulREvents )
+        {
+            xTimeout = 0;
+            break;
+        }
+    }
+
+    /* No socket is connected, so all of them have reported a hang up. */
+    if( max_fd < 0 )
+    {
+        return ( int32_t ) xFdCount;
+    }
+
+    if( portMAX_DELAY != xTimeout )
+    {
+        tv.tv_sec = TICK_TO_S( xTimeout );
+        tv.tv_usec = TICK_TO_US( xTimeout % configTICK_RATE_HZ );
+        ptv = &tv;
+    }
+
+    ret = lwip_select( max_fd + 1, &read_fds, &write_fds, &err_fds, ptv );
+
+    if( ret < 0 )
+    {
+        return SOCKETS_SOCKET_ERROR;
+    }
+
+    for( i = 0; i < xFdCount; i++ )
+    {
+        ctx = ( ss_ctx_t * ) pxFds[ i ].xSocket;
+
+        if( ( pxFds[ i ].ulREvents & SOCKETS_POLLHUP ) == 0 )
+        {
+            if( FD_ISSET( ctx->ip_socket, &err_fds ) )
+            {
+                pxFds[ i ].ulREvents |= SOCKETS_POLLHUP;
+            }
+            else if( FD_ISSET( ctx->ip_socket, &read_fds ) )
+            {
+                /* A readable socket may only be reporting that the peer
+                 * closed the connection. */
+                ret = lwip_recv( ctx->ip_socket, &peek, 1, MSG_PEEK | MSG_DONTWAIT );
+
+                if( ret > 0 )
+                {
+                    pxFds[ i ].ulREvents |= ( pxFds[ i ].ulEvents & SOCKETS_POLLIN );
+                }
+                else if( ( 0 == ret ) || ( ( errno != EWOULDBLOCK ) && ( errno != EAGAIN ) ) )
+                {
+                    pxFds[ i ].ulREvents |= SOCKETS_POLLHUP;
+                }
+            }
+
+            if( ( ( pxFds[ i ].ulREvents & SOCKETS_POLLHUP ) == 0 ) &&
+                ( ( pxFds[ i ].ulEvents & SOCKETS_POLLOUT ) != 0 ) &&
+                FD_ISSET( ctx->ip_socket, &write_fds ) )
+            {
+                pxFds[ i ].ulREvents |= SOCKETS_POLLOUT;
+            }
+        }
+
+        if( 0 != pxFds[ i ].ulREvents )
+        {
+            ready++;
+        }
+    }
+
+    return ready;
+}
+
 
 /*-----------------------------------------------------------*/
 
@@ -676,6 +1286,7 @@ int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
                    return SOCKETS_EINVAL;
                }
 
+               ctx->nonblocking = true;
                break;
            }
 
@@ -701,6 +1312,8 @@ int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
                 return SOCKETS_EINVAL;
             }
 
+            prvTlsPrepareWait( ctx );
+
             if( ctx->server_cert )
             {
                 vPortFree( ctx->server_cert );
@@ -748,6 +1361,35 @@ int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
 
             break;
 
+        case SOCKETS_SO_TLS_SESSION_CACHE:
+
+            if( ctx->status & SS_STATUS_CONNECTED )
+            {
+                return SOCKETS_EISCONN;
+            }
+
+            if( ( NULL == pvOptionValue ) || ( sizeof( BaseType_t ) != xOptionLength ) )
+            {
+                return SOCKETS_EINVAL;
+            }
+
+            ctx->disable_session_cache = ( pdFALSE == *( ( const BaseType_t * ) pvOptionValue ) );
+            break;
+
+        case SOCKETS_SO_TLS_PREPARE:
+
+            if( ctx->status & SS_STATUS_CONNECTED )
+            {
+                return SOCKETS_EISCONN;
+            }
+
+            if( !ctx->enforce_tls )
+            {
+                return SOCKETS_EINVAL;
+            }
+
+            return prvTlsPrepare( ctx );
+
         case SOCKETS_SO_WAKEUP_CALLBACK:
 
             if( ( xOptionLength == sizeof( void * ) ) &&
@@ -762,6 +1404,33 @@ int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
 
             break;
 
+        case SOCKETS_SO_READY_CALLBACK:
+           {
+               const SocketsReadyNotification_t * notification = pvOptionValue;
+
+               if( ( NULL != notification ) && ( NULL != notification->pxCallback ) )
+               {
+                   if( sizeof( SocketsReadyNotification_t ) != xOptionLength )
+                   {
+                       return SOCKETS_EINVAL;
+                   }
+
+                   if( ( ctx->status & SS_STATUS_CONNECTED ) != SS_STATUS_CONNECTED )
+                   {
+                       return SOCKETS_ENOTCONN;
+                   }
+
+                   return prvReadySet( ctx, notification );
+               }
+
+               if( NULL != ctx->ready_callback )
+               {
+                   prvReadyClear( ctx );
+               }
+
+               break;
+           }
+
         case SOCKETS_SO_ALPN_PROTOCOLS:
 
             /* Do not set the ALPN option if the socket is already connected. */
@@ -0,0 +1,336 @@
+/*
+ * FreeRTOS Secure Sockets V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "portableDefs.h"
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+
+#include "mock_task.h"
+#include "mock_queue.h"
+#include "mock_portable.h"
+#include "mock_iot_tls.h"
+#include "mock_FreeRTOS_Sockets.h"
+#include "mock_FreeRTOS_DNS.h"
+#include "mock_iot_pkcs11.h"
+#include "mock_ctr_drbg.h"
+
+#include "FreeRTOS_IP.h"
+#include "iot_secure_sockets.h"
+
+#define POOL_SIZE               socketsconfigRANDOM_POOL_SIZE
+#define VALUES_PER_POOL         ( POOL_SIZE / sizeof( uint32_t ) )
+
+#define GENERATE_RANDOM_BYTE    0xA5
+
+/* ============================  GLOBAL VARIABLES =========================== */
+
+static uint16_t malloc_free_calls = 0;
+
+/* Number of times the DRBG was asked to refill the pool. */
+static int drbg_refills = 0;
+
+/* When set, the DRBG fails to refill the pool. */
+static bool drbg_fails = false;
+
+/* Number of times PKCS #11 was asked for random bytes. */
+static int generate_random_calls = 0;
+
+/* When set, another task holds the random pool. */
+static bool pool_busy = false;
+
+static CK_FUNCTION_LIST pkcs11_function_list;
+
+/* ==========================  CALLBACK FUNCTIONS =========================== */
+/*@null@*/ void * malloc_cb( size_t size,
+                             int numCalls )
+{
+    malloc_free_calls++;
+    return ( void * ) malloc( size );
+}
+
+void free_cb( void * ptr,
+              int numCalls )
+{
+    malloc_free_calls--;
+    free( ptr );
+}
+
+static QueueHandle_t xQueueCreateMutexStatic_cb( const uint8_t ucQueueType,
+                                                 StaticQueue_t * pxStaticQueue,
+                                                 int numCalls )
+{
+    return ( QueueHandle_t ) pxStaticQueue;
+}
+
+/* The pool is only ever taken without waiting, the PKCS #11 session is not. */
+static BaseType_t xQueueSemaphoreTake_cb( QueueHandle_t xQueue,
+                                          TickType_t xTicksToWait,
+                                          int numCalls )
+{
+    return ( pool_busy && ( 0 == xTicksToWait ) ) ? pdFALSE : pdTRUE;
+}
+
+static BaseType_t xQueueGenericSend_cb( QueueHandle_t xQueue,
+                                        const void * const pvItemToQueue,
+                                        TickType_t xTicksToWait,
+                                        const BaseType_t xCopyPosition,
+                                        int numCalls )
+{
+    return pdTRUE;
+}
+
+static int mbedtls_ctr_drbg_seed_cb( mbedtls_ctr_drbg_context * ctx,
+                                     int ( * f_entropy )( void *, unsigned char *, size_t ),
+                                     void * p_entropy,
+                                     const unsigned char * custom,
+                                     size_t len,
+                                     int numCalls )
+{
+    unsigned char entropy[ 32 ];
+
+    return f_entropy( p_entropy, entropy, sizeof( entropy ) );
+}
+
+/* Fill the pool with 1, 2, ... so the order values are handed out is visible. */
+static int mbedtls_ctr_drbg_random_cb( void * p_rng,
+                                       unsigned char * output,
+                                       size_t output_len,
+                                       int numCalls )
+{
+    size_t i;
+    int ret = MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
+
+    if( !drbg_fails )
+    {
+        TEST_ASSERT_EQUAL_INT( POOL_SIZE, output_len );
+
+        for( i = 0; i < output_len; i++ )
+        {
+            output[ i ] = ( unsigned char ) ( i + 1 );
+        }
+
+        drbg_refills++;
+        ret = 0;
+    }
+
+    return ret;
+}
+
+static CK_RV C_GetSlotList_cb( CK_BBOOL tokenPresent,
+                               CK_SLOT_ID_PTR pSlotList,
+                               CK_ULONG_PTR pulCount )
+{
+    if( NULL != pSlotList )
+    {
+        pSlotList[ 0 ] = 1;
+    }
+
+    *pulCount = 1;
+    return CKR_OK;
+}
+
+static CK_RV C_OpenSession_cb( CK_SLOT_ID slotID,
+                               CK_FLAGS flags,
+                               CK_VOID_PTR pApplication,
+                               CK_NOTIFY Notify,
+                               CK_SESSION_HANDLE_PTR phSession )
+{
+    *phSession = 1;
+    return CKR_OK;
+}
+
+static CK_RV C_GenerateRandom_cb( CK_SESSION_HANDLE hSession,
+                                  CK_BYTE_PTR RandomData,
+                                  CK_ULONG ulRandomLen )
+{
+    generate_random_calls++;
+    memset( RandomData, GENERATE_RANDOM_BYTE, ulRandomLen );
+    return CKR_OK;
+}
+
+/* The PKCS #11 function list is not in a mocked header. */
+CK_RV C_GetFunctionList( CK_FUNCTION_LIST_PTR_PTR ppFunctionList )
+{
+    pkcs11_function_list.C_GetSlotList = C_GetSlotList_cb;
+    pkcs11_function_list.C_OpenSession = C_OpenSession_cb;
+    pkcs11_function_list.C_GenerateRandom = C_GenerateRandom_cb;
+    *ppFunctionList = &pkcs11_function_list;
+    return CKR_OK;
+}
+
+/* The critical section macros of the port are not in a mocked header. */
+void vPortEnterCritical( void )
+{
+}
+
+void vPortExitCritical( void )
+{
+}
+
+/* ============================   UNITY FIXTURES ============================ */
+void setUp( void )
+{
+    pvPortMalloc_Stub( malloc_cb );
+    vPortFree_Stub( free_cb );
+    xQueueCreateMutexStatic_Stub( xQueueCreateMutexStatic_cb );
+    xQueueSemaphoreTake_Stub( xQueueSemaphoreTake_cb );
+    xQueueGenericSend_Stub( xQueueGenericSend_cb );
+    xInitializePkcs11Token_IgnoreAndReturn( CKR_OK );
+    mbedtls_ctr_drbg_init_Ignore();
+    mbedtls_ctr_drbg_free_Ignore();
+    mbedtls_ctr_drbg_seed_Stub( mbedtls_ctr_drbg_seed_cb );
+    mbedtls_ctr_drbg_random_Stub( mbedtls_ctr_drbg_random_cb );
+
+    malloc_free_calls = 0;
+    drbg_refills = 0;
+    drbg_fails = false;
+    generate_random_calls = 0;
+    pool_busy = false;
+}
+
+/* called before each testcase */
+void tearDown( void )
+{
+    TEST_ASSERT_EQUAL_INT_MESSAGE( 0, malloc_free_calls,
+                                   "free is not called the same number of times as malloc, \
+            you might have a memory leak!!" );
+}
+
+/* called at the beginning of the whole suite */
+void suiteSetUp()
+{
+}
+
+/* called at the end of the whole suite */
+int suiteTearDown( int numFailures )
+{
+    return( numFailures > 0 );
+}
+
+/* ==========================  Helper functions  ============================ */
+
+/* The pool outlives each testcase, so drain it to start from a known state. */
+static void emptyPool( void )
+{
+    uint32_t value;
+    size_t i;
+
+    while( 0 == drbg_refills )
+    {
+        TEST_ASSERT_EQUAL_INT( pdTRUE, xApplicationGetRandomNumber( &value ) );
+    }
+
+    for( i = 1; i < VALUES_PER_POOL; i++ )
+    {
+        TEST_ASSERT_EQUAL_INT( pdTRUE, xApplicationGetRandomNumber( &value ) );
+    }
+
+    drbg_refills = 0;
+    generate_random_calls = 0;
+}
+
+/* ===================  TESTING xApplicationGetRandomNumber  ================ */
+
+/*!
+ * @brief Random numbers are taken from the pool
+ *
+ * @details The purpose of this testcase is to make sure the DRBG is run once
+ *          per pool rather than once per random number, and that it is run
+ *          again when the pool runs empty
+ */
+void test_SecureSockets_random_pool_refill( void )
+{
+    uint8_t pool[ POOL_SIZE ];
+    uint32_t expected;
+    uint32_t value;
+    size_t i;
+
+    emptyPool();
+
+    for( i = 0; i < POOL_SIZE; i++ )
+    {
+        pool[ i ] = ( uint8_t ) ( i + 1 );
+    }
+
+    /* The pool is handed out from its end. */
+    for( i = VALUES_PER_POOL; i > 0; i-- )
+    {
+        memcpy( &expected, &pool[ ( i - 1 ) * sizeof( uint32_t ) ], sizeof( expected ) );
+        TEST_ASSERT_EQUAL_INT( pdTRUE, xApplicationGetRandomNumber( &value ) );
+        TEST_ASSERT_EQUAL_HEX32( expected, value );
+        TEST_ASSERT_EQUAL_INT( 1, drbg_refills );
+    }
+
+    TEST_ASSERT_EQUAL_INT( pdTRUE, xApplicationGetRandomNumber( &value ) );
+    TEST_ASSERT_EQUAL_INT( 2, drbg_refills );
+    TEST_ASSERT_EQUAL_INT( 0, generate_random_calls );
+}
+
+/*!
+ * @brief The pool is empty and the DRBG fails
+ *
+ * @details The purpose of this testcase is to make sure a failed refill is
+ *          reported instead of handing out stale bytes, and that the pool
+ *          recovers once the DRBG works again
+ */
+void test_SecureSockets_random_pool_exhausted( void )
+{
+    uint32_t value = 1;
+
+    emptyPool();
+
+    drbg_fails = true;
+    TEST_ASSERT_EQUAL_INT( pdFALSE, xApplicationGetRandomNumber( &value ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, value );
+    TEST_ASSERT_EQUAL_INT( 0, drbg_refills );
+
+    drbg_fails = false;
+    TEST_ASSERT_EQUAL_INT( pdTRUE, xApplicationGetRandomNumber( &value ) );
+    TEST_ASSERT_EQUAL_INT( 1, drbg_refills );
+}
+
+/*!
+ * @brief Another task holds the pool
+ *
+ * @details The purpose of this testcase is to make sure the caller does not
+ *          wait for the pool, and reads the bytes from PKCS #11 instead
+ */
+void test_SecureSockets_random_pool_busy( void )
+{
+    uint32_t value;
+
+    emptyPool();
+
+    pool_busy = true;
+    TEST_ASSERT_EQUAL_INT( pdTRUE, xApplicationGetRandomNumber( &value ) );
+    TEST_ASSERT_EACH_EQUAL_HEX8( GENERATE_RANDOM_BYTE, &value, sizeof( value ) );
+    TEST_ASSERT_EQUAL_INT( 1, generate_random_calls );
+    TEST_ASSERT_EQUAL_INT( 0, drbg_refills );
+}
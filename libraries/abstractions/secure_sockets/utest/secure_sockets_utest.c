@@ -211,6 +211,15 @@ static Socket_t create_normal_connection()
     connectSocket( s );
     return s;
 }
+
+static void setNonBlocking( Socket_t s )
+{
+    int32_t ret;
+
+    lwip_ioctl_ExpectAnyArgsAndReturn( 0 );
+    ret = SOCKETS_SetSockOpt( s, 0, SOCKETS_SO_NONBLOCK, NULL, 0 );
+    TEST_ASSERT_EQUAL_INT( SOCKETS_ERROR_NONE, ret );
+}
 /* ======================  TESTING SOCKETS_Send  ============================ */
 
 /*!
@@ -314,6 +323,401 @@ void test_SecureSockets_send_not_connected( void )
     deinitSocket( so );
 }
 
+/*!
+ * @brief Send on a full non-blocking socket
+ *
+ * @details The purpose of this testcase is to make sure a non-blocking socket
+ *          that lwip can't send on reports SOCKETS_EWOULDBLOCK
+ */
+void test_SecureSockets_send_nonblocking_would_block( void )
+{
+    int32_t ret;
+    const char buffer[ BUFFER_LEN ];
+    Socket_t so = create_normal_connection();
+
+    setNonBlocking( so );
+
+    lwip_send_ExpectAnyArgsAndReturn( -1 );
+    errno = EAGAIN;
+    ret = SOCKETS_Send( so,
+                        buffer,
+                        BUFFER_LEN,
+                        0 );
+    TEST_ASSERT_EQUAL_INT( SOCKETS_EWOULDBLOCK, ret );
+    deinitSocket( so );
+}
+
+/* ======================  TESTING SOCKETS_Sendv  =========================== */
+
+static const char sendv_header[] = "header";
+static const char sendv_body[] = "body";
+static int tls_send_calls;
+
+/* helper function to check that TLS_Send is given the gathered buffers */
+static BaseType_t TLS_Send_gather_cb( void * pvContext,
+                                      const unsigned char * pucMsg,
+                                      size_t xMsgLength,
+                                      int num_calls )
+{
+    tls_send_calls++;
+    TEST_ASSERT_EQUAL_INT( sizeof( sendv_header ) + sizeof( sendv_body ), xMsgLength );
+    TEST_ASSERT_EQUAL_MEMORY( sendv_header, pucMsg, sizeof( sendv_header ) );
+    TEST_ASSERT_EQUAL_MEMORY( sendv_body, pucMsg + sizeof( sendv_header ), sizeof( sendv_body ) );
+    return ( BaseType_t ) xMsgLength;
+}
+
+/*!
+ * @brief A happy vectored send case with normal sockets
+ *
+ * @details The purpose is to make sure every buffer is sent in order and the
+ *          total number of bytes is returned
+ */
+void test_SecureSockets_sendv_successful( void )
+{
+    int32_t ret;
+    Socket_t so = create_normal_connection();
+    SocketsIoVector_t vectors[ 2 ] =
+    {
+        { sendv_header, sizeof( sendv_header ) },
+        { sendv_body,   sizeof( sendv_body )   }
+    };
+
+    lwip_send_ExpectAndReturn( 5, sendv_header, sizeof( sendv_header ), 0, sizeof( sendv_header ) );
+    lwip_send_ExpectAndReturn( 5, sendv_body, sizeof( sendv_body ), 0, sizeof( sendv_body ) );
+    ret = SOCKETS_Sendv( so, vectors, 2, 0 );
+    TEST_ASSERT_EQUAL_INT( sizeof( sendv_header ) + sizeof( sendv_body ), ret );
+    deinitSocket( so );
+}
+
+/*!
+ * @brief A vectored send with tls sockets
+ *
+ * @details The purpose of this testcase is to make sure small buffers are
+ *          gathered into a single TLS_Send call
+ */
+void test_SecureSockets_sendv_tls_gathers_buffers( void )
+{
+    int32_t ret;
+    Socket_t so = create_TLS_connection();
+    SocketsIoVector_t vectors[ 2 ] =
+    {
+        { sendv_header, sizeof( sendv_header ) },
+        { sendv_body,   sizeof( sendv_body )   }
+    };
+    uint16_t allocations = malloc_free_calls;
+
+    tls_send_calls = 0;
+    TLS_Send_Stub( TLS_Send_gather_cb );
+    ret = SOCKETS_Sendv( so, vectors, 2, 0 );
+    TEST_ASSERT_EQUAL_INT( sizeof( sendv_header ) + sizeof( sendv_body ), ret );
+    TEST_ASSERT_EQUAL_INT( 1, tls_send_calls );
+
+    /* the staging buffer is kept by the socket */
+    ret = SOCKETS_Sendv( so, vectors, 2, 0 );
+    TEST_ASSERT_EQUAL_INT( sizeof( sendv_header ) + sizeof( sendv_body ), ret );
+    TEST_ASSERT_EQUAL_INT( 2, tls_send_calls );
+    TEST_ASSERT_EQUAL_INT( allocations + 1, malloc_free_calls );
+    TLS_Send_Stub( NULL );
+    TLS_Cleanup_ExpectAnyArgs();
+    deinitSocket( so );
+}
+
+/* helper function to check that TLS_Send is given the caller's buffer */
+static BaseType_t TLS_Send_direct_cb( void * pvContext,
+                                      const unsigned char * pucMsg,
+                                      size_t xMsgLength,
+                                      int num_calls )
+{
+    tls_send_calls++;
+    TEST_ASSERT_EQUAL_PTR( sendv_body, pucMsg );
+    TEST_ASSERT_EQUAL_INT( sizeof( sendv_body ), xMsgLength );
+    return ( BaseType_t ) xMsgLength;
+}
+
+/*!
+ * @brief A vectored send of a single buffer with tls sockets
+ *
+ * @details The purpose of this testcase is to make sure a single buffer is
+ *          sent as it is, without allocating a staging buffer
+ */
+void test_SecureSockets_sendv_tls_single_buffer( void )
+{
+    int32_t ret;
+    Socket_t so = create_TLS_connection();
+    SocketsIoVector_t vectors[ 1 ] =
+    {
+        { sendv_body, sizeof( sendv_body ) }
+    };
+    uint16_t allocations = malloc_free_calls;
+
+    tls_send_calls = 0;
+    TLS_Send_Stub( TLS_Send_direct_cb );
+    ret = SOCKETS_Sendv( so, vectors, 1, 0 );
+    TEST_ASSERT_EQUAL_INT( sizeof( sendv_body ), ret );
+    TEST_ASSERT_EQUAL_INT( 1, tls_send_calls );
+    TEST_ASSERT_EQUAL_INT( allocations, malloc_free_calls );
+    TLS_Send_Stub( NULL );
+    TLS_Cleanup_ExpectAnyArgs();
+    deinitSocket( so );
+}
+
+/*!
+ * @brief A vectored send that is cut short
+ *
+ * @details The purpose of this testcase is to make sure the bytes sent so far
+ *          are returned, and that no more buffers are sent, once a send comes
+ *          up short or fails
+ */
+void test_SecureSockets_sendv_partial( void )
+{
+    int32_t ret;
+    Socket_t so = create_normal_connection();
+    SocketsIoVector_t vectors[ 2 ] =
+    {
+        { sendv_header, sizeof( sendv_header ) },
+        { sendv_body,   sizeof( sendv_body )   }
+    };
+
+    lwip_send_ExpectAnyArgsAndReturn( 2 );
+    ret = SOCKETS_Sendv( so, vectors, 2, 0 );
+    TEST_ASSERT_EQUAL_INT( 2, ret );
+
+    lwip_send_ExpectAnyArgsAndReturn( sizeof( sendv_header ) );
+    lwip_send_ExpectAnyArgsAndReturn( -1 );
+    ret = SOCKETS_Sendv( so, vectors, 2, 0 );
+    TEST_ASSERT_EQUAL_INT( sizeof( sendv_header ), ret );
+
+    lwip_send_ExpectAnyArgsAndReturn( -1 );
+    ret = SOCKETS_Sendv( so, vectors, 2, 0 );
+    TEST_ASSERT_LESS_THAN_INT( 0, ret );
+    deinitSocket( so );
+}
+
+/*!
+ * @brief Test various bad parameters
+ *
+ * @details The purpose of this testcase is to make sure SOCKETS_Sendv returns
+ *          errors when it receives some invalid parameters
+ */
+void test_SecureSockets_sendv_invalid_parameters( void )
+{
+    Socket_t s = SOCKETS_INVALID_SOCKET;
+    int32_t ret;
+    SocketsIoVector_t vectors[ 2 ] =
+    {
+        { sendv_header, sizeof( sendv_header ) },
+        { NULL,         sizeof( sendv_body )   }
+    };
+
+    /* test invalid socket */
+    ret = SOCKETS_Sendv( s, vectors, 1, 0 );
+    TEST_ASSERT_EQUAL_INT( SOCKETS_SOCKET_ERROR, ret );
+
+    s = initSocket();
+
+    /* test null vectors */
+    ret = SOCKETS_Sendv( s, NULL, 1, 0 );
+    TEST_ASSERT_EQUAL_INT( SOCKETS_EINVAL, ret );
+
+    /* test zero vectors */
+    ret = SOCKETS_Sendv( s, vectors, 0, 0 );
+    TEST_ASSERT_EQUAL_INT( SOCKETS_EINVAL, ret );
+
+    /* test null buffer */
+    ret = SOCKETS_Sendv( s, vectors, 2, 0 );
+    TEST_ASSERT_EQUAL_INT( SOCKETS_EINVAL, ret );
+
+    /* test not connected */
+    ret = SOCKETS_Sendv( s, vectors, 1, 0 );
+    TEST_ASSERT_EQUAL_INT( SOCKETS_ENOTCONN, ret );
+    deinitSocket( s );
+}
+
+/* ======================  TESTING SOCKETS_Poll  ============================ */
+
+/* helper function to check that SOCKETS_Poll does not block when TLS has data */
+static int lwip_select_no_wait_cb( int maxfdp1,
+                                   fd_set * readset,
+                                   fd_set * writeset,
+                                   fd_set * exceptset,
+                                   struct timeval * timeout,
+                                   int num_calls )
+{
+    TEST_ASSERT_NOT_NULL( timeout );
+    TEST_ASSERT_EQUAL_INT( 0, timeout->tv_sec );
+    TEST_ASSERT_EQUAL_INT( 0, timeout->tv_usec );
+    FD_ZERO( readset );
+    FD_ZERO( exceptset );
+    return 0;
+}
+
+/*!
+ * @brief A socket with data to read
+ *
+ * @details The purpose of this testcase is to make sure a socket that lwip
+ *          reports readable, and that has data, is reported with SOCKETS_POLLIN
+ */
+void test_SecureSockets_poll_readable( void )
+{
+    int32_t ret;
+    fd_set ready_fds;
+    fd_set empty_fds;
+    SocketsPollFd_t fd;
+
+    fd.xSocket = create_normal_connection();
+    fd.ulEvents = SOCKETS_POLLIN;
+    FD_ZERO( &ready_fds );
+    FD_ZERO( &empty_fds );
+    FD_SET( 5, &ready_fds );
+
+    lwip_select_ExpectAnyArgsAndReturn( 1 );
+    lwip_select_ReturnMemThruPtr_readset( &ready_fds, sizeof( fd_set ) );
+    lwip_select_ReturnMemThruPtr_exceptset( &empty_fds, sizeof( fd_set ) );
+    lwip_recv_ExpectAnyArgsAndReturn( 1 );
+    ret = SOCKETS_Poll( &fd, 1, 10 );
+    TEST_ASSERT_EQUAL_INT( 1, ret );
+    TEST_ASSERT_EQUAL_UINT32( SOCKETS_POLLIN, fd.ulREvents );
+    deinitSocket( fd.xSocket );
+}
+
+/*!
+ * @brief A socket closed by the peer
+ *
+ * @details The purpose of this testcase is to make sure a socket that lwip
+ *          reports readable, but that has no data left, is reported with
+ *          SOCKETS_POLLHUP only
+ */
+void test_SecureSockets_poll_hangup( void )
+{
+    int32_t ret;
+    fd_set ready_fds;
+    fd_set empty_fds;
+    SocketsPollFd_t fd;
+
+    fd.xSocket = create_normal_connection();
+    fd.ulEvents = SOCKETS_POLLIN;
+    FD_ZERO( &ready_fds );
+    FD_ZERO( &empty_fds );
+    FD_SET( 5, &ready_fds );
+
+    lwip_select_ExpectAnyArgsAndReturn( 1 );
+    lwip_select_ReturnMemThruPtr_readset( &ready_fds, sizeof( fd_set ) );
+    lwip_select_ReturnMemThruPtr_exceptset( &empty_fds, sizeof( fd_set ) );
+    lwip_recv_ExpectAnyArgsAndReturn( 0 );
+    ret = SOCKETS_Poll( &fd, 1, 10 );
+    TEST_ASSERT_EQUAL_INT( 1, ret );
+    TEST_ASSERT_EQUAL_UINT32( SOCKETS_POLLHUP, fd.ulREvents );
+    deinitSocket( fd.xSocket );
+}
+
+/*!
+ * @brief A timeout with nothing to read
+ *
+ * @details The purpose of this testcase is to make sure 0 is returned and no
+ *          event is reported when lwip reports nothing
+ */
+void test_SecureSockets_poll_timeout( void )
+{
+    int32_t ret;
+    fd_set empty_fds;
+    SocketsPollFd_t fd;
+
+    fd.xSocket = create_normal_connection();
+    fd.ulEvents = SOCKETS_POLLIN;
+    FD_ZERO( &empty_fds );
+
+    lwip_select_ExpectAnyArgsAndReturn( 0 );
+    lwip_select_ReturnMemThruPtr_readset( &empty_fds, sizeof( fd_set ) );
+    lwip_select_ReturnMemThruPtr_exceptset( &empty_fds, sizeof( fd_set ) );
+    ret = SOCKETS_Poll( &fd, 1, 10 );
+    TEST_ASSERT_EQUAL_INT( 0, ret );
+    TEST_ASSERT_EQUAL_UINT32( 0, fd.ulREvents );
+    deinitSocket( fd.xSocket );
+}
+
+/*!
+ * @brief A TLS socket with records already read from lwip
+ *
+ * @details The purpose of this testcase is to make sure data buffered by TLS
+ *          is reported with SOCKETS_POLLIN without waiting on lwip
+ */
+void test_SecureSockets_poll_tls_pending( void )
+{
+    int32_t ret;
+    SocketsPollFd_t fd;
+
+    fd.xSocket = create_TLS_connection();
+    fd.ulEvents = SOCKETS_POLLIN;
+
+    TLS_Pending_ExpectAnyArgsAndReturn( pdTRUE );
+    lwip_select_Stub( lwip_select_no_wait_cb );
+    ret = SOCKETS_Poll( &fd, 1, portMAX_DELAY );
+    TEST_ASSERT_EQUAL_INT( 1, ret );
+    TEST_ASSERT_EQUAL_UINT32( SOCKETS_POLLIN, fd.ulREvents );
+    lwip_select_Stub( NULL );
+    TLS_Cleanup_ExpectAnyArgs();
+    deinitSocket( fd.xSocket );
+}
+
+/*!
+ * @brief A socket with room to send
+ *
+ * @details The purpose of this testcase is to make sure a socket that lwip
+ *          reports writable is reported with SOCKETS_POLLOUT when requested
+ */
+void test_SecureSockets_poll_writable( void )
+{
+    int32_t ret;
+    fd_set ready_fds;
+    fd_set empty_fds;
+    SocketsPollFd_t fd;
+
+    fd.xSocket = create_normal_connection();
+    fd.ulEvents = SOCKETS_POLLOUT;
+    FD_ZERO( &ready_fds );
+    FD_ZERO( &empty_fds );
+    FD_SET( 5, &ready_fds );
+
+    lwip_select_ExpectAnyArgsAndReturn( 1 );
+    lwip_select_ReturnMemThruPtr_readset( &empty_fds, sizeof( fd_set ) );
+    lwip_select_ReturnMemThruPtr_writeset( &ready_fds, sizeof( fd_set ) );
+    lwip_select_ReturnMemThruPtr_exceptset( &empty_fds, sizeof( fd_set ) );
+    ret = SOCKETS_Poll( &fd, 1, 10 );
+    TEST_ASSERT_EQUAL_INT( 1, ret );
+    TEST_ASSERT_EQUAL_UINT32( SOCKETS_POLLOUT, fd.ulREvents );
+    deinitSocket( fd.xSocket );
+}
+
+/*!
+ * @brief Test various bad parameters
+ *
+ * @details The purpose of this testcase is to make sure SOCKETS_Poll returns
+ *          errors for invalid parameters, and reports sockets that are not
+ *          connected with SOCKETS_POLLHUP without waiting
+ */
+void test_SecureSockets_poll_invalid_parameters( void )
+{
+    int32_t ret;
+    SocketsPollFd_t fd;
+
+    /* test null array */
+    ret = SOCKETS_Poll( NULL, 1, 0 );
+    TEST_ASSERT_EQUAL_INT( SOCKETS_EINVAL, ret );
+
+    /* test invalid socket */
+    fd.xSocket = SOCKETS_INVALID_SOCKET;
+    fd.ulEvents = SOCKETS_POLLIN;
+    ret = SOCKETS_Poll( &fd, 1, 0 );
+    TEST_ASSERT_EQUAL_INT( SOCKETS_EINVAL, ret );
+
+    /* test not connected */
+    fd.xSocket = initSocket();
+    ret = SOCKETS_Poll( &fd, 1, portMAX_DELAY );
+    TEST_ASSERT_EQUAL_INT( 1, ret );
+    TEST_ASSERT_EQUAL_UINT32( SOCKETS_POLLHUP, fd.ulREvents );
+    deinitSocket( fd.xSocket );
+}
+
 /* =====================  TESTING SOCKETS_Socket  =========================== */
 
 /*!
@@ -523,6 +927,29 @@ void test_SecureSockets_Recv_lwip_error( void )
     deinitSocket( so );
 }
 
+/*!
+ * @brief Receive on an empty non-blocking socket
+ *
+ * The purpose of this testcase is to make sure a non-blocking socket reports
+ * SOCKETS_EWOULDBLOCK instead of 0 when lwip has no data, so that the caller,
+ * and TLS, can tell it apart from a closed connection
+ */
+void test_SecureSockets_Recv_nonblocking_would_block( void )
+{
+    int32_t ret;
+    char buffer[ BUFFER_LEN ];
+    Socket_t so = create_normal_connection();
+
+    setNonBlocking( so );
+
+    lwip_recv_ExpectAnyArgsAndReturn( -1 );
+    errno = EWOULDBLOCK;
+    ret = SOCKETS_Recv( so, buffer, BUFFER_LEN, 0 );
+    TEST_ASSERT_EQUAL_INT( SOCKETS_EWOULDBLOCK, ret );
+
+    deinitSocket( so );
+}
+
 /*!
  * @brief A happy path for TLS socket receive
  *
@@ -1158,6 +1585,51 @@ void test_SecureSockets_SetsockOpt_nonblock_error( void )
     deinitSocket( so );
 }
 
+static BaseType_t xSessionCacheDisabled;
+
+/* helper function to capture the session cache parameter given to TLS_Init */
+static BaseType_t TLS_Init_session_cache_cb( void ** ppvContext,
+                                             TLSParams_t * pxParams,
+                                             int num_calls )
+{
+    xSessionCacheDisabled = pxParams->xDisableSessionCache;
+    return pdFREERTOS_ERRNO_NONE;
+}
+
+/*!
+ * @brief SetSockOpt TLS session cache toggle
+ *
+ * The Purpose of this testcase is to make sure the session cache option is
+ * validated, handed to TLS_Init and refused once the socket is connected
+ */
+void test_SecureSockets_SetSockOpt_TLS_session_cache( void )
+{
+    Socket_t so = SOCKETS_INVALID_SOCKET;
+    int32_t ret;
+    BaseType_t xEnable = pdFALSE;
+
+    so = initSocket();
+    setTLSMode( so );
+
+    ret = SOCKETS_SetSockOpt( so, 0, SOCKETS_SO_TLS_SESSION_CACHE, NULL, 0 );
+    TEST_ASSERT_EQUAL( SOCKETS_EINVAL, ret );
+
+    ret = SOCKETS_SetSockOpt( so, 0, SOCKETS_SO_TLS_SESSION_CACHE, &xEnable, sizeof( xEnable ) );
+    TEST_ASSERT_EQUAL( SOCKETS_ERROR_NONE, ret );
+
+    xSessionCacheDisabled = pdFALSE;
+    TLS_Init_Stub( TLS_Init_session_cache_cb );
+    TLS_Connect_IgnoreAndReturn( pdFREERTOS_ERRNO_NONE );
+    connectSocket( so );
+    TEST_ASSERT_EQUAL( pdTRUE, xSessionCacheDisabled );
+
+    ret = SOCKETS_SetSockOpt( so, 0, SOCKETS_SO_TLS_SESSION_CACHE, &xEnable, sizeof( xEnable ) );
+    TEST_ASSERT_EQUAL( SOCKETS_EISCONN, ret );
+
+    TLS_Cleanup_ExpectAnyArgs();
+    deinitSocket( so );
+}
+
 static TaskHandle_t handle;
 static Socket_t s_so;
 static bool userCallback_called;
@@ -1320,6 +1792,44 @@ void test_SecureSockets_SetSockOpt_wakeup_callback_clear( void )
     deinitSocket( so );
 }
 
+static void readyCallback_cb( Socket_t xSocket,
+                              uint32_t ulREvents,
+                              void * pvContext )
+{
+}
+
+/*!
+ * @brief SetSockOpt SOCKETS_SO_READY_CALLBACK with invalid arguments
+ *
+ * The Purpose of this testcase is to make sure a ready callback is refused
+ * on a socket that is not connected or with the wrong option length, and
+ * that clearing a callback that was never set succeeds
+ */
+void test_SecureSockets_SetSockOpt_ready_callback_invalid( void )
+{
+    Socket_t so = SOCKETS_INVALID_SOCKET;
+    int32_t ret;
+    SocketsReadyNotification_t notification = { readyCallback_cb, NULL, SOCKETS_POLLIN };
+
+    so = initSocket();
+
+    ret = SOCKETS_SetSockOpt( so, 0, SOCKETS_SO_READY_CALLBACK,
+                              &notification, sizeof( notification ) );
+    TEST_ASSERT_EQUAL( SOCKETS_ENOTCONN, ret );
+
+    connectSocket( so );
+
+    ret = SOCKETS_SetSockOpt( so, 0, SOCKETS_SO_READY_CALLBACK,
+                              &notification, sizeof( void * ) );
+    TEST_ASSERT_EQUAL( SOCKETS_EINVAL, ret );
+
+    ret = SOCKETS_SetSockOpt( so, 0, SOCKETS_SO_READY_CALLBACK,
+                              NULL, 0 );
+    TEST_ASSERT_EQUAL( SOCKETS_ERROR_NONE, ret );
+
+    deinitSocket( so );
+}
+
 /* Helper function for alpn memory
  * since alpn is trying to allocate a 2d array
  * we simulate that the first memory allocation passes but the second one fails
@@ -270,6 +270,20 @@ static int32_t tlsSetup( const SocketsConfig_t * pSocketsConfig,
         }
     }
 
+    /* Start loading the credentials while the server name is resolved and the
+     * TCP connection is established. The handshake loads them if this fails. */
+    if( secureSocketStatus == SOCKETS_ERROR_NONE )
+    {
+        if( SOCKETS_SetSockOpt( tcpSocket,
+                                0,
+                                SOCKETS_SO_TLS_PREPARE,
+                                NULL,
+                                0 ) != ( int32_t ) SOCKETS_ERROR_NONE )
+        {
+            LogDebug( ( "Credentials not loaded ahead of the TLS handshake." ) );
+        }
+    }
+
     return secureSocketStatus;
 }
 
@@ -311,6 +311,9 @@ void AwsIotDefender_Stop( void )
         /* Delete report if it was created */
         AwsIotDefenderInternal_DeleteReport();
 
+        /* Start from a full report next time. */
+        AwsIotDefenderInternal_ResetReportHistory();
+
         /* Reset _startInfo to empty; otherwise next time defender might start with incorrect information. */
         _startInfo = ( AwsIotDefenderStartInfo_t ) AWS_IOT_DEFENDER_START_INFO_INITIALIZER;
 
@@ -547,6 +550,8 @@ void _acceptCallback( void * pArgument,
 
     /* Invoke user's callback with accept event. */
     _handleApplicationCallback( AWS_IOT_DEFENDER_METRICS_ACCEPTED, pPublish );
+    /* The next report only needs what changed since this one. */
+    AwsIotDefenderInternal_ReportAccepted();
     /* Delete report if exists */
     AwsIotDefenderInternal_DeleteReport();
 }
@@ -567,6 +572,8 @@ void _rejectCallback( void * pArgument,
     _handleApplicationCallback( AWS_IOT_DEFENDER_METRICS_REJECTED, pPublish );
     /* Delete report if exists */
     AwsIotDefenderInternal_DeleteReport();
+    /* The rejected report cannot serve as a baseline; send a full report next. */
+    AwsIotDefenderInternal_ResetReportHistory();
 }
 
 /*-----------------------------------------------------------*/
@@ -25,6 +25,7 @@
 
 /* Standard includes */
 #include <stdio.h>
+#include <string.h>
 
 /* Defender internal include. */
 #include "private/aws_iot_defender_internal.h"
@@ -48,6 +49,13 @@
 #define CONN_TAG            AwsIotDefenderInternal_SelectTag( "connections", "cs" )
 #define REMOTE_ADDR_TAG     AwsIotDefenderInternal_SelectTag( "remote_addr", "rad" )
 
+/* Extra bytes allocated on top of the previous report's size, so that small
+ * growth between periods does not need a second serialization. */
+#define REPORT_SIZE_MARGIN    ( 32 )
+
+/* Number of snapshots kept in the ring; the current period and the previous one. */
+#define SNAPSHOT_RING_SIZE    ( 2 )
+
 /**
  * Structure to hold a metrics report.
  */
@@ -56,16 +64,48 @@ typedef struct _metricsReport
     IotSerializerEncoderObject_t object; /* Encoder object handle. */
     uint8_t * pDataBuffer;               /* Raw data buffer to be published with MQTT. */
     size_t size;                         /* Raw data size. */
+    bool sizeEstimated;                  /* Whether size is an estimate from the previous report. */
 } _metricsReport_t;
 
 /* Initialize metrics report. */
 static _metricsReport_t _report =
 {
-    .object      = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_STREAM,
-    .pDataBuffer = NULL,
-    .size        = 0
+    .object        = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_STREAM,
+    .pDataBuffer   = NULL,
+    .size          = 0,
+    .sizeEstimated = false
 };
 
+/* Encoded size of the previous report; 0 if there is none. */
+static size_t _previousReportSize = 0;
+
+#if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1
+
+/**
+ * Structure to hold the TCP connections of one period.
+ */
+    typedef struct _connectionsSnapshot
+    {
+        size_t total;                                         /* Number of connections reported by the platform. */
+        size_t count;                                         /* Number of connections copied; less than total on overflow. */
+        uint32_t pAddressHash[ AWS_IOT_DEFENDER_INCREMENTAL_MAX_CONNECTIONS ];
+        char pRemoteAddress[ AWS_IOT_DEFENDER_INCREMENTAL_MAX_CONNECTIONS ][ IOT_METRICS_IP_ADDRESS_LENGTH ];
+    } _connectionsSnapshot_t;
+
+/* Ring of TCP connection snapshots. */
+    static _connectionsSnapshot_t _snapshotRing[ SNAPSHOT_RING_SIZE ];
+
+/* Index of the snapshot of the current period in _snapshotRing. */
+    static uint32_t _snapshotIndex = 0;
+
+/* Whether the previous snapshot in _snapshotRing was reported and accepted. */
+    static bool _hasPreviousSnapshot = false;
+#endif /* if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1 */
+
+/* Provides the TCP connections. Replaced by the tests. */
+static void ( * _getTcpConnections )( void * pContext,
+                                      void ( * metricsCallback )( void *, const IotListDouble_t * ) ) = IotMetrics_GetTcpConnections;
+
 /* Define a "snapshot" global array of metrics flag. */
 static uint32_t _metricsFlagSnapshot[ DEFENDER_METRICS_GROUP_COUNT ];
 
@@ -88,6 +128,22 @@ static void serializeReport( void );
 static void _serializeTcpConnections( void * param1,
                                       const IotListDouble_t * pTcpConnectionsMetricsList );
 
+static bool _serializeInBuffer( size_t dataSize,
+                                bool sizeEstimated );
+
+#if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1
+    static uint32_t _hashAddress( const char * pAddress );
+
+    static void _snapshotTcpConnections( void * param1,
+                                         const IotListDouble_t * pTcpConnectionsMetricsList );
+
+    static bool _findNewConnections( const _connectionsSnapshot_t * pPrevious,
+                                     const _connectionsSnapshot_t * pCurrent,
+                                     bool * pIsNew );
+
+    static void _serializeTcpConnectionsDelta( IotSerializerEncoderObject_t * pMetricsObject );
+#endif
+
 #if DEBUG_CBOR_PRINT == 1
     static void _printReport();
 #endif
@@ -136,7 +192,6 @@ bool AwsIotDefenderInternal_CreateReport( void )
     IotSerializerEncoderObject_t * pEncoderObject = &( _report.object );
 
     size_t dataSize = 0;
-    uint8_t * pReportBuffer = NULL;
 
     /* Copy the metrics flag user specified. */
     _copyMetricsFlag();
@@ -144,34 +199,86 @@ bool AwsIotDefenderInternal_CreateReport( void )
     /* Generate report id based on current time. */
     _AwsIotDefenderReportId = IotClock_GetTimeMs();
 
-    /* Dry-run serialization to calculate the required size. */
-    serializeReport();
+    #if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1
+        /* Take this period's snapshot once, so that every serialization pass
+         * reports the same connections. */
+        if( _metricsFlagSnapshot[ AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS ] )
+        {
+            _getTcpConnections( ( void * ) &_snapshotRing[ _snapshotIndex ], _snapshotTcpConnections );
+        }
+    #endif
 
-    /* Get the calculated required size. */
-    dataSize = _pAwsIotDefenderEncoder->getExtraBufferSizeNeeded( pEncoderObject );
+    if( _previousReportSize > 0 )
+    {
+        /* Metrics change little between periods. Size the buffer from the
+         * previous report instead of running a dry-run serialization. */
+        dataSize = _previousReportSize + REPORT_SIZE_MARGIN;
 
-    /* Clean the encoder object handle. */
-    _pAwsIotDefenderEncoder->destroy( pEncoderObject );
+        result = _serializeInBuffer( dataSize, true );
 
-    /* Allocate memory once. */
-    pReportBuffer = AwsIotDefender_MallocReport( dataSize * sizeof( uint8_t ) );
+        /* Check whether the report outgrew the estimate. */
+        if( result )
+        {
+            dataSize += _pAwsIotDefenderEncoder->getExtraBufferSizeNeeded( pEncoderObject );
 
-    if( pReportBuffer != NULL )
-    {
-        _report.pDataBuffer = pReportBuffer;
-        _report.size = dataSize;
+            if( dataSize > _report.size )
+            {
+                IotLogDebug( "Metrics report needs %lu bytes, more than the estimated %lu. Serializing again.",
+                             ( unsigned long ) dataSize,
+                             ( unsigned long ) _report.size );
+
+                AwsIotDefenderInternal_DeleteReport();
 
-        /* Actual serialization. */
+                result = _serializeInBuffer( dataSize, false );
+            }
+        }
+    }
+    else
+    {
+        /* Dry-run serialization to calculate the required size. */
         serializeReport();
 
+        /* Get the calculated required size. */
+        dataSize = _pAwsIotDefenderEncoder->getExtraBufferSizeNeeded( pEncoderObject );
+
+        /* Clean the encoder object handle. */
+        _pAwsIotDefenderEncoder->destroy( pEncoderObject );
+
+        /* Allocate memory once and do the actual serialization. */
+        result = _serializeInBuffer( dataSize, false );
+    }
+
+    if( result )
+    {
+        /* Remember the size of this report for the next period. */
+        _previousReportSize = AwsIotDefenderInternal_GetReportBufferSize();
+
         /* Ouput the report to stdout if debugging mode is enabled. */
         #if DEBUG_CBOR_PRINT == 1
             _printReport();
         #endif
     }
-    else
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _serializeInBuffer( size_t dataSize,
+                                bool sizeEstimated )
+{
+    bool result = false;
+    uint8_t * pReportBuffer = AwsIotDefender_MallocReport( dataSize * sizeof( uint8_t ) );
+
+    if( pReportBuffer != NULL )
     {
-        result = false;
+        _report.pDataBuffer = pReportBuffer;
+        _report.size = dataSize;
+        _report.sizeEstimated = sizeEstimated;
+
+        serializeReport();
+
+        result = true;
     }
 
     return result;
@@ -190,9 +297,34 @@ void AwsIotDefenderInternal_DeleteReport( void )
     /* Reset report members. */
     _report.pDataBuffer = NULL;
     _report.size = 0;
+    _report.sizeEstimated = false;
     _report.object = ( IotSerializerEncoderObject_t ) IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_STREAM;
 }
 
+/*-----------------------------------------------------------*/
+
+void AwsIotDefenderInternal_ReportAccepted( void )
+{
+    #if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1
+        /* The service has this period's connections, so its snapshot becomes
+         * the previous one. Until then the next report is still a delta
+         * against the last accepted report. */
+        _snapshotIndex = ( _snapshotIndex + 1 ) % SNAPSHOT_RING_SIZE;
+        _hasPreviousSnapshot = ( _metricsFlagSnapshot[ AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS ] > 0 );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+void AwsIotDefenderInternal_ResetReportHistory( void )
+{
+    _previousReportSize = 0;
+
+    #if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1
+        _hasPreviousSnapshot = false;
+    #endif
+}
+
 /*
  * report:
  * {
@@ -215,8 +347,9 @@ static void serializeReport( void )
     IotSerializerEncoderObject_t headerMap = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
     IotSerializerEncoderObject_t metricsMap = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
 
-    /* Define an assert function for serialization returned error. */
-    void (* assertNoError)( IotSerializerError_t ) = _report.pDataBuffer == NULL ? _assertSuccessOrBufferToSmall
+    /* Define an assert function for serialization returned error. A dry-run or
+     * a buffer sized from the previous report may run out of space. */
+    void (* assertNoError)( IotSerializerError_t ) = ( _report.pDataBuffer == NULL ) || _report.sizeEstimated ? _assertSuccessOrBufferToSmall
                                                      : _assertSuccess;
 
     uint8_t metricsGroupCount = 0;
@@ -273,7 +406,15 @@ static void serializeReport( void )
             switch( i )
             {
                 case AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS:
-                    IotMetrics_GetTcpConnections( ( void * ) &metricsMap, _serializeTcpConnections );
+                    #if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1
+                        /* Report the snapshot unless it overflowed. */
+                        if( _snapshotRing[ _snapshotIndex ].count == _snapshotRing[ _snapshotIndex ].total )
+                        {
+                            _serializeTcpConnectionsDelta( &metricsMap );
+                            break;
+                        }
+                    #endif
+                    _getTcpConnections( ( void * ) &metricsMap, _serializeTcpConnections );
                     break;
 
                 default:
@@ -334,7 +475,7 @@ static void _serializeTcpConnections( void * param1,
     uint8_t hasTotal = ( tcpConnFlag & AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED_TOTAL ) > 0;
     uint8_t hasRemoteAddr = ( tcpConnFlag & AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED_REMOTE_ADDR ) > 0;
 
-    void (* assertNoError)( IotSerializerError_t ) = _report.pDataBuffer == NULL ? _assertSuccessOrBufferToSmall
+    void (* assertNoError)( IotSerializerError_t ) = ( _report.pDataBuffer == NULL ) || _report.sizeEstimated ? _assertSuccessOrBufferToSmall
                                                      : _assertSuccess;
 
     /* Create the "tcp_connections" map with 1 key "established_connections" */
@@ -408,6 +549,211 @@ static void _serializeTcpConnections( void * param1,
     assertNoError( serializerError );
 }
 
+#if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t _hashAddress( const char * pAddress )
+    {
+        uint32_t hash = 2166136261UL;
+
+        /* FNV-1a hash of the NULL-terminated address. */
+        while( *pAddress != '\0' )
+        {
+            hash ^= ( uint32_t ) ( uint8_t ) *pAddress;
+            hash *= 16777619UL;
+            pAddress++;
+        }
+
+        return hash;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void _snapshotTcpConnections( void * param1,
+                                         const IotListDouble_t * pTcpConnectionsMetricsList )
+    {
+        _connectionsSnapshot_t * pSnapshot = ( _connectionsSnapshot_t * ) param1;
+
+        AwsIotDefender_Assert( pSnapshot != NULL );
+
+        IotLink_t * pListIterator = NULL;
+        IotMetricsTcpConnection_t * pMetricsTcpConnection = NULL;
+
+        pSnapshot->total = IotListDouble_Count( pTcpConnectionsMetricsList );
+        pSnapshot->count = 0;
+
+        IotContainers_ForEach( pTcpConnectionsMetricsList, pListIterator )
+        {
+            /* Stop copying when the snapshot is full; the total is still recorded. */
+            if( pSnapshot->count == AWS_IOT_DEFENDER_INCREMENTAL_MAX_CONNECTIONS )
+            {
+                break;
+            }
+
+            pMetricsTcpConnection = IotLink_Container( IotMetricsTcpConnection_t, pListIterator, link );
+
+            ( void ) strncpy( pSnapshot->pRemoteAddress[ pSnapshot->count ],
+                              pMetricsTcpConnection->pRemoteAddress,
+                              IOT_METRICS_IP_ADDRESS_LENGTH - 1 );
+            pSnapshot->pRemoteAddress[ pSnapshot->count ][ IOT_METRICS_IP_ADDRESS_LENGTH - 1 ] = '\0';
+            pSnapshot->pAddressHash[ pSnapshot->count ] = _hashAddress( pSnapshot->pRemoteAddress[ pSnapshot->count ] );
+
+            pSnapshot->count++;
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static bool _findNewConnections( const _connectionsSnapshot_t * pPrevious,
+                                     const _connectionsSnapshot_t * pCurrent,
+                                     bool * pIsNew )
+    {
+        /* An overflowed snapshot was reported in full, but only its first
+         * entries are known, so it can't tell which connections closed. */
+        bool allOpen = ( pPrevious->count == pPrevious->total );
+        bool found = false;
+        size_t i = 0, j = 0;
+
+        for( i = 0; i < pCurrent->count; i++ )
+        {
+            pIsNew[ i ] = true;
+        }
+
+        /* Match every previous connection with a different current one, so
+         * that two connections to the same address are counted as two. */
+        for( i = 0; ( i < pPrevious->count ) && allOpen; i++ )
+        {
+            found = false;
+
+            for( j = 0; ( j < pCurrent->count ) && ( !found ); j++ )
+            {
+                found = pIsNew[ j ] &&
+                        ( pCurrent->pAddressHash[ j ] == pPrevious->pAddressHash[ i ] ) &&
+                        ( strcmp( pCurrent->pRemoteAddress[ j ], pPrevious->pRemoteAddress[ i ] ) == 0 );
+                pIsNew[ j ] = !found && pIsNew[ j ];
+            }
+
+            allOpen = found;
+        }
+
+        return allOpen;
+    }
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Same layout as _serializeTcpConnections, but "connections" only lists the
+ * connections that were opened since the previous snapshot, and "total" is
+ * omitted if it did not change. The schema has no way to remove a connection,
+ * so once one of the previous connections has closed, the report lists all
+ * connections like a full report.
+ */
+    static void _serializeTcpConnectionsDelta( IotSerializerEncoderObject_t * pMetricsObject )
+    {
+        IotSerializerError_t serializerError = IOT_SERIALIZER_SUCCESS;
+
+        IotSerializerEncoderObject_t tcpConnectionMap = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+        IotSerializerEncoderObject_t establishedMap = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+        IotSerializerEncoderObject_t connectionsArray = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_ARRAY;
+
+        const _connectionsSnapshot_t * pCurrent = &_snapshotRing[ _snapshotIndex ];
+        const _connectionsSnapshot_t * pPrevious = _hasPreviousSnapshot ?
+                                                   &_snapshotRing[ ( _snapshotIndex + SNAPSHOT_RING_SIZE - 1 ) % SNAPSHOT_RING_SIZE ] : NULL;
+
+        bool pIsChanged[ AWS_IOT_DEFENDER_INCREMENTAL_MAX_CONNECTIONS ] = { false };
+        bool isFull = ( pPrevious == NULL ) || !_findNewConnections( pPrevious, pCurrent, pIsChanged );
+        size_t changed = 0;
+        size_t i = 0;
+
+        uint32_t tcpConnFlag = _metricsFlagSnapshot[ AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS ];
+
+        /* Count the connections to report. */
+        for( i = 0; i < pCurrent->count; i++ )
+        {
+            pIsChanged[ i ] = pIsChanged[ i ] || isFull;
+            changed += pIsChanged[ i ];
+        }
+
+        uint8_t hasEstablishedConnections = ( tcpConnFlag & AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED ) > 0;
+        uint8_t hasConnections = ( tcpConnFlag & AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED_CONNECTIONS ) > 0 &&
+                                 ( changed > 0 );
+        uint8_t hasTotal = ( tcpConnFlag & AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED_TOTAL ) > 0 &&
+                           ( isFull || ( pPrevious->total != pCurrent->total ) );
+        uint8_t hasRemoteAddr = ( tcpConnFlag & AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED_REMOTE_ADDR ) > 0;
+
+        void (* assertNoError)( IotSerializerError_t ) = ( _report.pDataBuffer == NULL ) || _report.sizeEstimated ? _assertSuccessOrBufferToSmall
+                                                         : _assertSuccess;
+
+        /* Create the "tcp_connections" map with 1 key "established_connections" */
+        serializerError = _pAwsIotDefenderEncoder->openContainerWithKey( pMetricsObject,
+                                                                         TCP_CONN_TAG,
+                                                                         &tcpConnectionMap,
+                                                                         1 );
+        assertNoError( serializerError );
+
+        if( hasEstablishedConnections )
+        {
+            serializerError = _pAwsIotDefenderEncoder->openContainerWithKey( &tcpConnectionMap,
+                                                                             EST_CONN_TAG,
+                                                                             &establishedMap,
+                                                                             hasConnections + hasTotal );
+            assertNoError( serializerError );
+
+            if( hasConnections )
+            {
+                serializerError = _pAwsIotDefenderEncoder->openContainerWithKey( &establishedMap,
+                                                                                 CONN_TAG,
+                                                                                 &connectionsArray,
+                                                                                 changed );
+                assertNoError( serializerError );
+
+                for( i = 0; i < pCurrent->count; i++ )
+                {
+                    IotSerializerEncoderObject_t connectionMap = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+
+                    if( !pIsChanged[ i ] )
+                    {
+                        continue;
+                    }
+
+                    serializerError = _pAwsIotDefenderEncoder->openContainer( &connectionsArray,
+                                                                              &connectionMap,
+                                                                              hasRemoteAddr );
+                    assertNoError( serializerError );
+
+                    if( hasRemoteAddr )
+                    {
+                        serializerError = _pAwsIotDefenderEncoder->appendKeyValue( &connectionMap, REMOTE_ADDR_TAG,
+                                                                                   IotSerializer_ScalarTextString( pCurrent->pRemoteAddress[ i ] ) );
+                        assertNoError( serializerError );
+                    }
+
+                    serializerError = _pAwsIotDefenderEncoder->closeContainer( &connectionsArray, &connectionMap );
+                    assertNoError( serializerError );
+                }
+
+                serializerError = _pAwsIotDefenderEncoder->closeContainer( &establishedMap, &connectionsArray );
+                assertNoError( serializerError );
+            }
+
+            if( hasTotal )
+            {
+                serializerError = _pAwsIotDefenderEncoder->appendKeyValue( &establishedMap,
+                                                                           TOTAL_TAG,
+                                                                           IotSerializer_ScalarSignedInt( pCurrent->total ) );
+                assertNoError( serializerError );
+            }
+
+            serializerError = _pAwsIotDefenderEncoder->closeContainer( &tcpConnectionMap, &establishedMap );
+            assertNoError( serializerError );
+        }
+
+        serializerError = _pAwsIotDefenderEncoder->closeContainer( pMetricsObject, &tcpConnectionMap );
+        assertNoError( serializerError );
+    }
+#endif /* if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1 */
+
 #if DEBUG_CBOR_PRINT == 1
     #include "cbor.h"
     /*-----------------------------------------------------------*/
@@ -426,3 +772,10 @@ static void _serializeTcpConnections( void * param1,
         cbor_value_to_pretty( stdout, &cborValue );
     }
 #endif /* if DEBUG_CBOR_PRINT == 1 */
+
+/*-----------------------------------------------------------*/
+
+/* Provide access to internal functions and variables if testing. */
+#if IOT_BUILD_TESTS == 1
+    #include "aws_iot_test_access_defender_collector.c"
+#endif
@@ -207,6 +207,30 @@
  *
  * <b>Possible values:</b>  greater than 0 <br>
  * <b>Default value (if undefined):</b>  `10` <br>
+ *
+ * @section AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT
+ * @brief Report only the metrics that changed since the previous report.
+ *
+ * When enabled, TCP connections are copied into a fixed ring of snapshots once
+ * per period. A report then lists only the connections that were opened since
+ * the last accepted report, and includes the connection total only when it
+ * changed. The report schema cannot remove a connection, so a report is full
+ * once any connection of the last accepted report has closed. The first report
+ * after start, after a rejected report, or from a period with more connections
+ * than @ref AWS_IOT_DEFENDER_INCREMENTAL_MAX_CONNECTIONS is a full report as
+ * well.
+ *
+ * <b>Possible values:</b>  `0` or `1` <br>
+ * <b>Recommended values:</b> 1 on devices with many long-lived sockets, if the
+ * consumer of the reports accumulates them. <br>
+ * <b>Default value (if undefined):</b> `0` <br>
+ *
+ * @section AWS_IOT_DEFENDER_INCREMENTAL_MAX_CONNECTIONS
+ * @brief The number of TCP connections held by each snapshot when
+ * @ref AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT is enabled.
+ *
+ * <b>Possible values:</b>  greater than 0 <br>
+ * <b>Default value (if undefined):</b>  `16` <br>
  */
 
 #ifndef AWS_IOT_DEFENDER_DEFAULT_PERIOD_SECONDS
@@ -243,6 +267,14 @@
     #define AWS_IOT_DEFENDER_USE_LONG_TAG    ( 0 )
 #endif
 
+#ifndef AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT
+    #define AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT    ( 0 )
+#endif
+
+#ifndef AWS_IOT_DEFENDER_INCREMENTAL_MAX_CONNECTIONS
+    #define AWS_IOT_DEFENDER_INCREMENTAL_MAX_CONNECTIONS    ( 16 )
+#endif
+
 /*----------------- Below this line is INTERNAL used only --------------------*/
 
 /* This MUST be consistent with enum AwsIotDefenderMetricsGroup_t. */
@@ -312,6 +344,18 @@ size_t AwsIotDefenderInternal_GetReportBufferSize( void );
  */
 void AwsIotDefenderInternal_DeleteReport( void );
 
+/**
+ * Make the report that was accepted by the service the baseline of the next
+ * incremental report.
+ */
+void AwsIotDefenderInternal_ReportAccepted( void );
+
+/**
+ * Forget the previous report, so that the next report is sized by a dry-run
+ * and, for incremental reports, contains all metrics.
+ */
+void AwsIotDefenderInternal_ResetReportHistory( void );
+
 /**
  * Build three topics names used by defender library.
  */
@@ -0,0 +1,71 @@
+/*
+ * FreeRTOS Defender V3.0.2
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_iot_test_access_defender.h
+ * @brief Declares the functions that provide access to the internal functions
+ * and variables of the Defender library.
+ */
+
+#ifndef AWS_IOT_TEST_ACCESS_DEFENDER_H_
+#define AWS_IOT_TEST_ACCESS_DEFENDER_H_
+
+/*------------------- aws_iot_defender_collector.c ----------------------*/
+
+/**
+ * @brief The most TCP connections that can be passed to
+ * #AwsIotTestDefender_SetTcpConnections.
+ */
+#define AWS_IOT_TEST_DEFENDER_MAX_CONNECTIONS    ( 32 )
+
+/**
+ * @brief Make the collector report the given TCP connections instead of those
+ * of the platform.
+ *
+ * @param[in] ppRemoteAddresses The remote address of each connection, or NULL
+ * to report the connections of the platform again.
+ * @param[in] count Number of connections.
+ */
+void AwsIotTestDefender_SetTcpConnections( const char * const * ppRemoteAddresses,
+                                           size_t count );
+
+/**
+ * @brief Get the size of the buffer allocated for the current report.
+ */
+size_t AwsIotTestDefender_GetReportAllocatedSize( void );
+
+/**
+ * @brief Whether the buffer of the current report was sized from the
+ * previous report.
+ */
+bool AwsIotTestDefender_IsReportSizeEstimated( void );
+
+/**
+ * @brief Set the encoded size of the previous report, from which the buffer of
+ * the next report is sized.
+ */
+void AwsIotTestDefender_SetPreviousReportSize( size_t size );
+
+#endif /* ifndef AWS_IOT_TEST_ACCESS_DEFENDER_H_ */
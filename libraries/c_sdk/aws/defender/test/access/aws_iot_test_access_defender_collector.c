@@ -0,0 +1,100 @@
+/*
+ * FreeRTOS Defender V3.0.2
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_iot_test_access_defender_collector.c
+ * @brief Provides access to the internal functions and variables of
+ * aws_iot_defender_collector.c
+ *
+ * This file should only be included at the bottom of aws_iot_defender_collector.c
+ * and never compiled by itself.
+ */
+
+#include "aws_iot_test_access_defender.h"
+
+/* The connections set by AwsIotTestDefender_SetTcpConnections. */
+static IotMetricsTcpConnection_t _testConnections[ AWS_IOT_TEST_DEFENDER_MAX_CONNECTIONS ];
+static IotListDouble_t _testConnectionList = IOT_LIST_DOUBLE_INITIALIZER;
+
+/*-----------------------------------------------------------*/
+
+static void _getTestTcpConnections( void * pContext,
+                                    void ( * metricsCallback )( void *, const IotListDouble_t * ) )
+{
+    metricsCallback( pContext, &_testConnectionList );
+}
+
+/*-----------------------------------------------------------*/
+
+void AwsIotTestDefender_SetTcpConnections( const char * const * ppRemoteAddresses,
+                                           size_t count )
+{
+    size_t i = 0;
+
+    AwsIotDefender_Assert( count <= AWS_IOT_TEST_DEFENDER_MAX_CONNECTIONS );
+
+    IotListDouble_Create( &_testConnectionList );
+
+    if( ppRemoteAddresses == NULL )
+    {
+        _getTcpConnections = IotMetrics_GetTcpConnections;
+    }
+    else
+    {
+        for( i = 0; i < count; i++ )
+        {
+            ( void ) memset( &_testConnections[ i ], 0x00, sizeof( IotMetricsTcpConnection_t ) );
+            ( void ) strncpy( _testConnections[ i ].pRemoteAddress, ppRemoteAddresses[ i ], IOT_METRICS_IP_ADDRESS_LENGTH - 1 );
+            _testConnections[ i ].addressLength = strlen( _testConnections[ i ].pRemoteAddress );
+
+            IotListDouble_InsertTail( &_testConnectionList, &( _testConnections[ i ].link ) );
+        }
+
+        _getTcpConnections = _getTestTcpConnections;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+size_t AwsIotTestDefender_GetReportAllocatedSize( void )
+{
+    return _report.size;
+}
+
+/*-----------------------------------------------------------*/
+
+bool AwsIotTestDefender_IsReportSizeEstimated( void )
+{
+    return _report.sizeEstimated;
+}
+
+/*-----------------------------------------------------------*/
+
+void AwsIotTestDefender_SetPreviousReportSize( size_t size )
+{
+    _previousReportSize = size;
+}
+
+/*-----------------------------------------------------------*/
@@ -29,6 +29,9 @@
 /* Defender internal includes. */
 #include "private/aws_iot_defender_internal.h"
 
+/* Test access include. */
+#include "aws_iot_test_access_defender.h"
+
 /* MQTT Mock include */
 #include "iot_tests_mqtt_mock.h"
 
@@ -57,6 +60,18 @@
  */
 #define AWS_IOT_DEFENDER_DEFAULT_INVALID_METRICS_GROUP    ( 10 )
 
+/**
+ * @brief Remote addresses of the TCP connections reported by the collector tests.
+ */
+#define REMOTE_ADDR_A                                     "192.168.0.1:8883"
+#define REMOTE_ADDR_B                                     "192.168.0.2:443"
+#define REMOTE_ADDR_C                                     "10.0.0.3:1883"
+
+/**
+ * @brief Passed to _verifyTcpConnections when "total" must not be in the report.
+ */
+#define NO_TOTAL                                          ( -1 )
+
 /* Empty callback structure passed to startInfo. */
 static const AwsIotDefenderCallback_t _emptyCallback = { .function = NULL, .pCallbackContext = NULL };
 
@@ -67,8 +82,21 @@ static IotMqttConnection_t _mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
 static AwsIotDefenderStartInfo_t _startInfo = AWS_IOT_DEFENDER_START_INFO_INITIALIZER;
 
 static bool _mockedMqttConnection = false;
+
+static bool _collectorSetUp = false;
+
 /*------------------ Functions -----------------------------*/
 
+static void _setUpCollector( void );
+
+static void _createReport( const char * const * ppRemoteAddresses,
+                           size_t count );
+
+static void _verifyTcpConnections( const char * const * ppExpectedAddresses,
+                                   size_t expectedCount,
+                                   int expectedTotal );
+
+
 TEST_GROUP( Defender_Unit );
 
 TEST_SETUP( Defender_Unit )
@@ -105,6 +133,16 @@ TEST_TEAR_DOWN( Defender_Unit )
         _mockedMqttConnection = false;
     }
 
+    if( _collectorSetUp )
+    {
+        AwsIotDefenderInternal_DeleteReport();
+        AwsIotDefenderInternal_ResetReportHistory();
+        AwsIotTestDefender_SetTcpConnections( NULL, 0 );
+        memset( _AwsIotDefenderMetrics.metricsFlag, 0, sizeof( _AwsIotDefenderMetrics.metricsFlag ) );
+        IotMutex_Destroy( &_AwsIotDefenderMetrics.mutex );
+        _collectorSetUp = false;
+    }
+
     IotMetrics_Cleanup();
     IotMqtt_Cleanup();
     IotSdk_Cleanup();
@@ -183,6 +221,37 @@ TEST_GROUP_RUNNER( Defender_Unit )
      * Expectation: Start API return "already started" error
      */
     RUN_TEST_CASE( Defender_Unit, Start_should_return_err_if_already_started );
+
+    /*
+     * Setup: a first report was created
+     * Action: create a second report with the same metrics
+     * Expectation: its buffer is sized from the first report without a dry-run
+     */
+    RUN_TEST_CASE( Defender_Unit, Report_sized_from_previous_report );
+
+    /*
+     * Setup: the previous report was much smaller
+     * Action: create a report
+     * Expectation: the report is serialized again into a buffer of the right size
+     */
+    RUN_TEST_CASE( Defender_Unit, Report_serialized_again_when_estimate_too_small );
+
+    #if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1
+
+        /*
+         * Setup: a report was accepted
+         * Action: open a connection and create reports before and after the next one is accepted
+         * Expectation: only the new connection and the new total are reported until accepted
+         */
+        RUN_TEST_CASE( Defender_Unit, Report_incremental_lists_new_connections );
+
+        /*
+         * Setup: a report was accepted
+         * Action: close a connection and create a report
+         * Expectation: the report lists all connections and the total
+         */
+        RUN_TEST_CASE( Defender_Unit, Report_incremental_full_after_close );
+    #endif
 }
 
 TEST( Defender_Unit, SetMetrics_with_invalid_metrics_group )
@@ -299,3 +368,213 @@ TEST( Defender_Unit, SetPeriod_after_started )
 
     TEST_ASSERT_EQUAL( 2 * AWS_IOT_DEFENDER_DEFAULT_PERIOD_SECONDS, AwsIotDefender_GetPeriod() );
 }
+
+/*-----------------------------------------------------------*/
+
+TEST( Defender_Unit, Report_sized_from_previous_report )
+{
+    const char * const pAddresses[] = { REMOTE_ADDR_A, REMOTE_ADDR_B };
+    size_t firstReportSize = 0;
+
+    _setUpCollector();
+
+    /* The first report is sized by a dry-run. */
+    _createReport( pAddresses, 2 );
+    TEST_ASSERT_FALSE( AwsIotTestDefender_IsReportSizeEstimated() );
+    firstReportSize = AwsIotDefenderInternal_GetReportBufferSize();
+    TEST_ASSERT_TRUE( AwsIotTestDefender_GetReportAllocatedSize() >= firstReportSize );
+    _verifyTcpConnections( pAddresses, 2, 2 );
+    AwsIotDefenderInternal_DeleteReport();
+
+    /* The second one reuses its size, with a margin. */
+    _createReport( pAddresses, 2 );
+    TEST_ASSERT_TRUE( AwsIotTestDefender_IsReportSizeEstimated() );
+    TEST_ASSERT_GREATER_THAN( firstReportSize, AwsIotTestDefender_GetReportAllocatedSize() );
+    TEST_ASSERT_EQUAL( firstReportSize, AwsIotDefenderInternal_GetReportBufferSize() );
+    _verifyTcpConnections( pAddresses, 2, 2 );
+}
+
+/*-----------------------------------------------------------*/
+
+TEST( Defender_Unit, Report_serialized_again_when_estimate_too_small )
+{
+    const char * const pAddresses[] = { REMOTE_ADDR_A, REMOTE_ADDR_B, REMOTE_ADDR_C };
+
+    _setUpCollector();
+
+    /* Far too small for three connections, even with the margin. */
+    AwsIotTestDefender_SetPreviousReportSize( 1 );
+
+    _createReport( pAddresses, 3 );
+
+    /* The second serialization is into a buffer sized by the encoder. */
+    TEST_ASSERT_FALSE( AwsIotTestDefender_IsReportSizeEstimated() );
+    TEST_ASSERT_TRUE( AwsIotTestDefender_GetReportAllocatedSize() >= AwsIotDefenderInternal_GetReportBufferSize() );
+    _verifyTcpConnections( pAddresses, 3, 3 );
+}
+
+/*-----------------------------------------------------------*/
+
+#if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1
+    TEST( Defender_Unit, Report_incremental_lists_new_connections )
+    {
+        const char * const pAddresses[] = { REMOTE_ADDR_A, REMOTE_ADDR_B, REMOTE_ADDR_C };
+        const char * const pNewAddresses[] = { REMOTE_ADDR_C };
+
+        _setUpCollector();
+
+        _createReport( pAddresses, 2 );
+        _verifyTcpConnections( pAddresses, 2, 2 );
+        AwsIotDefenderInternal_ReportAccepted();
+        AwsIotDefenderInternal_DeleteReport();
+
+        /* A connection was opened. */
+        _createReport( pAddresses, 3 );
+        _verifyTcpConnections( pNewAddresses, 1, 3 );
+        AwsIotDefenderInternal_DeleteReport();
+
+        /* That report was not accepted, so the next one is still a delta from
+         * the first. */
+        _createReport( pAddresses, 3 );
+        _verifyTcpConnections( pNewAddresses, 1, 3 );
+        AwsIotDefenderInternal_ReportAccepted();
+        AwsIotDefenderInternal_DeleteReport();
+
+        /* Nothing changed since the accepted report. */
+        _createReport( pAddresses, 3 );
+        _verifyTcpConnections( NULL, 0, NO_TOTAL );
+        AwsIotDefenderInternal_DeleteReport();
+
+        /* After a rejected report, all connections are reported again. */
+        AwsIotDefenderInternal_ResetReportHistory();
+        _createReport( pAddresses, 3 );
+        _verifyTcpConnections( pAddresses, 3, 3 );
+    }
+
+/*-----------------------------------------------------------*/
+
+    TEST( Defender_Unit, Report_incremental_full_after_close )
+    {
+        const char * const pAddresses[] = { REMOTE_ADDR_A, REMOTE_ADDR_B };
+        const char * const pReplaced[] = { REMOTE_ADDR_B, REMOTE_ADDR_C };
+        const char * const pTwice[] = { REMOTE_ADDR_A, REMOTE_ADDR_A };
+
+        _setUpCollector();
+
+        _createReport( pAddresses, 2 );
+        AwsIotDefenderInternal_ReportAccepted();
+        AwsIotDefenderInternal_DeleteReport();
+
+        /* A was closed and C opened; the total did not change. */
+        _createReport( pReplaced, 2 );
+        _verifyTcpConnections( pReplaced, 2, 2 );
+        AwsIotDefenderInternal_ReportAccepted();
+        AwsIotDefenderInternal_DeleteReport();
+
+        /* Two connections to the same address count as two. */
+        _createReport( pTwice, 2 );
+        AwsIotDefenderInternal_ReportAccepted();
+        AwsIotDefenderInternal_DeleteReport();
+
+        /* One of them was closed and B opened. */
+        _createReport( pAddresses, 2 );
+        _verifyTcpConnections( pAddresses, 2, 2 );
+    }
+#endif /* if AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT == 1 */
+
+/*-----------------------------------------------------------*/
+
+static void _setUpCollector( void )
+{
+    /* Prepare the collector the way AwsIotDefender_Start does, without
+     * scheduling the publish job. */
+    _pAwsIotDefenderEncoder = &_IotSerializerCborEncoder;
+    _pAwsIotDefenderDecoder = &_IotSerializerCborDecoder;
+    TEST_ASSERT_TRUE( IotMutex_Create( &_AwsIotDefenderMetrics.mutex, false ) );
+    _collectorSetUp = true;
+
+    TEST_ASSERT_EQUAL( AWS_IOT_DEFENDER_SUCCESS,
+                       AwsIotDefender_SetMetrics( AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS,
+                                                  AWS_IOT_DEFENDER_METRICS_ALL ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _createReport( const char * const * ppRemoteAddresses,
+                           size_t count )
+{
+    AwsIotTestDefender_SetTcpConnections( ppRemoteAddresses, count );
+
+    TEST_ASSERT_TRUE( AwsIotDefenderInternal_CreateReport() );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _verifyTcpConnections( const char * const * ppExpectedAddresses,
+                                   size_t expectedCount,
+                                   int expectedTotal )
+{
+    IotSerializerDecoderObject_t reportObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t metricsObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t tcpConnObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t estConnObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t totalObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t connsObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderIterator_t connIterator = IOT_SERIALIZER_DECODER_ITERATOR_INITIALIZER;
+    size_t i = 0;
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _pAwsIotDefenderDecoder->init( &reportObject,
+                                                      AwsIotDefenderInternal_GetReportBuffer(),
+                                                      AwsIotDefenderInternal_GetReportBufferSize() ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->find( &reportObject, "metrics", &metricsObject ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->find( &metricsObject, "tcp_connections", &tcpConnObject ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->find( &tcpConnObject, "established_connections", &estConnObject ) );
+
+    if( expectedTotal == NO_TOTAL )
+    {
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_NOT_FOUND, _pAwsIotDefenderDecoder->find( &estConnObject, "total", &totalObject ) );
+    }
+    else
+    {
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->find( &estConnObject, "total", &totalObject ) );
+        TEST_ASSERT_EQUAL( expectedTotal, totalObject.u.value.u.signedInt );
+    }
+
+    if( expectedCount == 0 )
+    {
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_NOT_FOUND, _pAwsIotDefenderDecoder->find( &estConnObject, "connections", &connsObject ) );
+    }
+    else
+    {
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->find( &estConnObject, "connections", &connsObject ) );
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->stepIn( &connsObject, &connIterator ) );
+
+        /* The connections are reported in the order of the platform's list. */
+        for( i = 0; i < expectedCount; i++ )
+        {
+            IotSerializerDecoderObject_t connMap = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+            IotSerializerDecoderObject_t remoteAddrObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+
+            TEST_ASSERT_FALSE( _pAwsIotDefenderDecoder->isEndOfContainer( connIterator ) );
+            TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->get( connIterator, &connMap ) );
+            TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->find( &connMap, "remote_addr", &remoteAddrObject ) );
+            TEST_ASSERT_EQUAL( strlen( ppExpectedAddresses[ i ] ), remoteAddrObject.u.value.u.string.length );
+            TEST_ASSERT_EQUAL_STRING_LEN( ppExpectedAddresses[ i ],
+                                          ( const char * ) remoteAddrObject.u.value.u.string.pString,
+                                          remoteAddrObject.u.value.u.string.length );
+
+            _pAwsIotDefenderDecoder->destroy( &connMap );
+            TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->next( connIterator ) );
+        }
+
+        TEST_ASSERT_TRUE( _pAwsIotDefenderDecoder->isEndOfContainer( connIterator ) );
+        _pAwsIotDefenderDecoder->stepOut( connIterator, &connsObject );
+    }
+
+    _pAwsIotDefenderDecoder->destroy( &connsObject );
+    _pAwsIotDefenderDecoder->destroy( &estConnObject );
+    _pAwsIotDefenderDecoder->destroy( &tcpConnObject );
+    _pAwsIotDefenderDecoder->destroy( &metricsObject );
+    _pAwsIotDefenderDecoder->destroy( &reportObject );
+}
@@ -66,6 +66,14 @@
  * @function_brief{shadow_function_setupdatedcallback}
  * - @function_name{shadow_function_removepersistentsubscriptions}
  * @function_brief{shadow_function_removepersistentsubscriptions}
+ * - @function_name{shadow_function_reportedcreate}
+ * @function_brief{shadow_function_reportedcreate}
+ * - @function_name{shadow_function_reportedset}
+ * @function_brief{shadow_function_reportedset}
+ * - @function_name{shadow_function_reportedflush}
+ * @function_brief{shadow_function_reportedflush}
+ * - @function_name{shadow_function_reporteddestroy}
+ * @function_brief{shadow_function_reporteddestroy}
  * - @function_name{shadow_function_strerror}
  * @function_brief{shadow_function_strerror}
  */
@@ -107,6 +115,18 @@
  * @function_page{AwsIotShadow_RemovePersistentSubscriptions,shadow,removepersistentsubscriptions}
  * @function_snippet{shadow,removepersistentsubscriptions,this}
  * @copydoc AwsIotShadow_RemovePersistentSubscriptions
+ * @function_page{AwsIotShadow_ReportedCreate,shadow,reportedcreate}
+ * @function_snippet{shadow,reportedcreate,this}
+ * @copydoc AwsIotShadow_ReportedCreate
+ * @function_page{AwsIotShadow_ReportedSet,shadow,reportedset}
+ * @function_snippet{shadow,reportedset,this}
+ * @copydoc AwsIotShadow_ReportedSet
+ * @function_page{AwsIotShadow_ReportedFlush,shadow,reportedflush}
+ * @function_snippet{shadow,reportedflush,this}
+ * @copydoc AwsIotShadow_ReportedFlush
+ * @function_page{AwsIotShadow_ReportedDestroy,shadow,reporteddestroy}
+ * @function_snippet{shadow,reporteddestroy,this}
+ * @copydoc AwsIotShadow_ReportedDestroy
  * @function_page{AwsIotShadow_strerror,shadow,strerror}
  * @function_snippet{shadow,strerror,this}
  * @copydoc AwsIotShadow_strerror
@@ -900,6 +920,110 @@ AwsIotShadowError_t AwsIotShadow_RemovePersistentSubscriptions( IotMqttConnectio
                                                                 uint32_t flags );
 /* @[declare_shadow_removepersistentsubscriptions] */
 
+/*-------------------- Shadow reported state functions ----------------------*/
+
+/**
+ * @brief Create a manager that coalesces changes to a Thing Shadow's reported
+ * state.
+ *
+ * Applications that call @ref shadow_function_update whenever any reported
+ * value changes send a full reported document for every change. A reported
+ * state manager instead keeps the last reported document acknowledged by the
+ * Shadow service, merges field changes passed to @ref shadow_function_reportedset,
+ * and sends them one [flush window](@ref AwsIotShadowReportedInfo_t.flushWindowMs)
+ * after the first change, so at most one Shadow update is sent per window. Each
+ * update contains only the fields whose values differ from the acknowledged
+ * document.
+ *
+ * Only one update from a manager is in flight at any time. If that update is
+ * rejected or times out, the fields it carried remain pending and are sent again
+ * in the next window; fields acknowledged by earlier updates are not resent.
+ *
+ * @param[in] mqttConnection The MQTT connection to use for Shadow updates.
+ * @param[in] pReportedInfo Thing Name, QoS and flush window of the manager.
+ * @param[out] pReported Set to a handle to the new manager.
+ *
+ * @return One of the following:
+ * - #AWS_IOT_SHADOW_SUCCESS
+ * - #AWS_IOT_SHADOW_BAD_PARAMETER
+ * - #AWS_IOT_SHADOW_NO_MEMORY
+ *
+ * @see @ref shadow_function_reporteddestroy
+ */
+/* @[declare_shadow_reportedcreate] */
+AwsIotShadowError_t AwsIotShadow_ReportedCreate( IotMqttConnection_t mqttConnection,
+                                                 const AwsIotShadowReportedInfo_t * pReportedInfo,
+                                                 AwsIotShadowReported_t * pReported );
+/* @[declare_shadow_reportedcreate] */
+
+/**
+ * @brief Set the value of one top-level field of the reported state.
+ *
+ * The new value replaces any pending value for the same key. If it differs from
+ * the value last acknowledged by the Shadow service and no flush is scheduled,
+ * a flush is scheduled one flush window from now.
+ *
+ * @param[in] reported Handle returned by @ref shadow_function_reportedcreate.
+ * @param[in] pKey Key of the reported field, without quotes.
+ * @param[in] keyLength Length of `pKey`. Must not exceed
+ * @ref AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH.
+ * @param[in] pValue JSON text of the value, e.g. `23`, `true` or `"on"`.
+ * @param[in] valueLength Length of `pValue`. Must not exceed
+ * @ref AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH.
+ *
+ * @return One of the following:
+ * - #AWS_IOT_SHADOW_SUCCESS
+ * - #AWS_IOT_SHADOW_BAD_PARAMETER
+ * - #AWS_IOT_SHADOW_NO_MEMORY if the manager already holds
+ * @ref AWS_IOT_SHADOW_REPORTED_MAX_FIELDS other keys.
+ *
+ * <b>Example</b>
+ * @code{c}
+ * // Two changes within one flush window produce a single Shadow update
+ * // containing {"temperature":23,"power":"on"}.
+ * AwsIotShadow_ReportedSet( reported, "temperature", 11, "23", 2 );
+ * AwsIotShadow_ReportedSet( reported, "power", 5, "\"on\"", 4 );
+ * @endcode
+ */
+/* @[declare_shadow_reportedset] */
+AwsIotShadowError_t AwsIotShadow_ReportedSet( AwsIotShadowReported_t reported,
+                                              const char * pKey,
+                                              size_t keyLength,
+                                              const char * pValue,
+                                              size_t valueLength );
+/* @[declare_shadow_reportedset] */
+
+/**
+ * @brief Send pending reported fields without waiting for the flush window.
+ *
+ * If an update from this manager is already in flight, the pending fields are
+ * sent one flush window after it completes.
+ *
+ * @param[in] reported Handle returned by @ref shadow_function_reportedcreate.
+ *
+ * @return One of the following:
+ * - #AWS_IOT_SHADOW_SUCCESS if nothing needed to be sent.
+ * - #AWS_IOT_SHADOW_STATUS_PENDING if an update was queued or will be queued.
+ * - #AWS_IOT_SHADOW_BAD_PARAMETER
+ * - #AWS_IOT_SHADOW_NO_MEMORY
+ * - #AWS_IOT_SHADOW_MQTT_ERROR
+ */
+/* @[declare_shadow_reportedflush] */
+AwsIotShadowError_t AwsIotShadow_ReportedFlush( AwsIotShadowReported_t reported );
+/* @[declare_shadow_reportedflush] */
+
+/**
+ * @brief Destroy a reported state manager.
+ *
+ * Pending fields that were not yet sent are discarded. If an update is in
+ * flight, the manager's memory is released once that update completes.
+ *
+ * @param[in] reported Handle returned by @ref shadow_function_reportedcreate.
+ */
+/* @[declare_shadow_reporteddestroy] */
+void AwsIotShadow_ReportedDestroy( AwsIotShadowReported_t reported );
+/* @[declare_shadow_reporteddestroy] */
+
 /*------------------------- Shadow helper functions -------------------------*/
 
 /**
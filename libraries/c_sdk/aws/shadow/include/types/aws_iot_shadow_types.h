@@ -67,6 +67,21 @@
  */
 typedef struct _shadowOperation * AwsIotShadowOperation_t;
 
+/**
+ * @ingroup shadow_datatypes_handles
+ * @brief Opaque handle that references a Shadow reported state manager.
+ *
+ * Set as an output parameter of @ref shadow_function_reportedcreate. A reported
+ * state manager keeps the last acknowledged `state.reported` fields of a Thing
+ * Shadow and coalesces changes to those fields into Shadow updates.
+ *
+ * This reference is valid from the successful return of @ref shadow_function_reportedcreate
+ * until it is passed to @ref shadow_function_reporteddestroy.
+ *
+ * @initializer{AwsIotShadowReported_t,AWS_IOT_SHADOW_REPORTED_INITIALIZER}
+ */
+typedef struct _shadowReported * AwsIotShadowReported_t;
+
 /*------------------------- Shadow enumerated types -------------------------*/
 
 /**
@@ -483,6 +498,38 @@ typedef struct AwsIotShadowDocumentInfo
     } u;                                  /**< @brief Valid member depends on operation type. */
 } AwsIotShadowDocumentInfo_t;
 
+/**
+ * @ingroup shadow_datatypes_paramstructs
+ * @brief Parameters of a Shadow reported state manager.
+ *
+ * @paramfor @ref shadow_function_reportedcreate
+ *
+ * Reported field changes passed to @ref shadow_function_reportedset are held
+ * for up to #AwsIotShadowReportedInfo_t.flushWindowMs before being sent as a
+ * single Shadow update containing only the fields that differ from the last
+ * document acknowledged by the Shadow service.
+ *
+ * @initializer{AwsIotShadowReportedInfo_t,AWS_IOT_SHADOW_REPORTED_INFO_INITIALIZER}
+ */
+typedef struct AwsIotShadowReportedInfo
+{
+    const char * pThingName; /**< @brief The Thing Name whose reported state is managed. */
+    size_t thingNameLength;  /**< @brief Length of #AwsIotShadowReportedInfo_t.pThingName. */
+
+    IotMqttQos_t qos;        /**< @brief QoS of the Shadow updates sent by the manager. See #AwsIotShadowDocumentInfo_t.qos. */
+    uint32_t retryLimit;     /**< @brief See #AwsIotShadowDocumentInfo_t.retryLimit. */
+    uint32_t retryMs;        /**< @brief See #AwsIotShadowDocumentInfo_t.retryMs. */
+
+    /**
+     * @brief How long the manager holds field changes before sending them.
+     *
+     * The window starts at the first change after the previous update completed.
+     * All changes made within it are merged into one Shadow update.
+     * If `0`, @ref AWS_IOT_SHADOW_REPORTED_DEFAULT_FLUSH_WINDOW_MS is used.
+     */
+    uint32_t flushWindowMs;
+} AwsIotShadowReportedInfo_t;
+
 /*------------------------ Shadow defined constants -------------------------*/
 
 /**
@@ -507,6 +554,8 @@ typedef struct AwsIotShadowDocumentInfo
  * AwsIotShadowCallbackInfo_t callbackInfo = AWS_IOT_SHADOW_CALLBACK_INFO_INITIALIZER;
  * AwsIotShadowDocumentInfo_t documentInfo = AWS_IOT_SHADOW_DOCUMENT_INFO_INITIALIZER;
  * AwsIotShadowOperation_t operation = AWS_IOT_SHADOW_OPERATION_INITIALIZER;
+ * AwsIotShadowReportedInfo_t reportedInfo = AWS_IOT_SHADOW_REPORTED_INFO_INITIALIZER;
+ * AwsIotShadowReported_t reported = AWS_IOT_SHADOW_REPORTED_INITIALIZER;
  * @endcode
  *
  * @section shadow_constants_flags Shadow Function Flags
@@ -541,6 +590,8 @@ typedef struct AwsIotShadowDocumentInfo
 #define AWS_IOT_SHADOW_CALLBACK_INFO_INITIALIZER    { 0 }        /**< @brief Initializer for #AwsIotShadowCallbackInfo_t. */
 #define AWS_IOT_SHADOW_DOCUMENT_INFO_INITIALIZER    { 0 }        /**< @brief Initializer for #AwsIotShadowDocumentInfo_t. */
 #define AWS_IOT_SHADOW_OPERATION_INITIALIZER        NULL         /**< @brief Initializer for #AwsIotShadowOperation_t. */
+#define AWS_IOT_SHADOW_REPORTED_INFO_INITIALIZER    { 0 }        /**< @brief Initializer for #AwsIotShadowReportedInfo_t. */
+#define AWS_IOT_SHADOW_REPORTED_INITIALIZER         NULL         /**< @brief Initializer for #AwsIotShadowReported_t. */
 /* @[define_shadow_initializers] */
 
 /**
@@ -590,6 +590,8 @@ static void _updatedCallbackWrapper( void * pArgument,
 
 AwsIotShadowError_t AwsIotShadow_Init( uint32_t mqttTimeoutMs )
 {
+    int i = 0;
+
     /* Create the Shadow pending operation list mutex. */
     if( IotMutex_Create( &( _AwsIotShadowPendingOperationsMutex ), false ) == false )
     {
@@ -609,7 +611,15 @@ AwsIotShadowError_t AwsIotShadow_Init( uint32_t mqttTimeoutMs )
 
     /* Create Shadow linear containers. */
     IotListDouble_Create( &( _AwsIotShadowPendingOperations ) );
-    IotListDouble_Create( &( _AwsIotShadowSubscriptions ) );
+
+    for( i = 0; i < SHADOW_SUBSCRIPTION_BUCKET_COUNT; i++ )
+    {
+        IotListDouble_Create( &( _AwsIotShadowSubscriptions[ i ] ) );
+    }
+
+    #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+        IotListDouble_Create( &( _AwsIotShadowWildcards ) );
+    #endif
 
     /* Save the MQTT timeout option. */
     if( mqttTimeoutMs != 0 )
@@ -626,6 +636,8 @@ AwsIotShadowError_t AwsIotShadow_Init( uint32_t mqttTimeoutMs )
 
 void AwsIotShadow_Cleanup( void )
 {
+    int i = 0;
+
     /* Remove and free all items in the Shadow pending operation list. */
     IotMutex_Lock( &( _AwsIotShadowPendingOperationsMutex ) );
     IotListDouble_RemoveAll( &( _AwsIotShadowPendingOperations ),
@@ -633,11 +645,23 @@ void AwsIotShadow_Cleanup( void )
                              offsetof( _shadowOperation_t, link ) );
     IotMutex_Unlock( &( _AwsIotShadowPendingOperationsMutex ) );
 
-    /* Remove and free all items in the Shadow subscription list. */
+    /* Remove and free all items in the Shadow subscription lists. */
     IotMutex_Lock( &( _AwsIotShadowSubscriptionsMutex ) );
-    IotListDouble_RemoveAll( &( _AwsIotShadowSubscriptions ),
-                             _AwsIotShadow_DestroySubscription,
-                             offsetof( _shadowSubscription_t, link ) );
+
+    for( i = 0; i < SHADOW_SUBSCRIPTION_BUCKET_COUNT; i++ )
+    {
+        IotListDouble_RemoveAll( &( _AwsIotShadowSubscriptions[ i ] ),
+                                 _AwsIotShadow_DestroySubscription,
+                                 offsetof( _shadowSubscription_t, link ) );
+    }
+
+    /* Forget the wildcard subscriptions of the removed operations and Things. */
+    #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+        IotListDouble_RemoveAll( &( _AwsIotShadowWildcards ),
+                                 AwsIotShadow_FreeSubscription,
+                                 offsetof( _shadowWildcard_t, link ) );
+    #endif
+
     IotMutex_Unlock( &( _AwsIotShadowSubscriptionsMutex ) );
 
     /* Destroy Shadow library mutexes. */
@@ -56,6 +56,7 @@ typedef struct _operationMatchParams
     _shadowOperationType_t type; /**< @brief DELETE, GET, or UPDATE. */
     const char * pThingName;     /**< @brief Thing Name of Shadow operation. */
     size_t thingNameLength;      /**< @brief Length of #_operationMatchParams_t.pThingName. */
+    uint32_t thingNameHash;      /**< @brief Hash of #_operationMatchParams_t.pThingName. */
     const char * pDocument;      /**< @brief Shadow UPDATE response document. */
     size_t documentLength;       /**< @brief Length of #_operationMatchParams_t.pDocument. */
 } _operationMatchParams_t;
@@ -173,6 +174,7 @@ static bool _shadowOperation_match( const IotLink_t * pOperationLink,
 
     /* Check for matching Thing Name and operation type. */
     bool match = ( pOperation->type == pParam->type ) &&
+                 ( pParam->thingNameHash == pSubscription->thingNameHash ) &&
                  ( pParam->thingNameLength == pSubscription->thingNameLength ) &&
                  ( strncmp( pParam->pThingName,
                             pSubscription->pThingName,
@@ -248,6 +250,27 @@ static void _commonOperationCallback( _shadowOperationType_t type,
         return;
     }
 
+    param.thingNameHash = _AwsIotShadow_HashThingName( param.pThingName,
+                                                       param.thingNameLength );
+
+    /* Parse the status from the topic name. */
+    status = _AwsIotShadow_ParseShadowStatus( pMessage->u.message.info.pTopicName,
+                                              pMessage->u.message.info.topicNameLength );
+
+    /* In gateway mode, the wildcard subscription for UPDATE also receives the
+     * "delta" and "documents" topics. These are not operation responses. */
+    #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+        if( status == _UNKNOWN_STATUS )
+        {
+            IotLogDebug( "Ignoring message on %.*s, which is not a Shadow %s response.",
+                         pMessage->u.message.info.topicNameLength,
+                         pMessage->u.message.info.pTopicName,
+                         _pAwsIotShadowOperationNames[ type ] );
+
+            return;
+        }
+    #endif
+
     /* Lock the pending operations list for exclusive access. */
     IotMutex_Lock( &( _AwsIotShadowPendingOperationsMutex ) );
 
@@ -289,10 +312,6 @@ static void _commonOperationCallback( _shadowOperationType_t type,
                  pMessage->u.message.info.topicNameLength,
                  pMessage->u.message.info.pTopicName );
 
-    /* Parse the status from the topic name. */
-    status = _AwsIotShadow_ParseShadowStatus( pMessage->u.message.info.pTopicName,
-                                              pMessage->u.message.info.topicNameLength );
-
     switch( status )
     {
         case _SHADOW_ACCEPTED:
@@ -679,8 +698,10 @@ AwsIotShadowError_t _AwsIotShadow_ProcessOperation( IotMqttConnection_t mqttConn
         pOperation->pSubscription = pSubscription;
 
         /* Assign the topic buffer to the subscription to use for unsubscribing if
-         * the subscription has no topic buffer. */
-        if( pSubscription->pTopicBuffer == NULL )
+         * the subscription has no topic buffer. In gateway mode, operation topics
+         * are never unsubscribed per Thing, so the subscription does not keep it. */
+        if( ( AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 0 ) &&
+            ( pSubscription->pTopicBuffer == NULL ) )
         {
             pSubscription->pTopicBuffer = pTopicBuffer;
 
@@ -0,0 +1,753 @@
+/*
+ * FreeRTOS Shadow V2.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_iot_shadow_reported.c
+ * @brief Implements the Shadow reported state manager, which coalesces reported
+ * field changes into minimal Shadow updates.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* Shadow internal include. */
+#include "private/aws_iot_shadow_internal.h"
+
+/* Platform layer include. */
+#include "platform/iot_threads.h"
+
+/* Task pool include. */
+#include "iot_taskpool.h"
+
+/* Validate reported state configuration settings. */
+#if AWS_IOT_SHADOW_REPORTED_DEFAULT_FLUSH_WINDOW_MS <= 0
+    #error "AWS_IOT_SHADOW_REPORTED_DEFAULT_FLUSH_WINDOW_MS cannot be 0 or negative."
+#endif
+#if AWS_IOT_SHADOW_REPORTED_MAX_FIELDS <= 0
+    #error "AWS_IOT_SHADOW_REPORTED_MAX_FIELDS cannot be 0 or negative."
+#endif
+#if AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH <= 0
+    #error "AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH cannot be 0 or negative."
+#endif
+#if AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH <= 0
+    #error "AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH cannot be 0 or negative."
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check if a reported field's pending value differs from the value last
+ * acknowledged by the Shadow service.
+ *
+ * @param[in] pField The field to check.
+ *
+ * @return `true` if the field must be sent in the next update.
+ */
+static bool _fieldIsDirty( const _shadowReportedField_t * pField );
+
+/**
+ * @brief Schedule the flush job to run one flush window from now.
+ *
+ * Does nothing if the job is already scheduled or an update is in flight; the
+ * completion of an in-flight update reschedules the flush. Changes made while
+ * the job is scheduled are therefore merged into a single update.
+ *
+ * @param[in] pReported The reported state manager.
+ *
+ * @note This function should be called with the manager's mutex locked.
+ */
+static void _scheduleFlush( _shadowReported_t * pReported );
+
+/**
+ * @brief Send the update document prepared by #_AwsIotShadow_ReportedSerialize.
+ *
+ * @param[in] pReported The reported state manager.
+ * @param[in] version Version of the prepared document.
+ *
+ * @return #AWS_IOT_SHADOW_STATUS_PENDING on success; otherwise, the error
+ * returned by @ref shadow_function_update.
+ *
+ * @note This function must be called with the manager's mutex unlocked, as it
+ * may block on MQTT subscriptions. If the update cannot be sent and the manager
+ * was destroyed meanwhile, the manager is freed.
+ */
+static AwsIotShadowError_t _sendUpdate( _shadowReported_t * pReported,
+                                        uint32_t version );
+
+/**
+ * @brief Prepare the update document for all dirty fields and mark it in flight.
+ *
+ * @param[in] pReported The reported state manager.
+ *
+ * @return The version of the prepared document; 0 if no field is dirty.
+ *
+ * @note This function should be called with the manager's mutex locked and no
+ * update in flight.
+ */
+static uint32_t _prepareUpdate( _shadowReported_t * pReported );
+
+/**
+ * @brief Prepare and send an update for all dirty fields.
+ *
+ * @param[in] pReported The reported state manager.
+ *
+ * @return #AWS_IOT_SHADOW_SUCCESS if nothing was sent; otherwise, the result of
+ * #_sendUpdate.
+ */
+static AwsIotShadowError_t _flush( _shadowReported_t * pReported );
+
+/**
+ * @brief Task pool routine that runs at the end of a flush window.
+ *
+ * The flush runs in the task pool rather than a timer callback because
+ * @ref shadow_function_update may block while adding MQTT subscriptions.
+ *
+ * @param[in] pTaskPool Pointer to the system task pool.
+ * @param[in] pFlushJob Pointer to the flush job.
+ * @param[in] pContext The #_shadowReported_t that scheduled the job.
+ */
+static void _flushJob( IotTaskPool_t pTaskPool,
+                       IotTaskPoolJob_t pFlushJob,
+                       void * pContext );
+
+/**
+ * @brief Invoked when a Shadow update sent by a manager completes.
+ *
+ * @param[in] pCallbackContext The #_shadowReported_t that sent the update.
+ * @param[in] pCallbackParam Outcome of the update.
+ */
+static void _updateComplete( void * pCallbackContext,
+                             AwsIotShadowCallbackParam_t * pCallbackParam );
+
+/**
+ * @brief Check if a destroyed reported state manager may be freed.
+ *
+ * @param[in] pReported The reported state manager.
+ *
+ * @return `true` if @ref shadow_function_reporteddestroy was called and no job
+ * or Shadow update still references the manager.
+ *
+ * @note This function should be called with the manager's mutex locked.
+ */
+static bool _canFreeReported( const _shadowReported_t * pReported );
+
+/**
+ * @brief Free the resources of a reported state manager.
+ *
+ * @param[in] pReported The reported state manager to free.
+ */
+static void _destroyReported( _shadowReported_t * pReported );
+
+/*-----------------------------------------------------------*/
+
+static bool _fieldIsDirty( const _shadowReportedField_t * pField )
+{
+    bool dirty = false;
+
+    if( pField->pendingLength != pField->acknowledgedLength )
+    {
+        dirty = true;
+    }
+    else if( memcmp( pField->pPending, pField->pAcknowledged, pField->pendingLength ) != 0 )
+    {
+        dirty = true;
+    }
+
+    return dirty;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _scheduleFlush( _shadowReported_t * pReported )
+{
+    IotTaskPoolError_t taskPoolStatus = IOT_TASKPOOL_SUCCESS;
+
+    if( ( pReported->flushScheduled == false ) && ( pReported->inFlightVersion == 0 ) )
+    {
+        /* Creating a job should never fail when parameters are valid. */
+        taskPoolStatus = IotTaskPool_CreateJob( _flushJob,
+                                                pReported,
+                                                &( pReported->flushJobStorage ),
+                                                &( pReported->flushJob ) );
+        AwsIotShadow_Assert( taskPoolStatus == IOT_TASKPOOL_SUCCESS );
+
+        taskPoolStatus = IotTaskPool_ScheduleDeferred( IOT_SYSTEM_TASKPOOL,
+                                                       pReported->flushJob,
+                                                       pReported->flushWindowMs );
+
+        if( taskPoolStatus == IOT_TASKPOOL_SUCCESS )
+        {
+            pReported->flushScheduled = true;
+        }
+        else
+        {
+            IotLogError( "(%.*s) Failed to schedule reported state flush, error %s.",
+                         pReported->thingNameLength,
+                         pReported->pThingName,
+                         IotTaskPool_strerror( taskPoolStatus ) );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static AwsIotShadowError_t _sendUpdate( _shadowReported_t * pReported,
+                                        uint32_t version )
+{
+    AwsIotShadowError_t status = AWS_IOT_SHADOW_STATUS_PENDING;
+    AwsIotShadowDocumentInfo_t updateInfo = AWS_IOT_SHADOW_DOCUMENT_INFO_INITIALIZER;
+    AwsIotShadowCallbackInfo_t callbackInfo = AWS_IOT_SHADOW_CALLBACK_INFO_INITIALIZER;
+    bool freeReported = false;
+
+    updateInfo.pThingName = pReported->pThingName;
+    updateInfo.thingNameLength = pReported->thingNameLength;
+    updateInfo.qos = pReported->qos;
+    updateInfo.retryLimit = pReported->retryLimit;
+    updateInfo.retryMs = pReported->retryMs;
+    updateInfo.u.update.pUpdateDocument = pReported->pDocument;
+    updateInfo.u.update.updateDocumentLength = pReported->documentLength;
+
+    callbackInfo.pCallbackContext = pReported;
+    callbackInfo.function = _updateComplete;
+
+    IotLogDebug( "(%.*s) Sending reported state version %lu: %.*s",
+                 pReported->thingNameLength,
+                 pReported->pThingName,
+                 ( unsigned long ) version,
+                 pReported->documentLength,
+                 pReported->pDocument );
+
+    /* Reported state updates are frequent; keep the update topic subscriptions
+     * between flushes. */
+    status = AwsIotShadow_Update( pReported->mqttConnection,
+                                  &updateInfo,
+                                  AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS,
+                                  &callbackInfo,
+                                  NULL );
+
+    if( status != AWS_IOT_SHADOW_STATUS_PENDING )
+    {
+        IotLogWarn( "(%.*s) Failed to send reported state version %lu, error %s.",
+                    pReported->thingNameLength,
+                    pReported->pThingName,
+                    ( unsigned long ) version,
+                    AwsIotShadow_strerror( status ) );
+
+        /* The completion callback will not be invoked. Return the fields to the
+         * dirty state and retry in the next window, unless the manager was
+         * destroyed while the update was being sent. */
+        IotMutex_Lock( &( pReported->mutex ) );
+
+        if( ( _AwsIotShadow_ReportedComplete( pReported, version, false ) == true ) &&
+            ( pReported->destroyed == false ) )
+        {
+            _scheduleFlush( pReported );
+        }
+
+        freeReported = _canFreeReported( pReported );
+
+        IotMutex_Unlock( &( pReported->mutex ) );
+
+        if( freeReported == true )
+        {
+            _destroyReported( pReported );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t _prepareUpdate( _shadowReported_t * pReported )
+{
+    uint32_t version = pReported->nextVersion;
+
+    if( _AwsIotShadow_ReportedSerialize( pReported, version ) == true )
+    {
+        pReported->inFlightVersion = version;
+
+        /* Version 0 means "not in flight", so skip it when wrapping. */
+        pReported->nextVersion++;
+
+        if( pReported->nextVersion == 0 )
+        {
+            pReported->nextVersion = 1;
+        }
+    }
+    else
+    {
+        version = 0;
+    }
+
+    return version;
+}
+
+/*-----------------------------------------------------------*/
+
+static AwsIotShadowError_t _flush( _shadowReported_t * pReported )
+{
+    AwsIotShadowError_t status = AWS_IOT_SHADOW_SUCCESS;
+    uint32_t version = 0;
+
+    IotMutex_Lock( &( pReported->mutex ) );
+
+    if( pReported->inFlightVersion != 0 )
+    {
+        /* The in-flight update's completion reschedules the flush. */
+        status = AWS_IOT_SHADOW_STATUS_PENDING;
+    }
+    else
+    {
+        version = _prepareUpdate( pReported );
+    }
+
+    IotMutex_Unlock( &( pReported->mutex ) );
+
+    /* pDocument is not modified while an update is in flight, so it may be
+     * read without the mutex. */
+    if( version != 0 )
+    {
+        status = _sendUpdate( pReported, version );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _flushJob( IotTaskPool_t pTaskPool,
+                       IotTaskPoolJob_t pFlushJob,
+                       void * pContext )
+{
+    _shadowReported_t * pReported = pContext;
+    bool freeReported = false;
+    uint32_t version = 0;
+
+    /* Check parameters. */
+    AwsIotShadow_Assert( pTaskPool == IOT_SYSTEM_TASKPOOL );
+    AwsIotShadow_Assert( pFlushJob == pReported->flushJob );
+
+    /* The flush stays scheduled until the update is in flight, so that a
+     * concurrent destroy leaves freeing the manager to this job or to the
+     * update's completion. */
+    IotMutex_Lock( &( pReported->mutex ) );
+
+    if( ( pReported->destroyed == false ) && ( pReported->inFlightVersion == 0 ) )
+    {
+        version = _prepareUpdate( pReported );
+    }
+
+    pReported->flushScheduled = false;
+    freeReported = _canFreeReported( pReported );
+    IotMutex_Unlock( &( pReported->mutex ) );
+
+    if( version != 0 )
+    {
+        ( void ) _sendUpdate( pReported, version );
+    }
+    else if( freeReported == true )
+    {
+        _destroyReported( pReported );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _updateComplete( void * pCallbackContext,
+                             AwsIotShadowCallbackParam_t * pCallbackParam )
+{
+    _shadowReported_t * pReported = pCallbackContext;
+    bool accepted = ( pCallbackParam->u.operation.result == AWS_IOT_SHADOW_SUCCESS );
+    bool freeReported = false;
+
+    IotMutex_Lock( &( pReported->mutex ) );
+
+    IotLogDebug( "(%.*s) Reported state version %lu completed with result %s.",
+                 pReported->thingNameLength,
+                 pReported->pThingName,
+                 ( unsigned long ) pReported->inFlightVersion,
+                 AwsIotShadow_strerror( pCallbackParam->u.operation.result ) );
+
+    if( _AwsIotShadow_ReportedComplete( pReported,
+                                        pReported->inFlightVersion,
+                                        accepted ) == true )
+    {
+        if( pReported->destroyed == false )
+        {
+            _scheduleFlush( pReported );
+        }
+    }
+
+    freeReported = _canFreeReported( pReported );
+
+    IotMutex_Unlock( &( pReported->mutex ) );
+
+    if( freeReported == true )
+    {
+        _destroyReported( pReported );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _canFreeReported( const _shadowReported_t * pReported )
+{
+    return ( pReported->destroyed == true ) &&
+           ( pReported->flushScheduled == false ) &&
+           ( pReported->inFlightVersion == 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _destroyReported( _shadowReported_t * pReported )
+{
+    IotMutex_Destroy( &( pReported->mutex ) );
+    AwsIotShadow_FreeReported( pReported );
+}
+
+/*-----------------------------------------------------------*/
+
+bool _AwsIotShadow_ReportedSerialize( _shadowReported_t * pReported,
+                                      uint32_t version )
+{
+    size_t i = 0, length = 0;
+    bool dirtyFieldFound = false;
+    _shadowReportedField_t * pField = NULL;
+    char * pDocument = pReported->pDocument;
+    int versionLength = 0;
+
+    AwsIotShadow_Assert( version != 0 );
+
+    ( void ) memcpy( pDocument, SHADOW_REPORTED_DOCUMENT_PREFIX, SHADOW_REPORTED_DOCUMENT_PREFIX_LENGTH );
+    length = SHADOW_REPORTED_DOCUMENT_PREFIX_LENGTH;
+
+    for( i = 0; i < pReported->fieldCount; i++ )
+    {
+        pField = &( pReported->pFields[ i ] );
+
+        if( _fieldIsDirty( pField ) == true )
+        {
+            if( dirtyFieldFound == true )
+            {
+                pDocument[ length++ ] = ',';
+            }
+
+            dirtyFieldFound = true;
+
+            pDocument[ length++ ] = '"';
+            ( void ) memcpy( pDocument + length, pField->pKey, pField->keyLength );
+            length += pField->keyLength;
+            pDocument[ length++ ] = '"';
+            pDocument[ length++ ] = ':';
+            ( void ) memcpy( pDocument + length, pField->pPending, pField->pendingLength );
+            length += pField->pendingLength;
+
+            /* Remember exactly what was sent, as the pending value may change
+             * before the Shadow service responds. */
+            ( void ) memcpy( pField->pInFlight, pField->pPending, pField->pendingLength );
+            pField->inFlightLength = pField->pendingLength;
+            pField->inFlightVersion = version;
+        }
+    }
+
+    if( dirtyFieldFound == true )
+    {
+        ( void ) memcpy( pDocument + length, SHADOW_REPORTED_DOCUMENT_TOKEN, SHADOW_REPORTED_DOCUMENT_TOKEN_LENGTH );
+        length += SHADOW_REPORTED_DOCUMENT_TOKEN_LENGTH;
+
+        versionLength = snprintf( pDocument + length,
+                                  SHADOW_REPORTED_DOCUMENT_SIZE - length,
+                                  "%lu\"}",
+                                  ( unsigned long ) version );
+        AwsIotShadow_Assert( ( versionLength > 0 ) &&
+                             ( ( size_t ) versionLength < SHADOW_REPORTED_DOCUMENT_SIZE - length ) );
+
+        pReported->documentLength = length + ( size_t ) versionLength;
+    }
+
+    return dirtyFieldFound;
+}
+
+/*-----------------------------------------------------------*/
+
+bool _AwsIotShadow_ReportedComplete( _shadowReported_t * pReported,
+                                     uint32_t version,
+                                     bool accepted )
+{
+    size_t i = 0;
+    bool dirtyFieldFound = false;
+    _shadowReportedField_t * pField = NULL;
+
+    for( i = 0; i < pReported->fieldCount; i++ )
+    {
+        pField = &( pReported->pFields[ i ] );
+
+        if( ( version != 0 ) && ( pField->inFlightVersion == version ) )
+        {
+            if( accepted == true )
+            {
+                ( void ) memcpy( pField->pAcknowledged, pField->pInFlight, pField->inFlightLength );
+                pField->acknowledgedLength = pField->inFlightLength;
+            }
+
+            pField->inFlightVersion = 0;
+            pField->inFlightLength = 0;
+        }
+
+        if( _fieldIsDirty( pField ) == true )
+        {
+            dirtyFieldFound = true;
+        }
+    }
+
+    if( pReported->inFlightVersion == version )
+    {
+        pReported->inFlightVersion = 0;
+    }
+
+    return dirtyFieldFound;
+}
+
+/*-----------------------------------------------------------*/
+
+AwsIotShadowError_t AwsIotShadow_ReportedCreate( IotMqttConnection_t mqttConnection,
+                                                 const AwsIotShadowReportedInfo_t * pReportedInfo,
+                                                 AwsIotShadowReported_t * pReported )
+{
+    _shadowReported_t * pNewReported = NULL;
+
+    if( ( pReportedInfo == NULL ) || ( pReported == NULL ) )
+    {
+        IotLogError( "Reported state info and handle cannot be NULL." );
+
+        return AWS_IOT_SHADOW_BAD_PARAMETER;
+    }
+
+    if( ( pReportedInfo->pThingName == NULL ) ||
+        ( pReportedInfo->thingNameLength == 0 ) ||
+        ( pReportedInfo->thingNameLength > MAX_THING_NAME_LENGTH ) )
+    {
+        IotLogError( "Thing Name for reported state must be set and no longer than %d.",
+                     MAX_THING_NAME_LENGTH );
+
+        return AWS_IOT_SHADOW_BAD_PARAMETER;
+    }
+
+    if( ( pReportedInfo->qos != IOT_MQTT_QOS_0 ) && ( pReportedInfo->qos != IOT_MQTT_QOS_1 ) )
+    {
+        IotLogError( "QoS for reported state must be 0 or 1." );
+
+        return AWS_IOT_SHADOW_BAD_PARAMETER;
+    }
+
+    if( ( pReportedInfo->retryLimit > 0 ) && ( pReportedInfo->retryMs == 0 ) )
+    {
+        IotLogError( "Retry time of reported state must be positive." );
+
+        return AWS_IOT_SHADOW_BAD_PARAMETER;
+    }
+
+    pNewReported = AwsIotShadow_MallocReported( sizeof( _shadowReported_t ) );
+
+    if( pNewReported == NULL )
+    {
+        IotLogError( "Failed to allocate memory for reported state manager." );
+
+        return AWS_IOT_SHADOW_NO_MEMORY;
+    }
+
+    ( void ) memset( pNewReported, 0x00, sizeof( _shadowReported_t ) );
+
+    if( IotMutex_Create( &( pNewReported->mutex ), false ) == false )
+    {
+        IotLogError( "Failed to create reported state mutex." );
+        AwsIotShadow_FreeReported( pNewReported );
+
+        return AWS_IOT_SHADOW_NO_MEMORY;
+    }
+
+    pNewReported->mqttConnection = mqttConnection;
+    pNewReported->qos = pReportedInfo->qos;
+    pNewReported->retryLimit = pReportedInfo->retryLimit;
+    pNewReported->retryMs = pReportedInfo->retryMs;
+    pNewReported->flushWindowMs = pReportedInfo->flushWindowMs;
+    pNewReported->nextVersion = 1;
+
+    if( pNewReported->flushWindowMs == 0 )
+    {
+        pNewReported->flushWindowMs = AWS_IOT_SHADOW_REPORTED_DEFAULT_FLUSH_WINDOW_MS;
+    }
+
+    ( void ) memcpy( pNewReported->pThingName,
+                     pReportedInfo->pThingName,
+                     pReportedInfo->thingNameLength );
+    pNewReported->thingNameLength = pReportedInfo->thingNameLength;
+
+    IotLogInfo( "(%.*s) Reported state manager created with a %lu ms flush window.",
+                pNewReported->thingNameLength,
+                pNewReported->pThingName,
+                ( unsigned long ) pNewReported->flushWindowMs );
+
+    *pReported = pNewReported;
+
+    return AWS_IOT_SHADOW_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+AwsIotShadowError_t AwsIotShadow_ReportedSet( AwsIotShadowReported_t reported,
+                                              const char * pKey,
+                                              size_t keyLength,
+                                              const char * pValue,
+                                              size_t valueLength )
+{
+    AwsIotShadowError_t status = AWS_IOT_SHADOW_SUCCESS;
+    _shadowReportedField_t * pField = NULL;
+    size_t i = 0;
+
+    if( ( reported == NULL ) ||
+        ( pKey == NULL ) || ( keyLength == 0 ) ||
+        ( keyLength > AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH ) ||
+        ( pValue == NULL ) || ( valueLength == 0 ) ||
+        ( valueLength > AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH ) )
+    {
+        IotLogError( "Reported field key and value must be set and no longer than "
+                     "%d and %d, respectively.",
+                     AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH,
+                     AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH );
+
+        return AWS_IOT_SHADOW_BAD_PARAMETER;
+    }
+
+    IotMutex_Lock( &( reported->mutex ) );
+
+    /* Find the field with this key. */
+    for( i = 0; i < reported->fieldCount; i++ )
+    {
+        if( ( reported->pFields[ i ].keyLength == keyLength ) &&
+            ( memcmp( reported->pFields[ i ].pKey, pKey, keyLength ) == 0 ) )
+        {
+            pField = &( reported->pFields[ i ] );
+            break;
+        }
+    }
+
+    /* Add a new field if not found. */
+    if( pField == NULL )
+    {
+        if( reported->fieldCount < AWS_IOT_SHADOW_REPORTED_MAX_FIELDS )
+        {
+            pField = &( reported->pFields[ reported->fieldCount ] );
+            reported->fieldCount++;
+
+            ( void ) memcpy( pField->pKey, pKey, keyLength );
+            pField->keyLength = keyLength;
+        }
+        else
+        {
+            IotLogError( "(%.*s) Reported state already holds the maximum of %d fields.",
+                         reported->thingNameLength,
+                         reported->pThingName,
+                         AWS_IOT_SHADOW_REPORTED_MAX_FIELDS );
+
+            status = AWS_IOT_SHADOW_NO_MEMORY;
+        }
+    }
+
+    if( pField != NULL )
+    {
+        ( void ) memcpy( pField->pPending, pValue, valueLength );
+        pField->pendingLength = valueLength;
+
+        if( _fieldIsDirty( pField ) == true )
+        {
+            _scheduleFlush( reported );
+        }
+    }
+
+    IotMutex_Unlock( &( reported->mutex ) );
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+AwsIotShadowError_t AwsIotShadow_ReportedFlush( AwsIotShadowReported_t reported )
+{
+    if( reported == NULL )
+    {
+        IotLogError( "Reported state handle cannot be NULL." );
+
+        return AWS_IOT_SHADOW_BAD_PARAMETER;
+    }
+
+    return _flush( reported );
+}
+
+/*-----------------------------------------------------------*/
+
+void AwsIotShadow_ReportedDestroy( AwsIotShadowReported_t reported )
+{
+    IotTaskPoolError_t taskPoolStatus = IOT_TASKPOOL_SUCCESS;
+    bool freeReported = false;
+
+    if( reported != NULL )
+    {
+        IotMutex_Lock( &( reported->mutex ) );
+
+        reported->destroyed = true;
+
+        if( reported->flushScheduled == true )
+        {
+            taskPoolStatus = IotTaskPool_TryCancel( IOT_SYSTEM_TASKPOOL,
+                                                    reported->flushJob,
+                                                    NULL );
+
+            /* If the job was not canceled, it is already executing and will
+             * free the manager. */
+            if( taskPoolStatus == IOT_TASKPOOL_SUCCESS )
+            {
+                reported->flushScheduled = false;
+            }
+        }
+
+        /* An in-flight update's completion frees the manager otherwise. */
+        freeReported = _canFreeReported( reported );
+
+        IotMutex_Unlock( &( reported->mutex ) );
+
+        if( freeReported == true )
+        {
+            _destroyReported( reported );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
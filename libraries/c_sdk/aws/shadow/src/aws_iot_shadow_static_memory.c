@@ -59,6 +59,9 @@
     #ifndef AWS_IOT_SHADOW_SUBSCRIPTIONS
         #define AWS_IOT_SHADOW_SUBSCRIPTIONS                 ( 2 )
     #endif
+    #ifndef AWS_IOT_SHADOW_REPORTED_MANAGERS
+        #define AWS_IOT_SHADOW_REPORTED_MANAGERS             ( 1 )
+    #endif
 /** @endcond */
 
 /* Validate static memory configuration settings. */
@@ -68,6 +71,9 @@
     #if AWS_IOT_SHADOW_SUBSCRIPTIONS <= 0
         #error "AWS_IOT_SHADOW_SUBSCRIPTIONS cannot be 0 or negative."
     #endif
+    #if AWS_IOT_SHADOW_REPORTED_MANAGERS <= 0
+        #error "AWS_IOT_SHADOW_REPORTED_MANAGERS cannot be 0 or negative."
+    #endif
 
 /**
  * @brief The size of a static memory Shadow subscription.
@@ -89,6 +95,9 @@
     static bool _pInUseShadowSubscriptions[ AWS_IOT_SHADOW_SUBSCRIPTIONS ] = { 0 };                                    /**< @brief Shadow subscription in-use flags. */
     static char _pShadowSubscriptions[ AWS_IOT_SHADOW_SUBSCRIPTIONS ][ SHADOW_SUBSCRIPTION_SIZE ] = { { 0 } };         /**< @brief Shadow subscriptions. */
 
+    static bool _pInUseShadowReported[ AWS_IOT_SHADOW_REPORTED_MANAGERS ] = { 0 };                                     /**< @brief Shadow reported state manager in-use flags. */
+    static _shadowReported_t _pShadowReported[ AWS_IOT_SHADOW_REPORTED_MANAGERS ] = { { .fieldCount = 0 } };            /**< @brief Shadow reported state managers. */
+
 /*-----------------------------------------------------------*/
 
     void * AwsIotShadow_MallocOperation( size_t size )
@@ -158,6 +167,41 @@
                                      SHADOW_SUBSCRIPTION_SIZE );
     }
 
+/*-----------------------------------------------------------*/
+
+    void * AwsIotShadow_MallocReported( size_t size )
+    {
+        int32_t freeIndex = -1;
+        void * pNewReported = NULL;
+
+        /* Check size argument. */
+        if( size == sizeof( _shadowReported_t ) )
+        {
+            /* Find a free Shadow reported state manager. */
+            freeIndex = IotStaticMemory_FindFree( _pInUseShadowReported,
+                                                  AWS_IOT_SHADOW_REPORTED_MANAGERS );
+
+            if( freeIndex != -1 )
+            {
+                pNewReported = &( _pShadowReported[ freeIndex ] );
+            }
+        }
+
+        return pNewReported;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void AwsIotShadow_FreeReported( void * ptr )
+    {
+        /* Return the in-use Shadow reported state manager. */
+        IotStaticMemory_ReturnInUse( ptr,
+                                     _pShadowReported,
+                                     _pInUseShadowReported,
+                                     AWS_IOT_SHADOW_REPORTED_MANAGERS,
+                                     sizeof( _shadowReported_t ) );
+    }
+
 /*-----------------------------------------------------------*/
 
 #endif /* if IOT_STATIC_MEMORY_ONLY == 1 */
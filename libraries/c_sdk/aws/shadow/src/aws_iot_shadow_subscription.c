@@ -53,6 +53,7 @@ typedef struct _thingName
 {
     const char * pThingName; /**< @brief Thing Name to compare. */
     size_t thingNameLength;  /**< @brief Length of `pThingName`. */
+    uint32_t thingNameHash;  /**< @brief Hash of `pThingName`. */
 } _thingName_t;
 
 /*-----------------------------------------------------------*/
@@ -69,6 +70,16 @@ typedef struct _thingName
 static bool _shadowSubscription_match( const IotLink_t * pSubscriptionLink,
                                        void * pMatch );
 
+/**
+ * @brief Search the subscription list for a Thing Name.
+ *
+ * @param[in] pThingName Thing Name to search for. Its hash must be set.
+ *
+ * @return Pointer to the link member of the matching #_shadowSubscription_t;
+ * `NULL` if not found.
+ */
+static IotLink_t * _findSubscriptionLink( const _thingName_t * pThingName );
+
 /**
  * @brief Modify Shadow subscriptions, either by unsubscribing or subscribing.
  *
@@ -88,18 +99,106 @@ static AwsIotShadowError_t _modifyOperationSubscriptions( IotMqttConnection_t mq
                                                           _mqttCallbackFunction_t callback,
                                                           _mqttOperationFunction_t mqttOperation );
 
+#if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+
+/**
+ * @brief Add or remove the wildcard subscription for a Shadow operation type.
+ *
+ * @param[in] mqttConnection The MQTT connection to use.
+ * @param[in] type DELETE, GET, or UPDATE.
+ * @param[in] callback The callback function to execute for an incoming message.
+ * @param[in] mqttOperation Either @ref mqtt_function_timedsubscribe or @ref
+ * mqtt_function_timedunsubscribe.
+ *
+ * @return #AWS_IOT_SHADOW_STATUS_PENDING on success; otherwise
+ * #AWS_IOT_SHADOW_NO_MEMORY or #AWS_IOT_SHADOW_MQTT_ERROR.
+ */
+    static AwsIotShadowError_t _modifyWildcardSubscription( IotMqttConnection_t mqttConnection,
+                                                            _shadowOperationType_t type,
+                                                            _mqttCallbackFunction_t callback,
+                                                            _mqttOperationFunction_t mqttOperation );
+
+/**
+ * @brief Match a #_shadowWildcard_t by MQTT connection.
+ *
+ * @param[in] pWildcardLink Pointer to the link member of a #_shadowWildcard_t.
+ * @param[in] pMatch The MQTT connection to compare.
+ *
+ * @return `true` if the MQTT connections match; `false` otherwise.
+ */
+    static bool _shadowWildcard_match( const IotLink_t * pWildcardLink,
+                                       void * pMatch );
+
+/**
+ * @brief Search the wildcard subscriptions list for an MQTT connection.
+ *
+ * @param[in] mqttConnection The MQTT connection to search for.
+ * @param[in] createNew Whether to add a new wildcard subscriptions object for
+ * `mqttConnection` if none is found.
+ *
+ * @return Pointer to the wildcard subscriptions object of `mqttConnection`;
+ * `NULL` if not found and not created.
+ */
+    static _shadowWildcard_t * _findWildcard( IotMqttConnection_t mqttConnection,
+                                              bool createNew );
+
+/**
+ * @brief Remove and free a wildcard subscriptions object if none of its
+ * subscriptions have references.
+ *
+ * @param[in] pWildcard The wildcard subscriptions object to check.
+ */
+    static void _removeWildcard( _shadowWildcard_t * pWildcard );
+
+/**
+ * @brief Release one reference to the wildcard subscription of a Shadow
+ * operation type, unsubscribing when none remain.
+ *
+ * @param[in] mqttConnection The MQTT connection to use.
+ * @param[in] type DELETE, GET, or UPDATE.
+ *
+ * @return #AWS_IOT_SHADOW_STATUS_PENDING on success; otherwise
+ * #AWS_IOT_SHADOW_BAD_PARAMETER, #AWS_IOT_SHADOW_NO_MEMORY, or
+ * #AWS_IOT_SHADOW_MQTT_ERROR.
+ */
+    static AwsIotShadowError_t _releaseWildcardSubscription( IotMqttConnection_t mqttConnection,
+                                                             _shadowOperationType_t type );
+#endif /* if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1 */
+
 /*-----------------------------------------------------------*/
 
 /**
- * @brief List of active Shadow subscriptions objects.
+ * @brief Lists of active Shadow subscriptions objects, indexed by Thing Name hash.
  */
-IotListDouble_t _AwsIotShadowSubscriptions = { 0 };
+IotListDouble_t _AwsIotShadowSubscriptions[ SHADOW_SUBSCRIPTION_BUCKET_COUNT ] = { { 0 } };
 
 /**
  * @brief Protects #_AwsIotShadowSubscriptions from concurrent access.
  */
 IotMutex_t _AwsIotShadowSubscriptionsMutex;
 
+#if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+
+/**
+ * @brief Topic filters that match the responses of a Shadow operation for all
+ * Things. These are shared by every Thing, so subscription objects do not need
+ * their own topic buffers for operations.
+ */
+    static const char * const _pWildcardTopicFilters[ SHADOW_OPERATION_COUNT ] =
+    {
+        SHADOW_TOPIC_PREFIX SHADOW_WILDCARD_THING_NAME SHADOW_DELETE_OPERATION_STRING SHADOW_WILDCARD_SUFFIX,
+        SHADOW_TOPIC_PREFIX SHADOW_WILDCARD_THING_NAME SHADOW_GET_OPERATION_STRING SHADOW_WILDCARD_SUFFIX,
+        SHADOW_TOPIC_PREFIX SHADOW_WILDCARD_THING_NAME SHADOW_UPDATE_OPERATION_STRING SHADOW_WILDCARD_SUFFIX
+    };
+
+/**
+ * @brief List of the wildcard subscriptions of each MQTT connection.
+ *
+ * Protected by #_AwsIotShadowSubscriptionsMutex.
+ */
+    IotListDouble_t _AwsIotShadowWildcards = { 0 };
+#endif /* if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1 */
+
 /*-----------------------------------------------------------*/
 
 static bool _shadowSubscription_match( const IotLink_t * pSubscriptionLink,
@@ -116,7 +215,8 @@ static bool _shadowSubscription_match( const IotLink_t * pSubscriptionLink,
                                                                      link );
     const _thingName_t * pThingName = ( _thingName_t * ) pMatch;
 
-    if( pThingName->thingNameLength == pSubscription->thingNameLength )
+    if( ( pThingName->thingNameHash == pSubscription->thingNameHash ) &&
+        ( pThingName->thingNameLength == pSubscription->thingNameLength ) )
     {
         /* Check for matching Thing Names. */
         match = ( strncmp( pThingName->pThingName,
@@ -129,6 +229,17 @@ static bool _shadowSubscription_match( const IotLink_t * pSubscriptionLink,
 
 /*-----------------------------------------------------------*/
 
+static IotLink_t * _findSubscriptionLink( const _thingName_t * pThingName )
+{
+    return IotListDouble_FindFirstMatch( &( _AwsIotShadowSubscriptions[ pThingName->thingNameHash %
+                                                                         SHADOW_SUBSCRIPTION_BUCKET_COUNT ] ),
+                                         NULL,
+                                         _shadowSubscription_match,
+                                         ( void * ) pThingName );
+}
+
+/*-----------------------------------------------------------*/
+
 static AwsIotShadowError_t _modifyOperationSubscriptions( IotMqttConnection_t mqttConnection,
                                                           const char * pTopicFilter,
                                                           uint16_t topicFilterLength,
@@ -193,6 +304,155 @@ static AwsIotShadowError_t _modifyOperationSubscriptions( IotMqttConnection_t mq
 
 /*-----------------------------------------------------------*/
 
+#if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+    static bool _shadowWildcard_match( const IotLink_t * pWildcardLink,
+                                       void * pMatch )
+    {
+        /* Because this function is called from a container function, the given link
+         * must never be NULL. */
+        AwsIotShadow_Assert( pWildcardLink != NULL );
+
+        const _shadowWildcard_t * pWildcard = IotLink_Container( _shadowWildcard_t,
+                                                                 pWildcardLink,
+                                                                 link );
+
+        return( pWildcard->mqttConnection == ( IotMqttConnection_t ) pMatch );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static _shadowWildcard_t * _findWildcard( IotMqttConnection_t mqttConnection,
+                                              bool createNew )
+    {
+        _shadowWildcard_t * pWildcard = NULL;
+        IotLink_t * pWildcardLink = IotListDouble_FindFirstMatch( &( _AwsIotShadowWildcards ),
+                                                                  NULL,
+                                                                  _shadowWildcard_match,
+                                                                  ( void * ) mqttConnection );
+
+        if( pWildcardLink != NULL )
+        {
+            pWildcard = IotLink_Container( _shadowWildcard_t, pWildcardLink, link );
+        }
+        else if( createNew == true )
+        {
+            /* Wildcard subscriptions objects share the subscription allocator. */
+            pWildcard = AwsIotShadow_MallocSubscription( sizeof( _shadowWildcard_t ) );
+
+            if( pWildcard != NULL )
+            {
+                ( void ) memset( pWildcard, 0x00, sizeof( _shadowWildcard_t ) );
+                pWildcard->mqttConnection = mqttConnection;
+
+                IotListDouble_InsertHead( &( _AwsIotShadowWildcards ),
+                                          &( pWildcard->link ) );
+
+                IotLogDebug( "Created Shadow wildcard subscriptions object for "
+                             "MQTT connection %p.",
+                             mqttConnection );
+            }
+            else
+            {
+                IotLogError( "Failed to allocate memory for Shadow wildcard "
+                             "subscriptions of MQTT connection %p.",
+                             mqttConnection );
+            }
+        }
+
+        return pWildcard;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void _removeWildcard( _shadowWildcard_t * pWildcard )
+    {
+        int i = 0;
+
+        /* Keep the object while any wildcard subscription is referenced. */
+        for( i = 0; i < SHADOW_OPERATION_COUNT; i++ )
+        {
+            if( pWildcard->references[ i ] != 0 )
+            {
+                return;
+            }
+        }
+
+        IotListDouble_Remove( &( pWildcard->link ) );
+
+        IotLogDebug( "Removed Shadow wildcard subscriptions object for MQTT "
+                     "connection %p.",
+                     pWildcard->mqttConnection );
+
+        AwsIotShadow_FreeSubscription( pWildcard );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static AwsIotShadowError_t _modifyWildcardSubscription( IotMqttConnection_t mqttConnection,
+                                                            _shadowOperationType_t type,
+                                                            _mqttCallbackFunction_t callback,
+                                                            _mqttOperationFunction_t mqttOperation )
+    {
+        const char * pTopicFilter = _pWildcardTopicFilters[ type ];
+        const uint16_t topicFilterLength = ( uint16_t ) strlen( pTopicFilter );
+
+        /* The wildcard subscription should exist only when unsubscribing. */
+        AwsIotShadow_Assert( IotMqtt_IsSubscribed( mqttConnection,
+                                                   pTopicFilter,
+                                                   topicFilterLength,
+                                                   NULL ) == ( mqttOperation == IotMqtt_TimedUnsubscribe ) );
+
+        return _modifyOperationSubscriptions( mqttConnection,
+                                              pTopicFilter,
+                                              topicFilterLength,
+                                              callback,
+                                              mqttOperation );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static AwsIotShadowError_t _releaseWildcardSubscription( IotMqttConnection_t mqttConnection,
+                                                             _shadowOperationType_t type )
+    {
+        AwsIotShadowError_t status = AWS_IOT_SHADOW_STATUS_PENDING;
+        _shadowWildcard_t * pWildcard = _findWildcard( mqttConnection, false );
+
+        if( pWildcard == NULL )
+        {
+            IotLogError( "MQTT connection %p has no Shadow wildcard subscriptions.",
+                         mqttConnection );
+
+            status = AWS_IOT_SHADOW_BAD_PARAMETER;
+        }
+        else
+        {
+            /* Decrement the number of references. Ensure that it's not negative. */
+            ( pWildcard->references[ type ] )--;
+            AwsIotShadow_Assert( pWildcard->references[ type ] >= 0 );
+
+            if( pWildcard->references[ type ] == 0 )
+            {
+                IotLogDebug( "Reference count for Shadow %s wildcard subscription of "
+                             "MQTT connection %p is 0. Unsubscribing.",
+                             _pAwsIotShadowOperationNames[ type ],
+                             mqttConnection );
+
+                status = _modifyWildcardSubscription( mqttConnection,
+                                                      type,
+                                                      NULL,
+                                                      IotMqtt_TimedUnsubscribe );
+
+                /* Free the object once none of its subscriptions are referenced. */
+                _removeWildcard( pWildcard );
+            }
+        }
+
+        return status;
+    }
+#endif /* if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1 */
+
+/*-----------------------------------------------------------*/
+
 _shadowSubscription_t * _AwsIotShadow_FindSubscription( const char * pThingName,
                                                         size_t thingNameLength )
 {
@@ -201,14 +461,12 @@ _shadowSubscription_t * _AwsIotShadow_FindSubscription( const char * pThingName,
     _thingName_t thingName =
     {
         .pThingName      = pThingName,
-        .thingNameLength = thingNameLength
+        .thingNameLength = thingNameLength,
+        .thingNameHash   = _AwsIotShadow_HashThingName( pThingName, thingNameLength )
     };
 
     /* Search the list for an existing subscription for Thing Name. */
-    pSubscriptionLink = IotListDouble_FindFirstMatch( &( _AwsIotShadowSubscriptions ),
-                                                      NULL,
-                                                      _shadowSubscription_match,
-                                                      &thingName );
+    pSubscriptionLink = _findSubscriptionLink( &thingName );
 
     /* Check if a subscription was found. */
     if( pSubscriptionLink == NULL )
@@ -221,12 +479,15 @@ _shadowSubscription_t * _AwsIotShadow_FindSubscription( const char * pThingName,
             /* Clear the new subscription. */
             ( void ) memset( pSubscription, 0x00, sizeof( _shadowSubscription_t ) + thingNameLength );
 
-            /* Set the Thing Name length and copy the Thing Name into the new subscription. */
+            /* Set the Thing Name length and hash, and copy the Thing Name into
+             * the new subscription. */
             pSubscription->thingNameLength = thingNameLength;
+            pSubscription->thingNameHash = thingName.thingNameHash;
             ( void ) strncpy( pSubscription->pThingName, pThingName, thingNameLength );
 
-            /* Add the new subscription to the subscription list. */
-            IotListDouble_InsertHead( &( _AwsIotShadowSubscriptions ),
+            /* Add the new subscription to the subscription list for its hash. */
+            IotListDouble_InsertHead( &( _AwsIotShadowSubscriptions[ thingName.thingNameHash %
+                                                                     SHADOW_SUBSCRIPTION_BUCKET_COUNT ] ),
                                       &( pSubscription->link ) );
 
             IotLogDebug( "Created new Shadow subscriptions object for %.*s.",
@@ -254,6 +515,23 @@ _shadowSubscription_t * _AwsIotShadow_FindSubscription( const char * pThingName,
 
 /*-----------------------------------------------------------*/
 
+uint32_t _AwsIotShadow_HashThingName( const char * pThingName,
+                                      size_t thingNameLength )
+{
+    size_t i = 0;
+    uint32_t hash = 2166136261UL;
+
+    for( i = 0; i < thingNameLength; i++ )
+    {
+        hash ^= ( uint32_t ) ( uint8_t ) pThingName[ i ];
+        hash *= 16777619UL;
+    }
+
+    return hash;
+}
+
+/*-----------------------------------------------------------*/
+
 void _AwsIotShadow_RemoveSubscription( _shadowSubscription_t * pSubscription,
                                        _shadowSubscription_t ** pRemovedSubscription )
 {
@@ -329,9 +607,17 @@ void _AwsIotShadow_DestroySubscription( void * pData )
 {
     _shadowSubscription_t * pSubscription = ( _shadowSubscription_t * ) pData;
 
-    /* Free the topic buffer. It should not be NULL. */
-    AwsIotShadow_Assert( pSubscription->pTopicBuffer != NULL );
-    AwsIotShadow_FreeString( pSubscription->pTopicBuffer );
+    /* Free the topic buffer. It should not be NULL unless gateway mode is
+     * enabled, where operation topics do not use it. */
+    #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+        if( pSubscription->pTopicBuffer != NULL )
+        {
+            AwsIotShadow_FreeString( pSubscription->pTopicBuffer );
+        }
+    #else
+        AwsIotShadow_Assert( pSubscription->pTopicBuffer != NULL );
+        AwsIotShadow_FreeString( pSubscription->pTopicBuffer );
+    #endif
 
     /* Free memory used by subscription. */
     AwsIotShadow_FreeSubscription( pSubscription );
@@ -349,6 +635,10 @@ AwsIotShadowError_t _AwsIotShadow_IncrementReferences( _shadowOperation_t * pOpe
     const _shadowOperationType_t type = pOperation->type;
     _shadowSubscription_t * pSubscription = pOperation->pSubscription;
 
+    #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+        _shadowWildcard_t * pWildcard = NULL;
+    #endif
+
     /* Do nothing if this operation has persistent subscriptions. */
     if( pSubscription->references[ type ] == PERSISTENT_SUBSCRIPTION )
     {
@@ -365,8 +655,36 @@ AwsIotShadowError_t _AwsIotShadow_IncrementReferences( _shadowOperation_t * pOpe
      * not be negative. */
     AwsIotShadow_Assert( pSubscription->references[ type ] >= 0 );
 
-    /* Check if there are any existing references for this operation. */
-    if( pSubscription->references[ type ] == 0 )
+    /* In gateway mode, all Things on an MQTT connection share one wildcard
+     * subscription per operation type. Subscribe if it has no references. */
+    #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+        pWildcard = _findWildcard( pOperation->mqttConnection, true );
+
+        if( pWildcard == NULL )
+        {
+            return AWS_IOT_SHADOW_NO_MEMORY;
+        }
+
+        if( pWildcard->references[ type ] == 0 )
+        {
+            status = _modifyWildcardSubscription( pOperation->mqttConnection,
+                                                  type,
+                                                  callback,
+                                                  IotMqtt_TimedSubscribe );
+
+            if( status != AWS_IOT_SHADOW_STATUS_PENDING )
+            {
+                /* Free the wildcard subscriptions object if it was just created. */
+                _removeWildcard( pWildcard );
+
+                return status;
+            }
+        }
+    #endif
+
+    /* Otherwise, check if there are any existing references for this operation. */
+    if( ( AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 0 ) &&
+        ( pSubscription->references[ type ] == 0 ) )
     {
         /* Place the topic "accepted" suffix at the end of the Shadow topic buffer. */
         ( void ) memcpy( pTopicBuffer + operationTopicLength,
@@ -434,6 +752,10 @@ AwsIotShadowError_t _AwsIotShadow_IncrementReferences( _shadowOperation_t * pOpe
      * the keep subscriptions flag is not set. */
     if( ( pOperation->flags & AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS ) == 0 )
     {
+        #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+            ( pWildcard->references[ type ] )++;
+        #endif
+
         ( pSubscription->references[ type ] )++;
 
         IotLogDebug( "Shadow %s subscriptions for %.*s now has count %d.",
@@ -445,6 +767,16 @@ AwsIotShadowError_t _AwsIotShadow_IncrementReferences( _shadowOperation_t * pOpe
     /* Otherwise, set the persistent subscriptions flag. */
     else
     {
+        /* The references of this Thing's pending operations are replaced by
+         * a single persistent reference. Like the per-Thing subscriptions
+         * outside gateway mode, a Thing's subscriptions are kept on the MQTT
+         * connection of its operations. */
+        #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+            pWildcard->references[ type ] -= pSubscription->references[ type ];
+            AwsIotShadow_Assert( pWildcard->references[ type ] >= 0 );
+            ( pWildcard->references[ type ] )++;
+        #endif
+
         pSubscription->references[ type ] = PERSISTENT_SUBSCRIPTION;
 
         IotLogDebug( "Set persistent subscriptions flag for Shadow %s of %.*s.",
@@ -484,8 +816,15 @@ void _AwsIotShadow_DecrementReferences( _shadowOperation_t * pOperation,
     ( pSubscription->references[ type ] )--;
     AwsIotShadow_Assert( pSubscription->references[ type ] >= 0 );
 
-    /* Check if the number of references has reached 0. */
-    if( pSubscription->references[ type ] == 0 )
+    /* In gateway mode, release this operation's reference to the shared
+     * wildcard subscription. */
+    #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+        ( void ) _releaseWildcardSubscription( pOperation->mqttConnection, type );
+    #endif
+
+    /* Otherwise, check if the number of references has reached 0. */
+    if( ( AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 0 ) &&
+        ( pSubscription->references[ type ] == 0 ) )
     {
         IotLogDebug( "Reference count for %.*s %s is 0. Unsubscribing.",
                      pSubscription->thingNameLength,
@@ -555,7 +894,10 @@ AwsIotShadowError_t AwsIotShadow_RemovePersistentSubscriptions( IotMqttConnectio
                                                                 uint32_t flags )
 {
     int i = 0;
-    uint16_t operationTopicLength = 0, topicFilterLength = 0;
+
+    #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 0
+        uint16_t operationTopicLength = 0, topicFilterLength = 0;
+    #endif
     AwsIotShadowError_t removeAcceptedStatus = AWS_IOT_SHADOW_STATUS_PENDING,
                         removeRejectedStatus = AWS_IOT_SHADOW_STATUS_PENDING;
     _shadowSubscription_t * pSubscription = NULL;
@@ -563,7 +905,8 @@ AwsIotShadowError_t AwsIotShadow_RemovePersistentSubscriptions( IotMqttConnectio
     _thingName_t thingName =
     {
         .pThingName      = pThingName,
-        .thingNameLength = thingNameLength
+        .thingNameLength = thingNameLength,
+        .thingNameHash   = _AwsIotShadow_HashThingName( pThingName, thingNameLength )
     };
 
     IotLogInfo( "Removing persistent subscriptions for %.*s.",
@@ -573,10 +916,7 @@ AwsIotShadowError_t AwsIotShadow_RemovePersistentSubscriptions( IotMqttConnectio
     IotMutex_Lock( &( _AwsIotShadowSubscriptionsMutex ) );
 
     /* Search the list for an existing subscription for Thing Name. */
-    pSubscriptionLink = IotListDouble_FindFirstMatch( &( _AwsIotShadowSubscriptions ),
-                                                      NULL,
-                                                      _shadowSubscription_match,
-                                                      &thingName );
+    pSubscriptionLink = _findSubscriptionLink( &thingName );
 
     /* Unsubscribe from operation subscriptions if found. */
     if( pSubscriptionLink != NULL )
@@ -597,53 +937,64 @@ AwsIotShadowError_t AwsIotShadow_RemovePersistentSubscriptions( IotMqttConnectio
                              pThingName,
                              _pAwsIotShadowOperationNames[ i ] );
 
-                /* Subscription must have a topic buffer. */
-                AwsIotShadow_Assert( pSubscription->pTopicBuffer != NULL );
-
                 if( pSubscription->references[ i ] == PERSISTENT_SUBSCRIPTION )
                 {
-                    /* Generate the prefix of the Shadow topic. This function will not
-                     * fail when given a buffer. */
-                    ( void ) _AwsIotShadow_GenerateShadowTopic( ( _shadowOperationType_t ) i,
-                                                                pThingName,
-                                                                thingNameLength,
-                                                                &( pSubscription->pTopicBuffer ),
-                                                                &operationTopicLength );
-
-                    /* Remove the "accepted" topic. */
-                    ( void ) memcpy( pSubscription->pTopicBuffer + operationTopicLength,
-                                     SHADOW_ACCEPTED_SUFFIX,
-                                     SHADOW_ACCEPTED_SUFFIX_LENGTH );
-                    topicFilterLength = ( uint16_t ) ( operationTopicLength + SHADOW_ACCEPTED_SUFFIX_LENGTH );
-
-                    removeAcceptedStatus = _modifyOperationSubscriptions( mqttConnection,
-                                                                          pSubscription->pTopicBuffer,
-                                                                          topicFilterLength,
-                                                                          NULL,
-                                                                          IotMqtt_TimedUnsubscribe );
-
-                    if( removeAcceptedStatus != AWS_IOT_SHADOW_STATUS_PENDING )
-                    {
-                        break;
-                    }
-
-                    /* Remove the "rejected" topic. */
-                    ( void ) memcpy( pSubscription->pTopicBuffer + operationTopicLength,
-                                     SHADOW_REJECTED_SUFFIX,
-                                     SHADOW_ACCEPTED_SUFFIX_LENGTH );
-                    topicFilterLength = ( uint16_t ) ( operationTopicLength +
-                                                       SHADOW_REJECTED_SUFFIX_LENGTH );
-
-                    removeRejectedStatus = _modifyOperationSubscriptions( mqttConnection,
-                                                                          pSubscription->pTopicBuffer,
-                                                                          topicFilterLength,
-                                                                          NULL,
-                                                                          IotMqtt_TimedUnsubscribe );
-
-                    if( removeRejectedStatus != AWS_IOT_SHADOW_STATUS_PENDING )
-                    {
-                        break;
-                    }
+                    #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+                        /* Release this Thing's reference to the wildcard subscription. */
+                        removeAcceptedStatus = _releaseWildcardSubscription( mqttConnection,
+                                                                             ( _shadowOperationType_t ) i );
+
+                        if( removeAcceptedStatus != AWS_IOT_SHADOW_STATUS_PENDING )
+                        {
+                            break;
+                        }
+                    #else
+                        /* Subscription must have a topic buffer. */
+                        AwsIotShadow_Assert( pSubscription->pTopicBuffer != NULL );
+
+                        /* Generate the prefix of the Shadow topic. This function will not
+                         * fail when given a buffer. */
+                        ( void ) _AwsIotShadow_GenerateShadowTopic( ( _shadowOperationType_t ) i,
+                                                                    pThingName,
+                                                                    thingNameLength,
+                                                                    &( pSubscription->pTopicBuffer ),
+                                                                    &operationTopicLength );
+
+                        /* Remove the "accepted" topic. */
+                        ( void ) memcpy( pSubscription->pTopicBuffer + operationTopicLength,
+                                         SHADOW_ACCEPTED_SUFFIX,
+                                         SHADOW_ACCEPTED_SUFFIX_LENGTH );
+                        topicFilterLength = ( uint16_t ) ( operationTopicLength + SHADOW_ACCEPTED_SUFFIX_LENGTH );
+
+                        removeAcceptedStatus = _modifyOperationSubscriptions( mqttConnection,
+                                                                              pSubscription->pTopicBuffer,
+                                                                              topicFilterLength,
+                                                                              NULL,
+                                                                              IotMqtt_TimedUnsubscribe );
+
+                        if( removeAcceptedStatus != AWS_IOT_SHADOW_STATUS_PENDING )
+                        {
+                            break;
+                        }
+
+                        /* Remove the "rejected" topic. */
+                        ( void ) memcpy( pSubscription->pTopicBuffer + operationTopicLength,
+                                         SHADOW_REJECTED_SUFFIX,
+                                         SHADOW_ACCEPTED_SUFFIX_LENGTH );
+                        topicFilterLength = ( uint16_t ) ( operationTopicLength +
+                                                           SHADOW_REJECTED_SUFFIX_LENGTH );
+
+                        removeRejectedStatus = _modifyOperationSubscriptions( mqttConnection,
+                                                                              pSubscription->pTopicBuffer,
+                                                                              topicFilterLength,
+                                                                              NULL,
+                                                                              IotMqtt_TimedUnsubscribe );
+
+                        if( removeRejectedStatus != AWS_IOT_SHADOW_STATUS_PENDING )
+                        {
+                            break;
+                        }
+                    #endif /* if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1 */
 
                     /* Clear the persistent subscriptions flag. */
                     pSubscription->references[ i ] = 0;
@@ -41,6 +41,9 @@
 /* Platform layer types include. */
 #include "types/iot_platform_types.h"
 
+/* Task pool include. */
+#include "iot_taskpool.h"
+
 /* Shadow include. */
 #include "aws_iot_shadow.h"
 
@@ -124,6 +127,20 @@
  * (http://pubs.opengroup.org/onlinepubs/9699919799/functions/free.html).
  */
     void AwsIotShadow_FreeSubscription( void * ptr );
+
+/**
+ * @brief Allocate a #_shadowReported_t. This function should have the same
+ * signature as [malloc]
+ * (http://pubs.opengroup.org/onlinepubs/9699919799/functions/malloc.html).
+ */
+    void * AwsIotShadow_MallocReported( size_t size );
+
+/**
+ * @brief Free a #_shadowReported_t. This function should have the same
+ * signature as [free]
+ * (http://pubs.opengroup.org/onlinepubs/9699919799/functions/free.html).
+ */
+    void AwsIotShadow_FreeReported( void * ptr );
 #else /* if IOT_STATIC_MEMORY_ONLY == 1 */
     #include <stdlib.h>
 
@@ -150,6 +167,14 @@
     #ifndef AwsIotShadow_FreeSubscription
         #define AwsIotShadow_FreeSubscription    free
     #endif
+
+    #ifndef AwsIotShadow_MallocReported
+        #define AwsIotShadow_MallocReported    malloc
+    #endif
+
+    #ifndef AwsIotShadow_FreeReported
+        #define AwsIotShadow_FreeReported    free
+    #endif
 #endif /* if IOT_STATIC_MEMORY_ONLY == 1 */
 
 /**
@@ -159,10 +184,41 @@
  * Provide default values for undefined configuration constants.
  */
 #ifndef AWS_IOT_SHADOW_DEFAULT_MQTT_TIMEOUT_MS
-    #define AWS_IOT_SHADOW_DEFAULT_MQTT_TIMEOUT_MS    ( 5000 )
+    #define AWS_IOT_SHADOW_DEFAULT_MQTT_TIMEOUT_MS           ( 5000 )
+#endif
+#ifndef AWS_IOT_SHADOW_REPORTED_DEFAULT_FLUSH_WINDOW_MS
+    #define AWS_IOT_SHADOW_REPORTED_DEFAULT_FLUSH_WINDOW_MS    ( 1000 )
+#endif
+#ifndef AWS_IOT_SHADOW_REPORTED_MAX_FIELDS
+    #define AWS_IOT_SHADOW_REPORTED_MAX_FIELDS                 ( 8 )
+#endif
+#ifndef AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH
+    #define AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH             ( 32 )
+#endif
+#ifndef AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH
+    #define AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH           ( 32 )
+#endif
+#ifndef AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE
+    #define AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE                 ( 0 )
+#endif
+#ifndef AWS_IOT_SHADOW_GATEWAY_HASH_BUCKETS
+    #define AWS_IOT_SHADOW_GATEWAY_HASH_BUCKETS                ( 64 )
 #endif
 /** @endcond */
 
+/**
+ * @brief The number of lists that Shadow subscription objects are spread over,
+ * indexed by Thing Name hash.
+ *
+ * A single list is sufficient for devices that manage a few Things. Gateways
+ * that proxy many Things use @ref AWS_IOT_SHADOW_GATEWAY_HASH_BUCKETS lists.
+ */
+#if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+    #define SHADOW_SUBSCRIPTION_BUCKET_COUNT    ( AWS_IOT_SHADOW_GATEWAY_HASH_BUCKETS )
+#else
+    #define SHADOW_SUBSCRIPTION_BUCKET_COUNT    ( 1 )
+#endif
+
 /**
  * @brief The longest Thing Name accepted by the Shadow service, per the [AWS IoT
  * Service Limits](https://docs.aws.amazon.com/general/latest/gr/aws_service_limits.html#limits_iot).
@@ -270,6 +326,18 @@
  */
 #define SHADOW_LONGEST_SUFFIX_LENGTH             SHADOW_UPDATED_SUFFIX_LENGTH
 
+/**
+ * @brief The topic level that matches any Thing Name in a gateway mode wildcard
+ * subscription.
+ */
+#define SHADOW_WILDCARD_THING_NAME               "+"
+
+/**
+ * @brief The suffix that matches both the "accepted" and "rejected" topics in a
+ * gateway mode wildcard subscription.
+ */
+#define SHADOW_WILDCARD_SUFFIX                   "/+"
+
 /**
  * @brief The JSON key used to represent client tokens in a Shadow update document.
  */
@@ -295,6 +363,39 @@
  */
 #define PERSISTENT_SUBSCRIPTION                  ( -1 )
 
+/**
+ * @brief Opening of a reported state update document, up to the first key.
+ */
+#define SHADOW_REPORTED_DOCUMENT_PREFIX          "{\"state\":{\"reported\":{"
+
+/**
+ * @brief Length of #SHADOW_REPORTED_DOCUMENT_PREFIX.
+ */
+#define SHADOW_REPORTED_DOCUMENT_PREFIX_LENGTH   ( sizeof( SHADOW_REPORTED_DOCUMENT_PREFIX ) - 1 )
+
+/**
+ * @brief Text between the last reported field and the client token value.
+ */
+#define SHADOW_REPORTED_DOCUMENT_TOKEN           "}},\"" CLIENT_TOKEN_KEY "\":\"reported-"
+
+/**
+ * @brief Length of #SHADOW_REPORTED_DOCUMENT_TOKEN.
+ */
+#define SHADOW_REPORTED_DOCUMENT_TOKEN_LENGTH    ( sizeof( SHADOW_REPORTED_DOCUMENT_TOKEN ) - 1 )
+
+/**
+ * @brief Size of the buffer holding a reported state update document.
+ *
+ * Every field adds its quoted key, a colon, its value and a comma. The client
+ * token ends in a 32-bit version printed as at most 10 digits, followed by the
+ * closing quote and brace and the NUL terminator written by snprintf.
+ */
+#define SHADOW_REPORTED_DOCUMENT_SIZE                                                 \
+    ( SHADOW_REPORTED_DOCUMENT_PREFIX_LENGTH +                                        \
+      ( AWS_IOT_SHADOW_REPORTED_MAX_FIELDS *                                          \
+        ( AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH + AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH + 4 ) ) + \
+      SHADOW_REPORTED_DOCUMENT_TOKEN_LENGTH + 10 + 2 + 1 )
+
 /*----------------------- Shadow internal data types ------------------------*/
 
 /**
@@ -413,11 +514,13 @@ typedef struct _shadowOperation
 /**
  * @brief Represents a Shadow subscriptions object.
  *
- * These structures are stored in a list.
+ * These structures are stored in the list of #_AwsIotShadowSubscriptions selected
+ * by their Thing Name hash.
  */
 typedef struct _shadowSubscription
 {
     IotLink_t link;                                                /**< @brief List link member. */
+    uint32_t thingNameHash;                                        /**< @brief Hash of Thing Name, compared before the name itself. */
 
     int32_t references[ SHADOW_OPERATION_COUNT ];                  /**< @brief Reference counter for Shadow operation topics. */
     AwsIotShadowCallbackInfo_t callbacks[ SHADOW_CALLBACK_COUNT ]; /**< @brief Shadow callbacks for this Thing. */
@@ -426,7 +529,9 @@ typedef struct _shadowSubscription
      * @brief Buffer allocated for removing Shadow topics.
      *
      * This buffer is pre-allocated to ensure that memory is available when
-     * unsubscribing.
+     * unsubscribing. In gateway mode, operation topics are covered by shared
+     * wildcard subscriptions, so this buffer is only allocated for Things with
+     * Shadow callbacks and may be `NULL`.
      */
     char * pTopicBuffer;
 
@@ -434,6 +539,86 @@ typedef struct _shadowSubscription
     char pThingName[];      /**< @brief Thing Name associated with this subscriptions object. */
 } _shadowSubscription_t;
 
+#if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+
+/**
+ * @brief The wildcard subscriptions of one MQTT connection in gateway mode.
+ *
+ * These structures are stored in #_AwsIotShadowWildcards and are allocated
+ * with @ref AwsIotShadow_MallocSubscription. A structure is removed when none
+ * of its subscriptions have references.
+ */
+    typedef struct _shadowWildcard
+    {
+        IotLink_t link;                      /**< @brief List link member. */
+        IotMqttConnection_t mqttConnection; /**< @brief MQTT connection of the wildcard subscriptions. */
+
+        /**
+         * @brief Reference counter for the wildcard subscription of each Shadow
+         * operation type.
+         *
+         * Each pending operation that does not keep subscriptions holds one
+         * reference, and each Thing with persistent subscriptions for the
+         * operation holds one reference.
+         */
+        int32_t references[ SHADOW_OPERATION_COUNT ];
+    } _shadowWildcard_t;
+#endif /* if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1 */
+
+/**
+ * @brief One top-level field managed by a #_shadowReported_t.
+ *
+ * A field is dirty when its pending value differs from its acknowledged value.
+ * While a Shadow update carrying the field is in flight, the sent value is kept
+ * in `pInFlight` so that later changes to `pPending` do not affect what is
+ * recorded as acknowledged.
+ */
+typedef struct _shadowReportedField
+{
+    char pKey[ AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH ];            /**< @brief Field key, without quotes. */
+    size_t keyLength;                                               /**< @brief Length of pKey. */
+
+    char pAcknowledged[ AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH ]; /**< @brief Value last accepted by the Shadow service. */
+    size_t acknowledgedLength;                                      /**< @brief Length of pAcknowledged; `0` if never accepted. */
+
+    char pPending[ AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH ];      /**< @brief Latest value set by the application. */
+    size_t pendingLength;                                           /**< @brief Length of pPending. */
+
+    char pInFlight[ AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH ];     /**< @brief Value carried by the in-flight update. */
+    size_t inFlightLength;                                          /**< @brief Length of pInFlight. */
+    uint32_t inFlightVersion;                                       /**< @brief Version of the update carrying pInFlight; `0` if none. */
+} _shadowReportedField_t;
+
+/**
+ * @brief Internal structure representing a Shadow reported state manager.
+ */
+typedef struct _shadowReported
+{
+    IotMutex_t mutex;                      /**< @brief Protects all members of this struct. */
+    IotTaskPoolJobStorage_t flushJobStorage; /**< @brief Storage for flushJob. */
+    IotTaskPoolJob_t flushJob;             /**< @brief Deferred job that runs at the end of the flush window. */
+    bool flushScheduled;                   /**< @brief Whether flushJob is scheduled. */
+    bool destroyed;                        /**< @brief Set by @ref shadow_function_reporteddestroy; the last job or callback to finish frees the manager. */
+
+    IotMqttConnection_t mqttConnection; /**< @brief MQTT connection used for Shadow updates. */
+    IotMqttQos_t qos;                   /**< @brief QoS of Shadow updates. */
+    uint32_t retryLimit;                /**< @brief Retry limit of Shadow updates. */
+    uint32_t retryMs;                   /**< @brief First retry time of Shadow updates. */
+    uint32_t flushWindowMs;             /**< @brief Time that changes are held before being sent. */
+
+    uint32_t nextVersion;               /**< @brief Version to assign to the next Shadow update. */
+    uint32_t inFlightVersion;           /**< @brief Version of the in-flight Shadow update; `0` if none. */
+
+    size_t fieldCount;                                                 /**< @brief Number of valid entries in pFields. */
+    _shadowReportedField_t pFields[ AWS_IOT_SHADOW_REPORTED_MAX_FIELDS ]; /**< @brief Managed fields. */
+
+    char pDocument[ SHADOW_REPORTED_DOCUMENT_SIZE ]; /**< @brief Buffer for the in-flight update document. */
+    size_t documentLength;                           /**< @brief Length of the document in pDocument. */
+
+    size_t thingNameLength;                       /**< @brief Length of Thing Name. */
+    char pThingName[ MAX_THING_NAME_LENGTH ];     /**< @brief Thing Name whose reported state is managed. */
+} _shadowReported_t;
+
 /* Declarations of names printed in logs. */
 #if LIBRARY_LOG_LEVEL > IOT_LOG_NONE
     extern const char * const _pAwsIotShadowOperationNames[];
@@ -443,10 +628,14 @@ typedef struct _shadowSubscription
 /* Declarations of variables for internal Shadow files. */
 extern uint32_t _AwsIotShadowMqttTimeoutMs;
 extern IotListDouble_t _AwsIotShadowPendingOperations;
-extern IotListDouble_t _AwsIotShadowSubscriptions;
+extern IotListDouble_t _AwsIotShadowSubscriptions[ SHADOW_SUBSCRIPTION_BUCKET_COUNT ];
 extern IotMutex_t _AwsIotShadowPendingOperationsMutex;
 extern IotMutex_t _AwsIotShadowSubscriptionsMutex;
 
+#if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+    extern IotListDouble_t _AwsIotShadowWildcards;
+#endif
+
 /*----------------------- Shadow operation functions ------------------------*/
 
 /**
@@ -547,6 +736,17 @@ void _AwsIotShadow_Notify( _shadowOperation_t * pOperation );
 _shadowSubscription_t * _AwsIotShadow_FindSubscription( const char * pThingName,
                                                         size_t thingNameLength );
 
+/**
+ * @brief Calculate the hash of a Thing Name.
+ *
+ * @param[in] pThingName Thing Name to hash.
+ * @param[in] thingNameLength Length of `pThingName`.
+ *
+ * @return 32-bit FNV-1a hash of the Thing Name.
+ */
+uint32_t _AwsIotShadow_HashThingName( const char * pThingName,
+                                      size_t thingNameLength );
+
 /**
  * @brief Remove a Shadow subscription object from the subscription list if
  * unreferenced.
@@ -620,6 +820,42 @@ void _AwsIotShadow_DecrementReferences( _shadowOperation_t * pOperation,
                                         char * pTopicBuffer,
                                         _shadowSubscription_t ** pRemovedSubscription );
 
+/*-------------------- Shadow reported state functions ----------------------*/
+
+/**
+ * @brief Generate the update document for all dirty fields of a reported state
+ * manager and mark those fields as in flight.
+ *
+ * @param[in] pReported The reported state manager.
+ * @param[in] version Version to assign to the update; must not be `0`.
+ *
+ * @return `true` if a document was placed in #_shadowReported_t.pDocument;
+ * `false` if no field differs from its acknowledged value.
+ *
+ * @note This function should be called with the manager's mutex locked.
+ */
+bool _AwsIotShadow_ReportedSerialize( _shadowReported_t * pReported,
+                                      uint32_t version );
+
+/**
+ * @brief Record the outcome of a reported state update.
+ *
+ * On success, the in-flight values of the fields carried by `version` become
+ * their acknowledged values. On failure, those fields are left dirty so that
+ * only they are sent again.
+ *
+ * @param[in] pReported The reported state manager.
+ * @param[in] version Version of the completed update.
+ * @param[in] accepted Whether the Shadow service accepted the update.
+ *
+ * @return `true` if any field is still dirty after recording the outcome.
+ *
+ * @note This function should be called with the manager's mutex locked.
+ */
+bool _AwsIotShadow_ReportedComplete( _shadowReported_t * pReported,
+                                     uint32_t version,
+                                     bool accepted );
+
 /*------------------------- Shadow parser functions -------------------------*/
 
 /**
@@ -33,6 +33,7 @@
 
 /* Standard includes. */
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 /* SDK initialization include. */
@@ -98,6 +99,16 @@
  */
 #define TEST_THING_NAME_LENGTH         ( sizeof( TEST_THING_NAME ) - 1 )
 
+/**
+ * @brief A Thing Name used with a second MQTT connection.
+ */
+#define SECOND_THING_NAME              "SecondThingName"
+
+/**
+ * @brief The length of #SECOND_THING_NAME.
+ */
+#define SECOND_THING_NAME_LENGTH       ( sizeof( SECOND_THING_NAME ) - 1 )
+
 /**
  * @brief A delay that simulates the time required for an MQTT packet to be sent
  * to the server and for the server to send a response.
@@ -129,6 +140,14 @@ typedef struct _receiveContext
  */
 static _mqttConnection_t * _pMqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
 
+/**
+ * @brief The MQTT connection of the last packet sent by the send thread.
+ *
+ * The network connection of each MQTT connection in these tests is set to the
+ * MQTT connection itself, so that responses are received on the right one.
+ */
+static _mqttConnection_t * _pLastConnection = NULL;
+
 /**
  * @brief The #IotNetworkInterface_t to share among the tests.
  */
@@ -218,7 +237,7 @@ static void _receiveThread( void * pArgument )
 
     /* Call the MQTT receive callback to process the ACK packet. */
     IotMqtt_ReceiveCallback( &receiveContext,
-                             _pMqttConnection );
+                             _pLastConnection );
 
     IotMutex_Unlock( &_lastPacketMutex );
 }
@@ -238,9 +257,6 @@ static size_t _sendSuccess( void * pSendContext,
     _mqttPacket_t mqttPacket = { .u.pMqttConnection = NULL };
     _receiveContext_t receiveContext = { 0 };
 
-    /* Ignore the send context. */
-    ( void ) pSendContext;
-
     /* Read the packet type, which is the first byte in the message. */
     mqttPacket.type = *pMessage;
 
@@ -251,6 +267,9 @@ static size_t _sendSuccess( void * pSendContext,
     /* Lock the mutex to modify the information on the last packet sent. */
     IotMutex_Lock( &_lastPacketMutex );
 
+    /* The send context is the MQTT connection that sent this packet. */
+    _pLastConnection = ( _mqttConnection_t * ) pSendContext;
+
     /* Read the remaining length. */
     mqttPacket.remainingLength = _IotMqtt_GetRemainingLength( &receiveContext,
                                                               &_networkInterface );
@@ -410,6 +429,9 @@ TEST_SETUP( Shadow_Unit_API )
                                                          &networkInfo,
                                                          0 );
     TEST_ASSERT_NOT_NULL( _pMqttConnection );
+
+    /* Use the MQTT connection as the send context. */
+    _pMqttConnection->pNetworkConnection = _pMqttConnection;
 }
 
 /*-----------------------------------------------------------*/
@@ -456,6 +478,12 @@ TEST_GROUP_RUNNER( Shadow_Unit_API )
     RUN_TEST_CASE( Shadow_Unit_API, DeleteMallocFail );
     RUN_TEST_CASE( Shadow_Unit_API, GetMallocFail );
     RUN_TEST_CASE( Shadow_Unit_API, UpdateMallocFail );
+    RUN_TEST_CASE( Shadow_Unit_API, HashThingName );
+
+    #if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+        RUN_TEST_CASE( Shadow_Unit_API, SubscriptionHashBuckets );
+        RUN_TEST_CASE( Shadow_Unit_API, WildcardSubscriptionsPerConnection );
+    #endif
 }
 
 /*-----------------------------------------------------------*/
@@ -854,3 +882,205 @@ TEST( Shadow_Unit_API, UpdateMallocFail )
 }
 
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that Thing Names are hashed with 32-bit FNV-1a.
+ */
+TEST( Shadow_Unit_API, HashThingName )
+{
+    /* Published FNV-1a test vectors. */
+    TEST_ASSERT_EQUAL_HEX32( 0x811c9dc5, _AwsIotShadow_HashThingName( "", 0 ) );
+    TEST_ASSERT_EQUAL_HEX32( 0xe40c292c, _AwsIotShadow_HashThingName( "a", 1 ) );
+    TEST_ASSERT_EQUAL_HEX32( 0xbf9cf968, _AwsIotShadow_HashThingName( "foobar", 6 ) );
+
+    /* Only the given length of the Thing Name is hashed. */
+    TEST_ASSERT_EQUAL_HEX32( _AwsIotShadow_HashThingName( "foo", 3 ),
+                             _AwsIotShadow_HashThingName( "foobar", 3 ) );
+}
+
+/*-----------------------------------------------------------*/
+
+#if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1
+
+/**
+ * @brief Tests that subscription objects are kept in the list selected by the
+ * hash of their Thing Name, and found again with that hash.
+ */
+    TEST( Shadow_Unit_API, SubscriptionHashBuckets )
+    {
+        int i = 0;
+        char pThingNames[ 3 ][ 16 ] = { "Thing0", { 0 }, { 0 } };
+        size_t thingNameLengths[ 3 ] = { 6, 0, 0 };
+        uint32_t buckets[ 3 ] = { 0 };
+        _shadowSubscription_t * pSubscriptions[ 3 ] = { NULL };
+        IotListDouble_t * pBucket = NULL;
+
+        buckets[ 0 ] = _AwsIotShadow_HashThingName( pThingNames[ 0 ], thingNameLengths[ 0 ] ) %
+                       SHADOW_SUBSCRIPTION_BUCKET_COUNT;
+
+        /* Find a Thing Name in the same bucket as the first, and one in a
+         * different bucket. */
+        for( i = 1; ( i < 100 * SHADOW_SUBSCRIPTION_BUCKET_COUNT ) &&
+             ( ( thingNameLengths[ 1 ] == 0 ) || ( thingNameLengths[ 2 ] == 0 ) ); i++ )
+        {
+            char pThingName[ 16 ] = { 0 };
+            size_t thingNameLength = ( size_t ) snprintf( pThingName, sizeof( pThingName ), "Thing%d", i );
+            uint32_t bucket = _AwsIotShadow_HashThingName( pThingName, thingNameLength ) %
+                              SHADOW_SUBSCRIPTION_BUCKET_COUNT;
+            int slot = ( bucket == buckets[ 0 ] ) ? 1 : 2;
+
+            if( thingNameLengths[ slot ] == 0 )
+            {
+                ( void ) memcpy( pThingNames[ slot ], pThingName, sizeof( pThingName ) );
+                thingNameLengths[ slot ] = thingNameLength;
+                buckets[ slot ] = bucket;
+            }
+        }
+
+        TEST_ASSERT_NOT_EQUAL( 0, thingNameLengths[ 1 ] );
+        TEST_ASSERT_NOT_EQUAL( 0, thingNameLengths[ 2 ] );
+
+        IotMutex_Lock( &_AwsIotShadowSubscriptionsMutex );
+
+        if( TEST_PROTECT() )
+        {
+            for( i = 0; i < 3; i++ )
+            {
+                pSubscriptions[ i ] = _AwsIotShadow_FindSubscription( pThingNames[ i ],
+                                                                      thingNameLengths[ i ] );
+                TEST_ASSERT_NOT_NULL( pSubscriptions[ i ] );
+            }
+
+            TEST_ASSERT_NOT_EQUAL( pSubscriptions[ 0 ], pSubscriptions[ 1 ] );
+            TEST_ASSERT_NOT_EQUAL( pSubscriptions[ 0 ], pSubscriptions[ 2 ] );
+            TEST_ASSERT_NOT_EQUAL( pSubscriptions[ 1 ], pSubscriptions[ 2 ] );
+
+            for( i = 0; i < 3; i++ )
+            {
+                /* Each subscription object is in the list of its bucket. */
+                pBucket = &( _AwsIotShadowSubscriptions[ buckets[ i ] ] );
+                TEST_ASSERT_EQUAL_PTR( &( pSubscriptions[ i ]->link ),
+                                       IotListDouble_FindFirstMatch( pBucket,
+                                                                     NULL,
+                                                                     NULL,
+                                                                     &( pSubscriptions[ i ]->link ) ) );
+
+                /* Searching again finds the same object, also when it shares
+                 * its bucket with another Thing. */
+                TEST_ASSERT_EQUAL_PTR( pSubscriptions[ i ],
+                                       _AwsIotShadow_FindSubscription( pThingNames[ i ],
+                                                                       thingNameLengths[ i ] ) );
+            }
+
+            /* The Thing in another bucket is not in the first bucket. */
+            TEST_ASSERT_NULL( IotListDouble_FindFirstMatch( &( _AwsIotShadowSubscriptions[ buckets[ 0 ] ] ),
+                                                            NULL,
+                                                            NULL,
+                                                            &( pSubscriptions[ 2 ]->link ) ) );
+
+            /* Remove the unused subscription objects. */
+            for( i = 0; i < 3; i++ )
+            {
+                _AwsIotShadow_RemoveSubscription( pSubscriptions[ i ], NULL );
+            }
+
+            TEST_ASSERT_EQUAL_INT( true, IotListDouble_IsEmpty( &( _AwsIotShadowSubscriptions[ buckets[ 0 ] ] ) ) );
+            TEST_ASSERT_EQUAL_INT( true, IotListDouble_IsEmpty( &( _AwsIotShadowSubscriptions[ buckets[ 2 ] ] ) ) );
+        }
+
+        IotMutex_Unlock( &_AwsIotShadowSubscriptionsMutex );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that each MQTT connection has its own wildcard subscriptions.
+ */
+    TEST( Shadow_Unit_API, WildcardSubscriptionsPerConnection )
+    {
+        IotMqttNetworkInfo_t networkInfo = IOT_MQTT_NETWORK_INFO_INITIALIZER;
+        _mqttConnection_t * pSecondConnection = NULL;
+        AwsIotShadowDocumentInfo_t documentInfo = AWS_IOT_SHADOW_DOCUMENT_INFO_INITIALIZER;
+        AwsIotShadowOperation_t getOperation = AWS_IOT_SHADOW_OPERATION_INITIALIZER;
+        const char * pRetrievedDocument = NULL;
+        size_t retrievedDocumentSize = 0;
+        const char * const pGetFilter = SHADOW_TOPIC_PREFIX SHADOW_WILDCARD_THING_NAME
+                                        SHADOW_GET_OPERATION_STRING SHADOW_WILDCARD_SUFFIX;
+        const uint16_t getFilterLength = ( uint16_t ) strlen( pGetFilter );
+
+        /* Create a second MQTT connection that shares the network interface. */
+        networkInfo.pNetworkInterface = &_networkInterface;
+        pSecondConnection = IotTestMqtt_createMqttConnection( false,
+                                                              &networkInfo,
+                                                              0 );
+        TEST_ASSERT_NOT_NULL( pSecondConnection );
+        pSecondConnection->pNetworkConnection = pSecondConnection;
+
+        documentInfo.u.get.mallocDocument = IotTest_Malloc;
+
+        if( TEST_PROTECT() )
+        {
+            /* Keep the GET subscriptions of one Thing on each connection. No
+             * response is received, so each GET times out. */
+            documentInfo.pThingName = TEST_THING_NAME;
+            documentInfo.thingNameLength = TEST_THING_NAME_LENGTH;
+
+            TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_STATUS_PENDING,
+                               AwsIotShadow_Get( _pMqttConnection,
+                                                 &documentInfo,
+                                                 AWS_IOT_SHADOW_FLAG_WAITABLE | AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS,
+                                                 NULL,
+                                                 &getOperation ) );
+            TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_TIMEOUT,
+                               AwsIotShadow_Wait( getOperation,
+                                                  0,
+                                                  &pRetrievedDocument,
+                                                  &retrievedDocumentSize ) );
+
+            documentInfo.pThingName = SECOND_THING_NAME;
+            documentInfo.thingNameLength = SECOND_THING_NAME_LENGTH;
+
+            TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_STATUS_PENDING,
+                               AwsIotShadow_Get( pSecondConnection,
+                                                 &documentInfo,
+                                                 AWS_IOT_SHADOW_FLAG_WAITABLE | AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS,
+                                                 NULL,
+                                                 &getOperation ) );
+            TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_TIMEOUT,
+                               AwsIotShadow_Wait( getOperation,
+                                                  0,
+                                                  &pRetrievedDocument,
+                                                  &retrievedDocumentSize ) );
+
+            /* Both connections subscribed to the GET wildcard. */
+            TEST_ASSERT_EQUAL_INT( true, IotMqtt_IsSubscribed( _pMqttConnection, pGetFilter, getFilterLength, NULL ) );
+            TEST_ASSERT_EQUAL_INT( true, IotMqtt_IsSubscribed( pSecondConnection, pGetFilter, getFilterLength, NULL ) );
+
+            /* Removing the persistent subscriptions of the first Thing only
+             * unsubscribes the first connection. */
+            TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_SUCCESS,
+                               AwsIotShadow_RemovePersistentSubscriptions( _pMqttConnection,
+                                                                           TEST_THING_NAME,
+                                                                           TEST_THING_NAME_LENGTH,
+                                                                           AWS_IOT_SHADOW_FLAG_REMOVE_GET_SUBSCRIPTIONS ) );
+            TEST_ASSERT_EQUAL_INT( false, IotMqtt_IsSubscribed( _pMqttConnection, pGetFilter, getFilterLength, NULL ) );
+            TEST_ASSERT_EQUAL_INT( true, IotMqtt_IsSubscribed( pSecondConnection, pGetFilter, getFilterLength, NULL ) );
+
+            TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_SUCCESS,
+                               AwsIotShadow_RemovePersistentSubscriptions( pSecondConnection,
+                                                                           SECOND_THING_NAME,
+                                                                           SECOND_THING_NAME_LENGTH,
+                                                                           AWS_IOT_SHADOW_FLAG_REMOVE_GET_SUBSCRIPTIONS ) );
+            TEST_ASSERT_EQUAL_INT( false, IotMqtt_IsSubscribed( pSecondConnection, pGetFilter, getFilterLength, NULL ) );
+
+            /* No wildcard subscriptions objects remain. */
+            IotMutex_Lock( &_AwsIotShadowSubscriptionsMutex );
+            TEST_ASSERT_EQUAL_INT( true, IotListDouble_IsEmpty( &_AwsIotShadowWildcards ) );
+            IotMutex_Unlock( &_AwsIotShadowSubscriptionsMutex );
+        }
+
+        IotMqtt_Disconnect( pSecondConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+    }
+#endif /* if AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE == 1 */
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,887 @@
+/*
+ * FreeRTOS Shadow V2.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_iot_tests_shadow_reported.c
+ * @brief Tests for the Shadow reported state document generation,
+ * acknowledgement tracking, and flushing.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* SDK initialization include. */
+#include "iot_init.h"
+
+/* Shadow internal include. */
+#include "private/aws_iot_shadow_internal.h"
+
+/* Undefine logging configuration set in Shadow internal header. */
+#undef LIBRARY_LOG_NAME
+#undef LIBRARY_LOG_LEVEL
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Undefine logging configuration set in MQTT internal header. */
+#undef LIBRARY_LOG_NAME
+#undef LIBRARY_LOG_LEVEL
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+#include "platform/iot_threads.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/* MQTT test access include. */
+#include "iot_test_access_mqtt.h"
+
+/* Require Shadow library asserts to be enabled for these tests. The Shadow
+ * assert function is used to abort the tests on failure from the MQTT send
+ * or receive threads. */
+#if AWS_IOT_SHADOW_ENABLE_ASSERTS == 0
+    #error "Shadow reported state unit tests require AWS_IOT_SHADOW_ENABLE_ASSERTS to be 1."
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The Thing Name of the reported state managers in the flush tests.
+ */
+#define TEST_THING_NAME                "TestThingName"
+
+/**
+ * @brief The length of #TEST_THING_NAME.
+ */
+#define TEST_THING_NAME_LENGTH         ( sizeof( TEST_THING_NAME ) - 1 )
+
+/**
+ * @brief The topic of the Shadow updates sent for #TEST_THING_NAME.
+ */
+#define UPDATE_TOPIC                   "$aws/things/" TEST_THING_NAME "/shadow/update"
+
+/**
+ * @brief The length of #UPDATE_TOPIC.
+ */
+#define UPDATE_TOPIC_LENGTH            ( sizeof( UPDATE_TOPIC ) - 1 )
+
+/**
+ * @brief The topic on which the Shadow service accepts updates for
+ * #TEST_THING_NAME.
+ */
+#define ACCEPTED_TOPIC                 UPDATE_TOPIC "/accepted"
+
+/**
+ * @brief The length of #ACCEPTED_TOPIC.
+ */
+#define ACCEPTED_TOPIC_LENGTH          ( sizeof( ACCEPTED_TOPIC ) - 1 )
+
+/**
+ * @brief The flush window of the reported state managers in the flush tests.
+ */
+#define FLUSH_WINDOW_MS                ( 100 )
+
+/**
+ * @brief How long to wait for a Shadow update to be sent or completed.
+ */
+#define UPDATE_TIMEOUT_MS              ( 2000 )
+
+/**
+ * @brief How often to check if a Shadow update has completed.
+ */
+#define POLL_INTERVAL_MS               ( 10 )
+
+/**
+ * @brief A delay that simulates the time required for an MQTT packet to be sent
+ * to the server and for the server to send a response.
+ */
+#define NETWORK_ROUND_TRIP_TIME_MS     ( 25 )
+
+/**
+ * @brief The maximum size of any MQTT acknowledgement packet (e.g. SUBACK,
+ * UNSUBACK) used in these tests.
+ */
+#define ACKNOWLEDGEMENT_PACKET_SIZE    ( 5 )
+
+/**
+ * @brief The maximum size of the PUBLISH that accepts an update.
+ */
+#define ACCEPTED_PACKET_SIZE           ( 127 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Context for calls to the network receive function.
+ */
+typedef struct _receiveContext
+{
+    const uint8_t * pData; /**< @brief The data to receive. */
+    size_t dataLength;     /**< @brief Length of data. */
+    size_t dataIndex;      /**< @brief Next byte of data to read. */
+} _receiveContext_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The reported state manager shared among the tests.
+ */
+static _shadowReported_t _reported = { .fieldCount = 0 };
+
+/**
+ * @brief The MQTT connection object shared among the flush tests.
+ */
+static _mqttConnection_t * _pMqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+
+/**
+ * @brief The #IotNetworkInterface_t to share among the flush tests.
+ */
+static IotNetworkInterface_t _networkInterface = { 0 };
+
+/**
+ * @brief Timer used to simulate a response from the network.
+ */
+static IotTimer_t _receiveTimer;
+
+/**
+ * @brief Synchronizes the MQTT send and receive threads in the flush tests.
+ */
+static IotMutex_t _lastPacketMutex;
+
+/**
+ * @brief The type of the last SUBSCRIBE or UNSUBSCRIBE sent by the send thread.
+ */
+static uint8_t _lastPacketType = 0;
+
+/**
+ * @brief The packet identifier of the last packet sent by the send thread.
+ */
+static uint16_t _lastPacketIdentifier = 0;
+
+/**
+ * @brief Posted each time a Shadow update is sent.
+ */
+static IotSemaphore_t _updateSent;
+
+/**
+ * @brief The number of Shadow updates sent.
+ */
+static uint32_t _updateCount = 0;
+
+/**
+ * @brief The document of the last Shadow update sent.
+ */
+static char _pUpdateDocument[ SHADOW_REPORTED_DOCUMENT_SIZE ] = { 0 };
+
+/**
+ * @brief The length of #_pUpdateDocument.
+ */
+static size_t _updateDocumentLength = 0;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Set the pending value of a field, adding the field if needed.
+ */
+static void _setField( const char * pKey,
+                       const char * pValue )
+{
+    size_t i = 0;
+    _shadowReportedField_t * pField = NULL;
+
+    for( i = 0; i < _reported.fieldCount; i++ )
+    {
+        if( ( _reported.pFields[ i ].keyLength == strlen( pKey ) ) &&
+            ( strncmp( _reported.pFields[ i ].pKey, pKey, strlen( pKey ) ) == 0 ) )
+        {
+            pField = &( _reported.pFields[ i ] );
+        }
+    }
+
+    if( pField == NULL )
+    {
+        TEST_ASSERT_LESS_THAN( AWS_IOT_SHADOW_REPORTED_MAX_FIELDS, _reported.fieldCount );
+        pField = &( _reported.pFields[ _reported.fieldCount++ ] );
+        ( void ) memcpy( pField->pKey, pKey, strlen( pKey ) );
+        pField->keyLength = strlen( pKey );
+    }
+
+    ( void ) memcpy( pField->pPending, pValue, strlen( pValue ) );
+    pField->pendingLength = strlen( pValue );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Generate a document and check it against an expected document.
+ */
+static void _checkDocument( uint32_t version,
+                            const char * pExpectedDocument )
+{
+    if( pExpectedDocument == NULL )
+    {
+        TEST_ASSERT_FALSE( _AwsIotShadow_ReportedSerialize( &_reported, version ) );
+    }
+    else
+    {
+        TEST_ASSERT_TRUE( _AwsIotShadow_ReportedSerialize( &_reported, version ) );
+        TEST_ASSERT_EQUAL( strlen( pExpectedDocument ), _reported.documentLength );
+        TEST_ASSERT_EQUAL_STRING_LEN( pExpectedDocument,
+                                      _reported.pDocument,
+                                      _reported.documentLength );
+        _reported.inFlightVersion = version;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Invokes the MQTT receive callback to simulate a SUBACK or UNSUBACK
+ * received from the network.
+ */
+static void _receiveThread( void * pArgument )
+{
+    uint8_t pReceivedData[ ACKNOWLEDGEMENT_PACKET_SIZE ] = { 0 };
+    _receiveContext_t receiveContext = { 0 };
+
+    receiveContext.pData = pReceivedData;
+
+    /* Silence warnings about unused parameters. */
+    ( void ) pArgument;
+
+    IotMutex_Lock( &_lastPacketMutex );
+
+    AwsIotShadow_Assert( _lastPacketIdentifier != 0 );
+
+    pReceivedData[ 2 ] = UINT16_HIGH_BYTE( _lastPacketIdentifier );
+    pReceivedData[ 3 ] = UINT16_LOW_BYTE( _lastPacketIdentifier );
+
+    if( _lastPacketType == MQTT_PACKET_TYPE_SUBSCRIBE )
+    {
+        pReceivedData[ 0 ] = MQTT_PACKET_TYPE_SUBACK;
+        pReceivedData[ 1 ] = 3;
+        pReceivedData[ 4 ] = 1;
+        receiveContext.dataLength = 5;
+    }
+    else
+    {
+        AwsIotShadow_Assert( _lastPacketType == MQTT_PACKET_TYPE_UNSUBSCRIBE );
+
+        pReceivedData[ 0 ] = MQTT_PACKET_TYPE_UNSUBACK;
+        pReceivedData[ 1 ] = 2;
+        receiveContext.dataLength = 4;
+    }
+
+    IotMqtt_ReceiveCallback( &receiveContext,
+                             _pMqttConnection );
+
+    IotMutex_Unlock( &_lastPacketMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A send function that always "succeeds". It acknowledges subscriptions
+ * and keeps the document of each Shadow update.
+ */
+static size_t _send( void * pSendContext,
+                     const uint8_t * pMessage,
+                     size_t messageLength )
+{
+    _mqttOperation_t deserializedPublish = { .link = { 0 } };
+    _mqttPacket_t mqttPacket = { .u.pMqttConnection = NULL };
+    _receiveContext_t receiveContext = { 0 };
+    const IotMqttPublishInfo_t * pPublishInfo = &( deserializedPublish.u.publish.publishInfo );
+
+    /* Silence warnings about unused parameters. */
+    ( void ) pSendContext;
+
+    mqttPacket.type = *pMessage;
+    receiveContext.pData = pMessage + 1;
+    receiveContext.dataLength = messageLength;
+
+    IotMutex_Lock( &_lastPacketMutex );
+
+    mqttPacket.remainingLength = _IotMqtt_GetRemainingLength( &receiveContext,
+                                                              &_networkInterface );
+    AwsIotShadow_Assert( mqttPacket.remainingLength != MQTT_REMAINING_LENGTH_INVALID );
+
+    switch( mqttPacket.type & 0xf0 )
+    {
+        case MQTT_PACKET_TYPE_PUBLISH:
+
+            /* The managers send their updates at QoS 0, which is not
+             * acknowledged. */
+            mqttPacket.u.pIncomingPublish = &deserializedPublish;
+            mqttPacket.pRemainingData = ( uint8_t * ) pMessage + ( messageLength - mqttPacket.remainingLength );
+            AwsIotShadow_Assert( _IotMqtt_DeserializePublish( &mqttPacket ) == IOT_MQTT_SUCCESS );
+            AwsIotShadow_Assert( pPublishInfo->qos == IOT_MQTT_QOS_0 );
+            AwsIotShadow_Assert( pPublishInfo->topicNameLength == UPDATE_TOPIC_LENGTH );
+            AwsIotShadow_Assert( strncmp( pPublishInfo->pTopicName,
+                                          UPDATE_TOPIC,
+                                          UPDATE_TOPIC_LENGTH ) == 0 );
+            AwsIotShadow_Assert( pPublishInfo->payloadLength <= SHADOW_REPORTED_DOCUMENT_SIZE );
+
+            ( void ) memcpy( _pUpdateDocument, pPublishInfo->pPayload, pPublishInfo->payloadLength );
+            _updateDocumentLength = pPublishInfo->payloadLength;
+            _updateCount++;
+            IotSemaphore_Post( &_updateSent );
+            break;
+
+        case ( MQTT_PACKET_TYPE_SUBSCRIBE & 0xf0 ):
+        case ( MQTT_PACKET_TYPE_UNSUBSCRIBE & 0xf0 ):
+
+            _lastPacketType = mqttPacket.type;
+            _lastPacketIdentifier = UINT16_DECODE( receiveContext.pData + receiveContext.dataIndex );
+            AwsIotShadow_Assert( _lastPacketIdentifier != 0 );
+
+            /* Set the receive thread to run after a "network round-trip". */
+            AwsIotShadow_Assert( IotClock_TimerArm( &_receiveTimer,
+                                                    NETWORK_ROUND_TRIP_TIME_MS,
+                                                    0 ) == true );
+            break;
+
+        default:
+
+            /* The only valid outgoing packets are PUBLISH, SUBSCRIBE, and
+             * UNSUBSCRIBE. Abort if any other packet is found. */
+            AwsIotShadow_Assert( 0 );
+    }
+
+    IotMutex_Unlock( &_lastPacketMutex );
+
+    /* Return the message length to simulate a successful send. */
+    return messageLength;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Simulates a network receive function.
+ */
+static size_t _receive( void * pConnection,
+                        uint8_t * pBuffer,
+                        size_t bytesRequested )
+{
+    size_t bytesReceived = 0;
+    _receiveContext_t * pReceiveContext = pConnection;
+
+    AwsIotShadow_Assert( bytesRequested != 0 );
+    AwsIotShadow_Assert( pReceiveContext->dataIndex < pReceiveContext->dataLength );
+
+    /* Calculate how much data to copy. */
+    const size_t dataAvailable = pReceiveContext->dataLength - pReceiveContext->dataIndex;
+
+    if( bytesRequested > dataAvailable )
+    {
+        bytesReceived = dataAvailable;
+    }
+    else
+    {
+        bytesReceived = bytesRequested;
+    }
+
+    /* Copy data into given buffer. */
+    if( bytesReceived > 0 )
+    {
+        ( void ) memcpy( pBuffer,
+                         pReceiveContext->pData + pReceiveContext->dataIndex,
+                         bytesReceived );
+
+        pReceiveContext->dataIndex += bytesReceived;
+    }
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Create a reported state manager for #TEST_THING_NAME.
+ */
+static AwsIotShadowReported_t _createReported( void )
+{
+    AwsIotShadowReportedInfo_t reportedInfo = AWS_IOT_SHADOW_REPORTED_INFO_INITIALIZER;
+    AwsIotShadowReported_t reported = AWS_IOT_SHADOW_REPORTED_INITIALIZER;
+
+    reportedInfo.pThingName = TEST_THING_NAME;
+    reportedInfo.thingNameLength = TEST_THING_NAME_LENGTH;
+    reportedInfo.qos = IOT_MQTT_QOS_0;
+    reportedInfo.flushWindowMs = FLUSH_WINDOW_MS;
+
+    TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_SUCCESS,
+                       AwsIotShadow_ReportedCreate( _pMqttConnection,
+                                                    &reportedInfo,
+                                                    &reported ) );
+
+    return reported;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Set a field of a reported state manager.
+ */
+static void _reportField( AwsIotShadowReported_t reported,
+                          const char * pKey,
+                          const char * pValue )
+{
+    TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_SUCCESS,
+                       AwsIotShadow_ReportedSet( reported,
+                                                 pKey,
+                                                 strlen( pKey ),
+                                                 pValue,
+                                                 strlen( pValue ) ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Wait for a Shadow update and check its document.
+ */
+static void _checkUpdate( const char * pExpectedDocument )
+{
+    TEST_ASSERT_TRUE( IotSemaphore_TimedWait( &_updateSent, UPDATE_TIMEOUT_MS ) );
+
+    IotMutex_Lock( &_lastPacketMutex );
+    TEST_ASSERT_EQUAL( strlen( pExpectedDocument ), _updateDocumentLength );
+    TEST_ASSERT_EQUAL_STRING_LEN( pExpectedDocument,
+                                  _pUpdateDocument,
+                                  _updateDocumentLength );
+    IotMutex_Unlock( &_lastPacketMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Simulate the Shadow service accepting an update.
+ */
+static void _acceptUpdate( uint32_t version )
+{
+    uint8_t pPublish[ ACCEPTED_PACKET_SIZE + 2 ] = { 0 };
+    _receiveContext_t receiveContext = { 0 };
+    size_t remainingLength = 0;
+    int payloadLength = 0;
+
+    /* The response carries the client token of the update it accepts. */
+    payloadLength = snprintf( ( char * ) pPublish + 4 + ACCEPTED_TOPIC_LENGTH,
+                              ACCEPTED_PACKET_SIZE - 2 - ACCEPTED_TOPIC_LENGTH,
+                              "{\"" CLIENT_TOKEN_KEY "\":\"reported-%lu\"}",
+                              ( unsigned long ) version );
+    TEST_ASSERT_GREATER_THAN( 0, payloadLength );
+
+    /* The remaining length fits in a single byte. */
+    remainingLength = 2 + ACCEPTED_TOPIC_LENGTH + ( size_t ) payloadLength;
+    TEST_ASSERT_LESS_OR_EQUAL( ACCEPTED_PACKET_SIZE, remainingLength );
+
+    pPublish[ 0 ] = MQTT_PACKET_TYPE_PUBLISH;
+    pPublish[ 1 ] = ( uint8_t ) remainingLength;
+    pPublish[ 2 ] = UINT16_HIGH_BYTE( ACCEPTED_TOPIC_LENGTH );
+    pPublish[ 3 ] = UINT16_LOW_BYTE( ACCEPTED_TOPIC_LENGTH );
+    ( void ) memcpy( pPublish + 4, ACCEPTED_TOPIC, ACCEPTED_TOPIC_LENGTH );
+
+    receiveContext.pData = pPublish;
+    receiveContext.dataLength = 2 + remainingLength;
+
+    IotMutex_Lock( &_lastPacketMutex );
+    IotMqtt_ReceiveCallback( &receiveContext,
+                             _pMqttConnection );
+    IotMutex_Unlock( &_lastPacketMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Wait until a reported state manager has no update scheduled or in
+ * flight.
+ */
+static bool _waitForIdle( AwsIotShadowReported_t reported )
+{
+    bool idle = false;
+    uint32_t waitedMs = 0;
+
+    while( waitedMs <= UPDATE_TIMEOUT_MS )
+    {
+        IotMutex_Lock( &( reported->mutex ) );
+        idle = ( reported->flushScheduled == false ) && ( reported->inFlightVersion == 0 );
+        IotMutex_Unlock( &( reported->mutex ) );
+
+        if( idle == true )
+        {
+            break;
+        }
+
+        IotClock_SleepMs( POLL_INTERVAL_MS );
+        waitedMs += POLL_INTERVAL_MS;
+    }
+
+    return idle;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for Shadow reported state tests.
+ */
+TEST_GROUP( Shadow_Unit_Reported );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for Shadow reported state tests.
+ */
+TEST_SETUP( Shadow_Unit_Reported )
+{
+    ( void ) memset( &_reported, 0x00, sizeof( _shadowReported_t ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for Shadow reported state tests.
+ */
+TEST_TEAR_DOWN( Shadow_Unit_Reported )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for Shadow reported state tests.
+ */
+TEST_GROUP_RUNNER( Shadow_Unit_Reported )
+{
+    RUN_TEST_CASE( Shadow_Unit_Reported, MergePendingChanges );
+    RUN_TEST_CASE( Shadow_Unit_Reported, OnlyChangedFields );
+    RUN_TEST_CASE( Shadow_Unit_Reported, RetryOnlyUnacknowledged );
+    RUN_TEST_CASE( Shadow_Unit_Reported, ChangeWhileInFlight );
+    RUN_TEST_CASE( Shadow_Unit_Reported, LargestDocument );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that repeated changes to a field are merged into one value.
+ */
+TEST( Shadow_Unit_Reported, MergePendingChanges )
+{
+    /* Nothing to send without fields. */
+    _checkDocument( 1, NULL );
+
+    _setField( "temperature", "20" );
+    _setField( "temperature", "21" );
+    _setField( "power", "\"on\"" );
+    _setField( "temperature", "22" );
+
+    _checkDocument( 1, "{\"state\":{\"reported\":{\"temperature\":22,\"power\":\"on\"}},"
+                       "\"clientToken\":\"reported-1\"}" );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that acknowledged fields are not sent again.
+ */
+TEST( Shadow_Unit_Reported, OnlyChangedFields )
+{
+    _setField( "temperature", "22" );
+    _setField( "power", "\"on\"" );
+    _checkDocument( 1, "{\"state\":{\"reported\":{\"temperature\":22,\"power\":\"on\"}},"
+                       "\"clientToken\":\"reported-1\"}" );
+
+    /* Accepting the update leaves nothing dirty. */
+    TEST_ASSERT_FALSE( _AwsIotShadow_ReportedComplete( &_reported, 1, true ) );
+    TEST_ASSERT_EQUAL( 0, _reported.inFlightVersion );
+    _checkDocument( 2, NULL );
+
+    /* Setting a field to its acknowledged value is not a change. */
+    _setField( "power", "\"on\"" );
+    _checkDocument( 2, NULL );
+
+    /* Only the changed field is sent. */
+    _setField( "temperature", "23" );
+    _checkDocument( 2, "{\"state\":{\"reported\":{\"temperature\":23}},"
+                       "\"clientToken\":\"reported-2\"}" );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a failed update resends only the fields it carried that
+ * were never acknowledged.
+ */
+TEST( Shadow_Unit_Reported, RetryOnlyUnacknowledged )
+{
+    _setField( "temperature", "22" );
+    _checkDocument( 1, "{\"state\":{\"reported\":{\"temperature\":22}},"
+                       "\"clientToken\":\"reported-1\"}" );
+    TEST_ASSERT_FALSE( _AwsIotShadow_ReportedComplete( &_reported, 1, true ) );
+
+    _setField( "power", "\"off\"" );
+    _checkDocument( 2, "{\"state\":{\"reported\":{\"power\":\"off\"}},"
+                       "\"clientToken\":\"reported-2\"}" );
+
+    /* The rejected field remains dirty and is sent again. */
+    TEST_ASSERT_TRUE( _AwsIotShadow_ReportedComplete( &_reported, 2, false ) );
+    TEST_ASSERT_EQUAL( 0, _reported.inFlightVersion );
+    _checkDocument( 3, "{\"state\":{\"reported\":{\"power\":\"off\"}},"
+                       "\"clientToken\":\"reported-3\"}" );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a change made while an update is in flight is not marked
+ * as acknowledged by that update.
+ */
+TEST( Shadow_Unit_Reported, ChangeWhileInFlight )
+{
+    _setField( "temperature", "22" );
+    _checkDocument( 1, "{\"state\":{\"reported\":{\"temperature\":22}},"
+                       "\"clientToken\":\"reported-1\"}" );
+
+    _setField( "temperature", "25" );
+
+    /* The acknowledged value is the one that was sent, so 25 is still dirty. */
+    TEST_ASSERT_TRUE( _AwsIotShadow_ReportedComplete( &_reported, 1, true ) );
+    _checkDocument( 2, "{\"state\":{\"reported\":{\"temperature\":25}},"
+                       "\"clientToken\":\"reported-2\"}" );
+
+    /* Change back to 22 while 25 is in flight. Once 25 is acknowledged, 22
+     * differs from it and must be sent. */
+    _setField( "temperature", "22" );
+    TEST_ASSERT_TRUE( _AwsIotShadow_ReportedComplete( &_reported, 2, true ) );
+    _checkDocument( 3, "{\"state\":{\"reported\":{\"temperature\":22}},"
+                       "\"clientToken\":\"reported-3\"}" );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a document with every field at its longest key and value
+ * and the longest version fits in the document buffer.
+ */
+TEST( Shadow_Unit_Reported, LargestDocument )
+{
+    char pKey[ AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH + 1 ] = { 0 };
+    char pValue[ AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH + 1 ] = { 0 };
+    const char * pEnd = "\"reported-4294967295\"}";
+    size_t i = 0;
+
+    ( void ) memset( pKey, 'k', AWS_IOT_SHADOW_REPORTED_MAX_KEY_LENGTH );
+    ( void ) memset( pValue, '1', AWS_IOT_SHADOW_REPORTED_MAX_VALUE_LENGTH );
+
+    /* Keys differ in their first character. */
+    for( i = 0; i < AWS_IOT_SHADOW_REPORTED_MAX_FIELDS; i++ )
+    {
+        pKey[ 0 ] = ( char ) ( 'a' + i );
+        _setField( pKey, pValue );
+    }
+
+    TEST_ASSERT_TRUE( _AwsIotShadow_ReportedSerialize( &_reported, UINT32_MAX ) );
+    TEST_ASSERT_LESS_THAN( SHADOW_REPORTED_DOCUMENT_SIZE, _reported.documentLength );
+    TEST_ASSERT_EQUAL_STRING_LEN( pEnd,
+                                  _reported.pDocument + _reported.documentLength - strlen( pEnd ),
+                                  strlen( pEnd ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for Shadow reported state flush tests.
+ */
+TEST_GROUP( Shadow_Unit_Reported_Flush );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for Shadow reported state flush tests.
+ */
+TEST_SETUP( Shadow_Unit_Reported_Flush )
+{
+    IotMqttNetworkInfo_t networkInfo = IOT_MQTT_NETWORK_INFO_INITIALIZER;
+
+    /* Initialize SDK. */
+    TEST_ASSERT_EQUAL_INT( true, IotSdk_Init() );
+
+    /* Initialize the MQTT library. */
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Init() );
+
+    /* Initialize the Shadow library. */
+    TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_SUCCESS, AwsIotShadow_Init( 0 ) );
+
+    /* Clear the last packet and update. */
+    _lastPacketType = 0;
+    _lastPacketIdentifier = 0;
+    _updateCount = 0;
+    _updateDocumentLength = 0;
+
+    /* Create the mutex that synchronizes the receive callback and send thread. */
+    TEST_ASSERT_EQUAL_INT( true, IotMutex_Create( &_lastPacketMutex, false ) );
+
+    /* Create the semaphore posted for each update. */
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &_updateSent, 0, 10 ) );
+
+    /* Create the receive thread timer. */
+    IotClock_TimerCreate( &_receiveTimer,
+                          _receiveThread,
+                          NULL );
+
+    /* Set the network interface send function. */
+    ( void ) memset( &_networkInterface, 0x00, sizeof( IotNetworkInterface_t ) );
+    _networkInterface.send = _send;
+    _networkInterface.receive = _receive;
+    networkInfo.pNetworkInterface = &_networkInterface;
+
+    /* Initialize the MQTT connection object to use for the Shadow tests. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( false,
+                                                         &networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for Shadow reported state flush tests.
+ */
+TEST_TEAR_DOWN( Shadow_Unit_Reported_Flush )
+{
+    /* Clean up the MQTT connection object. */
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+
+    /* Clean up the Shadow library. */
+    AwsIotShadow_Cleanup();
+
+    /* Clean up the MQTT library. */
+    IotMqtt_Cleanup();
+
+    /* Clean up SDK. */
+    IotSdk_Cleanup();
+
+    /* Destroy the receive thread timer. */
+    IotClock_TimerDestroy( &_receiveTimer );
+
+    /* Wait for the receive thread to finish and release the last packet mutex. */
+    IotMutex_Lock( &_lastPacketMutex );
+
+    /* Destroy the last packet mutex and the update semaphore. */
+    IotMutex_Unlock( &_lastPacketMutex );
+    IotMutex_Destroy( &_lastPacketMutex );
+    IotSemaphore_Destroy( &_updateSent );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for Shadow reported state flush tests.
+ */
+TEST_GROUP_RUNNER( Shadow_Unit_Reported_Flush )
+{
+    RUN_TEST_CASE( Shadow_Unit_Reported_Flush, MergeWithinWindow );
+    RUN_TEST_CASE( Shadow_Unit_Reported_Flush, DestroyPendingFlush );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that the changes made within a flush window, or while an update
+ * is in flight, are sent as one update.
+ */
+TEST( Shadow_Unit_Reported_Flush, MergeWithinWindow )
+{
+    AwsIotShadowReported_t reported = _createReported();
+
+    /* The window starts at the first change. */
+    _reportField( reported, "temperature", "20" );
+    IotClock_SleepMs( FLUSH_WINDOW_MS / 4 );
+    _reportField( reported, "temperature", "21" );
+    _reportField( reported, "power", "\"on\"" );
+    IotClock_SleepMs( FLUSH_WINDOW_MS / 4 );
+    _reportField( reported, "temperature", "22" );
+
+    /* Nothing is sent before the window ends. */
+    TEST_ASSERT_EQUAL( 0, _updateCount );
+
+    _checkUpdate( "{\"state\":{\"reported\":{\"temperature\":22,\"power\":\"on\"}},"
+                  "\"clientToken\":\"reported-1\"}" );
+
+    /* Changes made while the update is in flight wait for its completion. */
+    _reportField( reported, "temperature", "23" );
+    _reportField( reported, "temperature", "24" );
+    IotClock_SleepMs( FLUSH_WINDOW_MS * 2 );
+    TEST_ASSERT_EQUAL( 1, _updateCount );
+
+    _acceptUpdate( 1 );
+    _checkUpdate( "{\"state\":{\"reported\":{\"temperature\":24}},"
+                  "\"clientToken\":\"reported-2\"}" );
+
+    _acceptUpdate( 2 );
+    TEST_ASSERT_TRUE( _waitForIdle( reported ) );
+    TEST_ASSERT_EQUAL( 2, _updateCount );
+
+    AwsIotShadow_ReportedDestroy( reported );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that destroying a manager with a pending flush releases the
+ * manager and sends nothing more.
+ */
+TEST( Shadow_Unit_Reported_Flush, DestroyPendingFlush )
+{
+    AwsIotShadowReported_t reported = _createReported();
+
+    /* A scheduled flush is canceled, and the manager is freed at once. */
+    _reportField( reported, "temperature", "20" );
+    TEST_ASSERT_TRUE( reported->flushScheduled );
+    AwsIotShadow_ReportedDestroy( reported );
+
+    IotClock_SleepMs( FLUSH_WINDOW_MS * 2 );
+    TEST_ASSERT_EQUAL( 0, _updateCount );
+
+    /* With static memory, this reuses the manager freed above. */
+    reported = _createReported();
+
+    /* A manager destroyed with an update in flight is freed when the update
+     * completes, without sending the changes made meanwhile. */
+    _reportField( reported, "temperature", "21" );
+    _checkUpdate( "{\"state\":{\"reported\":{\"temperature\":21}},"
+                  "\"clientToken\":\"reported-1\"}" );
+
+    _reportField( reported, "temperature", "22" );
+    AwsIotShadow_ReportedDestroy( reported );
+    _acceptUpdate( 1 );
+
+    IotClock_SleepMs( FLUSH_WINDOW_MS * 2 );
+    TEST_ASSERT_EQUAL( 1, _updateCount );
+}
+
+/*-----------------------------------------------------------*/
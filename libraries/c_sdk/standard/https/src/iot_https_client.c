@@ -370,6 +370,25 @@ static IotHttpsReturnCode_t _networkSend( _httpsConnection_t * pHttpsConnection,
                                           uint8_t * pBuf,
                                           size_t len );
 
+/**
+ * @brief Send data held in several buffers on the network.
+ *
+ * The buffers are passed together to the network interface's sendv when it has
+ * one, so that a TLS connection can send them in a single record. Anything
+ * sendv leaves unsent, or every buffer when there is no sendv, is sent with
+ * _networkSend.
+ *
+ * @param[in] pHttpsConnection - HTTP connection context.
+ * @param[in] pVectors - The buffers containing the data to send, in order.
+ * @param[in] vectorCount - The number of buffers in pVectors.
+ *
+ * @return #IOT_HTTPS_OK if the data sent successfully.
+ *         #IOT_HTTPS_NETWORK_ERROR if there was an error sending the data on the network.
+ */
+static IotHttpsReturnCode_t _networkSendv( _httpsConnection_t * pHttpsConnection,
+                                           const IotNetworkIoVector_t * pVectors,
+                                           size_t vectorCount );
+
 /**
  * @brief Receive data on the network.
  *
@@ -387,10 +406,11 @@ static IotHttpsReturnCode_t _networkRecv( _httpsConnection_t * pHttpsConnection,
                                           size_t * numBytesRecv );
 
 /**
- * @brief Send all of the HTTP request headers in the pHeadersBuf and the final Content-Length and Connection headers.
+ * @brief Send all of the HTTP request headers in the pHeadersBuf, the final Content-Length and Connection headers,
+ * and the request body in pBodyBuf.
  *
  * All of the headers in headerbuf are sent first followed by the computed content length and persistent connection
- * indication.
+ * indication, then the body. They are passed to the network in one call so that they can share a TLS record.
  *
  * @param[in] pHttpsConnection - HTTP connection context.
  * @param[in] pHeadersBuf - The buffer containing the request headers to send. This buffer must contain HTTP headers
@@ -398,29 +418,19 @@ static IotHttpsReturnCode_t _networkRecv( _httpsConnection_t * pHttpsConnection,
  * @param[in] headersLength - The length of the request headers to send.
  * @param[in] isNonPersistent - Indicator of whether the connection is persistent or not.
  * @param[in] contentLength - The length of the request body used for automatically creating a "Content-Length" header.
+ * @param[in] pBodyBuf - Buffer of the request body to send, or NULL if there is no body.
+ * @param[in] bodyLength - The length of the body to send.
  *
- * @return #IOT_HTTPS_OK if the headers were fully sent successfully.
- *         #IOT_HTTPS_NETWORK_ERROR if there was an error receiving the data on the network.
+ * @return #IOT_HTTPS_OK if the headers and body were fully sent successfully.
+ *         #IOT_HTTPS_NETWORK_ERROR if there was an error sending the data on the network.
  */
 static IotHttpsReturnCode_t _sendHttpsHeaders( _httpsConnection_t * pHttpsConnection,
                                                uint8_t * pHeadersBuf,
                                                uint32_t headersLength,
                                                bool isNonPersistent,
-                                               uint32_t contentLength );
-
-/**
- * @brief Send all of the HTTP request body in pBodyBuf.
- *
- * @param[in] pHttpsConnection - HTTP connection context.
- * @param[in] pBodyBuf - Buffer of the request body to send.
- * @param[in] bodyLength - The length of the body to send.
- *
- * @return #IOT_HTTPS_OK if the body was fully sent successfully.
- *         #IOT_HTTPS_NETWORK_ERROR if there was an error receiving the data on the network.
- */
-static IotHttpsReturnCode_t _sendHttpsBody( _httpsConnection_t * pHttpsConnection,
-                                            uint8_t * pBodyBuf,
-                                            uint32_t bodyLength );
+                                               uint32_t contentLength,
+                                               uint8_t * pBodyBuf,
+                                               uint32_t bodyLength );
 
 /**
  * @brief Parse the HTTP response message in pBuf.
@@ -1647,6 +1657,55 @@ static IotHttpsReturnCode_t _networkSend( _httpsConnection_t * pHttpsConnection,
 
 /*-----------------------------------------------------------*/
 
+static IotHttpsReturnCode_t _networkSendv( _httpsConnection_t * pHttpsConnection,
+                                           const IotNetworkIoVector_t * pVectors,
+                                           size_t vectorCount )
+{
+    HTTPS_FUNCTION_ENTRY( IOT_HTTPS_OK );
+
+    size_t numBytesSent = 0;
+    size_t i = 0;
+
+    if( pHttpsConnection->pNetworkInterface->sendv != NULL )
+    {
+        numBytesSent = pHttpsConnection->pNetworkInterface->sendv( pHttpsConnection->pNetworkConnection,
+                                                                   pVectors,
+                                                                   vectorCount );
+
+        /* pNetworkInterface->sendv returns 0 on error. */
+        if( numBytesSent == 0 )
+        {
+            IotLogError( "Error sending %d buffers on the network.", vectorCount );
+            HTTPS_SET_AND_GOTO_CLEANUP( IOT_HTTPS_NETWORK_ERROR );
+        }
+    }
+
+    /* Skip the bytes sendv already sent and send the rest one buffer at a time. */
+    for( i = 0; i < vectorCount; i++ )
+    {
+        if( numBytesSent >= pVectors[ i ].length )
+        {
+            numBytesSent -= pVectors[ i ].length;
+        }
+        else
+        {
+            status = _networkSend( pHttpsConnection,
+                                   ( uint8_t * ) &( pVectors[ i ].pBuffer[ numBytesSent ] ),
+                                   pVectors[ i ].length - numBytesSent );
+            numBytesSent = 0;
+
+            if( HTTPS_FAILED( status ) )
+            {
+                HTTPS_GOTO_CLEANUP();
+            }
+        }
+    }
+
+    HTTPS_FUNCTION_EXIT_NO_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
 static IotHttpsReturnCode_t _networkRecv( _httpsConnection_t * pHttpsConnection,
                                           uint8_t * pBuf,
                                           size_t bufLen,
@@ -1688,13 +1747,18 @@ static IotHttpsReturnCode_t _sendHttpsHeaders( _httpsConnection_t * pHttpsConnec
                                                uint8_t * pHeadersBuf,
                                                uint32_t headersLength,
                                                bool isNonPersistent,
-                                               uint32_t contentLength )
+                                               uint32_t contentLength,
+                                               uint8_t * pBodyBuf,
+                                               uint32_t bodyLength )
 {
     HTTPS_FUNCTION_ENTRY( IOT_HTTPS_OK );
 
     const char * connectionHeader = NULL;
     int numWritten = 0;
     int connectionHeaderLen = 0;
+    /* The headers in pHeadersBuf, the final headers and the body. */
+    IotNetworkIoVector_t vectors[ 3 ] = { { 0 } };
+    size_t vectorCount = 2;
     /* The Content-Length header of the form "Content-Length: N\r\n" with a NULL terminator for snprintf. */
     char contentLengthHeaderStr[ HTTPS_MAX_CONTENT_LENGTH_LINE_LENGTH + 1 ];
 
@@ -1705,15 +1769,6 @@ static IotHttpsReturnCode_t _sendHttpsHeaders( _httpsConnection_t * pHttpsConnec
      * both the connection type strings will fit in the buffer. */
     char finalHeaders[ HTTPS_MAX_CONTENT_LENGTH_LINE_LENGTH + HTTPS_CONNECTION_KEEP_ALIVE_HEADER_LINE_LENGTH + HTTPS_END_OF_HEADER_LINES_INDICATOR_LENGTH ] = { 0 };
 
-    /* Send the headers passed into this function first. These headers are not terminated with a second set of "\r\n". */
-    status = _networkSend( pHttpsConnection, pHeadersBuf, headersLength );
-
-    if( HTTPS_FAILED( status ) )
-    {
-        IotLogError( "Error sending the HTTPS headers in the request user buffer. Error code: %d", status );
-        HTTPS_GOTO_CLEANUP();
-    }
-
     /* If there is a Content-Length, then write that to the finalHeaders to send. */
     if( contentLength > 0 )
     {
@@ -1750,30 +1805,24 @@ static IotHttpsReturnCode_t _sendHttpsHeaders( _httpsConnection_t * pHttpsConnec
     memcpy( &finalHeaders[ numWritten ], HTTPS_END_OF_HEADER_LINES_INDICATOR, HTTPS_END_OF_HEADER_LINES_INDICATOR_LENGTH );
     numWritten += HTTPS_END_OF_HEADER_LINES_INDICATOR_LENGTH;
 
-    status = _networkSend( pHttpsConnection, ( uint8_t * ) finalHeaders, numWritten );
+    /* The headers passed into this function go first. These headers are not terminated with a second set of "\r\n". */
+    vectors[ 0 ].pBuffer = pHeadersBuf;
+    vectors[ 0 ].length = headersLength;
+    vectors[ 1 ].pBuffer = ( const uint8_t * ) finalHeaders;
+    vectors[ 1 ].length = ( size_t ) numWritten;
 
-    if( HTTPS_FAILED( status ) )
+    if( ( pBodyBuf != NULL ) && ( bodyLength > 0 ) )
     {
-        IotLogError( "Error sending final HTTPS Headers \r\n%s. Error code: %d", finalHeaders, status );
-        HTTPS_GOTO_CLEANUP();
+        vectors[ 2 ].pBuffer = pBodyBuf;
+        vectors[ 2 ].length = bodyLength;
+        vectorCount = 3;
     }
 
-    HTTPS_FUNCTION_EXIT_NO_CLEANUP();
-}
-
-/*-----------------------------------------------------------*/
-
-static IotHttpsReturnCode_t _sendHttpsBody( _httpsConnection_t * pHttpsConnection,
-                                            uint8_t * pBodyBuf,
-                                            uint32_t bodyLength )
-{
-    HTTPS_FUNCTION_ENTRY( IOT_HTTPS_OK );
-
-    status = _networkSend( pHttpsConnection, pBodyBuf, bodyLength );
+    status = _networkSendv( pHttpsConnection, vectors, vectorCount );
 
     if( HTTPS_FAILED( status ) )
     {
-        IotLogError( "Error sending final HTTPS body at location %p. Error code: %d", pBodyBuf, status );
+        IotLogError( "Error sending the HTTPS headers and body. Error code: %d", status );
         HTTPS_GOTO_CLEANUP();
     }
 
@@ -2086,33 +2135,22 @@ static IotHttpsReturnCode_t _sendHttpsHeadersAndBody( _httpsConnection_t * pHttp
 {
     HTTPS_FUNCTION_ENTRY( IOT_HTTPS_OK );
 
-    /* Send the HTTP headers. */
+    /* Send the HTTP headers and body. */
     status = _sendHttpsHeaders( pHttpsConnection,
                                 pHttpsRequest->pHeaders,
                                 pHttpsRequest->pHeadersCur - pHttpsRequest->pHeaders,
                                 pHttpsRequest->isNonPersistent,
+                                pHttpsRequest->bodyLength,
+                                pHttpsRequest->pBody,
                                 pHttpsRequest->bodyLength );
 
     if( HTTPS_FAILED( status ) )
     {
-        IotLogError( "Error sending the HTTPS headers with error code: %d", status );
+        IotLogError( "Error sending the HTTPS headers and body with error code: %d", status );
         HTTPS_GOTO_CLEANUP();
     }
 
-    IotLogDebug( "Sent HTTPS headers for request %p.", pHttpsRequest );
-
-    if( ( pHttpsRequest->pBody != NULL ) && ( pHttpsRequest->bodyLength > 0 ) )
-    {
-        status = _sendHttpsBody( pHttpsConnection, pHttpsRequest->pBody, pHttpsRequest->bodyLength );
-
-        if( HTTPS_FAILED( status ) )
-        {
-            IotLogError( "Error sending final HTTPS body. Return code: %d", status );
-            HTTPS_GOTO_CLEANUP();
-        }
-
-        IotLogDebug( "Sent HTTPS body for request %p.", pHttpsRequest );
-    }
+    IotLogDebug( "Sent HTTPS headers and body for request %p.", pHttpsRequest );
 
     HTTPS_FUNCTION_EXIT_NO_CLEANUP();
 }
@@ -150,6 +150,11 @@ static IotHttpsResponseInfo_t _respInfo =
     .pSyncInfo            = &_syncResponseInfo
 };
 
+/**
+ * @brief The number of buffers passed to the last network sendv call.
+ */
+static size_t _sendvVectorCount = 0;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -296,6 +301,22 @@ static size_t _networkSendSuccess( void * pConnection,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Network abstraction sendv function that only sends the first buffer.
+ *
+ * The library must send the rest of the buffers with the network send function.
+ */
+static size_t _networkSendvFirstBuffer( void * pConnection,
+                                        const IotNetworkIoVector_t * pVectors,
+                                        size_t vectorCount )
+{
+    _sendvVectorCount = vectorCount;
+
+    return _networkSendSuccess( pConnection, pVectors[ 0 ].pBuffer, pVectors[ 0 ].length );
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Network abstraction receive function that fails when sending the HTTP headers.
  */
@@ -433,6 +454,7 @@ TEST_SETUP( HTTPS_Client_Unit_Sync )
     _alreadyCreatedReceiveCallbackThread = false;
     _currentlySendingRequestHandle = IOT_HTTPS_REQUEST_HANDLE_INITIALIZER;
     _nextRespMessageBufferByteToReceive = 0;
+    _sendvVectorCount = 0;
 
     /* This will initialize the library before every test case, which is OK. */
     TEST_ASSERT_EQUAL_INT( true, IotSdk_Init() );
@@ -471,6 +493,7 @@ TEST_GROUP_RUNNER( HTTPS_Client_Unit_Sync )
     RUN_TEST_CASE( HTTPS_Client_Unit_Sync, SendSyncBodyBufferNull );
     RUN_TEST_CASE( HTTPS_Client_Unit_Sync, SendSyncPersistentRequest );
     RUN_TEST_CASE( HTTPS_Client_Unit_Sync, SendSyncNonPersistentRequest );
+    RUN_TEST_CASE( HTTPS_Client_Unit_Sync, SendSyncGatheredRequest );
     RUN_TEST_CASE( HTTPS_Client_Unit_Sync, SendSyncHeadersEndsWithCarriageReturnSeparator );
     RUN_TEST_CASE( HTTPS_Client_Unit_Sync, SendSyncHeadersEndsWithNewlineSeparator );
     RUN_TEST_CASE( HTTPS_Client_Unit_Sync, SendSyncHeadersEndsWithColonSeparator );
@@ -1081,6 +1104,53 @@ TEST( HTTPS_Client_Unit_Sync, SendSyncNonPersistentRequest )
 
 /*-----------------------------------------------------------*/
 
+/**
+ * Test that the request headers and body are passed to the network sendv in one call, and that the part sendv did
+ * not send is completed with send.
+ */
+TEST( HTTPS_Client_Unit_Sync, SendSyncGatheredRequest )
+{
+    IotHttpsReturnCode_t returnCode = IOT_HTTPS_OK;
+    IotHttpsConnectionHandle_t connHandle = IOT_HTTPS_CONNECTION_HANDLE_INITIALIZER;
+    IotHttpsRequestHandle_t reqHandle = IOT_HTTPS_REQUEST_HANDLE_INITIALIZER;
+    IotHttpsResponseHandle_t respHandle = IOT_HTTPS_RESPONSE_HANDLE_INITIALIZER;
+    uint32_t timeout = HTTPS_TEST_SYNC_TIMEOUT_MS;
+    int headerLength = 0;
+    int bodyLength = 0;
+
+    /* Sending the request headers again with send fails the request. */
+    _networkInterface.send = _networkSendFailHeaders;
+    _networkInterface.sendv = _networkSendvFirstBuffer;
+    _networkInterface.receiveUpto = _networkReceiveSuccess;
+    _networkInterface.close = _networkCloseSuccess;
+    _networkInterface.destroy = _networkDestroySuccess;
+
+    /* Get a valid "connected" handled. */
+    connHandle = _getConnHandle();
+    TEST_ASSERT_NOT_NULL( connHandle );
+    /* Set the global test connection handle to be passed to the library network receive callback. */
+    _receiveCallbackConnHandle = connHandle;
+
+    /* Get a valid request handle. */
+    reqHandle = _getReqHandle( &_reqInfo );
+    TEST_ASSERT_NOT_NULL( reqHandle );
+    _currentlySendingRequestHandle = reqHandle;
+
+    /* Generate some ideal case header and body. */
+    headerLength = HTTPS_TEST_RESP_HEADER_BUFFER_LENGTH;
+    bodyLength = HTTPS_TEST_RESP_BODY_BUFFER_SIZE;
+    _generateHttpResponseMessage( headerLength, bodyLength );
+
+    returnCode = IotHttpsClient_SendSync( connHandle, reqHandle, &respHandle, &_respInfo, timeout );
+    TEST_ASSERT_EQUAL( IOT_HTTPS_OK, returnCode );
+    _verifyHttpResponseBody( bodyLength, _respInfo.pSyncInfo->pBody, 0 );
+
+    /* The request headers, the final headers and the body. */
+    TEST_ASSERT_EQUAL( 3, _sendvVectorCount );
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Test that we have the correct header data when it ends on the carriage return of the end of the header lines
  * separator.
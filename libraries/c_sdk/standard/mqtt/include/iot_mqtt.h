@@ -866,4 +866,19 @@ bool IotMqtt_IsSubscribed( IotMqttConnection_t mqttConnection,
                            IotMqttSubscription_t * pCurrentSubscription );
 /* @[declare_mqtt_issubscribed] */
 
+/**
+ * @brief Release a received PUBLISH buffer taken by a subscription callback.
+ *
+ * A subscription callback that sets `u.message.pReceivedData` of its
+ * #IotMqttCallbackParam_t to `NULL` becomes the owner of that buffer, and must
+ * pass it to this function once it no longer needs the message. This allows
+ * the payload of a PUBLISH to be processed after the callback returns without
+ * copying it.
+ *
+ * @param[in] pReceivedData The buffer taken from `u.message.pReceivedData`.
+ */
+/* @[declare_mqtt_freereceiveddata] */
+void IotMqtt_FreeReceivedData( void * pReceivedData );
+/* @[declare_mqtt_freereceiveddata] */
+
 #endif /* ifndef IOT_MQTT_H_ */
@@ -462,6 +462,17 @@ typedef struct IotMqttCallbackParam
             const char * pTopicFilter;  /**< @brief Topic filter that matched the message. */
             uint16_t topicFilterLength; /**< @brief Length of `pTopicFilter`. */
             IotMqttPublishInfo_t info;  /**< @brief PUBLISH message received from the server. */
+
+            /**
+             * @brief The buffer that holds `info.pTopicName` and `info.pPayload`.
+             *
+             * A callback may take ownership of this buffer by setting this member
+             * to `NULL`; `info.pPayload` then stays valid until the buffer is
+             * released with @ref mqtt_function_freereceiveddata. Taking the
+             * buffer consumes the message, so it is not passed to any other
+             * matching subscription callback.
+             */
+            void * pReceivedData;
         } message;
 
         /* Valid when a connection is disconnected. */
@@ -64,6 +64,9 @@
 #define _NUM_DISCONNECT_PARAMS         ( 1 )
 #define _NUM_PINGREQUEST_PARAMS        ( 1 )
 
+/* Size of the pre-encoded part of the PUBLISH and PUBACK templates. */
+#define _TEMPLATE_CONSTANTS_SIZE       ( 16 )
+
 const IotMqttSerializer_t IotBleMqttSerializer =
 {
     .serialize.connect       = IotBleMqtt_SerializeConnect,
@@ -113,9 +116,56 @@ static IotSerializerError_t _serializePublish( const IotMqttPublishInfo_t * cons
                                                uint8_t * pBuffer,
                                                size_t * pSize,
                                                uint16_t packetIdentifier );
+static IotSerializerError_t _serializePublishWithEncoder( const IotMqttPublishInfo_t * const pPublishInfo,
+                                                          uint8_t * pBuffer,
+                                                          size_t * pSize,
+                                                          uint16_t packetIdentifier );
 static IotSerializerError_t _serializePubAck( uint16_t packetIdentifier,
                                               uint8_t * pBuffer,
                                               size_t * pSize );
+static IotSerializerError_t _serializePubAckWithEncoder( uint16_t packetIdentifier,
+                                                         uint8_t * pBuffer,
+                                                         size_t * pSize );
+
+/**
+ * @brief Check whether the BLE message decoder is the CBOR decoder.
+ */
+static bool _isCborDecoder( void );
+
+/**
+ * @brief Initialize a decoder object for a received packet.
+ *
+ * The CBOR decoder runs in borrow mode: the decoder state lives in pState and
+ * strings point into the packet, so decoding allocates no memory.
+ */
+static IotSerializerError_t _initDecoder( IotSerializerCborBorrowState_t * pState,
+                                          IotSerializerDecoderObject_t * pDecoderObject,
+                                          const uint8_t * pBuffer,
+                                          size_t length );
+
+/**
+ * @brief Find a scalar value in a decoder object created by _initDecoder.
+ */
+static IotSerializerError_t _findValue( IotSerializerDecoderObject_t * pDecoderObject,
+                                        const char * pKey,
+                                        IotSerializerDecoderObject_t * pValueObject );
+
+/**
+ * @brief Create the CBOR templates of the PUBLISH and PUBACK messages.
+ *
+ * @return true if the templates can be used.
+ */
+static bool _createTemplates( void );
+
+/**
+ * @brief Serialize a message from a template, with the same size and buffer
+ * semantics as the encoder based functions.
+ */
+static IotSerializerError_t _serializeWithTemplate( const IotSerializerCborTemplate_t * pTemplate,
+                                                    const IotSerializerScalarData_t * pValues,
+                                                    size_t valueCount,
+                                                    uint8_t * pBuffer,
+                                                    size_t * pSize );
 
 
 
@@ -155,6 +205,19 @@ static IotSerializerError_t _serializePingRequest( uint8_t * const pBuffer,
 
 static IotMutex_t _packetIdentifierMutex;
 
+/**
+ * @brief CBOR templates of the messages sent for every PUBLISH.
+ *
+ * Keys and message types are encoded once at init; serializing a message
+ * encodes only its values. The templates are used when the BLE message
+ * encoder is the CBOR encoder.
+ */
+static IotSerializerCborTemplate_t _publishTemplate[ 2 ]; /* QoS 0, then QoS 1 with message ID. */
+static uint8_t _publishTemplateConstants[ 2 ][ _TEMPLATE_CONSTANTS_SIZE ];
+static IotSerializerCborTemplate_t _pubAckTemplate;
+static uint8_t _pubAckTemplateConstants[ _TEMPLATE_CONSTANTS_SIZE ];
+static bool _templatesReady = false;
+
 
 /* Declaration of snprintf. The header stdio.h is not included because it
  * includes conflicting symbols on some platforms. */
@@ -260,12 +323,127 @@ static IotSerializerError_t _serializeConnect( const IotMqttConnectInfo_t * cons
     return error;
 }
 
+static bool _createTemplates( void )
+{
+    IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
+    uint8_t i = 0;
+
+    for( i = 0; ( i < 2 ) && ( error == IOT_SERIALIZER_SUCCESS ); i++ )
+    {
+        const IotSerializerCborTemplateItem_t publishItems[] =
+        {
+            IotSerializer_CborTemplateMap( _NUM_DEFAULT_PUBLISH_PARMAS + i ),
+            IotSerializer_CborTemplateKey( IOT_BLE_MQTT_MSG_TYPE ),
+            IotSerializer_CborTemplateConstant( IotSerializer_ScalarSignedInt( IOT_BLE_MQTT_MSG_TYPE_PUBLISH ) ),
+            IotSerializer_CborTemplateKey( IOT_BLE_MQTT_TOPIC ),
+            IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_TEXT_STRING ),
+            IotSerializer_CborTemplateKey( IOT_BLE_MQTT_QOS ),
+            IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT ),
+            IotSerializer_CborTemplateKey( IOT_BLE_MQTT_PAYLOAD ),
+            IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_BYTE_STRING ),
+            IotSerializer_CborTemplateKey( IOT_BLE_MQTT_MESSAGE_ID ),
+            IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT )
+        };
+
+        /* The QoS 0 template stops before the message ID. */
+        error = IotSerializer_CborTemplateCreate( &_publishTemplate[ i ],
+                                                  publishItems,
+                                                  ( i == 0 ) ? ( sizeof( publishItems ) / sizeof( publishItems[ 0 ] ) ) - 2
+                                                  : sizeof( publishItems ) / sizeof( publishItems[ 0 ] ),
+                                                  _publishTemplateConstants[ i ],
+                                                  _TEMPLATE_CONSTANTS_SIZE );
+    }
+
+    if( error == IOT_SERIALIZER_SUCCESS )
+    {
+        const IotSerializerCborTemplateItem_t pubAckItems[] =
+        {
+            IotSerializer_CborTemplateMap( _NUM_PUBACK_PARMAS ),
+            IotSerializer_CborTemplateKey( IOT_BLE_MQTT_MSG_TYPE ),
+            IotSerializer_CborTemplateConstant( IotSerializer_ScalarSignedInt( IOT_BLE_MQTT_MSG_TYPE_PUBACK ) ),
+            IotSerializer_CborTemplateKey( IOT_BLE_MQTT_MESSAGE_ID ),
+            IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT )
+        };
+
+        error = IotSerializer_CborTemplateCreate( &_pubAckTemplate,
+                                                  pubAckItems,
+                                                  sizeof( pubAckItems ) / sizeof( pubAckItems[ 0 ] ),
+                                                  _pubAckTemplateConstants,
+                                                  _TEMPLATE_CONSTANTS_SIZE );
+    }
+
+    return( error == IOT_SERIALIZER_SUCCESS );
+}
+
+static IotSerializerError_t _serializeWithTemplate( const IotSerializerCborTemplate_t * pTemplate,
+                                                    const IotSerializerScalarData_t * pValues,
+                                                    size_t valueCount,
+                                                    uint8_t * pBuffer,
+                                                    size_t * pSize )
+{
+    IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
+    size_t encodedSize = 0;
+
+    error = IotSerializer_CborTemplateEncode( pTemplate,
+                                              pValues,
+                                              valueCount,
+                                              pBuffer,
+                                              *pSize,
+                                              &encodedSize );
+
+    if( _IS_VALID_SERIALIZER_RET( error, pBuffer ) )
+    {
+        *pSize = encodedSize;
+        error = IOT_SERIALIZER_SUCCESS;
+    }
+
+    return error;
+}
+
 static IotSerializerError_t _serializePublish( const IotMqttPublishInfo_t * const pPublishInfo,
                                                uint8_t * pBuffer,
                                                size_t * pSize,
                                                uint16_t packetIdentifier )
 {
     IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
+
+    if( _templatesReady == true )
+    {
+        /* The topic name is not NULL-terminated. */
+        const IotSerializerScalarData_t values[] =
+        {
+            {
+                .type = IOT_SERIALIZER_SCALAR_TEXT_STRING,
+                .value.u.string.pString = ( uint8_t * ) pPublishInfo->pTopicName,
+                .value.u.string.length = pPublishInfo->topicNameLength
+            },
+            IotSerializer_ScalarSignedInt( pPublishInfo->qos ),
+            IotSerializer_ScalarByteString( ( uint8_t * ) pPublishInfo->pPayload, pPublishInfo->payloadLength ),
+            IotSerializer_ScalarSignedInt( packetIdentifier )
+        };
+
+        /* The message type is part of the template, so there is one value less
+         * than parameters. */
+        error = _serializeWithTemplate( &_publishTemplate[ ( pPublishInfo->qos != 0 ) ? 1 : 0 ],
+                                        values,
+                                        _getNumPublishParams( pPublishInfo ) - 1,
+                                        pBuffer,
+                                        pSize );
+    }
+    else
+    {
+        error = _serializePublishWithEncoder( pPublishInfo, pBuffer, pSize, packetIdentifier );
+    }
+
+    return error;
+}
+
+static IotSerializerError_t _serializePublishWithEncoder( const IotMqttPublishInfo_t * const pPublishInfo,
+                                                          uint8_t * pBuffer,
+                                                          size_t * pSize,
+                                                          uint16_t packetIdentifier )
+{
+    IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
     IotSerializerEncoderObject_t encoderObj = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_STREAM;
     IotSerializerEncoderObject_t publishMap = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
     IotSerializerScalarData_t data = { 0 };
@@ -347,6 +525,29 @@ static IotSerializerError_t _serializePublish( const IotMqttPublishInfo_t * cons
 static IotSerializerError_t _serializePubAck( uint16_t packetIdentifier,
                                               uint8_t * pBuffer,
                                               size_t * pSize )
+{
+    IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
+
+    if( _templatesReady == true )
+    {
+        const IotSerializerScalarData_t values[] =
+        {
+            IotSerializer_ScalarSignedInt( packetIdentifier )
+        };
+
+        error = _serializeWithTemplate( &_pubAckTemplate, values, 1, pBuffer, pSize );
+    }
+    else
+    {
+        error = _serializePubAckWithEncoder( packetIdentifier, pBuffer, pSize );
+    }
+
+    return error;
+}
+
+static IotSerializerError_t _serializePubAckWithEncoder( uint16_t packetIdentifier,
+                                                         uint8_t * pBuffer,
+                                                         size_t * pSize )
 
 {
     IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
@@ -705,8 +906,62 @@ static IotSerializerError_t _serializePingRequest( uint8_t * const pBuffer,
 }
 
 
+static bool _isCborDecoder( void )
+{
+    const IotSerializerDecodeInterface_t * pDecoder = &IOT_BLE_MESG_DECODER;
+
+    return( pDecoder == &_IotSerializerCborDecoder );
+}
+
+static IotSerializerError_t _initDecoder( IotSerializerCborBorrowState_t * pState,
+                                          IotSerializerDecoderObject_t * pDecoderObject,
+                                          const uint8_t * pBuffer,
+                                          size_t length )
+{
+    IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
+
+    if( _isCborDecoder() == true )
+    {
+        error = IotSerializer_CborBorrowInit( pState, pDecoderObject, pBuffer, length );
+    }
+    else
+    {
+        error = IOT_BLE_MESG_DECODER.init( pDecoderObject, pBuffer, length );
+    }
+
+    return error;
+}
+
+static IotSerializerError_t _findValue( IotSerializerDecoderObject_t * pDecoderObject,
+                                        const char * pKey,
+                                        IotSerializerDecoderObject_t * pValueObject )
+{
+    IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
+
+    if( _isCborDecoder() == true )
+    {
+        /* Packets carry scalar values only, so no state is needed for containers. */
+        error = IotSerializer_CborBorrowFind( pDecoderObject, pKey, NULL, pValueObject );
+    }
+    else
+    {
+        error = IOT_BLE_MESG_DECODER.find( pDecoderObject, pKey, pValueObject );
+    }
+
+    return error;
+}
+
 bool IotBleMqtt_InitSerialize( void )
 {
+    const IotSerializerEncodeInterface_t * pEncoder = &IOT_BLE_MESG_ENCODER;
+
+    /* Templates produce CBOR only. Any other encoder serializes every message
+     * through the encoder interface. */
+    if( pEncoder == &_IotSerializerCborEncoder )
+    {
+        _templatesReady = _createTemplates();
+    }
+
     /* Create the packet identifier mutex. */
     return IotMutex_Create( &_packetIdentifierMutex, false );
 }
@@ -715,6 +970,8 @@ void IotBleMqtt_CleanupSerialize( void )
 {
     /* Destroy the packet identifier mutex */
     IotMutex_Destroy( &_packetIdentifierMutex );
+
+    _templatesReady = false;
 }
 
 
@@ -781,11 +1038,12 @@ IotMqttError_t IotBleMqtt_SerializeConnect( const IotMqttConnectInfo_t * const p
 IotMqttError_t IotBleMqtt_DeserializeConnack( _mqttPacket_t * pConnack )
 {
     IotSerializerDecoderObject_t decoderObj = { 0 }, decoderValue = { 0 };
+    IotSerializerCborBorrowState_t decoderState;
     IotSerializerError_t error;
     IotMqttError_t ret = IOT_MQTT_SUCCESS;
     int64_t respCode = 0L;
 
-    error = IOT_BLE_MESG_DECODER.init( &decoderObj, ( uint8_t * ) pConnack->pRemainingData, pConnack->remainingLength );
+    error = _initDecoder( &decoderState, &decoderObj, ( uint8_t * ) pConnack->pRemainingData, pConnack->remainingLength );
 
     if( ( error != IOT_SERIALIZER_SUCCESS ) ||
         ( decoderObj.type != IOT_SERIALIZER_CONTAINER_MAP ) )
@@ -796,7 +1054,7 @@ IotMqttError_t IotBleMqtt_DeserializeConnack( _mqttPacket_t * pConnack )
 
     if( ret == IOT_MQTT_SUCCESS )
     {
-        error = IOT_BLE_MESG_DECODER.find( &decoderObj, IOT_BLE_MQTT_STATUS, &decoderValue );
+        error = _findValue( &decoderObj, IOT_BLE_MQTT_STATUS, &decoderValue );
 
         if( ( error != IOT_SERIALIZER_SUCCESS ) ||
             ( decoderValue.type != IOT_SERIALIZER_SCALAR_SIGNED_INT ) )
@@ -901,10 +1159,11 @@ void IotBleMqtt_PublishSetDup( uint8_t * const pPublishPacket,
 IotMqttError_t IotBleMqtt_DeserializePublish( _mqttPacket_t * pPublish )
 {
     IotSerializerDecoderObject_t decoderObj = { 0 }, decoderValue = { 0 };
+    IotSerializerCborBorrowState_t decoderState;
     IotSerializerError_t xSerializerRet;
     IotMqttError_t ret = IOT_MQTT_SUCCESS;
 
-    xSerializerRet = IOT_BLE_MESG_DECODER.init( &decoderObj, ( uint8_t * ) pPublish->pRemainingData, pPublish->remainingLength );
+    xSerializerRet = _initDecoder( &decoderState, &decoderObj, ( uint8_t * ) pPublish->pRemainingData, pPublish->remainingLength );
 
     if( ( xSerializerRet != IOT_SERIALIZER_SUCCESS ) ||
         ( decoderObj.type != IOT_SERIALIZER_CONTAINER_MAP ) )
@@ -915,7 +1174,7 @@ IotMqttError_t IotBleMqtt_DeserializePublish( _mqttPacket_t * pPublish )
 
     if( ret == IOT_MQTT_SUCCESS )
     {
-        xSerializerRet = IOT_BLE_MESG_DECODER.find( &decoderObj, IOT_BLE_MQTT_QOS, &decoderValue );
+        xSerializerRet = _findValue( &decoderObj, IOT_BLE_MQTT_QOS, &decoderValue );
 
         if( ( xSerializerRet != IOT_SERIALIZER_SUCCESS ) ||
             ( decoderValue.type != IOT_SERIALIZER_SCALAR_SIGNED_INT ) )
@@ -933,7 +1192,7 @@ IotMqttError_t IotBleMqtt_DeserializePublish( _mqttPacket_t * pPublish )
     {
         decoderValue.u.value.u.string.pString = NULL;
         decoderValue.u.value.u.string.length = 0;
-        xSerializerRet = IOT_BLE_MESG_DECODER.find( &decoderObj, IOT_BLE_MQTT_TOPIC, &decoderValue );
+        xSerializerRet = _findValue( &decoderObj, IOT_BLE_MQTT_TOPIC, &decoderValue );
 
         if( ( xSerializerRet != IOT_SERIALIZER_SUCCESS ) ||
             ( decoderValue.type != IOT_SERIALIZER_SCALAR_TEXT_STRING ) )
@@ -952,7 +1211,7 @@ IotMqttError_t IotBleMqtt_DeserializePublish( _mqttPacket_t * pPublish )
     {
         decoderValue.u.value.u.string.pString = NULL;
         decoderValue.u.value.u.string.length = 0;
-        xSerializerRet = IOT_BLE_MESG_DECODER.find( &decoderObj, IOT_BLE_MQTT_PAYLOAD, &decoderValue );
+        xSerializerRet = _findValue( &decoderObj, IOT_BLE_MQTT_PAYLOAD, &decoderValue );
 
         if( ( xSerializerRet != IOT_SERIALIZER_SUCCESS ) ||
             ( decoderValue.type != IOT_SERIALIZER_SCALAR_BYTE_STRING ) )
@@ -971,7 +1230,7 @@ IotMqttError_t IotBleMqtt_DeserializePublish( _mqttPacket_t * pPublish )
     {
         if( pPublish->u.pIncomingPublish->u.publish.publishInfo.qos != 0 )
         {
-            xSerializerRet = IOT_BLE_MESG_DECODER.find( &decoderObj, IOT_BLE_MQTT_MESSAGE_ID, &decoderValue );
+            xSerializerRet = _findValue( &decoderObj, IOT_BLE_MQTT_MESSAGE_ID, &decoderValue );
 
             if( ( xSerializerRet != IOT_SERIALIZER_SUCCESS ) ||
                 ( decoderValue.type != IOT_SERIALIZER_SCALAR_SIGNED_INT ) )
@@ -1058,10 +1317,11 @@ IotMqttError_t IotBleMqtt_SerializePuback( uint16_t packetIdentifier,
 IotMqttError_t IotBleMqtt_DeserializePuback( _mqttPacket_t * pPuback )
 {
     IotSerializerDecoderObject_t decoderObj = { 0 }, decoderValue = { 0 };
+    IotSerializerCborBorrowState_t decoderState;
     IotSerializerError_t error;
     IotMqttError_t ret = IOT_MQTT_SUCCESS;
 
-    error = IOT_BLE_MESG_DECODER.init( &decoderObj, ( uint8_t * ) pPuback->pRemainingData, pPuback->remainingLength );
+    error = _initDecoder( &decoderState, &decoderObj, ( uint8_t * ) pPuback->pRemainingData, pPuback->remainingLength );
 
     if( ( error != IOT_SERIALIZER_SUCCESS ) ||
         ( decoderObj.type != IOT_SERIALIZER_CONTAINER_MAP ) )
@@ -1072,7 +1332,7 @@ IotMqttError_t IotBleMqtt_DeserializePuback( _mqttPacket_t * pPuback )
 
     if( ret == IOT_MQTT_SUCCESS )
     {
-        error = IOT_BLE_MESG_DECODER.find( &decoderObj, IOT_BLE_MQTT_MESSAGE_ID, &decoderValue );
+        error = _findValue( &decoderObj, IOT_BLE_MQTT_MESSAGE_ID, &decoderValue );
 
         if( ( error != IOT_SERIALIZER_SUCCESS ) ||
             ( decoderValue.type != IOT_SERIALIZER_SCALAR_SIGNED_INT ) )
@@ -1159,11 +1419,12 @@ IotMqttError_t IotBleMqtt_SerializeSubscribe( const IotMqttSubscription_t * cons
 IotMqttError_t IotBleMqtt_DeserializeSuback( _mqttPacket_t * pSuback )
 {
     IotSerializerDecoderObject_t decoderObj = { 0 }, decoderValue = { 0 };
+    IotSerializerCborBorrowState_t decoderState;
     IotSerializerError_t error;
     uint8_t subscriptionStatus;
     IotMqttError_t ret = IOT_MQTT_SUCCESS;
 
-    error = IOT_BLE_MESG_DECODER.init( &decoderObj, ( uint8_t * ) pSuback->pRemainingData, pSuback->remainingLength );
+    error = _initDecoder( &decoderState, &decoderObj, ( uint8_t * ) pSuback->pRemainingData, pSuback->remainingLength );
 
     if( ( error != IOT_SERIALIZER_SUCCESS ) ||
         ( decoderObj.type != IOT_SERIALIZER_CONTAINER_MAP ) )
@@ -1174,7 +1435,7 @@ IotMqttError_t IotBleMqtt_DeserializeSuback( _mqttPacket_t * pSuback )
 
     if( ret == IOT_MQTT_SUCCESS )
     {
-        error = IOT_BLE_MESG_DECODER.find( &decoderObj, IOT_BLE_MQTT_MESSAGE_ID, &decoderValue );
+        error = _findValue( &decoderObj, IOT_BLE_MQTT_MESSAGE_ID, &decoderValue );
 
         if( ( error != IOT_SERIALIZER_SUCCESS ) ||
             ( decoderValue.type != IOT_SERIALIZER_SCALAR_SIGNED_INT ) )
@@ -1190,7 +1451,7 @@ IotMqttError_t IotBleMqtt_DeserializeSuback( _mqttPacket_t * pSuback )
 
     if( ret == IOT_MQTT_SUCCESS )
     {
-        error = IOT_BLE_MESG_DECODER.find( &decoderObj, IOT_BLE_MQTT_STATUS, &decoderValue );
+        error = _findValue( &decoderObj, IOT_BLE_MQTT_STATUS, &decoderValue );
 
         if( ( error != IOT_SERIALIZER_SUCCESS ) ||
             ( decoderValue.type != IOT_SERIALIZER_SCALAR_SIGNED_INT ) )
@@ -1310,10 +1571,11 @@ IotMqttError_t IotBleMqtt_SerializeUnsubscribe( const IotMqttSubscription_t * co
 IotMqttError_t IotBleMqtt_DeserializeUnsuback( _mqttPacket_t * pUnsuback )
 {
     IotSerializerDecoderObject_t decoderObj = { 0 }, decoderValue = { 0 };
+    IotSerializerCborBorrowState_t decoderState;
     IotSerializerError_t error;
     IotMqttError_t ret = IOT_MQTT_SUCCESS;
 
-    error = IOT_BLE_MESG_DECODER.init( &decoderObj, ( uint8_t * ) pUnsuback->pRemainingData, pUnsuback->remainingLength );
+    error = _initDecoder( &decoderState, &decoderObj, ( uint8_t * ) pUnsuback->pRemainingData, pUnsuback->remainingLength );
 
     if( ( error != IOT_SERIALIZER_SUCCESS ) ||
         ( decoderObj.type != IOT_SERIALIZER_CONTAINER_MAP ) )
@@ -1324,7 +1586,7 @@ IotMqttError_t IotBleMqtt_DeserializeUnsuback( _mqttPacket_t * pUnsuback )
 
     if( ret == IOT_MQTT_SUCCESS )
     {
-        error = IOT_BLE_MESG_DECODER.find( &decoderObj, IOT_BLE_MQTT_MESSAGE_ID, &decoderValue );
+        error = _findValue( &decoderObj, IOT_BLE_MQTT_MESSAGE_ID, &decoderValue );
 
         if( ( error != IOT_SERIALIZER_SUCCESS ) ||
             ( decoderValue.type != IOT_SERIALIZER_SCALAR_SIGNED_INT ) )
@@ -1417,6 +1679,7 @@ uint8_t IotBleMqtt_GetPacketType( void * pNetworkConnection,
                                   const IotNetworkInterface_t * pNetworkInterface )
 {
     IotSerializerDecoderObject_t decoderObj = { 0 }, decoderValue = { 0 };
+    IotSerializerCborBorrowState_t decoderState;
     IotSerializerError_t error;
     uint8_t value = 0xFF, packetType = _INVALID_MQTT_PACKET_TYPE;
     const uint8_t * pBuffer;
@@ -1424,12 +1687,12 @@ uint8_t IotBleMqtt_GetPacketType( void * pNetworkConnection,
 
     IotBleDataTransfer_PeekReceiveBuffer( *( IotBleDataTransferChannel_t ** ) ( pNetworkConnection ), &pBuffer, &length );
 
-    error = IOT_BLE_MESG_DECODER.init( &decoderObj, pBuffer, length );
+    error = _initDecoder( &decoderState, &decoderObj, pBuffer, length );
 
     if( ( error == IOT_SERIALIZER_SUCCESS ) &&
         ( decoderObj.type == IOT_SERIALIZER_CONTAINER_MAP ) )
     {
-        error = IOT_BLE_MESG_DECODER.find( &decoderObj, IOT_BLE_MQTT_MSG_TYPE, &decoderValue );
+        error = _findValue( &decoderObj, IOT_BLE_MQTT_MSG_TYPE, &decoderValue );
 
         if( ( error == IOT_SERIALIZER_SUCCESS ) &&
             ( decoderValue.type == IOT_SERIALIZER_SCALAR_SIGNED_INT ) )
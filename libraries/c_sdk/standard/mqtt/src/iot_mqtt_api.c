@@ -2012,6 +2012,13 @@ const char * IotMqtt_OperationType( IotMqttOperationType_t operation )
 
 /*-----------------------------------------------------------*/
 
+void IotMqtt_FreeReceivedData( void * pReceivedData )
+{
+    IotMqtt_FreeMessage( pReceivedData );
+}
+
+/*-----------------------------------------------------------*/
+
 /* Provide access to internal functions and variables if testing. */
 #if IOT_BUILD_TESTS == 1
     #include "iot_test_access_mqtt_api.c"
@@ -879,10 +879,14 @@ void _IotMqtt_ProcessIncomingPublish( IotTaskPool_t pTaskPool,
 
     /* Process the current PUBLISH. */
     callbackParam.u.message.info = pOperation->u.publish.publishInfo;
+    callbackParam.u.message.pReceivedData = ( void * ) pOperation->u.publish.pReceivedData;
 
     _IotMqtt_InvokeSubscriptionCallback( pOperation->pMqttConnection,
                                          &callbackParam );
 
+    /* A callback may have taken ownership of the received buffer. */
+    pOperation->u.publish.pReceivedData = callbackParam.u.message.pReceivedData;
+
     /* Free any buffers associated with the current PUBLISH message. */
     if( pOperation->u.publish.pReceivedData != NULL )
     {
@@ -948,7 +952,11 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
                      IotMqtt_OperationType( pOperation->u.operation.type ),
                      pOperation );
 
-        /* Transmit the MQTT packet from the operation over the network. */
+        /* Transmit the MQTT packet from the operation over the network. The
+         * packet is a single buffer: a PUBLISH is serialized with a copy of its
+         * payload, because an asynchronous publisher may free the payload as soon
+         * as the publish call returns and the packet may be retransmitted. So
+         * there is nothing for the network interface's sendv to gather. */
         bytesSent = pMqttConnection->pNetworkInterface->send( pMqttConnection->pNetworkConnection,
                                                               pOperation->u.operation.pMqttPacket,
                                                               pOperation->u.operation.packetSize );
@@ -403,6 +403,7 @@ void _IotMqtt_InvokeSubscriptionCallback( _mqttConnection_t * pMqttConnection,
     _mqttSubscription_t * pSubscription = NULL;
     IotLink_t * pCurrentLink = NULL, * pNextLink = NULL;
     void * pCallbackContext = NULL;
+    const void * pReceivedData = pCallbackParam->u.message.pReceivedData;
 
     void ( * callbackFunction )( void *,
                                  IotMqttCallbackParam_t * ) = NULL;
@@ -495,6 +496,18 @@ void _IotMqtt_InvokeSubscriptionCallback( _mqttConnection_t * pMqttConnection,
 
         /* Move current link pointer. */
         pCurrentLink = pNextLink;
+
+        /* Stop if the callback took ownership of the received buffer. The
+         * message may no longer be valid for other subscriptions. */
+        if( ( pReceivedData != NULL ) &&
+            ( pCallbackParam->u.message.pReceivedData == NULL ) )
+        {
+            break;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
     }
 
     IotMutex_Unlock( &( pMqttConnection->subscriptionMutex ) );
@@ -416,6 +416,36 @@ static void _publishCallback( void * pCallbackContext,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Called when a PUBLISH message is "received". Takes ownership of the
+ * received buffer.
+ */
+static void _takeReceivedDataCallback( void * pCallbackContext,
+                                       IotMqttCallbackParam_t * pPublish )
+{
+    IotSemaphore_t * pInvokeCount = ( IotSemaphore_t * ) pCallbackContext;
+    const uint8_t * pReceivedData = pPublish->u.message.pReceivedData;
+    const uint8_t * pPayload = pPublish->u.message.info.pPayload;
+
+    /* Take the buffer holding the PUBLISH. */
+    pPublish->u.message.pReceivedData = NULL;
+
+    /* The payload must be inside the received buffer and remain valid after
+     * this callback returns. Check it, then release the buffer. */
+    if( ( pReceivedData != NULL ) &&
+        ( pPayload > pReceivedData ) &&
+        ( pPayload[ 0 ] == 0x00 ) &&
+        ( pPayload[ pPublish->u.message.info.payloadLength - 1 ] ==
+          _pPublishTemplate[ sizeof( _pPublishTemplate ) - 1 ] ) )
+    {
+        IotSemaphore_Post( pInvokeCount );
+    }
+
+    IotMqtt_FreeReceivedData( ( void * ) pReceivedData );
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief A PUBACK serializer function that does nothing, but always returns failure.
  *
@@ -607,6 +637,7 @@ TEST_GROUP_RUNNER( MQTT_Unit_Receive )
     RUN_TEST_CASE( MQTT_Unit_Receive, ConnackInvalid );
     RUN_TEST_CASE( MQTT_Unit_Receive, PublishValid );
     RUN_TEST_CASE( MQTT_Unit_Receive, PublishInvalid );
+    RUN_TEST_CASE( MQTT_Unit_Receive, PublishTakeReceivedData );
     RUN_TEST_CASE( MQTT_Unit_Receive, PubackValid );
     RUN_TEST_CASE( MQTT_Unit_Receive, PubackInvalid );
     RUN_TEST_CASE( MQTT_Unit_Receive, SubackValid );
@@ -1136,6 +1167,35 @@ TEST( MQTT_Unit_Receive, PublishInvalid )
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Tests that a subscription callback can take ownership of the buffer
+ * of a received PUBLISH.
+ */
+TEST( MQTT_Unit_Receive, PublishTakeReceivedData )
+{
+    _mqttSubscription_t * pSubscription = IotLink_Container( _mqttSubscription_t,
+                                                             IotListDouble_PeekHead( &( _pMqttConnection->subscriptionList ) ),
+                                                             link );
+
+    /* Replace the subscription callback with one that takes the buffer. */
+    pSubscription->callback.function = _takeReceivedDataCallback;
+
+    /* Process a valid QoS 0 PUBLISH. The MQTT library must not free the buffer
+     * that was taken by the callback. */
+    {
+        DECLARE_PACKET( _pPublishTemplate, pPublish, publishSize );
+        TEST_ASSERT_EQUAL_INT( true, _processPublish( pPublish,
+                                                      publishSize,
+                                                      1 ) );
+    }
+
+    /* Network close function should not have been invoked. */
+    TEST_ASSERT_EQUAL_INT( false, _networkCloseCalled );
+    TEST_ASSERT_EQUAL_INT( false, _disconnectCallbackCalled );
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Tests the behavior of @ref mqtt_function_receivecallback with a
  * spec-compliant PUBACK.
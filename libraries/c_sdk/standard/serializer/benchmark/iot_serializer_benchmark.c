@@ -0,0 +1,399 @@
+/*
+ * FreeRTOS Serializer V1.1.2
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_serializer_benchmark.c
+ * @brief Compare the CBOR encode paths on a host.
+ *
+ * Encodes a sequence of OTA Get Stream Request messages, the message the OTA
+ * agent sends for every request of a download, three ways: with tinycbor
+ * directly, with the serializer's CBOR encoder interface and with a CBOR
+ * template. The block offset and the requested block count change from one
+ * message to the next so that every integer head size is encoded. Checks that
+ * the three outputs are identical, then prints one row per path with the time
+ * per message.
+ *
+ * Usage: iot_serializer_benchmark [-m messages] [-r rounds]
+ *
+ * Each path encodes all messages once per round and the fastest round is
+ * reported.
+ */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Serializer and CBOR includes. */
+#include "iot_serializer.h"
+#include "cbor.h"
+
+#define _encoder                   _IotSerializerCborEncoder
+
+#define _DEFAULT_MESSAGES          ( 100000U )
+#define _DEFAULT_ROUNDS            ( 5U )
+#define _MESSAGE_BUFFER_SIZE       ( 128U )
+
+/* Keys and values of the Get Stream Request, as the OTA agent sends it. */
+#define _ITEM_COUNT                ( 6U )
+#define _CLIENT_TOKEN              "rdy"
+#define _FILE_ID                   ( 0 )
+#define _BLOCK_SIZE                ( 1024 )
+#define _BITMAP_SIZE               ( 16U )
+
+/**
+ * @brief The fields of the message that change from one request to the next.
+ */
+typedef struct _benchMessage
+{
+    int32_t blockOffset;
+    int32_t numberOfBlocks;
+} _benchMessage_t;
+
+/**
+ * @brief An encode path. Returns the encoded size, or 0 on error.
+ */
+typedef size_t ( * _encodeFunction_t )( const _benchMessage_t * pMessage,
+                                        uint8_t * pBuffer,
+                                        size_t bufferSize );
+
+/*-----------------------------------------------------------*/
+
+/* The bitmap sent with every request. */
+static uint8_t _bitmap[ _BITMAP_SIZE ];
+
+/* The template and its constants, created once before the timed runs. */
+static IotSerializerCborTemplate_t _getStreamRequestTemplate;
+static uint8_t _templateConstants[ _MESSAGE_BUFFER_SIZE ];
+
+/* Keeps the compiler from dropping the encode loops. */
+static volatile size_t _encodedBytes = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t _nowNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * 1000000000ULL ) + ( uint64_t ) now.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _encodeWithTinyCbor( const _benchMessage_t * pMessage,
+                                   uint8_t * pBuffer,
+                                   size_t bufferSize )
+{
+    CborError cborResult = CborNoError;
+    CborEncoder encoder, mapEncoder;
+    size_t encodedSize = 0;
+
+    cbor_encoder_init( &encoder, pBuffer, bufferSize, 0 );
+    cborResult |= cbor_encoder_create_map( &encoder, &mapEncoder, _ITEM_COUNT );
+    cborResult |= cbor_encode_text_stringz( &mapEncoder, "c" );
+    cborResult |= cbor_encode_text_stringz( &mapEncoder, _CLIENT_TOKEN );
+    cborResult |= cbor_encode_text_stringz( &mapEncoder, "f" );
+    cborResult |= cbor_encode_int( &mapEncoder, _FILE_ID );
+    cborResult |= cbor_encode_text_stringz( &mapEncoder, "l" );
+    cborResult |= cbor_encode_int( &mapEncoder, _BLOCK_SIZE );
+    cborResult |= cbor_encode_text_stringz( &mapEncoder, "o" );
+    cborResult |= cbor_encode_int( &mapEncoder, pMessage->blockOffset );
+    cborResult |= cbor_encode_text_stringz( &mapEncoder, "b" );
+    cborResult |= cbor_encode_byte_string( &mapEncoder, _bitmap, sizeof( _bitmap ) );
+    cborResult |= cbor_encode_text_stringz( &mapEncoder, "n" );
+    cborResult |= cbor_encode_int( &mapEncoder, pMessage->numberOfBlocks );
+    cborResult |= cbor_encoder_close_container_checked( &encoder, &mapEncoder );
+
+    if( cborResult == CborNoError )
+    {
+        encodedSize = cbor_encoder_get_buffer_size( &encoder, pBuffer );
+    }
+
+    return encodedSize;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _encodeWithEncoder( const _benchMessage_t * pMessage,
+                                  uint8_t * pBuffer,
+                                  size_t bufferSize )
+{
+    IotSerializerEncoderObject_t encoderObject = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_STREAM;
+    IotSerializerEncoderObject_t mapObject = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+    IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
+    size_t encodedSize = 0;
+
+    error = _encoder.init( &encoderObject, pBuffer, bufferSize );
+
+    if( error == IOT_SERIALIZER_SUCCESS )
+    {
+        error |= _encoder.openContainer( &encoderObject, &mapObject, _ITEM_COUNT );
+        error |= _encoder.appendKeyValue( &mapObject, "c", IotSerializer_ScalarTextString( _CLIENT_TOKEN ) );
+        error |= _encoder.appendKeyValue( &mapObject, "f", IotSerializer_ScalarSignedInt( _FILE_ID ) );
+        error |= _encoder.appendKeyValue( &mapObject, "l", IotSerializer_ScalarSignedInt( _BLOCK_SIZE ) );
+        error |= _encoder.appendKeyValue( &mapObject, "o", IotSerializer_ScalarSignedInt( pMessage->blockOffset ) );
+        error |= _encoder.appendKeyValue( &mapObject, "b", IotSerializer_ScalarByteString( _bitmap, sizeof( _bitmap ) ) );
+        error |= _encoder.appendKeyValue( &mapObject, "n", IotSerializer_ScalarSignedInt( pMessage->numberOfBlocks ) );
+        error |= _encoder.closeContainer( &encoderObject, &mapObject );
+
+        if( error == IOT_SERIALIZER_SUCCESS )
+        {
+            encodedSize = _encoder.getEncodedSize( &encoderObject, pBuffer );
+        }
+
+        _encoder.destroy( &encoderObject );
+    }
+
+    return encodedSize;
+}
+
+/*-----------------------------------------------------------*/
+
+static int _createTemplate( void )
+{
+    const IotSerializerCborTemplateItem_t items[] =
+    {
+        IotSerializer_CborTemplateMap( _ITEM_COUNT ),
+        IotSerializer_CborTemplateKey( "c" ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_TEXT_STRING ),
+        IotSerializer_CborTemplateKey( "f" ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT ),
+        IotSerializer_CborTemplateKey( "l" ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT ),
+        IotSerializer_CborTemplateKey( "o" ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT ),
+        IotSerializer_CborTemplateKey( "b" ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_BYTE_STRING ),
+        IotSerializer_CborTemplateKey( "n" ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT )
+    };
+
+    return IotSerializer_CborTemplateCreate( &_getStreamRequestTemplate,
+                                             items,
+                                             sizeof( items ) / sizeof( items[ 0 ] ),
+                                             _templateConstants,
+                                             sizeof( _templateConstants ) ) == IOT_SERIALIZER_SUCCESS ? 0 : 1;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _encodeWithTemplate( const _benchMessage_t * pMessage,
+                                   uint8_t * pBuffer,
+                                   size_t bufferSize )
+{
+    const IotSerializerScalarData_t values[] =
+    {
+        IotSerializer_ScalarTextString( _CLIENT_TOKEN ),
+        IotSerializer_ScalarSignedInt( _FILE_ID ),
+        IotSerializer_ScalarSignedInt( _BLOCK_SIZE ),
+        IotSerializer_ScalarSignedInt( pMessage->blockOffset ),
+        IotSerializer_ScalarByteString( _bitmap, sizeof( _bitmap ) ),
+        IotSerializer_ScalarSignedInt( pMessage->numberOfBlocks )
+    };
+    size_t encodedSize = 0;
+
+    if( IotSerializer_CborTemplateEncode( &_getStreamRequestTemplate,
+                                          values,
+                                          _ITEM_COUNT,
+                                          pBuffer,
+                                          bufferSize,
+                                          &encodedSize ) != IOT_SERIALIZER_SUCCESS )
+    {
+        encodedSize = 0;
+    }
+
+    return encodedSize;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Check that every message encodes the same with all paths. Returns 0 on success. */
+static int _verify( const _benchMessage_t * pMessages,
+                    uint32_t messageCount )
+{
+    uint8_t expected[ _MESSAGE_BUFFER_SIZE ], encoderBuffer[ _MESSAGE_BUFFER_SIZE ], templateBuffer[ _MESSAGE_BUFFER_SIZE ];
+    size_t expectedSize = 0, encoderSize = 0, templateSize = 0;
+    uint32_t i = 0;
+    int result = 0;
+
+    for( i = 0; ( i < messageCount ) && ( result == 0 ); i++ )
+    {
+        expectedSize = _encodeWithTinyCbor( &pMessages[ i ], expected, sizeof( expected ) );
+        encoderSize = _encodeWithEncoder( &pMessages[ i ], encoderBuffer, sizeof( encoderBuffer ) );
+        templateSize = _encodeWithTemplate( &pMessages[ i ], templateBuffer, sizeof( templateBuffer ) );
+
+        if( ( expectedSize == 0 ) ||
+            ( encoderSize != expectedSize ) || ( memcmp( encoderBuffer, expected, expectedSize ) != 0 ) ||
+            ( templateSize != expectedSize ) || ( memcmp( templateBuffer, expected, expectedSize ) != 0 ) )
+        {
+            fprintf( stderr, "Message %u encodes differently.\n", ( unsigned ) i );
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Encode all messages once per round and return the fastest round in nanoseconds. */
+static uint64_t _measure( _encodeFunction_t encode,
+                          const _benchMessage_t * pMessages,
+                          uint32_t messageCount,
+                          uint32_t rounds )
+{
+    uint8_t buffer[ _MESSAGE_BUFFER_SIZE ];
+    uint64_t startNs = 0, roundNs = 0, bestNs = UINT64_MAX;
+    size_t encodedBytes = 0;
+    uint32_t round = 0, i = 0;
+
+    for( round = 0; round < rounds; round++ )
+    {
+        startNs = _nowNs();
+
+        for( i = 0; i < messageCount; i++ )
+        {
+            encodedBytes += encode( &pMessages[ i ], buffer, sizeof( buffer ) );
+        }
+
+        roundNs = _nowNs() - startNs;
+
+        if( roundNs < bestNs )
+        {
+            bestNs = roundNs;
+        }
+    }
+
+    _encodedBytes += encodedBytes;
+
+    return bestNs;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    const struct
+    {
+        const char * pName;
+        _encodeFunction_t encode;
+    } paths[] =
+    {
+        { "tinycbor", _encodeWithTinyCbor },
+        { "encoder",  _encodeWithEncoder  },
+        { "template", _encodeWithTemplate }
+    };
+    uint32_t messageCount = _DEFAULT_MESSAGES;
+    uint32_t rounds = _DEFAULT_ROUNDS;
+    _benchMessage_t * pMessages = NULL;
+    uint64_t bestNs = 0;
+    uint32_t i = 0;
+    int option = 0;
+    int result = 0;
+
+    while( ( option = getopt( argc, argv, "m:r:" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'm':
+                messageCount = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'r':
+                rounds = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            default:
+                result = 1;
+                break;
+        }
+    }
+
+    if( ( result != 0 ) || ( messageCount == 0U ) || ( rounds == 0U ) )
+    {
+        fprintf( stderr, "usage: %s [-m messages] [-r rounds]\n", argv[ 0 ] );
+        result = 1;
+    }
+
+    if( result == 0 )
+    {
+        pMessages = calloc( messageCount, sizeof( _benchMessage_t ) );
+
+        if( pMessages == NULL )
+        {
+            fprintf( stderr, "Out of memory.\n" );
+            result = 1;
+        }
+    }
+
+    if( result == 0 )
+    {
+        memset( _bitmap, 0xFF, sizeof( _bitmap ) );
+
+        /* Walk through the blocks of a 64 MB file, so offsets take the
+         * immediate, one and two byte heads, and request 1 to 128 blocks. */
+        for( i = 0; i < messageCount; i++ )
+        {
+            pMessages[ i ].blockOffset = ( int32_t ) ( ( i * 37U ) % 65536U );
+            pMessages[ i ].numberOfBlocks = ( int32_t ) ( 1U + ( i % 128U ) );
+        }
+
+        result = _createTemplate();
+
+        if( result != 0 )
+        {
+            fprintf( stderr, "Failed to create the template.\n" );
+        }
+    }
+
+    if( result == 0 )
+    {
+        result = _verify( pMessages, messageCount );
+    }
+
+    if( result == 0 )
+    {
+        printf( "%-10s %10s %12s\n", "path", "messages", "ns/message" );
+
+        for( i = 0; i < sizeof( paths ) / sizeof( paths[ 0 ] ); i++ )
+        {
+            bestNs = _measure( paths[ i ].encode, pMessages, messageCount, rounds );
+            printf( "%-10s %10u %12.1f\n",
+                    paths[ i ].pName,
+                    ( unsigned ) messageCount,
+                    ( double ) bestNs / ( double ) messageCount );
+        }
+    }
+
+    free( pMessages );
+
+    return result;
+}
@@ -444,6 +444,190 @@ typedef struct IotSerializerDecodeInterface
                                         IotSerializerDecoderObject_t * pDecoderObject );
 } IotSerializerDecodeInterface_t;
 
+/**
+ * @brief The maximum number of value slots in a CBOR template.
+ */
+#ifndef IOT_SERIALIZER_CBOR_TEMPLATE_MAX_SLOTS
+    #define IOT_SERIALIZER_CBOR_TEMPLATE_MAX_SLOTS    ( 8 )
+#endif
+
+/* helper macros to describe the items of a CBOR template */
+#define IotSerializer_CborTemplateMap( pairCount ) \
+    ( IotSerializerCborTemplateItem_t ) { .kind = IOT_SERIALIZER_CBOR_TEMPLATE_CONTAINER, .type = IOT_SERIALIZER_CONTAINER_MAP, .length = ( pairCount ) }
+
+#define IotSerializer_CborTemplateArray( elementCount ) \
+    ( IotSerializerCborTemplateItem_t ) { .kind = IOT_SERIALIZER_CBOR_TEMPLATE_CONTAINER, .type = IOT_SERIALIZER_CONTAINER_ARRAY, .length = ( elementCount ) }
+
+#define IotSerializer_CborTemplateConstant( scalarData ) \
+    ( IotSerializerCborTemplateItem_t ) { .kind = IOT_SERIALIZER_CBOR_TEMPLATE_CONSTANT, .type = ( scalarData ).type, .value = ( scalarData ).value }
+
+#define IotSerializer_CborTemplateKey( pKey ) \
+    IotSerializer_CborTemplateConstant( IotSerializer_ScalarTextString( pKey ) )
+
+#define IotSerializer_CborTemplateSlot( scalarType ) \
+    ( IotSerializerCborTemplateItem_t ) { .kind = IOT_SERIALIZER_CBOR_TEMPLATE_SLOT, .type = ( scalarType ) }
+
+/* kind of an item in a CBOR template */
+typedef enum
+{
+    IOT_SERIALIZER_CBOR_TEMPLATE_CONTAINER = 0, /* map or array header with a definite length */
+    IOT_SERIALIZER_CBOR_TEMPLATE_CONSTANT,      /* scalar encoded once, e.g. a key */
+    IOT_SERIALIZER_CBOR_TEMPLATE_SLOT           /* scalar provided for every message */
+} IotSerializerCborTemplateItemKind_t;
+
+/* one item of a CBOR template, in encoding order */
+typedef struct IotSerializerCborTemplateItem
+{
+    IotSerializerCborTemplateItemKind_t kind;
+    IotSerializerDataType_t type;
+    size_t length;                    /* container: number of key-value pairs or elements */
+    IotSerializerScalarValue_t value; /* constant: the value to encode */
+} IotSerializerCborTemplateItem_t;
+
+/* a pre-encoded CBOR message with value slots */
+typedef struct IotSerializerCborTemplate
+{
+    const uint8_t * pConstants; /* every byte that does not depend on the slot values */
+    size_t constantsLength;
+    size_t slotCount;
+    struct
+    {
+        size_t offset; /* offset in pConstants where the slot value is inserted */
+        IotSerializerDataType_t type;
+    } slots[ IOT_SERIALIZER_CBOR_TEMPLATE_MAX_SLOTS ];
+} IotSerializerCborTemplate_t;
+
+/**
+ * @brief Pre-encode the containers and constants of a fixed-schema CBOR message.
+ *
+ * Maps and arrays must have a definite length. The key and value of a map
+ * entry are two items.
+ *
+ * @param[out] pTemplate The template to create.
+ * @param[in] pItems The items of the message in encoding order.
+ * @param[in] itemCount Number of items.
+ * @param[in] pConstantBuffer Buffer receiving the pre-encoded bytes. It must
+ * stay valid as long as the template is used.
+ * @param[in] constantBufferSize Size of pConstantBuffer.
+ *
+ * @return IOT_SERIALIZER_SUCCESS if successful;
+ * IOT_SERIALIZER_BUFFER_TOO_SMALL if pConstantBuffer is NULL or too small, in which
+ * case pTemplate->constantsLength is the size needed;
+ * IOT_SERIALIZER_INVALID_INPUT for an unsupported item or too many slots.
+ */
+IotSerializerError_t IotSerializer_CborTemplateCreate( IotSerializerCborTemplate_t * pTemplate,
+                                                       const IotSerializerCborTemplateItem_t * pItems,
+                                                       size_t itemCount,
+                                                       uint8_t * pConstantBuffer,
+                                                       size_t constantBufferSize );
+
+/**
+ * @brief Encode a message from a template by filling in its value slots.
+ *
+ * The output is identical to encoding the same message with _IotSerializerCborEncoder.
+ *
+ * @param[in] pTemplate A template created by IotSerializer_CborTemplateCreate.
+ * @param[in] pValues One value per slot, in slot order.
+ * @param[in] valueCount Number of values; must equal the number of slots.
+ * @param[in] pDataBuffer Output buffer; NULL is valid to calculate the needed size.
+ * @param[in] maxSize Size of pDataBuffer.
+ * @param[out] pEncodedSize Size of the encoded message, also set when the buffer is too small.
+ *
+ * @return IOT_SERIALIZER_SUCCESS if successful;
+ * IOT_SERIALIZER_BUFFER_TOO_SMALL if pDataBuffer is NULL or too small;
+ * IOT_SERIALIZER_INVALID_INPUT if the values do not match the slots.
+ */
+IotSerializerError_t IotSerializer_CborTemplateEncode( const IotSerializerCborTemplate_t * pTemplate,
+                                                       const IotSerializerScalarData_t * pValues,
+                                                       size_t valueCount,
+                                                       uint8_t * pDataBuffer,
+                                                       size_t maxSize,
+                                                       size_t * pEncodedSize );
+
+/**
+ * @brief Size in bytes of IotSerializerCborBorrowState_t.
+ */
+#define IOT_SERIALIZER_CBOR_BORROW_STATE_SIZE    ( 96 )
+
+/* caller-owned state of an object decoded in borrow mode */
+typedef struct IotSerializerCborBorrowState
+{
+    union
+    {
+        uint64_t alignment;
+        void * pAlignment;
+        uint8_t storage[ IOT_SERIALIZER_CBOR_BORROW_STATE_SIZE ];
+    } u;
+} IotSerializerCborBorrowState_t;
+
+/*
+ * Borrow-mode CBOR decoding.
+ *
+ * These functions create decoder objects like _IotSerializerCborDecoder does,
+ * without allocating memory:
+ * - A container or iterator keeps its state in an IotSerializerCborBorrowState_t
+ *   provided by the caller, typically on the stack.
+ * - A text or byte string points into the decoded buffer instead of being copied.
+ *   Chunked strings are not supported.
+ *
+ * The objects work with the next, isEndOfContainer, stepOut and destroy functions
+ * of _IotSerializerCborDecoder, which never free borrowed state. The state of the
+ * outermost object and the decoded buffer must outlive every object decoded from them.
+ */
+
+/**
+ * @brief Initialize a decoder object in borrow mode.
+ *
+ * @param[in] pState State of the outermost object.
+ * @param[out] pDecoderObject The outermost object.
+ * @param[in] pDataBuffer Buffer containing the data to decode.
+ * @param[in] maxSize Size of the data.
+ * @return IOT_SERIALIZER_SUCCESS if successful
+ */
+IotSerializerError_t IotSerializer_CborBorrowInit( IotSerializerCborBorrowState_t * pState,
+                                                   IotSerializerDecoderObject_t * pDecoderObject,
+                                                   const uint8_t * pDataBuffer,
+                                                   size_t maxSize );
+
+/**
+ * @brief Find an object by key within a map, in borrow mode.
+ *
+ * @param[in] pDecoderObject The map.
+ * @param[in] pKey The key to look for.
+ * @param[in] pState State of the value if it is a container; may be NULL when a scalar is expected.
+ * @param[out] pValueObject The value of the key.
+ * @return IOT_SERIALIZER_SUCCESS if successful; IOT_SERIALIZER_INVALID_INPUT if the
+ * value is a container and pState is NULL.
+ */
+IotSerializerError_t IotSerializer_CborBorrowFind( IotSerializerDecoderObject_t * pDecoderObject,
+                                                   const char * pKey,
+                                                   IotSerializerCborBorrowState_t * pState,
+                                                   IotSerializerDecoderObject_t * pValueObject );
+
+/**
+ * @brief Step into a container, in borrow mode.
+ *
+ * @param[in] pDecoderObject The container.
+ * @param[in] pState State of the iterator.
+ * @param[out] pIterator Iterator over the container.
+ * @return IOT_SERIALIZER_SUCCESS if successful
+ */
+IotSerializerError_t IotSerializer_CborBorrowStepIn( IotSerializerDecoderObject_t * pDecoderObject,
+                                                     IotSerializerCborBorrowState_t * pState,
+                                                     IotSerializerDecoderIterator_t * pIterator );
+
+/**
+ * @brief Get the object pointed to by an iterator, in borrow mode.
+ *
+ * @param[in] iterator The iterator.
+ * @param[in] pState State of the object if it is a container; may be NULL when a scalar is expected.
+ * @param[out] pValueObject The object.
+ * @return IOT_SERIALIZER_SUCCESS if successful
+ */
+IotSerializerError_t IotSerializer_CborBorrowGet( IotSerializerDecoderIterator_t iterator,
+                                                  IotSerializerCborBorrowState_t * pState,
+                                                  IotSerializerDecoderObject_t * pValueObject );
+
 /* Global reference of CBOR/JSON encoder and decoder. */
 extern IotSerializerEncodeInterface_t _IotSerializerCborEncoder;
 
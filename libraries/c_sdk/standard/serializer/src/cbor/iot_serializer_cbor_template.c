@@ -0,0 +1,388 @@
+/*
+ * FreeRTOS Serializer V1.1.2
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_serializer_cbor_template.c
+ * @brief Implements CBOR templates for messages with a fixed schema.
+ *
+ * Container headers, keys and other constants are encoded once when the
+ * template is created. Encoding a message then copies the constant bytes and
+ * encodes only the slot values. Integers and strings use the shortest form,
+ * the same as tinycbor, so a template produces the same bytes as the encoder
+ * in iot_serializer_tinycbor_encoder.c.
+ */
+
+#include "iot_serializer.h"
+
+/* CBOR major types. */
+#define CBOR_MAJOR_TYPE_UNSIGNED_INT    ( 0U )
+#define CBOR_MAJOR_TYPE_NEGATIVE_INT    ( 1U )
+#define CBOR_MAJOR_TYPE_BYTE_STRING     ( 2U )
+#define CBOR_MAJOR_TYPE_TEXT_STRING     ( 3U )
+#define CBOR_MAJOR_TYPE_ARRAY           ( 4U )
+#define CBOR_MAJOR_TYPE_MAP             ( 5U )
+
+/* CBOR simple values. */
+#define CBOR_SIMPLE_FALSE               ( 0xF4U )
+#define CBOR_SIMPLE_TRUE                ( 0xF5U )
+#define CBOR_SIMPLE_NULL                ( 0xF6U )
+
+/* Additional information values selecting the size of the argument. */
+#define CBOR_ARGUMENT_8BIT              ( 24U )
+#define CBOR_ARGUMENT_16BIT             ( 25U )
+#define CBOR_ARGUMENT_32BIT             ( 26U )
+#define CBOR_ARGUMENT_64BIT             ( 27U )
+
+/* Calculate the size of a CBOR head carrying the argument. */
+static size_t _headLength( uint64_t argument );
+
+/* Write a CBOR head in shortest form. The buffer must hold _headLength( argument ) bytes. */
+static void _writeHead( uint8_t * pBuffer,
+                        uint8_t majorType,
+                        uint64_t argument );
+
+/* Encode a scalar into the buffer if it fits. Returns the encoded size. */
+static size_t _encodeScalar( IotSerializerDataType_t type,
+                             const IotSerializerScalarValue_t * pValue,
+                             uint8_t * pBuffer,
+                             size_t remainingSize );
+
+/*-----------------------------------------------------------*/
+
+static size_t _headLength( uint64_t argument )
+{
+    size_t length = 9;
+
+    if( argument < CBOR_ARGUMENT_8BIT )
+    {
+        length = 1;
+    }
+    else if( argument <= UINT8_MAX )
+    {
+        length = 2;
+    }
+    else if( argument <= UINT16_MAX )
+    {
+        length = 3;
+    }
+    else if( argument <= UINT32_MAX )
+    {
+        length = 5;
+    }
+
+    return length;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _writeHead( uint8_t * pBuffer,
+                        uint8_t majorType,
+                        uint64_t argument )
+{
+    size_t length = _headLength( argument );
+    size_t i = 0;
+
+    majorType = ( uint8_t ) ( majorType << 5 );
+
+    switch( length )
+    {
+        case 1:
+            pBuffer[ 0 ] = ( uint8_t ) ( majorType | ( uint8_t ) argument );
+            break;
+
+        case 2:
+            pBuffer[ 0 ] = ( uint8_t ) ( majorType | CBOR_ARGUMENT_8BIT );
+            break;
+
+        case 3:
+            pBuffer[ 0 ] = ( uint8_t ) ( majorType | CBOR_ARGUMENT_16BIT );
+            break;
+
+        case 5:
+            pBuffer[ 0 ] = ( uint8_t ) ( majorType | CBOR_ARGUMENT_32BIT );
+            break;
+
+        default:
+            pBuffer[ 0 ] = ( uint8_t ) ( majorType | CBOR_ARGUMENT_64BIT );
+            break;
+    }
+
+    /* The argument follows in network byte order. */
+    for( i = length - 1; i > 0; i-- )
+    {
+        pBuffer[ i ] = ( uint8_t ) argument;
+        argument >>= 8;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _encodeScalar( IotSerializerDataType_t type,
+                             const IotSerializerScalarValue_t * pValue,
+                             uint8_t * pBuffer,
+                             size_t remainingSize )
+{
+    size_t length = 0;
+    uint8_t majorType = CBOR_MAJOR_TYPE_UNSIGNED_INT;
+    uint64_t argument = 0;
+
+    switch( type )
+    {
+        case IOT_SERIALIZER_SCALAR_NULL:
+        case IOT_SERIALIZER_SCALAR_BOOL:
+            length = 1;
+
+            if( ( pBuffer != NULL ) && ( remainingSize >= length ) )
+            {
+                pBuffer[ 0 ] = ( type == IOT_SERIALIZER_SCALAR_NULL ) ? CBOR_SIMPLE_NULL :
+                               ( pValue->u.booleanValue ? CBOR_SIMPLE_TRUE : CBOR_SIMPLE_FALSE );
+            }
+
+            break;
+
+        case IOT_SERIALIZER_SCALAR_SIGNED_INT:
+
+            if( pValue->u.signedInt < 0 )
+            {
+                majorType = CBOR_MAJOR_TYPE_NEGATIVE_INT;
+                argument = ( uint64_t ) ( -( pValue->u.signedInt + 1 ) );
+            }
+            else
+            {
+                argument = ( uint64_t ) pValue->u.signedInt;
+            }
+
+            length = _headLength( argument );
+
+            if( ( pBuffer != NULL ) && ( remainingSize >= length ) )
+            {
+                _writeHead( pBuffer, majorType, argument );
+            }
+
+            break;
+
+        default:
+            /* Text or byte string. The caller has validated the type. */
+            majorType = ( type == IOT_SERIALIZER_SCALAR_TEXT_STRING ) ? CBOR_MAJOR_TYPE_TEXT_STRING
+                        : CBOR_MAJOR_TYPE_BYTE_STRING;
+            argument = ( uint64_t ) pValue->u.string.length;
+            length = _headLength( argument ) + pValue->u.string.length;
+
+            if( ( pBuffer != NULL ) && ( remainingSize >= length ) )
+            {
+                _writeHead( pBuffer, majorType, argument );
+
+                if( pValue->u.string.length > 0 )
+                {
+                    ( void ) memcpy( pBuffer + _headLength( argument ),
+                                     pValue->u.string.pString,
+                                     pValue->u.string.length );
+                }
+            }
+
+            break;
+    }
+
+    return length;
+}
+
+/*-----------------------------------------------------------*/
+
+IotSerializerError_t IotSerializer_CborTemplateCreate( IotSerializerCborTemplate_t * pTemplate,
+                                                       const IotSerializerCborTemplateItem_t * pItems,
+                                                       size_t itemCount,
+                                                       uint8_t * pConstantBuffer,
+                                                       size_t constantBufferSize )
+{
+    IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
+    size_t offset = 0, i = 0;
+    size_t remainingSize = 0;
+    uint8_t * pCursor = NULL;
+    const IotSerializerCborTemplateItem_t * pItem = NULL;
+
+    IotSerializer_Assert( pTemplate != NULL );
+    IotSerializer_Assert( pItems != NULL );
+
+    pTemplate->slotCount = 0;
+
+    for( i = 0; ( i < itemCount ) && ( error == IOT_SERIALIZER_SUCCESS ); i++ )
+    {
+        pItem = &pItems[ i ];
+
+        /* Output is only written while the constants fit. The offset keeps
+         * counting so that the needed size is known either way. */
+        if( ( pConstantBuffer != NULL ) && ( offset <= constantBufferSize ) )
+        {
+            pCursor = pConstantBuffer + offset;
+            remainingSize = constantBufferSize - offset;
+        }
+        else
+        {
+            pCursor = NULL;
+            remainingSize = 0;
+        }
+
+        switch( pItem->kind )
+        {
+            case IOT_SERIALIZER_CBOR_TEMPLATE_CONTAINER:
+
+                if( ( ( pItem->type != IOT_SERIALIZER_CONTAINER_MAP ) &&
+                      ( pItem->type != IOT_SERIALIZER_CONTAINER_ARRAY ) ) ||
+                    ( pItem->length == IOT_SERIALIZER_INDEFINITE_LENGTH ) )
+                {
+                    error = IOT_SERIALIZER_INVALID_INPUT;
+                }
+                else
+                {
+                    if( ( pCursor != NULL ) && ( remainingSize >= _headLength( pItem->length ) ) )
+                    {
+                        _writeHead( pCursor,
+                                    ( pItem->type == IOT_SERIALIZER_CONTAINER_MAP ) ? CBOR_MAJOR_TYPE_MAP
+                                    : CBOR_MAJOR_TYPE_ARRAY,
+                                    ( uint64_t ) pItem->length );
+                    }
+
+                    offset += _headLength( pItem->length );
+                }
+
+                break;
+
+            case IOT_SERIALIZER_CBOR_TEMPLATE_CONSTANT:
+
+                if( ( pItem->type < IOT_SERIALIZER_SCALAR_NULL ) ||
+                    ( pItem->type > IOT_SERIALIZER_SCALAR_BYTE_STRING ) )
+                {
+                    error = IOT_SERIALIZER_INVALID_INPUT;
+                }
+                else
+                {
+                    offset += _encodeScalar( pItem->type, &pItem->value, pCursor, remainingSize );
+                }
+
+                break;
+
+            case IOT_SERIALIZER_CBOR_TEMPLATE_SLOT:
+
+                if( ( pItem->type < IOT_SERIALIZER_SCALAR_NULL ) ||
+                    ( pItem->type > IOT_SERIALIZER_SCALAR_BYTE_STRING ) ||
+                    ( pTemplate->slotCount == IOT_SERIALIZER_CBOR_TEMPLATE_MAX_SLOTS ) )
+                {
+                    error = IOT_SERIALIZER_INVALID_INPUT;
+                }
+                else
+                {
+                    pTemplate->slots[ pTemplate->slotCount ].offset = offset;
+                    pTemplate->slots[ pTemplate->slotCount ].type = pItem->type;
+                    pTemplate->slotCount++;
+                }
+
+                break;
+
+            default:
+                error = IOT_SERIALIZER_INVALID_INPUT;
+                break;
+        }
+    }
+
+    pTemplate->pConstants = pConstantBuffer;
+    pTemplate->constantsLength = offset;
+
+    if( ( error == IOT_SERIALIZER_SUCCESS ) &&
+        ( ( pConstantBuffer == NULL ) || ( offset > constantBufferSize ) ) )
+    {
+        error = IOT_SERIALIZER_BUFFER_TOO_SMALL;
+    }
+
+    return error;
+}
+
+/*-----------------------------------------------------------*/
+
+IotSerializerError_t IotSerializer_CborTemplateEncode( const IotSerializerCborTemplate_t * pTemplate,
+                                                       const IotSerializerScalarData_t * pValues,
+                                                       size_t valueCount,
+                                                       uint8_t * pDataBuffer,
+                                                       size_t maxSize,
+                                                       size_t * pEncodedSize )
+{
+    IotSerializerError_t error = IOT_SERIALIZER_SUCCESS;
+    size_t encodedSize = 0, constantsOffset = 0, i = 0;
+    size_t segmentLength = 0;
+
+    IotSerializer_Assert( pTemplate != NULL );
+    IotSerializer_Assert( pEncodedSize != NULL );
+
+    if( valueCount != pTemplate->slotCount )
+    {
+        error = IOT_SERIALIZER_INVALID_INPUT;
+    }
+
+    /* Every value must have the type of its slot, so the message keeps its schema. */
+    for( i = 0; ( i < valueCount ) && ( error == IOT_SERIALIZER_SUCCESS ); i++ )
+    {
+        if( pValues[ i ].type != pTemplate->slots[ i ].type )
+        {
+            error = IOT_SERIALIZER_INVALID_INPUT;
+        }
+    }
+
+    /* Interleave the pre-encoded constants with the slot values. The slot after
+     * the last one stands for the trailing constants. */
+    for( i = 0; ( i <= valueCount ) && ( error == IOT_SERIALIZER_SUCCESS ); i++ )
+    {
+        segmentLength = ( ( i < valueCount ) ? pTemplate->slots[ i ].offset
+                          : pTemplate->constantsLength ) - constantsOffset;
+
+        if( ( pDataBuffer != NULL ) && ( encodedSize + segmentLength <= maxSize ) )
+        {
+            ( void ) memcpy( pDataBuffer + encodedSize,
+                             pTemplate->pConstants + constantsOffset,
+                             segmentLength );
+        }
+
+        encodedSize += segmentLength;
+        constantsOffset += segmentLength;
+
+        if( i < valueCount )
+        {
+            encodedSize += _encodeScalar( pValues[ i ].type,
+                                          &pValues[ i ].value,
+                                          ( ( pDataBuffer != NULL ) && ( encodedSize <= maxSize ) ) ? pDataBuffer + encodedSize : NULL,
+                                          ( encodedSize <= maxSize ) ? maxSize - encodedSize : 0 );
+        }
+    }
+
+    if( error == IOT_SERIALIZER_SUCCESS )
+    {
+        *pEncodedSize = encodedSize;
+
+        if( ( pDataBuffer == NULL ) || ( encodedSize > maxSize ) )
+        {
+            error = IOT_SERIALIZER_BUFFER_TOO_SMALL;
+        }
+    }
+
+    return error;
+}
@@ -77,8 +77,20 @@ typedef struct _cborValueWrapper
 {
     CborValue cborValue;
     bool isOutermost;
+    bool isBorrowed; /* Lives in caller storage; never freed by the decoder. */
 } _cborValueWrapper_t;
 
+/* Layout of IotSerializerCborBorrowState_t. */
+typedef struct _cborBorrowState
+{
+    CborParser parser;                     /* Used by the outermost object only. */
+    IotSerializerDecoderObject_t iterator; /* Used by iterators only. */
+    _cborValueWrapper_t wrapper;
+} _cborBorrowState_t;
+
+/* The caller-owned storage must hold the borrow state. */
+typedef char _borrowStateSizeCheck_t[ ( sizeof( _cborBorrowState_t ) <= sizeof( IotSerializerCborBorrowState_t ) ) ? 1 : -1 ];
+
 /*-----------------------------------------------------------*/
 
 static void _translateErrorCode( CborError cborError,
@@ -143,9 +155,48 @@ static IotSerializerDataType_t _toSerializerType( CborType type )
 
 /*-----------------------------------------------------------*/
 
-/* Construct DecoderObject based on the wrapper of CborValue. */
+/* Point a decoder object at a definite length string in the decoded buffer. */
+static IotSerializerError_t _borrowString( const CborValue * pCborValue,
+                                           IotSerializerDecoderObject_t * pDecoderObject )
+{
+    IotSerializerError_t returnedError = IOT_SERIALIZER_SUCCESS;
+    CborError cborError = CborNoError;
+    CborValue next = *pCborValue;
+    size_t length = 0;
+
+    /* Chunked strings are not contiguous in the buffer. */
+    if( !cbor_value_is_length_known( pCborValue ) )
+    {
+        return IOT_SERIALIZER_NOT_SUPPORTED;
+    }
+
+    cborError = cbor_value_get_string_length( pCborValue, &length );
+
+    /* The bytes of a definite length string end where the next item starts. */
+    if( cborError == CborNoError )
+    {
+        cborError = cbor_value_advance( &next );
+    }
+
+    if( cborError == CborNoError )
+    {
+        pDecoderObject->u.value.u.string.pString = ( uint8_t * ) ( cbor_value_get_next_byte( &next ) - length );
+        pDecoderObject->u.value.u.string.length = length;
+    }
+
+    _translateErrorCode( cborError, &returnedError );
+
+    return returnedError;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Construct DecoderObject based on the wrapper of CborValue. In borrow mode,
+ * pBorrowState receives a container's state and strings are not copied. */
 static IotSerializerError_t _createDecoderObject( _cborValueWrapper_t * pCborValueWrapper,
-                                                  IotSerializerDecoderObject_t * pDecoderObject )
+                                                  IotSerializerDecoderObject_t * pDecoderObject,
+                                                  bool borrow,
+                                                  _cborBorrowState_t * pBorrowState )
 {
     IotSerializerError_t returnedError = IOT_SERIALIZER_SUCCESS;
     CborError cborError = CborNoError;
@@ -167,7 +218,19 @@ static IotSerializerError_t _createDecoderObject( _cborValueWrapper_t * pCborVal
     }
 
     /* If this is a map or array. */
-    if( _isArrayOrMap( dataType ) )
+    if( _isArrayOrMap( dataType ) && borrow )
+    {
+        /* Save to the caller's storage. */
+        if( pBorrowState == NULL )
+        {
+            return IOT_SERIALIZER_INVALID_INPUT;
+        }
+
+        pBorrowState->wrapper = *pCborValueWrapper;
+        pBorrowState->wrapper.isBorrowed = true;
+        pDecoderObject->u.pHandle = &pBorrowState->wrapper;
+    }
+    else if( _isArrayOrMap( dataType ) )
     {
         /* Save to decoder object's handle. */
         pDecoderObject->u.pHandle = IotSerializer_MallocCborValue( sizeof( _cborValueWrapper_t ) );
@@ -220,6 +283,12 @@ static IotSerializerError_t _createDecoderObject( _cborValueWrapper_t * pCborVal
             case IOT_SERIALIZER_SCALAR_BYTE_STRING:
             case IOT_SERIALIZER_SCALAR_TEXT_STRING:
 
+                if( borrow )
+                {
+                    returnedError = _borrowString( pCborValue, pDecoderObject );
+                    break;
+                }
+
                 if( dataType == IOT_SERIALIZER_SCALAR_BYTE_STRING )
                 {
                     cborError = cbor_value_copy_byte_string(
@@ -274,7 +343,7 @@ static IotSerializerError_t _init( IotSerializerDecoderObject_t * pDecoderObject
                                    size_t maxSize )
 {
     CborParser * pCborParser = IotSerializer_MallocCborParser( sizeof( CborParser ) );
-    _cborValueWrapper_t cborValueWrapper = { .isOutermost = 0 };
+    _cborValueWrapper_t cborValueWrapper = { .isOutermost = 0, .isBorrowed = false };
 
     if( pCborParser == NULL )
     {
@@ -296,7 +365,7 @@ static IotSerializerError_t _init( IotSerializerDecoderObject_t * pDecoderObject
     {
         cborValueWrapper.isOutermost = true;
 
-        returnedError = _createDecoderObject( &cborValueWrapper, pDecoderObject );
+        returnedError = _createDecoderObject( &cborValueWrapper, pDecoderObject, false, NULL );
     }
 
     /* If there is any error or decoder object is a scalar type, free the cbor resources. */
@@ -330,6 +399,14 @@ static void _destroy( IotSerializerDecoderObject_t * pDecoderObject )
 
     _cborValueWrapper_t * pCborValueWrapper = _castDecoderObjectToCborValue( pDecoderObject );
 
+    /* Borrowed objects own no memory. */
+    if( pCborValueWrapper->isBorrowed )
+    {
+        pDecoderObject->u.pHandle = NULL;
+
+        return;
+    }
+
     /* If this is outmost object, the parser's memory needs to be freed. */
     if( pCborValueWrapper->isOutermost )
     {
@@ -349,14 +426,16 @@ static IotSerializerError_t _get( IotSerializerDecoderIterator_t iterator,
 {
     _cborValueWrapper_t * pCborValueWrapper = _castDecoderIteratorToCborValue( iterator );
 
-    return _createDecoderObject( pCborValueWrapper, pValueObject );
+    return _createDecoderObject( pCborValueWrapper, pValueObject, false, NULL );
 }
 
 /*-----------------------------------------------------------*/
 
-static IotSerializerError_t _find( IotSerializerDecoderObject_t * pDecoderObject,
-                                   const char * pKey,
-                                   IotSerializerDecoderObject_t * pValueObject )
+static IotSerializerError_t _findValue( IotSerializerDecoderObject_t * pDecoderObject,
+                                        const char * pKey,
+                                        IotSerializerDecoderObject_t * pValueObject,
+                                        bool borrow,
+                                        _cborBorrowState_t * pBorrowState )
 {
     _cborValueWrapper_t newCborValueWrapper;
 
@@ -372,6 +451,7 @@ static IotSerializerError_t _find( IotSerializerDecoderObject_t * pDecoderObject
 
     /* Set this object not to be outermost one. */
     newCborValueWrapper.isOutermost = false;
+    newCborValueWrapper.isBorrowed = false;
 
     cborError = cbor_value_map_find_value(
         &pCborValueWrapper->cborValue,
@@ -389,7 +469,7 @@ static IotSerializerError_t _find( IotSerializerDecoderObject_t * pDecoderObject
         }
         else
         {
-            returnedError = _createDecoderObject( &newCborValueWrapper, pValueObject );
+            returnedError = _createDecoderObject( &newCborValueWrapper, pValueObject, borrow, pBorrowState );
         }
     }
 
@@ -398,6 +478,14 @@ static IotSerializerError_t _find( IotSerializerDecoderObject_t * pDecoderObject
     return returnedError;
 }
 
+/*-----------------------------------------------------------*/
+
+static IotSerializerError_t _find( IotSerializerDecoderObject_t * pDecoderObject,
+                                   const char * pKey,
+                                   IotSerializerDecoderObject_t * pValueObject )
+{
+    return _findValue( pDecoderObject, pKey, pValueObject, false, NULL );
+}
 
 /*-----------------------------------------------------------*/
 
@@ -421,6 +509,7 @@ static IotSerializerError_t _stepIn( IotSerializerDecoderObject_t * pDecoderObje
         pNewObject->type = pDecoderObject->type;
 
         pNewCborValueWrapper->isOutermost = false;
+        pNewCborValueWrapper->isBorrowed = false;
         pNewObject->u.pHandle = ( void * ) pNewCborValueWrapper;
 
         *pIterator = ( IotSerializerDecoderIterator_t ) pNewObject;
@@ -448,7 +537,7 @@ static IotSerializerError_t _stepOut( IotSerializerDecoderIterator_t iterator,
         &pOuterCborValueWrapper->cborValue,
         &pInnerCborValueWrapper->cborValue );
 
-    if( cborError == CborNoError )
+    if( ( cborError == CborNoError ) && !pInnerCborValueWrapper->isBorrowed )
     {
         IotSerializer_FreeCborValue( pInnerCborValueWrapper );
         IotSerializer_FreeDecoderObject( iterator );
@@ -483,3 +572,85 @@ static bool _isEndOfContainer( IotSerializerDecoderIterator_t iterator )
 
     return cbor_value_at_end( &pCborValueWrapper->cborValue );
 }
+
+/*-----------------------------------------------------------*/
+
+IotSerializerError_t IotSerializer_CborBorrowInit( IotSerializerCborBorrowState_t * pState,
+                                                   IotSerializerDecoderObject_t * pDecoderObject,
+                                                   const uint8_t * pDataBuffer,
+                                                   size_t maxSize )
+{
+    IotSerializerError_t returnedError = IOT_SERIALIZER_SUCCESS;
+    CborError cborError = CborNoError;
+    _cborBorrowState_t * pBorrowState = ( _cborBorrowState_t * ) pState;
+    _cborValueWrapper_t cborValueWrapper = { .isOutermost = false, .isBorrowed = true };
+
+    cborError = cbor_parser_init(
+        pDataBuffer,
+        maxSize,
+        0,
+        &pBorrowState->parser,
+        &cborValueWrapper.cborValue );
+
+    if( cborError == CborNoError )
+    {
+        returnedError = _createDecoderObject( &cborValueWrapper, pDecoderObject, true, pBorrowState );
+    }
+
+    _translateErrorCode( cborError, &returnedError );
+
+    return returnedError;
+}
+
+/*-----------------------------------------------------------*/
+
+IotSerializerError_t IotSerializer_CborBorrowFind( IotSerializerDecoderObject_t * pDecoderObject,
+                                                   const char * pKey,
+                                                   IotSerializerCborBorrowState_t * pState,
+                                                   IotSerializerDecoderObject_t * pValueObject )
+{
+    return _findValue( pDecoderObject, pKey, pValueObject, true, ( _cborBorrowState_t * ) pState );
+}
+
+/*-----------------------------------------------------------*/
+
+IotSerializerError_t IotSerializer_CborBorrowStepIn( IotSerializerDecoderObject_t * pDecoderObject,
+                                                     IotSerializerCborBorrowState_t * pState,
+                                                     IotSerializerDecoderIterator_t * pIterator )
+{
+    IotSerializerError_t returnedError = IOT_SERIALIZER_SUCCESS;
+    CborError cborError = CborNoError;
+    _cborBorrowState_t * pBorrowState = ( _cborBorrowState_t * ) pState;
+
+    _cborValueWrapper_t * pCborValueWrapper = _castDecoderObjectToCborValue( pDecoderObject );
+
+    cborError = cbor_value_enter_container(
+        &pCborValueWrapper->cborValue,
+        &pBorrowState->wrapper.cborValue );
+
+    if( cborError == CborNoError )
+    {
+        pBorrowState->wrapper.isOutermost = false;
+        pBorrowState->wrapper.isBorrowed = true;
+
+        pBorrowState->iterator.type = pDecoderObject->type;
+        pBorrowState->iterator.u.pHandle = &pBorrowState->wrapper;
+
+        *pIterator = ( IotSerializerDecoderIterator_t ) &pBorrowState->iterator;
+    }
+
+    _translateErrorCode( cborError, &returnedError );
+
+    return returnedError;
+}
+
+/*-----------------------------------------------------------*/
+
+IotSerializerError_t IotSerializer_CborBorrowGet( IotSerializerDecoderIterator_t iterator,
+                                                  IotSerializerCborBorrowState_t * pState,
+                                                  IotSerializerDecoderObject_t * pValueObject )
+{
+    _cborValueWrapper_t * pCborValueWrapper = _castDecoderIteratorToCborValue( iterator );
+
+    return _createDecoderObject( pCborValueWrapper, pValueObject, true, ( _cborBorrowState_t * ) pState );
+}
@@ -41,7 +41,13 @@
 #define _encoder        _IotSerializerCborEncoder
 #define _decoder        _IotSerializerCborDecoder
 
-#define _BUFFER_SIZE    100
+#define _BUFFER_SIZE                100
+
+/* Number of messages encoded with one template by the reuse test. */
+#define _TEMPLATE_REUSE_COUNT       ( 300 )
+
+/* Slot count of the template used by the tests. */
+#define _TEMPLATE_SLOT_COUNT        ( 3 )
 
 static IotSerializerEncoderObject_t _encoderObject;
 
@@ -85,6 +91,72 @@ TEST_GROUP_RUNNER( Serializer_Unit_CBOR )
 
     RUN_TEST_CASE( Serializer_Unit_CBOR, Encoder_map_nest_map );
     RUN_TEST_CASE( Serializer_Unit_CBOR, Encoder_map_nest_array );
+
+    RUN_TEST_CASE( Serializer_Unit_CBOR, Template_same_as_encoder );
+    RUN_TEST_CASE( Serializer_Unit_CBOR, Template_buffer_too_small );
+    RUN_TEST_CASE( Serializer_Unit_CBOR, Template_invalid_values );
+    RUN_TEST_CASE( Serializer_Unit_CBOR, Template_reuse );
+
+    RUN_TEST_CASE( Serializer_Unit_CBOR, Decoder_borrow_map );
+    RUN_TEST_CASE( Serializer_Unit_CBOR, Decoder_borrow_array );
+}
+
+/*
+ * Message used by the template tests:
+ * {
+ *  "type": 3,
+ *  "values": [ <int>, <int> ],
+ *  "payload": <bytes>
+ * }
+ */
+static IotSerializerError_t _createTemplate( IotSerializerCborTemplate_t * pTemplate,
+                                             uint8_t * pConstantBuffer,
+                                             size_t constantBufferSize )
+{
+    const IotSerializerCborTemplateItem_t items[] =
+    {
+        IotSerializer_CborTemplateMap( 3 ),
+        IotSerializer_CborTemplateKey( "type" ),
+        IotSerializer_CborTemplateConstant( IotSerializer_ScalarSignedInt( 3 ) ),
+        IotSerializer_CborTemplateKey( "values" ),
+        IotSerializer_CborTemplateArray( 2 ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT ),
+        IotSerializer_CborTemplateKey( "payload" ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_BYTE_STRING )
+    };
+
+    return IotSerializer_CborTemplateCreate( pTemplate,
+                                             items,
+                                             sizeof( items ) / sizeof( items[ 0 ] ),
+                                             pConstantBuffer,
+                                             constantBufferSize );
+}
+
+/* Encode the template test message with the generic encoder. */
+static size_t _encodeWithEncoder( uint8_t * pBuffer,
+                                  const IotSerializerScalarData_t * pValues )
+{
+    IotSerializerEncoderObject_t encoderObject = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_STREAM;
+    IotSerializerEncoderObject_t mapObject = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+    IotSerializerEncoderObject_t arrayObject = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_ARRAY;
+    size_t encodedSize = 0;
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _encoder.init( &encoderObject, pBuffer, _BUFFER_SIZE ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _encoder.openContainer( &encoderObject, &mapObject, 3 ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _encoder.appendKeyValue( &mapObject, "type", IotSerializer_ScalarSignedInt( 3 ) ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _encoder.openContainerWithKey( &mapObject, "values", &arrayObject, 2 ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _encoder.append( &arrayObject, pValues[ 0 ] ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _encoder.append( &arrayObject, pValues[ 1 ] ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _encoder.closeContainer( &mapObject, &arrayObject ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _encoder.appendKeyValue( &mapObject, "payload", pValues[ 2 ] ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _encoder.closeContainer( &encoderObject, &mapObject ) );
+
+    encodedSize = _encoder.getEncodedSize( &encoderObject, pBuffer );
+    _encoder.destroy( &encoderObject );
+
+    return encodedSize;
 }
 
 TEST( Serializer_Unit_CBOR, Encoder_init_with_null_buffer )
@@ -381,3 +453,260 @@ TEST( Serializer_Unit_CBOR, Encoder_map_nest_array )
 
     TEST_ASSERT_TRUE( cbor_value_at_end( &arrayElement ) );
 }
+
+TEST( Serializer_Unit_CBOR, Template_same_as_encoder )
+{
+    IotSerializerCborTemplate_t cborTemplate;
+    uint8_t constants[ _BUFFER_SIZE ] = { 0 };
+    uint8_t templateBuffer[ _BUFFER_SIZE ] = { 0 };
+    uint8_t payload[ 30 ] = { 0 };
+    size_t encodedSize = 0, expectedSize = 0, i = 0;
+
+    /* Integers covering every argument size of a CBOR head, both signs. */
+    int64_t numbers[] = { 0, 23, 24, 255, 256, 65535, 65536, 4294967296LL, -1, -24, -25, -70000 };
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _createTemplate( &cborTemplate, constants, sizeof( constants ) ) );
+    TEST_ASSERT_EQUAL( _TEMPLATE_SLOT_COUNT, cborTemplate.slotCount );
+
+    for( i = 0; i < sizeof( numbers ) / sizeof( numbers[ 0 ] ); i++ )
+    {
+        IotSerializerScalarData_t values[ _TEMPLATE_SLOT_COUNT ] =
+        {
+            IotSerializer_ScalarSignedInt( numbers[ i ] ),
+            IotSerializer_ScalarSignedInt( -numbers[ i ] ),
+            IotSerializer_ScalarByteString( payload, i % 2 == 0 ? i : sizeof( payload ) )
+        };
+
+        memset( _buffer, 0, _BUFFER_SIZE );
+        memset( templateBuffer, 0, _BUFFER_SIZE );
+
+        expectedSize = _encodeWithEncoder( _buffer, values );
+
+        /* A NULL buffer only calculates the size. */
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_BUFFER_TOO_SMALL,
+                           IotSerializer_CborTemplateEncode( &cborTemplate, values, _TEMPLATE_SLOT_COUNT, NULL, 0, &encodedSize ) );
+        TEST_ASSERT_EQUAL( expectedSize, encodedSize );
+
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                           IotSerializer_CborTemplateEncode( &cborTemplate, values, _TEMPLATE_SLOT_COUNT,
+                                                             templateBuffer, _BUFFER_SIZE, &encodedSize ) );
+        TEST_ASSERT_EQUAL( expectedSize, encodedSize );
+        TEST_ASSERT_EQUAL_UINT8_ARRAY( _buffer, templateBuffer, expectedSize );
+    }
+}
+
+TEST( Serializer_Unit_CBOR, Template_buffer_too_small )
+{
+    IotSerializerCborTemplate_t cborTemplate;
+    uint8_t constants[ _BUFFER_SIZE ] = { 0 };
+    uint8_t payload[ 4 ] = { 0 };
+    size_t encodedSize = 0, constantsLength = 0;
+
+    IotSerializerScalarData_t values[ _TEMPLATE_SLOT_COUNT ] =
+    {
+        IotSerializer_ScalarSignedInt( 1 ),
+        IotSerializer_ScalarSignedInt( 1000 ),
+        IotSerializer_ScalarByteString( payload, sizeof( payload ) )
+    };
+
+    /* Creating without a buffer reports the size of the constants. */
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_BUFFER_TOO_SMALL, _createTemplate( &cborTemplate, NULL, 0 ) );
+    constantsLength = cborTemplate.constantsLength;
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_BUFFER_TOO_SMALL, _createTemplate( &cborTemplate, constants, constantsLength - 1 ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _createTemplate( &cborTemplate, constants, constantsLength ) );
+
+    /* Encoding into a short buffer reports the needed size. */
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_BUFFER_TOO_SMALL,
+                       IotSerializer_CborTemplateEncode( &cborTemplate, values, _TEMPLATE_SLOT_COUNT, _buffer, 5, &encodedSize ) );
+    TEST_ASSERT_EQUAL( _encodeWithEncoder( _buffer, values ), encodedSize );
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_BUFFER_TOO_SMALL,
+                       IotSerializer_CborTemplateEncode( &cborTemplate, values, _TEMPLATE_SLOT_COUNT, _buffer, encodedSize - 1, &encodedSize ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       IotSerializer_CborTemplateEncode( &cborTemplate, values, _TEMPLATE_SLOT_COUNT, _buffer, encodedSize, &encodedSize ) );
+}
+
+TEST( Serializer_Unit_CBOR, Template_invalid_values )
+{
+    IotSerializerCborTemplate_t cborTemplate;
+    uint8_t constants[ _BUFFER_SIZE ] = { 0 };
+    size_t encodedSize = 0;
+
+    IotSerializerScalarData_t values[ _TEMPLATE_SLOT_COUNT ] =
+    {
+        IotSerializer_ScalarSignedInt( 1 ),
+        IotSerializer_ScalarTextString( "not an integer" ),
+        IotSerializer_ScalarSignedInt( 1 )
+    };
+
+    const IotSerializerCborTemplateItem_t indefiniteMap[] =
+    {
+        IotSerializer_CborTemplateMap( IOT_SERIALIZER_INDEFINITE_LENGTH )
+    };
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _createTemplate( &cborTemplate, constants, sizeof( constants ) ) );
+
+    /* Wrong value count. */
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_INVALID_INPUT,
+                       IotSerializer_CborTemplateEncode( &cborTemplate, values, 1, _buffer, _BUFFER_SIZE, &encodedSize ) );
+
+    /* Value types not matching the slots. */
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_INVALID_INPUT,
+                       IotSerializer_CborTemplateEncode( &cborTemplate, values, _TEMPLATE_SLOT_COUNT, _buffer, _BUFFER_SIZE, &encodedSize ) );
+
+    /* Indefinite length containers cannot be pre-encoded. */
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_INVALID_INPUT,
+                       IotSerializer_CborTemplateCreate( &cborTemplate, indefiniteMap, 1, constants, sizeof( constants ) ) );
+}
+
+TEST( Serializer_Unit_CBOR, Template_reuse )
+{
+    IotSerializerCborTemplate_t cborTemplate;
+    uint8_t constants[ _BUFFER_SIZE ] = { 0 };
+    uint8_t templateBuffer[ _BUFFER_SIZE ] = { 0 };
+    uint8_t payload[ 16 ] = { 0 };
+    size_t encodedSize = 0, expectedSize = 0;
+    uint32_t i = 0;
+
+    IotSerializerScalarData_t values[ _TEMPLATE_SLOT_COUNT ] =
+    {
+        IotSerializer_ScalarSignedInt( 0 ),
+        IotSerializer_ScalarSignedInt( 0 ),
+        IotSerializer_ScalarByteString( payload, sizeof( payload ) )
+    };
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _createTemplate( &cborTemplate, constants, sizeof( constants ) ) );
+
+    /* One template encodes a sequence of messages, each matching the encoder. */
+    for( i = 0; i < _TEMPLATE_REUSE_COUNT; i++ )
+    {
+        values[ 0 ].value.u.signedInt = i;
+        expectedSize = _encodeWithEncoder( _buffer, values );
+
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                           IotSerializer_CborTemplateEncode( &cborTemplate, values, _TEMPLATE_SLOT_COUNT,
+                                                             templateBuffer, _BUFFER_SIZE, &encodedSize ) );
+        TEST_ASSERT_EQUAL( expectedSize, encodedSize );
+        TEST_ASSERT_EQUAL_UINT8_ARRAY( _buffer, templateBuffer, expectedSize );
+    }
+}
+
+TEST( Serializer_Unit_CBOR, Decoder_borrow_map )
+{
+    IotSerializerEncoderObject_t mapObject = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+    IotSerializerCborBorrowState_t outermostState, arrayState;
+    IotSerializerDecoderObject_t outermostObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t valueObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    uint8_t bytes[] = { 1, 2, 3, 4 };
+    size_t encodedSize = 0;
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _encoder.openContainer( &_encoderObject, &mapObject, 3 ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _encoder.appendKeyValue( &mapObject, "text", IotSerializer_ScalarTextString( "value" ) ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _encoder.appendKeyValue( &mapObject, "bytes", IotSerializer_ScalarByteString( bytes, sizeof( bytes ) ) ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _encoder.appendKeyValue( &mapObject, "number", IotSerializer_ScalarSignedInt( 300 ) ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _encoder.closeContainer( &_encoderObject, &mapObject ) );
+
+    encodedSize = _encoder.getEncodedSize( &_encoderObject, _buffer );
+
+    /* --- Verification --- */
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       IotSerializer_CborBorrowInit( &outermostState, &outermostObject, _buffer, encodedSize ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_CONTAINER_MAP, outermostObject.type );
+
+    /* Strings point into the decoded buffer. */
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       IotSerializer_CborBorrowFind( &outermostObject, "text", NULL, &valueObject ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SCALAR_TEXT_STRING, valueObject.type );
+    TEST_ASSERT_EQUAL( 5, valueObject.u.value.u.string.length );
+    TEST_ASSERT_EQUAL( 0, memcmp( "value", valueObject.u.value.u.string.pString, 5 ) );
+    TEST_ASSERT_TRUE( ( valueObject.u.value.u.string.pString > _buffer ) &&
+                      ( valueObject.u.value.u.string.pString < _buffer + encodedSize ) );
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       IotSerializer_CborBorrowFind( &outermostObject, "bytes", NULL, &valueObject ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SCALAR_BYTE_STRING, valueObject.type );
+    TEST_ASSERT_EQUAL( sizeof( bytes ), valueObject.u.value.u.string.length );
+    TEST_ASSERT_EQUAL( 0, memcmp( bytes, valueObject.u.value.u.string.pString, sizeof( bytes ) ) );
+    TEST_ASSERT_TRUE( ( valueObject.u.value.u.string.pString > _buffer ) &&
+                      ( valueObject.u.value.u.string.pString < _buffer + encodedSize ) );
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       IotSerializer_CborBorrowFind( &outermostObject, "number", &arrayState, &valueObject ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SCALAR_SIGNED_INT, valueObject.type );
+    TEST_ASSERT_EQUAL( 300, valueObject.u.value.u.signedInt );
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_NOT_FOUND,
+                       IotSerializer_CborBorrowFind( &outermostObject, "missing", NULL, &valueObject ) );
+
+    /* Destroying a borrowed object is valid and frees nothing. */
+    _decoder.destroy( &outermostObject );
+    TEST_ASSERT_NULL( outermostObject.u.pHandle );
+}
+
+TEST( Serializer_Unit_CBOR, Decoder_borrow_array )
+{
+    uint8_t i = 0;
+    IotSerializerEncoderObject_t mapObject = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+    IotSerializerEncoderObject_t arrayObject = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_ARRAY;
+    IotSerializerCborBorrowState_t outermostState, arrayState, iteratorState;
+    IotSerializerDecoderObject_t outermostObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t arrayDecoderObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t valueObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderIterator_t iterator = IOT_SERIALIZER_DECODER_ITERATOR_INITIALIZER;
+    const char * strings[] = { "a", "bb", "ccc" };
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _encoder.openContainer( &_encoderObject, &mapObject, 1 ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _encoder.openContainerWithKey( &mapObject, "array", &arrayObject, 3 ) );
+
+    for( i = 0; i < 3; i++ )
+    {
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                           _encoder.append( &arrayObject, IotSerializer_ScalarTextString( strings[ i ] ) ) );
+    }
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _encoder.closeContainer( &mapObject, &arrayObject ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _encoder.closeContainer( &_encoderObject, &mapObject ) );
+
+    /* --- Verification --- */
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       IotSerializer_CborBorrowInit( &outermostState, &outermostObject, _buffer, _BUFFER_SIZE ) );
+
+    /* A container value needs a state. */
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_INVALID_INPUT,
+                       IotSerializer_CborBorrowFind( &outermostObject, "array", NULL, &arrayDecoderObject ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       IotSerializer_CborBorrowFind( &outermostObject, "array", &arrayState, &arrayDecoderObject ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_CONTAINER_ARRAY, arrayDecoderObject.type );
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       IotSerializer_CborBorrowStepIn( &arrayDecoderObject, &iteratorState, &iterator ) );
+
+    for( i = 0; i < 3; i++ )
+    {
+        TEST_ASSERT_TRUE( !_decoder.isEndOfContainer( iterator ) );
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                           IotSerializer_CborBorrowGet( iterator, NULL, &valueObject ) );
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SCALAR_TEXT_STRING, valueObject.type );
+        TEST_ASSERT_EQUAL( strlen( strings[ i ] ), valueObject.u.value.u.string.length );
+        TEST_ASSERT_EQUAL( 0, memcmp( strings[ i ], valueObject.u.value.u.string.pString, strlen( strings[ i ] ) ) );
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _decoder.next( iterator ) );
+    }
+
+    TEST_ASSERT_TRUE( _decoder.isEndOfContainer( iterator ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _decoder.stepOut( iterator, &arrayDecoderObject ) );
+
+    _decoder.destroy( &arrayDecoderObject );
+    _decoder.destroy( &outermostObject );
+}
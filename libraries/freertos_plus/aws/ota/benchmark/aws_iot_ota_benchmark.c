@@ -0,0 +1,664 @@
+/*
+ * FreeRTOS OTA V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_iot_ota_benchmark.c
+ * @brief Measure OTA download throughput on a host.
+ *
+ * Runs complete OTA jobs through the agent, with the MQTT data path answered by
+ * the loopback and the image written to RAM, and prints one row per block size.
+ * Block sizes are rounded by the agent as for any xSelectBlockSize callback, and
+ * the row shows the size that was used.
+ * The request and window settings are fixed when the benchmark is built.
+ *
+ * Usage: aws_iot_ota_benchmark [-l latency_ms] [-r rate_KBps] [-p loss_%]
+ *                              [-d duplicate_%] [-o reorder_%] [-s seed]
+ *                              [-z image_bytes] [-b block_bytes[,block_bytes...]]
+ *                              [-n runs] [-c] [-Z] [-t] [-v]
+ *
+ * -c delivers blocks without a receive buffer so the agent copies every block.
+ * -Z sends the image as a compressed file, stored as literals, so it is processed in order.
+ * -t fails a run that needed the request timer, seen as a stream request sent after no
+ *    block reached the agent for a whole request timer period.
+ */
+
+/* Standard includes. */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* OTA includes. */
+#include "aws_iot_ota_agent.h"
+#include "aws_iot_ota_pal.h"
+#include "aws_ota_agent_config.h"
+#include "aws_application_version.h"
+
+/* The compressed format, for -Z. */
+#include "aws_iot_ota_decompress.h"
+
+/* Test utilities. */
+#include "wait_for_event.h"
+
+#include "aws_iot_ota_benchmark_loopback.h"
+
+#define BENCH_THING_NAME           "ota_benchmark"
+#define BENCH_MAX_BLOCK_SIZES      8U
+#define BENCH_JOB_DOC_SIZE         1024U
+#define BENCH_INIT_WAIT_MS         5000U
+#define BENCH_SHUTDOWN_WAIT_MS     5000U
+#define BENCH_RUN_TIMEOUT_MS       120000U
+#define BENCH_DEFAULT_IMAGE_SIZE   ( 128U * 1024U )
+
+/* How a run ended. */
+
+typedef enum
+{
+    eBenchResult_Activated = 0, /* The image was received, verified and activated. */
+    eBenchResult_Failed,        /* The agent reported the job as failed. */
+    eBenchResult_Corrupt,       /* The image was activated but did not match the original. */
+    eBenchResult_Timeout,       /* The job did not finish in time. */
+    eBenchResult_Skipped,       /* The run could not be started. */
+    eBenchResult_Stalled        /* The image was activated but the request timer had to fire (-t). */
+} BenchResult_t;
+
+/* Measurements of one run. */
+
+typedef struct
+{
+    BenchResult_t eResult;
+    uint64_t ullStartUs;           /* When the agent was started. */
+    uint64_t ullActivateUs;        /* When the new image was activated. */
+    uint32_t ulBlockSize;          /* Block size the agent chose for the file. */
+    uint64_t ullBytesWritten;      /* Bytes written through the PAL. */
+    uint32_t ulBlockWrites;        /* Calls to prvPAL_WriteBlock(). */
+    uint32_t ulPacketsDropped;     /* Packets the agent could not queue. */
+    OTA_BenchmarkLinkStats_t xLink;
+} BenchRun_t;
+
+/* Run one OTA job and fill in its measurements. */
+
+static void prvRunJob( const OTA_BenchmarkLink_t * pxLink,
+                       uint32_t ulBlockSize,
+                       uint32_t ulRunIndex,
+                       BenchRun_t * pxRun );
+
+/* Print the header and the row for a set of runs with the same settings. */
+
+static void prvPrintHeader( void );
+static void prvPrintRow( const BenchRun_t * pxRuns,
+                         uint32_t ulNumRuns );
+
+/* Build the compressed file sent for the image. */
+
+static bool prvCompressImage( void );
+
+/* Block size the agent should use for the next file. */
+
+static uint32_t prvSelectBlockSize( const OTA_FileContext_t * C );
+
+/* Agent job completion callback. */
+
+static void prvJobComplete( OTA_JobEvent_t eEvent );
+
+/* Application version reported to the agent. */
+
+const AppVersion32_t xAppFirmwareVersion =
+{
+    .u.x.ucMajor = APP_VERSION_MAJOR,
+    .u.x.ucMinor = APP_VERSION_MINOR,
+    .u.x.usBuild = APP_VERSION_BUILD,
+};
+
+/* The signature key the job documents use. The RAM PAL does not check it. */
+
+const char cOTA_JSON_FileSignatureKey[ OTA_FILE_SIG_KEY_STR_MAX_LENGTH ] = "sig-sha256-ecdsa";
+
+/* Job document template. Fill in the job ID, the file size and the keys of a compressed file. */
+
+static const char pcJobTemplate[] =
+    "{\"clientToken\":\"0:" BENCH_THING_NAME "\",\"timestamp\":1,\"execution\":{"
+    "\"jobId\":\"bench-%u\",\"status\":\"QUEUED\",\"queuedAt\":1,\"lastUpdatedAt\":1,\"versionNumber\":1,\"executionNumber\":1,"
+    "\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"bench\",\"files\":[{"
+    "\"filepath\":\"bench.bin\",\"filesize\":%u,\"fileid\":0,\"certfile\":\"bench.crt\","
+    "\"sig-sha256-ecdsa\":\"AAAA\"%s}]}}}}";
+
+static const char pcCompressedKeys[] = ",\"compression\":1,\"imagesize\":%u";
+
+/* Benchmark state shared with the RAM PAL and the callbacks. */
+
+static uint8_t * pucSourceImage = NULL;
+static uint32_t ulSourceImageSize = BENCH_DEFAULT_IMAGE_SIZE;
+static uint8_t * pucSentFile = NULL;      /* The file served, the source image unless it is compressed. */
+static uint32_t ulSentFileSize = 0;
+static bool bCompressed = false;
+static bool bRequireNoTimer = false;
+static uint8_t * pucReceivedImage = NULL;
+static uint32_t ulRequestedBlockSize = 0;
+static struct event * pxJobDone = NULL;
+static BenchRun_t * pxCurrentRun = NULL;
+static bool bVerbose = false;
+
+/*-----------------------------------------------------------*/
+
+void vLoggingPrintf( char const * pcFormat,
+                     ... )
+{
+    va_list xArgs;
+
+    if( bVerbose == true )
+    {
+        va_start( xArgs, pcFormat );
+        ( void ) vprintf( pcFormat, xArgs );
+        va_end( xArgs );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_Err_t prvPAL_Abort( OTA_FileContext_t * const C )
+{
+    free( pucReceivedImage );
+    pucReceivedImage = NULL;
+    C->pucFile = NULL;
+
+    return kOTA_Err_None;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_Err_t prvPAL_CreateFileForRx( OTA_FileContext_t * const C )
+{
+    OTA_Err_t xResult = kOTA_Err_RxFileCreateFailed;
+
+    free( pucReceivedImage );
+    pucReceivedImage = calloc( 1, C->ulImageSize );
+
+    if( pucReceivedImage != NULL )
+    {
+        C->pucFile = pucReceivedImage;
+        xResult = kOTA_Err_None;
+
+        if( pxCurrentRun != NULL )
+        {
+            pxCurrentRun->ulBlockSize = C->ulBlockSize;
+        }
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_Err_t prvPAL_CloseFile( OTA_FileContext_t * const C )
+{
+    OTA_Err_t xResult = kOTA_Err_None;
+
+    /* Stand in for the signature check by comparing with the image that was sent. */
+    if( ( pucReceivedImage == NULL ) || ( C->ulImageSize != ulSourceImageSize ) ||
+        ( memcmp( pucReceivedImage, pucSourceImage, ulSourceImageSize ) != 0 ) )
+    {
+        xResult = kOTA_Err_SignatureCheckFailed;
+
+        if( pxCurrentRun != NULL )
+        {
+            pxCurrentRun->eResult = eBenchResult_Corrupt;
+        }
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+int16_t prvPAL_WriteBlock( OTA_FileContext_t * const C,
+                           uint32_t ulOffset,
+                           uint8_t * const pcData,
+                           uint32_t ulBlockSize )
+{
+    int16_t sResult = -1;
+
+    if( ( pucReceivedImage != NULL ) && ( ulOffset <= C->ulImageSize ) && ( ulBlockSize <= ( C->ulImageSize - ulOffset ) ) )
+    {
+        memcpy( &pucReceivedImage[ ulOffset ], pcData, ulBlockSize );
+        sResult = ( int16_t ) ulBlockSize;
+
+        if( pxCurrentRun != NULL )
+        {
+            pxCurrentRun->ullBytesWritten += ulBlockSize;
+            pxCurrentRun->ulBlockWrites++;
+        }
+    }
+
+    return sResult;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_Err_t prvPAL_ActivateNewImage( void )
+{
+    if( ( pxCurrentRun != NULL ) && ( pxCurrentRun->eResult == eBenchResult_Timeout ) )
+    {
+        pxCurrentRun->ullActivateUs = OTA_Benchmark_NowUs();
+        pxCurrentRun->eResult = eBenchResult_Activated;
+    }
+
+    event_signal( pxJobDone );
+
+    return kOTA_Err_None;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_Err_t prvPAL_ResetDevice( void )
+{
+    return kOTA_Err_None;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_Err_t prvPAL_SetPlatformImageState( OTA_ImageState_t eState )
+{
+    ( void ) eState;
+
+    return kOTA_Err_None;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_PAL_ImageState_t prvPAL_GetPlatformImageState( void )
+{
+    return eOTA_PAL_ImageState_Valid;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvCompressImage( void )
+{
+    uint32_t ulHeader[ OTA_DECOMPRESS_HEADER_SIZE / sizeof( uint32_t ) ];
+    uint32_t ulIndex;
+    uint32_t ulOut = OTA_DECOMPRESS_HEADER_SIZE;
+    uint32_t ulItems;
+
+    /* One flag byte for every 8 literal bytes. */
+    pucSentFile = malloc( OTA_DECOMPRESS_HEADER_SIZE + ulSourceImageSize + ( ( ulSourceImageSize + 7U ) / 8U ) );
+
+    if( pucSentFile != NULL )
+    {
+        /* The host is little endian like the format. */
+        memcpy( ulHeader, "OTAZ", 4 );
+        ulHeader[ 1 ] = OTA_DECOMPRESS_FORMAT_VERSION;
+        ulHeader[ 2 ] = 1024U; /* The agent's default window, so the image is written in large pieces. */
+        ulHeader[ 3 ] = ulSourceImageSize;
+        memcpy( pucSentFile, ulHeader, OTA_DECOMPRESS_HEADER_SIZE );
+
+        for( ulIndex = 0; ulIndex < ulSourceImageSize; ulIndex += ulItems )
+        {
+            ulItems = ( ( ulSourceImageSize - ulIndex ) < 8U ) ? ( ulSourceImageSize - ulIndex ) : 8U;
+            pucSentFile[ ulOut++ ] = ( uint8_t ) ( ( 1U << ulItems ) - 1U );
+            memcpy( &pucSentFile[ ulOut ], &pucSourceImage[ ulIndex ], ulItems );
+            ulOut += ulItems;
+        }
+
+        ulSentFileSize = ulOut;
+    }
+
+    return pucSentFile != NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvSelectBlockSize( const OTA_FileContext_t * C )
+{
+    ( void ) C;
+
+    return ulRequestedBlockSize;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvJobComplete( OTA_JobEvent_t eEvent )
+{
+    if( eEvent == eOTA_JobEvent_Activate )
+    {
+        ( void ) OTA_ActivateNewImage();
+    }
+    else if( eEvent == eOTA_JobEvent_Fail )
+    {
+        if( ( pxCurrentRun != NULL ) && ( pxCurrentRun->eResult == eBenchResult_Timeout ) )
+        {
+            pxCurrentRun->eResult = eBenchResult_Failed;
+        }
+
+        event_signal( pxJobDone );
+    }
+    else
+    {
+        /* Self test events don't happen in the benchmark. */
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvRunJob( const OTA_BenchmarkLink_t * pxLink,
+                       uint32_t ulBlockSize,
+                       uint32_t ulRunIndex,
+                       BenchRun_t * pxRun )
+{
+    static char pcJobDocument[ BENCH_JOB_DOC_SIZE ];
+    char pcFileKeys[ sizeof( pcCompressedKeys ) + 10U ] = "";
+    OTA_ConnectionContext_t xConnection = { 0 };
+    OTA_PAL_Callbacks_t xCallbacks = { 0 };
+
+    memset( pxRun, 0, sizeof( BenchRun_t ) );
+    pxRun->eResult = eBenchResult_Timeout;
+    pxCurrentRun = pxRun;
+    ulRequestedBlockSize = ulBlockSize;
+
+    if( bCompressed == true )
+    {
+        ( void ) snprintf( pcFileKeys, sizeof( pcFileKeys ), pcCompressedKeys, ulSourceImageSize );
+    }
+
+    ( void ) snprintf( pcJobDocument, sizeof( pcJobDocument ), pcJobTemplate, ulRunIndex, ulSentFileSize, pcFileKeys );
+
+    xCallbacks.xCompleteCallback = prvJobComplete;
+    xCallbacks.xSelectBlockSize = prvSelectBlockSize;
+
+    if( OTA_Benchmark_LinkStart( pxLink, pucSentFile, ulSentFileSize, pcJobDocument ) == false )
+    {
+        pxRun->eResult = eBenchResult_Skipped;
+    }
+    else
+    {
+        pxRun->ullStartUs = OTA_Benchmark_NowUs();
+
+        /* The agent task is a thread that may already have left the ready state
+         * when init returns, so only a stopped agent failed to start. */
+        if( OTA_AgentInit_internal( &xConnection,
+                                    ( const uint8_t * ) BENCH_THING_NAME,
+                                    &xCallbacks,
+                                    pdMS_TO_TICKS( BENCH_INIT_WAIT_MS ) ) == eOTA_AgentState_Stopped )
+        {
+            pxRun->eResult = eBenchResult_Skipped;
+        }
+        else
+        {
+            ( void ) event_wait_timed( pxJobDone, BENCH_RUN_TIMEOUT_MS );
+            pxRun->ulPacketsDropped = OTA_GetPacketsDropped();
+        }
+
+        /* Stop the link first so nothing is delivered while the agent shuts down. */
+        OTA_Benchmark_LinkStop( &pxRun->xLink );
+        ( void ) OTA_AgentShutdown( pdMS_TO_TICKS( BENCH_SHUTDOWN_WAIT_MS ) );
+
+        if( ( bRequireNoTimer == true ) && ( pxRun->eResult == eBenchResult_Activated ) &&
+            ( pxRun->xLink.ulMomentumEvents > 0U ) )
+        {
+            pxRun->eResult = eBenchResult_Stalled;
+        }
+    }
+
+    pxCurrentRun = NULL;
+    free( pucReceivedImage );
+    pucReceivedImage = NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintHeader( void )
+{
+    printf( "%6s %6s %6s %6s %9s %9s %9s %9s %9s %6s %6s %6s %6s %9s %9s  %s\n",
+            "window", "req", "block", "blocks", "ms", "blocks/s", "KB/s",
+            "copyB/blk", "writB/blk", "reqs", "momnt", "maxmom", "drop",
+            "first ms", "activ ms", "result" );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintRow( const BenchRun_t * pxRuns,
+                         uint32_t ulNumRuns )
+{
+    static const char * const pcResults[] = { "ok", "failed", "corrupt", "timeout", "skipped", "stalled" };
+    uint64_t ullTotalUs = 0, ullFirstUs = 0, ullCopied = 0, ullWritten = 0;
+    uint32_t ulBlocks = 0, ulWrites = 0, ulRequests = 0, ulMomentum = 0, ulMaxMomentum = 0, ulDropped = 0;
+    uint32_t ulIndex, ulGood = 0, ulBlockSize = 0;
+    const char * pcResult = pcResults[ eBenchResult_Activated ];
+    double dSeconds;
+
+    for( ulIndex = 0; ulIndex < ulNumRuns; ulIndex++ )
+    {
+        if( pxRuns[ ulIndex ].eResult == eBenchResult_Activated )
+        {
+            ulGood++;
+            ullTotalUs += pxRuns[ ulIndex ].ullActivateUs - pxRuns[ ulIndex ].ullStartUs;
+
+            if( pxRuns[ ulIndex ].xLink.ullFirstRequestUs != 0U )
+            {
+                ullFirstUs += pxRuns[ ulIndex ].xLink.ullFirstRequestUs - pxRuns[ ulIndex ].ullStartUs;
+            }
+        }
+        else
+        {
+            pcResult = pcResults[ pxRuns[ ulIndex ].eResult ];
+        }
+
+        if( pxRuns[ ulIndex ].ulBlockSize != 0U )
+        {
+            ulBlockSize = pxRuns[ ulIndex ].ulBlockSize;
+        }
+
+        ulBlocks += pxRuns[ ulIndex ].xLink.ulBlocksQueued;
+        ullCopied += pxRuns[ ulIndex ].xLink.ullBytesCopied;
+        ullWritten += pxRuns[ ulIndex ].ullBytesWritten;
+        ulWrites += pxRuns[ ulIndex ].ulBlockWrites;
+        ulRequests += pxRuns[ ulIndex ].xLink.ulStreamRequests;
+        ulMomentum += pxRuns[ ulIndex ].xLink.ulMomentumEvents;
+        ulDropped += pxRuns[ ulIndex ].ulPacketsDropped;
+
+        if( pxRuns[ ulIndex ].xLink.ulMaxMomentum > ulMaxMomentum )
+        {
+            ulMaxMomentum = pxRuns[ ulIndex ].xLink.ulMaxMomentum;
+        }
+    }
+
+    /* Rates and times are averaged over the runs that activated. */
+    dSeconds = ( ulGood > 0U ) ? ( ( double ) ullTotalUs / 1e6 ) : 0.0;
+
+    printf( "%6u %6u %6u %6u %9.1f %9.1f %9.1f %9.1f %9.1f %6u %6u %6u %6u %9.1f %9.1f  %s\n",
+            ( unsigned ) otaconfigMQTT_REQUEST_WINDOW_BLOCKS,
+            ( unsigned ) otaconfigMAX_NUM_BLOCKS_REQUEST,
+            ulBlockSize,
+            ( ulBlockSize > 0U ) ? ( ( ulSentFileSize + ulBlockSize - 1U ) / ulBlockSize ) : 0U,
+            ( ulGood > 0U ) ? ( ( double ) ullTotalUs / 1000.0 / ulGood ) : 0.0,
+            ( dSeconds > 0.0 ) ? ( ( double ) ulWrites / dSeconds ) : 0.0,
+            ( dSeconds > 0.0 ) ? ( ( double ) ullWritten / 1024.0 / dSeconds ) : 0.0,
+            ( ulBlocks > 0U ) ? ( ( double ) ullCopied / ulBlocks ) : 0.0,
+            ( ulWrites > 0U ) ? ( ( double ) ullWritten / ulWrites ) : 0.0,
+            ulRequests / ulNumRuns,
+            ulMomentum / ulNumRuns,
+            ulMaxMomentum,
+            ulDropped / ulNumRuns,
+            ( ulGood > 0U ) ? ( ( double ) ullFirstUs / 1000.0 / ulGood ) : 0.0,
+            ( ulGood > 0U ) ? ( ( double ) ullTotalUs / 1000.0 / ulGood ) : 0.0,
+            pcResult );
+    ( void ) fflush( stdout );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    OTA_BenchmarkLink_t xLink = { 0 };
+    uint32_t ulBlockSizes[ BENCH_MAX_BLOCK_SIZES ] = { 256U, 1024U, 4096U };
+    uint32_t ulNumBlockSizes = 3;
+    uint32_t ulNumRuns = 3;
+    uint32_t ulSize, ulRun, ulIndex;
+    BenchRun_t * pxRuns;
+    char * pcToken;
+    int iOption;
+    int iResult = 0;
+
+    xLink.ulLatencyMs = 20U;
+    xLink.ulRateKBps = 0U;
+    xLink.ulSeed = 1U;
+
+    while( ( iOption = getopt( argc, argv, "l:r:p:d:o:s:z:b:n:cZtv" ) ) != -1 )
+    {
+        switch( iOption )
+        {
+            case 'l':
+                xLink.ulLatencyMs = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'r':
+                xLink.ulRateKBps = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'p':
+                xLink.ulLossPercent = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'd':
+                xLink.ulDuplicatePercent = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'o':
+                xLink.ulReorderPercent = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 's':
+                xLink.ulSeed = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'z':
+                ulSourceImageSize = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'b':
+                ulNumBlockSizes = 0;
+
+                for( pcToken = strtok( optarg, "," ); ( pcToken != NULL ) && ( ulNumBlockSizes < BENCH_MAX_BLOCK_SIZES ); pcToken = strtok( NULL, "," ) )
+                {
+                    ulBlockSizes[ ulNumBlockSizes++ ] = ( uint32_t ) strtoul( pcToken, NULL, 0 );
+                }
+
+                break;
+
+            case 'n':
+                ulNumRuns = ( uint32_t ) strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'c':
+                xLink.bCopyPayload = true;
+                break;
+
+            case 'Z':
+                bCompressed = true;
+                break;
+
+            case 't':
+                bRequireNoTimer = true;
+                break;
+
+            case 'v':
+                bVerbose = true;
+                break;
+
+            default:
+                iResult = 1;
+                break;
+        }
+    }
+
+    if( ( iResult != 0 ) || ( ulSourceImageSize == 0U ) || ( ulNumRuns == 0U ) || ( ulNumBlockSizes == 0U ) )
+    {
+        fprintf( stderr, "usage: %s [-l latency_ms] [-r rate_KBps] [-p loss_%%] [-d duplicate_%%] [-o reorder_%%]\n"
+                         "       [-s seed] [-z image_bytes] [-b block_bytes,...] [-n runs] [-c] [-Z] [-t] [-v]\n", argv[ 0 ] );
+        iResult = 1;
+    }
+
+    if( iResult == 0 )
+    {
+        pucSourceImage = malloc( ulSourceImageSize );
+        pxRuns = calloc( ulNumRuns, sizeof( BenchRun_t ) );
+        pxJobDone = event_create();
+
+        if( ( pucSourceImage == NULL ) || ( pxRuns == NULL ) || ( pxJobDone == NULL ) )
+        {
+            fprintf( stderr, "Out of memory.\n" );
+            iResult = 1;
+        }
+    }
+
+    if( iResult == 0 )
+    {
+        for( ulIndex = 0; ulIndex < ulSourceImageSize; ulIndex++ )
+        {
+            pucSourceImage[ ulIndex ] = ( uint8_t ) ( ( ulIndex * 31U ) ^ ( ulIndex >> 8 ) );
+        }
+
+        pucSentFile = pucSourceImage;
+        ulSentFileSize = ulSourceImageSize;
+
+        if( ( bCompressed == true ) && ( prvCompressImage() == false ) )
+        {
+            fprintf( stderr, "Out of memory.\n" );
+            iResult = 1;
+        }
+    }
+
+    if( iResult == 0 )
+    {
+        printf( "image %u bytes%s, latency %u ms, rate %u KB/s, loss %u%%, duplicate %u%%, reorder %u%%, %s, %u runs\n",
+                ulSourceImageSize, ( bCompressed == true ) ? " compressed" : "", xLink.ulLatencyMs, xLink.ulRateKBps,
+                xLink.ulLossPercent, xLink.ulDuplicatePercent, xLink.ulReorderPercent,
+                ( xLink.bCopyPayload == true ) ? "copied blocks" : "zero copy blocks", ulNumRuns );
+        prvPrintHeader();
+
+        for( ulSize = 0; ulSize < ulNumBlockSizes; ulSize++ )
+        {
+            for( ulRun = 0; ulRun < ulNumRuns; ulRun++ )
+            {
+                prvRunJob( &xLink, ulBlockSizes[ ulSize ], ( ulSize * ulNumRuns ) + ulRun, &pxRuns[ ulRun ] );
+
+                if( pxRuns[ ulRun ].eResult != eBenchResult_Activated )
+                {
+                    iResult = 1;
+                }
+            }
+
+            prvPrintRow( pxRuns, ulNumRuns );
+        }
+    }
+
+    return iResult;
+}
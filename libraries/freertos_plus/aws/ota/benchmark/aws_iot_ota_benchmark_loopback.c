@@ -0,0 +1,770 @@
+/*
+ * FreeRTOS OTA V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_iot_ota_benchmark_loopback.c
+ * @brief An in-process MQTT broker, jobs service and stream service for the OTA benchmark.
+ */
+
+/* Standard includes. */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* MQTT include. */
+#include "iot_mqtt.h"
+
+/* OTA includes. */
+#include "aws_iot_ota_agent.h"
+#include "aws_ota_agent_config.h"
+
+/* CBOR include. */
+#include "cbor.h"
+
+#include "aws_iot_ota_benchmark_loopback.h"
+
+#define BENCH_MAX_SUBSCRIPTIONS    8U    /* The agent holds at most three subscriptions. */
+#define BENCH_MAX_TOPIC_LEN        256U  /* Longest topic or topic filter. */
+#define BENCH_MAX_BITMAP_SIZE      128U  /* Largest block bitmap in a stream request. */
+#define BENCH_CBOR_OVERHEAD        32U   /* Room for the block message keys and integers. */
+#define BENCH_REORDER_MAX_BLOCKS   4U    /* A reordered block is held back by up to this many block times. */
+
+/* A subscription of the agent. */
+
+typedef struct BenchSubscription
+{
+    bool bInUse;
+    char pcTopicFilter[ BENCH_MAX_TOPIC_LEN ];
+    IotMqttCallbackInfo_t xCallback;
+} BenchSubscription_t;
+
+/* A message on its way to the agent. */
+
+typedef struct BenchMessage
+{
+    struct BenchMessage * pxNext;
+    uint64_t ullArrivalUs;                 /* When the message reaches the device. */
+    char pcTopic[ BENCH_MAX_TOPIC_LEN ];
+    uint8_t * pucPayload;                  /* Allocated, handed to the agent as the receive buffer. */
+    size_t xPayloadLength;
+    bool bIsBlock;                         /* False for the job document. */
+} BenchMessage_t;
+
+/* Take a subscription matching the topic. Filters are matched exactly. */
+
+static BenchSubscription_t * prvFindSubscription( const char * pcTopic,
+                                                  size_t xTopicLength );
+
+/* Queue a message in arrival order. Messages arriving together keep the order they were queued in. */
+
+static void prvQueueMessage( BenchMessage_t * pxMessage );
+
+/* Answer a "get next job" request with the job document. */
+
+static void prvServeJobRequest( const IotMqttPublishInfo_t * pxPublishInfo );
+
+/* Answer a stream request with the requested blocks. */
+
+static void prvServeStreamRequest( const IotMqttPublishInfo_t * pxPublishInfo );
+
+/* Build a block message and put it on the link. */
+
+static void prvSendBlock( const char * pcDataTopic,
+                          int32_t lFileId,
+                          uint32_t ulBlockId,
+                          uint32_t ulBlockSize,
+                          uint64_t ullRequestArrivalUs );
+
+/* Deliver messages to the agent as they arrive. */
+
+static void * prvDeliveryThread( void * pvUnused );
+
+/* Pseudo random number for the link decisions. */
+
+static uint32_t prvRandom( void );
+
+/* Returns true if the string ends with the suffix. */
+
+static bool prvEndsWith( const char * pcString,
+                         size_t xLength,
+                         const char * pcSuffix );
+
+/* Loopback state. xLock protects everything below it. */
+
+static pthread_mutex_t xLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xChanged;
+static pthread_t xDeliveryThread;
+static bool bRunning = false;
+static OTA_BenchmarkLink_t xLink;
+static const uint8_t * pucImage = NULL;
+static uint32_t ulImageSize = 0;
+static const char * pcJobDocument = NULL;
+static bool bJobSent = false;
+static BenchSubscription_t xSubscriptions[ BENCH_MAX_SUBSCRIPTIONS ];
+static BenchMessage_t * pxPendingMessages = NULL;
+static uint64_t ullLinkFreeUs = 0;             /* When the sending side of the link is next idle. */
+static uint32_t ulRandomState = 1;
+static uint64_t ullLastQueuedUs = 0;           /* When a block last reached the agent. */
+static uint32_t ulMomentum = 0;
+static OTA_BenchmarkLinkStats_t xStats;
+
+/*-----------------------------------------------------------*/
+
+uint64_t OTA_Benchmark_NowUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000ULL ) + ( ( uint64_t ) xNow.tv_nsec / 1000ULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvRandom( void )
+{
+    ulRandomState ^= ulRandomState << 13;
+    ulRandomState ^= ulRandomState >> 17;
+    ulRandomState ^= ulRandomState << 5;
+
+    return ulRandomState;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvEndsWith( const char * pcString,
+                         size_t xLength,
+                         const char * pcSuffix )
+{
+    size_t xSuffixLength = strlen( pcSuffix );
+
+    return ( xLength >= xSuffixLength ) &&
+           ( memcmp( &pcString[ xLength - xSuffixLength ], pcSuffix, xSuffixLength ) == 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+static BenchSubscription_t * prvFindSubscription( const char * pcTopic,
+                                                  size_t xTopicLength )
+{
+    BenchSubscription_t * pxFound = NULL;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ( ulIndex < BENCH_MAX_SUBSCRIPTIONS ) && ( pxFound == NULL ); ulIndex++ )
+    {
+        if( ( xSubscriptions[ ulIndex ].bInUse == true ) &&
+            ( strlen( xSubscriptions[ ulIndex ].pcTopicFilter ) == xTopicLength ) &&
+            ( memcmp( xSubscriptions[ ulIndex ].pcTopicFilter, pcTopic, xTopicLength ) == 0 ) )
+        {
+            pxFound = &xSubscriptions[ ulIndex ];
+        }
+    }
+
+    return pxFound;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvQueueMessage( BenchMessage_t * pxMessage )
+{
+    BenchMessage_t ** ppxLink = &pxPendingMessages;
+
+    while( ( *ppxLink != NULL ) && ( ( *ppxLink )->ullArrivalUs <= pxMessage->ullArrivalUs ) )
+    {
+        ppxLink = &( ( *ppxLink )->pxNext );
+    }
+
+    pxMessage->pxNext = *ppxLink;
+    *ppxLink = pxMessage;
+
+    ( void ) pthread_cond_signal( &xChanged );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvServeJobRequest( const IotMqttPublishInfo_t * pxPublishInfo )
+{
+    BenchMessage_t * pxMessage;
+    size_t xLength = strlen( pcJobDocument );
+
+    /* Only the first request gets the job. Later ones are left unanswered. */
+    if( ( bJobSent == false ) && ( pxPublishInfo->topicNameLength + sizeof( "/accepted" ) <= BENCH_MAX_TOPIC_LEN ) )
+    {
+        pxMessage = calloc( 1, sizeof( BenchMessage_t ) );
+
+        if( pxMessage != NULL )
+        {
+            pxMessage->pucPayload = malloc( xLength );
+        }
+
+        if( ( pxMessage != NULL ) && ( pxMessage->pucPayload != NULL ) )
+        {
+            memcpy( pxMessage->pcTopic, pxPublishInfo->pTopicName, pxPublishInfo->topicNameLength );
+            strcpy( &pxMessage->pcTopic[ pxPublishInfo->topicNameLength ], "/accepted" );
+            memcpy( pxMessage->pucPayload, pcJobDocument, xLength );
+            pxMessage->xPayloadLength = xLength;
+            pxMessage->bIsBlock = false;
+            pxMessage->ullArrivalUs = OTA_Benchmark_NowUs() + ( 2ULL * xLink.ulLatencyMs * 1000ULL );
+            prvQueueMessage( pxMessage );
+            bJobSent = true;
+        }
+        else if( pxMessage != NULL )
+        {
+            free( pxMessage );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSendBlock( const char * pcDataTopic,
+                          int32_t lFileId,
+                          uint32_t ulBlockId,
+                          uint32_t ulBlockSize,
+                          uint64_t ullRequestArrivalUs )
+{
+    BenchMessage_t * pxMessage;
+    BenchMessage_t * pxDuplicate;
+    CborEncoder xEncoder, xMapEncoder;
+    CborError xError = CborNoError;
+    uint32_t ulOffset = ulBlockId * ulBlockSize;
+    uint32_t ulLength = ulImageSize - ulOffset;
+    size_t xBufferSize;
+    uint64_t ullSendUs;
+    uint64_t ullTransmitUs = 0;
+
+    if( ulLength > ulBlockSize )
+    {
+        ulLength = ulBlockSize;
+    }
+
+    xBufferSize = ulLength + BENCH_CBOR_OVERHEAD;
+    pxMessage = calloc( 1, sizeof( BenchMessage_t ) );
+
+    if( pxMessage != NULL )
+    {
+        pxMessage->pucPayload = malloc( xBufferSize );
+    }
+
+    if( ( pxMessage != NULL ) && ( pxMessage->pucPayload != NULL ) )
+    {
+        cbor_encoder_init( &xEncoder, pxMessage->pucPayload, xBufferSize, 0 );
+        xError |= cbor_encoder_create_map( &xEncoder, &xMapEncoder, 4 );
+        xError |= cbor_encode_text_stringz( &xMapEncoder, "f" );
+        xError |= cbor_encode_int( &xMapEncoder, lFileId );
+        xError |= cbor_encode_text_stringz( &xMapEncoder, "i" );
+        xError |= cbor_encode_int( &xMapEncoder, ( int64_t ) ulBlockId );
+        xError |= cbor_encode_text_stringz( &xMapEncoder, "l" );
+        xError |= cbor_encode_int( &xMapEncoder, ( int64_t ) ulLength );
+        xError |= cbor_encode_text_stringz( &xMapEncoder, "p" );
+        xError |= cbor_encode_byte_string( &xMapEncoder, &pucImage[ ulOffset ], ulLength );
+        xError |= cbor_encoder_close_container_checked( &xEncoder, &xMapEncoder );
+    }
+    else
+    {
+        xError = CborErrorOutOfMemory;
+    }
+
+    if( xError == CborNoError )
+    {
+        pxMessage->xPayloadLength = cbor_encoder_get_buffer_size( &xEncoder, pxMessage->pucPayload );
+        pxMessage->bIsBlock = true;
+        strcpy( pxMessage->pcTopic, pcDataTopic );
+
+        /* Blocks go out back to back at the link rate once the request has reached the service. */
+        if( xLink.ulRateKBps > 0U )
+        {
+            ullTransmitUs = ( ( uint64_t ) pxMessage->xPayloadLength * 1000000ULL ) / ( ( uint64_t ) xLink.ulRateKBps * 1024ULL );
+        }
+
+        ullSendUs = ( ullLinkFreeUs > ullRequestArrivalUs ) ? ullLinkFreeUs : ullRequestArrivalUs;
+        ullLinkFreeUs = ullSendUs + ullTransmitUs;
+        pxMessage->ullArrivalUs = ullLinkFreeUs + ( ( uint64_t ) xLink.ulLatencyMs * 1000ULL );
+
+        if( ( prvRandom() % 100U ) < xLink.ulReorderPercent )
+        {
+            /* Hold the block back so blocks sent after it overtake it. */
+            pxMessage->ullArrivalUs += ( ( uint64_t ) ( 1U + ( prvRandom() % BENCH_REORDER_MAX_BLOCKS ) ) * ullTransmitUs ) + 1000ULL;
+            xStats.ulBlocksReordered++;
+        }
+
+        if( ( prvRandom() % 100U ) < xLink.ulDuplicatePercent )
+        {
+            pxDuplicate = calloc( 1, sizeof( BenchMessage_t ) );
+
+            if( pxDuplicate != NULL )
+            {
+                *pxDuplicate = *pxMessage;
+                pxDuplicate->pucPayload = malloc( pxMessage->xPayloadLength );
+            }
+
+            if( ( pxDuplicate != NULL ) && ( pxDuplicate->pucPayload != NULL ) )
+            {
+                memcpy( pxDuplicate->pucPayload, pxMessage->pucPayload, pxMessage->xPayloadLength );
+                pxDuplicate->ullArrivalUs += ullTransmitUs;
+                prvQueueMessage( pxDuplicate );
+                xStats.ulBlocksDuplicated++;
+            }
+            else if( pxDuplicate != NULL )
+            {
+                free( pxDuplicate );
+            }
+        }
+
+        if( ( prvRandom() % 100U ) < xLink.ulLossPercent )
+        {
+            xStats.ulBlocksLost++;
+            free( pxMessage->pucPayload );
+            free( pxMessage );
+        }
+        else
+        {
+            prvQueueMessage( pxMessage );
+        }
+    }
+    else if( pxMessage != NULL )
+    {
+        free( pxMessage->pucPayload );
+        free( pxMessage );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvServeStreamRequest( const IotMqttPublishInfo_t * pxPublishInfo )
+{
+    CborParser xParser;
+    CborValue xMap, xValue;
+    CborError xError;
+    int lFileId = 0, lBlockSize = 0, lOffset = 0, lNumBlocks = 0;
+    uint8_t ucBitmap[ BENCH_MAX_BITMAP_SIZE ];
+    size_t xBitmapLength = sizeof( ucBitmap );
+    char pcDataTopic[ BENCH_MAX_TOPIC_LEN ];
+    size_t xPrefixLength = pxPublishInfo->topicNameLength - CONST_STRLEN( "get/cbor" );
+    uint64_t ullRequestArrivalUs = OTA_Benchmark_NowUs() + ( ( uint64_t ) xLink.ulLatencyMs * 1000ULL );
+    uint32_t ulBlock;
+    uint32_t ulSent = 0;
+
+    xError = cbor_parser_init( pxPublishInfo->pPayload, pxPublishInfo->payloadLength, 0, &xParser, &xMap );
+
+    if( ( xError == CborNoError ) && ( cbor_value_is_map( &xMap ) == false ) )
+    {
+        xError = CborErrorIllegalType;
+    }
+
+    if( xError == CborNoError )
+    {
+        xError = cbor_value_map_find_value( &xMap, "f", &xValue );
+        xError |= cbor_value_get_int( &xValue, &lFileId );
+        xError |= cbor_value_map_find_value( &xMap, "l", &xValue );
+        xError |= cbor_value_get_int( &xValue, &lBlockSize );
+        xError |= cbor_value_map_find_value( &xMap, "o", &xValue );
+        xError |= cbor_value_get_int( &xValue, &lOffset );
+        xError |= cbor_value_map_find_value( &xMap, "n", &xValue );
+        xError |= cbor_value_get_int( &xValue, &lNumBlocks );
+        xError |= cbor_value_map_find_value( &xMap, "b", &xValue );
+        xError |= cbor_value_copy_byte_string( &xValue, ucBitmap, &xBitmapLength, NULL );
+    }
+
+    if( ( xError == CborNoError ) && ( lBlockSize > 0 ) && ( lOffset >= 0 ) && ( lNumBlocks > 0 ) &&
+        ( xPrefixLength + sizeof( "data/cbor" ) <= sizeof( pcDataTopic ) ) )
+    {
+        memcpy( pcDataTopic, pxPublishInfo->pTopicName, xPrefixLength );
+        strcpy( &pcDataTopic[ xPrefixLength ], "data/cbor" );
+
+        xStats.ulStreamRequests++;
+
+        if( xStats.ullFirstRequestUs == 0U )
+        {
+            xStats.ullFirstRequestUs = OTA_Benchmark_NowUs();
+        }
+        else if( ( OTA_Benchmark_NowUs() - ullLastQueuedUs ) >= ( otaconfigFILE_REQUEST_WAIT_MS * 1000ULL ) )
+        {
+            /* Nothing reached the agent for a whole request timer period, so the
+             * timer sent this request. */
+            xStats.ulMomentumEvents++;
+            ulMomentum++;
+
+            if( ulMomentum > xStats.ulMaxMomentum )
+            {
+                xStats.ulMaxMomentum = ulMomentum;
+            }
+        }
+        else
+        {
+            ulMomentum = 0;
+        }
+
+        /* Send the first lNumBlocks blocks set in the bitmap, as the stream service does. */
+        for( ulBlock = ( uint32_t ) lOffset;
+             ( ulBlock < ( xBitmapLength * 8U ) ) && ( ulSent < ( uint32_t ) lNumBlocks ) &&
+             ( ( ulBlock * ( uint32_t ) lBlockSize ) < ulImageSize );
+             ulBlock++ )
+        {
+            if( ( ucBitmap[ ulBlock >> 3 ] & ( 1U << ( ulBlock & 7U ) ) ) != 0U )
+            {
+                prvSendBlock( pcDataTopic, ( int32_t ) lFileId, ulBlock, ( uint32_t ) lBlockSize, ullRequestArrivalUs );
+                ulSent++;
+            }
+        }
+
+        xStats.ulBlocksRequested += ulSent;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvDeliveryThread( void * pvUnused )
+{
+    BenchMessage_t * pxMessage;
+    BenchSubscription_t * pxSubscription;
+    IotMqttCallbackInfo_t xCallback;
+    IotMqttCallbackParam_t xParam;
+    struct timespec xDeadline;
+    uint64_t ullNowUs;
+    uint32_t ulQueuedBefore;
+    bool bDeliver;
+    bool bTaken;
+
+    ( void ) pvUnused;
+
+    ( void ) pthread_mutex_lock( &xLock );
+
+    while( bRunning == true )
+    {
+        ullNowUs = OTA_Benchmark_NowUs();
+
+        if( pxPendingMessages == NULL )
+        {
+            ( void ) pthread_cond_wait( &xChanged, &xLock );
+        }
+        else if( pxPendingMessages->ullArrivalUs > ullNowUs )
+        {
+            xDeadline.tv_sec = ( time_t ) ( pxPendingMessages->ullArrivalUs / 1000000ULL );
+            xDeadline.tv_nsec = ( long ) ( ( pxPendingMessages->ullArrivalUs % 1000000ULL ) * 1000ULL );
+            ( void ) pthread_cond_timedwait( &xChanged, &xLock, &xDeadline );
+        }
+        else
+        {
+            pxMessage = pxPendingMessages;
+            pxPendingMessages = pxMessage->pxNext;
+            pxSubscription = prvFindSubscription( pxMessage->pcTopic, strlen( pxMessage->pcTopic ) );
+            bDeliver = ( pxSubscription != NULL );
+
+            if( bDeliver == true )
+            {
+                xCallback = pxSubscription->xCallback;
+
+                if( pxMessage->bIsBlock == true )
+                {
+                    xStats.ulBlocksSent++;
+                }
+            }
+
+            ( void ) pthread_mutex_unlock( &xLock );
+
+            if( bDeliver == true )
+            {
+                memset( &xParam, 0, sizeof( xParam ) );
+                xParam.u.message.pTopicFilter = pxMessage->pcTopic;
+                xParam.u.message.topicFilterLength = ( uint16_t ) strlen( pxMessage->pcTopic );
+                xParam.u.message.info.qos = IOT_MQTT_QOS_0;
+                xParam.u.message.info.pTopicName = pxMessage->pcTopic;
+                xParam.u.message.info.topicNameLength = xParam.u.message.topicFilterLength;
+                xParam.u.message.info.pPayload = pxMessage->pucPayload;
+                xParam.u.message.info.payloadLength = pxMessage->xPayloadLength;
+
+                /* In copy mode the agent has to copy the payload into one of its own buffers. */
+                xParam.u.message.pReceivedData = ( xLink.bCopyPayload == true ) ? NULL : pxMessage->pucPayload;
+
+                ulQueuedBefore = OTA_GetPacketsQueued();
+                xCallback.function( xCallback.pCallbackContext, &xParam );
+
+                /* The agent clears pReceivedData when it takes the buffer instead of copying it. */
+                bTaken = ( xLink.bCopyPayload == false ) && ( xParam.u.message.pReceivedData == NULL );
+
+                if( ( pxMessage->bIsBlock == true ) && ( OTA_GetPacketsQueued() != ulQueuedBefore ) )
+                {
+                    ( void ) pthread_mutex_lock( &xLock );
+                    xStats.ulBlocksQueued++;
+                    ullLastQueuedUs = OTA_Benchmark_NowUs();
+
+                    if( bTaken == false )
+                    {
+                        xStats.ullBytesCopied += pxMessage->xPayloadLength;
+                    }
+
+                    ( void ) pthread_mutex_unlock( &xLock );
+                }
+
+                /* A buffer the agent took is freed with IotMqtt_FreeReceivedData(). */
+                if( bTaken == true )
+                {
+                    pxMessage->pucPayload = NULL;
+                }
+            }
+
+            free( pxMessage->pucPayload );
+            free( pxMessage );
+
+            ( void ) pthread_mutex_lock( &xLock );
+        }
+    }
+
+    ( void ) pthread_mutex_unlock( &xLock );
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+bool OTA_Benchmark_LinkStart( const OTA_BenchmarkLink_t * pxLink,
+                              const uint8_t * pucImageData,
+                              uint32_t ulImageDataSize,
+                              const char * pcJob )
+{
+    pthread_condattr_t xAttr;
+    bool bResult = true;
+
+    ( void ) pthread_mutex_lock( &xLock );
+
+    xLink = *pxLink;
+    pucImage = pucImageData;
+    ulImageSize = ulImageDataSize;
+    pcJobDocument = pcJob;
+    bJobSent = false;
+    ullLinkFreeUs = 0;
+    ulRandomState = ( pxLink->ulSeed != 0U ) ? pxLink->ulSeed : 1U;
+    ullLastQueuedUs = 0;
+    ulMomentum = 0;
+    memset( &xStats, 0, sizeof( xStats ) );
+    memset( xSubscriptions, 0, sizeof( xSubscriptions ) );
+
+    /* Arrival times are on the monotonic clock. */
+    ( void ) pthread_condattr_init( &xAttr );
+    ( void ) pthread_condattr_setclock( &xAttr, CLOCK_MONOTONIC );
+    ( void ) pthread_cond_init( &xChanged, &xAttr );
+    ( void ) pthread_condattr_destroy( &xAttr );
+
+    bRunning = true;
+
+    if( pthread_create( &xDeliveryThread, NULL, prvDeliveryThread, NULL ) != 0 )
+    {
+        bRunning = false;
+        ( void ) pthread_cond_destroy( &xChanged );
+        bResult = false;
+    }
+
+    ( void ) pthread_mutex_unlock( &xLock );
+
+    return bResult;
+}
+
+/*-----------------------------------------------------------*/
+
+void OTA_Benchmark_LinkStop( OTA_BenchmarkLinkStats_t * pxStats )
+{
+    BenchMessage_t * pxMessage;
+
+    ( void ) pthread_mutex_lock( &xLock );
+    bRunning = false;
+    ( void ) pthread_cond_signal( &xChanged );
+    ( void ) pthread_mutex_unlock( &xLock );
+
+    ( void ) pthread_join( xDeliveryThread, NULL );
+
+    ( void ) pthread_mutex_lock( &xLock );
+
+    while( pxPendingMessages != NULL )
+    {
+        pxMessage = pxPendingMessages;
+        pxPendingMessages = pxMessage->pxNext;
+        free( pxMessage->pucPayload );
+        free( pxMessage );
+    }
+
+    *pxStats = xStats;
+    ( void ) pthread_cond_destroy( &xChanged );
+
+    ( void ) pthread_mutex_unlock( &xLock );
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_TimedSubscribe( IotMqttConnection_t mqttConnection,
+                                       const IotMqttSubscription_t * pSubscriptionList,
+                                       size_t subscriptionCount,
+                                       uint32_t flags,
+                                       uint32_t timeoutMs )
+{
+    IotMqttError_t eResult = IOT_MQTT_SUCCESS;
+    BenchSubscription_t * pxSubscription;
+    size_t xIndex;
+    uint32_t ulSlot;
+
+    ( void ) mqttConnection;
+    ( void ) flags;
+    ( void ) timeoutMs;
+
+    ( void ) pthread_mutex_lock( &xLock );
+
+    for( xIndex = 0; ( xIndex < subscriptionCount ) && ( eResult == IOT_MQTT_SUCCESS ); xIndex++ )
+    {
+        pxSubscription = prvFindSubscription( pSubscriptionList[ xIndex ].pTopicFilter,
+                                              pSubscriptionList[ xIndex ].topicFilterLength );
+
+        for( ulSlot = 0; ( ulSlot < BENCH_MAX_SUBSCRIPTIONS ) && ( pxSubscription == NULL ); ulSlot++ )
+        {
+            if( xSubscriptions[ ulSlot ].bInUse == false )
+            {
+                pxSubscription = &xSubscriptions[ ulSlot ];
+            }
+        }
+
+        if( ( pxSubscription == NULL ) || ( pSubscriptionList[ xIndex ].topicFilterLength >= BENCH_MAX_TOPIC_LEN ) )
+        {
+            eResult = IOT_MQTT_NO_MEMORY;
+        }
+        else
+        {
+            memcpy( pxSubscription->pcTopicFilter, pSubscriptionList[ xIndex ].pTopicFilter, pSubscriptionList[ xIndex ].topicFilterLength );
+            pxSubscription->pcTopicFilter[ pSubscriptionList[ xIndex ].topicFilterLength ] = '\0';
+            pxSubscription->xCallback = pSubscriptionList[ xIndex ].callback;
+            pxSubscription->bInUse = true;
+        }
+    }
+
+    ( void ) pthread_mutex_unlock( &xLock );
+
+    return eResult;
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_TimedUnsubscribe( IotMqttConnection_t mqttConnection,
+                                         const IotMqttSubscription_t * pSubscriptionList,
+                                         size_t subscriptionCount,
+                                         uint32_t flags,
+                                         uint32_t timeoutMs )
+{
+    BenchSubscription_t * pxSubscription;
+    size_t xIndex;
+
+    ( void ) mqttConnection;
+    ( void ) flags;
+    ( void ) timeoutMs;
+
+    ( void ) pthread_mutex_lock( &xLock );
+
+    for( xIndex = 0; xIndex < subscriptionCount; xIndex++ )
+    {
+        pxSubscription = prvFindSubscription( pSubscriptionList[ xIndex ].pTopicFilter,
+                                              pSubscriptionList[ xIndex ].topicFilterLength );
+
+        if( pxSubscription != NULL )
+        {
+            pxSubscription->bInUse = false;
+        }
+    }
+
+    ( void ) pthread_mutex_unlock( &xLock );
+
+    return IOT_MQTT_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_Unsubscribe( IotMqttConnection_t mqttConnection,
+                                    const IotMqttSubscription_t * pSubscriptionList,
+                                    size_t subscriptionCount,
+                                    uint32_t flags,
+                                    const IotMqttCallbackInfo_t * pCallbackInfo,
+                                    IotMqttOperation_t * pUnsubscribeOperation )
+{
+    ( void ) pCallbackInfo;
+
+    ( void ) IotMqtt_TimedUnsubscribe( mqttConnection, pSubscriptionList, subscriptionCount, flags, 0 );
+
+    /* The unsubscribe is already complete, so there is nothing to wait for. */
+    if( pUnsubscribeOperation != NULL )
+    {
+        *pUnsubscribeOperation = NULL;
+    }
+
+    return IOT_MQTT_STATUS_PENDING;
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_Wait( IotMqttOperation_t operation,
+                             uint32_t timeoutMs )
+{
+    ( void ) operation;
+    ( void ) timeoutMs;
+
+    return IOT_MQTT_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_TimedPublish( IotMqttConnection_t mqttConnection,
+                                     const IotMqttPublishInfo_t * pPublishInfo,
+                                     uint32_t flags,
+                                     uint32_t timeoutMs )
+{
+    ( void ) mqttConnection;
+    ( void ) flags;
+    ( void ) timeoutMs;
+
+    ( void ) pthread_mutex_lock( &xLock );
+
+    if( bRunning == true )
+    {
+        if( prvEndsWith( pPublishInfo->pTopicName, pPublishInfo->topicNameLength, "/jobs/$next/get" ) )
+        {
+            prvServeJobRequest( pPublishInfo );
+        }
+        else if( prvEndsWith( pPublishInfo->pTopicName, pPublishInfo->topicNameLength, "/get/cbor" ) )
+        {
+            prvServeStreamRequest( pPublishInfo );
+        }
+        else if( prvEndsWith( pPublishInfo->pTopicName, pPublishInfo->topicNameLength, "/update" ) )
+        {
+            xStats.ulStatusUpdates++;
+        }
+    }
+
+    ( void ) pthread_mutex_unlock( &xLock );
+
+    return IOT_MQTT_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_FreeReceivedData( void * pReceivedData )
+{
+    free( pReceivedData );
+}
@@ -0,0 +1,97 @@
+/*
+ * FreeRTOS OTA V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+#ifndef __AWS_OTA_BENCHMARK_LOOPBACK__H__
+#define __AWS_OTA_BENCHMARK_LOOPBACK__H__
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The loopback stands in for the MQTT broker, the jobs service and the stream
+ * service. It implements the IotMqtt calls the OTA MQTT interface makes, so the
+ * agent's real request, CBOR and receive buffer code is what gets measured.
+ *
+ * The job document is returned for the first "get next job" request. Stream
+ * requests are decoded and answered with one message per requested block, sent
+ * over a simulated link with the configured latency and rate. Each block may be
+ * lost, duplicated or delayed past the blocks behind it.
+ */
+
+/* Simulated link settings. */
+
+typedef struct OTA_BenchmarkLink
+{
+    uint32_t ulLatencyMs;        /* One way delay added to every message. */
+    uint32_t ulRateKBps;         /* Link rate used to space out blocks, or 0 for no limit. */
+    uint32_t ulLossPercent;      /* Chance that a block is lost. */
+    uint32_t ulDuplicatePercent; /* Chance that a block is delivered twice. */
+    uint32_t ulReorderPercent;   /* Chance that a block is held back behind later blocks. */
+    uint32_t ulSeed;             /* Seed for the loss, duplicate and reorder decisions. */
+    bool bCopyPayload;           /* Deliver blocks without a receive buffer so the agent copies them. */
+} OTA_BenchmarkLink_t;
+
+/* What the loopback saw during a run. */
+
+typedef struct OTA_BenchmarkLinkStats
+{
+    uint32_t ulStreamRequests;   /* Stream requests received. */
+    uint32_t ulBlocksRequested;  /* Blocks asked for by those requests. */
+    uint32_t ulBlocksSent;       /* Block messages delivered, including duplicates. */
+    uint32_t ulBlocksLost;       /* Block messages lost on the link. */
+    uint32_t ulBlocksDuplicated; /* Extra copies delivered. */
+    uint32_t ulBlocksReordered;  /* Block messages held back. */
+    uint32_t ulBlocksQueued;     /* Block messages the agent accepted into an event buffer. */
+    uint32_t ulMomentumEvents;   /* Stream requests sent by the request timer, after no block for a timer period. */
+    uint32_t ulMaxMomentum;      /* Longest run of such requests. */
+    uint32_t ulStatusUpdates;    /* Job status updates published. */
+    uint64_t ullBytesCopied;     /* Block message bytes copied out of receive buffers by the agent. */
+    uint64_t ullFirstRequestUs;  /* Time of the first stream request, from OTA_Benchmark_NowUs(). */
+} OTA_BenchmarkLinkStats_t;
+
+/**
+ * @brief Microseconds of the monotonic clock.
+ */
+uint64_t OTA_Benchmark_NowUs( void );
+
+/**
+ * @brief Start serving one OTA job.
+ *
+ * pucImage and pcJobDocument must stay valid until OTA_Benchmark_LinkStop().
+ */
+bool OTA_Benchmark_LinkStart( const OTA_BenchmarkLink_t * pxLink,
+                              const uint8_t * pucImage,
+                              uint32_t ulImageSize,
+                              const char * pcJobDocument );
+
+/**
+ * @brief Stop serving, drop any messages still on the link and return the run's statistics.
+ *
+ * Call after the agent has been shut down.
+ */
+void OTA_Benchmark_LinkStop( OTA_BenchmarkLinkStats_t * pxStats );
+
+#endif /* ifndef __AWS_OTA_BENCHMARK_LOOPBACK__H__ */
@@ -0,0 +1,166 @@
+/*
+ * FreeRTOS OTA V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ota_agent_config.h
+ * @brief OTA settings for the host benchmark.
+ *
+ * The request settings can be overridden on the compiler command line so one
+ * executable is built for each request and window combination being compared.
+ */
+
+#ifndef _AWS_OTA_AGENT_CONFIG_H_
+#define _AWS_OTA_AGENT_CONFIG_H_
+
+/**
+ * @brief The number of words allocated to the stack for the OTA agent.
+ *
+ * The benchmark runs the agent on a host thread with its own stack.
+ */
+#define otaconfigSTACK_SIZE                    630U
+
+/**
+ * @brief Log base 2 of the largest file block size.
+ *
+ * Smaller blocks are selected per run through the xSelectBlockSize callback.
+ */
+#define otaconfigLOG2_FILE_BLOCK_SIZE          12UL
+
+/**
+ * @brief Milliseconds to wait for the self test phase to succeed before we force reset.
+ */
+#define otaconfigSELF_TEST_RESPONSE_WAIT_MS    16000U
+
+/**
+ * @brief Milliseconds to wait before requesting data blocks again if nothing is happening.
+ *
+ * Much shorter than on a device so lost blocks are requested again within a run.
+ */
+#ifndef otaconfigFILE_REQUEST_WAIT_MS
+    #define otaconfigFILE_REQUEST_WAIT_MS      250U
+#endif
+
+/**
+ * @brief The OTA agents task priority.
+ */
+#define otaconfigAGENT_PRIORITY                tskIDLE_PRIORITY
+
+/**
+ * @brief The maximum allowed length of the thing name used by the OTA agent.
+ */
+#define otaconfigMAX_THINGNAME_LEN             64U
+
+/**
+ * @brief The maximum number of data blocks requested from OTA streaming service.
+ */
+#ifndef otaconfigMAX_NUM_BLOCKS_REQUEST
+    #define otaconfigMAX_NUM_BLOCKS_REQUEST    1U
+#endif
+
+/**
+ * @brief The maximum number of data blocks kept in flight by windowed block requests.
+ *
+ * 0 measures the plain request and wait behaviour.
+ */
+#ifndef otaconfigMQTT_REQUEST_WINDOW_BLOCKS
+    #define otaconfigMQTT_REQUEST_WINDOW_BLOCKS    0U
+#endif
+
+/**
+ * @brief Hash received file blocks while the file is being downloaded.
+ *
+ * Disabled because the RAM PAL does not check signatures.
+ */
+#define otaconfigSTREAMING_SIGNATURE_CHECK    0U
+
+/**
+ * @brief Accept delta patch jobs.
+ */
+#define otaconfigDELTA_UPDATE                 0U
+
+/**
+ * @brief Accept compressed file jobs.
+ *
+ * The image is sent compressed with -Z.
+ */
+#define otaconfigCOMPRESSED_UPDATE            1U
+
+/**
+ * @brief Number of file blocks received between download checkpoints.
+ */
+#define otaconfigCHECKPOINT_BLOCKS            0U
+
+/**
+ * @brief The maximum number of files of one job received at the same time.
+ */
+#ifndef otaconfigMAX_CONCURRENT_FILES
+    #define otaconfigMAX_CONCURRENT_FILES    1U
+#endif
+
+/**
+ * @brief The maximum number of requests allowed to send without a response before we abort.
+ */
+#define otaconfigMAX_NUM_REQUEST_MOMENTUM     32U
+
+/**
+ * @brief The number of data buffers reserved by the OTA agent.
+ */
+#ifndef otaconfigMAX_NUM_OTA_DATA_BUFFERS
+    #define otaconfigMAX_NUM_OTA_DATA_BUFFERS    4U
+#endif
+
+/**
+ * @brief Size of the memory pool the data buffers are carved from, in bytes.
+ */
+#define otaconfigEVENT_BUFFER_POOL_SIZE       ( otaconfigMAX_NUM_OTA_DATA_BUFFERS * OTA_DATA_BLOCK_SIZE )
+
+/**
+ * @brief The smallest data buffer carved from the pool, in bytes.
+ */
+#define otaconfigMIN_EVENT_BUFFER_SIZE        OTA_DATA_BLOCK_SIZE
+
+/**
+ * @brief Allow update to same or lower version.
+ */
+#define otaconfigAllowDowngrade               0U
+
+/**
+ * @brief The protocol selected for OTA control operations.
+ */
+#define configENABLED_CONTROL_PROTOCOL        ( OTA_CONTROL_OVER_MQTT )
+
+/**
+ * @brief The protocol selected for OTA data operations.
+ *
+ * Only the MQTT data path is simulated by the loopback.
+ */
+#define configENABLED_DATA_PROTOCOLS          ( OTA_DATA_OVER_MQTT )
+
+/**
+ * @brief The preferred protocol selected for OTA data operations.
+ */
+#define configOTA_PRIMARY_DATA_PROTOCOL       ( OTA_DATA_OVER_MQTT )
+
+#endif /* _AWS_OTA_AGENT_CONFIG_H_ */
@@ -154,16 +154,18 @@ typedef enum
  */
 typedef enum
 {
-    eOTA_JobParseErr_Unknown = -1,        /* The error code has not yet been set by a logic path. */
-    eOTA_JobParseErr_None = 0,            /* Signifies no error has occurred. */
-    eOTA_JobParseErr_BusyWithExistingJob, /* We're busy with a job but received a new job document. */
-    eOTA_JobParseErr_NullJob,             /* A null job was reported (no job ID). */
-    eOTA_JobParseErr_UpdateCurrentJob,    /* We're already busy with the reported job ID. */
-    eOTA_JobParseErr_ZeroFileSize,        /* Job document specified a zero sized file. This is not allowed. */
-    eOTA_JobParseErr_NonConformingJobDoc, /* The job document failed to fulfill the model requirements. */
-    eOTA_JobParseErr_BadModelInitParams,  /* There was an invalid initialization parameter used in the document model. */
-    eOTA_JobParseErr_NoContextAvailable,  /* There wasn't an OTA context available. */
-    eOTA_JobParseErr_NoActiveJobs,        /* No active jobs are available in the service. */
+    eOTA_JobParseErr_Unknown = -1,           /* The error code has not yet been set by a logic path. */
+    eOTA_JobParseErr_None = 0,               /* Signifies no error has occurred. */
+    eOTA_JobParseErr_BusyWithExistingJob,    /* We're busy with a job but received a new job document. */
+    eOTA_JobParseErr_NullJob,                /* A null job was reported (no job ID). */
+    eOTA_JobParseErr_UpdateCurrentJob,       /* We're already busy with the reported job ID. */
+    eOTA_JobParseErr_ZeroFileSize,           /* Job document specified a zero sized file. This is not allowed. */
+    eOTA_JobParseErr_NonConformingJobDoc,    /* The job document failed to fulfill the model requirements. */
+    eOTA_JobParseErr_BadModelInitParams,     /* There was an invalid initialization parameter used in the document model. */
+    eOTA_JobParseErr_NoContextAvailable,     /* There wasn't an OTA context available. */
+    eOTA_JobParseErr_NoActiveJobs,           /* No active jobs are available in the service. */
+    eOTA_JobParseErr_UnsupportedPatch,       /* Job document specified a delta patch that can't be applied on this device. */
+    eOTA_JobParseErr_UnsupportedCompression, /* Job document specified a compression format this device can't decompress. */
 } OTA_JobParseErr_t;
 
 
@@ -361,6 +363,80 @@ typedef int16_t (* pxOTAPALWriteBlockCallback_t)( OTA_FileContext_t * const C,
                                                   uint8_t * const pacData,
                                                   uint32_t iBlockSize );
 
+/**
+ * @ingroup ota_datatypes_functionpointers
+ * @brief OTA read active image callback function typedef.
+ *
+ * The user may register a callback function when initializing the OTA Agent. This
+ * callback reads the currently running image, which is the base that delta patches
+ * are applied against. Delta update jobs are rejected if it is not provided.
+ *
+ * @param[in] C File context of the file being received.
+ * @param[in] ulOffset Offset into the running image to read from.
+ * @param[out] pacData Buffer to read the data into.
+ * @param[in] ulLength Number of bytes to read.
+ *
+ * @return The number of bytes read or a negative value on error.
+ */
+typedef int32_t (* pxOTAPALReadActiveImageCallback_t)( OTA_FileContext_t * const C,
+                                                       uint32_t ulOffset,
+                                                       uint8_t * const pacData,
+                                                       uint32_t ulLength );
+
+/**
+ * @ingroup ota_datatypes_functionpointers
+ * @brief OTA save checkpoint callback function typedef.
+ *
+ * The user may register a callback function when initializing the OTA Agent. This
+ * callback persists the download progress of the file being received so the download
+ * can continue after a reset. The blocks already written must be durable before the
+ * checkpoint is. Checkpointing is disabled if this or the resume callback is not provided.
+ *
+ * @param[in] C File context of the file being received.
+ * @param[in] pucCheckpoint Checkpoint to store, opaque to the PAL.
+ * @param[in] ulLength Length of the checkpoint. 0 erases any stored checkpoint.
+ *
+ * @return kOTA_Err_None on success, otherwise an error code.
+ */
+typedef OTA_Err_t (* pxOTAPALSaveCheckpointCallback_t)( OTA_FileContext_t * const C,
+                                                        const uint8_t * pucCheckpoint,
+                                                        uint32_t ulLength );
+
+/**
+ * @ingroup ota_datatypes_functionpointers
+ * @brief OTA resume file for receive callback function typedef.
+ *
+ * The user may register a callback function when initializing the OTA Agent. If a
+ * checkpoint is stored for the file, this callback copies it out and opens the partly
+ * received file without erasing it, in place of the create file for receive callback.
+ *
+ * @param[in] C File context of the file to be received.
+ * @param[out] pucCheckpoint Buffer to copy the checkpoint into.
+ * @param[in] ulMaxLength Size of the buffer.
+ *
+ * @return The checkpoint length with the file open, 0 if there is no checkpoint, or a
+ * negative value on error. The file is only left open when a length is returned.
+ */
+typedef int32_t (* pxOTAPALResumeFileForRxCallback_t)( OTA_FileContext_t * const C,
+                                                       uint8_t * const pucCheckpoint,
+                                                       uint32_t ulMaxLength );
+
+/**
+ * @ingroup ota_datatypes_functionpointers
+ * @brief OTA select block size callback function typedef.
+ *
+ * The user may register a callback function when initializing the OTA Agent to choose the
+ * size of the blocks a file is requested in, for example from the link the device is using.
+ * It is called once for each file before its download starts. The agent rounds the size down
+ * to a power of 2 from 256 bytes up to 2^otaconfigLOG2_FILE_BLOCK_SIZE bytes. Every file uses
+ * the largest block size if no callback is provided.
+ *
+ * @param[in] C File context of the file about to be received.
+ *
+ * @return The preferred block size in bytes.
+ */
+typedef uint32_t (* pxOTASelectBlockSizeCallback_t)( const OTA_FileContext_t * C );
+
 /**
  * @ingroup ota_datatypes_functionpointers
  * @brief Custom Job callback function typedef.
@@ -424,6 +500,11 @@ typedef struct OTA_FileContext
     uint32_t ulUpdaterVersion;  /*!< Used by OTA self-test detection, the version of FW that did the update. */
     bool bIsInSelfTest;         /*!< True if the job is in self test mode. */
     uint8_t * pucProtocols;     /*!< Authorization scheme. */
+    void * pvSigVerifyContext;  /*!< Signature verification context already fed the whole file, or NULL if the PAL must hash the file itself. */
+    uint32_t ulDeltaFormat;     /*!< Patch format if the file is a delta patch against the running image, otherwise 0. */
+    uint32_t ulCompression;     /*!< Compression format if the file is sent compressed, otherwise 0. */
+    uint32_t ulImageSize;       /*!< Size of the image written through the PAL. Differs from ulFileSize only for a patched or compressed file. */
+    uint32_t ulBlockSize;       /*!< Size of the blocks the file is requested in, a power of 2. */
 } OTA_FileContext_t;
 
 /**
@@ -455,6 +536,10 @@ typedef struct
     pxOTAPALWriteBlockCallback_t xWriteBlock;                       /* OTA Write Block callback pointer */
     pxOTACompleteCallback_t xCompleteCallback;                      /* OTA Job Completed callback pointer */
     pxOTACustomJobCallback_t xCustomJobCallback;                    /* OTA Custom Job callback pointer */
+    pxOTAPALReadActiveImageCallback_t xReadActiveImage;             /* OTA Read Active Image callback pointer, optional */
+    pxOTAPALSaveCheckpointCallback_t xSaveCheckpoint;               /* OTA Save Checkpoint callback pointer, optional */
+    pxOTAPALResumeFileForRxCallback_t xResumeFileForRx;             /* OTA Resume File for Receive callback pointer, optional */
+    pxOTASelectBlockSizeCallback_t xSelectBlockSize;                /* OTA Select Block Size callback pointer, optional */
 } OTA_PAL_Callbacks_t;
 
 
@@ -517,6 +602,9 @@ typedef struct
 #define kOTA_Err_EventQueueSendFailed    0x2c000000UL     /*!< Posting event message to the event queue failed. */
 #define kOTA_Err_InvalidDataProtocol     0x2d000000UL     /*!< Job does not have a valid protocol for data transfer. */
 #define kOTA_Err_OTAAgentStopped         0x2e000000UL     /*!< Returned when operations are performed that requires OTA Agent running & its stopped. */
+#define kOTA_Err_PatchFailed             0x2f000000UL     /*!< The delta patch could not be applied to the running image. */
+#define kOTA_Err_DecompressFailed        0x30000000UL     /*!< The compressed file could not be decompressed. */
+#define kOTA_Err_CheckpointFailed        0x31000000UL     /*!< The download checkpoint could not be stored. */
 /* @[define_ota_err_codes] */
 
 /* @[define_ota_err_code_helpers] */
@@ -36,6 +36,7 @@
 #include "task.h"
 #include "queue.h"
 #include "semphr.h"
+#include "atomic.h"
 
 /* OTA agent includes. */
 #include "aws_iot_ota_agent.h"
@@ -59,6 +60,9 @@
 /* OTA interface includes. */
 #include "aws_iot_ota_interface.h"
 
+/* Signature verification includes. */
+#include "iot_crypto.h"
+
 /* OTA event handler definiton. */
 
 typedef OTA_Err_t ( * OTAEventHandler_t )( OTA_EventData_t * pxEventMsg );
@@ -93,10 +97,41 @@ typedef union MultiParmPtr
 
 static OTA_EventMsg_t xQueueData[ OTA_NUM_MSG_Q_ENTRIES ];
 
-/* Buffers used to push event data. */
+/* Buffers used to push event data. Their data is carved from the pool to suit the current block size. */
 
 static OTA_EventData_t xEventBuffer[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ];
 
+/* Memory the event buffers are carved from. */
+
+static uint8_t ucEventBufferPool[ OTA_EVENT_BUFFER_POOL_SIZE ];
+
+/* Event buffer pool state. Only carving the pool changes the count and size, and that
+ * is only done while no buffer is in use. */
+
+static uint32_t ulEventBufferCount = 0;                /* Number of event buffers carved from the pool. */
+static volatile uint32_t ulEventBufferSize = 0;        /* Size of each carved event buffer. */
+static volatile uint32_t ulEventBufferPendingSize = 0; /* Event buffer size to carve once no buffer is in use. */
+static volatile uint32_t ulEventBuffersInUse = 0;      /* Number of event buffers in use, updated atomically. */
+
+/* Set in the in use count while the pool is being carved. Carving claims the pool by
+ * swapping an in use count of 0 for this flag, so a buffer can't be taken meanwhile. */
+
+#define OTA_EVENT_BUFFER_CARVING    0x80000000UL
+
+/*
+ * Free event buffers, as a list that callbacks and the agent task update with atomic
+ * compare and swap instead of a mutex. A link is a buffer index plus one, 0 ending the
+ * list. The low half of the head is the link to the first free buffer and the high
+ * half a tag that changes on every update, so a task that was preempted between
+ * reading the head and swapping it can't put back a list that has since changed.
+ */
+
+#define OTA_EVENT_BUFFER_LINK_MASK        0x0000FFFFUL
+#define OTA_EVENT_BUFFER_TAG_INCREMENT    0x00010000UL
+
+static uint32_t ulEventBufferFreeHead = 0;
+static uint32_t ulEventBufferNext[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ];
+
 /* OTA control interface. */
 
 static OTA_ControlInterface_t xOTA_ControlInterface;
@@ -132,6 +167,115 @@ static void prvStopRequestTimer( void );
 
 static void prvRequestTimer_Callback( TimerHandle_t T );
 
+/* Update the request window of a file for a received block. Returns true if more blocks should be requested. */
+
+static bool prvRequestWindowBlockReceived( OTA_FileRequest_t * pxRequest );
+
+/* Shrink the request window if a windowed request timed out and rescan the block bitmap. */
+
+static void prvRequestWindowRestart( OTA_FileRequest_t * pxRequest );
+
+/* Split the event buffers between the files still being received. */
+
+static void prvShareEventBuffers( void );
+
+#if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+
+/* Start hashing a new file as its blocks are received. */
+
+    static void prvStreamingHashStart( OTA_FileContext_t * C );
+
+/* Check whether a block is too far ahead of the streaming hash to be buffered. */
+
+    static bool prvStreamingHashDefers( const OTA_FileContext_t * C,
+                                        uint32_t ulBlockIndex );
+
+/* Feed a newly written block to the streaming hash, in file order. */
+
+    static void prvStreamingHashBlock( OTA_FileContext_t * C,
+                                       uint32_t ulBlockIndex,
+                                       const uint8_t * pucData,
+                                       uint32_t ulBlockSize );
+
+/* Release the frontier buffer and, if requested, abandon the streaming hash. */
+
+    static void prvStreamingHashRelease( OTA_FileContext_t * C,
+                                         bool bAbandon );
+#endif /* if ( OTA_STREAMING_SIGNATURE_CHECK != 0U ) */
+
+#if ( OTA_IN_ORDER_INGEST != 0U )
+
+/* Prepare to process a delta patch or compressed file as its blocks are received. */
+
+    static OTA_Err_t prvInOrderStart( OTA_FileContext_t * C );
+
+/* Process, stage or defer a received block of a file that must be processed in order. */
+
+    static IngestResult_t prvInOrderIngestBlock( OTA_FileContext_t * C,
+                                                 uint32_t ulBlockIndex,
+                                                 const uint8_t * pucData,
+                                                 uint32_t ulBlockSize,
+                                                 OTA_Err_t * pxCloseResult );
+
+/* Pass the next in order file data to the decompressor or patch applier. */
+
+    static OTA_Err_t prvInOrderProcess( const OTA_FileContext_t * C,
+                                        const uint8_t * pucData,
+                                        uint32_t ulLength );
+
+/* Complete processing once the whole file has been passed in order. */
+
+    static OTA_Err_t prvInOrderFinish( const OTA_FileContext_t * C );
+
+/* Free the in order processing buffers if they belong to the specified file. */
+
+    static void prvInOrderRelease( const OTA_FileContext_t * C );
+
+/* Write the image produced by in order processing. */
+
+    static int32_t prvInOrderWriteImage( void * pvContext,
+                                         uint32_t ulOffset,
+                                         uint8_t * pucData,
+                                         uint32_t ulLength );
+#endif /* if ( OTA_IN_ORDER_INGEST != 0U ) */
+
+#if ( OTA_DELTA_UPDATE != 0U )
+
+/* Read the running image for the delta patch applier. */
+
+    static int32_t prvDeltaReadBase( void * pvContext,
+                                     uint32_t ulOffset,
+                                     uint8_t * pucData,
+                                     uint32_t ulLength );
+#endif
+
+#if ( OTA_DELTA_UPDATE != 0U ) && ( OTA_COMPRESSED_UPDATE != 0U )
+
+/* Pass the decompressed data of a compressed delta patch to the patch applier. */
+
+    static int32_t prvDecompressToPatch( void * pvContext,
+                                         uint32_t ulOffset,
+                                         uint8_t * pucData,
+                                         uint32_t ulLength );
+#endif
+
+#if ( OTA_CHECKPOINT_BLOCKS != 0U )
+
+/* Open the file from its stored download checkpoint if there is a valid one. */
+
+    static bool prvCheckpointResume( OTA_FileContext_t * C,
+                                     uint32_t ulBitmapLen );
+
+/* Count a newly accepted block and store a checkpoint when one is due. */
+
+    static void prvCheckpointBlockAccepted( OTA_FileContext_t * C );
+
+/* Free the checkpoint buffer of the file and, if requested, erase its stored checkpoint. */
+
+    static void prvCheckpointRelease( OTA_FileContext_t * C,
+                                      bool bErase );
+#endif
+
 /* Start the self test timer if in self-test mode. */
 
 static BaseType_t prvStartSelfTestTimer( void );
@@ -151,6 +295,35 @@ static IngestResult_t prvIngestDataBlock( OTA_FileContext_t * C,
                                           uint32_t ulMsgSize,
                                           OTA_Err_t * pxCloseResult );
 
+/* Choose the size of the blocks a file is requested in. */
+
+static uint32_t prvSelectBlockSize( const OTA_FileContext_t * C );
+
+/* Push a chain of linked event buffers onto the free list. */
+
+static void prvEventBufferPushChain( uint32_t ulFirstLink,
+                                     uint32_t ulLastLink );
+
+/* Push one event buffer onto the free list. */
+
+static void prvEventBufferPush( OTA_EventData_t * const pxBuffer );
+
+/* Pop an event buffer from the free list or return NULL if it is empty. */
+
+static OTA_EventData_t * prvEventBufferPop( void );
+
+/* Carve the event buffer pool into as many buffers of the specified size as fit and link them. */
+
+static void prvEventBufferCarve( uint32_t ulBufferSize );
+
+/* Carve the event buffer pool for the pending size if no event buffer is in use. */
+
+static void prvEventBufferCarveIfIdle( void );
+
+/* Carve the event buffer pool for a new buffer size as soon as no event buffer is in use. */
+
+static void prvEventBufferResize( uint32_t ulBufferSize );
+
 /* Called to update the filecontext structure from the job. */
 
 static OTA_FileContext_t * prvGetFileContextFromJob( const char * pcRawMsg,
@@ -160,6 +333,18 @@ static OTA_FileContext_t * prvGetFileContextFromJob( const char * pcRawMsg,
 
 static OTA_FileContext_t * prvGetFreeContext( void );
 
+/* Get the file of the job a received block belongs to, or NULL if no file is waiting for it. */
+
+static OTA_FileContext_t * prvGetFileForBlock( const OTA_EventData_t * pxEventData );
+
+/* Count the files of the job that still have blocks to receive. */
+
+static uint32_t prvFilesReceiving( void );
+
+/* Close all files of the job. */
+
+static void prvCloseJobFiles( void );
+
 /* Parse a JSON document using the specified document model. */
 
 static DocParseErr_t prvParseJSONbyModel( const char * pcJSON,
@@ -172,6 +357,21 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
                                            uint32_t ulMsgLen,
                                            bool * pbUpdateJob );
 
+/* Check that the device can receive a file described by the job document. */
+
+static OTA_JobParseErr_t prvValidateJobFile( OTA_FileContext_t * C );
+
+/* Parse the files of a job after the first into free file contexts. */
+
+static OTA_JobParseErr_t prvParseJobDocFiles( const char * pcJSON,
+                                              uint32_t ulMsgLen,
+                                              const JSON_DocParam_t * pxBodyDef,
+                                              uint32_t ulNumFiles );
+
+/* Allocate the block bitmap of a file and open it for receiving. */
+
+static OTA_Err_t prvInitFileForRx( OTA_FileContext_t * C );
+
 /* Close an open OTA file context and free it. */
 
 static bool prvOTA_Close( OTA_FileContext_t * const C );
@@ -258,7 +458,15 @@ static OTA_Err_t prvSuspendHandler( OTA_EventData_t * pxEventData );
 static OTA_Err_t prvResumeHandler( OTA_EventData_t * pxEventData );
 static OTA_Err_t prvJobNotificationHandler( OTA_EventData_t * pxEventData );
 
-/* OTA default callback initializer. */
+/* OTA default callback initializer. The PAL only needs to provide the checkpoint hooks when checkpoints are enabled. */
+
+#if ( OTA_CHECKPOINT_BLOCKS != 0U )
+    #define OTA_PAL_SAVE_CHECKPOINT_DEFAULT        prvPAL_SaveCheckpoint
+    #define OTA_PAL_RESUME_FILE_FOR_RX_DEFAULT     prvPAL_ResumeFileForRx
+#else
+    #define OTA_PAL_SAVE_CHECKPOINT_DEFAULT        NULL
+    #define OTA_PAL_RESUME_FILE_FOR_RX_DEFAULT     NULL
+#endif
 
 #define OTA_JOB_CALLBACK_DEFAULT_INITIALIZER                           \
     {                                                                  \
@@ -271,7 +479,11 @@ static OTA_Err_t prvJobNotificationHandler( OTA_EventData_t * pxEventData );
         .xSetPlatformImageState = prvPAL_DefaultSetPlatformImageState, \
         .xWriteBlock = prvPAL_WriteBlock,                              \
         .xCompleteCallback = prvDefaultOTACompleteCallback,            \
-        .xCustomJobCallback = prvDefaultCustomJobCallback              \
+        .xCustomJobCallback = prvDefaultCustomJobCallback,             \
+        .xReadActiveImage = NULL,                                      \
+        .xSaveCheckpoint = OTA_PAL_SAVE_CHECKPOINT_DEFAULT,            \
+        .xResumeFileForRx = OTA_PAL_RESUME_FILE_FOR_RX_DEFAULT,        \
+        .xSelectBlockSize = NULL                                       \
     }
 
 /* This is THE OTA agent context and initialization state. */
@@ -282,6 +494,8 @@ static OTA_AgentContext_t xOTA_Agent =
     .pcThingName                   = { 0 },
     .pvConnectionContext           = NULL,
     .pxOTA_Files                   = { { 0 } }, /*lint !e910 !e9080 Zero initialization of all members of the single file context structure.*/
+    .ulFileIndex                   = 0,
+    .pxFileRequests                = { { 0 } },
     .ulServerFileID                = 0,
     .pcOTA_Singleton_ActiveJobName = NULL,
     .pcClientTokenFromJob          = NULL,
@@ -291,10 +505,11 @@ static OTA_AgentContext_t xOTA_Agent =
     .xOTA_EventQueue               = NULL,
     .eImageState                   = eOTA_ImageState_Unknown,
     .xPALCallbacks                 = OTA_JOB_CALLBACK_DEFAULT_INITIALIZER,
-    .ulNumOfBlocksToReceive        = 1,
     .xStatistics                   = { 0 },
-    .xOTA_ThreadSafetyMutex        = NULL,
-    .ulRequestMomentum             = 0
+    .ulRequestMomentum             = 0,
+    .xStreamingHash                = { 0 },
+    .xInOrderIngest                = { 0 },
+    .xCheckpoint                   = { 0 }
 };
 
 static OTAStateTableEntry_t OTATransitionTable[] =
@@ -419,50 +634,793 @@ static BaseType_t prvStartSelfTestTimer( void )
         {
             OTA_LOG_L1( "[%s] ERROR: failed to reset/start %s timer.\r\n", OTA_METHOD_NAME, pcTimerName );
         }
-    }
+    }
+
+    return xTimerStarted;
+}
+
+/* When the self test response timer expires, reset the device since we're likely broken. */
+
+static void prvSelfTestTimer_Callback( TimerHandle_t T )
+{
+    DEFINE_OTA_METHOD_NAME( "prvSelfTestTimer_Callback" );
+    ( void ) T;
+
+    OTA_LOG_L1( "[%s] Self test failed to complete within %ums\r\n", OTA_METHOD_NAME, otaconfigSELF_TEST_RESPONSE_WAIT_MS );
+    ( void ) xOTA_Agent.xPALCallbacks.xResetDevice( xOTA_Agent.ulServerFileID );
+}
+
+/* Stop the OTA self test timer if it is running. */
+
+static void prvStopSelfTestTimer( void )
+{
+    DEFINE_OTA_METHOD_NAME( "prvStopSelfTestTimer" );
+
+    if( xOTA_Agent.pvSelfTestTimer != NULL )
+    {
+        ( void ) xTimerStop( xOTA_Agent.pvSelfTestTimer, portMAX_DELAY );
+        OTA_LOG_L1( "[%s] Stopping the self test timer.\r\n", OTA_METHOD_NAME );
+    }
+}
+
+/*
+ * When the OTA request timer expires, signal the OTA task to request the file.
+ */
+
+static void prvRequestTimer_Callback( TimerHandle_t T )
+{
+    ( void ) T;
+    OTA_EventMsg_t xEventMsg = { 0 };
+
+    /*
+     * Send event to OTA agent task.
+     */
+    xEventMsg.xEventId = eOTA_AgentEvent_RequestTimer;
+    ( void ) OTA_SignalEvent( &xEventMsg );
+}
+
+static bool prvRequestWindowBlockReceived( OTA_FileRequest_t * pxRequest )
+{
+    DEFINE_OTA_METHOD_NAME( "prvRequestWindowBlockReceived" );
+
+    OTA_RequestWindow_t * pxWindow = &pxRequest->xRequestWindow;
+    TickType_t xNow = xTaskGetTickCount();
+    uint32_t ulMaxSize = OTA_REQUEST_WINDOW_MAX_BLOCKS;
+    uint32_t ulPipeBlocks;
+    uint32_t ulDropped;
+
+    if( pxWindow->ulInFlight > 0U )
+    {
+        pxWindow->ulInFlight--;
+    }
+
+    /* Track the round trip time of requests and the spacing of blocks with a
+     * 1/8 weight moving average. */
+    if( pxWindow->bAwaitingFirstBlock == true )
+    {
+        pxWindow->xRoundTrip = ( pxWindow->xRoundTrip == 0U ) ? ( xNow - pxWindow->xRequestTime ) :
+                               ( ( 7U * pxWindow->xRoundTrip ) + ( xNow - pxWindow->xRequestTime ) ) / 8U;
+        pxWindow->bAwaitingFirstBlock = false;
+    }
+    else
+    {
+        pxWindow->xBlockInterval = ( pxWindow->xBlockInterval == 0U ) ? ( xNow - pxWindow->xBlockTime ) :
+                                   ( ( 7U * pxWindow->xBlockInterval ) + ( xNow - pxWindow->xBlockTime ) ) / 8U;
+    }
+
+    pxWindow->xBlockTime = xNow;
+
+    if( xOTA_Agent.xStatistics.ulOTA_PacketsDropped != pxWindow->ulDropped )
+    {
+        /* Blocks are arriving faster than the agent can process them. The
+         * dropped blocks will never land, so stop counting them as in flight
+         * or the shrunk window may never be topped up again. */
+        ulDropped = xOTA_Agent.xStatistics.ulOTA_PacketsDropped - pxWindow->ulDropped;
+        pxWindow->ulInFlight = ( pxWindow->ulInFlight > ulDropped ) ? ( pxWindow->ulInFlight - ulDropped ) : 0U;
+        pxWindow->ulDropped = xOTA_Agent.xStatistics.ulOTA_PacketsDropped;
+        pxWindow->ulSize = ( pxWindow->ulSize > 1U ) ? ( pxWindow->ulSize / 2U ) : 1U;
+        pxWindow->ulReceived = 0;
+        OTA_LOG_L1( "[%s] Packets dropped, window reduced to %u blocks.\r\n", OTA_METHOD_NAME, pxWindow->ulSize );
+    }
+    else
+    {
+        pxWindow->ulReceived++;
+
+        /* Blocks needed to keep the link busy for a round trip. Growing the
+         * window past this only adds to the blocks lost on a timeout. */
+        if( pxWindow->xBlockInterval > 0U )
+        {
+            ulPipeBlocks = ( uint32_t ) ( pxWindow->xRoundTrip / pxWindow->xBlockInterval ) + 2U;
+
+            if( ulPipeBlocks < ulMaxSize )
+            {
+                ulMaxSize = ulPipeBlocks;
+            }
+        }
+
+        /* Leave event buffers for the other files being received. */
+        if( ( pxRequest->ulBlockShare > 0U ) && ( pxRequest->ulBlockShare < ulMaxSize ) )
+        {
+            ulMaxSize = pxRequest->ulBlockShare;
+        }
+
+        if( ( pxWindow->ulReceived >= pxWindow->ulSize ) && ( pxWindow->ulSize < ulMaxSize ) )
+        {
+            pxWindow->ulSize++;
+            pxWindow->ulReceived = 0;
+        }
+    }
+
+    /* Top up once half of the window has drained so each request carries
+     * several blocks. */
+    return pxWindow->ulInFlight <= ( pxWindow->ulSize / 2U );
+}
+
+static void prvRequestWindowRestart( OTA_FileRequest_t * pxRequest )
+{
+    DEFINE_OTA_METHOD_NAME( "prvRequestWindowRestart" );
+
+    OTA_RequestWindow_t * pxWindow = &pxRequest->xRequestWindow;
+
+    if( pxWindow->ulInFlight > 0U )
+    {
+        pxWindow->ulSize = ( pxWindow->ulSize > 1U ) ? ( pxWindow->ulSize / 2U ) : 1U;
+        OTA_LOG_L1( "[%s] %u blocks lost, window reduced to %u blocks.\r\n", OTA_METHOD_NAME, pxWindow->ulInFlight, pxWindow->ulSize );
+    }
+
+    /* Missing blocks are requested again starting from the beginning of the bitmap. */
+    pxWindow->ulInFlight = 0;
+    pxWindow->ulNextBlock = 0;
+    pxWindow->ulReceived = 0;
+    pxWindow->bAwaitingFirstBlock = false;
+}
+
+/* Each file still being received gets an equal share of the event buffers, so
+ * one file's requests can't leave the others without buffers for their blocks.
+ * A file being received on its own is not limited. */
+
+static void prvShareEventBuffers( void )
+{
+    uint32_t ulIndex;
+    uint32_t ulFiles = prvFilesReceiving();
+    uint32_t ulBuffers = OTA_EVENT_BUFFER_POOL_SIZE / ulEventBufferPendingSize;
+    uint32_t ulShare = 0;
+
+    if( ulBuffers > otaconfigMAX_NUM_OTA_DATA_BUFFERS )
+    {
+        ulBuffers = otaconfigMAX_NUM_OTA_DATA_BUFFERS;
+    }
+
+    if( ulFiles > 1U )
+    {
+        ulShare = ( ulBuffers > ulFiles ) ? ( ulBuffers / ulFiles ) : 1U;
+    }
+
+    for( ulIndex = 0U; ulIndex < OTA_MAX_FILES; ulIndex++ )
+    {
+        xOTA_Agent.pxFileRequests[ ulIndex ].ulBlockShare = ulShare;
+    }
+}
+
+#if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+
+    static void prvStreamingHashStart( OTA_FileContext_t * C )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvStreamingHashStart" );
+
+        OTA_StreamingHash_t * pxHash = &xOTA_Agent.xStreamingHash;
+
+        prvStreamingHashRelease( C, true );
+
+        if( pxHash->pxFile != NULL )
+        {
+            /* Another file of the job is being hashed, so the PAL will hash this one at close time. */
+            OTA_LOG_L2( "[%s] Streaming hash is busy, hashing deferred to close.\r\n", OTA_METHOD_NAME );
+        }
+        else if( pdFALSE == CRYPTO_SignatureVerificationStart( &C->pvSigVerifyContext,
+                                                               OTA_STREAMING_SIGNATURE_ASYMMETRIC_ALGORITHM,
+                                                               OTA_STREAMING_SIGNATURE_HASH_ALGORITHM ) )
+        {
+            /* The PAL will hash the whole file at close time instead. */
+            OTA_LOG_L1( "[%s] Warning: Unable to start streaming signature hash.\r\n", OTA_METHOD_NAME );
+            C->pvSigVerifyContext = NULL;
+        }
+        else if( ( C->ulDeltaFormat == 0U ) && ( C->ulCompression == 0U ) )
+        {
+            ( void ) memset( pxHash, 0, sizeof( OTA_StreamingHash_t ) );
+            pxHash->pxFile = C;
+
+            /* Without a frontier buffer only in order blocks can be streamed. */
+            pxHash->pucFrontier = ( uint8_t * ) pvPortMalloc( OTA_STREAMING_HASH_FRONTIER_BLOCKS * C->ulBlockSize ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+        }
+        else
+        {
+            /* A patched or decompressed image is written in order, so it is hashed as it is written. */
+            ( void ) memset( pxHash, 0, sizeof( OTA_StreamingHash_t ) );
+            pxHash->pxFile = C;
+        }
+    }
+
+    static bool prvStreamingHashDefers( const OTA_FileContext_t * C,
+                                        uint32_t ulBlockIndex )
+    {
+        const OTA_StreamingHash_t * pxHash = &xOTA_Agent.xStreamingHash;
+
+        /* Such a block is left missing and requested again, so the hash isn't
+         * abandoned because of a reordered or lost block. */
+        return ( C->pvSigVerifyContext != NULL ) &&
+               ( pxHash->pxFile == C ) &&
+               ( pxHash->pucFrontier != NULL ) &&
+               ( ulBlockIndex > pxHash->ulNextBlock ) &&
+               ( ( ulBlockIndex - pxHash->ulNextBlock ) > OTA_STREAMING_HASH_FRONTIER_BLOCKS );
+    }
+
+    static void prvStreamingHashBlock( OTA_FileContext_t * C,
+                                       uint32_t ulBlockIndex,
+                                       const uint8_t * pucData,
+                                       uint32_t ulBlockSize )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvStreamingHashBlock" );
+
+        OTA_StreamingHash_t * pxHash = &xOTA_Agent.xStreamingHash;
+        uint32_t ulSlot = 0;
+        uint32_t ulSize = 0;
+
+        if( C->pvSigVerifyContext != NULL )
+        {
+            if( ulBlockIndex == pxHash->ulNextBlock )
+            {
+                ( void ) CRYPTO_SignatureVerificationUpdate( C->pvSigVerifyContext, pucData, ulBlockSize );
+                pxHash->ulNextBlock++;
+
+                /* Drain any buffered blocks that now follow in order. */
+                ulSlot = pxHash->ulNextBlock % OTA_STREAMING_HASH_FRONTIER_BLOCKS;
+
+                while( ( pxHash->ulFrontierMask & ( 1UL << ulSlot ) ) != 0U )
+                {
+                    ulSize = C->ulFileSize - ( pxHash->ulNextBlock * C->ulBlockSize );
+
+                    if( ulSize > C->ulBlockSize )
+                    {
+                        ulSize = C->ulBlockSize;
+                    }
+
+                    ( void ) CRYPTO_SignatureVerificationUpdate( C->pvSigVerifyContext,
+                                                                 &pxHash->pucFrontier[ ulSlot * C->ulBlockSize ],
+                                                                 ulSize );
+                    pxHash->ulFrontierMask &= ~( 1UL << ulSlot );
+                    pxHash->ulNextBlock++;
+                    ulSlot = pxHash->ulNextBlock % OTA_STREAMING_HASH_FRONTIER_BLOCKS;
+                }
+            }
+            else if( ( pxHash->pucFrontier != NULL ) &&
+                     ( ulBlockIndex > pxHash->ulNextBlock ) &&
+                     ( ( ulBlockIndex - pxHash->ulNextBlock ) <= OTA_STREAMING_HASH_FRONTIER_BLOCKS ) )
+            {
+                /* Hold the block until the blocks before it have been hashed. */
+                ulSlot = ulBlockIndex % OTA_STREAMING_HASH_FRONTIER_BLOCKS;
+                ( void ) memcpy( &pxHash->pucFrontier[ ulSlot * C->ulBlockSize ], pucData, ulBlockSize );
+                pxHash->ulFrontierMask |= 1UL << ulSlot;
+            }
+            else
+            {
+                /* Only reached without a frontier buffer, since blocks beyond the frontier are deferred. */
+                OTA_LOG_L1( "[%s] Block %u is out of order at hash block %u, hashing deferred to close.\r\n",
+                            OTA_METHOD_NAME,
+                            ulBlockIndex,
+                            pxHash->ulNextBlock );
+                prvStreamingHashRelease( C, true );
+            }
+        }
+    }
+
+    static void prvStreamingHashRelease( OTA_FileContext_t * C,
+                                         bool bAbandon )
+    {
+        OTA_StreamingHash_t * pxHash = &xOTA_Agent.xStreamingHash;
+
+        if( pxHash->pxFile == C )
+        {
+            vPortFree( pxHash->pucFrontier );
+            ( void ) memset( pxHash, 0, sizeof( OTA_StreamingHash_t ) );
+        }
+
+        if( ( bAbandon == true ) && ( C->pvSigVerifyContext != NULL ) )
+        {
+            /* Called without a certificate or signature this only frees the context. */
+            ( void ) CRYPTO_SignatureVerificationFinal( C->pvSigVerifyContext, NULL, 0, NULL, 0 );
+            C->pvSigVerifyContext = NULL;
+        }
+    }
+
+#endif /* if ( OTA_STREAMING_SIGNATURE_CHECK != 0U ) */
+
+#if ( OTA_IN_ORDER_INGEST != 0U )
+
+    static OTA_Err_t prvInOrderStart( OTA_FileContext_t * C )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvInOrderStart" );
+
+        OTA_InOrderIngest_t * pxIngest = &xOTA_Agent.xInOrderIngest;
+        OTA_Err_t xErr = kOTA_Err_None;
+
+        ( void ) memset( pxIngest, 0, sizeof( OTA_InOrderIngest_t ) );
+        pxIngest->pxFile = C;
+        pxIngest->pucStaging = ( uint8_t * ) pvPortMalloc( OTA_IN_ORDER_STAGING_BLOCKS * C->ulBlockSize ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+
+        if( pxIngest->pucStaging == NULL )
+        {
+            xErr = kOTA_Err_OutOfMemory;
+        }
+
+        #if ( OTA_DELTA_UPDATE != 0U )
+            if( ( xErr == kOTA_Err_None ) && ( C->ulDeltaFormat != 0U ) )
+            {
+                pxIngest->pucOutput = ( uint8_t * ) pvPortMalloc( C->ulBlockSize ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+
+                if( pxIngest->pucOutput == NULL )
+                {
+                    xErr = kOTA_Err_OutOfMemory;
+                }
+                else
+                {
+                    ( void ) OTA_Delta_Init( &pxIngest->xPatch,
+                                             pxIngest->pucOutput,
+                                             C->ulBlockSize,
+                                             prvDeltaReadBase,
+                                             prvInOrderWriteImage,
+                                             C );
+                }
+            }
+        #endif /* if ( OTA_DELTA_UPDATE != 0U ) */
+
+        #if ( OTA_COMPRESSED_UPDATE != 0U )
+            if( ( xErr == kOTA_Err_None ) && ( C->ulCompression != 0U ) )
+            {
+                OTA_DecompressWrite_t xWrite = prvInOrderWriteImage;
+
+                #if ( OTA_DELTA_UPDATE != 0U )
+                    if( C->ulDeltaFormat != 0U )
+                    {
+                        xWrite = prvDecompressToPatch;
+                    }
+                #endif
+
+                pxIngest->pucWindow = ( uint8_t * ) pvPortMalloc( OTA_DECOMPRESS_WINDOW_SIZE ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+
+                if( pxIngest->pucWindow == NULL )
+                {
+                    xErr = kOTA_Err_OutOfMemory;
+                }
+                else if( OTA_Decompress_Init( &pxIngest->xDecompress,
+                                              pxIngest->pucWindow,
+                                              OTA_DECOMPRESS_WINDOW_SIZE,
+                                              xWrite,
+                                              C ) != eOTA_DecompressErr_None )
+                {
+                    OTA_LOG_L1( "[%s] Error: otaconfigDECOMPRESS_WINDOW_SIZE must be a power of 2 from 16 to 4096.\r\n", OTA_METHOD_NAME );
+                    xErr = kOTA_Err_DecompressFailed | ( uint32_t ) eOTA_DecompressErr_BadParams;
+                }
+                else
+                {
+                    /* Ready to decompress. */
+                }
+            }
+        #endif /* if ( OTA_COMPRESSED_UPDATE != 0U ) */
+
+        if( xErr == kOTA_Err_OutOfMemory )
+        {
+            OTA_LOG_L1( "[%s] Error: Unable to allocate in order processing buffers.\r\n", OTA_METHOD_NAME );
+        }
+
+        if( xErr != kOTA_Err_None )
+        {
+            prvInOrderRelease( C );
+        }
+
+        return xErr;
+    }
+
+    static IngestResult_t prvInOrderIngestBlock( OTA_FileContext_t * C,
+                                                 uint32_t ulBlockIndex,
+                                                 const uint8_t * pucData,
+                                                 uint32_t ulBlockSize,
+                                                 OTA_Err_t * pxCloseResult )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvInOrderIngestBlock" );
+
+        OTA_InOrderIngest_t * pxIngest = &xOTA_Agent.xInOrderIngest;
+        IngestResult_t eIngestResult = eIngest_Result_Accepted_Continue;
+        OTA_Err_t xErr = kOTA_Err_None;
+        uint32_t ulNumBlocks = OTA_FILE_NUM_BLOCKS( C );
+        uint32_t ulSlot = 0;
+        uint32_t ulSize = 0;
+
+        if( ulBlockIndex == pxIngest->ulNextBlock )
+        {
+            xErr = prvInOrderProcess( C, pucData, ulBlockSize );
+            pxIngest->ulNextBlock++;
+
+            /* Process any staged blocks that now follow in order. */
+            ulSlot = pxIngest->ulNextBlock % OTA_IN_ORDER_STAGING_BLOCKS;
+
+            while( ( xErr == kOTA_Err_None ) && ( ( pxIngest->ulStagedMask & ( 1UL << ulSlot ) ) != 0U ) )
+            {
+                ulSize = C->ulFileSize - ( pxIngest->ulNextBlock * C->ulBlockSize );
+
+                if( ulSize > C->ulBlockSize )
+                {
+                    ulSize = C->ulBlockSize;
+                }
+
+                xErr = prvInOrderProcess( C, &pxIngest->pucStaging[ ulSlot * C->ulBlockSize ], ulSize );
+                pxIngest->ulStagedMask &= ~( 1UL << ulSlot );
+                pxIngest->ulNextBlock++;
+                ulSlot = pxIngest->ulNextBlock % OTA_IN_ORDER_STAGING_BLOCKS;
+            }
+
+            /* The whole file has been processed once the last block is. */
+            if( ( xErr == kOTA_Err_None ) && ( pxIngest->ulNextBlock == ulNumBlocks ) )
+            {
+                xErr = prvInOrderFinish( C );
+                prvInOrderRelease( C );
+            }
+
+            if( xErr != kOTA_Err_None )
+            {
+                OTA_LOG_L1( "[%s] Error (0x%08x) processing block %u in order\r\n", OTA_METHOD_NAME, xErr, pxIngest->ulNextBlock - 1U );
+
+                if( ( xErr & kOTA_Main_ErrMask ) == kOTA_Err_DecompressFailed )
+                {
+                    eIngestResult = eIngest_Result_DecompressFailed;
+                }
+                else
+                {
+                    eIngestResult = eIngest_Result_PatchFailed;
+                }
+            }
+        }
+        else if( ( ulBlockIndex > pxIngest->ulNextBlock ) &&
+                 ( ( ulBlockIndex - pxIngest->ulNextBlock ) <= OTA_IN_ORDER_STAGING_BLOCKS ) )
+        {
+            /* Hold the block until the blocks before it have been processed. */
+            ulSlot = ulBlockIndex % OTA_IN_ORDER_STAGING_BLOCKS;
+            ( void ) memcpy( &pxIngest->pucStaging[ ulSlot * C->ulBlockSize ], pucData, ulBlockSize );
+            pxIngest->ulStagedMask |= 1UL << ulSlot;
+        }
+        else
+        {
+            OTA_LOG_L2( "[%s] Block %u is too far ahead of block %u, deferring it.\r\n", OTA_METHOD_NAME, ulBlockIndex, pxIngest->ulNextBlock );
+            eIngestResult = eIngest_Result_Deferred_Continue;
+        }
+
+        *pxCloseResult = xErr;
+
+        return eIngestResult;
+    }
+
+    static OTA_Err_t prvInOrderProcess( const OTA_FileContext_t * C,
+                                        const uint8_t * pucData,
+                                        uint32_t ulLength )
+    {
+        OTA_InOrderIngest_t * pxIngest = &xOTA_Agent.xInOrderIngest;
+        OTA_Err_t xErr = kOTA_Err_None;
+
+        #if ( OTA_COMPRESSED_UPDATE != 0U )
+            if( C->ulCompression != 0U )
+            {
+                /* A compressed delta patch reaches the patch applier as it is decompressed. */
+                OTA_DecompressErr_t eErr = OTA_Decompress_Apply( &pxIngest->xDecompress, pucData, ulLength );
+
+                if( eErr != eOTA_DecompressErr_None )
+                {
+                    xErr = kOTA_Err_DecompressFailed | ( uint32_t ) eErr;
+                }
+            }
+        #endif
+
+        #if ( OTA_DELTA_UPDATE != 0U )
+            if( ( C->ulCompression == 0U ) && ( C->ulDeltaFormat != 0U ) )
+            {
+                OTA_DeltaErr_t eErr = OTA_Delta_Apply( &pxIngest->xPatch, pucData, ulLength );
+
+                if( eErr != eOTA_DeltaErr_None )
+                {
+                    xErr = kOTA_Err_PatchFailed | ( uint32_t ) eErr;
+                }
+            }
+        #endif
+
+        return xErr;
+    }
+
+    static OTA_Err_t prvInOrderFinish( const OTA_FileContext_t * C )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvInOrderFinish" );
+
+        OTA_InOrderIngest_t * pxIngest = &xOTA_Agent.xInOrderIngest;
+        OTA_Err_t xErr = kOTA_Err_None;
+
+        #if ( OTA_COMPRESSED_UPDATE != 0U )
+            if( C->ulCompression != 0U )
+            {
+                /* This also passes the end of a compressed patch to the patch applier. */
+                OTA_DecompressErr_t eErr = OTA_Decompress_Finish( &pxIngest->xDecompress );
+
+                if( eErr != eOTA_DecompressErr_None )
+                {
+                    xErr = kOTA_Err_DecompressFailed | ( uint32_t ) eErr;
+                }
+            }
+        #endif
+
+        #if ( OTA_DELTA_UPDATE != 0U )
+            if( ( xErr == kOTA_Err_None ) && ( C->ulDeltaFormat != 0U ) )
+            {
+                OTA_DeltaErr_t eErr = OTA_Delta_Finish( &pxIngest->xPatch );
+
+                if( eErr != eOTA_DeltaErr_None )
+                {
+                    xErr = kOTA_Err_PatchFailed | ( uint32_t ) eErr;
+                }
+            }
+        #endif
+
+        /* The image must be the size the job document gave the PAL. */
+        if( ( xErr == kOTA_Err_None ) && ( pxIngest->ulImageEnd != C->ulImageSize ) )
+        {
+            OTA_LOG_L1( "[%s] Error: Image is %u bytes, expected %u.\r\n", OTA_METHOD_NAME, pxIngest->ulImageEnd, C->ulImageSize );
+            xErr = ( C->ulDeltaFormat != 0U ) ? ( kOTA_Err_PatchFailed | ( uint32_t ) eOTA_DeltaErr_Incomplete ) :
+                   ( kOTA_Err_DecompressFailed | ( uint32_t ) eOTA_DecompressErr_Incomplete );
+        }
+
+        return xErr;
+    }
+
+    static void prvInOrderRelease( const OTA_FileContext_t * C )
+    {
+        OTA_InOrderIngest_t * pxIngest = &xOTA_Agent.xInOrderIngest;
+
+        if( pxIngest->pxFile == C )
+        {
+            vPortFree( pxIngest->pucStaging );
+            vPortFree( pxIngest->pucOutput );
+            vPortFree( pxIngest->pucWindow );
+            ( void ) memset( pxIngest, 0, sizeof( OTA_InOrderIngest_t ) );
+        }
+    }
+
+    static int32_t prvInOrderWriteImage( void * pvContext,
+                                         uint32_t ulOffset,
+                                         uint8_t * pucData,
+                                         uint32_t ulLength )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvInOrderWriteImage" );
+
+        OTA_FileContext_t * C = ( OTA_FileContext_t * ) pvContext;
+        int32_t lWritten = -1;
+
+        /* The PAL created the file for the image size in the job document, so don't write past it. */
+        if( ( ulOffset > C->ulImageSize ) || ( ulLength > ( C->ulImageSize - ulOffset ) ) )
+        {
+            OTA_LOG_L1( "[%s] Error: Write of %u bytes at %u is past the %u byte image.\r\n", OTA_METHOD_NAME, ulLength, ulOffset, C->ulImageSize );
+        }
+        else
+        {
+            lWritten = xOTA_Agent.xPALCallbacks.xWriteBlock( C, ulOffset, pucData, ulLength );
+        }
+
+        if( lWritten >= 0 )
+        {
+            xOTA_Agent.xInOrderIngest.ulImageEnd = ulOffset + ulLength;
+
+            #if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+                if( C->pvSigVerifyContext != NULL )
+                {
+                    ( void ) CRYPTO_SignatureVerificationUpdate( C->pvSigVerifyContext, pucData, ulLength );
+                }
+            #endif
+        }
+
+        return lWritten;
+    }
+
+#endif /* if ( OTA_IN_ORDER_INGEST != 0U ) */
+
+#if ( OTA_DELTA_UPDATE != 0U )
+
+    static int32_t prvDeltaReadBase( void * pvContext,
+                                     uint32_t ulOffset,
+                                     uint8_t * pucData,
+                                     uint32_t ulLength )
+    {
+        return xOTA_Agent.xPALCallbacks.xReadActiveImage( ( OTA_FileContext_t * ) pvContext, ulOffset, pucData, ulLength );
+    }
+
+#endif
+
+#if ( OTA_DELTA_UPDATE != 0U ) && ( OTA_COMPRESSED_UPDATE != 0U )
+
+    static int32_t prvDecompressToPatch( void * pvContext,
+                                         uint32_t ulOffset,
+                                         uint8_t * pucData,
+                                         uint32_t ulLength )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvDecompressToPatch" );
+
+        int32_t lWritten = ( int32_t ) ulLength;
+        OTA_DeltaErr_t eErr = OTA_Delta_Apply( &xOTA_Agent.xInOrderIngest.xPatch, pucData, ulLength );
+
+        ( void ) pvContext;
+        ( void ) ulOffset;
+
+        if( eErr != eOTA_DeltaErr_None )
+        {
+            OTA_LOG_L1( "[%s] Error (%d) applying decompressed delta patch\r\n", OTA_METHOD_NAME, ( int32_t ) eErr );
+            lWritten = -1;
+        }
+
+        return lWritten;
+    }
+
+#endif
+
+#if ( OTA_CHECKPOINT_BLOCKS != 0U )
+
+    static bool prvCheckpointResume( OTA_FileContext_t * C,
+                                     uint32_t ulBitmapLen )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvCheckpointResume" );
+
+        OTA_Checkpoint_t * pxCheckpoint = &xOTA_Agent.xCheckpoint;
+        OTA_CheckpointHeader_t * pxHeader = NULL;
+        const uint8_t * pucSavedBitmap = NULL;
+        int32_t lLength = 0;
+        uint32_t ulIndex = 0;
+        uint32_t ulRemaining = 0;
+        uint8_t ucBits = 0;
+        bool bResumed = false;
+
+        /* Only one file of a job is checkpointed, the first one to be opened. */
+        if( pxCheckpoint->pxFile == C )
+        {
+            vPortFree( pxCheckpoint->pucBuffer );
+            ( void ) memset( pxCheckpoint, 0, sizeof( OTA_Checkpoint_t ) );
+        }
+
+        /* Patched and decompressed files are processed as a stream that can't be picked up part way through. */
+        if( ( pxCheckpoint->pxFile == NULL ) &&
+            ( xOTA_Agent.xPALCallbacks.xSaveCheckpoint != NULL ) &&
+            ( xOTA_Agent.xPALCallbacks.xResumeFileForRx != NULL ) &&
+            ( C->ulDeltaFormat == 0U ) &&
+            ( C->ulCompression == 0U ) &&
+            ( C->pxSignature != NULL ) )
+        {
+            pxCheckpoint->ulLength = sizeof( OTA_CheckpointHeader_t ) + ulBitmapLen;
+            pxCheckpoint->pucBuffer = ( uint8_t * ) pvPortMalloc( pxCheckpoint->ulLength ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+
+            if( pxCheckpoint->pucBuffer == NULL )
+            {
+                OTA_LOG_L1( "[%s] Warning: Unable to allocate a download checkpoint.\r\n", OTA_METHOD_NAME );
+                pxCheckpoint->ulLength = 0;
+            }
+            else
+            {
+                pxCheckpoint->pxFile = C;
+                pxHeader = ( OTA_CheckpointHeader_t * ) pxCheckpoint->pucBuffer; /*lint !e9087 The buffer is allocated for the header. */
+                pucSavedBitmap = &pxCheckpoint->pucBuffer[ sizeof( OTA_CheckpointHeader_t ) ];
+                lLength = xOTA_Agent.xPALCallbacks.xResumeFileForRx( C, pxCheckpoint->pucBuffer, pxCheckpoint->ulLength );
+
+                if( lLength > 0 )
+                {
+                    if( ( ( uint32_t ) lLength == pxCheckpoint->ulLength ) &&
+                        ( pxHeader->ulMagic == OTA_CHECKPOINT_MAGIC ) &&
+                        ( pxHeader->ulServerFileID == C->ulServerFileID ) &&
+                        ( pxHeader->ulFileSize == C->ulFileSize ) &&
+                        ( pxHeader->ulBlockSize == C->ulBlockSize ) &&
+                        ( pxHeader->usSignatureSize == C->pxSignature->usSize ) &&
+                        ( memcmp( pxHeader->ucSignature, C->pxSignature->ucData, C->pxSignature->usSize ) == 0 ) )
+                    {
+                        /* Count the blocks still needed. Out of range blocks stay marked as received. */
+                        for( ulIndex = 0U; ulIndex < ulBitmapLen; ulIndex++ )
+                        {
+                            ucBits = C->pucRxBlockBitmap[ ulIndex ] & pucSavedBitmap[ ulIndex ];
+
+                            while( ucBits != 0U )
+                            {
+                                ucBits &= ( uint8_t ) ( ucBits - 1U );
+                                ulRemaining++;
+                            }
+                        }
+
+                        if( ulRemaining > 0U )
+                        {
+                            /* Take the blocks received before the reset. */
+                            for( ulIndex = 0U; ulIndex < ulBitmapLen; ulIndex++ )
+                            {
+                                C->pucRxBlockBitmap[ ulIndex ] &= pucSavedBitmap[ ulIndex ];
+                            }
+
+                            OTA_LOG_L1( "[%s] Resuming download with %u of %u blocks remaining.\r\n",
+                                        OTA_METHOD_NAME,
+                                        ulRemaining,
+                                        C->ulBlocksRemaining );
+                            C->ulBlocksRemaining = ulRemaining;
+                            bResumed = true;
+                        }
+                    }
+
+                    if( bResumed == false )
+                    {
+                        /* The checkpoint is for another file or nothing would be left to receive, so start over. */
+                        OTA_LOG_L1( "[%s] Discarding download checkpoint that doesn't match the job.\r\n", OTA_METHOD_NAME );
+                        ( void ) xOTA_Agent.xPALCallbacks.xAbort( C );
+                    }
+                }
+
+                if( ( lLength != 0 ) && ( bResumed == false ) )
+                {
+                    ( void ) xOTA_Agent.xPALCallbacks.xSaveCheckpoint( C, NULL, 0 );
+                }
+
+                /* Identify the file in every checkpoint stored from now on. */
+                ( void ) memset( pxHeader, 0, sizeof( OTA_CheckpointHeader_t ) );
+                pxHeader->ulMagic = OTA_CHECKPOINT_MAGIC;
+                pxHeader->ulServerFileID = C->ulServerFileID;
+                pxHeader->ulFileSize = C->ulFileSize;
+                pxHeader->ulBlockSize = C->ulBlockSize;
+                pxHeader->usSignatureSize = C->pxSignature->usSize;
+                ( void ) memcpy( pxHeader->ucSignature, C->pxSignature->ucData, C->pxSignature->usSize );
+            }
+        }
 
-    return xTimerStarted;
-}
+        return bResumed;
+    }
 
-/* When the self test response timer expires, reset the device since we're likely broken. */
+    static void prvCheckpointBlockAccepted( OTA_FileContext_t * C )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvCheckpointBlockAccepted" );
 
-static void prvSelfTestTimer_Callback( TimerHandle_t T )
-{
-    DEFINE_OTA_METHOD_NAME( "prvSelfTestTimer_Callback" );
-    ( void ) T;
+        OTA_Checkpoint_t * pxCheckpoint = &xOTA_Agent.xCheckpoint;
 
-    OTA_LOG_L1( "[%s] Self test failed to complete within %ums\r\n", OTA_METHOD_NAME, otaconfigSELF_TEST_RESPONSE_WAIT_MS );
-    ( void ) xOTA_Agent.xPALCallbacks.xResetDevice( xOTA_Agent.ulServerFileID );
-}
+        if( ( pxCheckpoint->pxFile == C ) && ( C->ulBlocksRemaining > 0U ) )
+        {
+            pxCheckpoint->ulBlocksSinceSave++;
 
-/* Stop the OTA self test timer if it is running. */
+            if( pxCheckpoint->ulBlocksSinceSave >= OTA_CHECKPOINT_BLOCKS )
+            {
+                pxCheckpoint->ulBlocksSinceSave = 0;
+                ( void ) memcpy( &pxCheckpoint->pucBuffer[ sizeof( OTA_CheckpointHeader_t ) ],
+                                 C->pucRxBlockBitmap,
+                                 pxCheckpoint->ulLength - sizeof( OTA_CheckpointHeader_t ) );
 
-static void prvStopSelfTestTimer( void )
-{
-    DEFINE_OTA_METHOD_NAME( "prvStopSelfTestTimer" );
+                if( xOTA_Agent.xPALCallbacks.xSaveCheckpoint( C, pxCheckpoint->pucBuffer, pxCheckpoint->ulLength ) != kOTA_Err_None )
+                {
+                    /* Not fatal. A reset will resume from the previous checkpoint or start over. */
+                    OTA_LOG_L1( "[%s] Warning: Unable to store download checkpoint.\r\n", OTA_METHOD_NAME );
+                }
+            }
+        }
+    }
 
-    if( xOTA_Agent.pvSelfTestTimer != NULL )
+    static void prvCheckpointRelease( OTA_FileContext_t * C,
+                                      bool bErase )
     {
-        ( void ) xTimerStop( xOTA_Agent.pvSelfTestTimer, portMAX_DELAY );
-        OTA_LOG_L1( "[%s] Stopping the self test timer.\r\n", OTA_METHOD_NAME );
-    }
-}
+        OTA_Checkpoint_t * pxCheckpoint = &xOTA_Agent.xCheckpoint;
 
-/*
- * When the OTA request timer expires, signal the OTA task to request the file.
- */
+        if( ( C != NULL ) && ( pxCheckpoint->pxFile == C ) )
+        {
+            if( bErase == true )
+            {
+                ( void ) xOTA_Agent.xPALCallbacks.xSaveCheckpoint( C, NULL, 0 );
+            }
 
-static void prvRequestTimer_Callback( TimerHandle_t T )
-{
-    ( void ) T;
-    OTA_EventMsg_t xEventMsg = { 0 };
+            vPortFree( pxCheckpoint->pucBuffer );
+            ( void ) memset( pxCheckpoint, 0, sizeof( OTA_Checkpoint_t ) );
+        }
+    }
 
-    /*
-     * Send event to OTA agent task.
-     */
-    xEventMsg.xEventId = eOTA_AgentEvent_RequestTimer;
-    ( void ) OTA_SignalEvent( &xEventMsg );
-}
+#endif /* if ( OTA_CHECKPOINT_BLOCKS != 0U ) */
 
 /* Create and start or reset the OTA request timer to kick off the process if needed.
  * Do not output an important log message on reset since this gets called every time a file
@@ -786,6 +1744,24 @@ static void prvSetPALCallbacks( const OTA_PAL_Callbacks_t * pxCallbacks )
     {
         xOTA_Agent.xPALCallbacks.xCustomJobCallback = prvDefaultCustomJobCallback;
     }
+
+    /* Reading the active image is optional and only needed for delta updates. */
+    xOTA_Agent.xPALCallbacks.xReadActiveImage = pxCallbacks->xReadActiveImage;
+
+    /* Checkpoints are optional. Downloads start over after a reset if either hook is missing. */
+    if( ( pxCallbacks->xSaveCheckpoint != NULL ) || ( pxCallbacks->xResumeFileForRx != NULL ) )
+    {
+        xOTA_Agent.xPALCallbacks.xSaveCheckpoint = pxCallbacks->xSaveCheckpoint;
+        xOTA_Agent.xPALCallbacks.xResumeFileForRx = pxCallbacks->xResumeFileForRx;
+    }
+    else
+    {
+        xOTA_Agent.xPALCallbacks.xSaveCheckpoint = OTA_PAL_SAVE_CHECKPOINT_DEFAULT;
+        xOTA_Agent.xPALCallbacks.xResumeFileForRx = OTA_PAL_RESUME_FILE_FOR_RX_DEFAULT;
+    }
+
+    /* Every file uses the largest block size if the application doesn't choose. */
+    xOTA_Agent.xPALCallbacks.xSelectBlockSize = pxCallbacks->xSelectBlockSize;
 }
 
 static OTA_Err_t prvStartHandler( OTA_EventData_t * pxEventData )
@@ -905,7 +1881,7 @@ static OTA_Err_t prvProcessJobHandler( OTA_EventData_t * pxEventData )
     /*
      * Parse the job document and update file information in the file context.
      */
-    xOTAFileContext = prvGetFileContextFromJob( ( const char * ) pxEventData->ucData,
+    xOTAFileContext = prvGetFileContextFromJob( ( const char * ) pxEventData->pucData,
                                                 pxEventData->ulDataLength );
 
     /*
@@ -956,6 +1932,12 @@ static OTA_Err_t prvProcessJobHandler( OTA_EventData_t * pxEventData )
             /* Init data interface routines */
             xReturn = prvSetDataInterface( &xOTA_DataInterface, xOTA_Agent.pxOTA_Files[ xOTA_Agent.ulFileIndex ].pucProtocols );
 
+            if( ( xReturn == kOTA_Err_None ) && ( prvFilesReceiving() > xOTA_DataInterface.ulMaxFiles ) )
+            {
+                OTA_LOG_L1( "[%s] The data protocol can't receive %u files at once.\r\n", OTA_METHOD_NAME, prvFilesReceiving() );
+                xReturn = kOTA_Err_InvalidDataProtocol;
+            }
+
             if( xReturn == kOTA_Err_None )
             {
                 OTA_LOG_L1( "[%s] Setting OTA data inerface.\r\n", OTA_METHOD_NAME );
@@ -998,10 +1980,25 @@ static OTA_Err_t prvProcessJobHandler( OTA_EventData_t * pxEventData )
 static OTA_Err_t prvInitFileHandler( OTA_EventData_t * pxEventData )
 {
     ( void ) pxEventData;
-    OTA_Err_t xErr = kOTA_Err_Uninitialized;
+    OTA_Err_t xErr = kOTA_Err_None;
     OTA_EventMsg_t xEventMsg = { 0 };
+    uint32_t ulIndex;
+
+    prvShareEventBuffers();
+
+    /* Start the transfer of every file of the job. */
+    for( ulIndex = 0U; ( xErr == kOTA_Err_None ) && ( ulIndex < OTA_MAX_FILES ); ulIndex++ )
+    {
+        if( xOTA_Agent.pxOTA_Files[ ulIndex ].ulBlocksRemaining > 0U )
+        {
+            xOTA_Agent.ulFileIndex = ulIndex;
 
-    xErr = xOTA_DataInterface.prvInitFileTransfer( &xOTA_Agent );
+            /* The data interface enables windowed requests if it supports them. */
+            ( void ) memset( &xOTA_Agent.pxFileRequests[ ulIndex ].xRequestWindow, 0, sizeof( OTA_RequestWindow_t ) );
+
+            xErr = xOTA_DataInterface.prvInitFileTransfer( &xOTA_Agent );
+        }
+    }
 
     if( xErr != kOTA_Err_None )
     {
@@ -1052,17 +2049,40 @@ static OTA_Err_t prvRequestDataHandler( OTA_EventData_t * pxEventData )
 {
     ( void ) pxEventData;
     OTA_Err_t xErr = kOTA_Err_Uninitialized;
+    OTA_Err_t xFileErr = kOTA_Err_Uninitialized;
     OTA_EventMsg_t xEventMsg = { 0 };
+    uint32_t ulIndex;
 
-    if( xOTA_Agent.pxOTA_Files[ xOTA_Agent.ulFileIndex ].ulBlocksRemaining > 0U )
+    if( prvFilesReceiving() > 0U )
     {
         /* Start the request timer. */
         prvStartRequestTimer( otaconfigFILE_REQUEST_WAIT_MS );
 
         if( xOTA_Agent.ulRequestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM )
         {
-            /* Request data blocks. */
-            xErr = xOTA_DataInterface.prvRequestFileBlock( &xOTA_Agent );
+            xErr = kOTA_Err_None;
+
+            /* Request data blocks of every file still missing some. */
+            for( ulIndex = 0U; ulIndex < OTA_MAX_FILES; ulIndex++ )
+            {
+                if( xOTA_Agent.pxOTA_Files[ ulIndex ].ulBlocksRemaining > 0U )
+                {
+                    xOTA_Agent.ulFileIndex = ulIndex;
+
+                    /* Blocks still in flight when the request timer fires are treated as lost. */
+                    if( xOTA_Agent.pxFileRequests[ ulIndex ].xRequestWindow.ulSize > 0U )
+                    {
+                        prvRequestWindowRestart( &xOTA_Agent.pxFileRequests[ ulIndex ] );
+                    }
+
+                    xFileErr = xOTA_DataInterface.prvRequestFileBlock( &xOTA_Agent );
+
+                    if( xFileErr != kOTA_Err_None )
+                    {
+                        xErr = xFileErr;
+                    }
+                }
+            }
 
             /* Each request increases the momentum until a response is received. Too much momentum is
              * interpreted as a failure to communicate and will cause us to abort the OTA. */
@@ -1105,17 +2125,39 @@ static OTA_Err_t prvProcessDataHandler( OTA_EventData_t * pxEventData )
     OTA_Err_t xErr = kOTA_Err_Uninitialized;
     OTA_Err_t xCloseResult = kOTA_Err_Uninitialized;
     OTA_EventMsg_t xEventMsg = { 0 };
+    IngestResult_t xResult = eIngest_Result_Duplicate_Continue;
+    OTA_FileRequest_t * pxRequest = NULL;
+
+    /* Get the context of the file the block belongs to. */
+    OTA_FileContext_t * pxFileContext = prvGetFileForBlock( pxEventData );
 
-    /* Get the file context. */
-    OTA_FileContext_t * pxFileContext = &xOTA_Agent.pxOTA_Files[ xOTA_Agent.ulFileIndex ];
+    if( pxFileContext != NULL )
+    {
+        pxRequest = &xOTA_Agent.pxFileRequests[ xOTA_Agent.ulFileIndex ];
+
+        /* Ingest data blocks received. */
+        xResult = prvIngestDataBlock( pxFileContext,
+                                      pxEventData->pucData,
+                                      pxEventData->ulDataLength,
+                                      &xCloseResult );
+    }
+    else
+    {
+        /* A late copy of a block of a file that has already been received. */
+        OTA_LOG_L2( "[%s] Dropping block for a file that is not being received.\r\n", OTA_METHOD_NAME );
+    }
 
-    /* Ingest data blocks received. */
-    IngestResult_t xResult = prvIngestDataBlock( pxFileContext,
-                                                 pxEventData->ucData,
-                                                 pxEventData->ulDataLength,
-                                                 &xCloseResult );
+    xOTA_Agent.xStatistics.ulOTA_PacketsProcessed++;
 
-    if( xResult < eIngest_Result_Accepted_Continue )
+    if( ( xResult == eIngest_Result_FileComplete ) && ( prvFilesReceiving() > 0U ) )
+    {
+        /* The job is done once its last file is received, so keep requesting the others. */
+        OTA_LOG_L1( "[%s] File received, %u more files of the job to receive.\r\n", OTA_METHOD_NAME, prvFilesReceiving() );
+        xOTA_Agent.ulRequestMomentum = 0;
+        prvShareEventBuffers();
+        prvStartRequestTimer( otaconfigFILE_REQUEST_WAIT_MS );
+    }
+    else if( xResult < eIngest_Result_Accepted_Continue )
     {
         /* Negative result codes mean we should stop the OTA process
          * because we are either done or in an unrecoverable error state.
@@ -1188,9 +2230,50 @@ static OTA_Err_t prvProcessDataHandler( OTA_EventData_t * pxEventData )
             }
         }
 
-        if( xOTA_Agent.ulNumOfBlocksToReceive > 1U )
+        if( pxRequest == NULL )
+        {
+            /* Nothing to request for a block that wasn't ingested. */
+        }
+        else if( pxRequest->xRequestWindow.ulSize > 0U )
+        {
+            #if ( OTA_IN_ORDER_INGEST != 0U )
+                /* A deferred block is still missing but the window has moved past it,
+                 * so start the next request from the block in order processing needs.
+                 * The in order cursor is only meaningful for the file it belongs to. */
+                if( ( xResult == eIngest_Result_Deferred_Continue ) &&
+                    ( xOTA_Agent.xInOrderIngest.pxFile == pxFileContext ) &&
+                    ( pxRequest->xRequestWindow.ulNextBlock > xOTA_Agent.xInOrderIngest.ulNextBlock ) )
+                {
+                    pxRequest->xRequestWindow.ulNextBlock = xOTA_Agent.xInOrderIngest.ulNextBlock;
+                }
+            #endif
+
+            #if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+                /* The same holds for a block deferred by the streaming hash. */
+                if( ( xResult == eIngest_Result_Deferred_Continue ) &&
+                    ( xOTA_Agent.xStreamingHash.pxFile == pxFileContext ) &&
+                    ( pxRequest->xRequestWindow.ulNextBlock > xOTA_Agent.xStreamingHash.ulNextBlock ) )
+                {
+                    pxRequest->xRequestWindow.ulNextBlock = xOTA_Agent.xStreamingHash.ulNextBlock;
+                }
+            #endif
+
+            /* Keep the window full by requesting more blocks as blocks land rather
+             * than waiting for the whole previous request to be received. */
+            if( prvRequestWindowBlockReceived( pxRequest ) == true )
+            {
+                xErr = xOTA_DataInterface.prvRequestFileBlock( &xOTA_Agent );
+
+                if( xErr != kOTA_Err_None )
+                {
+                    /* The request timer will retry. */
+                    OTA_LOG_L2( "[%s] Failed to request more blocks %d\r\n", OTA_METHOD_NAME, xErr );
+                }
+            }
+        }
+        else if( pxRequest->ulNumOfBlocksToReceive > 1U )
         {
-            xOTA_Agent.ulNumOfBlocksToReceive--;
+            pxRequest->ulNumOfBlocksToReceive--;
         }
         else
         {
@@ -1219,7 +2302,7 @@ static OTA_Err_t prvCloseFileHandler( OTA_EventData_t * pxEventData )
 
     OTA_LOG_L2( "[%s] Closing File. %d\r\n", OTA_METHOD_NAME );
 
-    ( void ) prvOTA_Close( &( xOTA_Agent.pxOTA_Files[ xOTA_Agent.ulFileIndex ] ) );
+    prvCloseJobFiles();
 
     return kOTA_Err_None;
 }
@@ -1236,7 +2319,7 @@ static OTA_Err_t prvUserAbortHandler( OTA_EventData_t * pxEventData )
 
         if( xErr == kOTA_Err_None )
         {
-            ( void ) prvOTA_Close( &( xOTA_Agent.pxOTA_Files[ xOTA_Agent.ulFileIndex ] ) );
+            prvCloseJobFiles();
         }
     }
 
@@ -1311,7 +2394,7 @@ static OTA_Err_t prvJobNotificationHandler( OTA_EventData_t * pxEventData )
 
     /* Abort the current job. */
     ( void ) xOTA_Agent.xPALCallbacks.xSetPlatformImageState( xOTA_Agent.ulServerFileID, eOTA_ImageState_Aborted );
-    ( void ) prvOTA_Close( &xOTA_Agent.pxOTA_Files[ xOTA_Agent.ulFileIndex ] );
+    prvCloseJobFiles();
 
     /* Free the active job name as its no longer required. */
     if( xOTA_Agent.pcOTA_Singleton_ActiveJobName != NULL )
@@ -1357,47 +2440,189 @@ static OTA_Err_t prvResetDevice( void )
 
 void prvOTAEventBufferFree( OTA_EventData_t * const pxBuffer )
 {
-    DEFINE_OTA_METHOD_NAME( "prvOTAEventBufferFree" );
+    /* Release the transport buffer the data was received in, if the event owns it. */
+    if( pxBuffer->pvReceivedData != NULL )
+    {
+        pxBuffer->vFreeReceivedData( pxBuffer->pvReceivedData );
+        pxBuffer->pvReceivedData = NULL;
+    }
+
+    pxBuffer->bBufferUsed = false;
+    prvEventBufferPush( pxBuffer );
+
+    /* The pool can only be carved again once no event holds a part of it. */
+    if( ( Atomic_Decrement_u32( &ulEventBuffersInUse ) == 1U ) &&
+        ( ulEventBufferPendingSize != ulEventBufferSize ) )
+    {
+        prvEventBufferCarveIfIdle();
+    }
+}
+
+OTA_EventData_t * prvOTAEventBufferGet( void )
+{
+    OTA_EventData_t * pxOTAFreeMsg = NULL;
 
-    if( xSemaphoreTake( xOTA_Agent.xOTA_ThreadSafetyMutex, portMAX_DELAY ) == pdPASS )
+    /* Count the buffer as used before taking it so the pool is never carved under it. */
+    if( ( Atomic_Increment_u32( &ulEventBuffersInUse ) & OTA_EVENT_BUFFER_CARVING ) != 0U )
     {
-        pxBuffer->bBufferUsed = false;
-        ( void ) xSemaphoreGive( xOTA_Agent.xOTA_ThreadSafetyMutex );
+        /* The pool is being carved on another core. That is done in a critical section
+         * and takes a few steps per buffer, so wait for it rather than drop the event. */
+        while( ( ulEventBuffersInUse & OTA_EVENT_BUFFER_CARVING ) != 0U )
+        {
+        }
+    }
+
+    pxOTAFreeMsg = prvEventBufferPop();
+
+    if( pxOTAFreeMsg != NULL )
+    {
+        pxOTAFreeMsg->bBufferUsed = true;
+        pxOTAFreeMsg->pucData = pxOTAFreeMsg->pucBuffer;
     }
     else
     {
-        OTA_LOG_L1( "Error: Could not take semaphore for freeing message buffer.\r\n" );
+        if( ( Atomic_Decrement_u32( &ulEventBuffersInUse ) == 1U ) &&
+            ( ulEventBufferPendingSize != ulEventBufferSize ) )
+        {
+            prvEventBufferCarveIfIdle();
+        }
+
+        OTA_LOG_L2( "No free event buffer.\r\n" );
     }
+
+    return pxOTAFreeMsg;
 }
 
-OTA_EventData_t * prvOTAEventBufferGet( void )
+static void prvEventBufferPushChain( uint32_t ulFirstLink,
+                                     uint32_t ulLastLink )
 {
-    DEFINE_OTA_METHOD_NAME( "prvOTAEventBufferGet" );
+    uint32_t ulHead = 0;
+    uint32_t ulNewHead = 0;
 
-    uint32_t ulIndex = 0;
-    OTA_EventData_t * pxOTAFreeMsg = NULL;
+    do
+    {
+        ulHead = ulEventBufferFreeHead;
+        ulEventBufferNext[ ulLastLink - 1U ] = ulHead & OTA_EVENT_BUFFER_LINK_MASK;
+        ulNewHead = ( ( ulHead & ~OTA_EVENT_BUFFER_LINK_MASK ) + OTA_EVENT_BUFFER_TAG_INCREMENT ) | ulFirstLink;
+    } while( Atomic_CompareAndSwap_u32( &ulEventBufferFreeHead, ulNewHead, ulHead ) != ATOMIC_COMPARE_AND_SWAP_SUCCESS );
+}
 
-    /* Wait at most 1 task switch for a buffer so as not to block the callback. */
-    if( xSemaphoreTake( xOTA_Agent.xOTA_ThreadSafetyMutex, 1 ) == pdPASS )
+static void prvEventBufferPush( OTA_EventData_t * const pxBuffer )
+{
+    uint32_t ulLink = ( uint32_t ) ( pxBuffer - xEventBuffer ) + 1U;
+
+    prvEventBufferPushChain( ulLink, ulLink );
+}
+
+static OTA_EventData_t * prvEventBufferPop( void )
+{
+    OTA_EventData_t * pxBuffer = NULL;
+    uint32_t ulHead = 0;
+    uint32_t ulLink = 0;
+    uint32_t ulNewHead = 0;
+    bool bDone = false;
+
+    while( bDone == false )
     {
-        for( ulIndex = 0; ulIndex < otaconfigMAX_NUM_OTA_DATA_BUFFERS; ulIndex++ )
+        ulHead = ulEventBufferFreeHead;
+        ulLink = ulHead & OTA_EVENT_BUFFER_LINK_MASK;
+
+        if( ulLink == 0U )
+        {
+            bDone = true;
+        }
+        else
         {
-            if( xEventBuffer[ ulIndex ].bBufferUsed == false )
+            /* The next link may be stale if another task got in first, but then the
+             * tag has moved on and the swap fails. */
+            ulNewHead = ( ( ulHead & ~OTA_EVENT_BUFFER_LINK_MASK ) + OTA_EVENT_BUFFER_TAG_INCREMENT ) |
+                        ulEventBufferNext[ ulLink - 1U ];
+
+            if( Atomic_CompareAndSwap_u32( &ulEventBufferFreeHead, ulNewHead, ulHead ) == ATOMIC_COMPARE_AND_SWAP_SUCCESS )
             {
-                xEventBuffer[ ulIndex ].bBufferUsed = true;
-                pxOTAFreeMsg = &xEventBuffer[ ulIndex ];
-                break;
+                pxBuffer = &xEventBuffer[ ulLink - 1U ];
+                bDone = true;
             }
         }
+    }
+
+    return pxBuffer;
+}
+
+static void prvEventBufferCarve( uint32_t ulBufferSize )
+{
+    uint32_t ulIndex = 0;
+
+    /* Keep every buffer word aligned. */
+    ulEventBufferSize = ( ulBufferSize + ( sizeof( uint32_t ) - 1U ) ) & ~( sizeof( uint32_t ) - 1U );
+    ulEventBufferCount = OTA_EVENT_BUFFER_POOL_SIZE / ulEventBufferSize;
 
-        ( void ) xSemaphoreGive( xOTA_Agent.xOTA_ThreadSafetyMutex );
+    if( ulEventBufferCount > otaconfigMAX_NUM_OTA_DATA_BUFFERS )
+    {
+        ulEventBufferCount = otaconfigMAX_NUM_OTA_DATA_BUFFERS;
     }
-    else
+
+    for( ulIndex = 0; ulIndex < otaconfigMAX_NUM_OTA_DATA_BUFFERS; ulIndex++ )
+    {
+        if( ulIndex < ulEventBufferCount )
+        {
+            xEventBuffer[ ulIndex ].pucBuffer = &ucEventBufferPool[ ulIndex * ulEventBufferSize ];
+            xEventBuffer[ ulIndex ].ulBufferSize = ulEventBufferSize;
+        }
+        else
+        {
+            xEventBuffer[ ulIndex ].pucBuffer = NULL;
+            xEventBuffer[ ulIndex ].ulBufferSize = 0;
+        }
+    }
+
+    /* Link the carved buffers in index order. The caller publishes the list. */
+    for( ulIndex = 1U; ulIndex < ulEventBufferCount; ulIndex++ )
     {
-        OTA_LOG_L1( "Error: Could not take semaphore for getting message buffer.\r\n" );
+        ulEventBufferNext[ ulIndex - 1U ] = ulIndex + 1U;
     }
+}
 
-    return pxOTAFreeMsg;
+static void prvEventBufferCarveIfIdle( void )
+{
+    uint32_t ulHead = 0;
+
+    /*
+     * Claim the pool only if no event buffer is in use. The free list then holds every
+     * buffer and stays in place, so a task that wants a buffer meanwhile waits for the
+     * carve instead of finding the list empty. The critical section keeps that wait short.
+     */
+    portENTER_CRITICAL();
+
+    if( Atomic_CompareAndSwap_u32( &ulEventBuffersInUse, OTA_EVENT_BUFFER_CARVING, 0U ) == ATOMIC_COMPARE_AND_SWAP_SUCCESS )
+    {
+        while( ulEventBufferPendingSize != ulEventBufferSize )
+        {
+            prvEventBufferCarve( ulEventBufferPendingSize );
+        }
+
+        /* Publish the buffers in their carved order. Nothing else updates the list now. */
+        ulEventBufferNext[ ulEventBufferCount - 1U ] = 0U;
+
+        do
+        {
+            ulHead = ulEventBufferFreeHead;
+        } while( Atomic_CompareAndSwap_u32( &ulEventBufferFreeHead,
+                                            ( ( ulHead & ~OTA_EVENT_BUFFER_LINK_MASK ) + OTA_EVENT_BUFFER_TAG_INCREMENT ) | 1U,
+                                            ulHead ) != ATOMIC_COMPARE_AND_SWAP_SUCCESS );
+
+        ( void ) Atomic_AND_u32( &ulEventBuffersInUse, ( uint32_t ) ~OTA_EVENT_BUFFER_CARVING );
+    }
+
+    portEXIT_CRITICAL();
+}
+
+static void prvEventBufferResize( uint32_t ulBufferSize )
+{
+    ulEventBufferPendingSize = ( ulBufferSize + ( sizeof( uint32_t ) - 1U ) ) & ~( sizeof( uint32_t ) - 1U );
+
+    /* Unless a buffer is in use, then the last one to be freed carves the pool. */
+    prvEventBufferCarveIfIdle();
 }
 
 static void prvOTA_FreeContext( OTA_FileContext_t * const C )
@@ -1457,6 +2682,22 @@ static void prvOTA_FreeContext( OTA_FileContext_t * const C )
             vPortFree( C->pucProtocols ); /* Free the pucProtocols string memory. */
             C->pucProtocols = NULL;
         }
+
+        #if ( OTA_IN_ORDER_INGEST != 0U )
+            prvInOrderRelease( C );
+        #endif
+
+        #if ( OTA_CHECKPOINT_BLOCKS != 0U )
+            prvCheckpointRelease( C, false );
+        #endif
+
+        #if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+            /* Only the context of the file being received owns the streaming hash. */
+            if( C->pvSigVerifyContext != NULL )
+            {
+                prvStreamingHashRelease( C, true );
+            }
+        #endif
     }
 }
 
@@ -1467,17 +2708,47 @@ static bool prvOTA_Close( OTA_FileContext_t * const C )
     DEFINE_OTA_METHOD_NAME( "prvOTA_Close" );
 
     bool bResult = false;
+    bool bStreamInUse = false;
+    uint32_t ulIndex;
+    const OTA_FileContext_t * pxOther = NULL;
 
     OTA_LOG_L2( "[%s] Context->0x%p\r\n", OTA_METHOD_NAME, C );
 
+    /* The files of a job usually share a stream, so only the last file to close it cleans up. */
+    for( ulIndex = 0U; ulIndex < OTA_MAX_FILES; ulIndex++ )
+    {
+        pxOther = &xOTA_Agent.pxOTA_Files[ ulIndex ];
+
+        if( pxOther == C )
+        {
+            xOTA_Agent.ulFileIndex = ulIndex;
+        }
+        else if( ( C != NULL ) &&
+                 ( C->pucStreamName != NULL ) &&
+                 ( pxOther->pucStreamName != NULL ) &&
+                 ( strcmp( ( const char * ) C->pucStreamName, ( const char * ) pxOther->pucStreamName ) == 0 ) )
+        {
+            bStreamInUse = true;
+        }
+        else
+        {
+            /* Not a file of the stream. */
+        }
+    }
+
     /* Cleanup related to selected protocol. */
-    if( xOTA_DataInterface.prvCleanup != NULL )
+    if( ( xOTA_DataInterface.prvCleanup != NULL ) && ( bStreamInUse == false ) )
     {
         ( void ) xOTA_DataInterface.prvCleanup( &xOTA_Agent );
     }
 
     if( C != NULL )
     {
+        #if ( OTA_CHECKPOINT_BLOCKS != 0U )
+            /* Checkpoints are only for resuming after a reset, never after the agent gives up on a file. */
+            prvCheckpointRelease( C, true );
+        #endif
+
         /*
          * Abort any active file access and release the file resource, if needed.
          */
@@ -1508,18 +2779,116 @@ static OTA_FileContext_t * prvGetFreeContext( void )
         ulIndex++;
     }
 
-    if( ulIndex != OTA_MAX_FILES )
+    if( ulIndex != OTA_MAX_FILES )
+    {
+        ( void ) memset( &xOTA_Agent.pxOTA_Files[ ulIndex ], 0, sizeof( OTA_FileContext_t ) );
+        C = &xOTA_Agent.pxOTA_Files[ ulIndex ];
+        xOTA_Agent.ulFileIndex = ulIndex;
+    }
+    else
+    {
+        /* Not able to support this request so we'll return NULL. */
+    }
+
+    return C;
+}
+
+/* Find the file a received block belongs to and make it the current file. If the
+ * job has more than one file the block is decoded to get its file ID, so the extra
+ * decode is only paid for by multi-file jobs. */
+
+static OTA_FileContext_t * prvGetFileForBlock( const OTA_EventData_t * pxEventData )
+{
+    uint32_t ulIndex = 0U;
+    int32_t lFileId = 0;
+    int32_t lBlockIndex = 0;
+    int32_t lBlockSize = 0;
+    uint8_t * pucPayload = NULL;
+    size_t xPayloadSize = 0;
+    uint32_t ulJobFiles = 0U;
+    OTA_FileContext_t * C = NULL;
+
+    for( ulIndex = 0U; ulIndex < OTA_MAX_FILES; ulIndex++ )
+    {
+        if( xOTA_Agent.pxOTA_Files[ ulIndex ].pucFilePath != NULL )
+        {
+            ulJobFiles++;
+        }
+    }
+
+    if( ulJobFiles <= 1U )
+    {
+        C = &xOTA_Agent.pxOTA_Files[ xOTA_Agent.ulFileIndex ];
+
+        /* A block queued behind the last one of the file is dropped rather than
+         * failing a job that has already been received. */
+        if( ( C->pucRxBlockBitmap == NULL ) && ( C->ulBlocksRemaining == 0U ) )
+        {
+            C = NULL;
+        }
+    }
+    else if( kOTA_Err_None == xOTA_DataInterface.prvDecodeFileBlock( pxEventData->pucData,
+                                                                      pxEventData->ulDataLength,
+                                                                      &lFileId,
+                                                                      &lBlockIndex,
+                                                                      &lBlockSize,
+                                                                      &pucPayload,
+                                                                      &xPayloadSize ) )
+    {
+        for( ulIndex = 0U; ( C == NULL ) && ( ulIndex < OTA_MAX_FILES ); ulIndex++ )
+        {
+            if( ( xOTA_Agent.pxOTA_Files[ ulIndex ].ulBlocksRemaining > 0U ) &&
+                ( xOTA_Agent.pxOTA_Files[ ulIndex ].ulServerFileID == ( uint32_t ) lFileId ) )
+            {
+                C = &xOTA_Agent.pxOTA_Files[ ulIndex ];
+                xOTA_Agent.ulFileIndex = ulIndex;
+            }
+        }
+    }
+    else
+    {
+        /* Let the current file reject the bad block. */
+        C = &xOTA_Agent.pxOTA_Files[ xOTA_Agent.ulFileIndex ];
+    }
+
+    return C;
+}
+
+/* Count the files of the job that still have blocks to receive. */
+
+static uint32_t prvFilesReceiving( void )
+{
+    uint32_t ulIndex;
+    uint32_t ulFiles = 0U;
+
+    for( ulIndex = 0U; ulIndex < OTA_MAX_FILES; ulIndex++ )
     {
-        ( void ) memset( &xOTA_Agent.pxOTA_Files[ ulIndex ], 0, sizeof( OTA_FileContext_t ) );
-        C = &xOTA_Agent.pxOTA_Files[ ulIndex ];
-        xOTA_Agent.ulFileIndex = ulIndex;
+        if( xOTA_Agent.pxOTA_Files[ ulIndex ].ulBlocksRemaining > 0U )
+        {
+            ulFiles++;
+        }
     }
-    else
+
+    return ulFiles;
+}
+
+/* Close all files of the job. */
+
+static void prvCloseJobFiles( void )
+{
+    uint32_t ulIndex;
+    uint32_t ulCurrent = xOTA_Agent.ulFileIndex;
+
+    for( ulIndex = 0U; ulIndex < OTA_MAX_FILES; ulIndex++ )
     {
-        /* Not able to support this request so we'll return NULL. */
+        if( ( ulIndex != ulCurrent ) && ( xOTA_Agent.pxOTA_Files[ ulIndex ].pucFilePath != NULL ) )
+        {
+            ( void ) prvOTA_Close( &xOTA_Agent.pxOTA_Files[ ulIndex ] );
+        }
     }
 
-    return C;
+    /* The current file is closed last, so it is the one to clean up the data interface. */
+    ( void ) prvOTA_Close( &xOTA_Agent.pxOTA_Files[ ulCurrent ] );
 }
 
 static bool JSON_IsCStringEqual( const char * pcJSONString,
@@ -1596,6 +2965,9 @@ static DocParseErr_t prvParseJSONbyModel( const char * pcJSON,
     uint32_t ulIndex = 0;
     uint16_t usModelParamIndex = 0;
     uint32_t ulScanIndex = 0;
+    uint32_t ulElementEnd = 0;
+    uint32_t ulArrayEnd = 0;
+    uint32_t ulElement = 0;
     DocParseErr_t eErr = eDocParseErr_None;
 
     /* Reset the Jasmine tokenizer. */
@@ -1694,11 +3066,20 @@ static DocParseErr_t prvParseJSONbyModel( const char * pcJSON,
     /* Process JSON tokens. */
     if( eErr == eDocParseErr_None )
     {
+        ulElementEnd = ulNumTokens;
+        ulArrayEnd = ulNumTokens;
+
         /* Examine each JSON token, searching for job parameters based on our document model. */
         for( ulIndex = 0U; ( eErr == eDocParseErr_None ) && ( ulIndex < ulNumTokens ); ulIndex++ )
         {
+            /* Skip the array elements that follow the one being parsed. */
+            if( ulIndex == ulElementEnd )
+            {
+                ulIndex = ulArrayEnd;
+            }
+
             /* All parameter keys are JSON strings. */
-            if( pxTokens[ ulIndex ].type == JSMN_STRING )
+            if( ( ulIndex < ulNumTokens ) && ( pxTokens[ ulIndex ].type == JSMN_STRING ) )
             {
                 /* Search the document model to see if it matches the current key. */
                 ulTokenLen = ( uint32_t ) pxTokens[ ulIndex ].end - ( uint32_t ) pxTokens[ ulIndex ].start;
@@ -1736,6 +3117,51 @@ static DocParseErr_t prvParseJSONbyModel( const char * pcJSON,
                                     pxValTok->type, pxModelParam[ usModelParamIndex ].eJasmineType );
                         eErr = eDocParseErr_FieldTypeMismatch;
                     }
+                    else if( eModelParamType_Array == pxModelParam[ usModelParamIndex ].xModelParamType )
+                    {
+                        /* Only the selected element is parsed. Find where it starts and ends and
+                         * where the array ends. Elements are the direct children of the array. */
+                        int32_t iArray = ( int32_t ) ulIndex + 1; /* Use signed int since the parent index is signed. */
+                        pxDocModel->ulArrayElements = ( uint32_t ) pxValTok->size;
+                        ulElement = 0U;
+                        ulIndex++;
+
+                        for( ulScanIndex = ulIndex + 1UL; ( ulScanIndex < ulNumTokens ) && ( pxTokens[ ulScanIndex ].parent >= iArray ); ulScanIndex++ )
+                        {
+                            if( pxTokens[ ulScanIndex ].parent == iArray )
+                            {
+                                if( ulElement == pxDocModel->ulArrayElement )
+                                {
+                                    ulIndex = ulScanIndex - 1UL; /* Adjust for outer for-loop increment. */
+                                }
+                                else if( ulElement == ( pxDocModel->ulArrayElement + 1UL ) )
+                                {
+                                    ulElementEnd = ulScanIndex;
+                                }
+                                else
+                                {
+                                    /* Not next to the selected element. */
+                                }
+
+                                ulElement++;
+                            }
+                        }
+
+                        ulArrayEnd = ulScanIndex;
+
+                        if( pxDocModel->ulArrayElement >= pxDocModel->ulArrayElements )
+                        {
+                            ulIndex = ulArrayEnd - 1UL; /* No such element, so skip the whole array. */
+                        }
+                        else if( ulElementEnd == ulNumTokens )
+                        {
+                            ulElementEnd = ulArrayEnd; /* The selected element is the last one. */
+                        }
+                        else
+                        {
+                            /* Skip from the end of the selected element to the end of the array. */
+                        }
+                    }
                     else if( OTA_DONT_STORE_PARAM == pxModelParam[ usModelParamIndex ].ulDestOffset )
                     {
                         /* Nothing to do with this parameter since we're not storing it. */
@@ -1968,6 +3394,8 @@ static DocParseErr_t prvInitDocModel( JSON_DocModel_t * pxDocModel,
         pxDocModel->usNumModelParams = usNumJobParams;
         pxDocModel->ulParamsReceivedBitmap = 0;
         pxDocModel->ulParamsRequiredBitmap = 0;
+        pxDocModel->ulArrayElement = 0;
+        pxDocModel->ulArrayElements = 0;
 
         /* Scan the model and detect all required parameters (i.e. not optional). */
         for( ulScanIndex = 0; ulScanIndex < pxDocModel->usNumModelParams; ulScanIndex++ )
@@ -2032,6 +3460,148 @@ static OTA_Err_t prvValidateUpdateVersion( OTA_FileContext_t * C )
     return xErr;
 }
 
+/*
+ * Check that the device can receive a file described by the job document. The image
+ * written through the PAL is the file itself unless the file is patched or compressed,
+ * in which case the job document must give the size of the image it produces.
+ */
+static OTA_JobParseErr_t prvValidateJobFile( OTA_FileContext_t * C )
+{
+    DEFINE_OTA_METHOD_NAME( "prvValidateJobFile" );
+
+    OTA_JobParseErr_t eErr = eOTA_JobParseErr_None;
+
+    if( C->ulFileSize == 0U )
+    {
+        OTA_LOG_L1( "[%s] Zero file size is not allowed!\r\n", OTA_METHOD_NAME );
+        eErr = eOTA_JobParseErr_ZeroFileSize;
+    }
+    else if( ( C->ulDeltaFormat != 0U ) &&
+             ( ( OTA_DELTA_UPDATE == 0U ) ||
+               ( C->ulDeltaFormat != OTA_DELTA_FORMAT_VERSION ) ||
+               ( xOTA_Agent.xPALCallbacks.xReadActiveImage == NULL ) ) )
+    {
+        OTA_LOG_L1( "[%s] Delta patch format %u is not supported!\r\n", OTA_METHOD_NAME, C->ulDeltaFormat );
+        eErr = eOTA_JobParseErr_UnsupportedPatch;
+    }
+    else if( ( C->ulCompression != 0U ) &&
+             ( ( OTA_COMPRESSED_UPDATE == 0U ) ||
+               ( C->ulCompression != OTA_DECOMPRESS_FORMAT_VERSION ) ) )
+    {
+        OTA_LOG_L1( "[%s] Compression format %u is not supported!\r\n", OTA_METHOD_NAME, C->ulCompression );
+        eErr = eOTA_JobParseErr_UnsupportedCompression;
+    }
+    else if( ( C->ulDeltaFormat == 0U ) && ( C->ulCompression == 0U ) )
+    {
+        /* The file is written as it is received. */
+        C->ulImageSize = C->ulFileSize;
+    }
+    else if( C->ulImageSize == 0U )
+    {
+        OTA_LOG_L1( "[%s] A patched or compressed file needs its image size!\r\n", OTA_METHOD_NAME );
+        eErr = ( C->ulDeltaFormat != 0U ) ? eOTA_JobParseErr_UnsupportedPatch : eOTA_JobParseErr_UnsupportedCompression;
+    }
+    else
+    {
+        /* The file can be received. */
+    }
+
+    return eErr;
+}
+
+/*
+ * Parse the files of a job after the first one. Each file is parsed into its own
+ * context with the same document model, selecting one element of the file group
+ * at a time. Delta patches and compressed files share the in order processing
+ * state, so only one file of a job may be either.
+ */
+static OTA_JobParseErr_t prvParseJobDocFiles( const char * pcJSON,
+                                              uint32_t ulMsgLen,
+                                              const JSON_DocParam_t * pxBodyDef,
+                                              uint32_t ulNumFiles )
+{
+    DEFINE_OTA_METHOD_NAME( "prvParseJobDocFiles" );
+
+    OTA_JobParseErr_t eErr = eOTA_JobParseErr_None;
+    OTA_FileContext_t xFileContext = { 0 };
+    OTA_FileContext_t * C = &xFileContext;
+    OTA_FileContext_t * pxFile = NULL;
+    JSON_DocModel_t xFileDocModel;
+    uint32_t ulInOrderFiles = 0;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0U; ulIndex < OTA_MAX_FILES; ulIndex++ )
+    {
+        if( ( xOTA_Agent.pxOTA_Files[ ulIndex ].ulDeltaFormat != 0U ) ||
+            ( xOTA_Agent.pxOTA_Files[ ulIndex ].ulCompression != 0U ) )
+        {
+            ulInOrderFiles++;
+        }
+    }
+
+    for( ulIndex = 1U; ( eErr == eOTA_JobParseErr_None ) && ( ulIndex < ulNumFiles ); ulIndex++ )
+    {
+        ( void ) memset( C, 0, sizeof( OTA_FileContext_t ) );
+
+        if( prvInitDocModel( &xFileDocModel,
+                             pxBodyDef,
+                             ( uint32_t ) C, /*lint !e9078 !e923 Intentionally casting context pointer to a value for prvInitDocModel. */
+                             sizeof( OTA_FileContext_t ),
+                             OTA_NUM_JOB_PARAMS ) != eDocParseErr_None )
+        {
+            eErr = eOTA_JobParseErr_BadModelInitParams;
+        }
+        else
+        {
+            xFileDocModel.ulArrayElement = ulIndex;
+
+            if( prvParseJSONbyModel( pcJSON, ulMsgLen, &xFileDocModel ) != eDocParseErr_None )
+            {
+                eErr = eOTA_JobParseErr_NonConformingJobDoc;
+            }
+            else
+            {
+                eErr = prvValidateJobFile( C );
+            }
+        }
+
+        if( ( eErr == eOTA_JobParseErr_None ) &&
+            ( ( C->ulDeltaFormat != 0U ) || ( C->ulCompression != 0U ) ) )
+        {
+            ulInOrderFiles++;
+
+            if( ulInOrderFiles > 1U )
+            {
+                OTA_LOG_L1( "[%s] Only one file of a job may be patched or compressed!\r\n", OTA_METHOD_NAME );
+                eErr = ( C->ulDeltaFormat != 0U ) ? eOTA_JobParseErr_UnsupportedPatch : eOTA_JobParseErr_UnsupportedCompression;
+            }
+        }
+
+        if( eErr == eOTA_JobParseErr_None )
+        {
+            pxFile = prvGetFreeContext();
+
+            if( pxFile == NULL )
+            {
+                OTA_LOG_L1( "[%s] Job has more files than otaconfigMAX_CONCURRENT_FILES.\r\n", OTA_METHOD_NAME );
+                eErr = eOTA_JobParseErr_NoContextAvailable;
+            }
+            else
+            {
+                /* The job name is kept once for the whole job. */
+                vPortFree( C->pucJobName );
+                C->pucJobName = NULL;
+                *pxFile = *C;
+                ( void ) memset( C, 0, sizeof( OTA_FileContext_t ) );
+            }
+        }
+
+        prvOTA_FreeContext( C );
+    }
+
+    return eErr;
+}
+
 /* Parse the OTA job document and validate. Return the populated
  * OTA context if valid otherwise return NULL.
  */
@@ -2067,6 +3637,9 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
         { OTA_JSON_AUTH_SCHEME_KEY,     OTA_JOB_PARAM_OPTIONAL, { offsetof( OTA_FileContext_t, pucAuthScheme )  }, eModelParamType_StringCopy,  JSMN_STRING    },
         { cOTA_JSON_FileSignatureKey,   OTA_JOB_PARAM_REQUIRED, { offsetof( OTA_FileContext_t, pxSignature )    }, eModelParamType_SigBase64,   JSMN_STRING    },
         { OTA_JSON_FILE_ATTRIBUTE_KEY,  OTA_JOB_PARAM_OPTIONAL, { offsetof( OTA_FileContext_t, ulFileAttributes )}, eModelParamType_UInt32,      JSMN_PRIMITIVE },
+        { OTA_JSON_FILE_DELTA_KEY,      OTA_JOB_PARAM_OPTIONAL, { offsetof( OTA_FileContext_t, ulDeltaFormat )  }, eModelParamType_UInt32,      JSMN_PRIMITIVE },
+        { OTA_JSON_FILE_COMPRESS_KEY,   OTA_JOB_PARAM_OPTIONAL, { offsetof( OTA_FileContext_t, ulCompression )  }, eModelParamType_UInt32,      JSMN_PRIMITIVE },
+        { OTA_JSON_FILE_IMAGE_SIZE_KEY, OTA_JOB_PARAM_OPTIONAL, { offsetof( OTA_FileContext_t, ulImageSize )    }, eModelParamType_UInt32,      JSMN_PRIMITIVE },
     };
 
     OTA_Err_t xOTAErr = kOTA_Err_None;
@@ -2075,6 +3648,7 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
     OTA_FileContext_t xFileContext = { 0 };
     OTA_FileContext_t * C = &xFileContext;
     OTA_Err_t xErrVersionCheck = kOTA_Err_Uninitialized;
+    uint32_t ulFirstFile = 0;
 
     JSON_DocModel_t xOTA_JobDocModel;
 
@@ -2088,12 +3662,11 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
     }
     else if( prvParseJSONbyModel( pcJSON, ulMsgLen, &xOTA_JobDocModel ) == eDocParseErr_None )
     { /* Validate the job document parameters. */
-        eErr = eOTA_JobParseErr_None;
+        eErr = prvValidateJobFile( C );
 
-        if( C->ulFileSize == 0U )
+        if( eErr != eOTA_JobParseErr_None )
         {
-            OTA_LOG_L1( "[%s] Zero file size is not allowed!\r\n", OTA_METHOD_NAME );
-            eErr = eOTA_JobParseErr_ZeroFileSize;
+            /* The device can't receive the file. */
         }
         /* If there's an active job, verify that it's the same as what's being reported now. */
         /* We already checked for missing parameters so we SHOULD have a job name in the context. */
@@ -2108,7 +3681,7 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
 
                     /* Abort the current job. */
                     ( void ) xOTA_Agent.xPALCallbacks.xSetPlatformImageState( xOTA_Agent.ulServerFileID, eOTA_ImageState_Aborted );
-                    ( void ) prvOTA_Close( &xOTA_Agent.pxOTA_Files[ xOTA_Agent.ulFileIndex ] );
+                    prvCloseJobFiles();
 
                     /* Set new active job name. */
                     vPortFree( xOTA_Agent.pcOTA_Singleton_ActiveJobName );
@@ -2204,9 +3777,28 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
                 else
                 {
                     *pxFinalFile = *C;
+                    ulFirstFile = xOTA_Agent.ulFileIndex;
 
-                    /* Everything looks OK. Set final context structure to start OTA. */
-                    OTA_LOG_L1( "[%s] Job was accepted. Attempting to start transfer.\r\n", OTA_METHOD_NAME );
+                    /* Take the other files of the job as well. They are received at the same time. */
+                    if( xOTA_JobDocModel.ulArrayElements > 1U )
+                    {
+                        eErr = prvParseJobDocFiles( pcJSON, ulMsgLen, xOTA_JobDocModelParamStructure, xOTA_JobDocModel.ulArrayElements );
+                        xOTA_Agent.ulFileIndex = ulFirstFile;
+                    }
+
+                    if( eErr == eOTA_JobParseErr_None )
+                    {
+                        /* Everything looks OK. Set final context structure to start OTA. */
+                        OTA_LOG_L1( "[%s] Job was accepted. Attempting to start transfer.\r\n", OTA_METHOD_NAME );
+                    }
+                    else
+                    {
+                        /* The first file owns the parameters now. Hand the job name back so the job is rejected below. */
+                        ( void ) memset( C, 0, sizeof( OTA_FileContext_t ) );
+                        C->pucJobName = xOTA_Agent.pcOTA_Singleton_ActiveJobName;
+                        xOTA_Agent.pcOTA_Singleton_ActiveJobName = NULL;
+                        pxFinalFile = NULL;
+                    }
                 }
             }
         }
@@ -2304,7 +3896,7 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
         prvOTA_FreeContext( C );
 
         /* Close any open files. */
-        ( void ) prvOTA_Close( &xOTA_Agent.pxOTA_Files[ xOTA_Agent.ulFileIndex ] );
+        prvCloseJobFiles();
     }
 
     /* Return pointer to populated file context or NULL if it failed. */
@@ -2312,10 +3904,155 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
 }
 
 
+/* prvSelectBlockSize
+ *
+ * Use the block size the application prefers for this file, rounded down to a power of 2 and
+ * kept within what the stream service supports, the file block size setting and the event
+ * buffer pool. The block size is raised again if the file would need more blocks than the
+ * block bitmap can track. Returns 0 if no allowed block size covers the file.
+ */
+
+static uint32_t prvSelectBlockSize( const OTA_FileContext_t * C )
+{
+    DEFINE_OTA_METHOD_NAME( "prvSelectBlockSize" );
+
+    uint32_t ulPreferred = OTA_FILE_BLOCK_SIZE;
+    uint32_t ulBlockSize = OTA_FILE_BLOCK_SIZE;
+    uint32_t ulMaxBlockSize;
+
+    if( xOTA_Agent.xPALCallbacks.xSelectBlockSize != NULL )
+    {
+        ulPreferred = xOTA_Agent.xPALCallbacks.xSelectBlockSize( C );
+    }
+
+    while( ( ulBlockSize > OTA_MIN_FILE_BLOCK_SIZE ) &&
+           ( ( ulBlockSize + OTA_DATA_BLOCK_OVERHEAD ) > OTA_EVENT_BUFFER_POOL_SIZE ) )
+    {
+        ulBlockSize >>= 1U;
+    }
+
+    ulMaxBlockSize = ulBlockSize;
+
+    while( ( ulBlockSize > OTA_MIN_FILE_BLOCK_SIZE ) && ( ulBlockSize > ulPreferred ) )
+    {
+        ulBlockSize >>= 1U;
+    }
+
+    /* Every block of the file must fit in the block bitmap, which is also what bounds the
+     * size of a stream request message. */
+    while( ( ( ( C->ulFileSize + ( ulBlockSize - 1U ) ) / ulBlockSize ) > ( OTA_MAX_BLOCK_BITMAP_SIZE * BITS_PER_BYTE ) ) &&
+           ( ulBlockSize < ulMaxBlockSize ) )
+    {
+        ulBlockSize <<= 1U;
+    }
+
+    if( ( ( C->ulFileSize + ( ulBlockSize - 1U ) ) / ulBlockSize ) > ( OTA_MAX_BLOCK_BITMAP_SIZE * BITS_PER_BYTE ) )
+    {
+        OTA_LOG_L1( "[%s] Error: %u bytes need more than %u blocks of %u bytes.\r\n",
+                    OTA_METHOD_NAME, C->ulFileSize, OTA_MAX_BLOCK_BITMAP_SIZE * BITS_PER_BYTE, ulBlockSize );
+        ulBlockSize = 0U;
+    }
+    else
+    {
+        OTA_LOG_L1( "[%s] Using %u byte blocks.\r\n", OTA_METHOD_NAME, ulBlockSize );
+    }
+
+    return ulBlockSize;
+}
+
+/* prvInitFileForRx
+ *
+ * Allocate the block bitmap of a file of the job and open the file for receiving,
+ * resuming an interrupted download of it if there is a checkpoint.
+ */
+
+static OTA_Err_t prvInitFileForRx( OTA_FileContext_t * C )
+{
+    uint32_t ulIndex;
+    uint32_t ulNumBlocks; /* How many data pages are in the expected update image. */
+    uint32_t ulBitmapLen; /* Length of the file block bitmap in bytes. */
+    OTA_Err_t xErr = kOTA_Err_Uninitialized;
+
+    /* Calculate how many bytes we need in our bitmap for tracking received blocks. */
+
+    ulNumBlocks = OTA_FILE_NUM_BLOCKS( C );
+    ulBitmapLen = ( ulNumBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+    C->pucRxBlockBitmap = ( uint8_t * ) pvPortMalloc( ulBitmapLen ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+
+    if( C->pucRxBlockBitmap != NULL )
+    {
+        /* Set all bits in the bitmap to the erased state (we use 1 for erased just like flash memory). */
+        ( void ) memset( C->pucRxBlockBitmap, ( int32_t ) OTA_ERASED_BLOCKS_VAL, ulBitmapLen );
+
+        /* Mark as used any pages in the bitmap that are out of range, based on the file size.
+         * This keeps us from requesting those pages during retry processing or if using a windowed
+         * block request. It also avoids erroneously accepting an out of range data block should it
+         * get past any safety checks.
+         * Files aren't always a multiple of 8 pages (8 bits/pages per byte) so some bits of the
+         * last byte may be out of range and those are the bits we want to clear. */
+
+        uint8_t ulBit = 1U << ( BITS_PER_BYTE - 1U );
+        uint32_t ulNumOutOfRange = ( ulBitmapLen * BITS_PER_BYTE ) - ulNumBlocks;
+
+        for( ulIndex = 0U; ulIndex < ulNumOutOfRange; ulIndex++ )
+        {
+            C->pucRxBlockBitmap[ ulBitmapLen - 1U ] &= ~ulBit;
+            ulBit >>= 1U;
+        }
+
+        C->ulBlocksRemaining = ulNumBlocks; /* Initialize our blocks remaining counter. */
+
+        #if ( OTA_CHECKPOINT_BLOCKS != 0U )
+            /* Continue an interrupted download of the same file where it left off. */
+            if( prvCheckpointResume( C, ulBitmapLen ) )
+            {
+                xErr = kOTA_Err_None;
+            }
+        #endif
+
+        if( xErr != kOTA_Err_None )
+        {
+            /* Create/Open the OTA file on the file system. */
+            xErr = xOTA_Agent.xPALCallbacks.xCreateFileForRx( C );
+        }
+
+        #if ( OTA_IN_ORDER_INGEST != 0U )
+            if( ( xErr == kOTA_Err_None ) &&
+                ( ( C->ulDeltaFormat != 0U ) || ( C->ulCompression != 0U ) ) )
+            {
+                xErr = prvInOrderStart( C );
+            }
+        #endif
+
+        if( xErr != kOTA_Err_None )
+        {
+            ( void ) prvSetImageStateWithReason( eOTA_ImageState_Aborted, xErr );
+        }
+        else
+        {
+            #if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+                /* A resumed file is missing blocks from the hash, so leave it all to the PAL. */
+                if( C->ulBlocksRemaining == ulNumBlocks )
+                {
+                    prvStreamingHashStart( C );
+                }
+            #endif
+        }
+    }
+    else
+    {
+        /* Can't receive the image without enough memory. */
+        xErr = kOTA_Err_OutOfMemory;
+    }
+
+    return xErr;
+}
+
 /* prvGetFileContextFromJob
  *
  * We received an OTA update job message from the job service so process
- * the message and update the file context.
+ * the message and update the file context. Every file of the job is opened
+ * and the first one is returned.
  */
 
 static OTA_FileContext_t * prvGetFileContextFromJob( const char * pcRawMsg,
@@ -2324,10 +4061,10 @@ static OTA_FileContext_t * prvGetFileContextFromJob( const char * pcRawMsg,
     DEFINE_OTA_METHOD_NAME( "prvGetFileContextFromJob" );
 
     uint32_t ulIndex;
-    uint32_t ulNumBlocks;              /* How many data pages are in the expected update image. */
-    uint32_t ulBitmapLen;              /* Length of the file block bitmap in bytes. */
+    uint32_t ulBufferSize = OTA_MIN_EVENT_BUFFER_SIZE;
     OTA_FileContext_t * pstUpdateFile; /* Pointer to an OTA update context. */
-    OTA_Err_t xErr = kOTA_Err_Uninitialized;
+    OTA_FileContext_t * C = NULL;
+    OTA_Err_t xErr = kOTA_Err_None;
 
     bool bUpdateJob = false;
 
@@ -2342,56 +4079,53 @@ static OTA_FileContext_t * prvGetFileContextFromJob( const char * pcRawMsg,
 
     if( ( bUpdateJob == false ) && ( pstUpdateFile != NULL ) && ( prvInSelftest() == false ) )
     {
-        if( pstUpdateFile->pucRxBlockBitmap != NULL )
-        {
-            vPortFree( pstUpdateFile->pucRxBlockBitmap ); /* Free any previously allocated bitmap. */
-            pstUpdateFile->pucRxBlockBitmap = NULL;
-        }
-
-        /* Calculate how many bytes we need in our bitmap for tracking received blocks.
-         * The below calculation requires power of 2 page sizes. */
-
-        ulNumBlocks = ( pstUpdateFile->ulFileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
-        ulBitmapLen = ( ulNumBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
-        pstUpdateFile->pucRxBlockBitmap = ( uint8_t * ) pvPortMalloc( ulBitmapLen ); /*lint !e9079 FreeRTOS malloc port returns void*. */
-
-        if( pstUpdateFile->pucRxBlockBitmap != NULL )
+        /* Choose the block size of each file and make sure the event buffers can hold the largest blocks. */
+        for( ulIndex = 0U; ( xErr == kOTA_Err_None ) && ( ulIndex < OTA_MAX_FILES ); ulIndex++ )
         {
-            /* Set all bits in the bitmap to the erased state (we use 1 for erased just like flash memory). */
-            ( void ) memset( pstUpdateFile->pucRxBlockBitmap, ( int32_t ) OTA_ERASED_BLOCKS_VAL, ulBitmapLen );
+            C = &xOTA_Agent.pxOTA_Files[ ulIndex ];
 
-            /* Mark as used any pages in the bitmap that are out of range, based on the file size.
-             * This keeps us from requesting those pages during retry processing or if using a windowed
-             * block request. It also avoids erroneously accepting an out of range data block should it
-             * get past any safety checks.
-             * Files aren't always a multiple of 8 pages (8 bits/pages per byte) so some bits of the
-             * last byte may be out of range and those are the bits we want to clear. */
+            if( C->pucFilePath != NULL )
+            {
+                if( C->pucRxBlockBitmap != NULL )
+                {
+                    vPortFree( C->pucRxBlockBitmap ); /* Free any previously allocated bitmap. */
+                    C->pucRxBlockBitmap = NULL;
+                }
 
-            uint8_t ulBit = 1U << ( BITS_PER_BYTE - 1U );
-            uint32_t ulNumOutOfRange = ( ulBitmapLen * BITS_PER_BYTE ) - ulNumBlocks;
+                C->ulBlockSize = prvSelectBlockSize( C );
 
-            for( ulIndex = 0U; ulIndex < ulNumOutOfRange; ulIndex++ )
-            {
-                pstUpdateFile->pucRxBlockBitmap[ ulBitmapLen - 1U ] &= ~ulBit;
-                ulBit >>= 1U;
+                if( C->ulBlockSize == 0U )
+                {
+                    /* Reject the file before anything is created for it. */
+                    xErr = kOTA_Err_RxFileTooLarge;
+                    ( void ) prvSetImageStateWithReason( eOTA_ImageState_Aborted, xErr );
+                }
+                else if( ( C->ulBlockSize + OTA_DATA_BLOCK_OVERHEAD ) > ulBufferSize )
+                {
+                    ulBufferSize = C->ulBlockSize + OTA_DATA_BLOCK_OVERHEAD;
+                }
             }
+        }
 
-            pstUpdateFile->ulBlocksRemaining = ulNumBlocks; /* Initialize our blocks remaining counter. */
+        if( xErr == kOTA_Err_None )
+        {
+            prvEventBufferResize( ulBufferSize );
+        }
 
-            /* Create/Open the OTA file on the file system. */
-            xErr = xOTA_Agent.xPALCallbacks.xCreateFileForRx( pstUpdateFile );
+        /* The first file is opened first, so it is the one to get a checkpoint and the streaming hash. */
+        for( ulIndex = 0U; ( xErr == kOTA_Err_None ) && ( ulIndex < OTA_MAX_FILES ); ulIndex++ )
+        {
+            C = &xOTA_Agent.pxOTA_Files[ ( xOTA_Agent.ulFileIndex + ulIndex ) % OTA_MAX_FILES ];
 
-            if( xErr != kOTA_Err_None )
+            if( C->pucFilePath != NULL )
             {
-                ( void ) prvSetImageStateWithReason( eOTA_ImageState_Aborted, xErr );
-                ( void ) prvOTA_Close( pstUpdateFile ); /* Ignore false result since we're setting the pointer to null on the next line. */
-                pstUpdateFile = NULL;
+                xErr = prvInitFileForRx( C );
             }
         }
-        else
+
+        if( xErr != kOTA_Err_None )
         {
-            /* Can't receive the image without enough memory. */
-            ( void ) prvOTA_Close( pstUpdateFile );
+            prvCloseJobFiles();
             pstUpdateFile = NULL;
         }
     }
@@ -2413,10 +4147,10 @@ static bool prvValidateDataBlock( const OTA_FileContext_t * C,
     bool bRet = false;
     uint32_t ulLastBlock = 0;
 
-    ulLastBlock = ( ( C->ulFileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE ) - 1U;
+    ulLastBlock = OTA_FILE_NUM_BLOCKS( C ) - 1U;
 
-    if( ( ( ulBlockIndex < ulLastBlock ) && ( ulBlockSize == OTA_FILE_BLOCK_SIZE ) ) ||
-        ( ( ulBlockIndex == ulLastBlock ) && ( ulBlockSize == ( C->ulFileSize - ( ulLastBlock * OTA_FILE_BLOCK_SIZE ) ) ) ) )
+    if( ( ( ulBlockIndex < ulLastBlock ) && ( ulBlockSize == C->ulBlockSize ) ) ||
+        ( ( ulBlockIndex == ulLastBlock ) && ( ulBlockSize == ( C->ulFileSize - ( ulLastBlock * C->ulBlockSize ) ) ) ) )
     {
         bRet = true;
     }
@@ -2541,19 +4275,50 @@ static IngestResult_t prvIngestDataBlock( OTA_FileContext_t * C,
     {
         if( C->pucFile != NULL )
         {
-            int32_t iBytesWritten = xOTA_Agent.xPALCallbacks.xWriteBlock( C, ( ulBlockIndex * OTA_FILE_BLOCK_SIZE ), pucPayload, ulBlockSize );
-
-            if( iBytesWritten < 0 )
+            #if ( OTA_IN_ORDER_INGEST != 0U )
+                if( ( C->ulDeltaFormat != 0U ) || ( C->ulCompression != 0U ) )
+                {
+                    /* Delta patches and compressed files are processed in order instead of being written as they are. */
+                    eIngestResult = prvInOrderIngestBlock( C, ulBlockIndex, pucPayload, ulBlockSize, pxCloseResult );
+                }
+                else
+            #endif
+            #if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+                if( prvStreamingHashDefers( C, ulBlockIndex ) == true )
+                {
+                    OTA_LOG_L2( "[%s] Block %u is too far ahead of hash block %u, deferring it.\r\n", OTA_METHOD_NAME, ulBlockIndex, xOTA_Agent.xStreamingHash.ulNextBlock );
+                    eIngestResult = eIngest_Result_Deferred_Continue;
+                    *pxCloseResult = kOTA_Err_None;
+                }
+                else
+            #endif
             {
-                OTA_LOG_L1( "[%s] Error (%d) writing file block\r\n", OTA_METHOD_NAME, iBytesWritten );
-                eIngestResult = eIngest_Result_WriteBlockFailed;
+                int32_t iBytesWritten = xOTA_Agent.xPALCallbacks.xWriteBlock( C, ( ulBlockIndex * C->ulBlockSize ), pucPayload, ulBlockSize );
+
+                if( iBytesWritten < 0 )
+                {
+                    OTA_LOG_L1( "[%s] Error (%d) writing file block\r\n", OTA_METHOD_NAME, iBytesWritten );
+                    eIngestResult = eIngest_Result_WriteBlockFailed;
+                }
+                else
+                {
+                    eIngestResult = eIngest_Result_Accepted_Continue;
+                    *pxCloseResult = kOTA_Err_None;
+
+                    #if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+                        prvStreamingHashBlock( C, ulBlockIndex, pucPayload, ulBlockSize );
+                    #endif
+                }
             }
-            else
+
+            if( eIngestResult == eIngest_Result_Accepted_Continue )
             {
                 C->pucRxBlockBitmap[ ulByte ] &= ~ucBitMask; /* Mark this block as received in our bitmap. */
                 C->ulBlocksRemaining--;
-                eIngestResult = eIngest_Result_Accepted_Continue;
-                *pxCloseResult = kOTA_Err_None;
+
+                #if ( OTA_CHECKPOINT_BLOCKS != 0U )
+                    prvCheckpointBlockAccepted( C );
+                #endif
             }
         }
         else
@@ -2574,10 +4339,25 @@ static IngestResult_t prvIngestDataBlock( OTA_FileContext_t * C,
             vPortFree( C->pucRxBlockBitmap ); /* Free the bitmap now that we're done with the download. */
             C->pucRxBlockBitmap = NULL;
 
+            #if ( OTA_CHECKPOINT_BLOCKS != 0U )
+                /* The download is complete, so there is nothing left to resume. */
+                prvCheckpointRelease( C, true );
+            #endif
+
+            #if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+                /* Every block has been hashed, so the PAL only has to check the signature. */
+                prvStreamingHashRelease( C, false );
+            #endif
+
             if( C->pucFile != NULL )
             {
                 *pxCloseResult = xOTA_Agent.xPALCallbacks.xCloseFile( C );
 
+                #if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+                    /* Free the hash context if the PAL verified the file without it. */
+                    prvStreamingHashRelease( C, true );
+                #endif
+
                 if( *pxCloseResult == kOTA_Err_None )
                 {
                     OTA_LOG_L1( "[%s] File receive complete and signature is valid.\r\n", OTA_METHOD_NAME );
@@ -2686,18 +4466,21 @@ static void prvAgentShutdownCleanup( void )
     }
 
     /*
-     * Free OTA event buffers.
+     * Free OTA event buffers, including any receive buffers still owned by
+     * events that were left in the queue.
      */
     for( ulIndex = 0; ulIndex < otaconfigMAX_NUM_OTA_DATA_BUFFERS; ulIndex++ )
     {
+        if( xEventBuffer[ ulIndex ].pvReceivedData != NULL )
+        {
+            xEventBuffer[ ulIndex ].vFreeReceivedData( xEventBuffer[ ulIndex ].pvReceivedData );
+            xEventBuffer[ ulIndex ].pvReceivedData = NULL;
+        }
+
         xEventBuffer[ ulIndex ].bBufferUsed = false;
     }
 
-    /* Delete the semaphore.*/
-    if( xOTA_Agent.xOTA_ThreadSafetyMutex != NULL )
-    {
-        vSemaphoreDelete( xOTA_Agent.xOTA_ThreadSafetyMutex );
-    }
+    ulEventBuffersInUse = 0;
 }
 
 /*
@@ -2861,12 +4644,6 @@ static BaseType_t prvStartOTAAgentTask( void * pvConnectionContext,
     xOTA_Agent.xOTA_EventQueue = xQueueCreateStatic( ( UBaseType_t ) OTA_NUM_MSG_Q_ENTRIES, ( UBaseType_t ) sizeof( OTA_EventMsg_t ), ( uint8_t * ) xQueueData, &xStaticQueue );
     configASSERT( xOTA_Agent.xOTA_EventQueue != NULL );
 
-    /*
-     * Create the queue used to pass event messages to the OTA task.
-     */
-    xOTA_Agent.xOTA_ThreadSafetyMutex = xSemaphoreCreateMutex();
-    configASSERT( xOTA_Agent.xOTA_ThreadSafetyMutex != NULL );
-
     /*
      * Initialize all file paths to NULL.
      */
@@ -2883,6 +4660,13 @@ static BaseType_t prvStartOTAAgentTask( void * pvConnectionContext,
         xEventBuffer[ ulIndex ].bBufferUsed = false;
     }
 
+    /* Start with buffers for job documents. They are carved again for the blocks of each file. */
+    ulEventBuffersInUse = 0;
+    prvEventBufferCarve( OTA_MIN_EVENT_BUFFER_SIZE );
+    ulEventBufferPendingSize = ulEventBufferSize;
+    ulEventBufferFreeHead = 0;
+    prvEventBufferPushChain( 1U, ulEventBufferCount );
+
     xReturn = xTaskCreate( prvOTAAgentTask, "OTA Agent Task", otaconfigSTACK_SIZE, NULL, otaconfigAGENT_PRIORITY, &pxOTA_TaskHandle );
 
     portEXIT_CRITICAL(); /* Protected elements are initialized. It's now safe to context switch. */
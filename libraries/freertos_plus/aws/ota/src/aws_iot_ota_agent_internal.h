@@ -34,6 +34,8 @@
 
 #include "aws_ota_agent_config.h"
 #include "jsmn.h"
+#include "aws_iot_ota_delta.h"
+#include "aws_iot_ota_decompress.h"
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
@@ -44,18 +46,100 @@
 /* General constants. */
 #define LOG2_BITS_PER_BYTE           3UL                                               /* Log base 2 of bits per byte. */
 #define BITS_PER_BYTE                ( 1UL << LOG2_BITS_PER_BYTE )                     /* Number of bits in a byte. This is used by the block bitmap implementation. */
-#define OTA_FILE_BLOCK_SIZE          ( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE )          /* Data section size of the file data block message (excludes the header). */
-#define OTA_MAX_FILES                1U                                                /* [MUST REMAIN 1! Future support.] Maximum number of concurrent OTA files. */
+#define OTA_FILE_BLOCK_SIZE          ( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE )          /* Largest and default data section size of the file data block message (excludes the header). */
+#define OTA_MIN_FILE_BLOCK_SIZE      256UL                                             /* Smallest file block size supported by the stream service. */
 #define OTA_MAX_BLOCK_BITMAP_SIZE    128U                                              /* Max allowed number of bytes to track all blocks of an OTA file. Adjust block size if more range is needed. */
 #define OTA_REQUEST_MSG_MAX_SIZE     ( 3U * OTA_MAX_BLOCK_BITMAP_SIZE )
 #define OTA_REQUEST_URL_MAX_SIZE     ( 1500 )
 #define OTA_ERASED_BLOCKS_VAL        0xffU                 /* The starting state of a group of erased blocks in the Rx block bitmap. */
+#ifdef otaconfigMAX_CONCURRENT_FILES
+    #define OTA_MAX_FILES            otaconfigMAX_CONCURRENT_FILES
+#else
+    #define OTA_MAX_FILES            1U /* Maximum number of files of a job received at the same time. */
+#endif
 #ifdef configOTA_NUM_MSG_Q_ENTRIES
     #define OTA_NUM_MSG_Q_ENTRIES    configOTA_NUM_MSG_Q_ENTRIES
 #else
-    #define OTA_NUM_MSG_Q_ENTRIES    20U                   /* Maximum number of entries in the OTA message queue. */
+    #define OTA_NUM_MSG_Q_ENTRIES    ( 20U + otaconfigMAX_NUM_OTA_DATA_BUFFERS ) /* Maximum number of entries in the OTA message queue, with room for an event per data buffer. */
+#endif
+#ifdef otaconfigMQTT_REQUEST_WINDOW_BLOCKS
+    #define OTA_REQUEST_WINDOW_MAX_BLOCKS    otaconfigMQTT_REQUEST_WINDOW_BLOCKS
+#else
+    #define OTA_REQUEST_WINDOW_MAX_BLOCKS    0U            /* Maximum number of blocks kept in flight. 0 disables windowed block requests. */
+#endif
+
+#ifdef otaconfigDELTA_UPDATE
+    #define OTA_DELTA_UPDATE    otaconfigDELTA_UPDATE
+#else
+    #define OTA_DELTA_UPDATE    0U                     /* Accept delta patch jobs. 0 rejects them. */
+#endif
+
+#ifdef otaconfigCOMPRESSED_UPDATE
+    #define OTA_COMPRESSED_UPDATE    otaconfigCOMPRESSED_UPDATE
+#else
+    #define OTA_COMPRESSED_UPDATE    0U                /* Accept compressed file jobs. 0 rejects them. */
+#endif
+
+#ifdef otaconfigDECOMPRESS_WINDOW_SIZE
+    #define OTA_DECOMPRESS_WINDOW_SIZE    otaconfigDECOMPRESS_WINDOW_SIZE
+#else
+    #define OTA_DECOMPRESS_WINDOW_SIZE    1024U        /* Largest compression window accepted. A power of 2 from 16 to 4096. */
+#endif
+
+/* Delta patches and compressed files are both processed in file order. */
+#if ( OTA_DELTA_UPDATE != 0U ) || ( OTA_COMPRESSED_UPDATE != 0U )
+    #define OTA_IN_ORDER_INGEST    1U
+#else
+    #define OTA_IN_ORDER_INGEST    0U
+#endif
+
+#ifdef otaconfigIN_ORDER_STAGING_BLOCKS
+    #define OTA_IN_ORDER_STAGING_BLOCKS    otaconfigIN_ORDER_STAGING_BLOCKS
+#else
+    #define OTA_IN_ORDER_STAGING_BLOCKS    2U          /* Out of order blocks held for files that must be processed in order. 1 to 32. */
+#endif
+
+#ifdef otaconfigSTREAMING_SIGNATURE_CHECK
+    #define OTA_STREAMING_SIGNATURE_CHECK    otaconfigSTREAMING_SIGNATURE_CHECK
+#else
+    #define OTA_STREAMING_SIGNATURE_CHECK    0U            /* Hash file blocks as they are received. 0 leaves all hashing to the PAL at close time. */
+#endif
+
+#ifdef otaconfigSTREAMING_SIGNATURE_FRONTIER_BLOCKS
+    #define OTA_STREAMING_HASH_FRONTIER_BLOCKS    otaconfigSTREAMING_SIGNATURE_FRONTIER_BLOCKS
+#elif ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 32U )
+    #define OTA_STREAMING_HASH_FRONTIER_BLOCKS    32U      /* The frontier mask holds at most 32 blocks. */
+#elif ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 4U )
+    #define OTA_STREAMING_HASH_FRONTIER_BLOCKS    OTA_REQUEST_WINDOW_MAX_BLOCKS /* Room for a full request window of out of order blocks. */
+#else
+    #define OTA_STREAMING_HASH_FRONTIER_BLOCKS    4U       /* Out of order blocks buffered ahead of the hash. */
+#endif
+
+/* Each frontier slot is a bit of OTA_StreamingHash_t::ulFrontierMask. */
+#if ( OTA_STREAMING_HASH_FRONTIER_BLOCKS < 1U ) || ( OTA_STREAMING_HASH_FRONTIER_BLOCKS > 32U )
+    #error "otaconfigSTREAMING_SIGNATURE_FRONTIER_BLOCKS must be between 1 and 32."
+#endif
+
+#ifdef otaconfigSTREAMING_SIGNATURE_ASYMMETRIC_ALGORITHM
+    #define OTA_STREAMING_SIGNATURE_ASYMMETRIC_ALGORITHM    otaconfigSTREAMING_SIGNATURE_ASYMMETRIC_ALGORITHM
+#else
+    #define OTA_STREAMING_SIGNATURE_ASYMMETRIC_ALGORITHM    cryptoASYMMETRIC_ALGORITHM_ECDSA /* Must match the PAL's cOTA_JSON_FileSignatureKey. */
 #endif
 
+#ifdef otaconfigSTREAMING_SIGNATURE_HASH_ALGORITHM
+    #define OTA_STREAMING_SIGNATURE_HASH_ALGORITHM    otaconfigSTREAMING_SIGNATURE_HASH_ALGORITHM
+#else
+    #define OTA_STREAMING_SIGNATURE_HASH_ALGORITHM    cryptoHASH_ALGORITHM_SHA256 /* Must match the PAL's cOTA_JSON_FileSignatureKey. */
+#endif
+
+#ifdef otaconfigCHECKPOINT_BLOCKS
+    #define OTA_CHECKPOINT_BLOCKS    otaconfigCHECKPOINT_BLOCKS
+#else
+    #define OTA_CHECKPOINT_BLOCKS    0U                /* Blocks received between download checkpoints. 0 disables resuming after a reset. */
+#endif
+
+#define OTA_CHECKPOINT_MAGIC         0x4F544301UL      /* "OTC" and the checkpoint layout version. */
+
 /* Job document parser constants. */
 #define OTA_MAX_JSON_TOKENS         64U                                                                         /* Number of JSON tokens supported in a single parser call. */
 #define OTA_MAX_JSON_STR_LEN        256U                                                                        /* Limit our JSON string compares to something small to avoid going into the weeds. */
@@ -63,7 +147,24 @@
 #define OTA_JOB_PARAM_REQUIRED      true                                                                        /* Used to denote a required document model parameter. */
 #define OTA_JOB_PARAM_OPTIONAL      false                                                                       /* Used to denote an optional document model parameter. */
 #define OTA_DONT_STORE_PARAM        0xffffffffUL                                                                /* If ulDestOffset in the model is 0xffffffff, do not store the value. */
-#define OTA_DATA_BLOCK_SIZE         ( ( 1U << otaconfigLOG2_FILE_BLOCK_SIZE ) + OTA_REQUEST_URL_MAX_SIZE + 30 ) /* Header is 19 bytes.*/
+#define OTA_DATA_BLOCK_OVERHEAD     ( OTA_REQUEST_URL_MAX_SIZE + 30 )                                           /* Header is 19 bytes.*/
+#define OTA_DATA_BLOCK_SIZE         ( OTA_FILE_BLOCK_SIZE + OTA_DATA_BLOCK_OVERHEAD )                           /* Largest file data block message. */
+
+/* Number of blocks in a file, using the block size chosen for it. */
+#define OTA_FILE_NUM_BLOCKS( C )    ( ( ( C )->ulFileSize + ( ( C )->ulBlockSize - 1U ) ) / ( C )->ulBlockSize )
+
+/* OTA event buffer pool. */
+#ifdef otaconfigEVENT_BUFFER_POOL_SIZE
+    #define OTA_EVENT_BUFFER_POOL_SIZE    otaconfigEVENT_BUFFER_POOL_SIZE
+#else
+    #define OTA_EVENT_BUFFER_POOL_SIZE    ( otaconfigMAX_NUM_OTA_DATA_BUFFERS * OTA_DATA_BLOCK_SIZE ) /* Bytes the event buffers are carved from. */
+#endif
+
+#ifdef otaconfigMIN_EVENT_BUFFER_SIZE
+    #define OTA_MIN_EVENT_BUFFER_SIZE    otaconfigMIN_EVENT_BUFFER_SIZE
+#else
+    #define OTA_MIN_EVENT_BUFFER_SIZE    OTA_DATA_BLOCK_SIZE /* Smallest event buffer. Job documents must fit. */
+#endif
 
 
 /* OTA Agent task event flags. */
@@ -88,9 +189,12 @@ typedef enum
     eIngest_Result_BadData = -8,            /* The data block from the server was malformed. */
     eIngest_Result_WriteBlockFailed = -9,   /* The PAL layer failed to write the file block. */
     eIngest_Result_NullResultPointer = -10, /* The pointer to the close result pointer was null. */
+    eIngest_Result_PatchFailed = -11,       /* The delta patch could not be applied. */
+    eIngest_Result_DecompressFailed = -12,  /* The compressed file could not be decompressed. */
     eIngest_Result_Uninitialized = -127,    /* Software BUG: We forgot to set the result code. */
     eIngest_Result_Accepted_Continue = 0,   /* The block was accepted and we're expecting more. */
     eIngest_Result_Duplicate_Continue = 1,  /* The block was a duplicate but that's OK. Continue. */
+    eIngest_Result_Deferred_Continue = 2,   /* The block arrived too far ahead to be staged. It stays missing and will be requested again. */
 } IngestResult_t;
 
 /* Generic JSON document parser errors. */
@@ -167,6 +271,9 @@ typedef struct
  * document and where to store the parameters, if desired, in a destination context.
  * We currently only store parameters into an OTA_FileContext_t but it could be used
  * for any structure since we don't use a type pointer.
+ *
+ * Only one element of an eModelParamType_Array parameter is parsed, so a document
+ * describing several files is parsed once for each file.
  */
 typedef struct
 {
@@ -176,6 +283,8 @@ typedef struct
     uint16_t usNumModelParams;         /* The number of entries in the document model (limited to 32). */
     uint32_t ulParamsReceivedBitmap;   /* Bitmap of the parameters received based on the model. */
     uint32_t ulParamsRequiredBitmap;   /* Bitmap of the parameters required from the model. */
+    uint32_t ulArrayElement;           /* Element of the eModelParamType_Array parameter to parse. */
+    uint32_t ulArrayElements;          /* Number of elements found in the eModelParamType_Array parameter. */
 } JSON_DocModel_t;
 
 /*lint -esym(749,OTA_JobStatus_t::eJobStatus_Rejected) Until the Job Service supports it, this is unused. */
@@ -205,7 +314,7 @@ enum
  * size, attributes, etc. The following value specifies the number of parameters
  * that are included in the job document model although some may be optional. */
 
-#define OTA_NUM_JOB_PARAMS              ( 20 ) /* Number of parameters in the job document. */
+#define OTA_NUM_JOB_PARAMS              ( 23 ) /* Number of parameters in the job document. */
 
 /* Keys in OTA job doc . */
 #define OTA_JSON_CLIENT_TOKEN_KEY       "clientToken"
@@ -227,6 +336,9 @@ enum
 #define OTA_JSON_FILE_CERT_NAME_KEY     "certfile"
 #define OTA_JSON_UPDATE_DATA_URL_KEY    "update_data_url"
 #define OTA_JSON_AUTH_SCHEME_KEY        "auth_scheme"
+#define OTA_JSON_FILE_DELTA_KEY         "delta"
+#define OTA_JSON_FILE_COMPRESS_KEY      "compression"
+#define OTA_JSON_FILE_IMAGE_SIZE_KEY    "imagesize"
 
 /* This is the OTA statistics structure to hold useful info. */
 
@@ -238,6 +350,91 @@ typedef struct ota_agent_statistics
     uint32_t ulOTA_PacketsDropped;   /* Number of OTA packets dropped due to congestion. */
 } OTA_AgentStatistics_t;
 
+/* State of the windowed file block request mode. The window starts at
+ * otaconfigMAX_NUM_BLOCKS_REQUEST blocks, grows by one block each time a full
+ * window is received and is halved on a request timeout or dropped packet. */
+
+typedef struct ota_request_window
+{
+    uint32_t ulSize;           /* Number of blocks to keep in flight, or 0 if windowed requests are not in use. */
+    uint32_t ulInFlight;       /* Number of blocks requested but not received yet. */
+    uint32_t ulNextBlock;      /* Block to start from when selecting the blocks of the next request. */
+    uint32_t ulReceived;       /* Blocks received since the window size last changed. */
+    uint32_t ulDropped;        /* Value of ulOTA_PacketsDropped when the window was last updated. */
+    bool bAwaitingFirstBlock;  /* Set when a request is sent and cleared when its first block arrives. */
+    TickType_t xRequestTime;   /* Time the last request was sent. */
+    TickType_t xBlockTime;     /* Time the last block was received. */
+    TickType_t xRoundTrip;     /* Smoothed time from a request to its first block. */
+    TickType_t xBlockInterval; /* Smoothed time between blocks. */
+} OTA_RequestWindow_t;
+
+/* State of the streaming signature hash. Blocks are hashed in file order as
+ * they are ingested. Blocks that arrive ahead of the next block to hash are held
+ * in a small frontier buffer until the gap is filled. Blocks further ahead are
+ * left missing and requested again. Without a frontier buffer, an out of order
+ * block abandons streaming and the PAL hashes the file at close.
+ * One file is hashed at a time; other files of the job are hashed by the PAL. */
+
+typedef struct ota_streaming_hash
+{
+    const OTA_FileContext_t * pxFile; /* The file being hashed. */
+    uint32_t ulNextBlock;             /* Index of the next block to feed to the hash. */
+    uint32_t ulFrontierMask;          /* Bit n is set if frontier slot n holds a block. */
+    uint8_t * pucFrontier;            /* OTA_STREAMING_HASH_FRONTIER_BLOCKS blocks of buffer space, slot = block index modulo the frontier size. */
+} OTA_StreamingHash_t;
+
+/* State of a file whose blocks must be processed in file order, such as a delta
+ * patch or a compressed file. Blocks that arrive a little ahead of the next block are staged until the
+ * gap is filled. Blocks further ahead are left missing and requested again. */
+
+typedef struct ota_in_order_ingest
+{
+    const OTA_FileContext_t * pxFile; /* The file being processed. */
+    uint32_t ulNextBlock;             /* Index of the next block to process. */
+    uint32_t ulImageEnd;              /* Offset just past the image written so far. */
+    uint32_t ulStagedMask;            /* Bit n is set if staging slot n holds a block. */
+    uint8_t * pucStaging;             /* OTA_IN_ORDER_STAGING_BLOCKS blocks of buffer space, slot = block index modulo the staging size. */
+    uint8_t * pucOutput;              /* Delta patch output buffer of one block (the file's ulBlockSize bytes). */
+    OTA_DeltaPatch_t xPatch;          /* Delta patch being applied. */
+    uint8_t * pucWindow;              /* Decompression window of OTA_DECOMPRESS_WINDOW_SIZE bytes. */
+    OTA_Decompress_t xDecompress;     /* File being decompressed. */
+} OTA_InOrderIngest_t;
+
+/* A download checkpoint is this header followed by a copy of the receive block bitmap.
+ * The header identifies the file so a checkpoint is only resumed for the same file.
+ * Erased flash reads back as all 1s, which the bitmap takes as blocks still needed, so
+ * a torn checkpoint write never claims a block that wasn't written. */
+
+typedef struct ota_checkpoint_header
+{
+    uint32_t ulMagic;                            /* OTA_CHECKPOINT_MAGIC. */
+    uint32_t ulServerFileID;                     /* Server file ID of the file. */
+    uint32_t ulFileSize;                         /* Size of the file in bytes. */
+    uint32_t ulBlockSize;                        /* Block size the bitmap was built with. */
+    uint16_t usSignatureSize;                    /* Size of the file signature. */
+    uint8_t ucSignature[ kOTA_MaxSignatureSize ]; /* The file signature. */
+} OTA_CheckpointHeader_t;
+
+/* Download checkpoint state of the file being received. */
+
+typedef struct ota_checkpoint
+{
+    const OTA_FileContext_t * pxFile; /* The file being checkpointed. */
+    uint8_t * pucBuffer;              /* The checkpoint header and bitmap. */
+    uint32_t ulLength;                /* Length of the checkpoint in bytes. */
+    uint32_t ulBlocksSinceSave;       /* Blocks received since the last checkpoint was stored. */
+} OTA_Checkpoint_t;
+
+/* Request state of a file being received. Each file of a job has its own,
+ * indexed like the file contexts. */
+
+typedef struct ota_file_request
+{
+    uint32_t ulNumOfBlocksToReceive;    /* Number of data blocks to receive per data request. */
+    uint32_t ulBlockShare;              /* Most blocks to have in flight, or 0 if the file has the event buffers to itself. */
+    OTA_RequestWindow_t xRequestWindow; /* Windowed file block request state. */
+} OTA_FileRequest_t;
+
 /* The OTA agent is a singleton today. The structure keeps it nice and organized. */
 
 typedef struct ota_agent_context
@@ -246,7 +443,8 @@ typedef struct ota_agent_context
     uint8_t pcThingName[ otaconfigMAX_THINGNAME_LEN + 1U ]; /* Thing name + zero terminator. */
     void * pvConnectionContext;                             /* Connection context for control and data plane. */
     OTA_FileContext_t pxOTA_Files[ OTA_MAX_FILES ];         /* Static array of OTA file structures. */
-    uint32_t ulFileIndex;                                   /* Index of current file in the array. */
+    uint32_t ulFileIndex;                                   /* Index of the file the data interface is working on. */
+    OTA_FileRequest_t pxFileRequests[ OTA_MAX_FILES ];      /* Request state of each file. */
     uint32_t ulServerFileID;                                /* Variable to store current file ID passed down */
     uint8_t * pcOTA_Singleton_ActiveJobName;                /* The currently active job name. We only allow one at a time. */
     uint8_t * pcClientTokenFromJob;                         /* The clientToken field from the latest update job. */
@@ -256,19 +454,24 @@ typedef struct ota_agent_context
     QueueHandle_t xOTA_EventQueue;                          /* Event queue for communicating with the OTA Agent task. */
     OTA_ImageState_t eImageState;                           /* The current application image state. */
     OTA_PAL_Callbacks_t xPALCallbacks;                      /* Variable to store PAL callbacks */
-    uint32_t ulNumOfBlocksToReceive;                        /* Number of data blocks to receive per data request. */
     OTA_AgentStatistics_t xStatistics;                      /* The OTA agent statistics block. */
-    SemaphoreHandle_t xOTA_ThreadSafetyMutex;               /* Mutex used to ensure thread safety while managing data buffers. */
     uint32_t ulRequestMomentum;                             /* The number of requests sent before a response was received. */
+    OTA_StreamingHash_t xStreamingHash;                     /* Streaming signature hash state. */
+    OTA_InOrderIngest_t xInOrderIngest;                     /* In order block processing state. */
+    OTA_Checkpoint_t xCheckpoint;                           /* Download checkpoint state. */
 } OTA_AgentContext_t;
 
 /* The OTA Agent event and data structures. */
 
 typedef struct
 {
-    uint8_t ucData[ OTA_DATA_BLOCK_SIZE ];
+    uint8_t * pucBuffer;                                   /* The part of the event buffer pool this event owns. */
+    uint32_t ulBufferSize;                                 /* Size of pucBuffer. */
     uint32_t ulDataLength;
     bool bBufferUsed;
+    uint8_t * pucData;                                     /* The event data. Points to pucBuffer unless a receive buffer is owned. */
+    void * pvReceivedData;                                 /* Transport receive buffer owned by this event, or NULL. */
+    void ( * vFreeReceivedData )( void * pvReceivedData ); /* Releases pvReceivedData when the event buffer is freed. */
 } OTA_EventData_t;
 
 typedef struct
@@ -278,12 +481,13 @@ typedef struct
 } OTA_EventMsg_t;
 
 /*
- * Get buffer available from static pool of OTA buffers.
+ * Get buffer available from static pool of OTA buffers. Its pucBuffer holds ulBufferSize bytes.
+ * Never blocks, so it can be called from transport receive callbacks.
  */
 OTA_EventData_t * prvOTAEventBufferGet( void );
 
 /*
- * Free OTA buffer.
+ * Free OTA buffer. Any transport receive buffer owned by the event is released.
  */
 void prvOTAEventBufferFree( OTA_EventData_t * const pxBuffer );
 
@@ -0,0 +1,290 @@
+/*
+ * FreeRTOS OTA V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/* Standard library includes. */
+#include <stddef.h>
+#include <string.h>
+
+/* OTA decompression includes. */
+#include "aws_iot_ota_decompress.h"
+
+/* Magic bytes at the start of every compressed image. */
+static const uint8_t ucDecompressMagic[ 4 ] = { 'O', 'T', 'A', 'Z' };
+
+/* Decode a little endian 32 bit value. */
+
+static uint32_t prvReadU32( const uint8_t * pucData );
+
+/* Check the completed header. */
+
+static OTA_DecompressErr_t prvDecodeHeader( OTA_Decompress_t * pxDecompress );
+
+/* Write the part of the window not yet written to the image. */
+
+static OTA_DecompressErr_t prvFlushWindow( OTA_Decompress_t * pxDecompress );
+
+/* Append a byte to the image. */
+
+static OTA_DecompressErr_t prvPutByte( OTA_Decompress_t * pxDecompress,
+                                       uint8_t ucByte );
+
+/* Copy an earlier part of the image from the window. */
+
+static OTA_DecompressErr_t prvCopyMatch( OTA_Decompress_t * pxDecompress,
+                                         uint32_t ulMatch );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvReadU32( const uint8_t * pucData )
+{
+    return ( uint32_t ) pucData[ 0 ] |
+           ( ( uint32_t ) pucData[ 1 ] << 8 ) |
+           ( ( uint32_t ) pucData[ 2 ] << 16 ) |
+           ( ( uint32_t ) pucData[ 3 ] << 24 );
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DecompressErr_t prvDecodeHeader( OTA_Decompress_t * pxDecompress )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+    uint32_t ulWindowSize = prvReadU32( &pxDecompress->ucHeader[ 8 ] );
+
+    if( ( memcmp( pxDecompress->ucHeader, ucDecompressMagic, sizeof( ucDecompressMagic ) ) != 0 ) ||
+        ( prvReadU32( &pxDecompress->ucHeader[ 4 ] ) != OTA_DECOMPRESS_FORMAT_VERSION ) ||
+        ( ulWindowSize < OTA_DECOMPRESS_MIN_WINDOW_SIZE ) ||
+        ( ulWindowSize > OTA_DECOMPRESS_MAX_WINDOW_SIZE ) ||
+        ( ( ulWindowSize & ( ulWindowSize - 1U ) ) != 0U ) )
+    {
+        eErr = eOTA_DecompressErr_BadHeader;
+    }
+    else if( ulWindowSize > pxDecompress->ulWindowSize )
+    {
+        eErr = eOTA_DecompressErr_WindowTooLarge;
+    }
+    else
+    {
+        /* Only the part of the window the image was compressed with is used. */
+        pxDecompress->ulWindowMask = ulWindowSize - 1U;
+        pxDecompress->ulImageSize = prvReadU32( &pxDecompress->ucHeader[ 12 ] );
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DecompressErr_t prvFlushWindow( OTA_Decompress_t * pxDecompress )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+    uint32_t ulStart = pxDecompress->ulWritten & pxDecompress->ulWindowMask;
+    uint32_t ulLength = pxDecompress->ulProduced - pxDecompress->ulWritten;
+    int32_t lWritten = 0;
+
+    if( ulLength > 0U )
+    {
+        lWritten = pxDecompress->xWrite( pxDecompress->pvContext,
+                                         pxDecompress->ulWritten,
+                                         &pxDecompress->pucWindow[ ulStart ],
+                                         ulLength );
+
+        if( lWritten < 0 )
+        {
+            eErr = eOTA_DecompressErr_WriteFailed;
+        }
+        else
+        {
+            pxDecompress->ulWritten = pxDecompress->ulProduced;
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DecompressErr_t prvPutByte( OTA_Decompress_t * pxDecompress,
+                                       uint8_t ucByte )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+
+    pxDecompress->pucWindow[ pxDecompress->ulProduced & pxDecompress->ulWindowMask ] = ucByte;
+    pxDecompress->ulProduced++;
+
+    /* The window is written out as soon as it fills so it can be reused. */
+    if( ( pxDecompress->ulProduced & pxDecompress->ulWindowMask ) == 0U )
+    {
+        eErr = prvFlushWindow( pxDecompress );
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DecompressErr_t prvCopyMatch( OTA_Decompress_t * pxDecompress,
+                                         uint32_t ulMatch )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+    uint32_t ulDistance = ( ulMatch & 0x0FFFU ) + 1U;
+    uint32_t ulLength = ( ulMatch >> 12 ) + OTA_DECOMPRESS_MIN_MATCH;
+    uint32_t ulFrom = 0;
+
+    if( ( ulDistance > pxDecompress->ulProduced ) ||
+        ( ulDistance > ( pxDecompress->ulWindowMask + 1U ) ) ||
+        ( ulLength > ( pxDecompress->ulImageSize - pxDecompress->ulProduced ) ) )
+    {
+        eErr = eOTA_DecompressErr_BadData;
+    }
+    else
+    {
+        /* Copy a byte at a time since a match may overlap the bytes it produces. */
+        ulFrom = pxDecompress->ulProduced - ulDistance;
+
+        while( ( eErr == eOTA_DecompressErr_None ) && ( ulLength > 0U ) )
+        {
+            eErr = prvPutByte( pxDecompress, pxDecompress->pucWindow[ ulFrom & pxDecompress->ulWindowMask ] );
+            ulFrom++;
+            ulLength--;
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_DecompressErr_t OTA_Decompress_Init( OTA_Decompress_t * pxDecompress,
+                                         uint8_t * pucWindow,
+                                         uint32_t ulWindowSize,
+                                         OTA_DecompressWrite_t xWrite,
+                                         void * pvContext )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+
+    if( ( pxDecompress == NULL ) || ( pucWindow == NULL ) || ( xWrite == NULL ) ||
+        ( ulWindowSize < OTA_DECOMPRESS_MIN_WINDOW_SIZE ) ||
+        ( ( ulWindowSize & ( ulWindowSize - 1U ) ) != 0U ) )
+    {
+        eErr = eOTA_DecompressErr_BadParams;
+    }
+    else
+    {
+        ( void ) memset( pxDecompress, 0, sizeof( OTA_Decompress_t ) );
+        pxDecompress->xWrite = xWrite;
+        pxDecompress->pvContext = pvContext;
+        pxDecompress->pucWindow = pucWindow;
+        pxDecompress->ulWindowSize = ulWindowSize;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_DecompressErr_t OTA_Decompress_Apply( OTA_Decompress_t * pxDecompress,
+                                          const uint8_t * pucData,
+                                          uint32_t ulLength )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+    uint32_t ulIndex = 0;
+    uint8_t ucByte = 0;
+
+    if( ( pxDecompress == NULL ) || ( ( pucData == NULL ) && ( ulLength > 0U ) ) )
+    {
+        eErr = eOTA_DecompressErr_BadParams;
+    }
+
+    for( ulIndex = 0; ( eErr == eOTA_DecompressErr_None ) && ( ulIndex < ulLength ); ulIndex++ )
+    {
+        ucByte = pucData[ ulIndex ];
+
+        if( pxDecompress->ulHeaderFill < OTA_DECOMPRESS_HEADER_SIZE )
+        {
+            /* The header may be split across calls. */
+            pxDecompress->ucHeader[ pxDecompress->ulHeaderFill ] = ucByte;
+            pxDecompress->ulHeaderFill++;
+
+            if( pxDecompress->ulHeaderFill == OTA_DECOMPRESS_HEADER_SIZE )
+            {
+                eErr = prvDecodeHeader( pxDecompress );
+            }
+        }
+        else if( pxDecompress->ulProduced == pxDecompress->ulImageSize )
+        {
+            eErr = eOTA_DecompressErr_TrailingData;
+        }
+        else if( pxDecompress->ulFlagsLeft == 0U )
+        {
+            pxDecompress->ulFlags = ucByte;
+            pxDecompress->ulFlagsLeft = 8U;
+        }
+        else if( ( pxDecompress->ulFlags & 1U ) != 0U )
+        {
+            eErr = prvPutByte( pxDecompress, ucByte );
+            pxDecompress->ulFlags >>= 1;
+            pxDecompress->ulFlagsLeft--;
+        }
+        else if( pxDecompress->bMatchLow == false )
+        {
+            pxDecompress->ulMatchLow = ucByte;
+            pxDecompress->bMatchLow = true;
+        }
+        else
+        {
+            eErr = prvCopyMatch( pxDecompress, pxDecompress->ulMatchLow | ( ( uint32_t ) ucByte << 8 ) );
+            pxDecompress->bMatchLow = false;
+            pxDecompress->ulFlags >>= 1;
+            pxDecompress->ulFlagsLeft--;
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_DecompressErr_t OTA_Decompress_Finish( OTA_Decompress_t * pxDecompress )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+
+    if( pxDecompress == NULL )
+    {
+        eErr = eOTA_DecompressErr_BadParams;
+    }
+    else if( ( pxDecompress->ulHeaderFill < OTA_DECOMPRESS_HEADER_SIZE ) ||
+             ( pxDecompress->bMatchLow == true ) ||
+             ( pxDecompress->ulProduced != pxDecompress->ulImageSize ) )
+    {
+        eErr = eOTA_DecompressErr_Incomplete;
+    }
+    else
+    {
+        eErr = prvFlushWindow( pxDecompress );
+    }
+
+    return eErr;
+}
@@ -0,0 +1,129 @@
+/*
+ * FreeRTOS OTA V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+#ifndef __AWS_OTADECOMPRESS__H__
+#define __AWS_OTADECOMPRESS__H__
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Compressed image format, version 1. All integers are little endian.
+ *
+ * Header (16 bytes):
+ *      "OTAZ"          Magic.
+ *      uint32_t        Format version, OTA_DECOMPRESS_FORMAT_VERSION.
+ *      uint32_t        Window size used by the compressor, a power of 2 up to OTA_DECOMPRESS_MAX_WINDOW_SIZE.
+ *      uint32_t        Size of the uncompressed image.
+ *
+ * Followed by LZSS coded data. A flag byte describes the next 8 items, least significant
+ * bit first. A set bit is a literal byte. A clear bit is a 2 byte match where the low
+ * 12 bits are the distance back minus 1 and the high 4 bits are the length minus
+ * OTA_DECOMPRESS_MIN_MATCH. Matches never reach further back than the window size.
+ *
+ * Decoding needs no memory beyond the window, which is also the buffer the image is
+ * written from.
+ */
+
+#define OTA_DECOMPRESS_FORMAT_VERSION      1U    /* The compressed format version produced and understood. */
+#define OTA_DECOMPRESS_HEADER_SIZE         16U   /* Size of the header in bytes. */
+#define OTA_DECOMPRESS_MIN_MATCH           3U    /* Shortest match. */
+#define OTA_DECOMPRESS_MAX_MATCH           18U   /* Longest match. */
+#define OTA_DECOMPRESS_MIN_WINDOW_SIZE     16U   /* Smallest window size. */
+#define OTA_DECOMPRESS_MAX_WINDOW_SIZE     4096U /* Largest window size the match distance can address. */
+
+/* Decompression errors. */
+
+typedef enum
+{
+    eOTA_DecompressErr_None = 0,       /* No error. */
+    eOTA_DecompressErr_BadParams,      /* Invalid parameters were passed. */
+    eOTA_DecompressErr_BadHeader,      /* The header is not valid. */
+    eOTA_DecompressErr_WindowTooLarge, /* The image needs a larger window than the one provided. */
+    eOTA_DecompressErr_BadData,        /* A match reaches outside the window or past the end of the image. */
+    eOTA_DecompressErr_WriteFailed,    /* Writing the image failed. */
+    eOTA_DecompressErr_TrailingData,   /* Data remained after the image was complete. */
+    eOTA_DecompressErr_Incomplete      /* The data ended before the image was complete. */
+} OTA_DecompressErr_t;
+
+/* Write ulLength bytes of the image at ulOffset. Returns the number of bytes written or a negative value on error. */
+
+typedef int32_t (* OTA_DecompressWrite_t)( void * pvContext,
+                                           uint32_t ulOffset,
+                                           uint8_t * pucData,
+                                           uint32_t ulLength );
+
+/* State of an image being decompressed. Treat as opaque. */
+
+typedef struct OTA_Decompress
+{
+    OTA_DecompressWrite_t xWrite;                         /* Writes the image. */
+    void * pvContext;                                     /* Passed to xWrite. */
+    uint8_t * pucWindow;                                  /* History of the most recent output, written out each time it fills. */
+    uint32_t ulWindowSize;                                /* Size of the window buffer. */
+    uint32_t ulWindowMask;                                /* Window size used by the image minus 1. */
+    uint32_t ulImageSize;                                 /* Size of the image from the header. */
+    uint32_t ulProduced;                                  /* Bytes of the image decoded so far. */
+    uint32_t ulWritten;                                   /* Bytes of the image written so far. */
+    uint8_t ucHeader[ OTA_DECOMPRESS_HEADER_SIZE ];       /* Partially received header. */
+    uint32_t ulHeaderFill;                                /* Bytes in ucHeader. */
+    uint32_t ulFlags;                                     /* Remaining bits of the current flag byte. */
+    uint32_t ulFlagsLeft;                                 /* Items left in the current flag byte. */
+    uint32_t ulMatchLow;                                  /* First byte of a match split across calls. */
+    bool bMatchLow;                                       /* True if ulMatchLow holds a byte. */
+} OTA_Decompress_t;
+
+/**
+ * @brief Start decompressing an image.
+ *
+ * pucWindow must be a power of 2 in size and at least as large as the window the image
+ * was compressed with. The image is written through xWrite each time the window fills,
+ * so writes are always a full window at aligned offsets except for the last one.
+ */
+OTA_DecompressErr_t OTA_Decompress_Init( OTA_Decompress_t * pxDecompress,
+                                         uint8_t * pucWindow,
+                                         uint32_t ulWindowSize,
+                                         OTA_DecompressWrite_t xWrite,
+                                         void * pvContext );
+
+/**
+ * @brief Decompress the next ulLength bytes of compressed data.
+ *
+ * Data must be passed in order but may be split anywhere.
+ */
+OTA_DecompressErr_t OTA_Decompress_Apply( OTA_Decompress_t * pxDecompress,
+                                          const uint8_t * pucData,
+                                          uint32_t ulLength );
+
+/**
+ * @brief Finish decompressing once all of the data has been passed to OTA_Decompress_Apply().
+ *
+ * Writes the rest of the image and checks the whole image was produced.
+ */
+OTA_DecompressErr_t OTA_Decompress_Finish( OTA_Decompress_t * pxDecompress );
+
+#endif /* ifndef __AWS_OTADECOMPRESS__H__ */
@@ -0,0 +1,343 @@
+/*
+ * FreeRTOS OTA V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/* Standard library includes. */
+#include <stddef.h>
+#include <string.h>
+
+/* OTA delta patch includes. */
+#include "aws_iot_ota_delta.h"
+
+/* Magic bytes at the start of every patch. */
+static const uint8_t ucDeltaMagic[ 4 ] = { 'O', 'T', 'A', 'D' };
+
+/* Decode a little endian 32 bit value. */
+
+static uint32_t prvReadU32( const uint8_t * pucData );
+
+/* Write the output buffer to the target image. */
+
+static OTA_DeltaErr_t prvFlushOutput( OTA_DeltaPatch_t * pxPatch );
+
+/* Decode the completed header or command in the pending buffer. */
+
+static OTA_DeltaErr_t prvDecodePending( OTA_DeltaPatch_t * pxPatch );
+
+/* Copy a range of the base image to the target image. */
+
+static OTA_DeltaErr_t prvCopyFromBase( OTA_DeltaPatch_t * pxPatch,
+                                       uint32_t ulBaseOffset,
+                                       uint32_t ulLength );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvReadU32( const uint8_t * pucData )
+{
+    return ( uint32_t ) pucData[ 0 ] |
+           ( ( uint32_t ) pucData[ 1 ] << 8 ) |
+           ( ( uint32_t ) pucData[ 2 ] << 16 ) |
+           ( ( uint32_t ) pucData[ 3 ] << 24 );
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DeltaErr_t prvFlushOutput( OTA_DeltaPatch_t * pxPatch )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+    int32_t lWritten = 0;
+
+    if( pxPatch->ulOutputFill > 0U )
+    {
+        lWritten = pxPatch->xWriteTarget( pxPatch->pvContext,
+                                          pxPatch->ulOutputOffset,
+                                          pxPatch->pucOutput,
+                                          pxPatch->ulOutputFill );
+
+        if( lWritten < 0 )
+        {
+            eErr = eOTA_DeltaErr_WriteFailed;
+        }
+        else
+        {
+            pxPatch->ulOutputOffset += pxPatch->ulOutputFill;
+            pxPatch->ulOutputFill = 0;
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DeltaErr_t prvCopyFromBase( OTA_DeltaPatch_t * pxPatch,
+                                       uint32_t ulBaseOffset,
+                                       uint32_t ulLength )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+    uint32_t ulChunk = 0;
+    int32_t lRead = 0;
+
+    /* Read the base image straight into the free part of the output buffer. */
+    while( ( eErr == eOTA_DeltaErr_None ) && ( ulLength > 0U ) )
+    {
+        ulChunk = pxPatch->ulOutputSize - pxPatch->ulOutputFill;
+
+        if( ulChunk > ulLength )
+        {
+            ulChunk = ulLength;
+        }
+
+        lRead = pxPatch->xReadBase( pxPatch->pvContext,
+                                    ulBaseOffset,
+                                    &pxPatch->pucOutput[ pxPatch->ulOutputFill ],
+                                    ulChunk );
+
+        if( ( lRead < 0 ) || ( ( uint32_t ) lRead != ulChunk ) )
+        {
+            eErr = eOTA_DeltaErr_ReadBaseFailed;
+        }
+        else
+        {
+            pxPatch->ulOutputFill += ulChunk;
+            ulBaseOffset += ulChunk;
+            ulLength -= ulChunk;
+
+            if( pxPatch->ulOutputFill == pxPatch->ulOutputSize )
+            {
+                eErr = prvFlushOutput( pxPatch );
+            }
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DeltaErr_t prvDecodePending( OTA_DeltaPatch_t * pxPatch )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+    const uint8_t * pucPending = pxPatch->ucPending;
+    uint32_t ulProduced = pxPatch->ulOutputOffset + pxPatch->ulOutputFill;
+    uint32_t ulLength = 0;
+    uint32_t ulBaseOffset = 0;
+
+    if( pxPatch->bHeaderDone == false )
+    {
+        pxPatch->ulBaseSize = prvReadU32( &pucPending[ 8 ] );
+        pxPatch->ulTargetSize = prvReadU32( &pucPending[ 12 ] );
+
+        if( ( memcmp( pucPending, ucDeltaMagic, sizeof( ucDeltaMagic ) ) != 0 ) ||
+            ( prvReadU32( &pucPending[ 4 ] ) != OTA_DELTA_FORMAT_VERSION ) )
+        {
+            eErr = eOTA_DeltaErr_BadHeader;
+        }
+        else
+        {
+            pxPatch->bHeaderDone = true;
+        }
+    }
+    else if( pxPatch->ulPendingSize == 1U )
+    {
+        /* Only the opcode is known so far. Wait for the rest of the command. */
+        if( pucPending[ 0 ] == OTA_DELTA_OP_COPY )
+        {
+            pxPatch->ulPendingSize = OTA_DELTA_COPY_CMD_SIZE;
+        }
+        else if( pucPending[ 0 ] == OTA_DELTA_OP_INSERT )
+        {
+            pxPatch->ulPendingSize = OTA_DELTA_INSERT_CMD_SIZE;
+        }
+        else
+        {
+            eErr = eOTA_DeltaErr_BadCommand;
+        }
+    }
+    else
+    {
+        ulLength = prvReadU32( &pucPending[ 1 ] );
+
+        /* Commands may not produce more than the target image. */
+        if( ( ulLength == 0U ) || ( ulLength > ( pxPatch->ulTargetSize - ulProduced ) ) )
+        {
+            eErr = eOTA_DeltaErr_BadCommand;
+        }
+        else if( pucPending[ 0 ] == OTA_DELTA_OP_COPY )
+        {
+            ulBaseOffset = prvReadU32( &pucPending[ 5 ] );
+
+            if( ( ulBaseOffset > pxPatch->ulBaseSize ) ||
+                ( ulLength > ( pxPatch->ulBaseSize - ulBaseOffset ) ) )
+            {
+                eErr = eOTA_DeltaErr_BadCommand;
+            }
+            else
+            {
+                eErr = prvCopyFromBase( pxPatch, ulBaseOffset, ulLength );
+            }
+        }
+        else
+        {
+            pxPatch->ulInsertRemaining = ulLength;
+        }
+    }
+
+    /* Start collecting the next command unless this was only its opcode. */
+    if( ( eErr == eOTA_DeltaErr_None ) && ( pxPatch->ulPendingFill == pxPatch->ulPendingSize ) )
+    {
+        pxPatch->ulPendingFill = 0;
+        pxPatch->ulPendingSize = 1U;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_DeltaErr_t OTA_Delta_Init( OTA_DeltaPatch_t * pxPatch,
+                               uint8_t * pucOutput,
+                               uint32_t ulOutputSize,
+                               OTA_DeltaReadBase_t xReadBase,
+                               OTA_DeltaWriteTarget_t xWriteTarget,
+                               void * pvContext )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+
+    if( ( pxPatch == NULL ) || ( pucOutput == NULL ) || ( ulOutputSize == 0U ) ||
+        ( xReadBase == NULL ) || ( xWriteTarget == NULL ) )
+    {
+        eErr = eOTA_DeltaErr_BadParams;
+    }
+    else
+    {
+        ( void ) memset( pxPatch, 0, sizeof( OTA_DeltaPatch_t ) );
+        pxPatch->xReadBase = xReadBase;
+        pxPatch->xWriteTarget = xWriteTarget;
+        pxPatch->pvContext = pvContext;
+        pxPatch->pucOutput = pucOutput;
+        pxPatch->ulOutputSize = ulOutputSize;
+        pxPatch->ulPendingSize = OTA_DELTA_HEADER_SIZE;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_DeltaErr_t OTA_Delta_Apply( OTA_DeltaPatch_t * pxPatch,
+                                const uint8_t * pucData,
+                                uint32_t ulLength )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+    uint32_t ulChunk = 0;
+
+    if( ( pxPatch == NULL ) || ( ( pucData == NULL ) && ( ulLength > 0U ) ) )
+    {
+        eErr = eOTA_DeltaErr_BadParams;
+    }
+
+    while( ( eErr == eOTA_DeltaErr_None ) && ( ulLength > 0U ) )
+    {
+        if( pxPatch->ulInsertRemaining > 0U )
+        {
+            /* Literal data goes straight to the output buffer. */
+            ulChunk = pxPatch->ulOutputSize - pxPatch->ulOutputFill;
+
+            if( ulChunk > pxPatch->ulInsertRemaining )
+            {
+                ulChunk = pxPatch->ulInsertRemaining;
+            }
+
+            if( ulChunk > ulLength )
+            {
+                ulChunk = ulLength;
+            }
+
+            ( void ) memcpy( &pxPatch->pucOutput[ pxPatch->ulOutputFill ], pucData, ulChunk );
+            pxPatch->ulOutputFill += ulChunk;
+            pxPatch->ulInsertRemaining -= ulChunk;
+
+            if( pxPatch->ulOutputFill == pxPatch->ulOutputSize )
+            {
+                eErr = prvFlushOutput( pxPatch );
+            }
+        }
+        else if( ( pxPatch->bHeaderDone == true ) &&
+                 ( ( pxPatch->ulOutputOffset + pxPatch->ulOutputFill ) == pxPatch->ulTargetSize ) )
+        {
+            eErr = eOTA_DeltaErr_TrailingData;
+        }
+        else
+        {
+            /* Collect the header or the next command, which may be split across calls. */
+            ulChunk = pxPatch->ulPendingSize - pxPatch->ulPendingFill;
+
+            if( ulChunk > ulLength )
+            {
+                ulChunk = ulLength;
+            }
+
+            ( void ) memcpy( &pxPatch->ucPending[ pxPatch->ulPendingFill ], pucData, ulChunk );
+            pxPatch->ulPendingFill += ulChunk;
+
+            if( pxPatch->ulPendingFill == pxPatch->ulPendingSize )
+            {
+                eErr = prvDecodePending( pxPatch );
+            }
+        }
+
+        pucData += ulChunk;
+        ulLength -= ulChunk;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_DeltaErr_t OTA_Delta_Finish( OTA_DeltaPatch_t * pxPatch )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+
+    if( pxPatch == NULL )
+    {
+        eErr = eOTA_DeltaErr_BadParams;
+    }
+    else
+    {
+        eErr = prvFlushOutput( pxPatch );
+
+        if( ( eErr == eOTA_DeltaErr_None ) &&
+            ( ( pxPatch->bHeaderDone == false ) ||
+              ( pxPatch->ulInsertRemaining > 0U ) ||
+              ( pxPatch->ulPendingFill > 0U ) ||
+              ( pxPatch->ulOutputOffset != pxPatch->ulTargetSize ) ) )
+        {
+            eErr = eOTA_DeltaErr_Incomplete;
+        }
+    }
+
+    return eErr;
+}
@@ -0,0 +1,137 @@
+/*
+ * FreeRTOS OTA V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+#ifndef __AWS_OTADELTA__H__
+#define __AWS_OTADELTA__H__
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Delta patch format, version 1. All integers are little endian.
+ *
+ * Header (16 bytes):
+ *      "OTAD"          Magic.
+ *      uint32_t        Format version, OTA_DELTA_FORMAT_VERSION.
+ *      uint32_t        Size of the base image the patch was generated against.
+ *      uint32_t        Size of the target image the patch produces.
+ *
+ * Followed by commands until the whole target image has been produced:
+ *      OTA_DELTA_OP_COPY,   uint32_t length, uint32_t base offset
+ *          Copy length bytes of the base image starting at base offset.
+ *      OTA_DELTA_OP_INSERT, uint32_t length, length bytes of data
+ *          Append the literal data.
+ *
+ * The target image is produced strictly in order, so the patch can be applied
+ * while it is being received with no more memory than one output buffer.
+ */
+
+#define OTA_DELTA_FORMAT_VERSION    1U    /* The patch format version produced and understood. */
+#define OTA_DELTA_HEADER_SIZE       16U   /* Size of the patch header in bytes. */
+#define OTA_DELTA_OP_COPY           0x01U /* Copy a range of the base image. */
+#define OTA_DELTA_OP_INSERT         0x02U /* Insert literal data. */
+#define OTA_DELTA_COPY_CMD_SIZE     9U    /* Size of a copy command in bytes. */
+#define OTA_DELTA_INSERT_CMD_SIZE   5U    /* Size of an insert command in bytes, excluding its data. */
+
+/* Delta patch application errors. */
+
+typedef enum
+{
+    eOTA_DeltaErr_None = 0,       /* No error. */
+    eOTA_DeltaErr_BadParams,      /* Invalid parameters were passed. */
+    eOTA_DeltaErr_BadHeader,      /* The patch header is not valid. */
+    eOTA_DeltaErr_BadCommand,     /* A patch command is not valid or is out of range. */
+    eOTA_DeltaErr_ReadBaseFailed, /* Reading the base image failed. */
+    eOTA_DeltaErr_WriteFailed,    /* Writing the target image failed. */
+    eOTA_DeltaErr_TrailingData,   /* Patch data remained after the target image was complete. */
+    eOTA_DeltaErr_Incomplete      /* The patch ended before the target image was complete. */
+} OTA_DeltaErr_t;
+
+/* Read ulLength bytes of the base image at ulOffset. Returns the number of bytes read or a negative value on error. */
+
+typedef int32_t (* OTA_DeltaReadBase_t)( void * pvContext,
+                                         uint32_t ulOffset,
+                                         uint8_t * pucData,
+                                         uint32_t ulLength );
+
+/* Write ulLength bytes of the target image at ulOffset. Returns the number of bytes written or a negative value on error. */
+
+typedef int32_t (* OTA_DeltaWriteTarget_t)( void * pvContext,
+                                            uint32_t ulOffset,
+                                            uint8_t * pucData,
+                                            uint32_t ulLength );
+
+/* State of a patch being applied. Treat as opaque. */
+
+typedef struct OTA_DeltaPatch
+{
+    OTA_DeltaReadBase_t xReadBase;              /* Reads the base image. */
+    OTA_DeltaWriteTarget_t xWriteTarget;        /* Writes the target image. */
+    void * pvContext;                           /* Passed to xReadBase and xWriteTarget. */
+    uint8_t * pucOutput;                        /* Buffer the target image is assembled in before it is written. */
+    uint32_t ulOutputSize;                      /* Size of the output buffer. */
+    uint32_t ulOutputFill;                      /* Bytes in the output buffer. */
+    uint32_t ulOutputOffset;                    /* Target image offset of the start of the output buffer. */
+    uint32_t ulBaseSize;                        /* Size of the base image from the header. */
+    uint32_t ulTargetSize;                      /* Size of the target image from the header. */
+    uint32_t ulInsertRemaining;                 /* Literal bytes of the current insert command still to come. */
+    uint8_t ucPending[ OTA_DELTA_HEADER_SIZE ]; /* Partially received header or command. */
+    uint32_t ulPendingFill;                     /* Bytes in ucPending. */
+    uint32_t ulPendingSize;                     /* Bytes needed in ucPending before it can be decoded. */
+    bool bHeaderDone;                           /* True once the header has been decoded. */
+} OTA_DeltaPatch_t;
+
+/**
+ * @brief Start applying a delta patch.
+ *
+ * The target image is assembled in pucOutput and written through xWriteTarget each time
+ * the buffer fills, so writes are always ulOutputSize bytes at aligned offsets except
+ * for the last one.
+ */
+OTA_DeltaErr_t OTA_Delta_Init( OTA_DeltaPatch_t * pxPatch,
+                               uint8_t * pucOutput,
+                               uint32_t ulOutputSize,
+                               OTA_DeltaReadBase_t xReadBase,
+                               OTA_DeltaWriteTarget_t xWriteTarget,
+                               void * pvContext );
+
+/**
+ * @brief Apply the next ulLength bytes of the patch.
+ *
+ * Patch data must be passed in order but may be split anywhere.
+ */
+OTA_DeltaErr_t OTA_Delta_Apply( OTA_DeltaPatch_t * pxPatch,
+                                const uint8_t * pucData,
+                                uint32_t ulLength );
+
+/**
+ * @brief Finish applying a patch once all of it has been passed to OTA_Delta_Apply().
+ *
+ * Writes any buffered output and checks the whole target image was produced.
+ */
+OTA_DeltaErr_t OTA_Delta_Finish( OTA_DeltaPatch_t * pxPatch );
+
+#endif /* ifndef __AWS_OTADELTA__H__ */
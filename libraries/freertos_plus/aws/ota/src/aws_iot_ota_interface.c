@@ -99,6 +99,7 @@ OTA_Err_t prvSetDataInterface( OTA_DataInterface_t * pxDataInterface,
                     pxDataInterface->prvRequestFileBlock = prvRequestFileBlock_Mqtt;
                     pxDataInterface->prvDecodeFileBlock = prvDecodeFileBlock_Mqtt;
                     pxDataInterface->prvCleanup = prvCleanupData_Mqtt;
+                    pxDataInterface->ulMaxFiles = OTA_MAX_FILES;
 
                     OTA_LOG_L1( "[%s] Data interface is set to MQTT.\r\n", OTA_METHOD_NAME );
 
@@ -114,6 +115,7 @@ OTA_Err_t prvSetDataInterface( OTA_DataInterface_t * pxDataInterface,
                     pxDataInterface->prvRequestFileBlock = _AwsIotOTA_RequestDataBlock_HTTP;
                     pxDataInterface->prvDecodeFileBlock = _AwsIotOTA_DecodeFileBlock_HTTP;
                     pxDataInterface->prvCleanup = _AwsIotOTA_CleanupData_HTTP;
+                    pxDataInterface->ulMaxFiles = 1U; /* One download at a time over the HTTP connection. */
 
                     OTA_LOG_L1( "[%s] Data interface is set to HTTP.\r\n", OTA_METHOD_NAME );
 
@@ -75,6 +75,7 @@ typedef struct
                                         uint8_t ** ppucPayload,
                                         size_t * pxPayloadSize );
     OTA_Err_t ( * prvCleanup )( OTA_AgentContext_t * pAgentCtx );
+    uint32_t ulMaxFiles; /* Number of files the interface can receive at the same time. */
 } OTA_DataInterface_t;
 
 /**
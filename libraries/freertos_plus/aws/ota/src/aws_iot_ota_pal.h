@@ -59,6 +59,10 @@ OTA_Err_t prvPAL_Abort( OTA_FileContext_t * const C );
  * @note The previous image may be present in the designated image download partition or file, so the partition or file
  * must be completely erased or overwritten in this routine.
  *
+ * @note The image written to the file is C->ulImageSize bytes. This is the size to check against the
+ * partition and to erase. It differs from C->ulFileSize, the size received, when the file is a delta
+ * patch or is compressed.
+ *
  * @note The input OTA_FileContext_t C is checked for NULL by the OTA agent before this
  * function is called.
  * The device file path is a required field in the OTA job document, so C->pucFilePath is
@@ -89,6 +93,12 @@ OTA_Err_t prvPAL_CreateFileForRx( OTA_FileContext_t * const C );
  *
  * If the signature verification fails, file close should still be attempted.
  *
+ * If C->pvSigVerifyContext is not NULL, the agent has already fed every block of the file to that
+ * CRYPTO_SignatureVerificationStart() context, in order, as the blocks were received. The PAL may
+ * then skip reading the file back and pass the context straight to CRYPTO_SignatureVerificationFinal(),
+ * setting C->pvSigVerifyContext to NULL to take ownership of it. A context left in place is freed by
+ * the agent after this function returns.
+ *
  * @param[in] C OTA file context information.
  *
  * @return The OTA PAL layer error code combined with the MCU specific error code. See OTA Agent
@@ -124,6 +134,52 @@ int16_t prvPAL_WriteBlock( OTA_FileContext_t * const C,
                            uint8_t * const pcData,
                            uint32_t ulBlockSize );
 
+/**
+ * @brief Store the download checkpoint of the specified file.
+ *
+ * Only required when otaconfigCHECKPOINT_BLOCKS is not 0. The agent calls this every
+ * otaconfigCHECKPOINT_BLOCKS blocks while C is open for receive. Every block written so far
+ * must be durable before the checkpoint is, so a checkpoint never claims a block that is
+ * lost by a reset. A stored checkpoint replaces the previous one.
+ *
+ * @note The input OTA_FileContext_t C is checked for NULL by the OTA agent before this
+ * function is called.
+ *
+ * @param[in] C OTA file context information.
+ * @param[in] pucCheckpoint The checkpoint, opaque to the PAL.
+ * @param[in] ulLength Length of the checkpoint. 0 erases the stored checkpoint, and
+ * pucCheckpoint may then be NULL.
+ *
+ * @return kOTA_Err_None on success, otherwise an error code.
+ */
+OTA_Err_t prvPAL_SaveCheckpoint( OTA_FileContext_t * const C,
+                                 const uint8_t * pucCheckpoint,
+                                 uint32_t ulLength );
+
+/**
+ * @brief Reopen a partly received file from its stored checkpoint.
+ *
+ * Only required when otaconfigCHECKPOINT_BLOCKS is not 0. The agent calls this in place of
+ * prvPAL_CreateFileForRx() when a file is offered. If a checkpoint is stored for the file at
+ * C->pucFilePath, it is copied to pucCheckpoint and the file is opened for receive WITHOUT
+ * erasing the blocks already written. If the agent then finds the checkpoint does not match
+ * the file it calls prvPAL_Abort() and prvPAL_CreateFileForRx().
+ *
+ * @note The input OTA_FileContext_t C is checked for NULL by the OTA agent before this
+ * function is called.
+ *
+ * @param[in] C OTA file context information.
+ * @param[out] pucCheckpoint Buffer to copy the checkpoint into.
+ * @param[in] ulMaxLength Size of pucCheckpoint.
+ *
+ * @return The length of the checkpoint with the file open for receive, 0 if no checkpoint is
+ * stored, or a negative value if the checkpoint is larger than ulMaxLength or can't be read.
+ * The file is only left open when a length is returned.
+ */
+int32_t prvPAL_ResumeFileForRx( OTA_FileContext_t * const C,
+                                uint8_t * const pucCheckpoint,
+                                uint32_t ulMaxLength );
+
 /**
  * @brief Activate the newest MCU image received via OTA.
  *
@@ -294,26 +294,48 @@ static void _httpProcessResponseBody( OTA_AgentContext_t * pAgentCtx,
 
     OTA_EventData_t * pMessage;
     OTA_EventMsg_t eventMsg = { 0 };
-
-    pAgentCtx->xStatistics.ulOTA_PacketsReceived++;
+    bool queued = false;
 
     /* Try to get OTA data buffer. */
     pMessage = prvOTAEventBufferGet();
 
     if( pMessage == NULL )
     {
-        pAgentCtx->xStatistics.ulOTA_PacketsDropped++;
         IotLogError( "Could not get a free buffer to copy callback data." );
     }
+    else if( bufferSize > pMessage->ulBufferSize )
+    {
+        /* The event buffers haven't been carved for this block size yet. The block will be requested again. */
+        prvOTAEventBufferFree( pMessage );
+        IotLogError( "Event buffer is too small for the file block." );
+    }
     else
     {
         pMessage->ulDataLength = bufferSize;
 
-        memcpy( pMessage->ucData, pHTTPResponseBody, pMessage->ulDataLength );
+        memcpy( pMessage->pucData, pHTTPResponseBody, pMessage->ulDataLength );
         eventMsg.xEventId = eOTA_AgentEvent_ReceivedFileBlock;
         eventMsg.pxEventData = pMessage;
         /* Send job document received event. */
-        OTA_SignalEvent( &eventMsg );
+        queued = OTA_SignalEvent( &eventMsg );
+
+        if( !queued )
+        {
+            /* The event was not queued so the agent will never free it. */
+            prvOTAEventBufferFree( pMessage );
+        }
+    }
+
+    /* Update the statistics counters the same way as the MQTT data callback. */
+    pAgentCtx->xStatistics.ulOTA_PacketsReceived++;
+
+    if( queued )
+    {
+        pAgentCtx->xStatistics.ulOTA_PacketsQueued++;
+    }
+    else
+    {
+        pAgentCtx->xStatistics.ulOTA_PacketsDropped++;
     }
 }
 
@@ -1076,10 +1098,10 @@ OTA_Err_t _AwsIotOTA_RequestDataBlock_HTTP( OTA_AgentContext_t * pAgentCtx )
     }
 
     /* Set number of blocks to request to 1. */
-    pAgentCtx->ulNumOfBlocksToReceive = 1;
+    pAgentCtx->pxFileRequests[ pAgentCtx->ulFileIndex ].ulNumOfBlocksToReceive = 1;
 
     /* Calculate ranges. */
-    rangeStart = _httpDownloader.currBlock * OTA_FILE_BLOCK_SIZE;
+    rangeStart = _httpDownloader.currBlock * fileContext->ulBlockSize;
 
     if( fileContext->ulBlocksRemaining == 1 )
     {
@@ -1087,7 +1109,7 @@ OTA_Err_t _AwsIotOTA_RequestDataBlock_HTTP( OTA_AgentContext_t * pAgentCtx )
     }
     else
     {
-        rangeEnd = rangeStart + OTA_FILE_BLOCK_SIZE - 1;
+        rangeEnd = rangeStart + fileContext->ulBlockSize - 1;
     }
 
     _httpDownloader.currBlockSize = rangeEnd - rangeStart + 1;
@@ -30,6 +30,7 @@
 
 #include "FreeRTOS.h"
 #include "cbor.h"
+#include "iot_serializer.h"
 #include "aws_iot_ota_cbor.h"
 #include "aws_iot_ota_cbor_internal.h"
 
@@ -39,6 +40,12 @@
 
 #define OTA_CBOR_GETSTREAMREQUEST_ITEM_COUNT    6
 
+/**
+ * @brief Size of the pre-encoded part of a Get Stream Request message: the
+ * map header and the single character keys.
+ */
+#define OTA_CBOR_GETSTREAMREQUEST_CONSTANTS_SIZE    ( 1 + ( 2 * OTA_CBOR_GETSTREAMREQUEST_ITEM_COUNT ) )
+
 /**
  * @brief Internal context structure for decoding CBOR arrays.
  */
@@ -48,6 +55,13 @@ typedef struct OTAMessageDecodeContext
     CborValue xCborRecursedItem;
 } OTAMessageDecodeContext_t, * OTAMessageDecodeContextPtr_t;
 
+/**
+ * @brief Template of the Get Stream Request message and its pre-encoded bytes.
+ */
+static IotSerializerCborTemplate_t xGetStreamRequestTemplate;
+static uint8_t ucGetStreamRequestConstants[ OTA_CBOR_GETSTREAMREQUEST_CONSTANTS_SIZE ];
+static BaseType_t xGetStreamRequestTemplateReady = pdFALSE;
+
 /**
  * @brief Decode a Get Stream response message from AWS IoT OTA.
  */
@@ -162,28 +176,31 @@ BaseType_t OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pucMessageB
         }
     }
 
+    /* The payload is returned as a view into the message buffer, so it must be
+     * a definite length string whose bytes are contiguous. */
     if( CborNoError == xCborResult )
     {
-        xCborResult = cbor_value_calculate_string_length( &xCborValue,
-                                                          pxPayloadSize );
+        if( false == cbor_value_is_length_known( &xCborValue ) )
+        {
+            xCborResult = CborErrorUnknownLength;
+        }
     }
 
     if( CborNoError == xCborResult )
     {
-        *ppucPayload = pvPortMalloc( *pxPayloadSize );
+        xCborResult = cbor_value_get_string_length( &xCborValue,
+                                                    pxPayloadSize );
+    }
 
-        if( NULL == *ppucPayload )
-        {
-            xCborResult = CborErrorOutOfMemory;
-        }
+    /* The bytes of the payload end where the next item starts. */
+    if( CborNoError == xCborResult )
+    {
+        xCborResult = cbor_value_advance( &xCborValue );
     }
 
     if( CborNoError == xCborResult )
     {
-        xCborResult = cbor_value_copy_byte_string( &xCborValue,
-                                                   *ppucPayload,
-                                                   pxPayloadSize,
-                                                   NULL );
+        *ppucPayload = ( uint8_t * ) ( cbor_value_get_next_byte( &xCborValue ) - *pxPayloadSize );
     }
 
     return CborNoError == xCborResult;
@@ -191,6 +208,36 @@ BaseType_t OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pucMessageB
 
 
 
+/**
+ * @brief Create the template of the Get Stream Request message. Only the
+ * values of the six keys change from one request to the next.
+ */
+static BaseType_t prvCreateGetStreamRequestTemplate( void )
+{
+    const IotSerializerCborTemplateItem_t xItems[] =
+    {
+        IotSerializer_CborTemplateMap( OTA_CBOR_GETSTREAMREQUEST_ITEM_COUNT ),
+        IotSerializer_CborTemplateKey( OTA_CBOR_CLIENTTOKEN_KEY ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_TEXT_STRING ),
+        IotSerializer_CborTemplateKey( OTA_CBOR_FILEID_KEY ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT ),
+        IotSerializer_CborTemplateKey( OTA_CBOR_BLOCKSIZE_KEY ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT ),
+        IotSerializer_CborTemplateKey( OTA_CBOR_BLOCKOFFSET_KEY ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT ),
+        IotSerializer_CborTemplateKey( OTA_CBOR_BLOCKBITMAP_KEY ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_BYTE_STRING ),
+        IotSerializer_CborTemplateKey( OTA_CBOR_NUMBEROFBLOCKS_KEY ),
+        IotSerializer_CborTemplateSlot( IOT_SERIALIZER_SCALAR_SIGNED_INT )
+    };
+
+    return IOT_SERIALIZER_SUCCESS == IotSerializer_CborTemplateCreate( &xGetStreamRequestTemplate,
+                                                                       xItems,
+                                                                       sizeof( xItems ) / sizeof( xItems[ 0 ] ),
+                                                                       ucGetStreamRequestConstants,
+                                                                       sizeof( ucGetStreamRequestConstants ) );
+}
+
 /**
  * @brief Create an encoded Get Stream Request message for the AWS IoT OTA
  * service. The service allows block count or block bitmap to be requested,
@@ -207,110 +254,46 @@ BaseType_t OTA_CBOR_Encode_GetStreamRequestMessage( uint8_t * pucMessageBuffer,
                                                     size_t xBlockBitmapSize,
                                                     int32_t lNumOfBlocksRequested )
 {
-    CborError xCborResult = CborNoError;
-    CborEncoder xCborEncoder, xCborMapEncoder;
-
-    /* Initialize the CBOR encoder. */
-    cbor_encoder_init( &xCborEncoder,
-                       pucMessageBuffer,
-                       xMessageBufferSize,
-                       0 );
-    xCborResult = cbor_encoder_create_map( &xCborEncoder,
-                                           &xCborMapEncoder,
-                                           OTA_CBOR_GETSTREAMREQUEST_ITEM_COUNT );
-
-    /* Encode the client token key and value. */
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encode_text_stringz( &xCborMapEncoder,
-                                                OTA_CBOR_CLIENTTOKEN_KEY );
-    }
-
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encode_text_stringz( &xCborMapEncoder,
-                                                pcClientToken );
-    }
-
-    /* Encode the file ID key and value. */
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encode_text_stringz( &xCborMapEncoder,
-                                                OTA_CBOR_FILEID_KEY );
-    }
-
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encode_int( &xCborMapEncoder,
-                                       lFileId );
-    }
+    BaseType_t xResult = pdTRUE;
+    size_t xEncodedSize = 0;
 
-    /* Encode the block size key and value. */
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encode_text_stringz( &xCborMapEncoder,
-                                                OTA_CBOR_BLOCKSIZE_KEY );
-    }
-
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encode_int( &xCborMapEncoder,
-                                       lBlockSize );
-    }
-
-    /* Encode the block offset key and value. */
-    if( CborNoError == xCborResult )
+    /* Requests are sent by the OTA agent task only, so the template is
+     * created on first use without locking. */
+    if( pdFALSE == xGetStreamRequestTemplateReady )
     {
-        xCborResult = cbor_encode_text_stringz( &xCborMapEncoder,
-                                                OTA_CBOR_BLOCKOFFSET_KEY );
+        xResult = prvCreateGetStreamRequestTemplate();
+        xGetStreamRequestTemplateReady = xResult;
     }
 
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encode_int( &xCborMapEncoder,
-                                       lBlockOffset );
-    }
-
-    /* Encode the block bitmap key and value. */
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encode_text_stringz( &xCborMapEncoder,
-                                                OTA_CBOR_BLOCKBITMAP_KEY );
-    }
-
-    if( CborNoError == xCborResult )
+    if( pdTRUE == xResult )
     {
-        xCborResult = cbor_encode_byte_string( &xCborMapEncoder,
-                                               pucBlockBitmap,
-                                               xBlockBitmapSize );
-    }
-
-    /* Encode the number of blocks requested key and value. */
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encode_text_stringz( &xCborMapEncoder,
-                                                OTA_CBOR_NUMBEROFBLOCKS_KEY );
-    }
-
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encode_int( &xCborMapEncoder,
-                                       lNumOfBlocksRequested );
-    }
-
-    /* Done with the encoder. */
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_encoder_close_container_checked( &xCborEncoder,
-                                                            &xCborMapEncoder );
+        const IotSerializerScalarData_t xValues[] =
+        {
+            IotSerializer_ScalarTextString( pcClientToken ),
+            IotSerializer_ScalarSignedInt( lFileId ),
+            IotSerializer_ScalarSignedInt( lBlockSize ),
+            IotSerializer_ScalarSignedInt( lBlockOffset ),
+            IotSerializer_ScalarByteString( pucBlockBitmap, xBlockBitmapSize ),
+            IotSerializer_ScalarSignedInt( lNumOfBlocksRequested )
+        };
+
+        /* Copy the pre-encoded keys and encode the values in between. */
+        if( IOT_SERIALIZER_SUCCESS != IotSerializer_CborTemplateEncode( &xGetStreamRequestTemplate,
+                                                                        xValues,
+                                                                        OTA_CBOR_GETSTREAMREQUEST_ITEM_COUNT,
+                                                                        pucMessageBuffer,
+                                                                        xMessageBufferSize,
+                                                                        &xEncodedSize ) )
+        {
+            xResult = pdFALSE;
+        }
     }
 
     /* Get the encoded size. */
-    if( CborNoError == xCborResult )
+    if( pdTRUE == xResult )
     {
-        *pxEncodedMessageSize = cbor_encoder_get_buffer_size( &xCborEncoder,
-                                                              pucMessageBuffer );
+        *pxEncodedMessageSize = xEncodedSize;
     }
 
-    return CborNoError == xCborResult;
+    return xResult;
 }
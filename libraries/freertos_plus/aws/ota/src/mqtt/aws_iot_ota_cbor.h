@@ -28,6 +28,9 @@
 
 /**
  * @brief Decode a Get Stream response message from AWS IoT OTA.
+ *
+ * The payload is not copied; on success ppucPayload points into
+ * pucMessageBuffer and is only valid for as long as the message buffer is.
  */
 BaseType_t OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pucMessageBuffer,
                                                      size_t xMessageSize,
@@ -131,6 +131,17 @@ static bool prvUnSubscribeFromDataStream( const OTA_AgentContext_t * pxAgentCtx
 
 static void prvUnSubscribeFromJobNotificationTopic( const OTA_AgentContext_t * pxAgentCtx );
 
+/* Select the missing blocks for the next windowed file block request. */
+
+#if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U )
+    static uint32_t prvSelectWindowBlocks( const OTA_FileContext_t * C,
+                                           uint32_t ulNumBlocks,
+                                           uint32_t ulFirstBlock,
+                                           uint32_t ulMaxBlocks,
+                                           uint8_t * pucRequestBitmap,
+                                           uint32_t * pulNextBlock );
+#endif
+
 /* Publish a message using the platforms PubSub mechanism. */
 
 static IotMqttError_t prvPublishMessage( const OTA_AgentContext_t * pxAgentCtx,
@@ -436,7 +447,7 @@ static uint32_t prvBuildStatusMessageReceiving( char * pcMsgBuffer,
 
     if( pxOTAFileCtx != NULL )
     {
-        ulNumBlocks = ( pxOTAFileCtx->ulFileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
+        ulNumBlocks = OTA_FILE_NUM_BLOCKS( pxOTAFileCtx );
         ulReceived = ulNumBlocks - pxOTAFileCtx->ulBlocksRemaining;
 
         if( ( ulReceived % OTA_UPDATE_STATUS_FREQUENCY ) == 0U ) /* Output a status update once in a while. */
@@ -563,13 +574,45 @@ static void prvSendCallbackEvent( void * pvCallbackContext,
 
         if( pxData != NULL )
         {
-            memcpy( pxData->ucData, pxPublishData->u.message.info.pPayload, pxPublishData->u.message.info.payloadLength );
-            pxData->ulDataLength = pxPublishData->u.message.info.payloadLength;
-            xEventMsg.xEventId = xEventId;
-            xEventMsg.pxEventData = pxData;
+            /* File blocks are decoded in place, so take ownership of the MQTT
+             * receive buffer instead of copying the payload out of it. Job
+             * documents are parsed in the event buffer and are always copied. */
+            if( ( xEventId == eOTA_AgentEvent_ReceivedFileBlock ) &&
+                ( pxPublishData->u.message.pReceivedData != NULL ) )
+            {
+                pxData->pvReceivedData = pxPublishData->u.message.pReceivedData;
+                pxData->vFreeReceivedData = IotMqtt_FreeReceivedData;
+                pxData->pucData = ( uint8_t * ) pxPublishData->u.message.info.pPayload;
+                pxPublishData->u.message.pReceivedData = NULL;
+                xErr = pdTRUE;
+            }
+            else if( pxPublishData->u.message.info.payloadLength <= pxData->ulBufferSize )
+            {
+                memcpy( pxData->pucData, pxPublishData->u.message.info.pPayload, pxPublishData->u.message.info.payloadLength );
+                xErr = pdTRUE;
+            }
+            else
+            {
+                /* Event buffers are carved for the current block size and this doesn't fit. */
+                OTA_LOG_L1( "Error: buffers are too small %d to contains the payload %d.\r\n", pxData->ulBufferSize, pxPublishData->u.message.info.payloadLength );
+                prvOTAEventBufferFree( pxData );
+            }
 
-            /* Send job document received event. */
-            xErr = OTA_SignalEvent( &xEventMsg );
+            if( xErr == pdTRUE )
+            {
+                pxData->ulDataLength = pxPublishData->u.message.info.payloadLength;
+                xEventMsg.xEventId = xEventId;
+                xEventMsg.pxEventData = pxData;
+
+                /* Send job document received event. */
+                xErr = OTA_SignalEvent( &xEventMsg );
+
+                if( xErr != pdTRUE )
+                {
+                    /* The event was not queued so the agent will never free it. */
+                    prvOTAEventBufferFree( pxData );
+                }
+            }
         }
         else
         {
@@ -581,14 +624,17 @@ static void prvSendCallbackEvent( void * pvCallbackContext,
         OTA_LOG_L1( "Error: buffers are too small %d to contains the payload %d.\r\n", OTA_DATA_BLOCK_SIZE, pxPublishData->u.message.info.payloadLength );
     }
 
+    /* Update packet received statistics counter. */
+    pxAgentCtx->xStatistics.ulOTA_PacketsReceived++;
+
     if( xErr == pdTRUE )
     {
-        /* Update packet received statistics counter. */
-        pxAgentCtx->xStatistics.ulOTA_PacketsReceived++;
+        /* Update packet queued statistics counter. */
+        pxAgentCtx->xStatistics.ulOTA_PacketsQueued++;
     }
     else
     {
-        /* Update packet received statistics counter. */
+        /* Update packet dropped statistics counter. */
         pxAgentCtx->xStatistics.ulOTA_PacketsDropped++;
     }
 }
@@ -795,9 +841,66 @@ OTA_Err_t prvInitFileTransfer_Mqtt( OTA_AgentContext_t * pxAgentCtx )
         OTA_LOG_L1( "[%s] Failed to build stream topic.\n\r", OTA_METHOD_NAME );
     }
 
+    #if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U )
+        if( xResult == kOTA_Err_None )
+        {
+            OTA_FileRequest_t * pxRequest = &( pxAgentCtx->pxFileRequests[ pxAgentCtx->ulFileIndex ] );
+
+            /* Start the window at the configured request size and let it grow from there. */
+            pxRequest->xRequestWindow.ulSize = ( otaconfigMAX_NUM_BLOCKS_REQUEST < OTA_REQUEST_WINDOW_MAX_BLOCKS ) ?
+                                               otaconfigMAX_NUM_BLOCKS_REQUEST : OTA_REQUEST_WINDOW_MAX_BLOCKS;
+
+            if( ( pxRequest->ulBlockShare > 0U ) && ( pxRequest->xRequestWindow.ulSize > pxRequest->ulBlockShare ) )
+            {
+                pxRequest->xRequestWindow.ulSize = pxRequest->ulBlockShare;
+            }
+
+            pxRequest->xRequestWindow.ulDropped = pxAgentCtx->xStatistics.ulOTA_PacketsDropped;
+        }
+    #endif
+
     return xResult;
 }
 
+#if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U )
+
+    /*
+     * Mark up to ulMaxBlocks missing blocks, starting at ulFirstBlock, in the request bitmap.
+     */
+    static uint32_t prvSelectWindowBlocks( const OTA_FileContext_t * C,
+                                           uint32_t ulNumBlocks,
+                                           uint32_t ulFirstBlock,
+                                           uint32_t ulMaxBlocks,
+                                           uint8_t * pucRequestBitmap,
+                                           uint32_t * pulNextBlock )
+    {
+        uint32_t ulBlock = ulFirstBlock;
+        uint32_t ulCount = 0;
+        uint32_t ulByte;
+        uint8_t ucBitMask;
+
+        /* Blocks before ulFirstBlock have been received or are already in flight. */
+        while( ( ulCount < ulMaxBlocks ) && ( ulBlock < ulNumBlocks ) )
+        {
+            ucBitMask = ( uint8_t ) ( 1U << ( ulBlock % BITS_PER_BYTE ) );
+            ulByte = ulBlock >> LOG2_BITS_PER_BYTE;
+
+            if( ( C->pucRxBlockBitmap[ ulByte ] & ucBitMask ) != 0U )
+            {
+                pucRequestBitmap[ ulByte ] |= ucBitMask;
+                ulCount++;
+            }
+
+            ulBlock++;
+        }
+
+        *pulNextBlock = ulBlock;
+
+        return ulCount;
+    }
+
+#endif /* if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U ) */
+
 /*
  * Request file block by publishing to the get stream topic.
  */
@@ -809,35 +912,82 @@ OTA_Err_t prvRequestFileBlock_Mqtt( OTA_AgentContext_t * pxAgentCtx )
     uint32_t ulNumBlocks, ulBitmapLen;
     uint32_t ulMsgSizeToPublish = 0;
     uint32_t ulTopicLen = 0;
+    uint32_t ulBlocksToRequest = otaconfigMAX_NUM_BLOCKS_REQUEST;
+    uint8_t * pucBlockBitmap = NULL;
     IotMqttError_t eResult = IOT_MQTT_STATUS_PENDING;
     OTA_Err_t xErr = kOTA_Err_Uninitialized;
     char pcMsg[ OTA_REQUEST_MSG_MAX_SIZE ];
     char pcTopicBuffer[ OTA_MAX_TOPIC_LEN ];
 
+    OTA_FileRequest_t * pxRequest = &( pxAgentCtx->pxFileRequests[ pxAgentCtx->ulFileIndex ] );
+
+    #if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U )
+        OTA_RequestWindow_t * pxWindow = &( pxRequest->xRequestWindow );
+        uint8_t ucWindowBitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+        uint32_t ulNextBlock = 0;
+    #endif
+
     /*
      * Get the current file context.
      */
     OTA_FileContext_t * C = &( pxAgentCtx->pxOTA_Files[ pxAgentCtx->ulFileIndex ] );
 
+    /* Leave event buffers for the other files being received. */
+    if( ( pxRequest->ulBlockShare > 0U ) && ( ulBlocksToRequest > pxRequest->ulBlockShare ) )
+    {
+        ulBlocksToRequest = pxRequest->ulBlockShare;
+    }
+
     /* Reset number of blocks requested. */
-    pxAgentCtx->ulNumOfBlocksToReceive = otaconfigMAX_NUM_BLOCKS_REQUEST;
+    pxRequest->ulNumOfBlocksToReceive = ulBlocksToRequest;
 
     if( C != NULL )
     {
-        ulNumBlocks = ( C->ulFileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
+        ulNumBlocks = OTA_FILE_NUM_BLOCKS( C );
         ulBitmapLen = ( ulNumBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+        pucBlockBitmap = C->pucRxBlockBitmap;
+
+        #if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U )
 
-        if( pdTRUE == OTA_CBOR_Encode_GetStreamRequestMessage(
-                ( uint8_t * ) pcMsg,
-                sizeof( pcMsg ),
-                &xMsgSizeFromStream,
-                OTA_CLIENT_TOKEN,
-                ( int32_t ) C->ulServerFileID,
-                ( int32_t ) ( OTA_FILE_BLOCK_SIZE & 0x7fffffffUL ), /* Mask to keep lint happy. It's still a constant. */
-                0,
-                C->pucRxBlockBitmap,
-                ulBitmapLen,
-                otaconfigMAX_NUM_BLOCKS_REQUEST ) )
+            /* In windowed mode only the blocks that fit in the window and are not
+             * already in flight are requested. The request carries a bitmap with
+             * just those blocks set. */
+            if( ( pxWindow->ulSize > 0U ) && ( ulBitmapLen <= sizeof( ucWindowBitmap ) ) )
+            {
+                ulBlocksToRequest = ( pxWindow->ulSize > pxWindow->ulInFlight ) ? ( pxWindow->ulSize - pxWindow->ulInFlight ) : 0U;
+                ( void ) memset( ucWindowBitmap, 0, ulBitmapLen );
+                pucBlockBitmap = ucWindowBitmap;
+
+                if( ulBlocksToRequest > 0U )
+                {
+                    ulBlocksToRequest = prvSelectWindowBlocks( C, ulNumBlocks, pxWindow->ulNextBlock, ulBlocksToRequest, ucWindowBitmap, &ulNextBlock );
+
+                    /* Nothing is in flight but blocks are still missing, so start over
+                     * from the beginning of the file. */
+                    if( ( ulBlocksToRequest == 0U ) && ( pxWindow->ulInFlight == 0U ) )
+                    {
+                        ulBlocksToRequest = prvSelectWindowBlocks( C, ulNumBlocks, 0, pxWindow->ulSize, ucWindowBitmap, &ulNextBlock );
+                    }
+                }
+            }
+        #endif /* if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U ) */
+
+        if( ulBlocksToRequest == 0U )
+        {
+            /* Every missing block is already in flight. */
+            xErr = kOTA_Err_None;
+        }
+        else if( pdTRUE == OTA_CBOR_Encode_GetStreamRequestMessage(
+                     ( uint8_t * ) pcMsg,
+                     sizeof( pcMsg ),
+                     &xMsgSizeFromStream,
+                     OTA_CLIENT_TOKEN,
+                     ( int32_t ) C->ulServerFileID,
+                     ( int32_t ) ( C->ulBlockSize & 0x7fffffffUL ), /* Mask to keep lint happy. */
+                     0,
+                     pucBlockBitmap,
+                     ulBitmapLen,
+                     ( int32_t ) ulBlocksToRequest ) )
         {
             xErr = kOTA_Err_None;
         }
@@ -848,7 +998,7 @@ OTA_Err_t prvRequestFileBlock_Mqtt( OTA_AgentContext_t * pxAgentCtx )
         }
     }
 
-    if( xErr == kOTA_Err_None )
+    if( ( xErr == kOTA_Err_None ) && ( ulBlocksToRequest > 0U ) )
     {
         ulMsgSizeToPublish = ( uint32_t ) xMsgSizeFromStream;
 
@@ -871,7 +1021,7 @@ OTA_Err_t prvRequestFileBlock_Mqtt( OTA_AgentContext_t * pxAgentCtx )
         }
     }
 
-    if( xErr == kOTA_Err_None )
+    if( ( xErr == kOTA_Err_None ) && ( ulBlocksToRequest > 0U ) )
     {
         eResult = prvPublishMessage(
             pxAgentCtx,
@@ -890,6 +1040,16 @@ OTA_Err_t prvRequestFileBlock_Mqtt( OTA_AgentContext_t * pxAgentCtx )
         {
             OTA_LOG_L1( "[%s] OK: %s\r\n", OTA_METHOD_NAME, pcTopicBuffer );
             xErr = kOTA_Err_None;
+
+            #if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U )
+                if( pxWindow->ulSize > 0U )
+                {
+                    pxWindow->ulInFlight += ulBlocksToRequest;
+                    pxWindow->ulNextBlock = ulNextBlock;
+                    pxWindow->xRequestTime = xTaskGetTickCount();
+                    pxWindow->bAwaitingFirstBlock = true;
+                }
+            #endif
         }
     }
 
@@ -917,20 +1077,13 @@ OTA_Err_t prvDecodeFileBlock_Mqtt( uint8_t * pucMessageBuffer,
             plFileId,
             plBlockId,   /*lint !e9087 CBOR requires pointer to int and our block index's never exceed 31 bits. */
             plBlockSize, /*lint !e9087 CBOR requires pointer to int and our block sizes never exceed 31 bits. */
-            ppucPayload, /* This payload gets malloc'd by OTA_CBOR_Decode_GetStreamResponseMessage(). We must free it. */
+            ppucPayload, /* The payload points into pucMessageBuffer; it is not copied. */
             pxPayloadSize ) )
     {
         xErr = kOTA_Err_GenericIngestError;
     }
     else
     {
-        /* Decode the CBOR content. */
-        memcpy( pucMessageBuffer, *ppucPayload, *pxPayloadSize );
-
-        /* Free the payload as it is copied in data buffer. */
-        vPortFree( *ppucPayload );
-        *ppucPayload = pucMessageBuffer;
-
         xErr = kOTA_Err_None;
     }
 
@@ -962,3 +1115,10 @@ OTA_Err_t prvCleanupData_Mqtt( OTA_AgentContext_t * pxAgentCtx )
 
     return kOTA_Err_None;
 }
+
+/*-----------------------------------------------------------*/
+
+/* Provide access to private members for testing. */
+#ifdef FREERTOS_ENABLE_UNIT_TESTS
+    #include "aws_ota_mqtt_test_access_define.h"
+#endif
@@ -80,7 +80,7 @@ OTA_Err_t prvRequestFileBlock_Mqtt( OTA_AgentContext_t * pxAgentCtx );
  * @param[out] plFileId        The server file ID.
  * @param[out] plBlockId       The file block ID.
  * @param[out] plBlockSize     The file block size.
- * @param[out] ppucPayload     The payload.
+ * @param[out] ppucPayload     The payload. This points into pucMessageBuffer.
  * @param[out] pxPayloadSize   The payload size.
  *
  * @return The OTA PAL layer error code combined with the MCU specific error code. See OTA Agent
@@ -54,4 +54,46 @@ DocParseErr_t TEST_OTA_prvParseJSONbyModel( const char * pcJSON,
 
 void TEST_OTA_prvSetDataInterfaceMQTT();
 
+uint32_t TEST_OTA_prvSelectBlockSize( const OTA_FileContext_t * C,
+                                      pxOTASelectBlockSizeCallback_t xSelectBlockSize );
+
+void TEST_OTA_prvEventBufferInit( uint32_t ulBufferSize );
+
+void TEST_OTA_prvEventBufferResize( uint32_t ulBufferSize );
+
+uint32_t TEST_OTA_ulEventBufferFreeHead( void );
+
+void TEST_OTA_prvEventBufferSetTag( uint32_t ulTag );
+
+OTA_FileContext_t * TEST_OTA_prvGetFreeContext( void );
+
+OTA_FileContext_t * TEST_OTA_prvGetJobFile( uint32_t ulServerFileID );
+
+OTA_FileContext_t * TEST_OTA_prvGetFileForBlock( const OTA_EventData_t * pxEventData );
+
+uint32_t TEST_OTA_prvFilesReceiving( void );
+
+void TEST_OTA_prvCloseJobFiles( void );
+
+bool TEST_OTA_prvRequestWindowBlockReceived( OTA_FileRequest_t * pxRequest );
+
+void TEST_OTA_prvRequestWindowRestart( OTA_FileRequest_t * pxRequest );
+
+#if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+    void TEST_OTA_prvStreamingHashStart( OTA_FileContext_t * C );
+
+    bool TEST_OTA_prvStreamingHashDefers( const OTA_FileContext_t * C,
+                                          uint32_t ulBlockIndex );
+
+    void TEST_OTA_prvStreamingHashBlock( OTA_FileContext_t * C,
+                                         uint32_t ulBlockIndex,
+                                         const uint8_t * pucData,
+                                         uint32_t ulBlockSize );
+
+    void TEST_OTA_prvStreamingHashRelease( OTA_FileContext_t * C,
+                                           bool bAbandon );
+
+    const OTA_StreamingHash_t * TEST_OTA_pxStreamingHash( void );
+#endif
+
 #endif /* ifndef _AWS_OTA_AGENT_TEST_ACCESS_DECLARE_H_ */
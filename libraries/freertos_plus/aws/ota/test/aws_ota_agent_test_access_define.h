@@ -76,4 +76,154 @@ void TEST_OTA_prvSetDataInterfaceMQTT()
     prvSetDataInterface( &xOTA_DataInterface, ( const uint8_t * ) "MQTT" );
 }
 
+/*-----------------------------------------------------------*/
+
+uint32_t TEST_OTA_prvSelectBlockSize( const OTA_FileContext_t * C,
+                                      pxOTASelectBlockSizeCallback_t xSelectBlockSize )
+{
+    uint32_t ulBlockSize;
+    pxOTASelectBlockSizeCallback_t xSaved = xOTA_Agent.xPALCallbacks.xSelectBlockSize;
+
+    xOTA_Agent.xPALCallbacks.xSelectBlockSize = xSelectBlockSize;
+    ulBlockSize = prvSelectBlockSize( C );
+    xOTA_Agent.xPALCallbacks.xSelectBlockSize = xSaved;
+
+    return ulBlockSize;
+}
+
+/*-----------------------------------------------------------*/
+
+void TEST_OTA_prvEventBufferInit( uint32_t ulBufferSize )
+{
+    ulEventBuffersInUse = 0;
+    prvEventBufferCarve( ulBufferSize );
+    ulEventBufferPendingSize = ulEventBufferSize;
+    ulEventBufferFreeHead = 0;
+    prvEventBufferPushChain( 1U, ulEventBufferCount );
+}
+
+/*-----------------------------------------------------------*/
+
+void TEST_OTA_prvEventBufferResize( uint32_t ulBufferSize )
+{
+    prvEventBufferResize( ulBufferSize );
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t TEST_OTA_ulEventBufferFreeHead( void )
+{
+    return ulEventBufferFreeHead;
+}
+
+/*-----------------------------------------------------------*/
+
+void TEST_OTA_prvEventBufferSetTag( uint32_t ulTag )
+{
+    ulEventBufferFreeHead = ( ulTag * OTA_EVENT_BUFFER_TAG_INCREMENT ) | ( ulEventBufferFreeHead & OTA_EVENT_BUFFER_LINK_MASK );
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_FileContext_t * TEST_OTA_prvGetFreeContext( void )
+{
+    return prvGetFreeContext();
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_FileContext_t * TEST_OTA_prvGetJobFile( uint32_t ulServerFileID )
+{
+    uint32_t ulIndex;
+    OTA_FileContext_t * C = NULL;
+
+    for( ulIndex = 0U; ( C == NULL ) && ( ulIndex < OTA_MAX_FILES ); ulIndex++ )
+    {
+        if( ( xOTA_Agent.pxOTA_Files[ ulIndex ].pucFilePath != NULL ) &&
+            ( xOTA_Agent.pxOTA_Files[ ulIndex ].ulServerFileID == ulServerFileID ) )
+        {
+            C = &xOTA_Agent.pxOTA_Files[ ulIndex ];
+        }
+    }
+
+    return C;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_FileContext_t * TEST_OTA_prvGetFileForBlock( const OTA_EventData_t * pxEventData )
+{
+    return prvGetFileForBlock( pxEventData );
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t TEST_OTA_prvFilesReceiving( void )
+{
+    return prvFilesReceiving();
+}
+
+/*-----------------------------------------------------------*/
+
+void TEST_OTA_prvCloseJobFiles( void )
+{
+    prvCloseJobFiles();
+}
+
+/*-----------------------------------------------------------*/
+
+bool TEST_OTA_prvRequestWindowBlockReceived( OTA_FileRequest_t * pxRequest )
+{
+    return prvRequestWindowBlockReceived( pxRequest );
+}
+
+/*-----------------------------------------------------------*/
+
+void TEST_OTA_prvRequestWindowRestart( OTA_FileRequest_t * pxRequest )
+{
+    prvRequestWindowRestart( pxRequest );
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+    void TEST_OTA_prvStreamingHashStart( OTA_FileContext_t * C )
+    {
+        prvStreamingHashStart( C );
+    }
+
+/*-----------------------------------------------------------*/
+
+    bool TEST_OTA_prvStreamingHashDefers( const OTA_FileContext_t * C,
+                                          uint32_t ulBlockIndex )
+    {
+        return prvStreamingHashDefers( C, ulBlockIndex );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void TEST_OTA_prvStreamingHashBlock( OTA_FileContext_t * C,
+                                         uint32_t ulBlockIndex,
+                                         const uint8_t * pucData,
+                                         uint32_t ulBlockSize )
+    {
+        prvStreamingHashBlock( C, ulBlockIndex, pucData, ulBlockSize );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void TEST_OTA_prvStreamingHashRelease( OTA_FileContext_t * C,
+                                           bool bAbandon )
+    {
+        prvStreamingHashRelease( C, bAbandon );
+    }
+
+/*-----------------------------------------------------------*/
+
+    const OTA_StreamingHash_t * TEST_OTA_pxStreamingHash( void )
+    {
+        return &xOTA_Agent.xStreamingHash;
+    }
+#endif /* if ( OTA_STREAMING_SIGNATURE_CHECK != 0U ) */
+
 #endif /* _AWS_OTA_AGENT_TEST_ACCESS_DEFINE_H_ */
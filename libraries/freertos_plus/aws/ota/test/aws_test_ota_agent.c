@@ -39,6 +39,7 @@
 #include "unity.h"
 #include "jsmn.h"
 #include "aws_ota_agent_test_access_declare.h"
+#include "aws_ota_mqtt_test_access_declare.h"
 #include "aws_iot_ota_agent.h"
 #include "aws_clientcredential.h"
 #include "aws_iot_ota_agent_internal.h"
@@ -118,6 +119,51 @@ static const uint8_t ucOtatestSIGNATURE[] =
  */
 #define otatestLASER_JSON_WITH_SELF_TEST         "{\"clientToken\":\"mytoken\",\"timestamp\":1508445004,\"execution\":{\"self_test\":\"true\",\"jobId\":\"15\",\"status\":\"QUEUED\",\"queuedAt\":1507697924,\"lastUpdatedAt\":1507697924,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\": {\"streamname\": \"1\",\"files\": [{\"filepath\": \"payload.bin\",\"version\":\"1.0.0.0\",\"filesize\": 90860,\"fileid\": 0,\"attr\": 3,\"certfile\":\"rsasigner.crt\", \"" otatestVALID_SIG_METHOD "\":\"OHj5sNjxqMNK3WNEwbyfs/PeSSS1kzLkAQ4MSu0yKNFoGxJrUKuIWhjQbQiPlXcDtXlSXE8ydAwoxnnw5lcwpJsbXxD1K1PwZJoc/3mv5XHXbvvEoFr4yA0rhY4tyrMDBesEtOVrW0yI4mM4Lde5OtdIxo8sjTSPGXo2Ejuhn+LDRD3gKdb1gtPpoJ/YBQmYKXHFQ5QW58GOSlB9prq5v+MloVCATjmzb9tu4msScXYYy41ikEhK2eyfl7/vpc2vMNX6uhyyeZhku9namI4OZmsp72tLL4D4pFt4/nDWYSAo8sQAwns1RNY+j52KfvgvKKN3u6G3suFyVQoxWJu3aA==\"}]}}}}"
 
+#define otatestSECOND_FILE_SIZE       1024
+#define otatestSECOND_FILE_PATH       "payload2.bin"
+#define otatestSECOND_FILE_ID         1
+
+/**
+ * @brief Job document with a file group built from otatestJOB_FILE entries.
+ */
+#define otatestJOB_JSON( files )      "{\"clientToken\":\"mytoken\",\"timestamp\":1508445004,\"execution\":{\"jobId\":\"16\",\"status\":\"QUEUED\",\"queuedAt\":1507697924,\"lastUpdatedAt\":1507697924,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\": {\"protocols\":[\"MQTT\"],\"streamname\": \"1\",\"files\": [" files "]}}}}"
+
+/**
+ * @brief One file of a job document. Extra keys, each followed by a comma, go in front of the certificate.
+ */
+#define otatestJOB_FILE( path, size, id, extra )    "{\"filepath\": \"" path "\",\"version\":\"1.0.0.0\",\"filesize\": " size ",\"fileid\": " id ",\"attr\": 3," extra "\"certfile\":\"rsasigner.crt\", \"" otatestVALID_SIG_METHOD "\":\"OHj5sNjxqMNK3WNEwbyfs/PeSSS1kzLkAQ4MSu0yKNFoGxJrUKuIWhjQbQiPlXcDtXlSXE8ydAwoxnnw5lcwpJsbXxD1K1PwZJoc/3mv5XHXbvvEoFr4yA0rhY4tyrMDBesEtOVrW0yI4mM4Lde5OtdIxo8sjTSPGXo2Ejuhn+LDRD3gKdb1gtPpoJ/YBQmYKXHFQ5QW58GOSlB9prq5v+MloVCATjmzb9tu4msScXYYy41ikEhK2eyfl7/vpc2vMNX6uhyyeZhku9namI4OZmsp72tLL4D4pFt4/nDWYSAo8sQAwns1RNY+j52KfvgvKKN3u6G3suFyVQoxWJu3aA==\"}"
+
+/**
+ * @brief Job document with two files on the same stream.
+ */
+#define otatestTWO_FILES_JSON                       \
+    otatestJOB_JSON( otatestJOB_FILE( "payload.bin", "90860", "0", "" ) "," \
+                     otatestJOB_FILE( "payload2.bin", "1024", "1", "" ) )
+
+/**
+ * @brief Job document with two compressed files. Only one file of a job may be processed in order.
+ */
+#define otatestTWO_COMPRESSED_FILES_JSON                                                                \
+    otatestJOB_JSON( otatestJOB_FILE( "payload.bin", "1024", "0", "\"compression\": 1,\"imagesize\": 90860," ) "," \
+                     otatestJOB_FILE( "payload2.bin", "1024", "1", "\"compression\": 1,\"imagesize\": 90860," ) )
+
+/**
+ * @brief Most blocks a file can have, limited by the block bitmap.
+ */
+#define otatestMAX_FILE_BLOCKS    ( OTA_MAX_BLOCK_BITMAP_SIZE * BITS_PER_BYTE )
+
+/**
+ * @brief Event buffer size rounded up the way the pool carves it.
+ */
+#define otatestEVENT_BUFFER_SIZE( x )    ( ( ( x ) + 3U ) & ~3U )
+
+/**
+ * @brief Number of event buffers the pool holds at a buffer size.
+ */
+#define otatestEVENT_BUFFER_COUNT( x )                                                                 \
+    ( ( ( OTA_EVENT_BUFFER_POOL_SIZE / otatestEVENT_BUFFER_SIZE( x ) ) > otaconfigMAX_NUM_OTA_DATA_BUFFERS ) ? \
+      otaconfigMAX_NUM_OTA_DATA_BUFFERS : ( OTA_EVENT_BUFFER_POOL_SIZE / otatestEVENT_BUFFER_SIZE( x ) ) )
+
 /**
  * @brief Shared MQTT client handle, used across setup, tests, and teardown.
  * But only used by one test at a time. */
@@ -160,6 +206,26 @@ static OTA_State_t prvOTAAgentInit()
     return eOtaStatus;
 }
 
+/**
+ * @brief Block size callback that asks for the smallest blocks.
+ */
+static uint32_t prvSelectSmallestBlockSize( const OTA_FileContext_t * C )
+{
+    ( void ) C;
+
+    return OTA_MIN_FILE_BLOCK_SIZE;
+}
+
+/**
+ * @brief Block size callback that asks for a block size that is not a power of 2.
+ */
+static uint32_t prvSelectOddBlockSize( const OTA_FileContext_t * C )
+{
+    ( void ) C;
+
+    return OTA_MIN_FILE_BLOCK_SIZE + 44U;
+}
+
 /**
  * @brief Test group definition.
  */
@@ -235,6 +301,28 @@ TEST_GROUP_RUNNER( Full_OTA_AGENT )
     RUN_TEST_CASE( Full_OTA_AGENT, OTA_GetStatistics_BeforeInit );
     RUN_TEST_CASE( Full_OTA_AGENT, prvParseJobDocFromJSONandPrvOTA_Close );
     RUN_TEST_CASE( Full_OTA_AGENT, prvParseJSONbyModel_Errors );
+    RUN_TEST_CASE( Full_OTA_AGENT, prvParseJobDoc_MultiFile );
+    RUN_TEST_CASE( Full_OTA_AGENT, prvParseJobDoc_TwoCompressedFiles );
+    RUN_TEST_CASE( Full_OTA_AGENT, prvGetFileForBlock_LateBlock );
+    RUN_TEST_CASE( Full_OTA_AGENT, prvSelectBlockSize_Preference );
+    RUN_TEST_CASE( Full_OTA_AGENT, prvSelectBlockSize_BitmapLimit );
+    RUN_TEST_CASE( Full_OTA_AGENT, prvOTAEventBufferGet_Exhaustion );
+    RUN_TEST_CASE( Full_OTA_AGENT, prvOTAEventBufferGet_TagWrap );
+    RUN_TEST_CASE( Full_OTA_AGENT, prvOTAEventBufferGet_StaleHead );
+    RUN_TEST_CASE( Full_OTA_AGENT, prvOTAEventBufferGet_ResizeWhileInUse );
+    RUN_TEST_CASE( Full_OTA_AGENT, prvRequestWindowRestart_Shrink );
+
+    /* Windowed block requests are only built when a window size is configured. */
+    #if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U )
+        RUN_TEST_CASE( Full_OTA_AGENT, prvSelectWindowBlocks_MissingBlocks );
+        RUN_TEST_CASE( Full_OTA_AGENT, prvRequestWindowBlockReceived_GrowAndDrop );
+    #endif
+
+    /* The streaming hash is only built when it is enabled. */
+    #if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+        RUN_TEST_CASE( Full_OTA_AGENT, prvStreamingHashBlock_Frontier );
+        RUN_TEST_CASE( Full_OTA_AGENT, prvStreamingHashStart_Fallback );
+    #endif
 }
 
 TEST( Full_OTA_AGENT, OTA_SetImageState_AbortBeforeInit )
@@ -494,3 +582,498 @@ TEST( Full_OTA_AGENT, prvParseJSONbyModel_Errors )
     /* Shut down the OTA Agent. */
     ( void ) OTA_AgentShutdown( otatestSHUTDOWN_WAIT );
 }
+
+TEST( Full_OTA_AGENT, prvParseJobDoc_MultiFile )
+{
+    OTA_FileContext_t * pxUpdateFile = NULL;
+    OTA_FileContext_t * pxSecondFile = NULL;
+    bool_t bUpdateJob = false;
+
+    /* Initialize the OTA Agent for the following tests. */
+    TEST_ASSERT_EQUAL( eOTA_AgentState_WaitingForJob, prvOTAAgentInit() );
+
+    /* The OTA Agent must be shut down if these tests fail, so a TEST_PROTECT is necessary. */
+    if( TEST_PROTECT() )
+    {
+        pxUpdateFile = TEST_OTA_prvParseJobDoc( otatestTWO_FILES_JSON, sizeof( otatestTWO_FILES_JSON ), &bUpdateJob );
+
+        #if ( OTA_MAX_FILES > 1U )
+            /* The first file of the job is the current file. */
+            TEST_ASSERT_TRUE( pxUpdateFile != NULL );
+            TEST_ASSERT_EQUAL_STRING( otatestFILE_PATH, pxUpdateFile->pucFilePath );
+            TEST_ASSERT_EQUAL( otatestFILE_SIZE, pxUpdateFile->ulFileSize );
+            TEST_ASSERT_EQUAL_PTR( pxUpdateFile, TEST_OTA_prvGetJobFile( otatestFILE_ID ) );
+
+            /* The second file is parsed into its own context on the same stream. */
+            pxSecondFile = TEST_OTA_prvGetJobFile( otatestSECOND_FILE_ID );
+            TEST_ASSERT_TRUE( pxSecondFile != NULL );
+            TEST_ASSERT_TRUE( pxSecondFile != pxUpdateFile );
+            TEST_ASSERT_EQUAL_STRING( otatestSECOND_FILE_PATH, pxSecondFile->pucFilePath );
+            TEST_ASSERT_EQUAL( otatestSECOND_FILE_SIZE, pxSecondFile->ulFileSize );
+            TEST_ASSERT_EQUAL_STRING( otatestSTREAM_NAME, pxSecondFile->pucStreamName );
+            TEST_ASSERT_EQUAL_STRING( otatestCERT_FILE, pxSecondFile->pucCertFilepath );
+            TEST_ASSERT_EQUAL( sizeof( ucOtatestSIGNATURE ), pxSecondFile->pxSignature->usSize );
+            TEST_ASSERT_EQUAL_MEMORY( ucOtatestSIGNATURE,
+                                      pxSecondFile->pxSignature->ucData,
+                                      sizeof( ucOtatestSIGNATURE ) );
+
+            /* The job name is kept once for the whole job. */
+            TEST_ASSERT_TRUE( pxSecondFile->pucJobName == NULL );
+        #else
+            /* A job with more files than otaconfigMAX_CONCURRENT_FILES is rejected as a whole. */
+            TEST_ASSERT_TRUE( pxUpdateFile == NULL );
+        #endif
+    }
+
+    if( pxUpdateFile != NULL )
+    {
+        /* Closing the job closes every file of it. */
+        TEST_OTA_prvCloseJobFiles();
+        pxUpdateFile = NULL;
+    }
+
+    if( TEST_PROTECT() )
+    {
+        TEST_ASSERT_TRUE( TEST_OTA_prvGetJobFile( otatestFILE_ID ) == NULL );
+        TEST_ASSERT_TRUE( TEST_OTA_prvGetJobFile( otatestSECOND_FILE_ID ) == NULL );
+    }
+
+    /* Shut down the OTA Agent. */
+    ( void ) OTA_AgentShutdown( otatestSHUTDOWN_WAIT );
+}
+
+TEST( Full_OTA_AGENT, prvParseJobDoc_TwoCompressedFiles )
+{
+    OTA_FileContext_t * pxUpdateFile = NULL;
+    bool_t bUpdateJob = false;
+
+    /* Initialize the OTA Agent for the following tests. */
+    TEST_ASSERT_EQUAL( eOTA_AgentState_WaitingForJob, prvOTAAgentInit() );
+
+    /* The OTA Agent must be shut down if these tests fail, so a TEST_PROTECT is necessary. */
+    if( TEST_PROTECT() )
+    {
+        /* The job is rejected and none of its files are left open. */
+        pxUpdateFile = TEST_OTA_prvParseJobDoc( otatestTWO_COMPRESSED_FILES_JSON, sizeof( otatestTWO_COMPRESSED_FILES_JSON ), &bUpdateJob );
+        TEST_ASSERT_TRUE( pxUpdateFile == NULL );
+        TEST_ASSERT_TRUE( TEST_OTA_prvGetJobFile( otatestFILE_ID ) == NULL );
+        TEST_ASSERT_TRUE( TEST_OTA_prvGetJobFile( otatestSECOND_FILE_ID ) == NULL );
+    }
+
+    if( pxUpdateFile != NULL )
+    {
+        TEST_OTA_prvCloseJobFiles();
+        pxUpdateFile = NULL;
+    }
+
+    /* Shut down the OTA Agent. */
+    ( void ) OTA_AgentShutdown( otatestSHUTDOWN_WAIT );
+}
+
+TEST( Full_OTA_AGENT, prvGetFileForBlock_LateBlock )
+{
+    OTA_FileContext_t * pxFile = NULL;
+    OTA_EventData_t xEventData = { 0 };
+
+    pxFile = TEST_OTA_prvGetFreeContext();
+    TEST_ASSERT_TRUE( pxFile != NULL );
+
+    if( TEST_PROTECT() )
+    {
+        pxFile->pucFilePath = pvPortMalloc( sizeof( otatestFILE_PATH ) );
+        TEST_ASSERT_TRUE( pxFile->pucFilePath != NULL );
+        memcpy( pxFile->pucFilePath, otatestFILE_PATH, sizeof( otatestFILE_PATH ) );
+
+        pxFile->pucRxBlockBitmap = pvPortMalloc( 1U );
+        TEST_ASSERT_TRUE( pxFile->pucRxBlockBitmap != NULL );
+
+        /* A single-file job routes every block to its file without decoding it. */
+        pxFile->ulBlocksRemaining = 1U;
+        TEST_ASSERT_EQUAL_PTR( pxFile, TEST_OTA_prvGetFileForBlock( &xEventData ) );
+
+        /* Once the file is received a late copy of one of its blocks is dropped. */
+        pxFile->ulBlocksRemaining = 0U;
+        vPortFree( pxFile->pucRxBlockBitmap );
+        pxFile->pucRxBlockBitmap = NULL;
+        TEST_ASSERT_TRUE( TEST_OTA_prvGetFileForBlock( &xEventData ) == NULL );
+    }
+
+    vPortFree( pxFile->pucRxBlockBitmap );
+    vPortFree( pxFile->pucFilePath );
+    memset( pxFile, 0, sizeof( OTA_FileContext_t ) );
+}
+
+TEST( Full_OTA_AGENT, prvSelectBlockSize_Preference )
+{
+    OTA_FileContext_t xFile = { 0 };
+    uint32_t ulMaxBlockSize;
+
+    xFile.ulFileSize = otatestFILE_SIZE;
+
+    /* Without a preference the largest block size the configuration allows is used. */
+    ulMaxBlockSize = TEST_OTA_prvSelectBlockSize( &xFile, NULL );
+    TEST_ASSERT_TRUE( ulMaxBlockSize >= OTA_MIN_FILE_BLOCK_SIZE );
+    TEST_ASSERT_TRUE( ulMaxBlockSize <= OTA_FILE_BLOCK_SIZE );
+    TEST_ASSERT_EQUAL( 0, ulMaxBlockSize & ( ulMaxBlockSize - 1U ) );
+    TEST_ASSERT_TRUE( ( ulMaxBlockSize == OTA_MIN_FILE_BLOCK_SIZE ) ||
+                      ( ( ulMaxBlockSize + OTA_DATA_BLOCK_OVERHEAD ) <= OTA_EVENT_BUFFER_POOL_SIZE ) );
+
+    /* The preference is honored and rounded down to a power of 2. */
+    TEST_ASSERT_EQUAL( OTA_MIN_FILE_BLOCK_SIZE, TEST_OTA_prvSelectBlockSize( &xFile, prvSelectSmallestBlockSize ) );
+    TEST_ASSERT_EQUAL( OTA_MIN_FILE_BLOCK_SIZE, TEST_OTA_prvSelectBlockSize( &xFile, prvSelectOddBlockSize ) );
+}
+
+TEST( Full_OTA_AGENT, prvSelectBlockSize_BitmapLimit )
+{
+    OTA_FileContext_t xFile = { 0 };
+    uint32_t ulMaxBlockSize;
+
+    xFile.ulFileSize = otatestFILE_SIZE;
+    ulMaxBlockSize = TEST_OTA_prvSelectBlockSize( &xFile, NULL );
+
+    /* A file that needs every bit of the bitmap keeps the preferred block size. */
+    xFile.ulFileSize = otatestMAX_FILE_BLOCKS * OTA_MIN_FILE_BLOCK_SIZE;
+    TEST_ASSERT_EQUAL( OTA_MIN_FILE_BLOCK_SIZE, TEST_OTA_prvSelectBlockSize( &xFile, prvSelectSmallestBlockSize ) );
+
+    /* One byte more and the block size is raised so the bitmap still covers the file. */
+    xFile.ulFileSize++;
+
+    if( ulMaxBlockSize > OTA_MIN_FILE_BLOCK_SIZE )
+    {
+        TEST_ASSERT_EQUAL( 2U * OTA_MIN_FILE_BLOCK_SIZE, TEST_OTA_prvSelectBlockSize( &xFile, prvSelectSmallestBlockSize ) );
+    }
+    else
+    {
+        TEST_ASSERT_EQUAL( 0, TEST_OTA_prvSelectBlockSize( &xFile, prvSelectSmallestBlockSize ) );
+    }
+
+    /* The largest file the bitmap can track at the largest block size is accepted. */
+    xFile.ulFileSize = otatestMAX_FILE_BLOCKS * ulMaxBlockSize;
+    TEST_ASSERT_EQUAL( ulMaxBlockSize, TEST_OTA_prvSelectBlockSize( &xFile, prvSelectSmallestBlockSize ) );
+    TEST_ASSERT_EQUAL( ulMaxBlockSize, TEST_OTA_prvSelectBlockSize( &xFile, NULL ) );
+
+    /* Anything larger is rejected up front. */
+    xFile.ulFileSize++;
+    TEST_ASSERT_EQUAL( 0, TEST_OTA_prvSelectBlockSize( &xFile, prvSelectSmallestBlockSize ) );
+    TEST_ASSERT_EQUAL( 0, TEST_OTA_prvSelectBlockSize( &xFile, NULL ) );
+}
+
+TEST( Full_OTA_AGENT, prvOTAEventBufferGet_Exhaustion )
+{
+    OTA_EventData_t * pxBuffers[ otaconfigMAX_NUM_OTA_DATA_BUFFERS + 1U ] = { 0 };
+    uint32_t ulCount = otatestEVENT_BUFFER_COUNT( OTA_MIN_EVENT_BUFFER_SIZE );
+    uint32_t ulIndex;
+
+    TEST_OTA_prvEventBufferInit( OTA_MIN_EVENT_BUFFER_SIZE );
+
+    /* The buffers come out in pool order, each its own part of the pool. */
+    for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+    {
+        pxBuffers[ ulIndex ] = prvOTAEventBufferGet();
+        TEST_ASSERT_NOT_NULL( pxBuffers[ ulIndex ] );
+        TEST_ASSERT_TRUE( pxBuffers[ ulIndex ]->bBufferUsed );
+        TEST_ASSERT_EQUAL( otatestEVENT_BUFFER_SIZE( OTA_MIN_EVENT_BUFFER_SIZE ), pxBuffers[ ulIndex ]->ulBufferSize );
+        TEST_ASSERT_TRUE( pxBuffers[ ulIndex ]->pucData == pxBuffers[ ulIndex ]->pucBuffer );
+
+        if( ulIndex > 0U )
+        {
+            TEST_ASSERT_TRUE( pxBuffers[ ulIndex ]->pucBuffer ==
+                              pxBuffers[ ulIndex - 1U ]->pucBuffer + pxBuffers[ ulIndex - 1U ]->ulBufferSize );
+        }
+    }
+
+    /* An exhausted pool returns NULL and stays usable. */
+    TEST_ASSERT_NULL( prvOTAEventBufferGet() );
+    TEST_ASSERT_NULL( prvOTAEventBufferGet() );
+
+    /* The last buffer freed is the first taken again. */
+    prvOTAEventBufferFree( pxBuffers[ 0 ] );
+    TEST_ASSERT_TRUE( prvOTAEventBufferGet() == pxBuffers[ 0 ] );
+    TEST_ASSERT_NULL( prvOTAEventBufferGet() );
+
+    for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+    {
+        prvOTAEventBufferFree( pxBuffers[ ulIndex ] );
+        TEST_ASSERT_FALSE( pxBuffers[ ulIndex ]->bBufferUsed );
+    }
+}
+
+TEST( Full_OTA_AGENT, prvOTAEventBufferGet_TagWrap )
+{
+    OTA_EventData_t * pxBuffer = NULL;
+    uint32_t ulCount = otatestEVENT_BUFFER_COUNT( OTA_MIN_EVENT_BUFFER_SIZE );
+    uint32_t ulHead;
+    uint32_t ulIndex;
+
+    TEST_OTA_prvEventBufferInit( OTA_MIN_EVENT_BUFFER_SIZE );
+
+    /* Put the tag at its largest value so the next update wraps it. */
+    TEST_OTA_prvEventBufferSetTag( 0xFFFFU );
+    ulHead = TEST_OTA_ulEventBufferFreeHead();
+
+    pxBuffer = prvOTAEventBufferGet();
+    TEST_ASSERT_NOT_NULL( pxBuffer );
+    TEST_ASSERT_EQUAL( 0U, TEST_OTA_ulEventBufferFreeHead() >> 16 );
+
+    /* The wrap must not disturb the list, so the same link is back on top. */
+    prvOTAEventBufferFree( pxBuffer );
+    TEST_ASSERT_EQUAL( ulHead & 0xFFFFU, TEST_OTA_ulEventBufferFreeHead() & 0xFFFFU );
+    TEST_ASSERT_EQUAL( 1U, TEST_OTA_ulEventBufferFreeHead() >> 16 );
+
+    for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+    {
+        TEST_ASSERT_NOT_NULL( prvOTAEventBufferGet() );
+    }
+
+    TEST_ASSERT_NULL( prvOTAEventBufferGet() );
+    TEST_OTA_prvEventBufferInit( OTA_MIN_EVENT_BUFFER_SIZE );
+}
+
+TEST( Full_OTA_AGENT, prvOTAEventBufferGet_StaleHead )
+{
+    OTA_EventData_t * pxFirst = NULL;
+    OTA_EventData_t * pxSecond = NULL;
+    uint32_t ulHead;
+
+    TEST_OTA_prvEventBufferInit( OTA_MIN_EVENT_BUFFER_SIZE );
+
+    /* A task preempted after reading the head would see the same first buffer after
+     * these updates, but a different tag, so its compare and swap fails. */
+    ulHead = TEST_OTA_ulEventBufferFreeHead();
+    pxFirst = prvOTAEventBufferGet();
+    pxSecond = prvOTAEventBufferGet();
+    TEST_ASSERT_NOT_NULL( pxFirst );
+    TEST_ASSERT_NOT_NULL( pxSecond );
+    prvOTAEventBufferFree( pxSecond );
+    prvOTAEventBufferFree( pxFirst );
+
+    TEST_ASSERT_EQUAL( ulHead & 0xFFFFU, TEST_OTA_ulEventBufferFreeHead() & 0xFFFFU );
+    TEST_ASSERT_NOT_EQUAL( ulHead, TEST_OTA_ulEventBufferFreeHead() );
+
+    /* The list still links the second buffer after the first. */
+    TEST_ASSERT_TRUE( prvOTAEventBufferGet() == pxFirst );
+    TEST_ASSERT_TRUE( prvOTAEventBufferGet() == pxSecond );
+    prvOTAEventBufferFree( pxSecond );
+    prvOTAEventBufferFree( pxFirst );
+}
+
+TEST( Full_OTA_AGENT, prvOTAEventBufferGet_ResizeWhileInUse )
+{
+    OTA_EventData_t * pxHeld = NULL;
+    OTA_EventData_t * pxBuffer = NULL;
+    uint32_t ulNewSize = OTA_EVENT_BUFFER_POOL_SIZE / 2U;
+    uint32_t ulIndex;
+
+    TEST_OTA_prvEventBufferInit( OTA_MIN_EVENT_BUFFER_SIZE );
+
+    /* While a buffer is held the pool can't be carved, but buffers of the old size
+     * can still be taken. */
+    pxHeld = prvOTAEventBufferGet();
+    TEST_ASSERT_NOT_NULL( pxHeld );
+    TEST_OTA_prvEventBufferResize( ulNewSize );
+
+    pxBuffer = prvOTAEventBufferGet();
+    TEST_ASSERT_NOT_NULL( pxBuffer );
+    TEST_ASSERT_EQUAL( otatestEVENT_BUFFER_SIZE( OTA_MIN_EVENT_BUFFER_SIZE ), pxBuffer->ulBufferSize );
+    prvOTAEventBufferFree( pxBuffer );
+
+    /* Freeing the last buffer carves the pool for the new size. */
+    prvOTAEventBufferFree( pxHeld );
+
+    for( ulIndex = 0; ulIndex < otatestEVENT_BUFFER_COUNT( ulNewSize ); ulIndex++ )
+    {
+        pxBuffer = prvOTAEventBufferGet();
+        TEST_ASSERT_NOT_NULL( pxBuffer );
+        TEST_ASSERT_EQUAL( otatestEVENT_BUFFER_SIZE( ulNewSize ), pxBuffer->ulBufferSize );
+    }
+
+    TEST_ASSERT_NULL( prvOTAEventBufferGet() );
+    TEST_OTA_prvEventBufferInit( OTA_MIN_EVENT_BUFFER_SIZE );
+}
+
+TEST( Full_OTA_AGENT, prvRequestWindowRestart_Shrink )
+{
+    OTA_FileRequest_t xRequest = { 0 };
+    OTA_RequestWindow_t * pxWindow = &xRequest.xRequestWindow;
+
+    /* Blocks still in flight at a timeout were lost, so the window is halved and
+     * the missing blocks are requested again from the start of the file. */
+    pxWindow->ulSize = 4;
+    pxWindow->ulInFlight = 3;
+    pxWindow->ulNextBlock = 10;
+    pxWindow->ulReceived = 2;
+    pxWindow->bAwaitingFirstBlock = true;
+    TEST_OTA_prvRequestWindowRestart( &xRequest );
+    TEST_ASSERT_EQUAL( 2, pxWindow->ulSize );
+    TEST_ASSERT_EQUAL( 0, pxWindow->ulInFlight );
+    TEST_ASSERT_EQUAL( 0, pxWindow->ulNextBlock );
+    TEST_ASSERT_EQUAL( 0, pxWindow->ulReceived );
+    TEST_ASSERT_FALSE( pxWindow->bAwaitingFirstBlock );
+
+    /* Nothing was lost, so the window keeps its size. */
+    TEST_OTA_prvRequestWindowRestart( &xRequest );
+    TEST_ASSERT_EQUAL( 2, pxWindow->ulSize );
+
+    /* The window never closes. */
+    pxWindow->ulSize = 1;
+    pxWindow->ulInFlight = 1;
+    TEST_OTA_prvRequestWindowRestart( &xRequest );
+    TEST_ASSERT_EQUAL( 1, pxWindow->ulSize );
+}
+
+#if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U )
+
+    TEST( Full_OTA_AGENT, prvSelectWindowBlocks_MissingBlocks )
+    {
+        OTA_FileContext_t xFile = { 0 };
+        uint8_t ucRxBitmap[ 3 ] = { 0xFF, 0xFF, 0x0F };
+        uint8_t ucRequestBitmap[ 3 ] = { 0 };
+        uint32_t ulNextBlock = 0;
+
+        /* A set bit in the receive bitmap marks a missing block. Blocks 3 and 4 are received. */
+        ucRxBitmap[ 0 ] &= ( uint8_t ) ~0x18U;
+        xFile.pucRxBlockBitmap = ucRxBitmap;
+
+        TEST_ASSERT_EQUAL( 4, TEST_OTA_prvSelectWindowBlocks( &xFile, 20, 2, 4, ucRequestBitmap, &ulNextBlock ) );
+        TEST_ASSERT_EQUAL_HEX8( 0xE4, ucRequestBitmap[ 0 ] );
+        TEST_ASSERT_EQUAL_HEX8( 0x00, ucRequestBitmap[ 1 ] );
+        TEST_ASSERT_EQUAL( 8, ulNextBlock );
+
+        /* Selection stops at the last block of the file. */
+        ( void ) memset( ucRequestBitmap, 0, sizeof( ucRequestBitmap ) );
+        TEST_ASSERT_EQUAL( 2, TEST_OTA_prvSelectWindowBlocks( &xFile, 20, 18, 4, ucRequestBitmap, &ulNextBlock ) );
+        TEST_ASSERT_EQUAL_HEX8( 0x0C, ucRequestBitmap[ 2 ] );
+        TEST_ASSERT_EQUAL( 20, ulNextBlock );
+
+        /* Nothing is left to select past the end. */
+        ( void ) memset( ucRequestBitmap, 0, sizeof( ucRequestBitmap ) );
+        TEST_ASSERT_EQUAL( 0, TEST_OTA_prvSelectWindowBlocks( &xFile, 20, 20, 4, ucRequestBitmap, &ulNextBlock ) );
+        TEST_ASSERT_EQUAL( 20, ulNextBlock );
+    }
+
+    TEST( Full_OTA_AGENT, prvRequestWindowBlockReceived_GrowAndDrop )
+    {
+        OTA_FileRequest_t xRequest = { 0 };
+        OTA_RequestWindow_t * pxWindow = &xRequest.xRequestWindow;
+
+        /* A long round trip keeps the pipe limit out of the way. */
+        pxWindow->ulSize = 1;
+        pxWindow->ulInFlight = 3;
+        pxWindow->ulDropped = OTA_GetPacketsDropped();
+        pxWindow->xRoundTrip = pdMS_TO_TICKS( 100000 );
+        pxWindow->xBlockTime = xTaskGetTickCount();
+
+        /* A full window received grows the window by one block. */
+        TEST_ASSERT_FALSE( TEST_OTA_prvRequestWindowBlockReceived( &xRequest ) );
+        TEST_ASSERT_EQUAL( 2, pxWindow->ulInFlight );
+        TEST_ASSERT_EQUAL( 2, pxWindow->ulSize );
+        TEST_ASSERT_EQUAL( 0, pxWindow->ulReceived );
+
+        /* Another request is due once half of the window has drained. */
+        TEST_ASSERT_TRUE( TEST_OTA_prvRequestWindowBlockReceived( &xRequest ) );
+        TEST_ASSERT_EQUAL( 1, pxWindow->ulInFlight );
+        TEST_ASSERT_EQUAL( 1, pxWindow->ulReceived );
+
+        /* The window doesn't grow past the configured size. */
+        pxWindow->ulSize = OTA_REQUEST_WINDOW_MAX_BLOCKS;
+        pxWindow->ulReceived = OTA_REQUEST_WINDOW_MAX_BLOCKS;
+        ( void ) TEST_OTA_prvRequestWindowBlockReceived( &xRequest );
+        TEST_ASSERT_EQUAL( OTA_REQUEST_WINDOW_MAX_BLOCKS, pxWindow->ulSize );
+
+        /* Nor past the file's share of the event buffers. */
+        xRequest.ulBlockShare = 1;
+        pxWindow->ulSize = 1;
+        pxWindow->ulReceived = 1;
+        ( void ) TEST_OTA_prvRequestWindowBlockReceived( &xRequest );
+        TEST_ASSERT_EQUAL( 1, pxWindow->ulSize );
+
+        /* A packet dropped since the last block halves the window. */
+        xRequest.ulBlockShare = 0;
+        pxWindow->ulSize = 4;
+        pxWindow->ulReceived = 3;
+        pxWindow->ulDropped = OTA_GetPacketsDropped() - 1U;
+        ( void ) TEST_OTA_prvRequestWindowBlockReceived( &xRequest );
+        TEST_ASSERT_EQUAL( 2, pxWindow->ulSize );
+        TEST_ASSERT_EQUAL( 0, pxWindow->ulReceived );
+        TEST_ASSERT_EQUAL( OTA_GetPacketsDropped(), pxWindow->ulDropped );
+    }
+
+#endif /* if ( OTA_REQUEST_WINDOW_MAX_BLOCKS > 0U ) */
+
+#if ( OTA_STREAMING_SIGNATURE_CHECK != 0U )
+
+    TEST( Full_OTA_AGENT, prvStreamingHashBlock_Frontier )
+    {
+        OTA_FileContext_t xFile = { 0 };
+        const OTA_StreamingHash_t * pxHash = TEST_OTA_pxStreamingHash();
+        static uint8_t ucBlock[ OTA_MIN_FILE_BLOCK_SIZE ];
+        uint32_t ulFar = OTA_STREAMING_HASH_FRONTIER_BLOCKS + 1U;
+
+        xFile.ulBlockSize = OTA_MIN_FILE_BLOCK_SIZE;
+        xFile.ulFileSize = ( ulFar + 2U ) * OTA_MIN_FILE_BLOCK_SIZE;
+
+        TEST_OTA_prvStreamingHashStart( &xFile );
+        TEST_ASSERT_NOT_NULL( xFile.pvSigVerifyContext );
+        TEST_ASSERT_TRUE( pxHash->pxFile == &xFile );
+        TEST_ASSERT_NOT_NULL( pxHash->pucFrontier );
+
+        if( TEST_PROTECT() )
+        {
+            /* A block ahead of the hash is held in the frontier. */
+            TEST_OTA_prvStreamingHashBlock( &xFile, 1, ucBlock, sizeof( ucBlock ) );
+            TEST_ASSERT_EQUAL( 0, pxHash->ulNextBlock );
+            TEST_ASSERT_EQUAL_HEX32( 1UL << ( 1U % OTA_STREAMING_HASH_FRONTIER_BLOCKS ), pxHash->ulFrontierMask );
+
+            /* A block beyond the frontier is deferred rather than abandoning the hash. */
+            TEST_ASSERT_FALSE( TEST_OTA_prvStreamingHashDefers( &xFile, ulFar - 1U ) );
+            TEST_ASSERT_TRUE( TEST_OTA_prvStreamingHashDefers( &xFile, ulFar ) );
+
+            /* The missing block drains the frontier. */
+            TEST_OTA_prvStreamingHashBlock( &xFile, 0, ucBlock, sizeof( ucBlock ) );
+            TEST_ASSERT_EQUAL( 2, pxHash->ulNextBlock );
+            TEST_ASSERT_EQUAL( 0, pxHash->ulFrontierMask );
+            TEST_ASSERT_NOT_NULL( xFile.pvSigVerifyContext );
+
+            /* The frontier moved with the hash, so the deferred block now fits. */
+            TEST_ASSERT_FALSE( TEST_OTA_prvStreamingHashDefers( &xFile, ulFar ) );
+        }
+
+        TEST_OTA_prvStreamingHashRelease( &xFile, true );
+        TEST_ASSERT_NULL( xFile.pvSigVerifyContext );
+        TEST_ASSERT_NULL( pxHash->pxFile );
+    }
+
+    TEST( Full_OTA_AGENT, prvStreamingHashStart_Fallback )
+    {
+        OTA_FileContext_t xFirst = { 0 };
+        OTA_FileContext_t xSecond = { 0 };
+        const OTA_StreamingHash_t * pxHash = TEST_OTA_pxStreamingHash();
+
+        xFirst.ulBlockSize = OTA_MIN_FILE_BLOCK_SIZE;
+        xFirst.ulFileSize = 8U * OTA_MIN_FILE_BLOCK_SIZE;
+        xSecond = xFirst;
+
+        TEST_OTA_prvStreamingHashStart( &xFirst );
+        TEST_ASSERT_NOT_NULL( xFirst.pvSigVerifyContext );
+
+        if( TEST_PROTECT() )
+        {
+            /* Only one file is hashed at a time. The PAL hashes the other one at close,
+             * so its blocks are never deferred. */
+            TEST_OTA_prvStreamingHashStart( &xSecond );
+            TEST_ASSERT_NULL( xSecond.pvSigVerifyContext );
+            TEST_ASSERT_TRUE( pxHash->pxFile == &xFirst );
+            TEST_ASSERT_FALSE( TEST_OTA_prvStreamingHashDefers( &xSecond, 7 ) );
+
+            /* Finishing the first file leaves its context for the PAL to check the signature. */
+            TEST_OTA_prvStreamingHashRelease( &xFirst, false );
+            TEST_ASSERT_NULL( pxHash->pxFile );
+            TEST_ASSERT_NOT_NULL( xFirst.pvSigVerifyContext );
+            TEST_ASSERT_FALSE( TEST_OTA_prvStreamingHashDefers( &xFirst, 7 ) );
+        }
+
+        TEST_OTA_prvStreamingHashRelease( &xFirst, true );
+        TEST_ASSERT_NULL( xFirst.pvSigVerifyContext );
+    }
+
+#endif /* if ( OTA_STREAMING_SIGNATURE_CHECK != 0U ) */
@@ -226,6 +226,11 @@ TEST_GROUP_RUNNER( Full_OTA_CBOR )
 {
     RUN_TEST_CASE( Full_OTA_CBOR, CborOtaApi );
     RUN_TEST_CASE( Full_OTA_CBOR, CborOtaAgentIngestStreamResponse );
+    RUN_TEST_CASE( Full_OTA_CBOR, CborOtaFullBitmapRequest );
+
+    #if ( OTA_MAX_FILES > 1U )
+        RUN_TEST_CASE( Full_OTA_CBOR, CborOtaAgentIngestMultiFile );
+    #endif
 }
 
 TEST_GROUP_RUNNER( Quarantine_OTA_CBOR )
@@ -244,6 +249,30 @@ TEST_GROUP_RUNNER( Quarantine_OTA_CBOR )
 #define CBOR_TEST_BLOCKIDENTITY_VALUE                     0
 #define CBOR_TEST_STREAMFILES_COUNT                       3
 #define CBOR_TEST_STREAMFILE_FIELD_COUNT                  2
+#define CBOR_TEST_CERTFILE_VALUE                          "rsasigner.crt"
+
+/**
+ * @brief Signature of payload.bin made with the key of CBOR_TEST_CERTFILE_VALUE.
+ */
+static const uint8_t ucCborTestSIGNATURE[] =
+{
+    0x38, 0x78, 0xf9, 0xb0, 0xd8, 0xf1, 0xa8, 0xc3, 0x4a, 0xdd, 0x63, 0x44, 0xc1, 0xbc, 0x9f, 0xb3,
+    0xf3, 0xde, 0x49, 0x24, 0xb5, 0x93, 0x32, 0xe4, 0x01, 0x0e, 0x0c, 0x4a, 0xed, 0x32, 0x28, 0xd1,
+    0x68, 0x1b, 0x12, 0x6b, 0x50, 0xab, 0x88, 0x5a, 0x18, 0xd0, 0x6d, 0x08, 0x8f, 0x95, 0x77, 0x03,
+    0xb5, 0x79, 0x52, 0x5c, 0x4f, 0x32, 0x74, 0x0c, 0x28, 0xc6, 0x79, 0xf0, 0xe6, 0x57, 0x30, 0xa4,
+    0x9b, 0x1b, 0x5f, 0x10, 0xf5, 0x2b, 0x53, 0xf0, 0x64, 0x9a, 0x1c, 0xff, 0x79, 0xaf, 0xe5, 0x71,
+    0xd7, 0x6e, 0xfb, 0xc4, 0xa0, 0x5a, 0xf8, 0xc8, 0x0d, 0x2b, 0x85, 0x8e, 0x2d, 0xca, 0xb3, 0x03,
+    0x05, 0xeb, 0x04, 0xb4, 0xe5, 0x6b, 0x5b, 0x4c, 0x88, 0xe2, 0x63, 0x38, 0x2d, 0xd7, 0xb9, 0x3a,
+    0xd7, 0x48, 0xc6, 0x8f, 0x2c, 0x8d, 0x34, 0x8f, 0x19, 0x7a, 0x36, 0x12, 0x3b, 0xa1, 0x9f, 0xe2,
+    0xc3, 0x44, 0x3d, 0xe0, 0x29, 0xd6, 0xf5, 0x82, 0xd3, 0xe9, 0xa0, 0x9f, 0xd8, 0x05, 0x09, 0x98,
+    0x29, 0x71, 0xc5, 0x43, 0x94, 0x16, 0xe7, 0xc1, 0x8e, 0x4a, 0x50, 0x7d, 0xa6, 0xba, 0xb9, 0xbf,
+    0xe3, 0x25, 0xa1, 0x50, 0x80, 0x4e, 0x39, 0xb3, 0x6f, 0xdb, 0x6e, 0xe2, 0x6b, 0x12, 0x71, 0x76,
+    0x18, 0xcb, 0x8d, 0x62, 0x90, 0x48, 0x4a, 0xd9, 0xec, 0x9f, 0x97, 0xbf, 0xef, 0xa5, 0xcd, 0xaf,
+    0x30, 0xd5, 0xfa, 0xba, 0x1c, 0xb2, 0x79, 0x98, 0x64, 0xbb, 0xd9, 0xda, 0x98, 0x8e, 0x0e, 0x66,
+    0x6b, 0x29, 0xef, 0x6b, 0x4b, 0x2f, 0x80, 0xf8, 0xa4, 0x5b, 0x78, 0xfe, 0x70, 0xd6, 0x61, 0x20,
+    0x28, 0xf2, 0xc4, 0x00, 0xc2, 0x7b, 0x35, 0x44, 0xd6, 0x3e, 0x8f, 0x9d, 0x8a, 0x7e, 0xf8, 0x2f,
+    0x28, 0xa3, 0x77, 0xbb, 0xa1, 0xb7, 0xb2, 0xe1, 0x72, 0x55, 0x0a, 0x31, 0x58, 0x9b, 0xb7, 0x68
+};
 
 /*-----------------------------------------------------------*/
 
@@ -395,6 +424,7 @@ BaseType_t prvCreateSampleDescribeStreamResponseMessage( uint8_t * pucMessageBuf
 
 BaseType_t prvCreateSampleGetStreamResponseMessage( uint8_t * pucMessageBuffer,
                                                     size_t xMessageBufferSize,
+                                                    int lFileId,
                                                     int lBlockIndex,
                                                     uint8_t * pucBlockPayload,
                                                     size_t xBlockPayloadSize,
@@ -426,7 +456,7 @@ BaseType_t prvCreateSampleGetStreamResponseMessage( uint8_t * pucMessageBuffer,
     {
         xCborResult = cbor_encode_int(
             &xCborMapEncoder,
-            CBOR_TEST_FILEIDENTITY_VALUE );
+            lFileId );
     }
 
     /* Encode the block identity. */
@@ -538,6 +568,7 @@ TEST( Full_OTA_CBOR, CborOtaApi )
     xResult = prvCreateSampleGetStreamResponseMessage(
         ucCborWork,
         sizeof( ucCborWork ),
+        CBOR_TEST_FILEIDENTITY_VALUE,
         CBOR_TEST_BLOCKIDENTITY_VALUE,
         ucBlockPayload,
         sizeof( ucBlockPayload ),
@@ -556,11 +587,36 @@ TEST( Full_OTA_CBOR, CborOtaApi )
         &xPayloadSize );
     TEST_ASSERT_TRUE( xResult );
 
-    if( NULL != pucPayload )
-    {
-        vPortFree( pucPayload );
-        pucPayload = NULL;
-    }
+    /* The payload is a view into the message, not a copy. */
+    TEST_ASSERT_EQUAL( sizeof( ucBlockPayload ), xPayloadSize );
+    TEST_ASSERT_TRUE( ( pucPayload > ucCborWork ) && ( pucPayload + xPayloadSize <= ucCborWork + xEncodedSize ) );
+    TEST_ASSERT_EQUAL_UINT8_ARRAY( ucBlockPayload, pucPayload, xPayloadSize );
+}
+
+TEST( Full_OTA_CBOR, CborOtaFullBitmapRequest )
+{
+    BaseType_t xResult = pdFALSE;
+    uint8_t ucCborWork[ OTA_REQUEST_MSG_MAX_SIZE ];
+    uint8_t ucBitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+    size_t xEncodedSize = 0;
+
+    /* A request for every block the bitmap can track must fit the request message buffer. */
+    memset( ucBitmap, 0xff, sizeof( ucBitmap ) );
+
+    xResult = OTA_CBOR_Encode_GetStreamRequestMessage(
+        ucCborWork,
+        sizeof( ucCborWork ),
+        &xEncodedSize,
+        CBOR_TEST_CLIENTTOKEN_VALUE,
+        0x7fffffff,
+        0x7fffffff,
+        0,
+        ucBitmap,
+        sizeof( ucBitmap ),
+        0x7fffffff );
+
+    TEST_ASSERT_TRUE( xResult );
+    TEST_ASSERT_TRUE( xEncodedSize <= sizeof( ucCborWork ) );
 }
 
 TEST( Full_OTA_CBOR, CborOtaAgentIngestStreamResponse )
@@ -574,25 +630,6 @@ TEST( Full_OTA_CBOR, CborOtaAgentIngestStreamResponse )
     Sig256_t xSig = { 0 };
     uint8_t * pucInFile = NULL;
     size_t xBlockBitmapSize = 0;
-    uint8_t ucSignature[] =
-    {
-        0x38, 0x78, 0xf9, 0xb0, 0xd8, 0xf1, 0xa8, 0xc3, 0x4a, 0xdd, 0x63, 0x44, 0xc1, 0xbc, 0x9f, 0xb3,
-        0xf3, 0xde, 0x49, 0x24, 0xb5, 0x93, 0x32, 0xe4, 0x01, 0x0e, 0x0c, 0x4a, 0xed, 0x32, 0x28, 0xd1,
-        0x68, 0x1b, 0x12, 0x6b, 0x50, 0xab, 0x88, 0x5a, 0x18, 0xd0, 0x6d, 0x08, 0x8f, 0x95, 0x77, 0x03,
-        0xb5, 0x79, 0x52, 0x5c, 0x4f, 0x32, 0x74, 0x0c, 0x28, 0xc6, 0x79, 0xf0, 0xe6, 0x57, 0x30, 0xa4,
-        0x9b, 0x1b, 0x5f, 0x10, 0xf5, 0x2b, 0x53, 0xf0, 0x64, 0x9a, 0x1c, 0xff, 0x79, 0xaf, 0xe5, 0x71,
-        0xd7, 0x6e, 0xfb, 0xc4, 0xa0, 0x5a, 0xf8, 0xc8, 0x0d, 0x2b, 0x85, 0x8e, 0x2d, 0xca, 0xb3, 0x03,
-        0x05, 0xeb, 0x04, 0xb4, 0xe5, 0x6b, 0x5b, 0x4c, 0x88, 0xe2, 0x63, 0x38, 0x2d, 0xd7, 0xb9, 0x3a,
-        0xd7, 0x48, 0xc6, 0x8f, 0x2c, 0x8d, 0x34, 0x8f, 0x19, 0x7a, 0x36, 0x12, 0x3b, 0xa1, 0x9f, 0xe2,
-        0xc3, 0x44, 0x3d, 0xe0, 0x29, 0xd6, 0xf5, 0x82, 0xd3, 0xe9, 0xa0, 0x9f, 0xd8, 0x05, 0x09, 0x98,
-        0x29, 0x71, 0xc5, 0x43, 0x94, 0x16, 0xe7, 0xc1, 0x8e, 0x4a, 0x50, 0x7d, 0xa6, 0xba, 0xb9, 0xbf,
-        0xe3, 0x25, 0xa1, 0x50, 0x80, 0x4e, 0x39, 0xb3, 0x6f, 0xdb, 0x6e, 0xe2, 0x6b, 0x12, 0x71, 0x76,
-        0x18, 0xcb, 0x8d, 0x62, 0x90, 0x48, 0x4a, 0xd9, 0xec, 0x9f, 0x97, 0xbf, 0xef, 0xa5, 0xcd, 0xaf,
-        0x30, 0xd5, 0xfa, 0xba, 0x1c, 0xb2, 0x79, 0x98, 0x64, 0xbb, 0xd9, 0xda, 0x98, 0x8e, 0x0e, 0x66,
-        0x6b, 0x29, 0xef, 0x6b, 0x4b, 0x2f, 0x80, 0xf8, 0xa4, 0x5b, 0x78, 0xfe, 0x70, 0xd6, 0x61, 0x20,
-        0x28, 0xf2, 0xc4, 0x00, 0xc2, 0x7b, 0x35, 0x44, 0xd6, 0x3e, 0x8f, 0x9d, 0x8a, 0x7e, 0xf8, 0x2f,
-        0x28, 0xa3, 0x77, 0xbb, 0xa1, 0xb7, 0xb2, 0xe1, 0x72, 0x55, 0x0a, 0x31, 0x58, 0x9b, 0xb7, 0x68
-    };
 
     /* Set OTA data interface to MQTT. */
     TEST_OTA_prvSetDataInterfaceMQTT();
@@ -608,6 +645,7 @@ TEST( Full_OTA_CBOR, CborOtaAgentIngestStreamResponse )
      * order. */
     xOTAFileContext.pxFile = fopen( "testOtaFile.bin", "w+b" );
     TEST_ASSERT_NOT_NULL( xOTAFileContext.pxFile );
+    xOTAFileContext.ulBlockSize = OTA_FILE_BLOCK_SIZE;
     xOTAFileContext.ulBlocksRemaining =
         xOTAFileContext.ulFileSize / OTA_FILE_BLOCK_SIZE;
 
@@ -623,8 +661,8 @@ TEST( Full_OTA_CBOR, CborOtaAgentIngestStreamResponse )
 
     xOTAFileContext.pucCertFilepath = "rsasigner.crt";
     xOTAFileContext.pxSignature = &xSig;
-    memcpy( xOTAFileContext.pxSignature->ucData, ucSignature, sizeof( ucSignature ) );
-    xOTAFileContext.pxSignature->usSize = sizeof( ucSignature );
+    memcpy( xOTAFileContext.pxSignature->ucData, ucCborTestSIGNATURE, sizeof( ucCborTestSIGNATURE ) );
+    xOTAFileContext.pxSignature->usSize = sizeof( ucCborTestSIGNATURE );
 
     /* Process the signed file by chunks. */
     for( size_t xBlock = 0;
@@ -638,6 +676,7 @@ TEST( Full_OTA_CBOR, CborOtaAgentIngestStreamResponse )
         xResultBool = prvCreateSampleGetStreamResponseMessage(
             ucCborWork,
             sizeof( ucCborWork ),
+            CBOR_TEST_FILEIDENTITY_VALUE,
             xBlock,
             pucInFile + ( xBlock * OTA_FILE_BLOCK_SIZE ),
             xChunkSize,
@@ -679,6 +718,162 @@ TEST( Full_OTA_CBOR, CborOtaAgentIngestStreamResponse )
     }
 }
 
+#if ( OTA_MAX_FILES > 1U )
+
+/*-----------------------------------------------------------*/
+
+static OTA_FileContext_t * prvCreateJobFileContext( uint32_t ulServerFileID,
+                                                    const char * pcFilePath,
+                                                    uint32_t ulFileSize,
+                                                    bool bBadSignature )
+{
+    OTA_FileContext_t * C = TEST_OTA_prvGetFreeContext();
+    uint32_t ulBitmapSize = 0;
+
+    TEST_ASSERT_NOT_NULL( C );
+
+    /* The agent frees these when the file is closed, so they are allocated the way the job parser does. */
+    C->pucFilePath = pvPortMalloc( strlen( pcFilePath ) + 1U );
+    TEST_ASSERT_NOT_NULL( C->pucFilePath );
+    strcpy( ( char * ) C->pucFilePath, pcFilePath );
+
+    C->pucCertFilepath = pvPortMalloc( sizeof( CBOR_TEST_CERTFILE_VALUE ) );
+    TEST_ASSERT_NOT_NULL( C->pucCertFilepath );
+    memcpy( C->pucCertFilepath, CBOR_TEST_CERTFILE_VALUE, sizeof( CBOR_TEST_CERTFILE_VALUE ) );
+
+    C->pxSignature = pvPortMalloc( sizeof( Sig256_t ) );
+    TEST_ASSERT_NOT_NULL( C->pxSignature );
+    memcpy( C->pxSignature->ucData, ucCborTestSIGNATURE, sizeof( ucCborTestSIGNATURE ) );
+    C->pxSignature->usSize = sizeof( ucCborTestSIGNATURE );
+
+    if( bBadSignature )
+    {
+        C->pxSignature->ucData[ 0 ] ^= 0xFFU;
+    }
+
+    C->ulServerFileID = ulServerFileID;
+    C->ulFileSize = ulFileSize;
+    C->ulImageSize = ulFileSize;
+    C->ulBlockSize = OTA_FILE_BLOCK_SIZE;
+    C->ulBlocksRemaining = ( ulFileSize + OTA_FILE_BLOCK_SIZE - 1U ) / OTA_FILE_BLOCK_SIZE;
+
+    ulBitmapSize = ( C->ulBlocksRemaining + BITS_PER_BYTE - 1U ) / BITS_PER_BYTE;
+    C->pucRxBlockBitmap = pvPortMalloc( ulBitmapSize );
+    TEST_ASSERT_NOT_NULL( C->pucRxBlockBitmap );
+    memset( C->pucRxBlockBitmap, 0xFF, ulBitmapSize );
+
+    C->pxFile = fopen( pcFilePath, "w+b" );
+    TEST_ASSERT_NOT_NULL( C->pxFile );
+
+    return C;
+}
+
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_CBOR, CborOtaAgentIngestMultiFile )
+{
+    BaseType_t xResultBool = pdFALSE;
+    IngestResult_t xResultIngest = 0;
+    uint8_t ucCborWork[ CBOR_TEST_MESSAGE_BUFFER_SIZE ];
+    size_t xChunkSize = 0;
+    size_t xEncodedSize = 0;
+    OTA_EventData_t xEventData = { 0 };
+    OTA_FileContext_t * pxFiles[ 2 ] = { NULL, NULL };
+    OTA_Err_t xCloseResult = kOTA_Err_None;
+    uint8_t * pucInFile = NULL;
+    uint32_t ulFileSize = 0;
+    uint32_t ulFile = 0;
+    size_t xBlock = 0;
+    bool bLastBlock = false;
+
+    /* Set OTA data interface to MQTT. */
+    TEST_OTA_prvSetDataInterfaceMQTT();
+
+    /* Read the test signed file. */
+    xResultBool = prvReadCborTestFile(
+        "payload.bin",
+        &pucInFile,
+        &ulFileSize );
+    TEST_ASSERT_TRUE( xResultBool );
+
+    if( TEST_PROTECT() )
+    {
+        /* Both files of the job carry the same payload, but the second one fails its signature check. */
+        pxFiles[ 0 ] = prvCreateJobFileContext( CBOR_TEST_FILEIDENTITY_VALUE, "testOtaFile.bin", ulFileSize, false );
+        pxFiles[ 1 ] = prvCreateJobFileContext( CBOR_TEST_FILEIDENTITY_VALUE + 1, "testOtaFile2.bin", ulFileSize, true );
+        TEST_ASSERT_EQUAL( 2, TEST_OTA_prvFilesReceiving() );
+
+        /* Interleave the blocks of the two files the way a shared stream delivers them. */
+        for( xBlock = 0;
+             ( xBlock * OTA_FILE_BLOCK_SIZE ) < ulFileSize;
+             xBlock++ )
+        {
+            xChunkSize = min(
+                OTA_FILE_BLOCK_SIZE,
+                ulFileSize - ( xBlock * OTA_FILE_BLOCK_SIZE ) );
+            bLastBlock = ( ( xBlock * OTA_FILE_BLOCK_SIZE ) + xChunkSize == ulFileSize );
+
+            for( ulFile = 0; ulFile < 2U; ulFile++ )
+            {
+                xResultBool = prvCreateSampleGetStreamResponseMessage(
+                    ucCborWork,
+                    sizeof( ucCborWork ),
+                    pxFiles[ ulFile ]->ulServerFileID,
+                    xBlock,
+                    pucInFile + ( xBlock * OTA_FILE_BLOCK_SIZE ),
+                    xChunkSize,
+                    &xEncodedSize );
+                TEST_ASSERT_TRUE( xResultBool );
+
+                /* The block is routed to the file it belongs to. */
+                xEventData.pucData = ucCborWork;
+                xEventData.ulDataLength = xEncodedSize;
+                TEST_ASSERT_EQUAL_PTR( pxFiles[ ulFile ], TEST_OTA_prvGetFileForBlock( &xEventData ) );
+
+                xResultIngest = TEST_OTA_prvIngestDataBlock(
+                    pxFiles[ ulFile ],
+                    ucCborWork,
+                    xEncodedSize,
+                    &xCloseResult );
+
+                if( bLastBlock == false )
+                {
+                    TEST_ASSERT_EQUAL_INT32( eIngest_Result_Accepted_Continue, xResultIngest );
+                }
+                else if( ulFile == 0U )
+                {
+                    /* The first file is complete while the other one is still received. */
+                    TEST_ASSERT_EQUAL_INT32( eIngest_Result_FileComplete, xResultIngest );
+                    TEST_ASSERT_EQUAL( 1, TEST_OTA_prvFilesReceiving() );
+
+                    /* A late copy of one of its blocks is dropped instead of being routed to another file. */
+                    TEST_ASSERT_NULL( TEST_OTA_prvGetFileForBlock( &xEventData ) );
+                }
+                else
+                {
+                    /* The second file fails without affecting the file that completed. */
+                    TEST_ASSERT_EQUAL_INT32( eIngest_Result_SigCheckFail, xResultIngest );
+                    TEST_ASSERT_EQUAL( 0, TEST_OTA_prvFilesReceiving() );
+                    TEST_ASSERT_NULL( TEST_OTA_prvGetFileForBlock( &xEventData ) );
+                }
+            }
+        }
+    }
+
+    /* A failed file closes the whole job, which releases every file of it. */
+    TEST_OTA_prvCloseJobFiles();
+    TEST_ASSERT_NULL( TEST_OTA_prvGetJobFile( CBOR_TEST_FILEIDENTITY_VALUE ) );
+    TEST_ASSERT_NULL( TEST_OTA_prvGetJobFile( CBOR_TEST_FILEIDENTITY_VALUE + 1 ) );
+
+    /* Clean-up. */
+    if( NULL != pucInFile )
+    {
+        vPortFree( pucInFile );
+    }
+}
+
+#endif /* if ( OTA_MAX_FILES > 1U ) */
+
 TEST( Quarantine_OTA_CBOR, CborOtaServerFiles )
 {
     BaseType_t xResultBool = pdFALSE;
@@ -722,12 +917,6 @@ TEST( Quarantine_OTA_CBOR, CborOtaServerFiles )
             &xBufferSize );
         TEST_ASSERT_TRUE( xResultBool );
 
-        /* Free the previous chunk buffer. */
-        if( NULL != pucPayload )
-        {
-            vPortFree( pucPayload );
-        }
-
         /* Parse the chunk message. */
         xResultBool = OTA_CBOR_Decode_GetStreamResponseMessage(
             pucInFile,
@@ -753,9 +942,4 @@ TEST( Quarantine_OTA_CBOR, CborOtaServerFiles )
     {
         vPortFree( pucInFile );
     }
-
-    if( NULL != pucPayload )
-    {
-        vPortFree( pucPayload );
-    }
 }
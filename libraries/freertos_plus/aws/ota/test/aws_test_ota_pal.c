@@ -169,6 +169,12 @@ TEST_GROUP_RUNNER( Full_OTA_PAL )
     RUN_TEST_CASE( Full_OTA_PAL, prvPAL_WriteBlock_WriteSingleByte );
     RUN_TEST_CASE( Full_OTA_PAL, prvPAL_WriteBlock_WriteManyBlocks );
 
+    #if ( otatestpalCHECKPOINT_SUPPORTED == 1 )
+        RUN_TEST_CASE( Full_OTA_PAL, prvPAL_ResumeFileForRx_Interrupted );
+        RUN_TEST_CASE( Full_OTA_PAL, prvPAL_ResumeFileForRx_NoCheckpoint );
+        RUN_TEST_CASE( Full_OTA_PAL, prvPAL_SaveCheckpoint_ReplacesPrevious );
+    #endif
+
     /* This test resets the device so it is not valid for an MCU. */
     RUN_TEST_CASE( Full_OTA_PAL, prvPAL_ActivateNewImage );
 
@@ -617,6 +623,131 @@ TEST( Full_OTA_PAL, prvPAL_WriteBlock_WriteManyBlocks )
     }
 }
 
+#if ( otatestpalCHECKPOINT_SUPPORTED == 1 )
+
+/**
+ * @brief Write half a file, store a checkpoint and drop the file as a reset would. Resume
+ * the file, write the rest and verify the whole file passes the signature check.
+ */
+    TEST( Full_OTA_PAL, prvPAL_ResumeFileForRx_Interrupted )
+    {
+        OTA_Err_t xOtaStatus;
+        OTA_FileContext_t xInterruptedFile;
+        int16_t sNumBytesWritten;
+        int32_t lCheckpointLength;
+        uint32_t ulHalfSize = sizeof( ucDummyData ) / 2U;
+        const uint8_t ucCheckpoint[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+        uint8_t ucReadBack[ 16 ] = { 0 };
+        Sig256_t xSig = { 0 };
+
+        xOtaFile.pucFilePath = ( uint8_t * ) ( "test_resume_image.bin" );
+        xOtaFile.ulFileSize = sizeof( ucDummyData );
+        xOtaStatus = prvPAL_CreateFileForRx( &xOtaFile );
+        TEST_ASSERT_EQUAL( kOTA_Err_None, xOtaStatus );
+
+        sNumBytesWritten = prvPAL_WriteBlock( &xOtaFile, 0, ucDummyData, ulHalfSize );
+        TEST_ASSERT_EQUAL_INT( ulHalfSize, sNumBytesWritten );
+
+        xOtaStatus = prvPAL_SaveCheckpoint( &xOtaFile, ucCheckpoint, sizeof( ucCheckpoint ) );
+        TEST_ASSERT_EQUAL_INT( kOTA_Err_None, xOtaStatus );
+
+        /* The agent forgets the file on a reset. Keep the old handle only to release it. */
+        xInterruptedFile = xOtaFile;
+        memset( &xOtaFile, 0, sizeof( xOtaFile ) );
+        ( void ) prvPAL_Abort( &xInterruptedFile );
+
+        xOtaFile.pucFilePath = ( uint8_t * ) ( "test_resume_image.bin" );
+        xOtaFile.ulFileSize = sizeof( ucDummyData );
+        lCheckpointLength = prvPAL_ResumeFileForRx( &xOtaFile, ucReadBack, sizeof( ucReadBack ) );
+
+        if( TEST_PROTECT() )
+        {
+            TEST_ASSERT_EQUAL_INT( sizeof( ucCheckpoint ), lCheckpointLength );
+            TEST_ASSERT_EQUAL_UINT8_ARRAY( ucCheckpoint, ucReadBack, sizeof( ucCheckpoint ) );
+            TEST_ASSERT_NOT_NULL( xOtaFile.pucFile );
+
+            sNumBytesWritten = prvPAL_WriteBlock( &xOtaFile,
+                                                  ulHalfSize,
+                                                  &ucDummyData[ ulHalfSize ],
+                                                  sizeof( ucDummyData ) - ulHalfSize );
+            TEST_ASSERT_EQUAL_INT( sizeof( ucDummyData ) - ulHalfSize, sNumBytesWritten );
+
+            xOtaFile.pxSignature = &xSig;
+            xOtaFile.pxSignature->usSize = ucValidSignatureLength;
+            memcpy( xOtaFile.pxSignature->ucData, ucValidSignature, ucValidSignatureLength );
+            xOtaFile.pucCertFilepath = ( uint8_t * ) otatestpalCERTIFICATE_FILE;
+
+            /* The blocks written before the reset must still be there for the signature to match. */
+            xOtaStatus = prvPAL_CloseFile( &xOtaFile );
+            TEST_ASSERT_EQUAL_INT( kOTA_Err_None, xOtaStatus );
+        }
+
+        ( void ) prvPAL_SaveCheckpoint( &xOtaFile, NULL, 0 );
+    }
+
+/**
+ * @brief Verify a file without a stored checkpoint is not resumed or opened.
+ */
+    TEST( Full_OTA_PAL, prvPAL_ResumeFileForRx_NoCheckpoint )
+    {
+        OTA_Err_t xOtaStatus;
+        int32_t lCheckpointLength;
+        uint8_t ucReadBack[ 16 ] = { 0 };
+
+        xOtaFile.pucFilePath = ( uint8_t * ) otatestpalFIRMWARE_FILE;
+
+        /* Erasing when there is no checkpoint is not an error. */
+        xOtaStatus = prvPAL_SaveCheckpoint( &xOtaFile, NULL, 0 );
+        TEST_ASSERT_EQUAL_INT( kOTA_Err_None, xOtaStatus );
+
+        lCheckpointLength = prvPAL_ResumeFileForRx( &xOtaFile, ucReadBack, sizeof( ucReadBack ) );
+        TEST_ASSERT_EQUAL_INT( 0, lCheckpointLength );
+        TEST_ASSERT_NULL( xOtaFile.pucFile );
+    }
+
+/**
+ * @brief Verify only the latest checkpoint is resumed and one that doesn't fit is rejected.
+ */
+    TEST( Full_OTA_PAL, prvPAL_SaveCheckpoint_ReplacesPrevious )
+    {
+        OTA_Err_t xOtaStatus;
+        int32_t lCheckpointLength;
+        const uint8_t ucFirst[] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
+        const uint8_t ucSecond[] = { 0xAA, 0xBB, 0xCC, 0xDD };
+        uint8_t ucReadBack[ 16 ] = { 0 };
+
+        xOtaFile.pucFilePath = ( uint8_t * ) otatestpalFIRMWARE_FILE;
+        xOtaStatus = prvPAL_CreateFileForRx( &xOtaFile );
+        TEST_ASSERT_EQUAL( kOTA_Err_None, xOtaStatus );
+
+        if( TEST_PROTECT() )
+        {
+            xOtaStatus = prvPAL_SaveCheckpoint( &xOtaFile, ucFirst, sizeof( ucFirst ) );
+            TEST_ASSERT_EQUAL_INT( kOTA_Err_None, xOtaStatus );
+            xOtaStatus = prvPAL_SaveCheckpoint( &xOtaFile, ucSecond, sizeof( ucSecond ) );
+            TEST_ASSERT_EQUAL_INT( kOTA_Err_None, xOtaStatus );
+
+            xOtaStatus = prvPAL_Abort( &xOtaFile );
+            TEST_ASSERT_EQUAL_INT( kOTA_Err_None, xOtaStatus );
+
+            lCheckpointLength = prvPAL_ResumeFileForRx( &xOtaFile, ucReadBack, sizeof( ucReadBack ) );
+            TEST_ASSERT_EQUAL_INT( sizeof( ucSecond ), lCheckpointLength );
+            TEST_ASSERT_EQUAL_UINT8_ARRAY( ucSecond, ucReadBack, sizeof( ucSecond ) );
+
+            xOtaStatus = prvPAL_Abort( &xOtaFile );
+            TEST_ASSERT_EQUAL_INT( kOTA_Err_None, xOtaStatus );
+
+            /* A checkpoint larger than the caller's buffer fails and leaves the file closed. */
+            lCheckpointLength = prvPAL_ResumeFileForRx( &xOtaFile, ucReadBack, sizeof( ucSecond ) - 1U );
+            TEST_ASSERT_LESS_THAN_INT32( 0, lCheckpointLength );
+            TEST_ASSERT_NULL( xOtaFile.pucFile );
+        }
+
+        ( void ) prvPAL_SaveCheckpoint( &xOtaFile, NULL, 0 );
+    }
+
+#endif /* if ( otatestpalCHECKPOINT_SUPPORTED == 1 ) */
+
 /**
  * Call prvPAL_ActivateNewImage() and verify success. This function is expected to
  * reset the device, so this test is only supported on the Windows Simulator environment.
@@ -0,0 +1,484 @@
+/*
+ * FreeRTOS OTA V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "aws_iot_ota_decompress.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define IMAGE_SIZE          ( 40000U )
+#define MAX_COMPRESSED_SIZE ( 48000U )
+#define BLOCK_SIZE          ( 1024U ) /* Size of the chunks fed to the decompressor, like OTA file blocks. */
+#define WINDOW_SIZE         ( 1024U ) /* Size of the window buffer given to the decompressor. */
+
+/*******************************************************************************
+ * Global Variables
+ ******************************************************************************/
+static uint8_t ucImage[ IMAGE_SIZE ];
+static uint8_t ucResult[ IMAGE_SIZE ];
+static uint8_t ucCompressed[ MAX_COMPRESSED_SIZE ];
+static uint8_t ucWindow[ OTA_DECOMPRESS_MAX_WINDOW_SIZE ];
+static uint32_t ulImageSize = 0;
+static uint32_t ulCompressedSize = 0;
+static uint32_t ulResultSize = 0;
+static uint32_t ulWindowSize = 0;
+static uint32_t ulWriteCalls = 0;
+static bool bFailWrites = false;
+static OTA_Decompress_t xDecompress;
+
+/*******************************************************************************
+ * Sample image and compression
+ ******************************************************************************/
+
+/* Fill the image with repeatable data that compresses a little like code, built
+ * from a small set of instruction patterns and runs of padding. */
+static void prvFillImage( uint32_t ulSeed )
+{
+    uint8_t ucPatterns[ 32 ][ 4 ];
+    uint32_t i, j;
+
+    for( i = 0; i < 32U; i++ )
+    {
+        for( j = 0; j < 4U; j++ )
+        {
+            ulSeed = ( ulSeed * 1103515245U ) + 12345U;
+            ucPatterns[ i ][ j ] = ( uint8_t ) ( ulSeed >> 16 );
+        }
+    }
+
+    for( i = 0; i < ulImageSize; i += 4U )
+    {
+        ulSeed = ( ulSeed * 1103515245U ) + 12345U;
+
+        for( j = 0; ( j < 4U ) && ( ( i + j ) < ulImageSize ); j++ )
+        {
+            /* Mostly common instructions, with some unique immediates mixed in. */
+            ucImage[ i + j ] = ( ( ( ulSeed >> 24 ) & 0x7U ) == 0U ) ? ( uint8_t ) ( ulSeed >> ( 8U * j ) ) : ucPatterns[ ( ulSeed >> 16 ) & 0x1FU ][ j ];
+        }
+    }
+}
+
+static void prvPutU32( uint8_t * pucData,
+                       uint32_t ulValue )
+{
+    pucData[ 0 ] = ( uint8_t ) ulValue;
+    pucData[ 1 ] = ( uint8_t ) ( ulValue >> 8 );
+    pucData[ 2 ] = ( uint8_t ) ( ulValue >> 16 );
+    pucData[ 3 ] = ( uint8_t ) ( ulValue >> 24 );
+}
+
+static void prvPutHeader( uint32_t ulVersion,
+                          uint32_t ulWindow )
+{
+    memcpy( ucCompressed, "OTAZ", 4 );
+    prvPutU32( &ucCompressed[ 4 ], ulVersion );
+    prvPutU32( &ucCompressed[ 8 ], ulWindow );
+    prvPutU32( &ucCompressed[ 12 ], ulImageSize );
+    ulCompressedSize = OTA_DECOMPRESS_HEADER_SIZE;
+}
+
+/* Compress the image with a window of ulWindow bytes. The longest match is searched for
+ * among the last few positions with the same 3 byte hash, which is plenty for a test. */
+static void prvCompress( uint32_t ulWindow )
+{
+    static uint32_t ulHead[ 1U << 12 ];
+    static uint32_t ulPrev[ IMAGE_SIZE ];
+    uint32_t ulPos = 0;
+    uint32_t ulFlagPos = 0;
+    uint32_t ulItems = 8U;
+    uint32_t ulHash, ulCandidate, ulLength, ulBestLength, ulBestDistance, ulTries, i;
+
+    memset( ulHead, 0xFF, sizeof( ulHead ) );
+    prvPutHeader( OTA_DECOMPRESS_FORMAT_VERSION, ulWindow );
+
+    while( ulPos < ulImageSize )
+    {
+        ulBestLength = 0;
+        ulBestDistance = 0;
+
+        if( ( ulPos + OTA_DECOMPRESS_MIN_MATCH ) <= ulImageSize )
+        {
+            ulHash = ( ( ucImage[ ulPos ] << 4 ) ^ ( ucImage[ ulPos + 1U ] << 2 ) ^ ucImage[ ulPos + 2U ] ) & 0xFFFU;
+            ulCandidate = ulHead[ ulHash ];
+
+            for( ulTries = 0; ( ulTries < 32U ) && ( ulCandidate != 0xFFFFFFFFU ) && ( ( ulPos - ulCandidate ) <= ulWindow ); ulTries++ )
+            {
+                ulLength = 0;
+
+                while( ( ulLength < OTA_DECOMPRESS_MAX_MATCH ) &&
+                       ( ( ulPos + ulLength ) < ulImageSize ) &&
+                       ( ucImage[ ulCandidate + ulLength ] == ucImage[ ulPos + ulLength ] ) )
+                {
+                    ulLength++;
+                }
+
+                if( ulLength > ulBestLength )
+                {
+                    ulBestLength = ulLength;
+                    ulBestDistance = ulPos - ulCandidate;
+                }
+
+                ulCandidate = ulPrev[ ulCandidate ];
+            }
+        }
+
+        if( ulItems == 8U )
+        {
+            ulFlagPos = ulCompressedSize++;
+            ucCompressed[ ulFlagPos ] = 0;
+            ulItems = 0;
+        }
+
+        if( ulBestLength >= OTA_DECOMPRESS_MIN_MATCH )
+        {
+            i = ( ( ulBestLength - OTA_DECOMPRESS_MIN_MATCH ) << 12 ) | ( ulBestDistance - 1U );
+            ucCompressed[ ulCompressedSize++ ] = ( uint8_t ) i;
+            ucCompressed[ ulCompressedSize++ ] = ( uint8_t ) ( i >> 8 );
+        }
+        else
+        {
+            ucCompressed[ ulFlagPos ] |= ( uint8_t ) ( 1U << ulItems );
+            ucCompressed[ ulCompressedSize++ ] = ucImage[ ulPos ];
+            ulBestLength = 1U;
+        }
+
+        ulItems++;
+
+        /* Index every position the item covered. */
+        for( i = 0; i < ulBestLength; i++, ulPos++ )
+        {
+            if( ( ulPos + OTA_DECOMPRESS_MIN_MATCH ) <= ulImageSize )
+            {
+                ulHash = ( ( ucImage[ ulPos ] << 4 ) ^ ( ucImage[ ulPos + 1U ] << 2 ) ^ ucImage[ ulPos + 2U ] ) & 0xFFFU;
+                ulPrev[ ulPos ] = ulHead[ ulHash ];
+                ulHead[ ulHash ] = ulPos;
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Decompressor callbacks
+ ******************************************************************************/
+static int32_t prvWriteImage( void * pvContext,
+                              uint32_t ulOffset,
+                              uint8_t * pucData,
+                              uint32_t ulLength )
+{
+    int32_t lResult = -1;
+
+    TEST_ASSERT_EQUAL_PTR( &xDecompress, pvContext );
+
+    /* Whole windows are written in order, only the last write may be short. */
+    TEST_ASSERT_EQUAL_UINT32( ulResultSize, ulOffset );
+    TEST_ASSERT_TRUE( ulLength > 0U );
+    TEST_ASSERT_TRUE( ulLength <= ulWindowSize );
+    TEST_ASSERT_EQUAL_UINT32( 0U, ulOffset % ulWindowSize );
+    ulWriteCalls++;
+
+    if( ( bFailWrites == false ) && ( ( ulOffset + ulLength ) <= IMAGE_SIZE ) )
+    {
+        memcpy( &ucResult[ ulOffset ], pucData, ulLength );
+        ulResultSize = ulOffset + ulLength;
+        lResult = ( int32_t ) ulLength;
+    }
+
+    return lResult;
+}
+
+/* Decompress in ulChunk sized pieces the way the agent passes file blocks. */
+static OTA_DecompressErr_t prvDecompress( uint32_t ulWindowBuffer,
+                                          uint32_t ulChunk )
+{
+    OTA_DecompressErr_t eErr;
+    uint32_t ulOffset = 0;
+    uint32_t ulLength;
+
+    ulResultSize = 0;
+    ulWriteCalls = 0;
+    eErr = OTA_Decompress_Init( &xDecompress, ucWindow, ulWindowBuffer, prvWriteImage, &xDecompress );
+
+    while( ( eErr == eOTA_DecompressErr_None ) && ( ulOffset < ulCompressedSize ) )
+    {
+        ulLength = ( ( ulCompressedSize - ulOffset ) < ulChunk ) ? ( ulCompressedSize - ulOffset ) : ulChunk;
+        eErr = OTA_Decompress_Apply( &xDecompress, &ucCompressed[ ulOffset ], ulLength );
+        ulOffset += ulLength;
+    }
+
+    if( eErr == eOTA_DecompressErr_None )
+    {
+        eErr = OTA_Decompress_Finish( &xDecompress );
+    }
+
+    return eErr;
+}
+
+static void prvCheckResult( void )
+{
+    TEST_ASSERT_EQUAL_UINT32( ulImageSize, ulResultSize );
+    TEST_ASSERT_EQUAL_MEMORY( ucImage, ucResult, ulImageSize );
+}
+
+/*******************************************************************************
+ * Unity fixtures
+ ******************************************************************************/
+void setUp( void )
+{
+    ulImageSize = IMAGE_SIZE;
+    prvFillImage( 1U );
+
+    ulWindowSize = WINDOW_SIZE;
+    ulCompressedSize = 0;
+    ulResultSize = 0;
+    ulWriteCalls = 0;
+    bFailWrites = false;
+    memset( ucResult, 0, sizeof( ucResult ) );
+}
+
+/* called before each testcase */
+void tearDown( void )
+{
+}
+
+/* called at the beginning of the whole suite */
+void suiteSetUp()
+{
+}
+
+/* called at the end of the whole suite */
+int suiteTearDown( int numFailures )
+{
+    return( numFailures > 0 );
+}
+
+/*******************************************************************************
+ * Decompression
+ ******************************************************************************/
+
+/**
+ * @brief A code like image compresses well and is restored exactly, a window at a time.
+ */
+void test_OTA_Decompress_Image( void )
+{
+    prvCompress( WINDOW_SIZE );
+
+    TEST_ASSERT_TRUE( ulCompressedSize < ( ( ulImageSize * 7U ) / 10U ) );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+    prvCheckResult();
+    TEST_ASSERT_EQUAL_UINT32( ( IMAGE_SIZE + WINDOW_SIZE - 1U ) / WINDOW_SIZE, ulWriteCalls );
+}
+
+/**
+ * @brief Runs are coded as matches that overlap the bytes they produce.
+ */
+void test_OTA_Decompress_Runs( void )
+{
+    memset( ucImage, 0xFF, ulImageSize );
+    memset( &ucImage[ 10000 ], 0x00, 5000U );
+    prvCompress( WINDOW_SIZE );
+
+    TEST_ASSERT_TRUE( ulCompressedSize < ( ulImageSize / 8U ) );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+    prvCheckResult();
+}
+
+/**
+ * @brief Any window from the smallest to the largest works, and a window buffer larger
+ * than the image needs is fine.
+ */
+void test_OTA_Decompress_WindowSizes( void )
+{
+    uint32_t ulWindow;
+
+    for( ulWindow = OTA_DECOMPRESS_MIN_WINDOW_SIZE; ulWindow <= OTA_DECOMPRESS_MAX_WINDOW_SIZE; ulWindow <<= 1 )
+    {
+        prvCompress( ulWindow );
+        ulWindowSize = ulWindow;
+        TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, prvDecompress( ulWindow, BLOCK_SIZE ) );
+        prvCheckResult();
+    }
+
+    prvCompress( 256U );
+    ulWindowSize = 256U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, prvDecompress( OTA_DECOMPRESS_MAX_WINDOW_SIZE, BLOCK_SIZE ) );
+    prvCheckResult();
+}
+
+/**
+ * @brief The data may be split anywhere, including inside the header and matches.
+ */
+void test_OTA_Decompress_AnyChunkSize( void )
+{
+    uint32_t ulChunk;
+
+    ulImageSize = 5000U;
+    prvCompress( WINDOW_SIZE );
+
+    for( ulChunk = 1U; ulChunk <= 17U; ulChunk++ )
+    {
+        TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, prvDecompress( WINDOW_SIZE, ulChunk ) );
+        prvCheckResult();
+    }
+}
+
+/**
+ * @brief An image that isn't a multiple of the window size is written out at finish.
+ */
+void test_OTA_Decompress_PartialLastWindow( void )
+{
+    ulImageSize = ( 3U * WINDOW_SIZE ) + 5U;
+    prvCompress( WINDOW_SIZE );
+
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+    prvCheckResult();
+    TEST_ASSERT_EQUAL_UINT32( 4U, ulWriteCalls );
+}
+
+/*******************************************************************************
+ * Malformed data and failures
+ ******************************************************************************/
+
+/**
+ * @brief Bad parameters are rejected.
+ */
+void test_OTA_Decompress_BadParams( void )
+{
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadParams, OTA_Decompress_Init( NULL, ucWindow, WINDOW_SIZE, prvWriteImage, NULL ) );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadParams, OTA_Decompress_Init( &xDecompress, NULL, WINDOW_SIZE, prvWriteImage, NULL ) );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadParams, OTA_Decompress_Init( &xDecompress, ucWindow, WINDOW_SIZE, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadParams, OTA_Decompress_Init( &xDecompress, ucWindow, 8U, prvWriteImage, NULL ) );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadParams, OTA_Decompress_Init( &xDecompress, ucWindow, 1000U, prvWriteImage, NULL ) );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadParams, OTA_Decompress_Apply( NULL, ucCompressed, 1U ) );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadParams, OTA_Decompress_Finish( NULL ) );
+}
+
+/**
+ * @brief The magic, format version and window size are checked.
+ */
+void test_OTA_Decompress_BadHeader( void )
+{
+    prvCompress( WINDOW_SIZE );
+    ucCompressed[ 0 ] = 'X';
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadHeader, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+
+    prvPutHeader( OTA_DECOMPRESS_FORMAT_VERSION + 1U, WINDOW_SIZE );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadHeader, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+
+    prvPutHeader( OTA_DECOMPRESS_FORMAT_VERSION, 1000U );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadHeader, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+
+    prvPutHeader( OTA_DECOMPRESS_FORMAT_VERSION, OTA_DECOMPRESS_MAX_WINDOW_SIZE * 2U );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadHeader, prvDecompress( OTA_DECOMPRESS_MAX_WINDOW_SIZE, BLOCK_SIZE ) );
+}
+
+/**
+ * @brief An image compressed with a larger window than the device provides is rejected.
+ */
+void test_OTA_Decompress_WindowTooLarge( void )
+{
+    prvCompress( 2U * WINDOW_SIZE );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_WindowTooLarge, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+}
+
+/**
+ * @brief Matches before the start of the image, beyond the window or past the end of
+ * the image are rejected.
+ */
+void test_OTA_Decompress_BadData( void )
+{
+    uint32_t i;
+
+    /* A match with nothing produced yet. */
+    prvPutHeader( OTA_DECOMPRESS_FORMAT_VERSION, WINDOW_SIZE );
+    ucCompressed[ ulCompressedSize++ ] = 0x00U;
+    ucCompressed[ ulCompressedSize++ ] = 0x00U;
+    ucCompressed[ ulCompressedSize++ ] = 0x00U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadData, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+
+    /* 17 literals then a match reaching 17 bytes back with a 16 byte window. */
+    ulWindowSize = OTA_DECOMPRESS_MIN_WINDOW_SIZE;
+    prvPutHeader( OTA_DECOMPRESS_FORMAT_VERSION, OTA_DECOMPRESS_MIN_WINDOW_SIZE );
+
+    for( i = 0; i < 17U; i++ )
+    {
+        if( ( i % 8U ) == 0U )
+        {
+            ucCompressed[ ulCompressedSize++ ] = ( i < 16U ) ? 0xFFU : 0x01U;
+        }
+
+        ucCompressed[ ulCompressedSize++ ] = ( uint8_t ) i;
+    }
+
+    ucCompressed[ ulCompressedSize++ ] = 0x10U;
+    ucCompressed[ ulCompressedSize++ ] = 0x00U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadData, prvDecompress( OTA_DECOMPRESS_MIN_WINDOW_SIZE, BLOCK_SIZE ) );
+
+    /* A literal then a match longer than the rest of a 4 byte image. */
+    ulImageSize = 4U;
+    ulWindowSize = WINDOW_SIZE;
+    prvPutHeader( OTA_DECOMPRESS_FORMAT_VERSION, WINDOW_SIZE );
+    ucCompressed[ ulCompressedSize++ ] = 0x01U;
+    ucCompressed[ ulCompressedSize++ ] = 0xAAU;
+    ucCompressed[ ulCompressedSize++ ] = 0x00U;
+    ucCompressed[ ulCompressedSize++ ] = 0x10U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadData, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+}
+
+/**
+ * @brief Truncated data is reported at finish and extra data is rejected.
+ */
+void test_OTA_Decompress_TruncatedAndTrailing( void )
+{
+    uint32_t ulFullSize;
+
+    prvCompress( WINDOW_SIZE );
+    ulFullSize = ulCompressedSize;
+
+    ulCompressedSize = ulFullSize - 1U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_Incomplete, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+
+    ulCompressedSize = OTA_DECOMPRESS_HEADER_SIZE - 1U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_Incomplete, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+
+    ulCompressedSize = ulFullSize + 1U;
+    ucCompressed[ ulFullSize ] = 0x00U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_TrailingData, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+}
+
+/**
+ * @brief Image write failures are reported.
+ */
+void test_OTA_Decompress_WriteFailure( void )
+{
+    prvCompress( WINDOW_SIZE );
+
+    bFailWrites = true;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_WriteFailed, prvDecompress( WINDOW_SIZE, BLOCK_SIZE ) );
+}
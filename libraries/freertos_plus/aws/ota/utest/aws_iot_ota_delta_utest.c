@@ -0,0 +1,475 @@
+/*
+ * FreeRTOS OTA V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "aws_iot_ota_delta.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define IMAGE_SIZE          ( 40000U )
+#define MAX_IMAGE_SIZE      ( 48000U )
+#define MAX_PATCH_SIZE      ( 64000U )
+#define BLOCK_SIZE          ( 1024U )  /* Size of the patch chunks fed to the applier, like OTA file blocks. */
+#define OUTPUT_SIZE         ( 256U )   /* Size of the applier output buffer. */
+#define MIN_MATCH           ( 16U )    /* Shortest base image match the patch generator emits as a copy. */
+
+/*******************************************************************************
+ * Global Variables
+ ******************************************************************************/
+static uint8_t ucBase[ MAX_IMAGE_SIZE ];
+static uint8_t ucTarget[ MAX_IMAGE_SIZE ];
+static uint8_t ucResult[ MAX_IMAGE_SIZE ];
+static uint8_t ucPatch[ MAX_PATCH_SIZE ];
+static uint8_t ucOutput[ OUTPUT_SIZE ];
+static uint32_t ulBaseSize = 0;
+static uint32_t ulTargetSize = 0;
+static uint32_t ulPatchSize = 0;
+static uint32_t ulResultSize = 0;
+static uint32_t ulWriteCalls = 0;
+static bool bFailReads = false;
+static bool bFailWrites = false;
+static OTA_DeltaPatch_t xPatch;
+
+/*******************************************************************************
+ * Sample images and patch generation
+ ******************************************************************************/
+
+/* Fill a buffer with repeatable pseudo random data that looks a little like code. */
+static void prvFillImage( uint8_t * pucImage,
+                          uint32_t ulSize,
+                          uint32_t ulSeed )
+{
+    uint32_t i;
+
+    for( i = 0; i < ulSize; i++ )
+    {
+        ulSeed = ( ulSeed * 1103515245U ) + 12345U;
+        pucImage[ i ] = ( uint8_t ) ( ( ulSeed >> 16 ) & 0x3FU );
+    }
+}
+
+static void prvPutU32( uint8_t * pucData,
+                       uint32_t ulValue )
+{
+    pucData[ 0 ] = ( uint8_t ) ulValue;
+    pucData[ 1 ] = ( uint8_t ) ( ulValue >> 8 );
+    pucData[ 2 ] = ( uint8_t ) ( ulValue >> 16 );
+    pucData[ 3 ] = ( uint8_t ) ( ulValue >> 24 );
+}
+
+static void prvPutHeader( uint32_t ulVersion )
+{
+    memcpy( ucPatch, "OTAD", 4 );
+    prvPutU32( &ucPatch[ 4 ], ulVersion );
+    prvPutU32( &ucPatch[ 8 ], ulBaseSize );
+    prvPutU32( &ucPatch[ 12 ], ulTargetSize );
+    ulPatchSize = OTA_DELTA_HEADER_SIZE;
+}
+
+static void prvPutCopy( uint32_t ulOffset,
+                        uint32_t ulLength )
+{
+    ucPatch[ ulPatchSize ] = OTA_DELTA_OP_COPY;
+    prvPutU32( &ucPatch[ ulPatchSize + 1U ], ulLength );
+    prvPutU32( &ucPatch[ ulPatchSize + 5U ], ulOffset );
+    ulPatchSize += OTA_DELTA_COPY_CMD_SIZE;
+}
+
+static void prvPutInsert( const uint8_t * pucData,
+                          uint32_t ulLength )
+{
+    ucPatch[ ulPatchSize ] = OTA_DELTA_OP_INSERT;
+    prvPutU32( &ucPatch[ ulPatchSize + 1U ], ulLength );
+    memcpy( &ucPatch[ ulPatchSize + OTA_DELTA_INSERT_CMD_SIZE ], pucData, ulLength );
+    ulPatchSize += OTA_DELTA_INSERT_CMD_SIZE + ulLength;
+}
+
+/* Generate a patch from ucBase to ucTarget. Matches are found by hashing MIN_MATCH byte
+ * windows of the base image, which is enough to find moved and unchanged code. */
+static void prvGeneratePatch( void )
+{
+    static uint32_t ulIndex[ 1U << 16 ];
+    uint32_t ulPos = 0;
+    uint32_t ulLiteralStart = 0;
+    uint32_t ulHash, ulCandidate, ulLength, i;
+
+    memset( ulIndex, 0xFF, sizeof( ulIndex ) );
+
+    for( i = 0; ( i + MIN_MATCH ) <= ulBaseSize; i++ )
+    {
+        ulHash = ( ( ucBase[ i ] * 2654435761U ) ^ ( ucBase[ i + 3U ] << 8 ) ^ ( ucBase[ i + 7U ] << 12 ) ^ ucBase[ i + 15U ] ) & 0xFFFFU;
+        ulIndex[ ulHash ] = i;
+    }
+
+    prvPutHeader( OTA_DELTA_FORMAT_VERSION );
+
+    while( ulPos < ulTargetSize )
+    {
+        ulLength = 0;
+
+        if( ( ulPos + MIN_MATCH ) <= ulTargetSize )
+        {
+            ulHash = ( ( ucTarget[ ulPos ] * 2654435761U ) ^ ( ucTarget[ ulPos + 3U ] << 8 ) ^ ( ucTarget[ ulPos + 7U ] << 12 ) ^ ucTarget[ ulPos + 15U ] ) & 0xFFFFU;
+            ulCandidate = ulIndex[ ulHash ];
+
+            if( ulCandidate != 0xFFFFFFFFU )
+            {
+                while( ( ( ulCandidate + ulLength ) < ulBaseSize ) &&
+                       ( ( ulPos + ulLength ) < ulTargetSize ) &&
+                       ( ucBase[ ulCandidate + ulLength ] == ucTarget[ ulPos + ulLength ] ) )
+                {
+                    ulLength++;
+                }
+            }
+        }
+
+        if( ulLength >= MIN_MATCH )
+        {
+            if( ulPos > ulLiteralStart )
+            {
+                prvPutInsert( &ucTarget[ ulLiteralStart ], ulPos - ulLiteralStart );
+            }
+
+            prvPutCopy( ulCandidate, ulLength );
+            ulPos += ulLength;
+            ulLiteralStart = ulPos;
+        }
+        else
+        {
+            ulPos++;
+        }
+    }
+
+    if( ulPos > ulLiteralStart )
+    {
+        prvPutInsert( &ucTarget[ ulLiteralStart ], ulPos - ulLiteralStart );
+    }
+}
+
+/*******************************************************************************
+ * Applier callbacks
+ ******************************************************************************/
+static int32_t prvReadBase( void * pvContext,
+                            uint32_t ulOffset,
+                            uint8_t * pucData,
+                            uint32_t ulLength )
+{
+    int32_t lResult = -1;
+
+    TEST_ASSERT_EQUAL_PTR( &xPatch, pvContext );
+
+    if( ( bFailReads == false ) && ( ( ulOffset + ulLength ) <= ulBaseSize ) )
+    {
+        memcpy( pucData, &ucBase[ ulOffset ], ulLength );
+        lResult = ( int32_t ) ulLength;
+    }
+
+    return lResult;
+}
+
+static int32_t prvWriteTarget( void * pvContext,
+                               uint32_t ulOffset,
+                               uint8_t * pucData,
+                               uint32_t ulLength )
+{
+    int32_t lResult = -1;
+
+    TEST_ASSERT_EQUAL_PTR( &xPatch, pvContext );
+
+    /* The applier only ever writes whole output buffers in order. */
+    TEST_ASSERT_EQUAL_UINT32( ulResultSize, ulOffset );
+    TEST_ASSERT_EQUAL_UINT32( 0U, ulOffset % OUTPUT_SIZE );
+    TEST_ASSERT_TRUE( ulLength <= OUTPUT_SIZE );
+    ulWriteCalls++;
+
+    if( ( bFailWrites == false ) && ( ( ulOffset + ulLength ) <= MAX_IMAGE_SIZE ) )
+    {
+        memcpy( &ucResult[ ulOffset ], pucData, ulLength );
+        ulResultSize = ulOffset + ulLength;
+        lResult = ( int32_t ) ulLength;
+    }
+
+    return lResult;
+}
+
+/* Apply the patch in ulChunk sized pieces the way the agent passes file blocks. */
+static OTA_DeltaErr_t prvApplyPatch( uint32_t ulChunk )
+{
+    OTA_DeltaErr_t eErr;
+    uint32_t ulOffset = 0;
+    uint32_t ulLength;
+
+    ulResultSize = 0;
+    ulWriteCalls = 0;
+    eErr = OTA_Delta_Init( &xPatch, ucOutput, sizeof( ucOutput ), prvReadBase, prvWriteTarget, &xPatch );
+
+    while( ( eErr == eOTA_DeltaErr_None ) && ( ulOffset < ulPatchSize ) )
+    {
+        ulLength = ( ( ulPatchSize - ulOffset ) < ulChunk ) ? ( ulPatchSize - ulOffset ) : ulChunk;
+        eErr = OTA_Delta_Apply( &xPatch, &ucPatch[ ulOffset ], ulLength );
+        ulOffset += ulLength;
+    }
+
+    if( eErr == eOTA_DeltaErr_None )
+    {
+        eErr = OTA_Delta_Finish( &xPatch );
+    }
+
+    return eErr;
+}
+
+static void prvCheckResult( void )
+{
+    TEST_ASSERT_EQUAL_UINT32( ulTargetSize, ulResultSize );
+    TEST_ASSERT_EQUAL_MEMORY( ucTarget, ucResult, ulTargetSize );
+}
+
+/*******************************************************************************
+ * Unity fixtures
+ ******************************************************************************/
+void setUp( void )
+{
+    ulBaseSize = IMAGE_SIZE;
+    prvFillImage( ucBase, ulBaseSize, 1U );
+
+    /* By default the new image is the old one with a few edits. */
+    ulTargetSize = ulBaseSize;
+    memcpy( ucTarget, ucBase, ulTargetSize );
+
+    ulPatchSize = 0;
+    ulResultSize = 0;
+    ulWriteCalls = 0;
+    bFailReads = false;
+    bFailWrites = false;
+    memset( ucResult, 0, sizeof( ucResult ) );
+}
+
+/* called before each testcase */
+void tearDown( void )
+{
+}
+
+/* called at the beginning of the whole suite */
+void suiteSetUp()
+{
+}
+
+/* called at the end of the whole suite */
+int suiteTearDown( int numFailures )
+{
+    return( numFailures > 0 );
+}
+
+/*******************************************************************************
+ * Patch application
+ ******************************************************************************/
+
+/**
+ * @brief An identical image is a single copy of the base image.
+ */
+void test_OTA_Delta_IdenticalImage( void )
+{
+    prvGeneratePatch();
+
+    TEST_ASSERT_EQUAL_UINT32( OTA_DELTA_HEADER_SIZE + OTA_DELTA_COPY_CMD_SIZE, ulPatchSize );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_None, prvApplyPatch( BLOCK_SIZE ) );
+    prvCheckResult();
+    TEST_ASSERT_EQUAL_UINT32( ( IMAGE_SIZE + OUTPUT_SIZE - 1U ) / OUTPUT_SIZE, ulWriteCalls );
+}
+
+/**
+ * @brief Small edits, an insertion and a deletion produce a patch much smaller than the image.
+ */
+void test_OTA_Delta_EditedImage( void )
+{
+    uint32_t ulInsertAt = 12000U;
+
+    /* Patch a few scattered bytes, like changed constants. */
+    ucTarget[ 100 ] ^= 0x80U;
+    ucTarget[ 5000 ] ^= 0x80U;
+    ucTarget[ 30000 ] ^= 0x80U;
+
+    /* Insert 300 new bytes, shifting the rest of the image. */
+    memmove( &ucTarget[ ulInsertAt + 300U ], &ucTarget[ ulInsertAt ], ulTargetSize - ulInsertAt );
+    prvFillImage( &ucTarget[ ulInsertAt ], 300U, 7U );
+    ulTargetSize += 300U;
+
+    /* Delete 1000 bytes near the end. */
+    memmove( &ucTarget[ 35000 ], &ucTarget[ 36000 ], ulTargetSize - 36000U );
+    ulTargetSize -= 1000U;
+
+    prvGeneratePatch();
+
+    TEST_ASSERT_TRUE( ulPatchSize < ( ulTargetSize / 20U ) );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_None, prvApplyPatch( BLOCK_SIZE ) );
+    prvCheckResult();
+}
+
+/**
+ * @brief Reordered sections of the base image are copied from where they moved.
+ */
+void test_OTA_Delta_MovedSections( void )
+{
+    memcpy( &ucTarget[ 0 ], &ucBase[ 20000 ], 20000U );
+    memcpy( &ucTarget[ 20000 ], &ucBase[ 0 ], 20000U );
+
+    prvGeneratePatch();
+
+    TEST_ASSERT_TRUE( ulPatchSize < 256U );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_None, prvApplyPatch( BLOCK_SIZE ) );
+    prvCheckResult();
+}
+
+/**
+ * @brief An unrelated image is sent as literal data and still applies.
+ */
+void test_OTA_Delta_UnrelatedImage( void )
+{
+    ulTargetSize = MAX_IMAGE_SIZE;
+    prvFillImage( ucTarget, ulTargetSize, 99U );
+
+    prvGeneratePatch();
+
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_None, prvApplyPatch( BLOCK_SIZE ) );
+    prvCheckResult();
+}
+
+/**
+ * @brief The patch may be split anywhere, including inside the header and commands.
+ */
+void test_OTA_Delta_AnyChunkSize( void )
+{
+    uint32_t ulChunk;
+
+    memmove( &ucTarget[ 1000 ], &ucTarget[ 1003 ], ulTargetSize - 1003U );
+    ulTargetSize -= 3U;
+    ucTarget[ 20000 ] = 0xAAU;
+
+    prvGeneratePatch();
+
+    for( ulChunk = 1U; ulChunk <= 17U; ulChunk++ )
+    {
+        TEST_ASSERT_EQUAL( eOTA_DeltaErr_None, prvApplyPatch( ulChunk ) );
+        prvCheckResult();
+    }
+}
+
+/*******************************************************************************
+ * Malformed patches and failures
+ ******************************************************************************/
+
+/**
+ * @brief Bad parameters are rejected.
+ */
+void test_OTA_Delta_BadParams( void )
+{
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadParams, OTA_Delta_Init( NULL, ucOutput, OUTPUT_SIZE, prvReadBase, prvWriteTarget, NULL ) );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadParams, OTA_Delta_Init( &xPatch, NULL, OUTPUT_SIZE, prvReadBase, prvWriteTarget, NULL ) );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadParams, OTA_Delta_Init( &xPatch, ucOutput, 0U, prvReadBase, prvWriteTarget, NULL ) );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadParams, OTA_Delta_Init( &xPatch, ucOutput, OUTPUT_SIZE, NULL, prvWriteTarget, NULL ) );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadParams, OTA_Delta_Init( &xPatch, ucOutput, OUTPUT_SIZE, prvReadBase, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadParams, OTA_Delta_Apply( NULL, ucPatch, 1U ) );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadParams, OTA_Delta_Finish( NULL ) );
+}
+
+/**
+ * @brief The magic and format version are checked.
+ */
+void test_OTA_Delta_BadHeader( void )
+{
+    prvGeneratePatch();
+    ucPatch[ 0 ] = 'X';
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadHeader, prvApplyPatch( BLOCK_SIZE ) );
+
+    prvPutHeader( OTA_DELTA_FORMAT_VERSION + 1U );
+    prvPutCopy( 0U, ulTargetSize );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadHeader, prvApplyPatch( BLOCK_SIZE ) );
+}
+
+/**
+ * @brief Unknown opcodes, copies outside the base image and commands that overrun the
+ * target image are rejected.
+ */
+void test_OTA_Delta_BadCommand( void )
+{
+    prvPutHeader( OTA_DELTA_FORMAT_VERSION );
+    ucPatch[ ulPatchSize++ ] = 0x7FU;
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadCommand, prvApplyPatch( BLOCK_SIZE ) );
+
+    prvPutHeader( OTA_DELTA_FORMAT_VERSION );
+    prvPutCopy( ulBaseSize - 10U, 20U );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadCommand, prvApplyPatch( BLOCK_SIZE ) );
+
+    prvPutHeader( OTA_DELTA_FORMAT_VERSION );
+    prvPutCopy( 0U, 0U );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadCommand, prvApplyPatch( BLOCK_SIZE ) );
+
+    ulTargetSize = 10U;
+    prvPutHeader( OTA_DELTA_FORMAT_VERSION );
+    prvPutInsert( ucTarget, 11U );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadCommand, prvApplyPatch( BLOCK_SIZE ) );
+}
+
+/**
+ * @brief A truncated patch is reported at finish and extra data is rejected.
+ */
+void test_OTA_Delta_TruncatedAndTrailing( void )
+{
+    uint32_t ulFullSize;
+
+    ucTarget[ 3000 ] ^= 0x01U;
+    prvGeneratePatch();
+    ulFullSize = ulPatchSize;
+
+    ulPatchSize = ulFullSize - 1U;
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_Incomplete, prvApplyPatch( BLOCK_SIZE ) );
+
+    ulPatchSize = OTA_DELTA_HEADER_SIZE - 1U;
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_Incomplete, prvApplyPatch( BLOCK_SIZE ) );
+
+    ulPatchSize = ulFullSize + 1U;
+    ucPatch[ ulFullSize ] = OTA_DELTA_OP_COPY;
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_TrailingData, prvApplyPatch( BLOCK_SIZE ) );
+}
+
+/**
+ * @brief Base image read and target image write failures are reported.
+ */
+void test_OTA_Delta_ReadAndWriteFailures( void )
+{
+    prvGeneratePatch();
+
+    bFailReads = true;
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_ReadBaseFailed, prvApplyPatch( BLOCK_SIZE ) );
+
+    bFailReads = false;
+    bFailWrites = true;
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_WriteFailed, prvApplyPatch( BLOCK_SIZE ) );
+}
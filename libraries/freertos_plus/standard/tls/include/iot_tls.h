@@ -46,6 +46,129 @@
 
 /**@} */
 
+/**
+ * @brief Number of TLS sessions kept for resumption.
+ *
+ * After a successful handshake the session is cached under the server name
+ * and port, the ALPN protocols, the trusted server certificate and the client
+ * certificate that were used. The next connection with the same parameters
+ * offers it back to the server, and if the server accepts, the abbreviated
+ * handshake skips the certificate exchange and the private key signature.
+ * Each entry holds a copy of the server certificate, so the cache costs a few
+ * kilobytes of heap per entry. Off by default. To resume the session tickets
+ * most servers issue, also define MBEDTLS_SSL_SESSION_TICKETS in the mbedTLS
+ * configuration; without it only session IDs are resumed.
+ */
+#ifndef tlsconfigSESSION_CACHE_ENTRIES
+    #define tlsconfigSESSION_CACHE_ENTRIES    ( 0 )
+#endif
+
+/**
+ * @brief Seconds a cached TLS session is offered for resumption.
+ *
+ * A shorter session ticket lifetime announced by the server takes precedence.
+ */
+#ifndef tlsconfigSESSION_CACHE_LIFETIME_S
+    #define tlsconfigSESSION_CACHE_LIFETIME_S    ( 3600UL )
+#endif
+
+/**
+ * @brief Number of parsed root certificate chains shared between connections.
+ *
+ * The default root certificates, or a server certificate set with
+ * pcServerCertificate, are parsed once into a shared trust store and reused
+ * read-only by every later handshake that trusts the same certificates. A
+ * store stays parsed while no handshake uses it, until it is needed for other
+ * certificates, trading a few kilobytes of heap for skipping the PEM decode and
+ * ASN.1 parse on each connection. When every store is in use for other
+ * certificates, the handshake parses its own copy. Set to 0 to parse the
+ * certificates for each connection.
+ */
+#ifndef tlsconfigTRUST_STORE_ENTRIES
+    #define tlsconfigTRUST_STORE_ENTRIES    ( 2 )
+#endif
+
+/**
+ * @brief Keep the client credentials read from PKCS #11 between connections.
+ *
+ * The device certificate, any JITR issuer certificate and the handle of the
+ * device private key are looked up and parsed by the first handshake, then
+ * shared read-only by later handshakes until TLS_InvalidateClientCredential is
+ * called. Each handshake checks that the device private key and certificate
+ * objects in PKCS #11 are still the ones the credentials were read from, so
+ * objects replaced without calling it are read again as well. Set to 0 to read
+ * the credentials for each connection.
+ */
+#ifndef tlsconfigCLIENT_CREDENTIAL_CACHE
+    #define tlsconfigCLIENT_CREDENTIAL_CACHE    ( 1 )
+#endif
+
+/**
+ * @brief Request the RFC 6066 maximum fragment length extension.
+ *
+ * When set to 1 and the incoming record buffer, sized by
+ * MBEDTLS_SSL_IN_CONTENT_LEN or MBEDTLS_SSL_MAX_CONTENT_LEN, is smaller than
+ * the 16 KB records a server may send, the handshake asks for the largest
+ * fragment length that fits the buffer. Servers that do not support the
+ * extension may abort the handshake, so it is off by default and should only
+ * be enabled with record buffers reduced to 4096 bytes or less.
+ */
+#ifndef tlsconfigMAX_FRAGMENT_LENGTH_REQUEST
+    #define tlsconfigMAX_FRAGMENT_LENGTH_REQUEST    ( 0 )
+#endif
+
+/**
+ * @brief Collect handshake and traffic statistics for each TLS context.
+ *
+ * Handshake timings are taken once per handshake step and traffic is counted
+ * in the network callbacks, so the cost is a few additions per record. The
+ * statistics are read with TLS_GetStatistics. Off by default.
+ *
+ * @warning The timings are only as fine as tlsconfigSTATISTICS_TIME_US, which
+ * defaults to the tick count. Ports enabling the statistics should define it
+ * with a microsecond clock, or steps shorter than a tick are reported as 0.
+ */
+#ifndef tlsconfigSTATISTICS
+    #define tlsconfigSTATISTICS    ( 0 )
+#endif
+
+/**
+ * @brief Number of servers for which connection statistics are summarized.
+ *
+ * Each TLS context adds its statistics to the entry for its server name when
+ * it is cleaned up, evicting the least recently used server when the table is
+ * full. The summary is read with TLS_GetEndpointStatistics. Set to 0 to keep
+ * only the statistics of each context.
+ */
+#ifndef tlsconfigSTATISTICS_ENDPOINTS
+    #define tlsconfigSTATISTICS_ENDPOINTS    ( 4 )
+#endif
+
+/**
+ * @brief Bytes kept of a server name in the endpoint statistics, including
+ * the terminating NUL.
+ *
+ * Longer names are truncated. Entries are matched on a hash of the full name.
+ */
+#ifndef tlsconfigSTATISTICS_NAME_LENGTH
+    #define tlsconfigSTATISTICS_NAME_LENGTH    ( 64 )
+#endif
+
+/**
+ * @brief Free running microsecond clock used for the TLS statistics.
+ *
+ * Only differences are used, so the clock may wrap.
+ *
+ * @warning The default is the tick count scaled to microseconds, so every
+ * duration is a whole number of tick periods: 1000 us at a 1000 Hz tick. Most
+ * handshake steps other than the key exchange take less than a tick and read
+ * as 0 or one tick. Define this with a cycle counter or hardware timer, for
+ * example the DWT cycle counter divided by the core clock in MHz on Cortex-M.
+ */
+#ifndef tlsconfigSTATISTICS_TIME_US
+    #define tlsconfigSTATISTICS_TIME_US()    ( ( uint32_t ) xTaskGetTickCount() * ( 1000000UL / configTICK_RATE_HZ ) )
+#endif
+
 /**
  * @brief Defines callback type for receiving bytes from the network.
  *
@@ -53,7 +176,8 @@
  * @param[out] pucReceiveBuffer Buffer to fill with received data.
  * @param[in] xReceiveLength Length of previous parameter in bytes.
  *
- * @return The number of bytes actually read.
+ * @return The number of bytes actually read, or -pdFREERTOS_ERRNO_EWOULDBLOCK
+ * if the connection is non-blocking and no data is available.
  */
 typedef BaseType_t ( * NetworkRecv_t )( void * pvCallerContext,
                                         unsigned char * pucReceiveBuffer,
@@ -66,7 +190,8 @@ typedef BaseType_t ( * NetworkRecv_t )( void * pvCallerContext,
  * @param[out] pucReceiveBuffer Buffer of data to send.
  * @param[in] xReceiveLength Length of previous parameter in bytes.
  *
- * @return The number of bytes actually sent.
+ * @return The number of bytes actually sent, or -pdFREERTOS_ERRNO_EWOULDBLOCK
+ * if the connection is non-blocking and nothing could be sent.
  */
 typedef BaseType_t ( * NetworkSend_t )( void * pvCallerContext,
                                         const unsigned char * pucData,
@@ -84,6 +209,10 @@ typedef BaseType_t ( * NetworkSend_t )( void * pvCallerContext,
  * @param[in] pxNetworkSend Caller-defined network send function pointer.
  * @param[in] pvCallerContext Caller-defined context handle to be used with callback
  * functions.
+ * @param[in] xDisableSessionCache pdTRUE to neither resume a cached session nor
+ * cache the session of this connection.
+ * @param[in] usPort Port of the TLS server, as in SocketsSockaddr_t. Sessions
+ * are only resumed with the port they were negotiated on.
  */
 typedef struct xTLS_PARAMS
 {
@@ -97,8 +226,104 @@ typedef struct xTLS_PARAMS
     NetworkRecv_t pxNetworkRecv;
     NetworkSend_t pxNetworkSend;
     void * pvCallerContext;
+    BaseType_t xDisableSessionCache;
+    uint16_t usPort;
 } TLSParams_t;
 
+/**
+ * @brief Handshake costs and traffic of one TLS context.
+ *
+ * Durations are in microseconds as measured by tlsconfigSTATISTICS_TIME_US,
+ * in whole tick periods unless the port defines it.
+ * Wire counts include the record headers, padding and MACs, so the record
+ * layer overhead is the difference to the application counts. mbedTLS uses
+ * fixed size record buffers, so their peak use is given by the largest record
+ * seen in each direction.
+ *
+ * @param[out] ulSetupUs Time to load the trust store and client credentials.
+ * @param[out] ulHandshakeUs Time from the ClientHello to the end of the
+ * handshake.
+ * @param[out] ulHelloUs Part of ulHandshakeUs spent on the hello messages.
+ * @param[out] ulServerAuthUs Part of ulHandshakeUs spent on the server
+ * certificate and key exchange.
+ * @param[out] ulClientAuthUs Part of ulHandshakeUs spent on the client
+ * certificate and key exchange.
+ * @param[out] ulFinishedUs Part of ulHandshakeUs spent on the change cipher
+ * spec and finished messages.
+ * @param[out] ulNetworkWaitUs Part of ulHandshakeUs spent receiving from the
+ * network.
+ * @param[out] ulVerifyUs Part of ulServerAuthUs not spent receiving, mostly
+ * verifying the server certificate and key exchange signature.
+ * @param[out] ulSignUs Time spent signing with the device private key.
+ * @param[out] ulBytesSent Bytes written to the network.
+ * @param[out] ulBytesReceived Bytes read from the network.
+ * @param[out] ulAppBytesSent Application bytes accepted by TLS_Send.
+ * @param[out] ulAppBytesReceived Application bytes returned by TLS_Recv.
+ * @param[out] ulRecordsSent Records written, including handshake records.
+ * @param[out] ulRecordsReceived Records read, including handshake records.
+ * @param[out] usPeakRecordSent Largest record written, including its header.
+ * @param[out] usPeakRecordReceived Largest record read, including its header.
+ * @param[out] xResumed pdTRUE if the handshake resumed a cached session.
+ */
+typedef struct xTLS_STATISTICS
+{
+    uint32_t ulSetupUs;
+    uint32_t ulHandshakeUs;
+    uint32_t ulHelloUs;
+    uint32_t ulServerAuthUs;
+    uint32_t ulClientAuthUs;
+    uint32_t ulFinishedUs;
+    uint32_t ulNetworkWaitUs;
+    uint32_t ulVerifyUs;
+    uint32_t ulSignUs;
+
+    uint32_t ulBytesSent;
+    uint32_t ulBytesReceived;
+    uint32_t ulAppBytesSent;
+    uint32_t ulAppBytesReceived;
+    uint32_t ulRecordsSent;
+    uint32_t ulRecordsReceived;
+    uint16_t usPeakRecordSent;
+    uint16_t usPeakRecordReceived;
+
+    BaseType_t xResumed;
+} TLSStatistics_t;
+
+/**
+ * @brief Statistics of all the TLS contexts that connected to one server.
+ *
+ * Handshake figures are added when TLS_Connect returns, traffic when the
+ * context is cleaned up. Fields have the meaning of the TLSStatistics_t
+ * fields they add up.
+ *
+ * @param[out] cDestination Server name, possibly truncated.
+ * @param[out] ulHandshakes Handshakes attempted.
+ * @param[out] ulFailures Handshakes that failed.
+ * @param[out] ulResumed Handshakes that resumed a cached session.
+ * @param[out] ulHandshakeMaxUs Longest handshake.
+ */
+typedef struct xTLS_ENDPOINT_STATISTICS
+{
+    char cDestination[ tlsconfigSTATISTICS_NAME_LENGTH ];
+    uint32_t ulHandshakes;
+    uint32_t ulFailures;
+    uint32_t ulResumed;
+    uint32_t ulHandshakeMaxUs;
+    uint64_t ullHandshakeUs;
+    uint64_t ullNetworkWaitUs;
+    uint64_t ullVerifyUs;
+    uint64_t ullSignUs;
+
+    uint64_t ullBytesSent;
+    uint64_t ullBytesReceived;
+    uint64_t ullAppBytesSent;
+    uint64_t ullAppBytesReceived;
+    uint32_t ulRecordsSent;
+    uint32_t ulRecordsReceived;
+    uint16_t usPeakRecordSent;
+    uint16_t usPeakRecordReceived;
+} TLSEndpointStatistics_t;
+
 /**
  * @brief Initializes the TLS context.
  *
@@ -127,7 +352,9 @@ BaseType_t TLS_Connect( void * pvContext );
  * network.
  * @param xReadLength Length in bytes of read buffer.
  *
- * @return Number of bytes read. Error return codes have the high bit set.
+ * @return Number of bytes read. -pdFREERTOS_ERRNO_EWOULDBLOCK if the network
+ * receive callback would block before any data was read; the context can still
+ * be used. Other error return codes have the high bit set.
  */
 BaseType_t TLS_Recv( void * pvContext,
                      unsigned char * pucReadBuffer,
@@ -140,12 +367,27 @@ BaseType_t TLS_Recv( void * pvContext,
  * @param pucMsg Byte array of data to be encrypted and then sent to the network.
  * @param xMsgLength Length in bytes of write buffer.
  *
- * @return Number of bytes read. Error return codes have the high bit set.
+ * @return Number of bytes written. -pdFREERTOS_ERRNO_EWOULDBLOCK if the network
+ * send callback would block before any data was written; the call must then be
+ * repeated with the same data. Other error return codes have the high bit set.
  */
 BaseType_t TLS_Send( void * pvContext,
                      const unsigned char * pucMsg,
                      size_t xMsgLength );
 
+/**
+ * @brief Checks whether received data is buffered in the TLS context.
+ *
+ * Such data can be read with TLS_Recv() even if nothing more arrives from the
+ * network, so callers waiting for the network to become readable must check
+ * this first.
+ *
+ * @param pvContext Opaque context handle for TLS library.
+ *
+ * @return pdTRUE if data is buffered, pdFALSE otherwise.
+ */
+BaseType_t TLS_Pending( void * pvContext );
+
 /**
  * @brief Frees resources consumed by the TLS context.
  *
@@ -153,4 +395,79 @@ BaseType_t TLS_Send( void * pvContext,
  */
 void TLS_Cleanup( void * pvContext );
 
+/**
+ * @brief Discards all TLS sessions cached for resumption.
+ *
+ * Sessions are bound to the client certificate they were negotiated with, so
+ * this is only needed when a server must see a full handshake again, e.g. after
+ * the device credentials were revoked on the server side.
+ */
+void TLS_FlushSessionCache( void );
+
+/**
+ * @brief Discards the cached client certificate and private key handle.
+ *
+ * Called by xProvisionDevice after it creates or destroys the device
+ * certificate, private key or JITR certificate objects, so that the next
+ * handshake reads the new credentials. Handshakes notice a replaced device
+ * certificate or private key on their own, but a JITR certificate replaced
+ * through PKCS #11 directly needs this call. Handshakes in progress keep using
+ * the credentials they started with.
+ */
+void TLS_InvalidateClientCredential( void );
+
+/**
+ * @brief Loads the trusted server certificates and the client credentials
+ * ahead of a handshake.
+ *
+ * Meant to be called from another task while the connecting task resolves the
+ * server name and opens the TCP connection, so that the handshake finds the
+ * certificates parsed and the private key handle read. A handshake starting
+ * while they are loaded waits for them instead of loading them again. Nothing
+ * is loaded if tlsconfigTRUST_STORE_ENTRIES and tlsconfigCLIENT_CREDENTIAL_CACHE
+ * are both 0, as every handshake then loads its own.
+ *
+ * @param pcServerCertificate The trusted server certificates the handshake will
+ * use, or NULL for the default root certificates.
+ * @param ulServerCertificateLength Length of pcServerCertificate.
+ *
+ * @return CKR_OK (0) on success, or the error that the handshake would have
+ * failed with.
+ */
+BaseType_t TLS_Prepare( const char * pcServerCertificate,
+                        uint32_t ulServerCertificateLength );
+
+/**
+ * @brief Reads the handshake costs and traffic of a TLS context.
+ *
+ * The statistics are kept until the context is cleaned up, so they can be read
+ * after a failed handshake.
+ *
+ * @param pvContext Opaque context handle for TLS library.
+ * @param pxStatistics Receives the statistics.
+ *
+ * @return pdPASS on success, pdFAIL if the arguments are invalid or
+ * tlsconfigSTATISTICS is 0.
+ */
+BaseType_t TLS_GetStatistics( void * pvContext,
+                              TLSStatistics_t * pxStatistics );
+
+/**
+ * @brief Reads the statistics summarized for each server.
+ *
+ * @param pxEndpoints Receives up to xMaxEndpoints entries.
+ * @param xMaxEndpoints Number of entries pxEndpoints can hold.
+ *
+ * @return The number of entries written to pxEndpoints.
+ */
+size_t TLS_GetEndpointStatistics( TLSEndpointStatistics_t * pxEndpoints,
+                                  size_t xMaxEndpoints );
+
+/**
+ * @brief Discards the statistics summarized for each server.
+ *
+ * Useful to report the statistics for fixed intervals.
+ */
+void TLS_ResetEndpointStatistics( void );
+
 #endif /* ifndef __AWS__TLS__H__ */
@@ -31,6 +31,7 @@
 #include "iot_pkcs11_config.h"
 #include "iot_pkcs11.h"
 #include "task.h"
+#include "semphr.h"
 #include "aws_clientcredential_keys.h"
 #include "iot_default_root_certificates.h"
 #include "iot_pki_utils.h"
@@ -86,6 +87,86 @@ static const char * pNoLowLevelMbedTlsCodeStr = "<No-Low-Level-Code>";
     mbedtls_strerror_lowlevel( mbedTlsCode ) : pNoLowLevelMbedTlsCodeStr
 
 
+/**
+ * @brief Length of the SHA-256 hashes that cached sessions and trust stores
+ * are looked up by.
+ */
+#define tlsHASH_LENGTH    32
+
+/**
+ * @brief Whether statistics are summarized for each server.
+ */
+#define tlsENDPOINT_STATISTICS    ( ( tlsconfigSTATISTICS == 1 ) && ( tlsconfigSTATISTICS_ENDPOINTS > 0 ) )
+
+/**
+ * @brief Whether the TLS contexts share any state, and so need a lock.
+ */
+#define tlsSHARED_STATE                                                          \
+    ( ( tlsconfigSESSION_CACHE_ENTRIES > 0 ) || ( tlsconfigTRUST_STORE_ENTRIES > 0 ) || \
+      ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 ) || tlsENDPOINT_STATISTICS )
+
+/**
+ * @brief Length of the header in front of each TLS record.
+ */
+#define tlsRECORD_HEADER_LENGTH    5
+
+/**
+ * @brief Root certificates parsed once and shared read-only by all handshakes
+ * that trust them.
+ *
+ * @param[in] xParsed Whether xChain holds the parsed certificates.
+ * @param[in] ucKey Hash of the PEM certificates, all zero for the default roots.
+ * @param[in] ulRefCount Number of handshakes currently using xChain.
+ * @param[in] xChain Parsed certificate chain.
+ */
+typedef struct TLSTrustStore
+{
+    BaseType_t xParsed;
+    unsigned char ucKey[ tlsHASH_LENGTH ];
+    uint32_t ulRefCount;
+    mbedtls_x509_crt xChain;
+} TLSTrustStore_t;
+
+/**
+ * @brief Client credentials read from PKCS #11 once and shared read-only by
+ * all handshakes.
+ *
+ * @param[in] xLoaded Whether the credentials were read.
+ * @param[in] xStale Whether the credentials were invalidated while in use.
+ * @param[in] ulRefCount Number of handshakes currently using the credentials.
+ * @param[in] xP11PrivateKey PKCS #11 handle of the device private key.
+ * @param[in] xP11Certificate PKCS #11 handle of the device certificate.
+ * @param[in] xKeyType PKCS #11 type of the device private key.
+ * @param[in] xChain Device certificate, followed by any JITR issuer certificate.
+ */
+typedef struct TLSClientCredential
+{
+    BaseType_t xLoaded;
+    BaseType_t xStale;
+    uint32_t ulRefCount;
+    CK_OBJECT_HANDLE xP11PrivateKey;
+    CK_OBJECT_HANDLE xP11Certificate;
+    CK_KEY_TYPE xKeyType;
+    mbedtls_x509_crt xChain;
+} TLSClientCredential_t;
+
+#if ( tlsconfigSTATISTICS == 1 )
+
+/**
+ * @brief Follows the record boundaries in one direction of the byte stream.
+ *
+ * @param[in] ucHeader Bytes of the next record header seen so far.
+ * @param[in] xHeaderLength Number of bytes in ucHeader.
+ * @param[in] xBodyRemaining Bytes of the current record body still to come.
+ */
+    typedef struct TLSRecordCounter
+    {
+        uint8_t ucHeader[ tlsRECORD_HEADER_LENGTH ];
+        size_t xHeaderLength;
+        size_t xBodyRemaining;
+    } TLSRecordCounter_t;
+#endif
+
 /**
  * @brief Internal context structure.
  *
@@ -96,18 +177,38 @@ static const char * pNoLowLevelMbedTlsCodeStr = "<No-Low-Level-Code>";
  * @param[in] xNetworkSend Callback for sending data on an open TCP socket.
  * @param[in] pvCallerContext Opaque pointer provided by caller for above callbacks.
  * @param[out] xTLSHandshakeState Indicates the state of the TLS handshake.
+ * @param[out] xNetworkWouldBlock Set when a network callback could not transfer
+ * data without blocking.
  * @param[out] xMbedSslCtx Connection context for mbedTLS.
  * @param[out] xMbedSslConfig Configuration context for mbedTLS.
- * @param[out] xMbedX509CA Server certificate context for mbedTLS.
- * @param[out] xMbedX509Cli Client certificate context for mbedTLS.
+ * @param[out] xMbedX509CA Server certificate context for mbedTLS, used when no
+ * shared trust store is available.
+ * @param[out] pxTrustStore Shared trust store used by the handshake, or NULL.
+ * @param[out] pxMbedX509CA Trusted certificate chain used by the handshake.
+ * @param[out] xMbedX509Cli Client certificate context for mbedTLS, used when
+ * the shared client credentials are not available.
+ * @param[out] pxClientCredential Shared client credentials used by the
+ * handshake, or NULL.
+ * @param[out] pxMbedX509Cli Client certificate chain used by the handshake.
  * @param[out] mbedPkAltCtx RSA crypto implementation context for mbedTLS.
  * @param[out] pxP11FunctionList PKCS#11 function list structure.
  * @param[out] xP11Session PKCS#11 session context.
  * @param[out] xP11PrivateKey PKCS#11 private key context.
+ * @param[in] xSessionCache Whether the connection resumes and caches sessions.
+ * @param[out] ucSessionKey Hash of the parameters the cached session is bound to.
+ * @param[out] xSessionOffered Whether a cached session was offered to the server.
+ * @param[out] xStatistics Handshake costs and traffic of the connection.
+ * @param[out] xRecordsSent Record boundaries of the bytes sent.
+ * @param[out] xRecordsReceived Record boundaries of the bytes received.
+ * @param[out] ulEndpointHash Hash of the server name the statistics are
+ * summarized under.
+ * @param[out] xEndpointCounted Whether the handshake was added to the summary
+ * of the server.
  */
 typedef struct TLSContext
 {
     const char * pcDestination;
+    uint16_t usPort;
     const char * pcServerCertificate;
     uint32_t ulServerCertificateLength;
     const char ** ppcAlpnProtocols;
@@ -117,12 +218,17 @@ typedef struct TLSContext
     NetworkSend_t xNetworkSend;
     void * pvCallerContext;
     BaseType_t xTLSHandshakeState;
+    BaseType_t xNetworkWouldBlock;
 
     /* mbedTLS. */
     mbedtls_ssl_context xMbedSslCtx;
     mbedtls_ssl_config xMbedSslConfig;
     mbedtls_x509_crt xMbedX509CA;
+    TLSTrustStore_t * pxTrustStore;
+    mbedtls_x509_crt * pxMbedX509CA;
     mbedtls_x509_crt xMbedX509Cli;
+    TLSClientCredential_t * pxClientCredential;
+    mbedtls_x509_crt * pxMbedX509Cli;
     mbedtls_pk_context xMbedPkCtx;
     mbedtls_pk_info_t xMbedPkInfo;
     mbedtls_ctr_drbg_context xMbedDrbgCtx;
@@ -132,6 +238,22 @@ typedef struct TLSContext
     CK_SESSION_HANDLE xP11Session;
     CK_OBJECT_HANDLE xP11PrivateKey;
     CK_KEY_TYPE xKeyType;
+
+    /* Session resumption. */
+    BaseType_t xSessionCache;
+    unsigned char ucSessionKey[ tlsHASH_LENGTH ];
+    BaseType_t xSessionOffered;
+
+    /* Statistics. */
+    #if ( tlsconfigSTATISTICS == 1 )
+        TLSStatistics_t xStatistics;
+        TLSRecordCounter_t xRecordsSent;
+        TLSRecordCounter_t xRecordsReceived;
+    #endif
+    #if tlsENDPOINT_STATISTICS
+        uint32_t ulEndpointHash;
+        BaseType_t xEndpointCounted;
+    #endif
 } TLSContext_t;
 
 #define TLS_HANDSHAKE_NOT_STARTED    ( 0 )      /* Must be 0 */
@@ -140,6 +262,105 @@ typedef struct TLSContext
 
 #define TLS_PRINT( X )    configPRINTF( X )
 
+/**
+ * @brief Maximum fragment length requested from the server.
+ *
+ * A server may send records of up to 16 KB, which do not fit an incoming
+ * record buffer made smaller through MBEDTLS_SSL_IN_CONTENT_LEN or
+ * MBEDTLS_SSL_MAX_CONTENT_LEN. When tlsconfigMAX_FRAGMENT_LENGTH_REQUEST is
+ * enabled, the largest RFC 6066 fragment length that fits the buffer is
+ * requested, so that both buffers can be sized down to 4 KB or less on devices
+ * with little heap.
+ */
+#if ( tlsconfigMAX_FRAGMENT_LENGTH_REQUEST == 0 ) || !defined( MBEDTLS_SSL_MAX_FRAGMENT_LENGTH ) || \
+    ( MBEDTLS_SSL_IN_CONTENT_LEN >= 16384 )
+    #define tlsMAX_FRAGMENT_LENGTH    MBEDTLS_SSL_MAX_FRAG_LEN_NONE
+#elif ( MBEDTLS_SSL_IN_CONTENT_LEN >= 4096 )
+    #define tlsMAX_FRAGMENT_LENGTH    MBEDTLS_SSL_MAX_FRAG_LEN_4096
+#elif ( MBEDTLS_SSL_IN_CONTENT_LEN >= 2048 )
+    #define tlsMAX_FRAGMENT_LENGTH    MBEDTLS_SSL_MAX_FRAG_LEN_2048
+#elif ( MBEDTLS_SSL_IN_CONTENT_LEN >= 1024 )
+    #define tlsMAX_FRAGMENT_LENGTH    MBEDTLS_SSL_MAX_FRAG_LEN_1024
+#else
+    #define tlsMAX_FRAGMENT_LENGTH    MBEDTLS_SSL_MAX_FRAG_LEN_512
+#endif
+
+#if ( tlsconfigSESSION_CACHE_ENTRIES > 0 )
+
+/**
+ * @brief A TLS session kept for resuming a later connection.
+ *
+ * @param[in] xInUse Whether the entry holds a session.
+ * @param[in] ucKey Hash of the connection parameters the session is bound to.
+ * @param[in] xSavedTime Tick count at which the session was first negotiated.
+ * @param[in] xLifetime Ticks after xSavedTime for which the session is offered.
+ * @param[in] xSession mbedTLS session state.
+ */
+    typedef struct TLSSessionCacheEntry
+    {
+        BaseType_t xInUse;
+        unsigned char ucKey[ tlsHASH_LENGTH ];
+        TickType_t xSavedTime;
+        TickType_t xLifetime;
+        mbedtls_ssl_session xSession;
+    } TLSSessionCacheEntry_t;
+
+/**
+ * @brief Sessions shared by all TLS contexts, guarded by xSharedStateLock.
+ */
+    static TLSSessionCacheEntry_t xSessionCache[ tlsconfigSESSION_CACHE_ENTRIES ];
+#endif /* if ( tlsconfigSESSION_CACHE_ENTRIES > 0 ) */
+
+#if ( tlsconfigTRUST_STORE_ENTRIES > 0 )
+
+/**
+ * @brief Trust stores shared by all TLS contexts, guarded by xSharedStateLock.
+ */
+    static TLSTrustStore_t xTrustStores[ tlsconfigTRUST_STORE_ENTRIES ];
+#endif /* if ( tlsconfigTRUST_STORE_ENTRIES > 0 ) */
+
+#if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 )
+
+/**
+ * @brief Client credentials shared by all TLS contexts, guarded by
+ * xSharedStateLock.
+ */
+    static TLSClientCredential_t xClientCredential;
+#endif
+
+#if tlsENDPOINT_STATISTICS
+
+/**
+ * @brief Statistics summarized for one server.
+ *
+ * @param[in] xInUse Whether the entry holds statistics.
+ * @param[in] ulHash Hash of the full server name.
+ * @param[in] xLastUsed Tick count at which a handshake was last added.
+ * @param[in] xStatistics The summary.
+ */
+    typedef struct TLSEndpointEntry
+    {
+        BaseType_t xInUse;
+        uint32_t ulHash;
+        TickType_t xLastUsed;
+        TLSEndpointStatistics_t xStatistics;
+    } TLSEndpointEntry_t;
+
+/**
+ * @brief Statistics summarized for each server, guarded by xSharedStateLock.
+ */
+    static TLSEndpointEntry_t xEndpoints[ tlsconfigSTATISTICS_ENDPOINTS ];
+#endif /* if tlsENDPOINT_STATISTICS */
+
+#if tlsSHARED_STATE
+
+/**
+ * @brief Lock guarding the state shared by all TLS contexts.
+ */
+    static SemaphoreHandle_t xSharedStateLock = NULL;
+    static StaticSemaphore_t xSharedStateLockBuffer;
+#endif
+
 /*-----------------------------------------------------------*/
 
 /*
@@ -176,6 +397,120 @@ static void prvFreeContext( TLSContext_t * pxCtx )
 
 /*-----------------------------------------------------------*/
 
+#if ( tlsconfigSTATISTICS == 1 )
+
+/**
+ * @brief Counts the records that start in a block of the byte stream.
+ *
+ * Only the record headers are looked at, so the cost does not depend on the
+ * record sizes.
+ *
+ * @param[in] pxCounter Record boundaries of the byte stream.
+ * @param[in] pucData Next bytes of the stream.
+ * @param[in] xDataLength Number of bytes in pucData.
+ * @param[out] pulRecords Incremented for each record header completed.
+ * @param[out] pusPeakRecord Updated with the largest record length seen.
+ */
+    static void prvStatisticsCountRecords( TLSRecordCounter_t * pxCounter,
+                                           const unsigned char * pucData,
+                                           size_t xDataLength,
+                                           uint32_t * pulRecords,
+                                           uint16_t * pusPeakRecord )
+    {
+        size_t xSkip = 0;
+        size_t xRecordLength = 0;
+
+        while( xDataLength > 0U )
+        {
+            if( pxCounter->xBodyRemaining > 0U )
+            {
+                /* Skip over the record body. */
+                xSkip = ( xDataLength < pxCounter->xBodyRemaining ) ? xDataLength : pxCounter->xBodyRemaining;
+                pxCounter->xBodyRemaining -= xSkip;
+                pucData += xSkip;
+                xDataLength -= xSkip;
+            }
+            else
+            {
+                pxCounter->ucHeader[ pxCounter->xHeaderLength ] = *pucData;
+                pxCounter->xHeaderLength++;
+                pucData++;
+                xDataLength--;
+
+                if( tlsRECORD_HEADER_LENGTH == pxCounter->xHeaderLength )
+                {
+                    /* The last two header bytes hold the body length. */
+                    xRecordLength = ( ( size_t ) pxCounter->ucHeader[ 3 ] << 8 ) | pxCounter->ucHeader[ 4 ];
+                    pxCounter->xBodyRemaining = xRecordLength;
+                    pxCounter->xHeaderLength = 0;
+
+                    xRecordLength += tlsRECORD_HEADER_LENGTH;
+                    ( *pulRecords )++;
+
+                    if( xRecordLength > *pusPeakRecord )
+                    {
+                        *pusPeakRecord = ( uint16_t ) xRecordLength;
+                    }
+                }
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Adds the duration of a handshake step to its phase.
+ *
+ * @param[in] pxCtx Caller TLS context.
+ * @param[in] lState Handshake state the step started in.
+ * @param[in] ulStepUs Duration of the step.
+ * @param[in] ulNetworkWaitUs Part of ulStepUs spent receiving.
+ */
+    static void prvStatisticsHandshakeStep( TLSContext_t * pxCtx,
+                                            int lState,
+                                            uint32_t ulStepUs,
+                                            uint32_t ulNetworkWaitUs )
+    {
+        TLSStatistics_t * pxStatistics = &pxCtx->xStatistics;
+
+        switch( lState )
+        {
+            case MBEDTLS_SSL_HELLO_REQUEST:
+            case MBEDTLS_SSL_CLIENT_HELLO:
+            case MBEDTLS_SSL_SERVER_HELLO:
+                pxStatistics->ulHelloUs += ulStepUs;
+                break;
+
+            case MBEDTLS_SSL_SERVER_CERTIFICATE:
+                /* A resumed session goes from the ServerHello straight to
+                 * the change cipher spec. */
+                pxStatistics->xResumed = pdFALSE;
+                pxStatistics->ulServerAuthUs += ulStepUs;
+                pxStatistics->ulVerifyUs += ulStepUs - ulNetworkWaitUs;
+                break;
+
+            case MBEDTLS_SSL_SERVER_KEY_EXCHANGE:
+            case MBEDTLS_SSL_CERTIFICATE_REQUEST:
+            case MBEDTLS_SSL_SERVER_HELLO_DONE:
+                pxStatistics->ulServerAuthUs += ulStepUs;
+                pxStatistics->ulVerifyUs += ulStepUs - ulNetworkWaitUs;
+                break;
+
+            case MBEDTLS_SSL_CLIENT_CERTIFICATE:
+            case MBEDTLS_SSL_CLIENT_KEY_EXCHANGE:
+            case MBEDTLS_SSL_CERTIFICATE_VERIFY:
+                pxStatistics->ulClientAuthUs += ulStepUs;
+                break;
+
+            default:
+                pxStatistics->ulFinishedUs += ulStepUs;
+                break;
+        }
+    }
+#endif /* if ( tlsconfigSTATISTICS == 1 ) */
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Network send callback shim.
  *
@@ -183,15 +518,36 @@ static void prvFreeContext( TLSContext_t * pxCtx )
  * @param[in] pucData Byte buffer to send.
  * @param[in] xDataLength Length of byte buffer to send.
  *
- * @return Number of bytes sent, or a negative value on error.
+ * @return Number of bytes sent, MBEDTLS_ERR_SSL_WANT_WRITE if the socket is
+ * non-blocking and full, or a negative value on error.
  */
 static int prvNetworkSend( void * pvContext,
                            const unsigned char * pucData,
                            size_t xDataLength )
 {
     TLSContext_t * pxCtx = ( TLSContext_t * ) pvContext; /*lint !e9087 !e9079 Allow casting void* to other types. */
+    int xResult = ( int ) pxCtx->xNetworkSend( pxCtx->pvCallerContext, pucData, xDataLength );
+
+    #if ( tlsconfigSTATISTICS == 1 )
+        if( xResult > 0 )
+        {
+            pxCtx->xStatistics.ulBytesSent += ( uint32_t ) xResult;
+            prvStatisticsCountRecords( &pxCtx->xRecordsSent,
+                                       pucData,
+                                       ( size_t ) xResult,
+                                       &pxCtx->xStatistics.ulRecordsSent,
+                                       &pxCtx->xStatistics.usPeakRecordSent );
+        }
+    #endif
+
+    /* mbedTLS keeps the unsent part of the record for the next write. */
+    if( -pdFREERTOS_ERRNO_EWOULDBLOCK == xResult )
+    {
+        pxCtx->xNetworkWouldBlock = pdTRUE;
+        xResult = MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
 
-    return ( int ) pxCtx->xNetworkSend( pxCtx->pvCallerContext, pucData, xDataLength );
+    return xResult;
 }
 
 /*-----------------------------------------------------------*/
@@ -203,15 +559,55 @@ static int prvNetworkSend( void * pvContext,
  * @param[out] pucReceiveBuffer Byte buffer to receive into.
  * @param[in] xReceiveLength Length of byte buffer for receive.
  *
- * @return Number of bytes received, or a negative value on error.
+ * @return Number of bytes received, MBEDTLS_ERR_SSL_WANT_READ if the socket is
+ * non-blocking and empty, or a negative value on error.
  */
 static int prvNetworkRecv( void * pvContext,
                            unsigned char * pucReceiveBuffer,
                            size_t xReceiveLength )
 {
     TLSContext_t * pxCtx = ( TLSContext_t * ) pvContext; /*lint !e9087 !e9079 Allow casting void* to other types. */
+    int xResult = 0;
+
+    #if ( tlsconfigSTATISTICS == 1 )
+        uint32_t ulStartUs = 0;
+
+        /* Only handshakes are timed, to keep reading the clock off the data
+         * path. */
+        if( TLS_HANDSHAKE_SUCCESSFUL != pxCtx->xTLSHandshakeState )
+        {
+            ulStartUs = tlsconfigSTATISTICS_TIME_US();
+        }
+    #endif
+
+    xResult = ( int ) pxCtx->xNetworkRecv( pxCtx->pvCallerContext, pucReceiveBuffer, xReceiveLength );
 
-    return ( int ) pxCtx->xNetworkRecv( pxCtx->pvCallerContext, pucReceiveBuffer, xReceiveLength );
+    #if ( tlsconfigSTATISTICS == 1 )
+        if( TLS_HANDSHAKE_SUCCESSFUL != pxCtx->xTLSHandshakeState )
+        {
+            pxCtx->xStatistics.ulNetworkWaitUs += tlsconfigSTATISTICS_TIME_US() - ulStartUs;
+        }
+
+        if( xResult > 0 )
+        {
+            pxCtx->xStatistics.ulBytesReceived += ( uint32_t ) xResult;
+            prvStatisticsCountRecords( &pxCtx->xRecordsReceived,
+                                       pucReceiveBuffer,
+                                       ( size_t ) xResult,
+                                       &pxCtx->xStatistics.ulRecordsReceived,
+                                       &pxCtx->xStatistics.usPeakRecordReceived );
+        }
+    #endif
+
+    /* Unlike 0, which mbedTLS treats as the end of the connection, this lets
+     * it keep a partly received record for the next read. */
+    if( -pdFREERTOS_ERRNO_EWOULDBLOCK == xResult )
+    {
+        pxCtx->xNetworkWouldBlock = pdTRUE;
+        xResult = MBEDTLS_ERR_SSL_WANT_READ;
+    }
+
+    return xResult;
 }
 
 /*-----------------------------------------------------------*/
@@ -354,6 +750,10 @@ static int prvPrivateKeySigningCallback( void * pvContext,
     CK_BYTE xToBeSigned[ 256 ];
     CK_ULONG xToBeSignedLen = sizeof( xToBeSigned );
 
+    #if ( tlsconfigSTATISTICS == 1 )
+        uint32_t ulStartUs = tlsconfigSTATISTICS_TIME_US();
+    #endif
+
     /* Unreferenced parameters. */
     ( void ) ( piRng );
     ( void ) ( pvRng );
@@ -427,6 +827,10 @@ static int prvPrivateKeySigningCallback( void * pvContext,
         lFinalResult = TLS_ERROR_SIGN;
     }
 
+    #if ( tlsconfigSTATISTICS == 1 )
+        pxTLSContext->xStatistics.ulSignUs += tlsconfigSTATISTICS_TIME_US() - ulStartUs;
+    #endif
+
     return lFinalResult;
 }
 
@@ -516,50 +920,32 @@ static int prvReadCertificateIntoContext( TLSContext_t * pxTlsContext,
 /*-----------------------------------------------------------*/
 
 /**
- * @brief Helper for setting up potentially hardware-based cryptographic context
- * for the client TLS certificate and private key.
+ * @brief Read the device private key handle and client certificates from
+ * PKCS #11.
  *
- * @param Caller context.
+ * @param[in] pxCtx TLS context with a logged in PKCS #11 session.
+ * @param[out] pxPrivateKey Handle of the device private key.
+ * @param[out] pxKeyType Type of the device private key.
+ * @param[out] pxChain Initialized certificate chain to parse into.
  *
  * @return Zero on success.
  */
-static int prvInitializeClientCredential( TLSContext_t * pxCtx )
+static int prvReadClientCredential( TLSContext_t * pxCtx,
+                                    CK_OBJECT_HANDLE * pxPrivateKey,
+                                    CK_KEY_TYPE * pxKeyType,
+                                    mbedtls_x509_crt * pxChain )
 {
     BaseType_t xResult = CKR_OK;
-    CK_ULONG xCount = 0;
     CK_ATTRIBUTE xTemplate[ 2 ];
-    mbedtls_pk_type_t xKeyAlgo = ( mbedtls_pk_type_t ) ~0;
     char * pcJitrCertificate = keyJITR_DEVICE_CERTIFICATE_AUTHORITY_PEM;
 
-    /* Initialize the mbed contexts. */
-    mbedtls_x509_crt_init( &pxCtx->xMbedX509Cli );
-
-    if( pxCtx->xP11Session == CK_INVALID_HANDLE )
-    {
-        xResult = CKR_SESSION_HANDLE_INVALID;
-        TLS_PRINT( ( "Error: PKCS #11 session was not initialized.\r\n" ) );
-    }
-
-    /* Put the module in authenticated mode. */
-    if( CKR_OK == xResult )
-    {
-        pxCtx->xTLSHandshakeState = TLS_HANDSHAKE_STARTED;
-        xResult = ( BaseType_t ) pxCtx->pxP11FunctionList->C_Login( pxCtx->xP11Session,
-                                                                    CKU_USER,
-                                                                    ( CK_UTF8CHAR_PTR ) configPKCS11_DEFAULT_USER_PIN,
-                                                                    sizeof( configPKCS11_DEFAULT_USER_PIN ) - 1 );
-    }
-
-    if( CKR_OK == xResult )
-    {
-        /* Get the handle of the device private key. */
-        xResult = xFindObjectWithLabelAndClass( pxCtx->xP11Session,
-                                                pkcs11configLABEL_DEVICE_PRIVATE_KEY_FOR_TLS,
-                                                CKO_PRIVATE_KEY,
-                                                &pxCtx->xP11PrivateKey );
-    }
+    /* Get the handle of the device private key. */
+    xResult = xFindObjectWithLabelAndClass( pxCtx->xP11Session,
+                                            pkcs11configLABEL_DEVICE_PRIVATE_KEY_FOR_TLS,
+                                            CKO_PRIVATE_KEY,
+                                            pxPrivateKey );
 
-    if( ( CKR_OK == xResult ) && ( pxCtx->xP11PrivateKey == CK_INVALID_HANDLE ) )
+    if( ( CKR_OK == xResult ) && ( *pxPrivateKey == CK_INVALID_HANDLE ) )
     {
         xResult = TLS_ERROR_NO_PRIVATE_KEY;
         TLS_PRINT( ( "ERROR: Private key not found. " ) );
@@ -569,50 +955,21 @@ static int prvInitializeClientCredential( TLSContext_t * pxCtx )
     if( xResult == CKR_OK )
     {
         xTemplate[ 0 ].type = CKA_KEY_TYPE;
-        xTemplate[ 0 ].pValue = &pxCtx->xKeyType;
+        xTemplate[ 0 ].pValue = pxKeyType;
         xTemplate[ 0 ].ulValueLen = sizeof( CK_KEY_TYPE );
         xResult = pxCtx->pxP11FunctionList->C_GetAttributeValue( pxCtx->xP11Session,
-                                                                 pxCtx->xP11PrivateKey,
+                                                                 *pxPrivateKey,
                                                                  xTemplate,
                                                                  1 );
     }
 
-    /* Map the PKCS #11 key type to an mbedTLS algorithm. */
-    if( xResult == CKR_OK )
-    {
-        switch( pxCtx->xKeyType )
-        {
-            case CKK_RSA:
-                xKeyAlgo = MBEDTLS_PK_RSA;
-                break;
-
-            case CKK_EC:
-                xKeyAlgo = MBEDTLS_PK_ECKEY;
-                break;
-
-            default:
-                xResult = CKR_ATTRIBUTE_VALUE_INVALID;
-                break;
-        }
-    }
-
-    /* Map the mbedTLS algorithm to its internal metadata. */
-    if( xResult == CKR_OK )
-    {
-        memcpy( &pxCtx->xMbedPkInfo, mbedtls_pk_info_from_type( xKeyAlgo ), sizeof( mbedtls_pk_info_t ) );
-
-        pxCtx->xMbedPkInfo.sign_func = prvPrivateKeySigningCallback;
-        pxCtx->xMbedPkCtx.pk_info = &pxCtx->xMbedPkInfo;
-        pxCtx->xMbedPkCtx.pk_ctx = pxCtx;
-    }
-
     /* Get the handle of the device client certificate. */
     if( xResult == CKR_OK )
     {
         xResult = prvReadCertificateIntoContext( pxCtx,
                                                  pkcs11configLABEL_DEVICE_CERTIFICATE_FOR_TLS,
                                                  CKO_CERTIFICATE,
-                                                 &pxCtx->xMbedX509Cli );
+                                                 pxChain );
     }
 
     /* Add a Just-in-Time Registration (JITR) device issuer certificate, if
@@ -623,7 +980,7 @@ static int prvInitializeClientCredential( TLSContext_t * pxCtx )
         if( ( NULL != pcJitrCertificate ) &&
             ( 0 != strcmp( "", pcJitrCertificate ) ) )
         {
-            xResult = mbedtls_x509_crt_parse( &pxCtx->xMbedX509Cli,
+            xResult = mbedtls_x509_crt_parse( pxChain,
                                               ( const unsigned char * ) pcJitrCertificate,
                                               1 + strlen( pcJitrCertificate ) );
         }
@@ -633,7 +990,7 @@ static int prvInitializeClientCredential( TLSContext_t * pxCtx )
             xResult = prvReadCertificateIntoContext( pxCtx,
                                                      pkcs11configLABEL_JITP_CERTIFICATE,
                                                      CKO_CERTIFICATE,
-                                                     &pxCtx->xMbedX509Cli );
+                                                     pxChain );
 
             /* It is optional to have a JITR certificate in storage. */
             if( CKR_OBJECT_HANDLE_INVALID == xResult )
@@ -643,14 +1000,6 @@ static int prvInitializeClientCredential( TLSContext_t * pxCtx )
         }
     }
 
-    /* Attach the client certificate(s) and private key to the TLS configuration. */
-    if( 0 == xResult )
-    {
-        xResult = mbedtls_ssl_conf_own_cert( &pxCtx->xMbedSslConfig,
-                                             &pxCtx->xMbedX509Cli,
-                                             &pxCtx->xMbedPkCtx );
-    }
-
     return xResult;
 }
 
@@ -699,48 +1048,1155 @@ static int prvEntropyCallback( void * tlsContext,
     return ret;
 }
 
-/*
- * Interface routines.
- */
+/*-----------------------------------------------------------*/
 
-BaseType_t TLS_Init( void ** ppvContext,
-                     TLSParams_t * pxParams )
+/**
+ * @brief Parse the root certificates to trust: either the default or the
+ * override.
+ *
+ * @param[in] pxCtx TLS context.
+ * @param[out] pxChain Initialized certificate chain to parse into.
+ *
+ * @return Zero on success.
+ */
+static int prvParseTrustedCertificates( TLSContext_t * pxCtx,
+                                        mbedtls_x509_crt * pxChain )
 {
-    BaseType_t xResult = CKR_OK;
-    int mbedTLSResult = 0;
-    TLSContext_t * pxCtx = NULL;
-    CK_C_GetFunctionList xCkGetFunctionList = NULL;
-
-    /* Allocate an internal context. */
-    pxCtx = ( TLSContext_t * ) pvPortMalloc( sizeof( TLSContext_t ) ); /*lint !e9087 !e9079 Allow casting void* to other types. */
+    int xResult = 0;
 
-    if( NULL != pxCtx )
+    if( NULL != pxCtx->pcServerCertificate )
     {
-        memset( pxCtx, 0, sizeof( TLSContext_t ) );
-        *ppvContext = pxCtx;
-
-        /* Initialize the context. */
-        pxCtx->pcDestination = pxParams->pcDestination;
-        pxCtx->pcServerCertificate = pxParams->pcServerCertificate;
-        pxCtx->ulServerCertificateLength = pxParams->ulServerCertificateLength;
-        pxCtx->ppcAlpnProtocols = pxParams->ppcAlpnProtocols;
-        pxCtx->ulAlpnProtocolsCount = pxParams->ulAlpnProtocolsCount;
-        pxCtx->xNetworkRecv = pxParams->pxNetworkRecv;
-        pxCtx->xNetworkSend = pxParams->pxNetworkSend;
-        pxCtx->pvCallerContext = pxParams->pvCallerContext;
-
-        /* Get the function pointer list for the PKCS#11 module. */
-        xCkGetFunctionList = C_GetFunctionList;
-        xResult = ( BaseType_t ) xCkGetFunctionList( &pxCtx->pxP11FunctionList );
+        xResult = mbedtls_x509_crt_parse( pxChain,
+                                          ( const unsigned char * ) pxCtx->pcServerCertificate,
+                                          pxCtx->ulServerCertificateLength );
 
-        /* Ensure that the PKCS #11 module is initialized and create a session. */
-        if( xResult == CKR_OK )
+        if( 0 != xResult )
         {
-            xResult = xInitializePkcs11Session( &pxCtx->xP11Session );
-
-            /* It is ok if the module was previously initialized. */
-            if( xResult == CKR_CRYPTOKI_ALREADY_INITIALIZED )
-            {
+            TLS_PRINT( ( "ERROR: Failed to parse custom server certificates %s : %s \r\n",
+                         mbedtlsHighLevelCodeOrDefault( xResult ),
+                         mbedtlsLowLevelCodeOrDefault( xResult ) ) );
+        }
+    }
+    else
+    {
+        xResult = mbedtls_x509_crt_parse( pxChain,
+                                          ( const unsigned char * ) tlsVERISIGN_ROOT_CERTIFICATE_PEM,
+                                          tlsVERISIGN_ROOT_CERTIFICATE_LENGTH );
+
+        if( 0 == xResult )
+        {
+            xResult = mbedtls_x509_crt_parse( pxChain,
+                                              ( const unsigned char * ) tlsATS1_ROOT_CERTIFICATE_PEM,
+                                              tlsATS1_ROOT_CERTIFICATE_LENGTH );
+
+            if( 0 == xResult )
+            {
+                xResult = mbedtls_x509_crt_parse( pxChain,
+                                                  ( const unsigned char * ) tlsSTARFIELD_ROOT_CERTIFICATE_PEM,
+                                                  tlsSTARFIELD_ROOT_CERTIFICATE_LENGTH );
+            }
+        }
+
+        if( 0 != xResult )
+        {
+            /* Default root certificates should be in aws_default_root_certificate.h */
+            TLS_PRINT( ( "ERROR: Failed to parse default server certificates %s : %s \r\n",
+                         mbedtlsHighLevelCodeOrDefault( xResult ),
+                         mbedtlsLowLevelCodeOrDefault( xResult ) ) );
+        }
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+#if tlsSHARED_STATE
+
+/**
+ * @brief Take the lock guarding the shared state, creating it on first use.
+ */
+    static void prvSharedStateLock( void )
+    {
+        /* Two connections may race to be the first to use the lock. */
+        portENTER_CRITICAL();
+
+        if( NULL == xSharedStateLock )
+        {
+            xSharedStateLock = xSemaphoreCreateMutexStatic( &xSharedStateLockBuffer );
+        }
+
+        portEXIT_CRITICAL();
+
+        ( void ) xSemaphoreTake( xSharedStateLock, portMAX_DELAY );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Give back the lock guarding the shared state.
+ */
+    static void prvSharedStateUnlock( void )
+    {
+        ( void ) xSemaphoreGive( xSharedStateLock );
+    }
+#endif /* if tlsSHARED_STATE */
+
+/*-----------------------------------------------------------*/
+
+#if tlsENDPOINT_STATISTICS
+
+/**
+ * @brief Hashes a server name with 32 bit FNV-1a.
+ *
+ * @param[in] pcName NUL terminated server name.
+ *
+ * @return The hash.
+ */
+    static uint32_t prvEndpointHash( const char * pcName )
+    {
+        uint32_t ulHash = 2166136261UL;
+
+        while( '\0' != *pcName )
+        {
+            ulHash ^= ( uint8_t ) *pcName;
+            ulHash *= 16777619UL;
+            pcName++;
+        }
+
+        return ulHash;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Finds the statistics summarized for a server. Must be called with
+ * xSharedStateLock taken.
+ *
+ * @param[in] ulHash Hash of the server name.
+ * @param[in] pcName Server name for a new entry, which replaces the least
+ * recently used one when the table is full, or NULL to not add an entry.
+ *
+ * @return The entry, or NULL if it was not found and pcName is NULL.
+ */
+    static TLSEndpointEntry_t * prvEndpointLookup( uint32_t ulHash,
+                                                   const char * pcName )
+    {
+        TLSEndpointEntry_t * pxEntry = NULL;
+        TLSEndpointEntry_t * pxOldest = NULL;
+        TickType_t xNow = xTaskGetTickCount();
+        size_t xIndex = 0;
+
+        for( xIndex = 0; xIndex < tlsconfigSTATISTICS_ENDPOINTS; xIndex++ )
+        {
+            if( pdFALSE == xEndpoints[ xIndex ].xInUse )
+            {
+                if( ( NULL == pxOldest ) || ( pdTRUE == pxOldest->xInUse ) )
+                {
+                    pxOldest = &xEndpoints[ xIndex ];
+                }
+            }
+            else if( ulHash == xEndpoints[ xIndex ].ulHash )
+            {
+                pxEntry = &xEndpoints[ xIndex ];
+                break;
+            }
+            else if( ( NULL == pxOldest ) ||
+                     ( ( pdTRUE == pxOldest->xInUse ) &&
+                       ( ( xNow - xEndpoints[ xIndex ].xLastUsed ) > ( xNow - pxOldest->xLastUsed ) ) ) )
+            {
+                pxOldest = &xEndpoints[ xIndex ];
+            }
+        }
+
+        if( ( NULL == pxEntry ) && ( NULL != pcName ) )
+        {
+            pxEntry = pxOldest;
+            memset( pxEntry, 0, sizeof( TLSEndpointEntry_t ) );
+            pxEntry->xInUse = pdTRUE;
+            pxEntry->ulHash = ulHash;
+            strncpy( pxEntry->xStatistics.cDestination, pcName, tlsconfigSTATISTICS_NAME_LENGTH - 1 );
+        }
+
+        return pxEntry;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Adds the handshake of a context to the summary of its server.
+ *
+ * @param[in] pxCtx Caller TLS context.
+ * @param[in] xResult Result of the handshake.
+ */
+    static void prvEndpointAddHandshake( TLSContext_t * pxCtx,
+                                         BaseType_t xResult )
+    {
+        const TLSStatistics_t * pxStatistics = &pxCtx->xStatistics;
+        const char * pcName = ( NULL != pxCtx->pcDestination ) ? pxCtx->pcDestination : "";
+        TLSEndpointEntry_t * pxEntry = NULL;
+        TLSEndpointStatistics_t * pxSummary = NULL;
+
+        pxCtx->ulEndpointHash = prvEndpointHash( pcName );
+        pxCtx->xEndpointCounted = pdTRUE;
+
+        prvSharedStateLock();
+
+        pxEntry = prvEndpointLookup( pxCtx->ulEndpointHash, pcName );
+        pxEntry->xLastUsed = xTaskGetTickCount();
+        pxSummary = &pxEntry->xStatistics;
+
+        pxSummary->ulHandshakes++;
+
+        if( 0 != xResult )
+        {
+            pxSummary->ulFailures++;
+        }
+        else if( pdTRUE == pxStatistics->xResumed )
+        {
+            pxSummary->ulResumed++;
+        }
+
+        if( pxStatistics->ulHandshakeUs > pxSummary->ulHandshakeMaxUs )
+        {
+            pxSummary->ulHandshakeMaxUs = pxStatistics->ulHandshakeUs;
+        }
+
+        pxSummary->ullHandshakeUs += pxStatistics->ulHandshakeUs;
+        pxSummary->ullNetworkWaitUs += pxStatistics->ulNetworkWaitUs;
+        pxSummary->ullVerifyUs += pxStatistics->ulVerifyUs;
+        pxSummary->ullSignUs += pxStatistics->ulSignUs;
+
+        prvSharedStateUnlock();
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Adds the traffic of a context to the summary of its server.
+ *
+ * The server name may already be freed by the caller, so the entry is found
+ * by the hash taken during the handshake.
+ *
+ * @param[in] pxCtx Caller TLS context.
+ */
+    static void prvEndpointAddTraffic( TLSContext_t * pxCtx )
+    {
+        const TLSStatistics_t * pxStatistics = &pxCtx->xStatistics;
+        TLSEndpointEntry_t * pxEntry = NULL;
+        TLSEndpointStatistics_t * pxSummary = NULL;
+
+        if( pdTRUE == pxCtx->xEndpointCounted )
+        {
+            prvSharedStateLock();
+
+            /* Nothing is added if the server was evicted meanwhile. */
+            pxEntry = prvEndpointLookup( pxCtx->ulEndpointHash, NULL );
+
+            if( NULL != pxEntry )
+            {
+                pxSummary = &pxEntry->xStatistics;
+                pxSummary->ullBytesSent += pxStatistics->ulBytesSent;
+                pxSummary->ullBytesReceived += pxStatistics->ulBytesReceived;
+                pxSummary->ullAppBytesSent += pxStatistics->ulAppBytesSent;
+                pxSummary->ullAppBytesReceived += pxStatistics->ulAppBytesReceived;
+                pxSummary->ulRecordsSent += pxStatistics->ulRecordsSent;
+                pxSummary->ulRecordsReceived += pxStatistics->ulRecordsReceived;
+
+                if( pxStatistics->usPeakRecordSent > pxSummary->usPeakRecordSent )
+                {
+                    pxSummary->usPeakRecordSent = pxStatistics->usPeakRecordSent;
+                }
+
+                if( pxStatistics->usPeakRecordReceived > pxSummary->usPeakRecordReceived )
+                {
+                    pxSummary->usPeakRecordReceived = pxStatistics->usPeakRecordReceived;
+                }
+            }
+
+            prvSharedStateUnlock();
+
+            pxCtx->xEndpointCounted = pdFALSE;
+        }
+    }
+#endif /* if tlsENDPOINT_STATISTICS */
+
+/*-----------------------------------------------------------*/
+
+#if ( tlsconfigSESSION_CACHE_ENTRIES > 0 )
+
+/**
+ * @brief Release the session held by a cache entry.
+ *
+ * @param[in] pxEntry Cache entry, with the shared state lock held.
+ */
+    static void prvSessionCacheFree( TLSSessionCacheEntry_t * pxEntry )
+    {
+        mbedtls_ssl_session_free( &pxEntry->xSession );
+        pxEntry->xInUse = pdFALSE;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find the cached session for a key, discarding expired sessions.
+ *
+ * @param[in] pucKey Hash of the connection parameters.
+ *
+ * @return The cache entry, or NULL if no session is cached for the key. The
+ * shared state lock must be held.
+ */
+    static TLSSessionCacheEntry_t * prvSessionCacheFind( const unsigned char * pucKey )
+    {
+        TLSSessionCacheEntry_t * pxFound = NULL;
+        TLSSessionCacheEntry_t * pxEntry = NULL;
+        TickType_t xNow = xTaskGetTickCount();
+        size_t xIndex = 0;
+
+        for( xIndex = 0; xIndex < tlsconfigSESSION_CACHE_ENTRIES; xIndex++ )
+        {
+            pxEntry = &xSessionCache[ xIndex ];
+
+            if( ( pdTRUE == pxEntry->xInUse ) &&
+                ( ( xNow - pxEntry->xSavedTime ) >= pxEntry->xLifetime ) )
+            {
+                prvSessionCacheFree( pxEntry );
+            }
+
+            if( ( pdTRUE == pxEntry->xInUse ) &&
+                ( 0 == memcmp( pxEntry->ucKey, pucKey, tlsHASH_LENGTH ) ) )
+            {
+                pxFound = pxEntry;
+            }
+        }
+
+        return pxFound;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Hash the connection parameters a session is bound to.
+ *
+ * A session is only resumed with the server name and port, the ALPN protocols,
+ * the trusted server certificate and the client certificate it was negotiated
+ * with. A different service on the same host, re-provisioning the device or
+ * changing the trust therefore always forces a full handshake.
+ *
+ * @param[in] pxCtx TLS context, after the client credential was loaded.
+ *
+ * @return Zero on success.
+ */
+    static int prvSessionCacheKey( TLSContext_t * pxCtx )
+    {
+        int xResult = 0;
+        uint32_t ulIndex = 0;
+        mbedtls_sha256_context xSha256Ctx;
+
+        mbedtls_sha256_init( &xSha256Ctx );
+        xResult = mbedtls_sha256_starts_ret( &xSha256Ctx, 0 );
+
+        /* Include the terminator to separate the server name from what follows. */
+        if( 0 == xResult )
+        {
+            xResult = mbedtls_sha256_update_ret( &xSha256Ctx,
+                                                 ( const unsigned char * ) pxCtx->pcDestination,
+                                                 1 + strlen( pxCtx->pcDestination ) );
+        }
+
+        if( 0 == xResult )
+        {
+            xResult = mbedtls_sha256_update_ret( &xSha256Ctx,
+                                                 ( const unsigned char * ) &pxCtx->usPort,
+                                                 sizeof( pxCtx->usPort ) );
+        }
+
+        /* The count and the terminators keep differently split protocol lists apart. */
+        if( 0 == xResult )
+        {
+            xResult = mbedtls_sha256_update_ret( &xSha256Ctx,
+                                                 ( const unsigned char * ) &pxCtx->ulAlpnProtocolsCount,
+                                                 sizeof( pxCtx->ulAlpnProtocolsCount ) );
+        }
+
+        for( ulIndex = 0; ( 0 == xResult ) && ( ulIndex < pxCtx->ulAlpnProtocolsCount ); ulIndex++ )
+        {
+            xResult = mbedtls_sha256_update_ret( &xSha256Ctx,
+                                                 ( const unsigned char * ) pxCtx->ppcAlpnProtocols[ ulIndex ],
+                                                 1 + strlen( pxCtx->ppcAlpnProtocols[ ulIndex ] ) );
+        }
+
+        if( ( 0 == xResult ) && ( NULL != pxCtx->pcServerCertificate ) )
+        {
+            xResult = mbedtls_sha256_update_ret( &xSha256Ctx,
+                                                 ( const unsigned char * ) pxCtx->pcServerCertificate,
+                                                 pxCtx->ulServerCertificateLength );
+        }
+
+        if( 0 == xResult )
+        {
+            xResult = mbedtls_sha256_update_ret( &xSha256Ctx,
+                                                 pxCtx->pxMbedX509Cli->raw.p,
+                                                 pxCtx->pxMbedX509Cli->raw.len );
+        }
+
+        if( 0 == xResult )
+        {
+            xResult = mbedtls_sha256_finish_ret( &xSha256Ctx, pxCtx->ucSessionKey );
+        }
+
+        mbedtls_sha256_free( &xSha256Ctx );
+
+        return xResult;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Offer the session cached for this connection to the server, if any.
+ *
+ * A session that cannot be offered only costs a full handshake, so failures
+ * are not reported to the caller.
+ *
+ * @param[in] pxCtx TLS context, after mbedtls_ssl_setup.
+ */
+    static void prvSessionResume( TLSContext_t * pxCtx )
+    {
+        int xResult = 0;
+        TLSSessionCacheEntry_t * pxEntry = NULL;
+
+        pxCtx->xSessionOffered = pdFALSE;
+        xResult = prvSessionCacheKey( pxCtx );
+
+        if( 0 == xResult )
+        {
+            prvSharedStateLock();
+
+            pxEntry = prvSessionCacheFind( pxCtx->ucSessionKey );
+
+            if( NULL != pxEntry )
+            {
+                xResult = mbedtls_ssl_set_session( &pxCtx->xMbedSslCtx, &pxEntry->xSession );
+
+                if( 0 == xResult )
+                {
+                    pxCtx->xSessionOffered = pdTRUE;
+                }
+            }
+
+            prvSharedStateUnlock();
+        }
+        else
+        {
+            /* Without a key the session cannot be cached either. */
+            pxCtx->xSessionCache = pdFALSE;
+        }
+
+        if( 0 != xResult )
+        {
+            TLS_PRINT( ( "WARNING: Failed to offer a cached TLS session %s : %s \r\n",
+                         mbedtlsHighLevelCodeOrDefault( xResult ),
+                         mbedtlsLowLevelCodeOrDefault( xResult ) ) );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Cache the session of a completed handshake.
+ *
+ * The session replaces the one cached for the same key, or else a free entry
+ * or the oldest session. A resumed session keeps the time it was first
+ * negotiated, so it still expires when the device keeps resuming it.
+ *
+ * @param[in] pxCtx TLS context, after a successful handshake.
+ */
+    static void prvSessionSave( TLSContext_t * pxCtx )
+    {
+        int xResult = 0;
+        TLSSessionCacheEntry_t * pxEntry = NULL;
+        TickType_t xNow = xTaskGetTickCount();
+        TickType_t xSavedTime = xNow;
+        TickType_t xLifetime = ( TickType_t ) tlsconfigSESSION_CACHE_LIFETIME_S * configTICK_RATE_HZ;
+        BaseType_t xResumable = pdFALSE;
+        size_t xIndex = 0;
+
+        prvSharedStateLock();
+
+        pxEntry = prvSessionCacheFind( pxCtx->ucSessionKey );
+
+        if( NULL != pxEntry )
+        {
+            /* The master secret only stays the same if the session was resumed. */
+            if( 0 == memcmp( pxEntry->xSession.master,
+                             pxCtx->xMbedSslCtx.session->master,
+                             sizeof( pxEntry->xSession.master ) ) )
+            {
+                xSavedTime = pxEntry->xSavedTime;
+            }
+
+            prvSessionCacheFree( pxEntry );
+        }
+        else
+        {
+            /* Use a free entry, or else replace the oldest session. */
+            for( xIndex = 0; xIndex < tlsconfigSESSION_CACHE_ENTRIES; xIndex++ )
+            {
+                if( pdFALSE == xSessionCache[ xIndex ].xInUse )
+                {
+                    pxEntry = &xSessionCache[ xIndex ];
+                    break;
+                }
+                else if( ( NULL == pxEntry ) ||
+                         ( ( xNow - xSessionCache[ xIndex ].xSavedTime ) > ( xNow - pxEntry->xSavedTime ) ) )
+                {
+                    pxEntry = &xSessionCache[ xIndex ];
+                }
+                else
+                {
+                    /* Newer than the oldest session found so far. */
+                }
+            }
+
+            if( pdTRUE == pxEntry->xInUse )
+            {
+                prvSessionCacheFree( pxEntry );
+            }
+        }
+
+        mbedtls_ssl_session_init( &pxEntry->xSession );
+        xResult = mbedtls_ssl_get_session( &pxCtx->xMbedSslCtx, &pxEntry->xSession );
+
+        if( 0 == xResult )
+        {
+            /* The server may not support resumption at all. */
+            if( 0U != pxEntry->xSession.id_len )
+            {
+                xResumable = pdTRUE;
+            }
+
+            #if defined( MBEDTLS_SSL_SESSION_TICKETS )
+                if( ( NULL != pxEntry->xSession.ticket ) && ( 0U != pxEntry->xSession.ticket_len ) )
+                {
+                    xResumable = pdTRUE;
+
+                    /* Honour a shorter ticket lifetime hint from the server. */
+                    if( ( 0U != pxEntry->xSession.ticket_lifetime ) &&
+                        ( pxEntry->xSession.ticket_lifetime < tlsconfigSESSION_CACHE_LIFETIME_S ) )
+                    {
+                        xLifetime = ( TickType_t ) pxEntry->xSession.ticket_lifetime * configTICK_RATE_HZ;
+                    }
+                }
+            #endif
+        }
+        else
+        {
+            TLS_PRINT( ( "WARNING: Failed to cache the TLS session %s : %s \r\n",
+                         mbedtlsHighLevelCodeOrDefault( xResult ),
+                         mbedtlsLowLevelCodeOrDefault( xResult ) ) );
+        }
+
+        if( pdTRUE == xResumable )
+        {
+            memcpy( pxEntry->ucKey, pxCtx->ucSessionKey, tlsHASH_LENGTH );
+            pxEntry->xSavedTime = xSavedTime;
+            pxEntry->xLifetime = xLifetime;
+            pxEntry->xInUse = pdTRUE;
+        }
+        else
+        {
+            mbedtls_ssl_session_free( &pxEntry->xSession );
+        }
+
+        prvSharedStateUnlock();
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Discard the session cached for this connection.
+ *
+ * @param[in] pxCtx TLS context whose session key was computed.
+ */
+    static void prvSessionDiscard( TLSContext_t * pxCtx )
+    {
+        TLSSessionCacheEntry_t * pxEntry = NULL;
+
+        prvSharedStateLock();
+
+        pxEntry = prvSessionCacheFind( pxCtx->ucSessionKey );
+
+        if( NULL != pxEntry )
+        {
+            prvSessionCacheFree( pxEntry );
+        }
+
+        prvSharedStateUnlock();
+    }
+#endif /* if ( tlsconfigSESSION_CACHE_ENTRIES > 0 ) */
+
+/*-----------------------------------------------------------*/
+
+#if ( tlsconfigTRUST_STORE_ENTRIES > 0 )
+
+/**
+ * @brief Find the shared trust store for a key, or claim one for it.
+ *
+ * A store that no handshake is using is replaced when the key is not found,
+ * preferring one that was never parsed.
+ *
+ * @param[in] pucKey Hash of the trusted certificates.
+ *
+ * @return The trust store, or NULL if all of them are in use. The shared
+ * state lock must be held.
+ */
+    static TLSTrustStore_t * prvTrustStoreFind( const unsigned char * pucKey )
+    {
+        TLSTrustStore_t * pxFound = NULL;
+        TLSTrustStore_t * pxUnused = NULL;
+        size_t xIndex = 0;
+
+        for( xIndex = 0; ( xIndex < tlsconfigTRUST_STORE_ENTRIES ) && ( NULL == pxFound ); xIndex++ )
+        {
+            if( ( pdTRUE == xTrustStores[ xIndex ].xParsed ) &&
+                ( 0 == memcmp( xTrustStores[ xIndex ].ucKey, pucKey, tlsHASH_LENGTH ) ) )
+            {
+                pxFound = &xTrustStores[ xIndex ];
+            }
+            else if( ( 0U == xTrustStores[ xIndex ].ulRefCount ) &&
+                     ( ( NULL == pxUnused ) || ( pdTRUE == pxUnused->xParsed ) ) )
+            {
+                pxUnused = &xTrustStores[ xIndex ];
+            }
+            else
+            {
+                /* In use for other certificates. */
+            }
+        }
+
+        if( ( NULL == pxFound ) && ( NULL != pxUnused ) )
+        {
+            if( pdTRUE == pxUnused->xParsed )
+            {
+                mbedtls_x509_crt_free( &pxUnused->xChain );
+                pxUnused->xParsed = pdFALSE;
+            }
+
+            memcpy( pxUnused->ucKey, pucKey, tlsHASH_LENGTH );
+            pxFound = pxUnused;
+        }
+
+        return pxFound;
+    }
+#endif /* if ( tlsconfigTRUST_STORE_ENTRIES > 0 ) */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the parsed root certificates for a handshake.
+ *
+ * The certificates are parsed into a shared trust store the first time and
+ * only referenced by later handshakes that trust the same certificates. When
+ * every store is in use for other certificates, they are parsed into the
+ * context instead, as if there was no sharing.
+ *
+ * @param[in] pxCtx TLS context, with xMbedX509CA initialized.
+ *
+ * @return Zero on success.
+ */
+static int prvTrustStoreAcquire( TLSContext_t * pxCtx )
+{
+    int xResult = 0;
+
+    #if ( tlsconfigTRUST_STORE_ENTRIES > 0 )
+        unsigned char ucKey[ tlsHASH_LENGTH ] = { 0 };
+        TLSTrustStore_t * pxStore = NULL;
+    #endif
+
+    pxCtx->pxTrustStore = NULL;
+    pxCtx->pxMbedX509CA = &pxCtx->xMbedX509CA;
+
+    #if ( tlsconfigTRUST_STORE_ENTRIES > 0 )
+        /* The default roots are looked up by the all zero key. */
+        if( NULL != pxCtx->pcServerCertificate )
+        {
+            xResult = mbedtls_sha256_ret( ( const unsigned char * ) pxCtx->pcServerCertificate,
+                                          pxCtx->ulServerCertificateLength,
+                                          ucKey,
+                                          0 );
+        }
+
+        if( 0 == xResult )
+        {
+            prvSharedStateLock();
+
+            pxStore = prvTrustStoreFind( ucKey );
+
+            /* Parse while holding the lock, so that handshakes waiting for the
+             * same certificates use the result instead of parsing them again. */
+            if( ( NULL != pxStore ) && ( pdFALSE == pxStore->xParsed ) )
+            {
+                mbedtls_x509_crt_init( &pxStore->xChain );
+                xResult = prvParseTrustedCertificates( pxCtx, &pxStore->xChain );
+
+                if( 0 == xResult )
+                {
+                    pxStore->xParsed = pdTRUE;
+                }
+                else
+                {
+                    mbedtls_x509_crt_free( &pxStore->xChain );
+                }
+            }
+
+            if( ( NULL != pxStore ) && ( 0 == xResult ) )
+            {
+                pxStore->ulRefCount++;
+                pxCtx->pxTrustStore = pxStore;
+                pxCtx->pxMbedX509CA = &pxStore->xChain;
+            }
+
+            prvSharedStateUnlock();
+        }
+
+        /* Neither a hashing nor a parsing error gets better by parsing the
+         * certificates again, so only fall back when no store was free. */
+        if( ( 0 == xResult ) && ( NULL == pxStore ) )
+        {
+            xResult = prvParseTrustedCertificates( pxCtx, &pxCtx->xMbedX509CA );
+        }
+    #else /* if ( tlsconfigTRUST_STORE_ENTRIES > 0 ) */
+        xResult = prvParseTrustedCertificates( pxCtx, &pxCtx->xMbedX509CA );
+    #endif /* if ( tlsconfigTRUST_STORE_ENTRIES > 0 ) */
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Stop using the shared trust store, once the handshake is over.
+ *
+ * The store stays parsed for later handshakes.
+ *
+ * @param[in] pxCtx TLS context.
+ */
+static void prvTrustStoreRelease( TLSContext_t * pxCtx )
+{
+    #if ( tlsconfigTRUST_STORE_ENTRIES > 0 )
+        if( NULL != pxCtx->pxTrustStore )
+        {
+            prvSharedStateLock();
+            pxCtx->pxTrustStore->ulRefCount--;
+            prvSharedStateUnlock();
+        }
+    #endif
+
+    pxCtx->pxTrustStore = NULL;
+    pxCtx->pxMbedX509CA = NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 )
+
+/**
+ * @brief Free the shared client credentials, so they are read again.
+ *
+ * @param[in] pxCredential Credentials that no handshake uses.
+ */
+    static void prvClientCredentialFree( TLSClientCredential_t * pxCredential )
+    {
+        mbedtls_x509_crt_free( &pxCredential->xChain );
+        memset( pxCredential, 0, sizeof( TLSClientCredential_t ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Make the next handshake read the client credentials again. Must be
+ * called with xSharedStateLock taken.
+ *
+ * Credentials no handshake uses are freed right away, the others by the last
+ * handshake using them.
+ */
+    static void prvClientCredentialInvalidate( void )
+    {
+        if( pdTRUE == xClientCredential.xLoaded )
+        {
+            if( 0U == xClientCredential.ulRefCount )
+            {
+                prvClientCredentialFree( &xClientCredential );
+            }
+            else
+            {
+                xClientCredential.xStale = pdTRUE;
+            }
+        }
+    }
+#endif /* if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 ) */
+
+/*-----------------------------------------------------------*/
+
+#if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 )
+
+/**
+ * @brief Find the PKCS #11 objects the client credentials are read from.
+ *
+ * @param[in] pxCtx TLS context with a logged in PKCS #11 session.
+ * @param[out] pxPrivateKey Handle of the device private key.
+ * @param[out] pxCertificate Handle of the device certificate.
+ *
+ * @return Zero if both objects were found.
+ */
+    static int prvFindClientCredentialObjects( TLSContext_t * pxCtx,
+                                               CK_OBJECT_HANDLE * pxPrivateKey,
+                                               CK_OBJECT_HANDLE * pxCertificate )
+    {
+        BaseType_t xResult = CKR_OK;
+
+        xResult = xFindObjectWithLabelAndClass( pxCtx->xP11Session,
+                                                pkcs11configLABEL_DEVICE_PRIVATE_KEY_FOR_TLS,
+                                                CKO_PRIVATE_KEY,
+                                                pxPrivateKey );
+
+        if( CKR_OK == xResult )
+        {
+            xResult = xFindObjectWithLabelAndClass( pxCtx->xP11Session,
+                                                    pkcs11configLABEL_DEVICE_CERTIFICATE_FOR_TLS,
+                                                    CKO_CERTIFICATE,
+                                                    pxCertificate );
+        }
+
+        if( ( CKR_OK == xResult ) &&
+            ( ( CK_INVALID_HANDLE == *pxPrivateKey ) || ( CK_INVALID_HANDLE == *pxCertificate ) ) )
+        {
+            xResult = CKR_OBJECT_HANDLE_INVALID;
+        }
+
+        return xResult;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check that the shared client credentials were read from the objects
+ * currently in PKCS #11.
+ *
+ * Provisioning destroys and creates the objects, which leaves a cached private
+ * key handle pointing to a destroyed object and the cached certificate out of
+ * date. A PKCS #11 module may hand out the same handle for a new object with
+ * the same label, so the device certificate is compared as well; it is only
+ * exported, not parsed. Must be called with xSharedStateLock taken.
+ *
+ * @param[in] pxCtx TLS context with a logged in PKCS #11 session.
+ *
+ * @return pdTRUE if the cached credentials can be used.
+ */
+    static BaseType_t prvClientCredentialCurrent( TLSContext_t * pxCtx )
+    {
+        BaseType_t xCurrent = pdFALSE;
+        CK_OBJECT_HANDLE xPrivateKey = CK_INVALID_HANDLE;
+        CK_OBJECT_HANDLE xCertificate = CK_INVALID_HANDLE;
+        CK_ATTRIBUTE xTemplate = { 0 };
+
+        if( ( 0 == prvFindClientCredentialObjects( pxCtx, &xPrivateKey, &xCertificate ) ) &&
+            ( xPrivateKey == xClientCredential.xP11PrivateKey ) &&
+            ( xCertificate == xClientCredential.xP11Certificate ) )
+        {
+            xTemplate.type = CKA_VALUE;
+
+            if( ( CKR_OK == pxCtx->pxP11FunctionList->C_GetAttributeValue( pxCtx->xP11Session,
+                                                                            xCertificate,
+                                                                            &xTemplate,
+                                                                            1 ) ) &&
+                ( xTemplate.ulValueLen == xClientCredential.xChain.raw.len ) )
+            {
+                xTemplate.pValue = pvPortMalloc( xTemplate.ulValueLen ); /*lint !e9079 Allow casting void* to other types. */
+            }
+
+            if( ( NULL != xTemplate.pValue ) &&
+                ( CKR_OK == pxCtx->pxP11FunctionList->C_GetAttributeValue( pxCtx->xP11Session,
+                                                                            xCertificate,
+                                                                            &xTemplate,
+                                                                            1 ) ) &&
+                ( 0 == memcmp( xTemplate.pValue, xClientCredential.xChain.raw.p, xTemplate.ulValueLen ) ) )
+            {
+                xCurrent = pdTRUE;
+            }
+
+            if( NULL != xTemplate.pValue )
+            {
+                vPortFree( xTemplate.pValue );
+            }
+        }
+
+        return xCurrent;
+    }
+#endif /* if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 ) */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the client credentials for a handshake.
+ *
+ * The credentials are read into the shared client credentials by the first
+ * handshake and only referenced by later ones. PKCS #11 object handles are
+ * valid in every session, so the private key handle is shared as well. The
+ * cached credentials are dropped when the objects in PKCS #11 changed. While
+ * invalidated credentials are still in use, they are read into the context
+ * instead, as if there was no sharing.
+ *
+ * @param[in] pxCtx TLS context with a logged in PKCS #11 session, and with
+ * xMbedX509Cli initialized.
+ *
+ * @return Zero on success.
+ */
+static int prvClientCredentialAcquire( TLSContext_t * pxCtx )
+{
+    int xResult = 0;
+
+    pxCtx->pxClientCredential = NULL;
+    pxCtx->pxMbedX509Cli = &pxCtx->xMbedX509Cli;
+
+    #if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 )
+        prvSharedStateLock();
+
+        /* Objects changed by provisioning invalidate the credentials even when
+         * TLS_InvalidateClientCredential was not called. */
+        if( ( pdTRUE == xClientCredential.xLoaded ) &&
+            ( pdFALSE == xClientCredential.xStale ) &&
+            ( pdFALSE == prvClientCredentialCurrent( pxCtx ) ) )
+        {
+            prvClientCredentialInvalidate();
+        }
+
+        if( pdFALSE == xClientCredential.xStale )
+        {
+            /* Read while holding the lock, so that handshakes waiting for the
+             * credentials use the result instead of reading them again. */
+            if( pdFALSE == xClientCredential.xLoaded )
+            {
+                mbedtls_x509_crt_init( &xClientCredential.xChain );
+                xResult = prvReadClientCredential( pxCtx,
+                                                   &xClientCredential.xP11PrivateKey,
+                                                   &xClientCredential.xKeyType,
+                                                   &xClientCredential.xChain );
+
+                /* Remember which certificate object the chain was read from. */
+                if( 0 == xResult )
+                {
+                    xResult = xFindObjectWithLabelAndClass( pxCtx->xP11Session,
+                                                            pkcs11configLABEL_DEVICE_CERTIFICATE_FOR_TLS,
+                                                            CKO_CERTIFICATE,
+                                                            &xClientCredential.xP11Certificate );
+                }
+
+                if( 0 == xResult )
+                {
+                    xClientCredential.xLoaded = pdTRUE;
+                }
+                else
+                {
+                    prvClientCredentialFree( &xClientCredential );
+                }
+            }
+
+            if( 0 == xResult )
+            {
+                xClientCredential.ulRefCount++;
+                pxCtx->pxClientCredential = &xClientCredential;
+                pxCtx->pxMbedX509Cli = &xClientCredential.xChain;
+                pxCtx->xP11PrivateKey = xClientCredential.xP11PrivateKey;
+                pxCtx->xKeyType = xClientCredential.xKeyType;
+            }
+        }
+
+        prvSharedStateUnlock();
+
+        /* A read error does not get better by reading again, so only fall
+         * back while invalidated credentials are in use. */
+        if( ( 0 == xResult ) && ( NULL == pxCtx->pxClientCredential ) )
+        {
+            xResult = prvReadClientCredential( pxCtx,
+                                               &pxCtx->xP11PrivateKey,
+                                               &pxCtx->xKeyType,
+                                               &pxCtx->xMbedX509Cli );
+        }
+    #else /* if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 ) */
+        xResult = prvReadClientCredential( pxCtx,
+                                           &pxCtx->xP11PrivateKey,
+                                           &pxCtx->xKeyType,
+                                           &pxCtx->xMbedX509Cli );
+    #endif /* if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 ) */
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Stop using the shared client credentials, once the handshake is over.
+ *
+ * Invalidated credentials are freed by the last handshake using them.
+ *
+ * @param[in] pxCtx TLS context.
+ */
+static void prvClientCredentialRelease( TLSContext_t * pxCtx )
+{
+    #if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 )
+        if( NULL != pxCtx->pxClientCredential )
+        {
+            prvSharedStateLock();
+            pxCtx->pxClientCredential->ulRefCount--;
+
+            if( ( 0U == pxCtx->pxClientCredential->ulRefCount ) &&
+                ( pdTRUE == pxCtx->pxClientCredential->xStale ) )
+            {
+                prvClientCredentialFree( pxCtx->pxClientCredential );
+            }
+
+            prvSharedStateUnlock();
+        }
+    #endif /* if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 ) */
+
+    pxCtx->pxClientCredential = NULL;
+    pxCtx->pxMbedX509Cli = NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Helper for setting up potentially hardware-based cryptographic context
+ * for the client TLS certificate and private key.
+ *
+ * @param Caller context.
+ *
+ * @return Zero on success.
+ */
+static int prvInitializeClientCredential( TLSContext_t * pxCtx )
+{
+    BaseType_t xResult = CKR_OK;
+    mbedtls_pk_type_t xKeyAlgo = ( mbedtls_pk_type_t ) ~0;
+
+    /* Initialize the mbed contexts. */
+    mbedtls_x509_crt_init( &pxCtx->xMbedX509Cli );
+
+    if( pxCtx->xP11Session == CK_INVALID_HANDLE )
+    {
+        xResult = CKR_SESSION_HANDLE_INVALID;
+        TLS_PRINT( ( "Error: PKCS #11 session was not initialized.\r\n" ) );
+    }
+
+    /* Put the module in authenticated mode. */
+    if( CKR_OK == xResult )
+    {
+        pxCtx->xTLSHandshakeState = TLS_HANDSHAKE_STARTED;
+        xResult = ( BaseType_t ) pxCtx->pxP11FunctionList->C_Login( pxCtx->xP11Session,
+                                                                    CKU_USER,
+                                                                    ( CK_UTF8CHAR_PTR ) configPKCS11_DEFAULT_USER_PIN,
+                                                                    sizeof( configPKCS11_DEFAULT_USER_PIN ) - 1 );
+    }
+
+    /* Get the device private key handle and certificates. */
+    if( CKR_OK == xResult )
+    {
+        xResult = prvClientCredentialAcquire( pxCtx );
+    }
+
+    /* Map the PKCS #11 key type to an mbedTLS algorithm. */
+    if( xResult == CKR_OK )
+    {
+        switch( pxCtx->xKeyType )
+        {
+            case CKK_RSA:
+                xKeyAlgo = MBEDTLS_PK_RSA;
+                break;
+
+            case CKK_EC:
+                xKeyAlgo = MBEDTLS_PK_ECKEY;
+                break;
+
+            default:
+                xResult = CKR_ATTRIBUTE_VALUE_INVALID;
+                break;
+        }
+    }
+
+    /* Map the mbedTLS algorithm to its internal metadata. */
+    if( xResult == CKR_OK )
+    {
+        memcpy( &pxCtx->xMbedPkInfo, mbedtls_pk_info_from_type( xKeyAlgo ), sizeof( mbedtls_pk_info_t ) );
+
+        pxCtx->xMbedPkInfo.sign_func = prvPrivateKeySigningCallback;
+        pxCtx->xMbedPkCtx.pk_info = &pxCtx->xMbedPkInfo;
+        pxCtx->xMbedPkCtx.pk_ctx = pxCtx;
+    }
+
+    /* Attach the client certificate(s) and private key to the TLS configuration. */
+    if( 0 == xResult )
+    {
+        xResult = mbedtls_ssl_conf_own_cert( &pxCtx->xMbedSslConfig,
+                                             pxCtx->pxMbedX509Cli,
+                                             &pxCtx->xMbedPkCtx );
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Interface routines.
+ */
+
+BaseType_t TLS_Init( void ** ppvContext,
+                     TLSParams_t * pxParams )
+{
+    BaseType_t xResult = CKR_OK;
+    int mbedTLSResult = 0;
+    TLSContext_t * pxCtx = NULL;
+    CK_C_GetFunctionList xCkGetFunctionList = NULL;
+
+    /* Allocate an internal context. */
+    pxCtx = ( TLSContext_t * ) pvPortMalloc( sizeof( TLSContext_t ) ); /*lint !e9087 !e9079 Allow casting void* to other types. */
+
+    if( NULL != pxCtx )
+    {
+        memset( pxCtx, 0, sizeof( TLSContext_t ) );
+        *ppvContext = pxCtx;
+
+        /* Initialize the context. */
+        pxCtx->pcDestination = pxParams->pcDestination;
+        pxCtx->usPort = pxParams->usPort;
+        pxCtx->pcServerCertificate = pxParams->pcServerCertificate;
+        pxCtx->ulServerCertificateLength = pxParams->ulServerCertificateLength;
+        pxCtx->ppcAlpnProtocols = pxParams->ppcAlpnProtocols;
+        pxCtx->ulAlpnProtocolsCount = pxParams->ulAlpnProtocolsCount;
+        pxCtx->xNetworkRecv = pxParams->pxNetworkRecv;
+        pxCtx->xNetworkSend = pxParams->pxNetworkSend;
+        pxCtx->pvCallerContext = pxParams->pvCallerContext;
+
+        /* Sessions are cached by server name, so a connection without SNI
+         * always performs a full handshake. */
+        if( ( pdFALSE == pxParams->xDisableSessionCache ) &&
+            ( NULL != pxParams->pcDestination ) )
+        {
+            pxCtx->xSessionCache = pdTRUE;
+        }
+
+        /* Get the function pointer list for the PKCS#11 module. */
+        xCkGetFunctionList = C_GetFunctionList;
+        xResult = ( BaseType_t ) xCkGetFunctionList( &pxCtx->pxP11FunctionList );
+
+        /* Ensure that the PKCS #11 module is initialized and create a session. */
+        if( xResult == CKR_OK )
+        {
+            xResult = xInitializePkcs11Session( &pxCtx->xP11Session );
+
+            /* It is ok if the module was previously initialized. */
+            if( xResult == CKR_CRYPTOKI_ALREADY_INITIALIZED )
+            {
                 xResult = CKR_OK;
             }
         }
@@ -797,53 +2253,20 @@ BaseType_t TLS_Connect( void * pvContext )
     BaseType_t xResult = 0;
     TLSContext_t * pxCtx = ( TLSContext_t * ) pvContext; /*lint !e9087 !e9079 Allow casting void* to other types. */
 
+    #if ( tlsconfigSTATISTICS == 1 )
+        uint32_t ulStartUs = tlsconfigSTATISTICS_TIME_US();
+        uint32_t ulStepUs = 0;
+        uint32_t ulNetworkWaitUs = 0;
+        int lState = 0;
+    #endif
+
     /* Initialize mbedTLS structures. */
     mbedtls_ssl_init( &pxCtx->xMbedSslCtx );
     mbedtls_ssl_config_init( &pxCtx->xMbedSslConfig );
     mbedtls_x509_crt_init( &pxCtx->xMbedX509CA );
 
-    /* Decode the root certificate: either the default or the override. */
-    if( NULL != pxCtx->pcServerCertificate )
-    {
-        xResult = mbedtls_x509_crt_parse( &pxCtx->xMbedX509CA,
-                                          ( const unsigned char * ) pxCtx->pcServerCertificate,
-                                          pxCtx->ulServerCertificateLength );
-
-        if( 0 != xResult )
-        {
-            TLS_PRINT( ( "ERROR: Failed to parse custom server certificates %s : %s \r\n",
-                         mbedtlsHighLevelCodeOrDefault( xResult ),
-                         mbedtlsLowLevelCodeOrDefault( xResult ) ) );
-        }
-    }
-    else
-    {
-        xResult = mbedtls_x509_crt_parse( &pxCtx->xMbedX509CA,
-                                          ( const unsigned char * ) tlsVERISIGN_ROOT_CERTIFICATE_PEM,
-                                          tlsVERISIGN_ROOT_CERTIFICATE_LENGTH );
-
-        if( 0 == xResult )
-        {
-            xResult = mbedtls_x509_crt_parse( &pxCtx->xMbedX509CA,
-                                              ( const unsigned char * ) tlsATS1_ROOT_CERTIFICATE_PEM,
-                                              tlsATS1_ROOT_CERTIFICATE_LENGTH );
-
-            if( 0 == xResult )
-            {
-                xResult = mbedtls_x509_crt_parse( &pxCtx->xMbedX509CA,
-                                                  ( const unsigned char * ) tlsSTARFIELD_ROOT_CERTIFICATE_PEM,
-                                                  tlsSTARFIELD_ROOT_CERTIFICATE_LENGTH );
-            }
-        }
-
-        if( 0 != xResult )
-        {
-            /* Default root certificates should be in aws_default_root_certificate.h */
-            TLS_PRINT( ( "ERROR: Failed to parse default server certificates %s : %s \r\n",
-                         mbedtlsHighLevelCodeOrDefault( xResult ),
-                         mbedtlsLowLevelCodeOrDefault( xResult ) ) );
-        }
-    }
+    /* Get the root certificates to trust: either the default or the override. */
+    xResult = prvTrustStoreAcquire( pxCtx );
 
     /* Start with protocol defaults. */
     if( 0 == xResult )
@@ -875,12 +2298,22 @@ BaseType_t TLS_Connect( void * pvContext )
         mbedtls_ssl_conf_rng( &pxCtx->xMbedSslConfig, &prvGenerateRandomBytes, pxCtx ); /*lint !e546 Nothing wrong here. */
 
         /* Set issuer certificate. */
-        mbedtls_ssl_conf_ca_chain( &pxCtx->xMbedSslConfig, &pxCtx->xMbedX509CA, NULL );
+        mbedtls_ssl_conf_ca_chain( &pxCtx->xMbedSslConfig, pxCtx->pxMbedX509CA, NULL );
 
         /* Configure the SSL context for the device credentials. */
         xResult = prvInitializeClientCredential( pxCtx );
     }
 
+    #if ( tlsMAX_FRAGMENT_LENGTH != MBEDTLS_SSL_MAX_FRAG_LEN_NONE )
+        /* Ask the server not to send records larger than the incoming record
+         * buffer. */
+        if( 0 == xResult )
+        {
+            xResult = mbedtls_ssl_conf_max_frag_len( &pxCtx->xMbedSslConfig,
+                                                     tlsMAX_FRAGMENT_LENGTH );
+        }
+    #endif
+
     if( ( 0 == xResult ) && ( NULL != pxCtx->ppcAlpnProtocols ) )
     {
         /* Include an application protocol list in the TLS ClientHello
@@ -910,6 +2343,15 @@ BaseType_t TLS_Connect( void * pvContext )
         xResult = mbedtls_ssl_set_hostname( &pxCtx->xMbedSslCtx, pxCtx->pcDestination );
     }
 
+    #if ( tlsconfigSESSION_CACHE_ENTRIES > 0 )
+        /* Offer a cached session to skip the certificate exchange and the
+         * private key signature. */
+        if( ( 0 == xResult ) && ( pdTRUE == pxCtx->xSessionCache ) )
+        {
+            prvSessionResume( pxCtx );
+        }
+    #endif
+
     /* Set the socket callbacks. */
     if( 0 == xResult )
     {
@@ -919,10 +2361,34 @@ BaseType_t TLS_Connect( void * pvContext )
                              prvNetworkRecv,
                              NULL );
 
-        /* Negotiate. */
-        while( 0 != ( xResult = mbedtls_ssl_handshake( &pxCtx->xMbedSslCtx ) ) )
+        #if ( tlsconfigSTATISTICS == 1 )
+            ulStepUs = tlsconfigSTATISTICS_TIME_US();
+            pxCtx->xStatistics.ulSetupUs = ulStepUs - ulStartUs;
+            pxCtx->xStatistics.xResumed = pxCtx->xSessionOffered;
+            ulStartUs = ulStepUs;
+        #endif
+
+        /* Negotiate, one handshake message at a time so that the phases can
+         * be timed. */
+        while( MBEDTLS_SSL_HANDSHAKE_OVER != pxCtx->xMbedSslCtx.state )
         {
-            if( ( MBEDTLS_ERR_SSL_WANT_READ != xResult ) &&
+            #if ( tlsconfigSTATISTICS == 1 )
+                lState = pxCtx->xMbedSslCtx.state;
+                ulNetworkWaitUs = pxCtx->xStatistics.ulNetworkWaitUs;
+                ulStepUs = tlsconfigSTATISTICS_TIME_US();
+            #endif
+
+            xResult = mbedtls_ssl_handshake_step( &pxCtx->xMbedSslCtx );
+
+            #if ( tlsconfigSTATISTICS == 1 )
+                prvStatisticsHandshakeStep( pxCtx,
+                                            lState,
+                                            tlsconfigSTATISTICS_TIME_US() - ulStepUs,
+                                            pxCtx->xStatistics.ulNetworkWaitUs - ulNetworkWaitUs );
+            #endif
+
+            if( ( 0 != xResult ) &&
+                ( MBEDTLS_ERR_SSL_WANT_READ != xResult ) &&
                 ( MBEDTLS_ERR_SSL_WANT_WRITE != xResult ) )
             {
                 /* There was an unexpected error. Per mbedTLS API documentation,
@@ -935,12 +2401,23 @@ BaseType_t TLS_Connect( void * pvContext )
                 break;
             }
         }
+
+        #if ( tlsconfigSTATISTICS == 1 )
+            pxCtx->xStatistics.ulHandshakeUs = tlsconfigSTATISTICS_TIME_US() - ulStartUs;
+        #endif
     }
 
     /* Keep track of successful completion of the handshake. */
     if( 0 == xResult )
     {
         pxCtx->xTLSHandshakeState = TLS_HANDSHAKE_SUCCESSFUL;
+
+        #if ( tlsconfigSESSION_CACHE_ENTRIES > 0 )
+            if( pdTRUE == pxCtx->xSessionCache )
+            {
+                prvSessionSave( pxCtx );
+            }
+        #endif
     }
     else if( xResult > 0 )
     {
@@ -949,7 +2426,28 @@ BaseType_t TLS_Connect( void * pvContext )
         xResult = TLS_ERROR_HANDSHAKE_FAILED;
     }
 
+    #if ( tlsconfigSESSION_CACHE_ENTRIES > 0 )
+        /* Do not offer a session again that failed to resume. */
+        if( ( 0 != xResult ) && ( pdTRUE == pxCtx->xSessionOffered ) )
+        {
+            prvSessionDiscard( pxCtx );
+        }
+    #endif
+
+    #if ( tlsconfigSTATISTICS == 1 )
+        if( 0 != xResult )
+        {
+            pxCtx->xStatistics.xResumed = pdFALSE;
+        }
+    #endif
+
+    #if tlsENDPOINT_STATISTICS
+        prvEndpointAddHandshake( pxCtx, xResult );
+    #endif
+
     /* Free up allocated memory. */
+    prvTrustStoreRelease( pxCtx );
+    prvClientCredentialRelease( pxCtx );
     mbedtls_x509_crt_free( &pxCtx->xMbedX509CA );
     mbedtls_x509_crt_free( &pxCtx->xMbedX509Cli );
 
@@ -969,7 +2467,10 @@ BaseType_t TLS_Recv( void * pvContext,
     if( ( NULL != pxCtx ) && ( TLS_HANDSHAKE_SUCCESSFUL == pxCtx->xTLSHandshakeState ) )
     {
         /* This routine will return however many bytes are returned from from mbedtls_ssl_read
-         * immediately unless MBEDTLS_ERR_SSL_WANT_READ is returned, in which case we try again. */
+         * immediately unless MBEDTLS_ERR_SSL_WANT_READ is returned, in which case we try again,
+         * unless a non-blocking socket had nothing to read. */
+        pxCtx->xNetworkWouldBlock = pdFALSE;
+
         do
         {
             xResult = mbedtls_ssl_read( &pxCtx->xMbedSslCtx,
@@ -985,7 +2486,13 @@ BaseType_t TLS_Recv( void * pvContext,
             /* If xResult == 0, then no data was received (and there is no error).
              * The secure sockets API supports non-blocking read, so stop the loop,
              * but don't flag an error. */
-        } while( ( xResult == MBEDTLS_ERR_SSL_WANT_READ ) );
+        } while( ( xResult == MBEDTLS_ERR_SSL_WANT_READ ) &&
+                 ( pdFALSE == pxCtx->xNetworkWouldBlock ) );
+
+        if( MBEDTLS_ERR_SSL_WANT_READ == xResult )
+        {
+            xResult = -pdFREERTOS_ERRNO_EWOULDBLOCK;
+        }
     }
     else
     {
@@ -995,8 +2502,12 @@ BaseType_t TLS_Recv( void * pvContext,
     if( xResult >= 0 )
     {
         xResult = ( BaseType_t ) xRead;
+
+        #if ( tlsconfigSTATISTICS == 1 )
+            pxCtx->xStatistics.ulAppBytesReceived += ( uint32_t ) xRead;
+        #endif
     }
-    else
+    else if( -pdFREERTOS_ERRNO_EWOULDBLOCK != xResult )
     {
         /* xResult < 0 is a hard error, so invalidate the context and stop. */
         prvFreeContext( pxCtx );
@@ -1017,6 +2528,8 @@ BaseType_t TLS_Send( void * pvContext,
 
     if( ( NULL != pxCtx ) && ( TLS_HANDSHAKE_SUCCESSFUL == pxCtx->xTLSHandshakeState ) )
     {
+        pxCtx->xNetworkWouldBlock = pdFALSE;
+
         while( xWritten < xMsgLength )
         {
             xResult = mbedtls_ssl_write( &pxCtx->xMbedSslCtx,
@@ -1036,6 +2549,14 @@ BaseType_t TLS_Send( void * pvContext,
                 xResult = 0;
                 break;
             }
+            else if( ( MBEDTLS_ERR_SSL_WANT_WRITE == xResult ) &&
+                     ( pdTRUE == pxCtx->xNetworkWouldBlock ) )
+            {
+                /* A non-blocking socket is full. mbedTLS holds the rest of
+                 * the record until the same data is written again. */
+                xResult = ( 0U == xWritten ) ? -pdFREERTOS_ERRNO_EWOULDBLOCK : 0;
+                break;
+            }
             else if( MBEDTLS_ERR_SSL_WANT_WRITE != xResult )
             {
                 /* Hard error: invalidate the context and stop. */
@@ -1052,6 +2573,30 @@ BaseType_t TLS_Send( void * pvContext,
     if( 0 <= xResult )
     {
         xResult = ( BaseType_t ) xWritten;
+
+        #if ( tlsconfigSTATISTICS == 1 )
+            pxCtx->xStatistics.ulAppBytesSent += ( uint32_t ) xWritten;
+        #endif
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Pending( void * pvContext )
+{
+    BaseType_t xResult = pdFALSE;
+    TLSContext_t * pxCtx = ( TLSContext_t * ) pvContext; /*lint !e9087 !e9079 Allow casting void* to other types. */
+
+    if( ( NULL != pxCtx ) && ( TLS_HANDSHAKE_SUCCESSFUL == pxCtx->xTLSHandshakeState ) )
+    {
+        /* Covers both decrypted data not yet read and records that were
+         * received but not yet processed. */
+        if( mbedtls_ssl_check_pending( &pxCtx->xMbedSslCtx ) != 0 )
+        {
+            xResult = pdTRUE;
+        }
     }
 
     return xResult;
@@ -1065,9 +2610,219 @@ void TLS_Cleanup( void * pvContext )
 
     if( NULL != pxCtx )
     {
+        #if tlsENDPOINT_STATISTICS
+            prvEndpointAddTraffic( pxCtx );
+        #endif
+
         prvFreeContext( pxCtx );
 
         /* Free memory. */
         vPortFree( pxCtx );
     }
 }
+
+/*-----------------------------------------------------------*/
+
+void TLS_FlushSessionCache( void )
+{
+    #if ( tlsconfigSESSION_CACHE_ENTRIES > 0 )
+        size_t xIndex = 0;
+
+        prvSharedStateLock();
+
+        for( xIndex = 0; xIndex < tlsconfigSESSION_CACHE_ENTRIES; xIndex++ )
+        {
+            if( pdTRUE == xSessionCache[ xIndex ].xInUse )
+            {
+                prvSessionCacheFree( &xSessionCache[ xIndex ] );
+            }
+        }
+
+        prvSharedStateUnlock();
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+void TLS_InvalidateClientCredential( void )
+{
+    #if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 )
+        prvSharedStateLock();
+        prvClientCredentialInvalidate();
+        prvSharedStateUnlock();
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Prepare( const char * pcServerCertificate,
+                        uint32_t ulServerCertificateLength )
+{
+    BaseType_t xResult = CKR_OK;
+
+    #if ( tlsconfigTRUST_STORE_ENTRIES > 0 ) || ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 )
+        TLSContext_t * pxCtx = NULL;
+    #endif
+
+    #if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 )
+        BaseType_t xLoadCredential = pdFALSE;
+        CK_C_GetFunctionList xCkGetFunctionList = NULL;
+    #endif
+
+    #if ( tlsconfigTRUST_STORE_ENTRIES > 0 ) || ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 )
+
+        /* The credentials are loaded through a context of their own, which
+         * is only used to reference the shared state. */
+        pxCtx = ( TLSContext_t * ) pvPortMalloc( sizeof( TLSContext_t ) ); /*lint !e9087 !e9079 Allow casting void* to other types. */
+
+        if( NULL != pxCtx )
+        {
+            memset( pxCtx, 0, sizeof( TLSContext_t ) );
+            pxCtx->pcServerCertificate = pcServerCertificate;
+            pxCtx->ulServerCertificateLength = ulServerCertificateLength;
+            mbedtls_x509_crt_init( &pxCtx->xMbedX509CA );
+            mbedtls_x509_crt_init( &pxCtx->xMbedX509Cli );
+        }
+        else
+        {
+            xResult = ( BaseType_t ) CKR_HOST_MEMORY;
+        }
+
+        #if ( tlsconfigTRUST_STORE_ENTRIES > 0 )
+            if( CKR_OK == xResult )
+            {
+                xResult = prvTrustStoreAcquire( pxCtx );
+                prvTrustStoreRelease( pxCtx );
+            }
+        #endif
+
+        #if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 )
+            /* Only open a PKCS #11 session when the credentials are not
+             * loaded yet. */
+            if( CKR_OK == xResult )
+            {
+                prvSharedStateLock();
+                xLoadCredential = ( pdFALSE == xClientCredential.xLoaded ) ? pdTRUE : pdFALSE;
+                prvSharedStateUnlock();
+            }
+
+            if( pdTRUE == xLoadCredential )
+            {
+                xCkGetFunctionList = C_GetFunctionList;
+                xResult = ( BaseType_t ) xCkGetFunctionList( &pxCtx->pxP11FunctionList );
+
+                if( CKR_OK == xResult )
+                {
+                    xResult = xInitializePkcs11Session( &pxCtx->xP11Session );
+
+                    /* It is ok if the module was previously initialized. */
+                    if( CKR_CRYPTOKI_ALREADY_INITIALIZED == xResult )
+                    {
+                        xResult = CKR_OK;
+                    }
+                }
+
+                if( CKR_OK == xResult )
+                {
+                    xResult = ( BaseType_t ) pxCtx->pxP11FunctionList->C_Login( pxCtx->xP11Session,
+                                                                                CKU_USER,
+                                                                                ( CK_UTF8CHAR_PTR ) configPKCS11_DEFAULT_USER_PIN,
+                                                                                sizeof( configPKCS11_DEFAULT_USER_PIN ) - 1 );
+                }
+
+                if( CKR_OK == xResult )
+                {
+                    xResult = prvClientCredentialAcquire( pxCtx );
+                    prvClientCredentialRelease( pxCtx );
+                }
+
+                if( ( NULL != pxCtx->pxP11FunctionList ) &&
+                    ( NULL != pxCtx->pxP11FunctionList->C_CloseSession ) &&
+                    ( CK_INVALID_HANDLE != pxCtx->xP11Session ) )
+                {
+                    pxCtx->pxP11FunctionList->C_CloseSession( pxCtx->xP11Session ); /*lint !e534 This function always return CKR_OK. */
+                }
+            }
+        #endif /* if ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 ) */
+
+        if( NULL != pxCtx )
+        {
+            /* Only set if the shared state was in use for other credentials. */
+            mbedtls_x509_crt_free( &pxCtx->xMbedX509CA );
+            mbedtls_x509_crt_free( &pxCtx->xMbedX509Cli );
+            vPortFree( pxCtx );
+        }
+    #else /* if ( tlsconfigTRUST_STORE_ENTRIES > 0 ) || ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 ) */
+        ( void ) pcServerCertificate;
+        ( void ) ulServerCertificateLength;
+    #endif /* if ( tlsconfigTRUST_STORE_ENTRIES > 0 ) || ( tlsconfigCLIENT_CREDENTIAL_CACHE > 0 ) */
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_GetStatistics( void * pvContext,
+                              TLSStatistics_t * pxStatistics )
+{
+    BaseType_t xResult = pdFAIL;
+
+    #if ( tlsconfigSTATISTICS == 1 )
+        TLSContext_t * pxCtx = ( TLSContext_t * ) pvContext; /*lint !e9087 !e9079 Allow casting void* to other types. */
+
+        if( ( NULL != pxCtx ) && ( NULL != pxStatistics ) )
+        {
+            *pxStatistics = pxCtx->xStatistics;
+            xResult = pdPASS;
+        }
+    #else
+        ( void ) pvContext;
+        ( void ) pxStatistics;
+    #endif
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t TLS_GetEndpointStatistics( TLSEndpointStatistics_t * pxEndpoints,
+                                  size_t xMaxEndpoints )
+{
+    size_t xCount = 0;
+
+    #if tlsENDPOINT_STATISTICS
+        size_t xIndex = 0;
+
+        if( NULL != pxEndpoints )
+        {
+            prvSharedStateLock();
+
+            for( xIndex = 0; ( xIndex < tlsconfigSTATISTICS_ENDPOINTS ) && ( xCount < xMaxEndpoints ); xIndex++ )
+            {
+                if( pdTRUE == xEndpoints[ xIndex ].xInUse )
+                {
+                    pxEndpoints[ xCount ] = xEndpoints[ xIndex ].xStatistics;
+                    xCount++;
+                }
+            }
+
+            prvSharedStateUnlock();
+        }
+    #else
+        ( void ) pxEndpoints;
+        ( void ) xMaxEndpoints;
+    #endif
+
+    return xCount;
+}
+
+/*-----------------------------------------------------------*/
+
+void TLS_ResetEndpointStatistics( void )
+{
+    #if tlsENDPOINT_STATISTICS
+        prvSharedStateLock();
+        memset( xEndpoints, 0, sizeof( xEndpoints ) );
+        prvSharedStateUnlock();
+    #endif
+}
@@ -33,6 +33,10 @@
 /* Secure sockets includes */
 #include "iot_secure_sockets.h"
 
+/* TLS includes. */
+#include "FreeRTOS.h"
+#include "iot_tls.h"
+
 /* Credential includes. */
 #include "aws_clientcredential.h"
 #include "aws_clientcredential_keys.h"
@@ -85,10 +89,17 @@ TEST_TEAR_DOWN( Full_TLS )
 TEST_GROUP_RUNNER( Full_TLS )
 {
     RUN_TEST_CASE( Full_TLS, AFQP_TLS_ConnectDefault );
+    #if ( tlsconfigSTATISTICS == 1 ) && ( tlsconfigSTATISTICS_ENDPOINTS > 0 )
+        #if ( tlsconfigSESSION_CACHE_ENTRIES > 0 )
+            RUN_TEST_CASE( Full_TLS, AFQP_TLS_ConnectResumeSession );
+        #endif
+        RUN_TEST_CASE( Full_TLS, AFQP_TLS_EndpointStatistics );
+    #endif
     #if ( pkcs11configIMPORT_PRIVATE_KEYS_SUPPORTED == 1 )
         #if ( pkcs11testEC_KEY_SUPPORT == 1 )
             RUN_TEST_CASE( Full_TLS, AFQP_TLS_ConnectEC );
             RUN_TEST_CASE( Full_TLS, AFQP_TLS_ConnectBYOCCredentials );
+            RUN_TEST_CASE( Full_TLS, AFQP_TLS_ConnectAfterReprovisioning );
         #endif
         RUN_TEST_CASE( Full_TLS, AFQP_TLS_ConnectMalformedCert );
         RUN_TEST_CASE( Full_TLS, AFQP_TLS_ConnectUntrustedCert );
@@ -277,7 +288,7 @@ static void prvExpectFailAfterDataSentWithProvisioning( ProvisioningParams_t * p
 }
 /*-----------------------------------------------------------*/
 
-TEST( Full_TLS, AFQP_TLS_ConnectDefault )
+static void prvConnectDefault( void )
 {
     const char * pcAWSIoTAddress = clientcredentialMQTT_BROKER_ENDPOINT;
     uint16_t usAWSIoTPort = clientcredentialMQTT_BROKER_PORT;
@@ -307,6 +318,58 @@ TEST( Full_TLS, AFQP_TLS_ConnectDefault )
 }
 /*-----------------------------------------------------------*/
 
+TEST( Full_TLS, AFQP_TLS_ConnectDefault )
+{
+    prvConnectDefault();
+}
+/*-----------------------------------------------------------*/
+
+#if ( tlsconfigSTATISTICS == 1 ) && ( tlsconfigSTATISTICS_ENDPOINTS > 0 ) && ( tlsconfigSESSION_CACHE_ENTRIES > 0 )
+    TEST( Full_TLS, AFQP_TLS_ConnectResumeSession )
+    {
+        TLSEndpointStatistics_t xEndpoint;
+
+        /* The first connection caches the session. */
+        prvConnectDefault();
+
+        /* The second one offers it back, and the server accepts it. */
+        TLS_ResetEndpointStatistics();
+        prvConnectDefault();
+
+        TEST_ASSERT_EQUAL_UINT32( 1, TLS_GetEndpointStatistics( &xEndpoint, 1 ) );
+        TEST_ASSERT_EQUAL_UINT32( 1, xEndpoint.ulHandshakes );
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE( 1, xEndpoint.ulResumed, "The second handshake did not resume the session" );
+    }
+/*-----------------------------------------------------------*/
+#endif /* if ( tlsconfigSTATISTICS == 1 ) && ( tlsconfigSTATISTICS_ENDPOINTS > 0 ) && ( tlsconfigSESSION_CACHE_ENTRIES > 0 ) */
+
+#if ( tlsconfigSTATISTICS == 1 ) && ( tlsconfigSTATISTICS_ENDPOINTS > 0 )
+    TEST( Full_TLS, AFQP_TLS_EndpointStatistics )
+    {
+        TLSEndpointStatistics_t xEndpoint;
+        size_t xCount;
+
+        TLS_ResetEndpointStatistics();
+        prvConnectDefault();
+
+        /* The connection is summarized under the server name. */
+        xCount = TLS_GetEndpointStatistics( &xEndpoint, 1 );
+        TEST_ASSERT_EQUAL_UINT32( 1, xCount );
+        TEST_ASSERT_EQUAL_STRING_LEN( clientcredentialMQTT_BROKER_ENDPOINT,
+                                      xEndpoint.cDestination,
+                                      tlsconfigSTATISTICS_NAME_LENGTH - 1 );
+        TEST_ASSERT_EQUAL_UINT32( 1, xEndpoint.ulHandshakes );
+        TEST_ASSERT_EQUAL_UINT32( 0, xEndpoint.ulFailures );
+        TEST_ASSERT_NOT_EQUAL( 0, xEndpoint.ulRecordsSent );
+        TEST_ASSERT_NOT_EQUAL( 0, xEndpoint.ulRecordsReceived );
+        TEST_ASSERT_TRUE( xEndpoint.ullBytesSent > xEndpoint.ullAppBytesSent );
+
+        TLS_ResetEndpointStatistics();
+        TEST_ASSERT_EQUAL_UINT32( 0, TLS_GetEndpointStatistics( &xEndpoint, 1 ) );
+    }
+/*-----------------------------------------------------------*/
+#endif /* if ( tlsconfigSTATISTICS == 1 ) && ( tlsconfigSTATISTICS_ENDPOINTS > 0 ) */
+
 TEST( Full_TLS, AFQP_TLS_ConnectEC )
 {
     ProvisioningParams_t xParams;
@@ -325,6 +388,65 @@ TEST( Full_TLS, AFQP_TLS_ConnectEC )
 }
 /*-----------------------------------------------------------*/
 
+#if ( pkcs11configIMPORT_PRIVATE_KEYS_SUPPORTED == 1 ) && ( pkcs11testEC_KEY_SUPPORT == 1 )
+    TEST( Full_TLS, AFQP_TLS_ConnectAfterReprovisioning )
+    {
+        CK_RV xResult;
+        CK_FUNCTION_LIST_PTR pxFunctionList = NULL;
+        CK_SESSION_HANDLE xSession = CK_INVALID_HANDLE;
+        CK_OBJECT_HANDLE xObject = CK_INVALID_HANDLE;
+
+        /* Connect with the default credentials, so that they are cached. */
+        prvConnectDefault();
+
+        if( TEST_PROTECT() )
+        {
+            /* Replace the credentials through PKCS #11 only, which does not
+             * invalidate the cached ones the way xProvisionDevice does. */
+            xResult = C_GetFunctionList( &pxFunctionList );
+            TEST_ASSERT_EQUAL_MESSAGE( CKR_OK, xResult, "Failed to get the PKCS #11 function list." );
+
+            xResult = xInitializePkcs11Session( &xSession );
+            TEST_ASSERT_EQUAL_MESSAGE( CKR_OK, xResult, "Failed to open a PKCS #11 session." );
+
+            xResult = xDestroyDefaultCryptoObjects( xSession );
+            TEST_ASSERT_EQUAL_MESSAGE( CKR_OK, xResult, "Failed to destroy the default credentials." );
+
+            xResult = xProvisionPrivateKey( xSession,
+                                            ( uint8_t * ) tlstestCLIENT_PRIVATE_KEY_PEM_EC,
+                                            tlstestCLIENT_PRIVATE_KEY_LENGTH_EC,
+                                            ( uint8_t * ) pkcs11configLABEL_DEVICE_PRIVATE_KEY_FOR_TLS,
+                                            &xObject );
+            TEST_ASSERT_EQUAL_MESSAGE( CKR_OK, xResult, "Failed to import the P-256 private key." );
+
+            xResult = xProvisionCertificate( xSession,
+                                             ( uint8_t * ) tlstestCLIENT_CERTIFICATE_PEM_EC,
+                                             tlstestCLIENT_CERTIFICATE_LENGTH_EC,
+                                             ( uint8_t * ) pkcs11configLABEL_DEVICE_CERTIFICATE_FOR_TLS,
+                                             &xObject );
+            TEST_ASSERT_EQUAL_MESSAGE( CKR_OK, xResult, "Failed to import the P-256 certificate." );
+
+            /* The handshake only succeeds with the new key and certificate. */
+            prvConnectDefault();
+        }
+        else
+        {
+            TEST_FAIL();
+        }
+
+        if( ( NULL != pxFunctionList ) && ( CK_INVALID_HANDLE != xSession ) )
+        {
+            ( void ) pxFunctionList->C_CloseSession( xSession );
+        }
+
+        /* Restore the default credentials for the tests that follow, and
+         * check that they are read again too. */
+        vDevModeKeyProvisioning();
+        prvConnectDefault();
+    }
+/*-----------------------------------------------------------*/
+#endif /* if ( pkcs11configIMPORT_PRIVATE_KEYS_SUPPORTED == 1 ) && ( pkcs11testEC_KEY_SUPPORT == 1 ) */
+
 TEST( Full_TLS, AFQP_TLS_ConnectMalformedCert )
 {
     ProvisioningParams_t xParams;
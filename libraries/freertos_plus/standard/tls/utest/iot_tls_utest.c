@@ -0,0 +1,418 @@
+/*
+ * FreeRTOS TLS V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "portableDefs.h"
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+
+#include "mock_task.h"
+#include "mock_queue.h"
+#include "mock_portable.h"
+#include "mock_iot_pkcs11.h"
+#include "mock_iot_pki_utils.h"
+#include "mock_ctr_drbg.h"
+#include "mock_debug.h"
+#include "mock_pk.h"
+#include "mock_sha256.h"
+#include "mock_ssl.h"
+#include "mock_x509_crt.h"
+
+#include "iot_tls.h"
+
+#define MAX_CERTIFICATES    16
+#define MAX_FREES           32
+#define MAX_HANDSHAKES      2
+
+/* The trust stores are looked up by a hash of the certificates, which the
+ * mocked hash takes from their first bytes. Every testcase uses certificates
+ * of its own, because the stores outlive the testcases. */
+static const char share_cert[] = "share";
+static const char evict_cert_a[] = "evict a";
+static const char evict_cert_b[] = "evict b";
+static const char evict_cert_c[] = "evict c";
+static const char full_cert_a[] = "full a";
+static const char full_cert_b[] = "full b";
+static const char full_cert_c[] = "full c";
+static const char bad_cert[] = "bad";
+static const char good_cert[] = "good";
+
+/* ============================  GLOBAL VARIABLES =========================== */
+
+static uint16_t malloc_free_calls = 0;
+
+/* Number of times each certificate was parsed. */
+static const unsigned char * parsed_certs[ MAX_CERTIFICATES ];
+static int parse_calls[ MAX_CERTIFICATES ];
+static size_t parsed_cert_count = 0;
+
+/* Chains freed by the testcase, in order. */
+static mbedtls_x509_crt * freed_chains[ MAX_FREES ];
+static size_t freed_chain_count = 0;
+
+/* Root certificates of the handshakes in progress, outermost first, and the
+ * number of chains freed when each handshake got them. */
+static mbedtls_x509_crt * handshake_chains[ MAX_HANDSHAKES ];
+static size_t handshake_frees[ MAX_HANDSHAKES ];
+static int handshake_depth = 0;
+
+/* Called by each handshake once it has its root certificates. */
+static void ( * during_handshake )( int depth ) = NULL;
+
+static CK_FUNCTION_LIST pkcs11_function_list;
+
+/* ==========================  CALLBACK FUNCTIONS =========================== */
+/*@null@*/ void * malloc_cb( size_t size,
+                             int numCalls )
+{
+    malloc_free_calls++;
+    return ( void * ) malloc( size );
+}
+
+void free_cb( void * ptr,
+              int numCalls )
+{
+    malloc_free_calls--;
+    free( ptr );
+}
+
+static QueueHandle_t xQueueCreateMutexStatic_cb( const uint8_t ucQueueType,
+                                                 StaticQueue_t * pxStaticQueue,
+                                                 int numCalls )
+{
+    return ( QueueHandle_t ) pxStaticQueue;
+}
+
+static int mbedtls_sha256_ret_cb( const unsigned char * input,
+                                  size_t ilen,
+                                  unsigned char output[ 32 ],
+                                  int is224,
+                                  int numCalls )
+{
+    memset( output, 0, 32 );
+    memcpy( output, input, ( ilen < 32 ) ? ilen : 32 );
+    return 0;
+}
+
+static int mbedtls_x509_crt_parse_cb( mbedtls_x509_crt * chain,
+                                      const unsigned char * buf,
+                                      size_t buflen,
+                                      int numCalls )
+{
+    size_t i = 0;
+
+    while( ( i < parsed_cert_count ) && ( parsed_certs[ i ] != buf ) )
+    {
+        i++;
+    }
+
+    if( i == parsed_cert_count )
+    {
+        TEST_ASSERT_LESS_THAN( MAX_CERTIFICATES, parsed_cert_count );
+        parsed_certs[ i ] = buf;
+        parsed_cert_count++;
+    }
+
+    parse_calls[ i ]++;
+
+    return ( ( const unsigned char * ) bad_cert == buf ) ? MBEDTLS_ERR_X509_INVALID_FORMAT : 0;
+}
+
+static void mbedtls_x509_crt_free_cb( mbedtls_x509_crt * crt,
+                                      int numCalls )
+{
+    TEST_ASSERT_LESS_THAN( MAX_FREES, freed_chain_count );
+    freed_chains[ freed_chain_count ] = crt;
+    freed_chain_count++;
+}
+
+/* The root certificates stay in use until the handshake is over. */
+static void mbedtls_ssl_conf_ca_chain_cb( mbedtls_ssl_config * conf,
+                                          mbedtls_x509_crt * ca_chain,
+                                          mbedtls_x509_crl * ca_crl,
+                                          int numCalls )
+{
+    TEST_ASSERT_LESS_THAN( MAX_HANDSHAKES, handshake_depth );
+
+    handshake_chains[ handshake_depth ] = ca_chain;
+    handshake_frees[ handshake_depth ] = freed_chain_count;
+    handshake_depth++;
+
+    if( NULL != during_handshake )
+    {
+        during_handshake( handshake_depth );
+    }
+
+    handshake_depth--;
+}
+
+/* The PKCS #11 function list is not in a mocked header. */
+CK_RV C_GetFunctionList( CK_FUNCTION_LIST_PTR_PTR ppFunctionList )
+{
+    *ppFunctionList = &pkcs11_function_list;
+    return CKR_OK;
+}
+
+/* The critical section macros of the port are not in a mocked header. */
+void vPortEnterCritical( void )
+{
+}
+
+void vPortExitCritical( void )
+{
+}
+
+/* ============================   UNITY FIXTURES ============================ */
+void setUp( void )
+{
+    pvPortMalloc_Stub( malloc_cb );
+    vPortFree_Stub( free_cb );
+    xQueueCreateMutexStatic_Stub( xQueueCreateMutexStatic_cb );
+    xQueueSemaphoreTake_IgnoreAndReturn( pdTRUE );
+    xQueueGenericSend_IgnoreAndReturn( pdTRUE );
+
+    /* The PKCS #11 session is left invalid, so handshakes stop at the client
+     * credentials, after the root certificates are in use. */
+    xInitializePkcs11Session_IgnoreAndReturn( CKR_OK );
+    mbedtls_ctr_drbg_init_Ignore();
+    mbedtls_ctr_drbg_seed_IgnoreAndReturn( 0 );
+    mbedtls_ctr_drbg_free_Ignore();
+
+    mbedtls_ssl_init_Ignore();
+    mbedtls_ssl_config_init_Ignore();
+    mbedtls_ssl_config_defaults_IgnoreAndReturn( 0 );
+    mbedtls_ssl_conf_verify_Ignore();
+    mbedtls_ssl_conf_authmode_Ignore();
+    mbedtls_ssl_conf_rng_Ignore();
+    mbedtls_ssl_conf_ca_chain_Stub( mbedtls_ssl_conf_ca_chain_cb );
+    mbedtls_ssl_close_notify_IgnoreAndReturn( 0 );
+    mbedtls_ssl_free_Ignore();
+    mbedtls_ssl_config_free_Ignore();
+
+    mbedtls_sha256_ret_Stub( mbedtls_sha256_ret_cb );
+    mbedtls_x509_crt_init_Ignore();
+    mbedtls_x509_crt_parse_Stub( mbedtls_x509_crt_parse_cb );
+    mbedtls_x509_crt_free_Stub( mbedtls_x509_crt_free_cb );
+
+    malloc_free_calls = 0;
+    parsed_cert_count = 0;
+    memset( parse_calls, 0, sizeof( parse_calls ) );
+    freed_chain_count = 0;
+    handshake_depth = 0;
+    during_handshake = NULL;
+}
+
+/* called before each testcase */
+void tearDown( void )
+{
+    TEST_ASSERT_EQUAL_INT_MESSAGE( 0, malloc_free_calls,
+                                   "free is not called the same number of times as malloc, \
+            you might have a memory leak!!" );
+}
+
+/* called at the beginning of the whole suite */
+void suiteSetUp()
+{
+}
+
+/* called at the end of the whole suite */
+int suiteTearDown( int numFailures )
+{
+    return( numFailures > 0 );
+}
+
+/* ==========================  Helper functions  ============================ */
+
+/* number of times a certificate was parsed */
+static int parseCount( const char * cert )
+{
+    size_t i;
+    int count = 0;
+
+    for( i = 0; i < parsed_cert_count; i++ )
+    {
+        if( ( const unsigned char * ) cert == parsed_certs[ i ] )
+        {
+            count = parse_calls[ i ];
+        }
+    }
+
+    return count;
+}
+
+/* whether the root certificates of a handshake were freed while in use */
+static bool handshakeChainFreed( int depth )
+{
+    size_t i;
+    bool freed = false;
+
+    for( i = handshake_frees[ depth ]; i < freed_chain_count; i++ )
+    {
+        if( handshake_chains[ depth ] == freed_chains[ i ] )
+        {
+            freed = true;
+        }
+    }
+
+    return freed;
+}
+
+/* run a handshake that trusts the given certificates, and clean it up */
+static BaseType_t handshake( const char * cert,
+                             uint32_t length )
+{
+    void * ctx = NULL;
+    TLSParams_t params;
+    BaseType_t ret;
+
+    memset( &params, 0, sizeof( params ) );
+    params.ulSize = sizeof( params );
+    params.pcServerCertificate = cert;
+    params.ulServerCertificateLength = length;
+
+    TEST_ASSERT_EQUAL_INT( CKR_OK, TLS_Init( &ctx, &params ) );
+    ret = TLS_Connect( ctx );
+    TLS_Cleanup( ctx );
+
+    return ret;
+}
+
+/* =======================  TESTING the trust stores  ======================= */
+
+/*!
+ * @brief Handshakes trusting the same certificates
+ *
+ * @details The purpose of this testcase is to make sure the certificates are
+ *          parsed once, and that later handshakes use the parsed chain
+ */
+void test_TLS_trust_store_shared( void )
+{
+    mbedtls_x509_crt * first_chain;
+
+    TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( share_cert, sizeof( share_cert ) ) );
+    TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( share_cert, sizeof( share_cert ) ) );
+    TEST_ASSERT_EQUAL_INT( 1, parseCount( share_cert ) );
+
+    TEST_ASSERT_EQUAL_INT( TLS_ERROR_HANDSHAKE_FAILED, handshake( share_cert, sizeof( share_cert ) ) );
+    first_chain = handshake_chains[ 0 ];
+    TEST_ASSERT_EQUAL_INT( TLS_ERROR_HANDSHAKE_FAILED, handshake( share_cert, sizeof( share_cert ) ) );
+    TEST_ASSERT_EQUAL_PTR( first_chain, handshake_chains[ 0 ] );
+    TEST_ASSERT_EQUAL_INT( 1, parseCount( share_cert ) );
+}
+
+static void evict_during_handshake( int depth )
+{
+    TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( evict_cert_b, sizeof( evict_cert_b ) ) );
+    TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( evict_cert_c, sizeof( evict_cert_c ) ) );
+    TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( evict_cert_b, sizeof( evict_cert_b ) ) );
+}
+
+/*!
+ * @brief Other certificates are loaded during a handshake
+ *
+ * @details The purpose of this testcase is to make sure the store of a
+ *          handshake in progress is never evicted, and that the other store
+ *          is reused instead
+ */
+void test_TLS_trust_store_evict_while_referenced( void )
+{
+    during_handshake = evict_during_handshake;
+    TEST_ASSERT_EQUAL_INT( TLS_ERROR_HANDSHAKE_FAILED, handshake( evict_cert_a, sizeof( evict_cert_a ) ) );
+    during_handshake = NULL;
+
+    TEST_ASSERT_FALSE( handshakeChainFreed( 0 ) );
+    TEST_ASSERT_EQUAL_INT( 1, parseCount( evict_cert_a ) );
+    TEST_ASSERT_EQUAL_INT( 1, parseCount( evict_cert_c ) );
+
+    /* the other store only holds one of b and c at a time */
+    TEST_ASSERT_EQUAL_INT( 2, parseCount( evict_cert_b ) );
+
+    TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( evict_cert_a, sizeof( evict_cert_a ) ) );
+    TEST_ASSERT_EQUAL_INT( 1, parseCount( evict_cert_a ) );
+}
+
+static void fill_during_handshake( int depth )
+{
+    if( 1 == depth )
+    {
+        TEST_ASSERT_EQUAL_INT( TLS_ERROR_HANDSHAKE_FAILED, handshake( full_cert_b, sizeof( full_cert_b ) ) );
+    }
+    else
+    {
+        TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( full_cert_c, sizeof( full_cert_c ) ) );
+        TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( full_cert_c, sizeof( full_cert_c ) ) );
+    }
+}
+
+/*!
+ * @brief Every store is used by a handshake in progress
+ *
+ * @details The purpose of this testcase is to make sure other certificates
+ *          are parsed without a store, as if there was no sharing, and that
+ *          the stores in use are left alone
+ */
+void test_TLS_trust_store_all_in_use( void )
+{
+    during_handshake = fill_during_handshake;
+    TEST_ASSERT_EQUAL_INT( TLS_ERROR_HANDSHAKE_FAILED, handshake( full_cert_a, sizeof( full_cert_a ) ) );
+    during_handshake = NULL;
+
+    TEST_ASSERT_NOT_EQUAL( handshake_chains[ 0 ], handshake_chains[ 1 ] );
+    TEST_ASSERT_FALSE( handshakeChainFreed( 0 ) );
+    TEST_ASSERT_FALSE( handshakeChainFreed( 1 ) );
+    TEST_ASSERT_EQUAL_INT( 2, parseCount( full_cert_c ) );
+
+    TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( full_cert_a, sizeof( full_cert_a ) ) );
+    TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( full_cert_b, sizeof( full_cert_b ) ) );
+    TEST_ASSERT_EQUAL_INT( 1, parseCount( full_cert_a ) );
+    TEST_ASSERT_EQUAL_INT( 1, parseCount( full_cert_b ) );
+}
+
+/*!
+ * @brief Custom certificates that do not parse
+ *
+ * @details The purpose of this testcase is to make sure a parse failure is
+ *          reported, is not kept in a store, and does not keep other
+ *          certificates from loading
+ */
+void test_TLS_trust_store_parse_failure( void )
+{
+    TEST_ASSERT_EQUAL_INT( MBEDTLS_ERR_X509_INVALID_FORMAT,
+                           TLS_Prepare( bad_cert, sizeof( bad_cert ) ) );
+    TEST_ASSERT_EQUAL_INT( 1, parseCount( bad_cert ) );
+
+    /* the failure is not reused, and is not parsed again without a store */
+    TEST_ASSERT_EQUAL_INT( MBEDTLS_ERR_X509_INVALID_FORMAT,
+                           handshake( bad_cert, sizeof( bad_cert ) ) );
+    TEST_ASSERT_EQUAL_INT( 2, parseCount( bad_cert ) );
+
+    TEST_ASSERT_EQUAL_INT( 0, TLS_Prepare( good_cert, sizeof( good_cert ) ) );
+    TEST_ASSERT_EQUAL_INT( TLS_ERROR_HANDSHAKE_FAILED, handshake( good_cert, sizeof( good_cert ) ) );
+    TEST_ASSERT_EQUAL_INT( 1, parseCount( good_cert ) );
+}
@@ -99,6 +99,8 @@ static void RunTests( void )
 
     #if ( testrunnerFULL_SHADOWv4_ENABLED == 1 )
         RUN_TEST_GROUP( Shadow_Unit_Parser );
+        RUN_TEST_GROUP( Shadow_Unit_Reported );
+        RUN_TEST_GROUP( Shadow_Unit_Reported_Flush );
         RUN_TEST_GROUP( Shadow_Unit_API );
         RUN_TEST_GROUP( Shadow_System );
     #endif /* if ( testrunnerFULL_SHADOWv4_ENABLED == 1 ) */
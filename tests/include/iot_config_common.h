@@ -141,6 +141,8 @@
     #define AwsIotShadow_FreeString              vPortFree
     #define AwsIotShadow_MallocSubscription      pvPortMalloc
     #define AwsIotShadow_FreeSubscription        vPortFree
+    #define AwsIotShadow_MallocReported          pvPortMalloc
+    #define AwsIotShadow_FreeReported            vPortFree
 
     #define AwsIotDefender_MallocReport          pvPortMalloc
     #define AwsIotDefender_FreeReport            vPortFree
@@ -201,12 +203,18 @@ extern uint16_t getDeviceMetricsLength( void );
 #define AWS_IOT_TEST_SHADOW_THING_NAME      clientcredentialIOT_THING_NAME
 #define AWS_IOT_TEST_DEFENDER_THING_NAME    clientcredentialIOT_THING_NAME
 
+/* Share one wildcard subscription per Shadow operation, so that the tests cover gateway mode. */
+#define AWS_IOT_SHADOW_ENABLE_GATEWAY_MODE  ( 1 )
+
 /* Configuration for defender demo: set format to CBOR. */
 #define AWS_IOT_DEFENDER_FORMAT             AWS_IOT_DEFENDER_FORMAT_CBOR
 
 /* Configuration for defender demo: use long tag for readable output. Please use short tag for the real application. */
 #define AWS_IOT_DEFENDER_USE_LONG_TAG       ( 1 )
 
+/* Report only what changed since the previous report, so that the tests cover incremental reports. */
+#define AWS_IOT_DEFENDER_ENABLE_INCREMENTAL_REPORT    ( 1 )
+
 /* Define the data type of metrics connection id as same as Socket_t in aws_secure_socket.h */
 #define IotMetricsConnectionId_t            void *
 
@@ -0,0 +1,1129 @@
+/*
+ * FreeRTOS V202007.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file benchmark_kernel.c
+ * @brief The kernel services used by the benchmarks, implemented with POSIX threads.
+ *
+ * Only what the benchmarked libraries call is provided. Each task is a thread,
+ * ticks are milliseconds of the monotonic clock and timers run from a single
+ * service thread, as they do from the timer task on a device. Task stacks and
+ * pvPortMalloc() are counted so a benchmark can report the memory a device would
+ * need.
+ */
+
+/* Standard includes. */
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "timers.h"
+#include "event_groups.h"
+
+#include "benchmark_kernel.h"
+
+/* The items of a queue, or the count of a semaphore when uxItemSize is 0. */
+
+typedef struct
+{
+    pthread_mutex_t xLock;
+    pthread_cond_t xNotEmpty;
+    pthread_cond_t xNotFull;
+    uint8_t * pucStorage; /* uxLength items, or NULL for a semaphore. */
+    bool bOwnsStorage;    /* True if pucStorage was allocated here. */
+    UBaseType_t uxLength;
+    UBaseType_t uxItemSize;
+    UBaseType_t uxCount;
+    UBaseType_t uxHead;   /* Index of the oldest item. */
+} BenchQueue_t;
+
+/* Event group bits or a task's notification value, and the condition to wait
+ * for a change. */
+
+typedef struct
+{
+    pthread_mutex_t xLock;
+    pthread_cond_t xChanged;
+    uint32_t ulValue;
+} BenchSync_t;
+
+/* Kernel objects hold a pointer to their state, so the handle of a statically
+ * created object is the address of its static buffer as it is on a device. */
+
+struct QueueDefinition
+{
+    BenchQueue_t * pxState;
+    bool bStatic; /* True if the handle is the caller's static buffer. */
+};
+
+struct EventGroupDef_t
+{
+    BenchSync_t * pxSync;
+};
+
+struct tmrTimerControl
+{
+    const char * pcTimerName;
+    TickType_t xPeriod;
+    UBaseType_t uxAutoReload;
+    void * pvTimerID;
+    TimerCallbackFunction_t pxCallback;
+    TickType_t xExpiry;
+    bool bActive;
+    struct tmrTimerControl * pxNext;
+};
+
+struct tskTaskControlBlock
+{
+    TaskFunction_t pxTaskCode;
+    void * pvParameters;
+    size_t xStackBytes;
+    BenchSync_t * pxNotify; /* Notification value of the task. */
+};
+
+/* Block allocated with pvPortMalloc(). The size is kept in front of the memory. */
+
+typedef union
+{
+    size_t xSize;
+    max_align_t xAlign;
+} BenchHeapHeader_t;
+
+/* Convert a tick timeout to an absolute monotonic clock deadline. */
+
+static void prvDeadline( TickType_t xTicks,
+                         struct timespec * pxDeadline );
+
+/* Wait on a condition until the deadline, or forever for portMAX_DELAY. Returns
+ * false on timeout, and at once for a timeout of 0. */
+
+static bool prvWait( pthread_cond_t * pxCond,
+                     pthread_mutex_t * pxLock,
+                     TickType_t xTicksToWait,
+                     const struct timespec * pxDeadline );
+
+/* Initialise a condition variable that waits on the monotonic clock. */
+
+static void prvCondInit( pthread_cond_t * pxCond );
+
+/* Allocate and initialise the state of an event group or task notification. */
+
+static BenchSync_t * prvSyncCreate( void );
+
+/* Allocate and initialise the state of a queue. Returns NULL if out of memory. */
+
+static BenchQueue_t * prvQueueStateCreate( UBaseType_t uxQueueLength,
+                                           UBaseType_t uxItemSize,
+                                           uint8_t * pucQueueStorage );
+
+/* Attach new queue state to a handle, allocating the handle if pxStaticQueue is NULL. */
+
+static QueueHandle_t prvQueueCreate( UBaseType_t uxQueueLength,
+                                     UBaseType_t uxItemSize,
+                                     uint8_t * pucQueueStorage,
+                                     StaticQueue_t * pxStaticQueue );
+
+/* Start the timer service thread the first time a timer is created. */
+
+static void prvTimerServiceStart( void );
+
+/* Run timer callbacks as they expire. */
+
+static void * prvTimerService( void * pvUnused );
+
+/* Run a task function in its own thread. */
+
+static void * prvTaskEntry( void * pvTCB );
+
+/* The time the kernel was first used. Tick 0. */
+
+static struct timespec xStartTime;
+static pthread_once_t xStartOnce = PTHREAD_ONCE_INIT;
+
+/* Timer service state. */
+
+static pthread_mutex_t xTimerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xTimerChanged;
+static struct tmrTimerControl * pxTimerList = NULL;
+static struct tmrTimerControl * pxRunningTimer = NULL; /* Timer whose callback is running. */
+static bool bRunningTimerDeleted = false;              /* Set if the running timer was deleted by its callback or another task. */
+static pthread_once_t xTimerOnce = PTHREAD_ONCE_INIT;
+
+/* Critical sections exclude each other but not tasks that aren't in one. */
+
+static pthread_mutex_t xCriticalLock;
+static pthread_once_t xCriticalOnce = PTHREAD_ONCE_INIT;
+
+/* Resource counters. */
+
+static pthread_mutex_t xUsageLock = PTHREAD_MUTEX_INITIALIZER;
+static BenchKernelUsage_t xUsage = { 0 };
+
+/* The TCB of the calling task, or NULL for threads not created with xTaskCreate. */
+
+static __thread struct tskTaskControlBlock * pxCurrentTCB = NULL;
+
+/* The handle returned to threads not created with xTaskCreate, like the main
+ * thread. Never NULL, so they are not mistaken for a task that was not created. */
+
+static struct tskTaskControlBlock xForeignTCB;
+
+/*-----------------------------------------------------------*/
+
+static void prvStartTimeInit( void )
+{
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xStartTime );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCondInit( pthread_cond_t * pxCond )
+{
+    pthread_condattr_t xAttr;
+
+    ( void ) pthread_condattr_init( &xAttr );
+    ( void ) pthread_condattr_setclock( &xAttr, CLOCK_MONOTONIC );
+    ( void ) pthread_cond_init( pxCond, &xAttr );
+    ( void ) pthread_condattr_destroy( &xAttr );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvDeadline( TickType_t xTicks,
+                         struct timespec * pxDeadline )
+{
+    uint64_t ullNs;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, pxDeadline );
+    ullNs = ( uint64_t ) pxDeadline->tv_nsec + ( ( uint64_t ) xTicks * portTICK_PERIOD_MS * 1000000ULL );
+    pxDeadline->tv_sec += ( time_t ) ( ullNs / 1000000000ULL );
+    pxDeadline->tv_nsec = ( long ) ( ullNs % 1000000000ULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvWait( pthread_cond_t * pxCond,
+                     pthread_mutex_t * pxLock,
+                     TickType_t xTicksToWait,
+                     const struct timespec * pxDeadline )
+{
+    bool bSignalled = true;
+
+    if( xTicksToWait == 0U )
+    {
+        bSignalled = false;
+    }
+    else if( xTicksToWait == portMAX_DELAY )
+    {
+        ( void ) pthread_cond_wait( pxCond, pxLock );
+    }
+    else if( pthread_cond_timedwait( pxCond, pxLock, pxDeadline ) == ETIMEDOUT )
+    {
+        bSignalled = false;
+    }
+
+    return bSignalled;
+}
+
+/*-----------------------------------------------------------*/
+
+static BenchSync_t * prvSyncCreate( void )
+{
+    BenchSync_t * pxSync = malloc( sizeof( BenchSync_t ) );
+
+    /* Static creation can't fail on a device, so neither does this. */
+    if( pxSync == NULL )
+    {
+        abort();
+    }
+
+    ( void ) pthread_mutex_init( &pxSync->xLock, NULL );
+    prvCondInit( &pxSync->xChanged );
+    pxSync->ulValue = 0U;
+
+    return pxSync;
+}
+
+/*-----------------------------------------------------------*/
+
+void vBenchKernelGetUsage( BenchKernelUsage_t * pxUsage )
+{
+    ( void ) pthread_mutex_lock( &xUsageLock );
+    *pxUsage = xUsage;
+    ( void ) pthread_mutex_unlock( &xUsageLock );
+}
+
+/*-----------------------------------------------------------*/
+
+void vBenchKernelResetPeak( void )
+{
+    ( void ) pthread_mutex_lock( &xUsageLock );
+    xUsage.xPeakHeapBytes = xUsage.xHeapBytes;
+    ( void ) pthread_mutex_unlock( &xUsageLock );
+}
+
+/*-----------------------------------------------------------*/
+
+TickType_t xTaskGetTickCount( void )
+{
+    struct timespec xNow;
+    uint64_t ullMs;
+
+    ( void ) pthread_once( &xStartOnce, prvStartTimeInit );
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    ullMs = ( ( uint64_t ) ( xNow.tv_sec - xStartTime.tv_sec ) * 1000ULL ) +
+            ( uint64_t ) ( ( xNow.tv_nsec - xStartTime.tv_nsec ) / 1000000L );
+
+    return ( TickType_t ) ( ullMs / portTICK_PERIOD_MS );
+}
+
+/*-----------------------------------------------------------*/
+
+void vTaskDelay( const TickType_t xTicksToDelay )
+{
+    struct timespec xDelay;
+
+    xDelay.tv_sec = ( time_t ) ( ( xTicksToDelay * portTICK_PERIOD_MS ) / 1000U );
+    xDelay.tv_nsec = ( long ) ( ( xTicksToDelay * portTICK_PERIOD_MS ) % 1000U ) * 1000000L;
+
+    while( nanosleep( &xDelay, &xDelay ) != 0 )
+    {
+        /* Interrupted by a signal, sleep for the rest of the time. */
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvTaskEntry( void * pvTCB )
+{
+    pxCurrentTCB = ( struct tskTaskControlBlock * ) pvTCB;
+
+    pxCurrentTCB->pxTaskCode( pxCurrentTCB->pvParameters );
+
+    /* FreeRTOS tasks must not return, but end the thread cleanly if one does. */
+    vTaskDelete( NULL );
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * const pcName,
+                        const configSTACK_DEPTH_TYPE usStackDepth,
+                        void * const pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * const pxCreatedTask )
+{
+    BaseType_t xReturn = pdFAIL;
+    struct tskTaskControlBlock * pxTCB = malloc( sizeof( struct tskTaskControlBlock ) );
+    pthread_attr_t xAttr;
+    pthread_t xThread;
+
+    /* Threads get the host's default stack and are not prioritised. The stack
+     * depth is only counted. */
+    ( void ) pcName;
+    ( void ) uxPriority;
+
+    if( pxTCB != NULL )
+    {
+        pxTCB->pxTaskCode = pxTaskCode;
+        pxTCB->pvParameters = pvParameters;
+        pxTCB->xStackBytes = ( size_t ) usStackDepth * sizeof( StackType_t );
+        pxTCB->pxNotify = prvSyncCreate();
+
+        ( void ) pthread_mutex_lock( &xUsageLock );
+        xUsage.uxTasks++;
+        xUsage.xStackBytes += pxTCB->xStackBytes;
+        ( void ) pthread_mutex_unlock( &xUsageLock );
+
+        /* The task may run and delete itself before pthread_create() returns, so it
+         * is created detached and its TCB is not touched here once it has started. */
+        ( void ) pthread_attr_init( &xAttr );
+        ( void ) pthread_attr_setdetachstate( &xAttr, PTHREAD_CREATE_DETACHED );
+
+        if( pxCreatedTask != NULL )
+        {
+            *pxCreatedTask = pxTCB;
+        }
+
+        if( pthread_create( &xThread, &xAttr, prvTaskEntry, pxTCB ) == 0 )
+        {
+            xReturn = pdPASS;
+        }
+        else
+        {
+            ( void ) pthread_mutex_lock( &xUsageLock );
+            xUsage.uxTasks--;
+            xUsage.xStackBytes -= pxTCB->xStackBytes;
+            ( void ) pthread_mutex_unlock( &xUsageLock );
+
+            free( pxTCB->pxNotify );
+            free( pxTCB );
+
+            if( pxCreatedTask != NULL )
+            {
+                *pxCreatedTask = NULL;
+            }
+        }
+
+        ( void ) pthread_attr_destroy( &xAttr );
+    }
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+void vTaskDelete( TaskHandle_t xTaskToDelete )
+{
+    /* Only a task deleting itself is supported. Threads can't be stopped from outside. */
+    if( ( pxCurrentTCB != NULL ) &&
+        ( ( xTaskToDelete == NULL ) || ( xTaskToDelete == pxCurrentTCB ) ) )
+    {
+        ( void ) pthread_mutex_lock( &xUsageLock );
+        xUsage.uxTasks--;
+        xUsage.xStackBytes -= pxCurrentTCB->xStackBytes;
+        ( void ) pthread_mutex_unlock( &xUsageLock );
+
+        free( pxCurrentTCB->pxNotify );
+        free( pxCurrentTCB );
+        pxCurrentTCB = NULL;
+        pthread_exit( NULL );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+TaskHandle_t xTaskGetCurrentTaskHandle( void )
+{
+    return ( pxCurrentTCB != NULL ) ? pxCurrentTCB : &xForeignTCB;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskGenericNotify( TaskHandle_t xTaskToNotify,
+                               uint32_t ulValue,
+                               eNotifyAction eAction,
+                               uint32_t * pulPreviousNotificationValue )
+{
+    BenchSync_t * pxSync = xTaskToNotify->pxNotify;
+
+    ( void ) pthread_mutex_lock( &pxSync->xLock );
+
+    if( pulPreviousNotificationValue != NULL )
+    {
+        *pulPreviousNotificationValue = pxSync->ulValue;
+    }
+
+    switch( eAction )
+    {
+        case eSetBits:
+            pxSync->ulValue |= ulValue;
+            break;
+
+        case eIncrement:
+            pxSync->ulValue++;
+            break;
+
+        case eSetValueWithOverwrite:
+        case eSetValueWithoutOverwrite:
+            pxSync->ulValue = ulValue;
+            break;
+
+        default:
+            break;
+    }
+
+    ( void ) pthread_cond_broadcast( &pxSync->xChanged );
+    ( void ) pthread_mutex_unlock( &pxSync->xLock );
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulTaskNotifyTake( BaseType_t xClearCountOnExit,
+                           TickType_t xTicksToWait )
+{
+    BenchSync_t * pxSync = pxCurrentTCB->pxNotify;
+    struct timespec xDeadline;
+    uint32_t ulValue;
+
+    prvDeadline( xTicksToWait, &xDeadline );
+    ( void ) pthread_mutex_lock( &pxSync->xLock );
+
+    while( ( pxSync->ulValue == 0U ) && prvWait( &pxSync->xChanged, &pxSync->xLock, xTicksToWait, &xDeadline ) )
+    {
+    }
+
+    ulValue = pxSync->ulValue;
+
+    if( ulValue != 0U )
+    {
+        pxSync->ulValue = ( xClearCountOnExit != pdFALSE ) ? 0U : ( ulValue - 1U );
+    }
+
+    ( void ) pthread_mutex_unlock( &pxSync->xLock );
+
+    return ulValue;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCriticalInit( void )
+{
+    pthread_mutexattr_t xAttr;
+
+    ( void ) pthread_mutexattr_init( &xAttr );
+    ( void ) pthread_mutexattr_settype( &xAttr, PTHREAD_MUTEX_RECURSIVE );
+    ( void ) pthread_mutex_init( &xCriticalLock, &xAttr );
+    ( void ) pthread_mutexattr_destroy( &xAttr );
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+    ( void ) pthread_once( &xCriticalOnce, prvCriticalInit );
+    ( void ) pthread_mutex_lock( &xCriticalLock );
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+    ( void ) pthread_mutex_unlock( &xCriticalLock );
+}
+
+/*-----------------------------------------------------------*/
+
+void * pvPortMalloc( size_t xWantedSize )
+{
+    BenchHeapHeader_t * pxHeader = malloc( sizeof( BenchHeapHeader_t ) + xWantedSize );
+    void * pvReturn = NULL;
+
+    if( pxHeader != NULL )
+    {
+        pxHeader->xSize = xWantedSize;
+        pvReturn = pxHeader + 1;
+
+        ( void ) pthread_mutex_lock( &xUsageLock );
+        xUsage.xHeapBytes += xWantedSize;
+
+        if( xUsage.xHeapBytes > xUsage.xPeakHeapBytes )
+        {
+            xUsage.xPeakHeapBytes = xUsage.xHeapBytes;
+        }
+
+        ( void ) pthread_mutex_unlock( &xUsageLock );
+    }
+
+    return pvReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortFree( void * pv )
+{
+    BenchHeapHeader_t * pxHeader;
+
+    if( pv != NULL )
+    {
+        pxHeader = ( BenchHeapHeader_t * ) pv - 1;
+
+        ( void ) pthread_mutex_lock( &xUsageLock );
+        xUsage.xHeapBytes -= pxHeader->xSize;
+        ( void ) pthread_mutex_unlock( &xUsageLock );
+
+        free( pxHeader );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static BenchQueue_t * prvQueueStateCreate( UBaseType_t uxQueueLength,
+                                           UBaseType_t uxItemSize,
+                                           uint8_t * pucQueueStorage )
+{
+    BenchQueue_t * pxState = calloc( 1, sizeof( BenchQueue_t ) );
+
+    if( pxState != NULL )
+    {
+        pxState->uxLength = uxQueueLength;
+        pxState->uxItemSize = uxItemSize;
+        pxState->pucStorage = pucQueueStorage;
+
+        if( ( pucQueueStorage == NULL ) && ( uxItemSize > 0U ) )
+        {
+            pxState->pucStorage = malloc( uxQueueLength * uxItemSize );
+            pxState->bOwnsStorage = true;
+        }
+
+        if( ( uxItemSize > 0U ) && ( pxState->pucStorage == NULL ) )
+        {
+            free( pxState );
+            pxState = NULL;
+        }
+        else
+        {
+            ( void ) pthread_mutex_init( &pxState->xLock, NULL );
+            prvCondInit( &pxState->xNotEmpty );
+            prvCondInit( &pxState->xNotFull );
+        }
+    }
+
+    return pxState;
+}
+
+/*-----------------------------------------------------------*/
+
+static QueueHandle_t prvQueueCreate( UBaseType_t uxQueueLength,
+                                     UBaseType_t uxItemSize,
+                                     uint8_t * pucQueueStorage,
+                                     StaticQueue_t * pxStaticQueue )
+{
+    struct QueueDefinition * pxQueue = ( struct QueueDefinition * ) pxStaticQueue;
+    BenchQueue_t * pxState = prvQueueStateCreate( uxQueueLength, uxItemSize, pucQueueStorage );
+
+    if( pxState == NULL )
+    {
+        /* Static creation can't fail on a device, so neither does this. */
+        if( pxStaticQueue != NULL )
+        {
+            abort();
+        }
+    }
+    else if( pxStaticQueue == NULL )
+    {
+        pxQueue = malloc( sizeof( struct QueueDefinition ) );
+
+        if( pxQueue == NULL )
+        {
+            free( pxState->pucStorage );
+            free( pxState );
+        }
+    }
+
+    if( ( pxState != NULL ) && ( pxQueue != NULL ) )
+    {
+        pxQueue->pxState = pxState;
+        pxQueue->bStatic = ( pxStaticQueue != NULL );
+    }
+
+    return pxQueue;
+}
+
+/*-----------------------------------------------------------*/
+
+QueueHandle_t xQueueGenericCreateStatic( const UBaseType_t uxQueueLength,
+                                         const UBaseType_t uxItemSize,
+                                         uint8_t * pucQueueStorage,
+                                         StaticQueue_t * pxStaticQueue,
+                                         const uint8_t ucQueueType )
+{
+    /* The items go in the caller's storage. Semaphores start out taken. */
+    ( void ) ucQueueType;
+
+    return prvQueueCreate( uxQueueLength, uxItemSize, pucQueueStorage, pxStaticQueue );
+}
+
+/*-----------------------------------------------------------*/
+
+QueueHandle_t xQueueGenericCreate( const UBaseType_t uxQueueLength,
+                                   const UBaseType_t uxItemSize,
+                                   const uint8_t ucQueueType )
+{
+    ( void ) ucQueueType;
+
+    return prvQueueCreate( uxQueueLength, uxItemSize, NULL, NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+QueueHandle_t xQueueCreateMutexStatic( const uint8_t ucQueueType,
+                                       StaticQueue_t * pxStaticQueue )
+{
+    QueueHandle_t xQueue = prvQueueCreate( 1, 0, NULL, pxStaticQueue );
+
+    /* A mutex is a semaphore that starts out available. Priorities aren't inherited. */
+    ( void ) ucQueueType;
+
+    xQueue->pxState->uxCount = 1;
+
+    return xQueue;
+}
+
+/*-----------------------------------------------------------*/
+
+QueueHandle_t xQueueCreateMutex( const uint8_t ucQueueType )
+{
+    QueueHandle_t xQueue = prvQueueCreate( 1, 0, NULL, NULL );
+
+    ( void ) ucQueueType;
+
+    if( xQueue != NULL )
+    {
+        xQueue->pxState->uxCount = 1;
+    }
+
+    return xQueue;
+}
+
+/*-----------------------------------------------------------*/
+
+void vQueueDelete( QueueHandle_t xQueue )
+{
+    BenchQueue_t * pxState;
+
+    if( xQueue != NULL )
+    {
+        pxState = xQueue->pxState;
+
+        ( void ) pthread_cond_destroy( &pxState->xNotFull );
+        ( void ) pthread_cond_destroy( &pxState->xNotEmpty );
+        ( void ) pthread_mutex_destroy( &pxState->xLock );
+
+        if( pxState->bOwnsStorage == true )
+        {
+            free( pxState->pucStorage );
+        }
+
+        free( pxState );
+
+        if( xQueue->bStatic == false )
+        {
+            free( xQueue );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueGenericSend( QueueHandle_t xQueue,
+                              const void * const pvItemToQueue,
+                              TickType_t xTicksToWait,
+                              const BaseType_t xCopyPosition )
+{
+    BenchQueue_t * pxState = xQueue->pxState;
+    BaseType_t xReturn = pdTRUE;
+    UBaseType_t uxSlot;
+    struct timespec xDeadline;
+
+    prvDeadline( xTicksToWait, &xDeadline );
+    ( void ) pthread_mutex_lock( &pxState->xLock );
+
+    while( ( pxState->uxCount >= pxState->uxLength ) && ( xCopyPosition != queueOVERWRITE ) && ( xReturn == pdTRUE ) )
+    {
+        if( prvWait( &pxState->xNotFull, &pxState->xLock, xTicksToWait, &xDeadline ) == false )
+        {
+            xReturn = errQUEUE_FULL;
+        }
+    }
+
+    if( xReturn == pdTRUE )
+    {
+        if( pxState->uxItemSize > 0U )
+        {
+            if( xCopyPosition == queueSEND_TO_FRONT )
+            {
+                pxState->uxHead = ( pxState->uxHead + pxState->uxLength - 1U ) % pxState->uxLength;
+                uxSlot = pxState->uxHead;
+            }
+            else if( xCopyPosition == queueOVERWRITE )
+            {
+                /* Overwrite is only used with queues of length 1. */
+                pxState->uxHead = 0;
+                pxState->uxCount = 0;
+                uxSlot = 0;
+            }
+            else
+            {
+                uxSlot = ( pxState->uxHead + pxState->uxCount ) % pxState->uxLength;
+            }
+
+            ( void ) memcpy( &pxState->pucStorage[ uxSlot * pxState->uxItemSize ], pvItemToQueue, pxState->uxItemSize );
+        }
+
+        pxState->uxCount++;
+        ( void ) pthread_cond_signal( &pxState->xNotEmpty );
+    }
+
+    ( void ) pthread_mutex_unlock( &pxState->xLock );
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueReceive( QueueHandle_t xQueue,
+                          void * const pvBuffer,
+                          TickType_t xTicksToWait )
+{
+    BenchQueue_t * pxState = xQueue->pxState;
+    BaseType_t xReturn = pdTRUE;
+    struct timespec xDeadline;
+
+    prvDeadline( xTicksToWait, &xDeadline );
+    ( void ) pthread_mutex_lock( &pxState->xLock );
+
+    while( ( pxState->uxCount == 0U ) && ( xReturn == pdTRUE ) )
+    {
+        if( prvWait( &pxState->xNotEmpty, &pxState->xLock, xTicksToWait, &xDeadline ) == false )
+        {
+            xReturn = pdFALSE;
+        }
+    }
+
+    if( xReturn == pdTRUE )
+    {
+        if( pxState->uxItemSize > 0U )
+        {
+            ( void ) memcpy( pvBuffer, &pxState->pucStorage[ pxState->uxHead * pxState->uxItemSize ], pxState->uxItemSize );
+            pxState->uxHead = ( pxState->uxHead + 1U ) % pxState->uxLength;
+        }
+
+        pxState->uxCount--;
+        ( void ) pthread_cond_signal( &pxState->xNotFull );
+    }
+
+    ( void ) pthread_mutex_unlock( &pxState->xLock );
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueSemaphoreTake( QueueHandle_t xQueue,
+                                TickType_t xTicksToWait )
+{
+    return xQueueReceive( xQueue, NULL, xTicksToWait );
+}
+
+/*-----------------------------------------------------------*/
+
+EventGroupHandle_t xEventGroupCreateStatic( StaticEventGroup_t * pxEventGroupBuffer )
+{
+    EventGroupHandle_t xEventGroup = ( EventGroupHandle_t ) pxEventGroupBuffer;
+
+    /* Static objects are never deleted, so the state is not freed. */
+    xEventGroup->pxSync = prvSyncCreate();
+
+    return xEventGroup;
+}
+
+/*-----------------------------------------------------------*/
+
+EventBits_t xEventGroupSetBits( EventGroupHandle_t xEventGroup,
+                                const EventBits_t uxBitsToSet )
+{
+    BenchSync_t * pxSync = xEventGroup->pxSync;
+    EventBits_t uxReturn;
+
+    ( void ) pthread_mutex_lock( &pxSync->xLock );
+    pxSync->ulValue |= ( uint32_t ) uxBitsToSet;
+    uxReturn = ( EventBits_t ) pxSync->ulValue;
+    ( void ) pthread_cond_broadcast( &pxSync->xChanged );
+    ( void ) pthread_mutex_unlock( &pxSync->xLock );
+
+    return uxReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+EventBits_t xEventGroupClearBits( EventGroupHandle_t xEventGroup,
+                                  const EventBits_t uxBitsToClear )
+{
+    BenchSync_t * pxSync = xEventGroup->pxSync;
+    EventBits_t uxReturn;
+
+    ( void ) pthread_mutex_lock( &pxSync->xLock );
+    uxReturn = ( EventBits_t ) pxSync->ulValue;
+    pxSync->ulValue &= ~( ( uint32_t ) uxBitsToClear );
+    ( void ) pthread_mutex_unlock( &pxSync->xLock );
+
+    return uxReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+EventBits_t xEventGroupWaitBits( EventGroupHandle_t xEventGroup,
+                                 const EventBits_t uxBitsToWaitFor,
+                                 const BaseType_t xClearOnExit,
+                                 const BaseType_t xWaitForAllBits,
+                                 TickType_t xTicksToWait )
+{
+    BenchSync_t * pxSync = xEventGroup->pxSync;
+    EventBits_t uxReturn;
+    bool bSatisfied = false;
+    bool bWaiting = true;
+    struct timespec xDeadline;
+
+    prvDeadline( xTicksToWait, &xDeadline );
+    ( void ) pthread_mutex_lock( &pxSync->xLock );
+
+    while( bWaiting == true )
+    {
+        if( xWaitForAllBits != pdFALSE )
+        {
+            bSatisfied = ( ( pxSync->ulValue & uxBitsToWaitFor ) == uxBitsToWaitFor );
+        }
+        else
+        {
+            bSatisfied = ( ( pxSync->ulValue & uxBitsToWaitFor ) != 0U );
+        }
+
+        if( bSatisfied == true )
+        {
+            bWaiting = false;
+        }
+        else
+        {
+            bWaiting = prvWait( &pxSync->xChanged, &pxSync->xLock, xTicksToWait, &xDeadline );
+        }
+    }
+
+    uxReturn = ( EventBits_t ) pxSync->ulValue;
+
+    if( ( bSatisfied == true ) && ( xClearOnExit != pdFALSE ) )
+    {
+        pxSync->ulValue &= ~( ( uint32_t ) uxBitsToWaitFor );
+    }
+
+    ( void ) pthread_mutex_unlock( &pxSync->xLock );
+
+    return uxReturn;
+}
+
+/*-----------------------------------------------------------*/
+static void prvTimerServiceStart( void )
+{
+    pthread_t xThread;
+
+    prvCondInit( &xTimerChanged );
+
+    if( pthread_create( &xThread, NULL, prvTimerService, NULL ) == 0 )
+    {
+        ( void ) pthread_detach( xThread );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvTimerService( void * pvUnused )
+{
+    struct tmrTimerControl * pxTimer;
+    struct tmrTimerControl * pxNext;
+    TimerCallbackFunction_t pxCallback;
+    TickType_t xNow;
+    struct timespec xDeadline;
+
+    ( void ) pvUnused;
+
+    ( void ) pthread_mutex_lock( &xTimerLock );
+
+    for( ; ; )
+    {
+        xNow = xTaskGetTickCount();
+        pxNext = NULL;
+
+        for( pxTimer = pxTimerList; pxTimer != NULL; pxTimer = pxTimer->pxNext )
+        {
+            if( ( pxTimer->bActive == true ) &&
+                ( ( pxNext == NULL ) || ( ( TickType_t ) ( pxTimer->xExpiry - pxNext->xExpiry ) > ( portMAX_DELAY / 2U ) ) ) )
+            {
+                pxNext = pxTimer;
+            }
+        }
+
+        if( pxNext == NULL )
+        {
+            ( void ) pthread_cond_wait( &xTimerChanged, &xTimerLock );
+        }
+        else if( ( TickType_t ) ( xNow - pxNext->xExpiry ) < ( portMAX_DELAY / 2U ) )
+        {
+            /* Expired. Callbacks run without the lock so they can use the timer API. */
+            if( pxNext->uxAutoReload != pdFALSE )
+            {
+                pxNext->xExpiry += pxNext->xPeriod;
+            }
+            else
+            {
+                pxNext->bActive = false;
+            }
+
+            pxCallback = pxNext->pxCallback;
+            pxRunningTimer = pxNext;
+            ( void ) pthread_mutex_unlock( &xTimerLock );
+            pxCallback( pxNext );
+            ( void ) pthread_mutex_lock( &xTimerLock );
+
+            if( bRunningTimerDeleted == true )
+            {
+                free( pxRunningTimer );
+                bRunningTimerDeleted = false;
+            }
+
+            pxRunningTimer = NULL;
+        }
+        else
+        {
+            prvDeadline( pxNext->xExpiry - xNow, &xDeadline );
+            ( void ) pthread_cond_timedwait( &xTimerChanged, &xTimerLock, &xDeadline );
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+TimerHandle_t xTimerCreate( const char * const pcTimerName,
+                            const TickType_t xTimerPeriodInTicks,
+                            const UBaseType_t uxAutoReload,
+                            void * const pvTimerID,
+                            TimerCallbackFunction_t pxCallbackFunction )
+{
+    struct tmrTimerControl * pxTimer = calloc( 1, sizeof( struct tmrTimerControl ) );
+
+    ( void ) pthread_once( &xTimerOnce, prvTimerServiceStart );
+
+    if( pxTimer != NULL )
+    {
+        pxTimer->pcTimerName = pcTimerName;
+        pxTimer->xPeriod = xTimerPeriodInTicks;
+        pxTimer->uxAutoReload = uxAutoReload;
+        pxTimer->pvTimerID = pvTimerID;
+        pxTimer->pxCallback = pxCallbackFunction;
+
+        ( void ) pthread_mutex_lock( &xTimerLock );
+        pxTimer->pxNext = pxTimerList;
+        pxTimerList = pxTimer;
+        ( void ) pthread_mutex_unlock( &xTimerLock );
+    }
+
+    return pxTimer;
+}
+
+/*-----------------------------------------------------------*/
+
+TimerHandle_t xTimerCreateStatic( const char * const pcTimerName,
+                                  const TickType_t xTimerPeriodInTicks,
+                                  const UBaseType_t uxAutoReload,
+                                  void * const pvTimerID,
+                                  TimerCallbackFunction_t pxCallbackFunction,
+                                  StaticTimer_t * pxTimerBuffer )
+{
+    /* Unlike a queue, the control block is allocated rather than placed in the
+     * buffer, so that deleting a timer can free it the same way in both cases. */
+    ( void ) pxTimerBuffer;
+
+    return xTimerCreate( pcTimerName, xTimerPeriodInTicks, uxAutoReload, pvTimerID, pxCallbackFunction );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerGenericCommand( TimerHandle_t xTimer,
+                                 const BaseType_t xCommandID,
+                                 const TickType_t xOptionalValue,
+                                 BaseType_t * const pxHigherPriorityTaskWoken,
+                                 const TickType_t xTicksToWait )
+{
+    struct tmrTimerControl ** ppxLink;
+
+    ( void ) pxHigherPriorityTaskWoken;
+    ( void ) xTicksToWait;
+
+    ( void ) pthread_mutex_lock( &xTimerLock );
+
+    switch( xCommandID )
+    {
+        case tmrCOMMAND_START:
+        case tmrCOMMAND_RESET:
+            xTimer->xExpiry = xOptionalValue + xTimer->xPeriod;
+            xTimer->bActive = true;
+            break;
+
+        case tmrCOMMAND_CHANGE_PERIOD:
+            xTimer->xPeriod = xOptionalValue;
+            xTimer->xExpiry = xTaskGetTickCount() + xOptionalValue;
+            xTimer->bActive = true;
+            break;
+
+        case tmrCOMMAND_STOP:
+            xTimer->bActive = false;
+            break;
+
+        case tmrCOMMAND_DELETE:
+
+            for( ppxLink = &pxTimerList; *ppxLink != NULL; ppxLink = &( ( *ppxLink )->pxNext ) )
+            {
+                if( *ppxLink == xTimer )
+                {
+                    *ppxLink = xTimer->pxNext;
+
+                    /* A timer is freed once its callback has returned. */
+                    if( xTimer == pxRunningTimer )
+                    {
+                        bRunningTimerDeleted = true;
+                    }
+                    else
+                    {
+                        free( xTimer );
+                    }
+
+                    break;
+                }
+            }
+
+            break;
+
+        default:
+            break;
+    }
+
+    ( void ) pthread_cond_signal( &xTimerChanged );
+    ( void ) pthread_mutex_unlock( &xTimerLock );
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+void * pvTimerGetTimerID( const TimerHandle_t xTimer )
+{
+    return xTimer->pvTimerID;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,58 @@
+/*
+ * FreeRTOS V202007.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file benchmark_kernel.h
+ * @brief Resource counters kept by the host kernel of the benchmarks.
+ */
+
+#ifndef BENCHMARK_KERNEL_H_
+#define BENCHMARK_KERNEL_H_
+
+/* Standard includes. */
+#include <stddef.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Resources in use at one point in time. */
+
+typedef struct
+{
+    UBaseType_t uxTasks;    /* Tasks that have been created and not deleted. */
+    size_t xStackBytes;     /* Stack the tasks would reserve on a device. */
+    size_t xHeapBytes;      /* Bytes allocated with pvPortMalloc() and not freed. */
+    size_t xPeakHeapBytes;  /* Most bytes allocated at once since the last reset. */
+} BenchKernelUsage_t;
+
+/* Read the counters. */
+
+void vBenchKernelGetUsage( BenchKernelUsage_t * pxUsage );
+
+/* Start measuring the peak heap from the current use. */
+
+void vBenchKernelResetPeak( void );
+
+#endif /* BENCHMARK_KERNEL_H_ */
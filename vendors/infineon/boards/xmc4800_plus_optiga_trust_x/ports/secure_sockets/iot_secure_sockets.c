@@ -547,6 +547,51 @@ int32_t SOCKETS_Send( Socket_t xSocket,
 }
 /*-----------------------------------------------------------*/
 
+int32_t SOCKETS_Sendv( Socket_t xSocket,
+                       const SocketsIoVector_t * pxVectors,
+                       size_t xVectorCount,
+                       uint32_t ulFlags )
+{
+    int32_t lStatus = 0;
+    int32_t lSent = 0;
+    size_t xVector = 0;
+
+    if( ( NULL == pxVectors ) && ( 0U != xVectorCount ) )
+    {
+        lStatus = SOCKETS_EINVAL;
+    }
+
+    /* Send the buffers one by one, until an error or a short send. */
+    while( ( lStatus >= 0 ) && ( xVector < xVectorCount ) )
+    {
+        lStatus = SOCKETS_Send( xSocket,
+                                pxVectors[ xVector ].pvBuffer,
+                                pxVectors[ xVector ].xLength,
+                                ulFlags );
+
+        if( lStatus > 0 )
+        {
+            lSent += lStatus;
+        }
+
+        if( lStatus != ( int32_t ) pxVectors[ xVector ].xLength )
+        {
+            break;
+        }
+
+        xVector++;
+    }
+
+    /* Only report an error if no data was sent. */
+    if( ( lStatus >= 0 ) || ( lSent > 0 ) )
+    {
+        lStatus = lSent;
+    }
+
+    return lStatus;
+}
+/*-----------------------------------------------------------*/
+
 int32_t SOCKETS_Shutdown( Socket_t xSocket,
                           uint32_t ulHow )
 {
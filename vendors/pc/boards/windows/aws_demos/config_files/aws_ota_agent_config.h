@@ -39,7 +39,8 @@
 /**
  * @brief Log base 2 of the size of the file data block message (excluding the header).
  *
- * 10 bits yields a data block size of 1KB.
+ * 10 bits yields a data block size of 1KB. This is the largest block size. An application
+ * can choose smaller blocks for each file with the xSelectBlockSize callback.
  */
 #define otaconfigLOG2_FILE_BLOCK_SIZE          12UL
 
@@ -86,6 +87,94 @@
  */
 #define otaconfigMAX_NUM_BLOCKS_REQUEST      1U
 
+/**
+ * @brief The maximum number of data blocks kept in flight by windowed block requests.
+ *
+ * When this is larger than zero, the MQTT data transfer keeps a window of blocks in flight
+ * and requests more as blocks are received instead of waiting for each request to complete.
+ * The window starts at otaconfigMAX_NUM_BLOCKS_REQUEST blocks and adapts to the observed
+ * round trip time, request timeouts and dropped packets, up to this limit. The same 128 KB
+ * service response limit as for otaconfigMAX_NUM_BLOCKS_REQUEST applies. Set to 0 to
+ * disable windowed requests.
+ */
+#define otaconfigMQTT_REQUEST_WINDOW_BLOCKS  0U
+
+/**
+ * @brief Hash received file blocks while the file is being downloaded.
+ *
+ * When set to 1, the agent feeds each block to the signature hash as soon as it has been
+ * written, so the PAL only has to check the final signature when the file is closed instead
+ * of reading the whole file back. The PAL must consume OTA_FileContext_t::pvSigVerifyContext
+ * for this to have an effect.
+ */
+#define otaconfigSTREAMING_SIGNATURE_CHECK    1U
+
+/**
+ * @brief The number of out of order blocks buffered ahead of the streaming signature hash.
+ *
+ * Blocks that arrive ahead of the next block to hash are held in RAM, up to this many blocks
+ * of OTA_FILE_BLOCK_SIZE bytes, until the missing blocks arrive. A block that arrives further
+ * ahead than this is dropped and requested again. Must be between 1 and 32. Defaults to the
+ * request window size, otaconfigMQTT_REQUEST_WINDOW_BLOCKS, with a minimum of 4.
+ */
+#define otaconfigSTREAMING_SIGNATURE_FRONTIER_BLOCKS    4U
+
+/**
+ * @brief Accept delta patch jobs.
+ *
+ * When enabled, a job file with a "delta" format is a patch against the running image and is
+ * applied as it is received. The job file must give the "imagesize" of the patched image, which
+ * is the size the PAL creates the file for. The PAL must provide
+ * OTA_PAL_Callbacks_t::xReadActiveImage, otherwise delta jobs are rejected. Set to 0 to reject
+ * all delta jobs.
+ */
+#define otaconfigDELTA_UPDATE    0U
+
+/**
+ * @brief Accept compressed file jobs.
+ *
+ * When enabled, a job file with a "compression" format is sent compressed and is decompressed
+ * as it is received. The job file must give the "imagesize" of the decompressed image, which is
+ * the size the PAL creates the file for. Set to 0 to reject all compressed jobs.
+ */
+#define otaconfigCOMPRESSED_UPDATE    0U
+
+/**
+ * @brief The largest compression window accepted, in bytes.
+ *
+ * This much RAM is allocated while a compressed file is received. Files compressed with a larger
+ * window fail. Must be a power of 2 between 16 and 4096.
+ */
+#define otaconfigDECOMPRESS_WINDOW_SIZE    1024U
+
+/**
+ * @brief Number of file blocks received between download checkpoints.
+ *
+ * When not 0, the receive block bitmap is stored through the PAL every this many blocks so a
+ * download interrupted by a reset or power loss continues where it left off instead of starting
+ * over. The PAL must implement prvPAL_SaveCheckpoint() and prvPAL_ResumeFileForRx(). Delta and
+ * compressed files are always received from the start.
+ */
+#define otaconfigCHECKPOINT_BLOCKS    0U
+
+/**
+ * @brief The number of out of order blocks held for files that must be processed in order.
+ *
+ * Delta patches and compressed files are processed in order. Blocks that arrive up to this many blocks ahead are
+ * buffered, blocks further ahead are dropped and requested again. Must be between 1 and 32.
+ */
+#define otaconfigIN_ORDER_STAGING_BLOCKS    2U
+
+/**
+ * @brief The maximum number of files of one job received at the same time.
+ *
+ * Each file has its own block bitmap, request window and PAL file handle. While more than
+ * one file is being received, each gets an equal share of the data buffers. Only one file
+ * of a job may be a delta patch or compressed, and only the first file is checkpointed and
+ * hashed while it streams. Files are received concurrently over MQTT only.
+ */
+#define otaconfigMAX_CONCURRENT_FILES    1U
+
 /**
  * @brief The maximum number of requests allowed to send without a response before we abort.
  *
@@ -103,6 +192,23 @@
  */
 #define otaconfigMAX_NUM_OTA_DATA_BUFFERS    4U
 
+/**
+ * @brief Size of the memory pool the data buffers are carved from, in bytes.
+ *
+ * The pool is carved into as many buffers as fit for the largest block size of the files
+ * being received, up to otaconfigMAX_NUM_OTA_DATA_BUFFERS. Defaults to enough for that many
+ * buffers of the largest block size.
+ */
+#define otaconfigEVENT_BUFFER_POOL_SIZE      ( otaconfigMAX_NUM_OTA_DATA_BUFFERS * OTA_DATA_BLOCK_SIZE )
+
+/**
+ * @brief The smallest data buffer carved from the pool, in bytes.
+ *
+ * Job documents must fit in one buffer. Buffers for small file blocks are never smaller
+ * than this, so lowering it gives more buffers when smaller blocks are in use.
+ */
+#define otaconfigMIN_EVENT_BUFFER_SIZE       OTA_DATA_BLOCK_SIZE
+
 /**
  * @brief Allow update to same or lower version.
  *
@@ -95,6 +95,14 @@
  */
 #define otaconfigMAX_NUM_REQUEST_MOMENTUM    32U
 
+/**
+ * @brief The maximum number of file blocks kept in flight by windowed MQTT block requests.
+ *
+ * Enabled in the tests so that the windowed request path is covered. Set to 0 to
+ * disable windowed requests.
+ */
+#define otaconfigMQTT_REQUEST_WINDOW_BLOCKS    8U
+
 /**
  * @brief The number of data buffers reserved by the OTA agent.
  *
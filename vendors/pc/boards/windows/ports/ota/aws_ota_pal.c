@@ -54,6 +54,12 @@ static inline BaseType_t prvContextValidate( OTA_FileContext_t * C )
 /* Size of buffer used in file operations on this platform (Windows). */
 #define OTA_PAL_WIN_BUF_SIZE ( ( size_t ) 4096UL )
 
+/* Size of the buffer used for file paths on this platform (Windows). */
+#define OTA_PAL_WIN_PATH_SIZE ( ( size_t ) 260UL )
+
+/* Suffix appended to the receive file path to name its download checkpoint. */
+#define OTA_PAL_CHECKPOINT_SUFFIX    ".ckpt"
+
 /* Attempt to create a new receive file for the file chunks as they come in. */
 
 OTA_Err_t prvPAL_CreateFileForRx( OTA_FileContext_t * const C )
@@ -193,6 +199,140 @@ int16_t prvPAL_WriteBlock( OTA_FileContext_t * const C,
     return ( int16_t ) lResult;
 }
 
+/* Get the path of the download checkpoint stored next to the receive file. */
+
+static BaseType_t prvPAL_CheckpointPath( const OTA_FileContext_t * const C,
+                                         char * pcPath )
+{
+    BaseType_t xResult = pdFALSE;
+    int lLength;
+
+    if( ( C != NULL ) && ( C->pucFilePath != NULL ) )
+    {
+        lLength = snprintf( pcPath, OTA_PAL_WIN_PATH_SIZE, "%s%s", ( const char * ) C->pucFilePath, OTA_PAL_CHECKPOINT_SUFFIX );
+
+        if( ( lLength > 0 ) && ( lLength < ( int ) OTA_PAL_WIN_PATH_SIZE ) )
+        {
+            xResult = pdTRUE;
+        }
+    }
+
+    return xResult;
+}
+
+/* Store the download checkpoint after making sure the blocks it covers are written. */
+
+OTA_Err_t prvPAL_SaveCheckpoint( OTA_FileContext_t * const C,
+                                 const uint8_t * pucCheckpoint,
+                                 uint32_t ulLength )
+{
+    DEFINE_OTA_METHOD_NAME( "prvPAL_SaveCheckpoint" );
+
+    OTA_Err_t eResult = kOTA_Err_Uninitialized;
+    char pcPath[ OTA_PAL_WIN_PATH_SIZE ];
+    FILE * pxCheckpointFile = NULL;
+
+    if( prvPAL_CheckpointPath( C, pcPath ) == pdFALSE )
+    {
+        OTA_LOG_L1( "[%s] ERROR - Invalid context provided.\r\n", OTA_METHOD_NAME );
+        eResult = kOTA_Err_CheckpointFailed;
+    }
+    else if( ulLength == 0U )
+    {
+        /* Erase the checkpoint. It is fine if there wasn't one. */
+        ( void ) remove( pcPath ); /*lint !e586 C standard library call is being used for portability. */
+        eResult = kOTA_Err_None;
+    }
+    else if( ( pucCheckpoint == NULL ) || ( C->pxFile == NULL ) || ( fflush( C->pxFile ) != 0 ) ) /*lint !e586 C standard library call is being used for portability. */
+    {
+        OTA_LOG_L1( "[%s] ERROR - Unable to flush the receive file.\r\n", OTA_METHOD_NAME );
+        eResult = ( kOTA_Err_CheckpointFailed | ( errno & kOTA_PAL_ErrMask ) ); /*lint !e40 !e737 !e9027 !e9029
+                                                                                 * Errno is being used in accordance with host API documentation.
+                                                                                 * Bitmasking is being used to preserve host API error with library status code. */
+    }
+    else
+    {
+        pxCheckpointFile = fopen( pcPath, "wb" ); /*lint !e586 C standard library call is being used for portability. */
+
+        if( ( pxCheckpointFile != NULL ) &&
+            ( fwrite( pucCheckpoint, 1, ulLength, pxCheckpointFile ) == ulLength ) && /*lint !e586 C standard library call is being used for portability. */
+            ( fclose( pxCheckpointFile ) == 0 ) )                                     /*lint !e586 C standard library call is being used for portability. */
+        {
+            eResult = kOTA_Err_None;
+        }
+        else
+        {
+            if( pxCheckpointFile != NULL )
+            {
+                ( void ) fclose( pxCheckpointFile ); /*lint !e586 C standard library call is being used for portability. */
+            }
+
+            OTA_LOG_L1( "[%s] ERROR - Unable to write the checkpoint.\r\n", OTA_METHOD_NAME );
+            eResult = ( kOTA_Err_CheckpointFailed | ( errno & kOTA_PAL_ErrMask ) ); /*lint !e40 !e737 !e9027 !e9029
+                                                                                     * Errno is being used in accordance with host API documentation.
+                                                                                     * Bitmasking is being used to preserve host API error with library status code. */
+        }
+    }
+
+    return eResult;
+}
+
+/* Read back a stored download checkpoint and reopen the partly received file without truncating it. */
+
+int32_t prvPAL_ResumeFileForRx( OTA_FileContext_t * const C,
+                                uint8_t * const pucCheckpoint,
+                                uint32_t ulMaxLength )
+{
+    DEFINE_OTA_METHOD_NAME( "prvPAL_ResumeFileForRx" );
+
+    int32_t lResult = 0;
+    char pcPath[ OTA_PAL_WIN_PATH_SIZE ];
+    FILE * pxCheckpointFile = NULL;
+    size_t xRead = 0;
+
+    if( ( pucCheckpoint == NULL ) || ( prvPAL_CheckpointPath( C, pcPath ) == pdFALSE ) )
+    {
+        OTA_LOG_L1( "[%s] ERROR - Invalid context provided.\r\n", OTA_METHOD_NAME );
+        lResult = -1;
+    }
+    else
+    {
+        pxCheckpointFile = fopen( pcPath, "rb" ); /*lint !e586 C standard library call is being used for portability. */
+
+        if( pxCheckpointFile != NULL )
+        {
+            /* A checkpoint with data left over after ulMaxLength bytes is too large. */
+            xRead = fread( pucCheckpoint, 1, ulMaxLength, pxCheckpointFile ); /*lint !e586 C standard library call is being used for portability. */
+
+            if( ( xRead == 0U ) || ( fgetc( pxCheckpointFile ) != EOF ) ) /*lint !e586 C standard library call is being used for portability. */
+            {
+                OTA_LOG_L1( "[%s] ERROR - Checkpoint is empty or too large.\r\n", OTA_METHOD_NAME );
+                lResult = -1;
+            }
+            else
+            {
+                C->pxFile = fopen( ( const char * ) C->pucFilePath, "r+b" ); /*lint !e586 C standard library call is being used for portability. */
+
+                if( C->pxFile != NULL )
+                {
+                    OTA_LOG_L1( "[%s] Receive file reopened.\r\n", OTA_METHOD_NAME );
+                    lResult = ( int32_t ) xRead;
+                }
+                else
+                {
+                    OTA_LOG_L1( "[%s] ERROR - Unable to reopen the receive file.\r\n", OTA_METHOD_NAME );
+                    lResult = -1;
+                }
+            }
+
+            ( void ) fclose( pxCheckpointFile ); /*lint !e586 C standard library call is being used for portability. */
+        }
+    }
+
+    return lResult; /*lint !e480 !e481 Exiting function without calling fclose.
+                     * Context file handle state is managed by this API. */
+}
+
 /* Close the specified file. This shall authenticate the file if it is marked as secure. */
 
 OTA_Err_t prvPAL_CloseFile( OTA_FileContext_t * const C )
@@ -264,15 +404,28 @@ static OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
     uint32_t ulSignerCertSize;
     uint8_t * pucBuf, * pucSignerCert;
     void * pvSigVerifyContext;
+    BaseType_t xFileHashed = pdFALSE;
 
     if( prvContextValidate( C ) == pdTRUE )
     {
+        if( C->pvSigVerifyContext != NULL )
+        {
+            /* The agent has already hashed every block as it was received. */
+            pvSigVerifyContext = C->pvSigVerifyContext;
+            C->pvSigVerifyContext = NULL;
+            xFileHashed = pdTRUE;
+        }
         /* Verify an ECDSA-SHA256 signature. */
-        if( pdFALSE == CRYPTO_SignatureVerificationStart( &pvSigVerifyContext, cryptoASYMMETRIC_ALGORITHM_ECDSA, cryptoHASH_ALGORITHM_SHA256 ) )
+        else if( pdFALSE == CRYPTO_SignatureVerificationStart( &pvSigVerifyContext, cryptoASYMMETRIC_ALGORITHM_ECDSA, cryptoHASH_ALGORITHM_SHA256 ) )
         {
             eResult = kOTA_Err_SignatureCheckFailed;
         }
         else
+        {
+            /* Nothing special to do. */
+        }
+
+        if( eResult == kOTA_Err_None )
         {
             OTA_LOG_L1( "[%s] Started %s signature verification, file: %s\r\n", OTA_METHOD_NAME,
                         cOTA_JSON_FileSignatureKey, ( const char * ) C->pucCertFilepath );
@@ -280,21 +433,24 @@ static OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
 
             if( pucSignerCert != NULL )
             {
-                pucBuf = pvPortMalloc( OTA_PAL_WIN_BUF_SIZE ); /*lint !e9079 Allow conversion. */
+                pucBuf = ( xFileHashed == pdTRUE ) ? NULL : pvPortMalloc( OTA_PAL_WIN_BUF_SIZE ); /*lint !e9079 Allow conversion. */
 
-                if( pucBuf != NULL )
+                if( ( pucBuf != NULL ) || ( xFileHashed == pdTRUE ) )
                 {
                     /* Rewind the received file to the beginning. */
-                    if( fseek( C->pxFile, 0L, SEEK_SET ) == 0 ) /*lint !e586
-                                                                  * C standard library call is being used for portability. */
+                    if( ( xFileHashed == pdTRUE ) || ( fseek( C->pxFile, 0L, SEEK_SET ) == 0 ) ) /*lint !e586
+                                                                                                   * C standard library call is being used for portability. */
                     {
-                        do
+                        if( xFileHashed == pdFALSE )
                         {
-                            ulBytesRead = fread( pucBuf, 1, OTA_PAL_WIN_BUF_SIZE, C->pxFile ); /*lint !e586
-                                                                                               * C standard library call is being used for portability. */
-                            /* Include the file chunk in the signature validation. Zero size is OK. */
-                            CRYPTO_SignatureVerificationUpdate( pvSigVerifyContext, pucBuf, ulBytesRead );
-                        } while( ulBytesRead > 0UL );
+                            do
+                            {
+                                ulBytesRead = fread( pucBuf, 1, OTA_PAL_WIN_BUF_SIZE, C->pxFile ); /*lint !e586
+                                                                                                   * C standard library call is being used for portability. */
+                                /* Include the file chunk in the signature validation. Zero size is OK. */
+                                CRYPTO_SignatureVerificationUpdate( pvSigVerifyContext, pucBuf, ulBytesRead );
+                            } while( ulBytesRead > 0UL );
+                        }
 
                         if( pdFALSE == CRYPTO_SignatureVerificationFinal( pvSigVerifyContext,
                                                                           ( char * ) pucSignerCert,
@@ -325,6 +481,8 @@ static OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
             }
             else
             {
+                /* Free the verification context. */
+                ( void ) CRYPTO_SignatureVerificationFinal( pvSigVerifyContext, NULL, 0, NULL, 0 );
                 eResult = kOTA_Err_BadSignerCert;
             }
         }